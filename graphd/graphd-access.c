@@ -113,6 +113,21 @@ int graphd_access_set_global(graphd_handle* g, graphd_access_global acc,
     }
   }
 
+  /*  Leaving a bulk load?  Index what it loaded before
+   *  anyone gets to read it.
+   */
+  if (GRAPHD_ACCESS_RESTORE == old_acc && GRAPHD_ACCESS_RESTORE != acc &&
+      pdb_bulk(g->g_pdb)) {
+    err = pdb_bulk_finish(g->g_pdb);
+    if (err) {
+      snprintf(error_buf, error_buf_size,
+               "failed to index bulk-loaded records: %s",
+               graphd_strerror(err));
+      *error_is_retriable = true;
+      return err;
+    }
+  }
+
   g->g_access = acc;
 
   /* If we're already in replica mode, the intention
@@ -0,0 +1,361 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+#include "graphd/graphd-read.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsrv/srv.h"
+
+/**
+ * @file graphd-admission.c
+ * @brief Defer or shed expensive reads while the server is behind.
+ *
+ *  With "admission-slo <milliseconds>" in the configuration file,
+ *  graphd keeps a moving average of how long requests wait before
+ *  they first get to run.  As long as that stays within the SLO,
+ *  every request runs as it always has.
+ *
+ *  Once it doesn't, a read is looked at after its iterators have
+ *  been built, but before it runs.  It still runs right away if
+ *  its estimated cost (see graphd_read_set_estimate_cost()) isn't
+ *  known or is no more than average, if its session hasn't used
+ *  up its fair share of the recent work, or if no other session
+ *  is waiting.  Otherwise, it is deferred: it gives up its turn
+ *  to the other sessions and asks again next time around.
+ *
+ *  If the wait grows past twice the SLO, or a read has been
+ *  deferred for four times the SLO, it is rejected instead, with
+ *  a "BUSY" error; the client can retry it later.
+ *
+ *  A session's fair share is the work admitted over the last few
+ *  GRAPHD_ADMISSION_WINDOW_MILLIS windows, divided by the number
+ *  of sessions that ran reads in them.
+ *
+ *  The counts are in "status (admission)".
+ */
+
+/*  When the cost of a read is still unknown, spend this much
+ *  on its statistics before deciding.  That's work the read would
+ *  have to do anyway.
+ */
+#define GRAPHD_ADMISSION_STATISTICS_BUDGET 1000
+
+/*  Let the average wait decay by half for every SLO interval
+ *  in which there was no new measurement.
+ */
+static void admission_delay_decay(graphd_handle *g, srv_msclock_t now) {
+  unsigned long long const slo = g->g_admission_slo;
+
+  if (now <= g->g_admission_delay_updated) return;
+  if (now - g->g_admission_delay_updated >= 32 * slo) {
+    g->g_admission_delay = 0;
+    g->g_admission_delay_updated = now;
+    return;
+  }
+  while (now - g->g_admission_delay_updated >= slo) {
+    g->g_admission_delay /= 2;
+    g->g_admission_delay_updated += slo;
+  }
+}
+
+static unsigned long long admission_halve(unsigned long long n,
+                                          unsigned long long times) {
+  return times >= 64 ? 0 : n >> times;
+}
+
+/*  Move the global and per-session usage counters into <window>.
+ */
+static void admission_window_advance(graphd_handle *g, graphd_session *gses,
+                                     unsigned long long window) {
+  if (window > g->g_admission_window) {
+    unsigned long long const d = window - g->g_admission_window;
+
+    g->g_admission_usage = admission_halve(g->g_admission_usage, d);
+    g->g_admission_sessions_previous = d == 1 ? g->g_admission_sessions : 0;
+    g->g_admission_sessions = 0;
+    g->g_admission_window = window;
+  }
+  if (window > gses->gses_admission_window) {
+    gses->gses_admission_usage = admission_halve(
+        gses->gses_admission_usage, window - gses->gses_admission_window);
+    gses->gses_admission_window = window;
+  }
+}
+
+static void admission_admit(graphd_request *greq, pdb_budget cost) {
+  graphd_handle *g = graphd_request_graphd(greq);
+  graphd_session *gses = graphd_request_session(greq);
+
+  greq->greq_admitted = true;
+  g->g_admission_admitted++;
+
+  if (cost < 0) return;
+
+  gses->gses_admission_usage += cost;
+  g->g_admission_usage += cost;
+  g->g_admission_mean_cost = (7 * g->g_admission_mean_cost + cost) / 8;
+
+  if (gses->gses_admission_active != g->g_admission_window) {
+    gses->gses_admission_active = g->g_admission_window;
+    g->g_admission_sessions++;
+  }
+}
+
+/**
+ * @brief A request has arrived.
+ *
+ * @param greq	the request
+ */
+void graphd_admission_arrived(graphd_request *greq) {
+  graphd_handle *g = graphd_request_graphd(greq);
+
+  greq->greq_admission_arrived = srv_msclock(g->g_srv);
+}
+
+/**
+ * @brief A request has finished running.
+ *
+ *  The next request in the same session can't start before this,
+ *  so that's where its wait begins.
+ *
+ * @param greq	the request
+ */
+void graphd_admission_done(graphd_request *greq) {
+  graphd_handle *g = graphd_request_graphd(greq);
+
+  graphd_request_session(greq)->gses_admission_done = srv_msclock(g->g_srv);
+}
+
+/**
+ * @brief May this read run now?
+ *
+ *  Called with the read's iterators built, but before it starts
+ *  running.  If the read is shed, its error message is set and
+ *  the caller should treat it as failed.
+ *
+ * @param greq	a read request
+ * @param it	the iterator for its top-level constraint
+ *
+ * @return 0 if the request may run,
+ * @return GRAPHD_ERR_MORE if it should yield and ask again later,
+ * @return EBUSY if it has been shed.
+ */
+int graphd_admission_check(graphd_request *greq, pdb_iterator *it) {
+  graphd_handle *g = graphd_request_graphd(greq);
+  graphd_session *gses = graphd_request_session(greq);
+  cl_handle *cl = graphd_request_cl(greq);
+  unsigned long long const slo = g->g_admission_slo;
+  unsigned long long share, active;
+  srv_msclock_t now;
+  pdb_budget cost;
+  int err;
+
+  if (greq->greq_admitted) return 0;
+  /*  Replication and SMP traffic is never held up.
+   */
+  if (slo == 0 || (gses->gses_type != GRAPHD_SESSION_UNSPECIFIED &&
+                   gses->gses_type != GRAPHD_SESSION_SERVER)) {
+    admission_admit(greq, -1);
+    return 0;
+  }
+
+  now = srv_msclock(g->g_srv);
+  admission_delay_decay(g, now);
+
+  /*  The first time around, measure how long we waited.
+   */
+  if (!greq->greq_admission_deferred) {
+    srv_msclock_t start = greq->greq_admission_arrived;
+
+    if (gses->gses_admission_done > start) start = gses->gses_admission_done;
+    if (now > start)
+      g->g_admission_delay = (7 * g->g_admission_delay + (now - start)) / 8;
+    else
+      g->g_admission_delay = (7 * g->g_admission_delay) / 8;
+    g->g_admission_delay_updated = now;
+  }
+  admission_window_advance(g, gses, now / GRAPHD_ADMISSION_WINDOW_MILLIS);
+
+  cost = graphd_read_set_estimate_cost(greq, it);
+  if (g->g_admission_delay <= slo) goto admit;
+
+  if (cost < 0 && !pdb_iterator_statistics_done(g->g_pdb, it)) {
+    pdb_budget budget = GRAPHD_ADMISSION_STATISTICS_BUDGET;
+
+    err = pdb_iterator_statistics(g->g_pdb, it, &budget);
+    if (err != 0 && err != PDB_ERR_MORE)
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_statistics", err,
+                   "ignoring error while estimating cost");
+    cost = graphd_read_set_estimate_cost(greq, it);
+  }
+  if (cost < 0 || (unsigned long long)cost <= g->g_admission_mean_cost)
+    goto admit;
+
+  active = g->g_admission_sessions > g->g_admission_sessions_previous
+               ? g->g_admission_sessions
+               : g->g_admission_sessions_previous;
+  share = g->g_admission_usage / (active > 0 ? active : 1);
+  if (gses->gses_admission_usage + cost <= share) goto admit;
+
+  /*  Nobody else would get to run in our place.
+   */
+  if (!srv_any_other_sessions_ready_to_run(g->g_srv, &gses->gses_ses))
+    goto admit;
+
+  if (g->g_admission_delay > 2 * slo ||
+      (greq->greq_admission_deferred &&
+       now - greq->greq_admission_deferred_since > 4 * slo)) {
+    cl_log(cl, CL_LEVEL_INFO,
+           "graphd_admission_check: shedding read with cost %lld "
+           "(delay %llu ms, slo %llu ms)",
+           (long long)cost, g->g_admission_delay, slo);
+    g->g_admission_shed++;
+    graphd_request_error(greq, "BUSY server overloaded; retry later");
+    return EBUSY;
+  }
+
+  if (!greq->greq_admission_deferred) {
+    greq->greq_admission_deferred = true;
+    greq->greq_admission_deferred_since = now;
+    g->g_admission_deferred++;
+
+    cl_log(cl, CL_LEVEL_VERBOSE,
+           "graphd_admission_check: deferring read with cost %lld "
+           "(delay %llu ms, usage %llu, share %llu)",
+           (long long)cost, g->g_admission_delay, gses->gses_admission_usage,
+           share);
+  }
+  return GRAPHD_ERR_MORE;
+
+admit:
+  admission_admit(greq, cost);
+  return 0;
+}
+
+static int admission_status_pair(graphd_handle *g, cm_handle *cm,
+                                 cl_handle *cl, graphd_value *val,
+                                 char const *name, unsigned long long n) {
+  int err;
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 2);
+  if (err != 0) return err;
+
+  err = graphd_value_text_strdup(cm, val->val_list_contents,
+                                 GRAPHD_VALUE_STRING, name,
+                                 name + strlen(name));
+  if (err != 0) return err;
+
+  graphd_value_number_set(val->val_list_contents + 1, n);
+  return 0;
+}
+
+/*
+ *  admission: (("slo" ms) ("delay" ms) ("mean-cost" n)
+ *		("admitted" n) ("deferred" n) ("shed" n))
+ */
+int graphd_admission_status(graphd_request *greq, graphd_value *val) {
+  cl_handle *cl = graphd_request_cl(greq);
+  cm_handle *cm = greq->greq_req.req_cm;
+  graphd_handle *g = graphd_request_graphd(greq);
+  graphd_value *el;
+  int err;
+
+  if (g->g_admission_slo > 0)
+    admission_delay_decay(g, srv_msclock(g->g_srv));
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 6);
+  if (err != 0) return err;
+
+  el = val->val_list_contents;
+  err = admission_status_pair(g, cm, cl, el++, "slo", g->g_admission_slo);
+  if (err == 0)
+    err = admission_status_pair(g, cm, cl, el++, "delay", g->g_admission_delay);
+  if (err == 0)
+    err = admission_status_pair(g, cm, cl, el++, "mean-cost",
+                                g->g_admission_mean_cost);
+  if (err == 0)
+    err = admission_status_pair(g, cm, cl, el++, "admitted",
+                                g->g_admission_admitted);
+  if (err == 0)
+    err = admission_status_pair(g, cm, cl, el++, "deferred",
+                                g->g_admission_deferred);
+  if (err == 0)
+    err = admission_status_pair(g, cm, cl, el++, "shed", g->g_admission_shed);
+  if (err != 0) graphd_value_finish(cl, val);
+
+  return err;
+}
+
+/**
+ * @brief Parse the admission control SLO from the configuration file.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ * @param s		in/out: current position in configuration file
+ * @param e		in: end of the buffered configuration file
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_admission_config_read(void *data, srv_handle *srv,
+                                 void *config_data, srv_config *srv_cf,
+                                 char **s, char const *e) {
+  cl_handle *cl = srv_log(srv);
+  graphd_config *gcf = config_data;
+  unsigned long long n = 0;
+  int err;
+
+  err = srv_config_read_number(srv_cf, cl, "admission SLO in millis", s, e,
+                               &n);
+  if (err != 0) return err;
+
+  if (n > 60 * 60 * 1000) {
+    cl_log(cl, CL_LEVEL_OPERATOR_ERROR,
+           "configuration file %s, line %d: admission-slo %llu "
+           "is longer than an hour; that can't be right",
+           srv_config_file_name(srv_cf), srv_config_line_number(srv_cf, e), n);
+    return ERANGE;
+  }
+  gcf->gcf_admission_slo = n;
+
+  return 0;
+}
+
+/**
+ * @brief Set an option as configured.  (Method.)
+ *
+ *  This is a method of the generic libsrv parameter mechanism,
+ *  passed in via a srv_config_parameter[] structure declared in graphd.c.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_admission_config_open(void *data, srv_handle *srv,
+                                 void *config_data, srv_config *srv_cf) {
+  graphd_handle *g = data;
+  graphd_config *gcf = config_data;
+
+  cl_assert(srv_log(srv), g != NULL);
+  cl_assert(srv_log(srv), config_data != NULL);
+
+  g->g_admission_slo = gcf->gcf_admission_slo;
+  return 0;
+}
@@ -1355,6 +1355,14 @@ static int ast_smpcmd_new(gdp_output *out, gdp_smpcmd_t **smpcmd,
                           unsigned long long **smppid) {
   graphd_request *greq = out->out_private;
 
+  /*  In the reply to one of our own SMP requests, the
+   *  command is the state the follower reports back.
+   */
+  if (greq->greq_request == GRAPHD_REQUEST_SMP_OUT) {
+    *smpcmd = &greq->greq_data.gd_smp_out.gdso_reply;
+    *smppid = &greq->greq_data.gd_smp_out.gdso_smppid;
+    return 0;
+  }
   *smpcmd = &greq->greq_data.gd_smp.gds_smpcmd;
   *smppid = &greq->greq_data.gd_smp.gds_smppid;
 
@@ -1449,11 +1457,17 @@ static int ast_statlist_add(gdp_output *out, gdp_statlist_t *statlist,
         if (gdp_token_matches(tok, "islink")) id = GRAPHD_STATUS_ISLINK;
         break;
 
+      case 'a':
+        if (gdp_token_matches(tok, "admission")) id = GRAPHD_STATUS_ADMISSION;
+        break;
+
       case 'c':
         if (gdp_token_matches(tok, "conn") ||
             gdp_token_matches(tok, "connection") ||
             gdp_token_matches(tok, "connections"))
           id = GRAPHD_STATUS_CONNECTION;
+        else if (gdp_token_matches(tok, "commit"))
+          id = GRAPHD_STATUS_COMMIT;
         break;
 
       case 'd':
@@ -1470,6 +1484,10 @@ static int ast_statlist_add(gdp_output *out, gdp_statlist_t *statlist,
           id = GRAPHD_STATUS_MEMORY;
         break;
 
+      case 'p':
+        if (gdp_token_matches(tok, "plan")) id = GRAPHD_STATUS_PLAN;
+        break;
+
       case 'r':
         if (gdp_token_matches(tok, "rep") ||
             gdp_token_matches(tok, "replica-details"))
@@ -1477,6 +1495,12 @@ static int ast_statlist_add(gdp_output *out, gdp_statlist_t *statlist,
         else if (gdp_token_matches(tok, "ru") ||
                  gdp_token_matches(tok, "rusage"))
           id = GRAPHD_STATUS_RUSAGE;
+        else if (gdp_token_matches(tok, "resource"))
+          id = GRAPHD_STATUS_RESOURCE;
+        break;
+
+      case 's':
+        if (gdp_token_matches(tok, "smp")) id = GRAPHD_STATUS_SMP;
         break;
 
       case 't':
@@ -58,6 +58,34 @@ static int add_subcondition(graphd_request *greq, graphd_constraint *con,
   return graphd_iterator_and_add_subcondition(g, con->con_it, sub_it);
 }
 
+/*  Key the "and" iterator's statistics contest in the plan cache
+ *  by the constraint's signature, without the GUIDs that vary
+ *  from one request to the next.
+ */
+static int set_plan_key(graphd_request *greq, graphd_constraint *con) {
+  graphd_handle *g = graphd_request_graphd(greq);
+  cm_buffer sig;
+  int err;
+
+  if (g->g_plan_cache_max == 0 ||
+      !graphd_iterator_and_is_instance(g->g_pdb, con->con_it, NULL, NULL))
+    return 0;
+
+  err = graphd_constraint_signature(
+      g, con, GRAPHD_SIGNATURE_OMIT_CURSOR | GRAPHD_SIGNATURE_OMIT_COMMON_GUID,
+      &sig);
+  if (err != 0) {
+    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graphd_constraint_signature", err,
+                 "con=%s", graphd_constraint_to_string(con));
+    return err;
+  }
+  err = graphd_iterator_and_set_plan_key(g, con->con_it, cm_buffer_memory(&sig),
+                                         cm_buffer_length(&sig));
+  cm_buffer_finish(&sig);
+
+  return err;
+}
+
 static char const *direction_to_string(graphd_direction dir) {
   switch (dir) {
     case GRAPHD_DIRECTION_FORWARD:
@@ -110,6 +138,7 @@ static int initialize(graphd_request *greq, graphd_constraint *con) {
 
   high = graphd_dateline_high(g, con);
   if (high < con->con_high) con->con_high = high;
+  if (greq->greq_snapshot < con->con_high) con->con_high = greq->greq_snapshot;
 
   direction = graphd_sort_root_iterator_direction(greq, con, &ordering);
 
@@ -767,6 +796,24 @@ static int cheap(graphd_request *greq, graphd_constraint *con) {
   return 0;
 }
 
+/*  Does this constraint only ever match live primitives -- the
+ *  newest of their lineage, and not deleted -- as the database is
+ *  right now?  (That's the default, unless the read looks at the
+ *  past.)  Then its linkage iterators needn't bother returning the
+ *  others.
+ */
+static bool linkage_live_only(graphd_request *greq,
+                              graphd_constraint const *con) {
+  pdb_handle *pdb = graphd_request_graphd(greq)->g_pdb;
+
+  return con->con_live == GRAPHD_FLAG_TRUE && con->con_newest.gencon_valid &&
+         con->con_newest.gencon_min == 0 && con->con_newest.gencon_max == 0 &&
+         !con->con_oldest.gencon_valid && con->con_or == NULL &&
+         con->con_or_head == NULL && greq->greq_asof == NULL &&
+         (greq->greq_snapshot == PDB_ITERATOR_HIGH_ANY ||
+          greq->greq_snapshot == pdb_primitive_n(pdb));
+}
+
 /**
  * @brief 	Create an iterator that embodies pointing to something
  *  		else with a right/left/type/scope link.
@@ -855,6 +902,11 @@ static int linkage_single_iterator(graphd_request *greq, graphd_constraint *con,
                              direction != GRAPHD_DIRECTION_BACKWARD,
                              /* error-if-null */ false, it_out);
   if (err == 0) {
+    /*  Large linkage sets are bitmaps; AND them with the
+     *  live bitmap instead of matching dead primitives later.
+     */
+    if (linkage_live_only(greq, con)) pdb_iterator_bgmap_live_set(pdb, *it_out);
+
     graphd_iterator_set_direction_ordering(pdb, *it_out, direction, ordering);
     graphd_constraint_account(greq, con, *it_out);
   }
@@ -2015,6 +2067,9 @@ done:
      *  graphd_iterator_and_create_commit() handles that
      *  gracefully.
      */
+    err = set_plan_key(greq, con);
+    if (err != 0) goto error;
+
     err = graphd_iterator_and_create_commit(g, con->con_it);
     if (err != 0) goto error;
 
@@ -19,6 +19,7 @@ limitations under the License.
 #include <string.h>
 #include <sysexits.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "libsrv/srv.h"
 
@@ -45,6 +46,12 @@ static graphd_database_config const* default_config(cl_handle* cl) {
     d.dcf_pdb_cf.pcf_gcf.gcf_max_lf = 256;
 
   d.dcf_pdb_cf.pcf_gcf.gcf_allow_bgmaps = true;
+  d.dcf_pdb_cf.pcf_gcf.gcf_pack = false;
+  d.dcf_pdb_cf.pcf_prefetch = 256 * 1024;
+
+  /* No worker threads unless the configuration asks for them.
+   */
+  d.dcf_pdb_cf.pcf_workers = 0;
 
   if (sizeof(void*) < 8) {
     /* A 32-bit system: try and fit indexes into the
@@ -312,6 +319,18 @@ again:
     goto err;
   }
 
+  /*
+   * During a bulk load, the indices catch up later.
+   */
+  if (g->g_bulk_load && (err = pdb_bulk_begin(g->g_pdb)) != 0) {
+    cl_log_errno(cl, CL_LEVEL_OPERATOR_ERROR, "pdb_bulk_begin", err,
+                 "unexpected error");
+    srv_epitaph_print(srv, EX_GRAPHD_DATABASE,
+                      "Failed to start a bulk load into database \"%s\": %s",
+                      dcf->dcf_path, graphd_strerror(err));
+    goto err;
+  }
+
   /*
    * If we need to reindex parts of the database, do that now.
    */
@@ -328,8 +347,9 @@ again:
 
   /*
    * Verify the last 10,000 or so primitives in the database.
+   * (Not during a bulk load -- they may not have been indexed yet.)
    */
-  if (g->g_verify) {
+  if (g->g_verify && !pdb_bulk(g->g_pdb)) {
     unsigned long long n = pdb_primitive_n(g->g_pdb);
     pdb_iterator_chain ch[1];
 
@@ -653,6 +673,30 @@ static int graphd_database_config_read_database(
           err = srv_config_read_boolean(srv_cf, cl, s, e,
                                         &(pdb_cf->pcf_gcf.gcf_allow_bgmaps));
 
+        else if (IS_LIT("gmap-pack", tok_s, tok_e))
+          err = srv_config_read_boolean(srv_cf, cl, s, e,
+                                        &(pdb_cf->pcf_gcf.gcf_pack));
+
+        else if (IS_LIT("workers", tok_s, tok_e))
+          err = srv_config_read_number(srv_cf, cl, "workers", s, e,
+                                       &pdb_cf->pcf_workers);
+
+        else if (IS_LIT("parallel-min", tok_s, tok_e))
+          err = srv_config_read_number(srv_cf, cl, "parallel minimum", s, e,
+                                       &pdb_cf->pcf_parallel_min);
+
+        else if (IS_LIT("prefetch", tok_s, tok_e))
+          err = srv_config_read_number(srv_cf, cl, "prefetch distance", s, e,
+                                       &pdb_cf->pcf_prefetch);
+
+        else if (IS_LIT("redo-log", tok_s, tok_e))
+          err = srv_config_read_number(srv_cf, cl, "redo log size", s, e,
+                                       &pdb_cf->pcf_redo_log);
+
+        else if (IS_LIT("writeback", tok_s, tok_e))
+          err = srv_config_read_number(srv_cf, cl, "writeback rate", s, e,
+                                       &pdb_cf->pcf_writeback);
+
         else {
           cl_cover(cl);
           goto unknown;
@@ -43,6 +43,27 @@ graph_dateline* graphd_dateline(graphd_handle* g) {
   return graph_dateline_dup(g->g_dateline);
 }
 
+/*  The dateline of a read snapshot: the server's dateline, with
+ *  the local database as it was when it had <n> primitives.
+ */
+graph_dateline* graphd_dateline_snapshot(graphd_handle* g, pdb_id n) {
+  graph_dateline* dl;
+  int err;
+
+  if ((dl = graphd_dateline(g)) == NULL) return NULL;
+  if (n == PDB_ITERATOR_HIGH_ANY || n >= pdb_primitive_n(g->g_pdb)) return dl;
+
+  /*  Splits off a copy of the shared g->g_dateline.
+   */
+  err = graph_dateline_add_minimum(&dl, pdb_database_id(g->g_pdb), n,
+                                   g->g_instance_id);
+  if (err != 0) {
+    graph_dateline_destroy(dl);
+    return NULL;
+  }
+  return dl;
+}
+
 pdb_id graphd_dateline_low(graphd_handle const* g,
                            graphd_constraint const* con) {
   graph_dateline const* dl;
@@ -0,0 +1,214 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsrv/srv.h"
+
+/**
+ * @file graphd-group-commit.c
+ * @brief Share one checkpoint between writes that arrive together.
+ *
+ *  Before graphd acknowledges a write, the primitives it wrote
+ *  have to be on disk; graphd_format_sync_horizon() takes care
+ *  of that just before the reply is sent.  Left alone, each
+ *  acknowledgement pays for its own checkpoint and fsync.
+ *
+ *  With "group-commit <milliseconds>" in the configuration file,
+ *  the first acknowledgement that needs a checkpoint opens a
+ *  window of that length.  Acknowledgements that need one while
+ *  the window is open wait along with it; when it closes, one
+ *  checkpoint makes all of them durable at once.
+ *
+ *  The number of acknowledgements per checkpoint is counted
+ *  in "status (commit)".
+ */
+
+/**
+ * @brief Should an acknowledgement keep waiting for its checkpoint?
+ *
+ *  The first call for an acknowledgement joins the current batch,
+ *  opening the window if it's the first one in it.
+ *
+ * @param g		graphd handle
+ * @param batch		in/out: the ordinal of the batch the caller
+ *			belongs to, 0 if none yet.
+ *
+ * @return true if the window is still open, false if it's time
+ *	to checkpoint.
+ */
+bool graphd_group_commit_wait(graphd_handle *g, unsigned long long *batch) {
+  pdb_msclock_t const now = pdb_msclock(g->g_pdb);
+
+  if (*batch != g->g_group_commit_batch + 1) {
+    *batch = g->g_group_commit_batch + 1;
+    if (g->g_group_commit_waiting++ == 0) g->g_group_commit_start = now;
+  }
+  return g->g_group_commit_window > 0 &&
+         now - g->g_group_commit_start < g->g_group_commit_window;
+}
+
+/**
+ * @brief A checkpoint has made the current batch durable.
+ *
+ * @param g		graphd handle
+ */
+void graphd_group_commit_done(graphd_handle *g) {
+  unsigned long long n = g->g_group_commit_waiting;
+  size_t bucket = 0;
+
+  if (n == 0) n = 1;
+  while (bucket < GRAPHD_GROUP_COMMIT_BUCKETS - 1 && (2ull << bucket) <= n)
+    bucket++;
+
+  g->g_group_commit_sizes[bucket]++;
+  g->g_group_commit_requests += n;
+  if (n > g->g_group_commit_largest) g->g_group_commit_largest = n;
+
+  g->g_group_commit_batch++;
+  g->g_group_commit_waiting = 0;
+}
+
+static int group_commit_status_pair(graphd_handle *g, cm_handle *cm,
+                                    cl_handle *cl, graphd_value *val,
+                                    char const *name, unsigned long long n) {
+  int err;
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 2);
+  if (err != 0) return err;
+
+  err = graphd_value_text_strdup(cm, val->val_list_contents,
+                                 GRAPHD_VALUE_STRING, name,
+                                 name + strlen(name));
+  if (err != 0) return err;
+
+  graphd_value_number_set(val->val_list_contents + 1, n);
+  return 0;
+}
+
+/*
+ *  commit: (("window" ms) ("batches" n) ("requests" n) ("largest" n)
+ *	     ("1" n) ("2-3" n) ("4-7" n) ... ("128+" n))
+ */
+int graphd_group_commit_status(graphd_request *greq, graphd_value *val) {
+  cl_handle *cl = graphd_request_cl(greq);
+  cm_handle *cm = greq->greq_req.req_cm;
+  graphd_handle *g = graphd_request_graphd(greq);
+  unsigned long long batches = 0;
+  graphd_value *el;
+  char name[42];
+  size_t i;
+  int err;
+
+  err = graphd_value_list_alloc(g, cm, cl, val,
+                                4 + GRAPHD_GROUP_COMMIT_BUCKETS);
+  if (err != 0) return err;
+
+  for (i = 0; i < GRAPHD_GROUP_COMMIT_BUCKETS; i++)
+    batches += g->g_group_commit_sizes[i];
+
+  el = val->val_list_contents;
+  err = group_commit_status_pair(g, cm, cl, el++, "window",
+                                 g->g_group_commit_window);
+  if (err == 0)
+    err = group_commit_status_pair(g, cm, cl, el++, "batches", batches);
+  if (err == 0)
+    err = group_commit_status_pair(g, cm, cl, el++, "requests",
+                                   g->g_group_commit_requests);
+  if (err == 0)
+    err = group_commit_status_pair(g, cm, cl, el++, "largest",
+                                   g->g_group_commit_largest);
+  if (err != 0) goto err;
+
+  for (i = 0; i < GRAPHD_GROUP_COMMIT_BUCKETS; i++) {
+    if (i == 0)
+      snprintf(name, sizeof name, "1");
+    else if (i == GRAPHD_GROUP_COMMIT_BUCKETS - 1)
+      snprintf(name, sizeof name, "%llu+", 1ull << i);
+    else
+      snprintf(name, sizeof name, "%llu-%llu", 1ull << i, (2ull << i) - 1);
+
+    err = group_commit_status_pair(g, cm, cl, el++, name,
+                                   g->g_group_commit_sizes[i]);
+    if (err != 0) goto err;
+  }
+  return 0;
+
+err:
+  graphd_value_finish(cl, val);
+  return err;
+}
+
+/**
+ * @brief Parse the group commit window from the configuration file.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ * @param s		in/out: current position in configuration file
+ * @param e		in: end of the buffered configuration file
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_group_commit_config_read(void *data, srv_handle *srv,
+                                    void *config_data, srv_config *srv_cf,
+                                    char **s, char const *e) {
+  cl_handle *cl = srv_log(srv);
+  graphd_config *gcf = config_data;
+  unsigned long long n = 0;
+  int err;
+
+  err = srv_config_read_number(srv_cf, cl, "group commit window in millis", s,
+                               e, &n);
+  if (err != 0) return err;
+
+  if (n > 60 * 1000) {
+    cl_log(cl, CL_LEVEL_OPERATOR_ERROR,
+           "configuration file %s, line %d: group-commit %llu "
+           "is longer than a minute; that can't be right",
+           srv_config_file_name(srv_cf), srv_config_line_number(srv_cf, e), n);
+    return ERANGE;
+  }
+  gcf->gcf_group_commit = n;
+
+  return 0;
+}
+
+/**
+ * @brief Set an option as configured.  (Method.)
+ *
+ *  This is a method of the generic libsrv parameter mechanism,
+ *  passed in via a srv_config_parameter[] structure declared in graphd.c.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_group_commit_config_open(void *data, srv_handle *srv,
+                                    void *config_data, srv_config *srv_cf) {
+  graphd_handle *g = data;
+  graphd_config *gcf = config_data;
+
+  cl_assert(srv_log(srv), g != NULL);
+  cl_assert(srv_log(srv), config_data != NULL);
+
+  g->g_group_commit_window = gcf->gcf_group_commit;
+  return 0;
+}
@@ -0,0 +1,505 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+#include "graphd/graphd-islink.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*  The islink cache file.
+ *
+ *  Groups and completed type analyses take a long time to
+ *  build, but they only depend on the primitives that existed
+ *  when they were built; the database is append-only.  At
+ *  shutdown, they're saved in the file "islink" in the database
+ *  directory, together with the horizon -- the number of
+ *  primitives in the database at the time.  At startup, they're
+ *  loaded again, and the instances of their types beyond the
+ *  horizon are added.
+ *
+ *  All numbers are 8 bytes, most significant byte first.
+ *
+ *	header:	magic, database id, horizon, GUID of horizon - 1
+ *	groups:	count, then for each group
+ *		result linkage, type id, endpoint id, n, n ids
+ *	types:	count, then for each type
+ *		type id, n, and for each side
+ *		flags, n, n ids, count, count * (id, count, flags)
+ *
+ *  Types whose analysis is still running aren't saved; they
+ *  start over when they're next used.  Intersections aren't
+ *  saved either.
+ *
+ *  A file that doesn't fit the database -- because the
+ *  database was replaced, or rolled back past the horizon --
+ *  is ignored.
+ */
+
+#define GRAPHD_ISLINK_FILE_NAME "islink"
+#define GRAPHD_ISLINK_FILE_MAGIC 0x67696c6b00000001ull /* "gilk" v1 */
+
+#define GRAPHD_ISLINK_SIDE_VAST 0x01
+#define GRAPHD_ISLINK_SIDE_GROUP 0x02
+#define GRAPHD_ISLINK_SC_IDSET 0x01
+
+static void islink_file_put(FILE* fp, unsigned long long u) {
+  int i;
+
+  for (i = 56; i >= 0; i -= 8) putc((u >> i) & 0xFF, fp);
+}
+
+static int islink_file_get(FILE* fp, unsigned long long* u_out) {
+  unsigned long long u = 0;
+  int i, c;
+
+  for (i = 0; i < 8; i++) {
+    if ((c = getc(fp)) == EOF) return GRAPHD_ERR_LEXICAL;
+    u = (u << 8) | (unsigned char)c;
+  }
+  *u_out = u;
+  return 0;
+}
+
+static void islink_file_put_idset(FILE* fp, graph_idset* idset) {
+  graph_idset_position pos;
+  unsigned long long id;
+
+  islink_file_put(fp, idset->gi_n);
+
+  graph_idset_next_reset(idset, &pos);
+  while (graph_idset_next(idset, &id, &pos)) islink_file_put(fp, id);
+}
+
+static int islink_file_get_idset(graphd_handle* g, FILE* fp,
+                                 graph_idset** idset_out) {
+  graph_idset* idset;
+  unsigned long long n, id;
+  int err;
+
+  if ((err = islink_file_get(fp, &n)) != 0) return err;
+
+  if ((idset = graphd_idset_create(g)) == NULL) return errno ? errno : ENOMEM;
+
+  while (n-- > 0) {
+    if ((err = islink_file_get(fp, &id)) != 0 ||
+        (err = graph_idset_insert(idset, id)) != 0) {
+      graph_idset_free(idset);
+      return err;
+    }
+  }
+  *idset_out = idset;
+  return 0;
+}
+
+static int islink_file_path(graphd_handle* g, char const* suffix, char* buf,
+                            size_t size) {
+  char const* dir;
+
+  if (g->g_pdb == NULL || (dir = pdb_database_path(g->g_pdb)) == NULL)
+    return GRAPHD_ERR_NO;
+
+  if (snprintf(buf, size, "%s/%s%s", dir, GRAPHD_ISLINK_FILE_NAME, suffix) >=
+      size)
+    return ENAMETOOLONG;
+  return 0;
+}
+
+static void islink_file_put_side(graphd_handle* g, FILE* fp,
+                                 graphd_islink_side const* side) {
+  graphd_islink_side_count const* sc;
+
+  islink_file_put(fp, (side->side_vast ? GRAPHD_ISLINK_SIDE_VAST : 0) |
+                          (side->side_group ? GRAPHD_ISLINK_SIDE_GROUP : 0));
+  if (side->side_vast) return;
+
+  /*  A side that became a group is saved with the group.
+   */
+  if (side->side_group || side->side_idset == NULL)
+    islink_file_put(fp, 0);
+  else
+    islink_file_put_idset(fp, side->side_idset);
+
+  if (side->side_idset == NULL) {
+    islink_file_put(fp, 0);
+    return;
+  }
+  islink_file_put(fp, cm_hashnelems(&side->side_count));
+  sc = NULL;
+  while ((sc = cm_hnext(&side->side_count, graphd_islink_side_count, sc)) !=
+         NULL) {
+    islink_file_put(fp, graphd_islink_side_count_id(side, sc));
+    islink_file_put(fp, sc->sc_count);
+    islink_file_put(fp, sc->sc_idset != NULL ? GRAPHD_ISLINK_SC_IDSET : 0);
+  }
+}
+
+/**
+ * @brief Save the islink cache.
+ *
+ *  Called at shutdown, with the database still open.
+ *
+ * @param g	graphd handle
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int graphd_islink_save(graphd_handle* g) {
+  graphd_islink_handle* ih = g->g_islink;
+  graphd_islink_group const* group;
+  graphd_islink_type const* tp;
+  unsigned long long horizon, n;
+  graph_guid guid;
+  char path[1024], tmp_path[1024];
+  FILE* fp;
+  int err;
+
+  if (ih == NULL) return 0;
+
+  if ((err = islink_file_path(g, "", path, sizeof path)) != 0 ||
+      (err = islink_file_path(g, ".tmp", tmp_path, sizeof tmp_path)) != 0)
+    return err == GRAPHD_ERR_NO ? 0 : err;
+
+  /*  Nothing worth saving?  Make sure we don't load an
+   *  older version next time.
+   */
+  if (cm_hashnelems(&ih->ih_group) == 0) {
+    if (unlink(path) != 0 && errno != ENOENT) {
+      err = errno;
+      cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "unlink", err, "path=%s", path);
+      return err;
+    }
+    return 0;
+  }
+
+  horizon = pdb_primitive_n(g->g_pdb);
+  memset(&guid, 0, sizeof guid);
+  if (horizon > 0 && (err = pdb_id_to_guid(g->g_pdb, horizon - 1, &guid)) != 0)
+    return err;
+
+  if ((fp = fopen(tmp_path, "w")) == NULL) {
+    err = errno;
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "fopen", err, "path=%s", tmp_path);
+    return err;
+  }
+
+  islink_file_put(fp, GRAPHD_ISLINK_FILE_MAGIC);
+  islink_file_put(fp, pdb_database_id(g->g_pdb));
+  islink_file_put(fp, horizon);
+  islink_file_put(fp, guid.guid_a);
+  islink_file_put(fp, guid.guid_b);
+
+  islink_file_put(fp, cm_hashnelems(&ih->ih_group));
+  group = NULL;
+  while ((group = cm_hnext(&ih->ih_group, graphd_islink_group, group)) !=
+         NULL) {
+    graphd_islink_key key;
+
+    memcpy(&key, cm_hmem(&ih->ih_group, graphd_islink_group, group),
+           sizeof key);
+    islink_file_put(fp, key.key_result_linkage);
+    islink_file_put(fp, key.key_type_id);
+    islink_file_put(fp, key.key_endpoint_id);
+    islink_file_put_idset(fp, group->group_idset);
+  }
+
+  n = 0;
+  tp = NULL;
+  while ((tp = cm_hnext(&ih->ih_type, graphd_islink_type, tp)) != NULL)
+    n += tp->tp_initialized &&
+         graphd_islink_type_job_lookup(g, graphd_islink_type_id(g, tp)) == NULL;
+
+  islink_file_put(fp, n);
+  tp = NULL;
+  while ((tp = cm_hnext(&ih->ih_type, graphd_islink_type, tp)) != NULL) {
+    pdb_id type_id = graphd_islink_type_id(g, tp);
+
+    if (!tp->tp_initialized || graphd_islink_type_job_lookup(g, type_id))
+      continue;
+
+    islink_file_put(fp, type_id);
+    islink_file_put(fp, tp->tp_n);
+    islink_file_put_side(g, fp, tp->tp_side + GRAPHD_ISLINK_RIGHT);
+    islink_file_put_side(g, fp, tp->tp_side + GRAPHD_ISLINK_LEFT);
+  }
+
+  if (fflush(fp) != 0 || ferror(fp) || fsync(fileno(fp)) != 0) {
+    err = errno ? errno : EIO;
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "fflush", err, "path=%s", tmp_path);
+    (void)fclose(fp);
+    (void)unlink(tmp_path);
+    return err;
+  }
+  if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+    err = errno;
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "rename", err, "%s -> %s", tmp_path,
+                 path);
+    (void)unlink(tmp_path);
+    return err;
+  }
+
+  cl_log(g->g_cl, CL_LEVEL_INFO,
+         "graphd_islink_save: saved %zu groups, %llu types up to %llx to %s",
+         cm_hashnelems(&ih->ih_group), n, horizon, path);
+  return 0;
+}
+
+/*  Read the side of a type.  Sets that belong to a group
+ *  are shared with the group, which must already have been loaded.
+ */
+static int islink_file_get_side(graphd_handle* g, FILE* fp,
+                                graphd_islink_side* side, int linkage,
+                                pdb_id type_id) {
+  unsigned long long flags, n, id, count;
+  int other_linkage =
+      linkage == PDB_LINKAGE_RIGHT ? PDB_LINKAGE_LEFT : PDB_LINKAGE_RIGHT;
+  graphd_islink_key key;
+  graph_idset* idset;
+  int err;
+
+  if ((err = islink_file_get(fp, &flags)) != 0) return err;
+  if (flags & GRAPHD_ISLINK_SIDE_VAST) {
+    side->side_vast = true;
+    return 0;
+  }
+
+  if ((err = graphd_islink_side_initialize(g, side)) != 0) return err;
+
+  if ((err = islink_file_get_idset(g, fp, &idset)) != 0) return err;
+  if (flags & GRAPHD_ISLINK_SIDE_GROUP) {
+    graph_idset_free(idset);
+    graphd_islink_key_make(g, linkage, type_id, PDB_ID_NONE, &key);
+    if ((idset = graphd_islink_group_idset(g, &key)) == NULL)
+      return GRAPHD_ERR_LEXICAL;
+
+    graph_idset_link(idset);
+    side->side_group = true;
+  }
+  graph_idset_free(side->side_idset);
+  side->side_idset = idset;
+
+  if ((err = islink_file_get(fp, &n)) != 0) return err;
+  while (n-- > 0) {
+    graphd_islink_side_count* sc;
+
+    if ((err = islink_file_get(fp, &id)) != 0 ||
+        (err = islink_file_get(fp, &count)) != 0 ||
+        (err = islink_file_get(fp, &flags)) != 0)
+      return err;
+
+    sc = cm_hnew(&side->side_count, graphd_islink_side_count, &id, sizeof id);
+    if (sc == NULL) return errno ? errno : ENOMEM;
+
+    sc->sc_count = count;
+    if (flags & GRAPHD_ISLINK_SC_IDSET) {
+      graphd_islink_key_make(g, other_linkage, type_id, id, &key);
+      if ((sc->sc_idset = graphd_islink_group_idset(g, &key)) != NULL)
+        graph_idset_link(sc->sc_idset);
+    }
+  }
+  return 0;
+}
+
+static int islink_file_get_all(graphd_handle* g, FILE* fp,
+                               unsigned long long* horizon_out) {
+  graphd_islink_handle* ih = g->g_islink;
+  unsigned long long u, n, horizon;
+  graph_guid guid, file_guid;
+  int err;
+
+  if ((err = islink_file_get(fp, &u)) != 0) return err;
+  if (u != GRAPHD_ISLINK_FILE_MAGIC) return GRAPHD_ERR_LEXICAL;
+
+  /*  Is this our database, and do we still have everything
+   *  that the cache was made from?
+   */
+  if ((err = islink_file_get(fp, &u)) != 0 ||
+      (err = islink_file_get(fp, &horizon)) != 0 ||
+      (err = islink_file_get(fp, &file_guid.guid_a)) != 0 ||
+      (err = islink_file_get(fp, &file_guid.guid_b)) != 0)
+    return err;
+
+  if (u != pdb_database_id(g->g_pdb) || horizon > pdb_primitive_n(g->g_pdb))
+    return GRAPHD_ERR_NO;
+  memset(&guid, 0, sizeof guid);
+  if (horizon > 0 && (err = pdb_id_to_guid(g->g_pdb, horizon - 1, &guid)) != 0)
+    return err;
+  if (!GRAPH_GUID_EQ(guid, file_guid)) return GRAPHD_ERR_NO;
+
+  if ((err = islink_file_get(fp, &n)) != 0) return err;
+  while (n-- > 0) {
+    unsigned long long linkage, type_id, endpoint_id;
+    graphd_islink_key key;
+    graph_idset* idset;
+
+    if ((err = islink_file_get(fp, &linkage)) != 0 ||
+        (err = islink_file_get(fp, &type_id)) != 0 ||
+        (err = islink_file_get(fp, &endpoint_id)) != 0)
+      return err;
+
+    if ((linkage != PDB_LINKAGE_RIGHT && linkage != PDB_LINKAGE_LEFT) ||
+        type_id == PDB_ID_NONE)
+      return GRAPHD_ERR_LEXICAL;
+
+    if ((err = islink_file_get_idset(g, fp, &idset)) != 0) return err;
+
+    err = graphd_islink_group_create(
+        g, graphd_islink_key_make(g, linkage, type_id, endpoint_id, &key),
+        idset);
+    graph_idset_free(idset);
+    if (err != 0) return err;
+  }
+
+  if ((err = islink_file_get(fp, &n)) != 0) return err;
+  while (n-- > 0) {
+    graphd_islink_type* tp;
+    pdb_id type_id;
+
+    if ((err = islink_file_get(fp, &u)) != 0) return err;
+    type_id = u;
+
+    tp = cm_hnew(&ih->ih_type, graphd_islink_type, &type_id, sizeof type_id);
+    if (tp == NULL) return errno ? errno : ENOMEM;
+    if (tp->tp_initialized) return GRAPHD_ERR_LEXICAL;
+
+    /*  Mark as initialized right away, so that a partially
+     *  read type is freed along with the rest.
+     */
+    tp->tp_initialized = true;
+    if ((err = islink_file_get(fp, &tp->tp_n)) != 0 ||
+        (err = islink_file_get_side(g, fp, tp->tp_side + GRAPHD_ISLINK_RIGHT,
+                                    PDB_LINKAGE_RIGHT, type_id)) != 0 ||
+        (err = islink_file_get_side(g, fp, tp->tp_side + GRAPHD_ISLINK_LEFT,
+                                    PDB_LINKAGE_LEFT, type_id)) != 0)
+      return err;
+  }
+
+  *horizon_out = horizon;
+  return 0;
+}
+
+/*  Add the instances of <type_id> at or above <horizon>
+ *  to the groups they belong to.
+ */
+static int islink_file_catch_up(graphd_handle* g, pdb_id type_id,
+                                unsigned long long horizon) {
+  pdb_handle* pdb = g->g_pdb;
+  pdb_iterator* it;
+  pdb_budget budget;
+  pdb_id id;
+  int err;
+
+  err = pdb_linkage_id_iterator(pdb, PDB_LINKAGE_TYPEGUID, type_id, horizon,
+                                PDB_ITERATOR_HIGH_ANY,
+                                /* forward */ true,
+                                /* error-if-null */ true, &it);
+  if (err != 0) return err == PDB_ERR_NO ? 0 : err;
+
+  for (;;) {
+    pdb_primitive pr;
+
+    budget = 999999;
+    if ((err = pdb_iterator_next(pdb, it, &id, &budget)) != 0) break;
+
+    if ((err = pdb_id_read(pdb, id, &pr)) != 0) break;
+    err = graphd_islink_primitive_add(g, id, &pr);
+    pdb_primitive_finish(pdb, &pr);
+    if (err != 0) break;
+  }
+  pdb_iterator_destroy(pdb, &it);
+
+  return err == PDB_ERR_NO ? 0 : err;
+}
+
+/**
+ * @brief Load the islink cache saved by graphd_islink_save().
+ *
+ *  Called at startup, after graphd_islink_initialize().
+ *  A missing, stale, or broken file just leaves the cache empty.
+ *
+ * @param g	graphd handle
+ *
+ * @return 0 on success, a nonzero error code on unexpected error.
+ */
+int graphd_islink_load(graphd_handle* g) {
+  graphd_islink_handle* ih = g->g_islink;
+  graphd_islink_group const* group;
+  unsigned long long horizon = 0;
+  cm_hashtable done;
+  char path[1024];
+  FILE* fp;
+  int err;
+
+  if (ih == NULL) return 0;
+
+  if ((err = islink_file_path(g, "", path, sizeof path)) != 0)
+    return err == GRAPHD_ERR_NO ? 0 : err;
+
+  if ((fp = fopen(path, "r")) == NULL) {
+    if (errno == ENOENT) return 0;
+    err = errno;
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "fopen", err, "path=%s", path);
+    return 0;
+  }
+  err = islink_file_get_all(g, fp, &horizon);
+  (void)fclose(fp);
+
+  if (err != 0) {
+    cl_log(g->g_cl, CL_LEVEL_INFO,
+           "graphd_islink_load: ignoring %s: %s", path,
+           err == GRAPHD_ERR_NO ? "doesn't match the database"
+                                : graphd_strerror(err));
+    return graphd_islink_truncate(g);
+  }
+  if (cm_hashnelems(&ih->ih_group) == 0) return 0;
+
+  /*  Add what was written after the cache was saved,
+   *  type by type, and keep it current from here on.
+   */
+  err = cm_hashinit(g->g_cm, &done, sizeof(char), 100);
+  if (err != 0) return err;
+
+  group = NULL;
+  while ((group = cm_hnext(&ih->ih_group, graphd_islink_group, group)) !=
+         NULL) {
+    graphd_islink_key key;
+    char* seen;
+
+    memcpy(&key, cm_hmem(&ih->ih_group, graphd_islink_group, group),
+           sizeof key);
+    seen = cm_hnew(&done, char, &key.key_type_id, sizeof key.key_type_id);
+    if (seen == NULL) {
+      err = errno ? errno : ENOMEM;
+      break;
+    }
+    if (*seen) continue;
+    *seen = 1;
+
+    if ((err = islink_file_catch_up(g, key.key_type_id, horizon)) != 0) break;
+  }
+  cm_hashfinish(&done);
+
+  if (err == 0) err = graphd_islink_subscribe(g);
+  if (err != 0) {
+    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "islink_file_catch_up", err,
+                 "can't update the islink cache from %llx; starting over",
+                 horizon);
+    return graphd_islink_truncate(g);
+  }
+
+  cl_log(g->g_cl, CL_LEVEL_INFO,
+         "graphd_islink_load: loaded %zu groups, %zu types from %s "
+         "(horizon %llx)",
+         cm_hashnelems(&ih->ih_group), cm_hashnelems(&ih->ih_type), path,
+         horizon);
+  return 0;
+}
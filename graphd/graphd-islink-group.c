@@ -287,6 +287,13 @@ int graphd_islink_group_job_make(graphd_handle* g, int result_linkage,
                                  pdb_id type_id, pdb_id endpoint_id) {
   graphd_islink_job* job;
   graphd_islink_key key;
+  int err;
+
+  /*  Once the group exists, new primitives must be added
+   *  to it as they are written.
+   */
+  err = graphd_islink_subscribe(g);
+  if (err != 0) return err;
 
   /*  Create a job for constructing just
    *  this specific group.
@@ -100,6 +100,14 @@ int graphd_islink_intersect_make(graphd_handle* g, graphd_islink_group* g1,
     g2 = g_tmp;
   }
 
+  /*  Most pairs of groups have nothing in common.  With
+   *  roaring sets, we can find that out a chunk at a time
+   *  rather than by walking the smaller group.
+   */
+  if (ii == NULL && g->g_idset_roaring &&
+      graph_idset_intersect_count(g1->group_idset, g2->group_idset) == 0)
+    return 0;
+
   for (n_intersect = 0, graph_idset_next_reset(g1->group_idset, &pos);
        graph_idset_next(g1->group_idset, &id, &pos); n_intersect++) {
     bool both = graph_idset_check(g2->group_idset, id);
@@ -190,7 +198,7 @@ int graphd_islink_intersect_add(graphd_handle* g, graphd_islink_intersect* ii,
   if (*set == NULL) {
     /* With an idset with a single element.
      */
-    *set = graph_idset_tile_create(g->g_graph);
+    *set = graphd_idset_create(g);
     if (*set == NULL) {
       graphd_islink_panic(g);
       return errno ? errno : ENOMEM;
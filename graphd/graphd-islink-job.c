@@ -72,7 +72,7 @@ graphd_islink_job *graphd_islink_job_alloc(graphd_handle *g,
   /*  Create an idset to collect the results in.
    */
   if (job->job_idset == NULL) {
-    job->job_idset = graph_idset_tile_create(g->g_graph);
+    job->job_idset = graphd_idset_create(g);
     if (job->job_idset == NULL) {
       cm_hdelete(&ih->ih_job, graphd_islink_job, job);
       return NULL;
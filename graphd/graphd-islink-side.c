@@ -40,11 +40,11 @@ void graphd_islink_side_finish(graphd_handle* g, graphd_islink_side* side,
 int graphd_islink_side_initialize(graphd_handle* g, graphd_islink_side* side) {
   int err;
 
-  side->side_idset = graph_idset_tile_create(g->g_graph);
+  side->side_idset = graphd_idset_create(g);
   if (side->side_idset == NULL) {
     err = errno ? errno : ENOMEM;
-    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graph_idset_tile_create", errno,
-                 "failed to allocate tile set");
+    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graphd_idset_create", errno,
+                 "failed to allocate idset");
     return err;
   }
 
@@ -131,13 +131,13 @@ static int islink_group_initialize(graphd_handle* g, pdb_id type_id,
 
   /* Create an empty set.
    */
-  idset = graph_idset_tile_create(g->g_graph);
+  idset = graphd_idset_create(g);
   if (idset == NULL) {
     err = errno ? errno : ENOMEM;
     pdb_iterator_destroy(pdb, &vip_it);
 
-    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graph_idset_tile_create", errno,
-                 "failed to allocate tile set");
+    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graphd_idset_create", errno,
+                 "failed to allocate idset");
     return err;
   }
 
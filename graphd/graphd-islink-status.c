@@ -55,7 +55,10 @@ static int graphd_islink_status_key(graphd_request* greq, graphd_value* val,
  *  group: (
  *		key
  *		null/nelems
+ *		null/bytes
  *	)
+ *
+ *  The size in bytes is only known for roaring idsets.
  */
 static int graphd_islink_status_group(graphd_request* greq, graphd_value* val,
                                       graphd_islink_group const* group) {
@@ -65,9 +68,10 @@ static int graphd_islink_status_group(graphd_request* greq, graphd_value* val,
   graphd_islink_handle* ih = g->g_islink;
 
   graphd_islink_key key;
+  size_t bytes;
   int err;
 
-  if ((err = graphd_value_list_alloc(g, cm, cl, val, 2)) != 0) return err;
+  if ((err = graphd_value_list_alloc(g, cm, cl, val, 3)) != 0) return err;
 
   memcpy(&key, cm_hmem(&ih->ih_group, graphd_islink_group, group), sizeof key);
   err = graphd_islink_status_key(greq, val->val_list_contents, &key);
@@ -78,6 +82,12 @@ static int graphd_islink_status_group(graphd_request* greq, graphd_value* val,
   else
     graphd_value_number_set(val->val_list_contents + 1,
                             group->group_idset->gi_n);
+
+  if (group->group_idset == NULL ||
+      (bytes = graph_idset_roaring_memory(group->group_idset)) == 0)
+    graphd_value_null_set(val->val_list_contents + 2);
+  else
+    graphd_value_number_set(val->val_list_contents + 2, bytes);
   return 0;
 }
 
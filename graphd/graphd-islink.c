@@ -35,26 +35,15 @@ typedef struct graphd_islink_context {
 
 } graphd_islink_context;
 
-/*  Given a new primitive, update any cache that fits it.
+/*  Given a new primitive, update any group that it belongs to.
  */
-static int islink_primitive_callback(void *data, pdb_handle *pdb, pdb_id id,
-                                     pdb_primitive const *pr) {
-  graphd_handle *g = data;
+int graphd_islink_primitive_add(graphd_handle *g, pdb_id id,
+                                pdb_primitive const *pr) {
+  pdb_handle *pdb = g->g_pdb;
   graph_guid r_guid, l_guid, t_guid;
   pdb_id r_id, l_id, t_id;
   int err;
 
-  if (id == PDB_ID_NONE) {
-    /*  Truncate the cache - we're emptying out our database.
-     */
-    err = graphd_islink_truncate(g);
-    if (err != 0)
-      cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graphd_islink_truncate", err,
-                   "can't reallocate islink database "
-                   "after truncate?");
-    return err;
-  }
-
   /*  Ignore additions that aren't typed links;
    *  also ignore things if islink isn't on.
    */
@@ -100,13 +89,34 @@ static int islink_primitive_callback(void *data, pdb_handle *pdb, pdb_id id,
     if (err != 0) return err;
   }
   if (l_id != PDB_ID_NONE) {
-    err = graphd_islink_group_update(g, l_id, PDB_LINKAGE_LEFT, t_id, r_id);
+    err = graphd_islink_group_update(g, l_id, PDB_LINKAGE_LEFT, t_id,
+                                     PDB_ID_NONE);
     if (err != 0) return err;
   }
 
   return 0;
 }
 
+/*  Given a new primitive, update any cache that fits it.
+ */
+static int islink_primitive_callback(void *data, pdb_handle *pdb, pdb_id id,
+                                     pdb_primitive const *pr) {
+  graphd_handle *g = data;
+  int err;
+
+  if (id == PDB_ID_NONE) {
+    /*  Truncate the cache - we're emptying out our database.
+     */
+    err = graphd_islink_truncate(g);
+    if (err != 0)
+      cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graphd_islink_truncate", err,
+                   "can't reallocate islink database "
+                   "after truncate?");
+    return err;
+  }
+  return graphd_islink_primitive_add(g, id, pr);
+}
+
 /*  Add a subscription.
  */
 int graphd_islink_subscribe(graphd_handle *g) {
@@ -210,6 +210,8 @@ typedef struct {
 /* graphd-islink.c */
 
 int graphd_islink_subscribe(graphd_handle *);
+int graphd_islink_primitive_add(graphd_handle *_g, pdb_id _id,
+                                pdb_primitive const *_pr);
 void graphd_islink_panic(graphd_handle *);
 
 /* graphd-islink-group.c */
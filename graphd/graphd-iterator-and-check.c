@@ -181,33 +181,61 @@ err:
   return err;
 }
 
+/*  A subcondition's check cost and chance of passing a check:
+ *  as observed while running, once that has strayed far enough
+ *  from the estimates (see graphd_iterator_and_check_observe()),
+ *  otherwise as estimated by the subiterator's statistics.
+ */
+static bool and_sc_check_cost_valid(pdb_handle *pdb,
+                                    graphd_subcondition const *sc) {
+  return sc->sc_run_observed || pdb_iterator_check_cost_valid(pdb, sc->sc_it);
+}
+
+static bool and_sc_n_valid(pdb_handle *pdb, graphd_subcondition const *sc) {
+  return sc->sc_run_observed || pdb_iterator_n_valid(pdb, sc->sc_it);
+}
+
+static double and_sc_check_cost(pdb_handle *pdb,
+                                graphd_subcondition const *sc) {
+  if (sc->sc_run_observed)
+    return (double)sc->sc_run_account.ia_check_cost /
+           sc->sc_run_account.ia_check_n;
+  return pdb_iterator_check_cost(pdb, sc->sc_it);
+}
+
+static double and_sc_check_chance(pdb_handle *pdb, unsigned long long range_n,
+                                  graphd_subcondition const *sc) {
+  if (sc->sc_run_observed)
+    return (double)sc->sc_run_check_yes_n / sc->sc_run_account.ia_check_n;
+  return (double)pdb_iterator_n(pdb, sc->sc_it) / (range_n ? range_n : 1);
+}
+
 static int and_compare_costs(pdb_handle *pdb, unsigned long long range_n,
-                             pdb_iterator *a, pdb_iterator *b) {
+                             graphd_subcondition const *a,
+                             graphd_subcondition const *b) {
   double cost_a, cost_b;
   cl_handle *cl = pdb_log(pdb);
 
   /*  If we don't have both Ns, but we do have both check-costs,
    *  just prefer the lower check-cost.
    */
-  if ((!pdb_iterator_n_valid(pdb, a) || !pdb_iterator_n_valid(pdb, b)) &&
-      pdb_iterator_check_cost_valid(pdb, a) &&
-      pdb_iterator_check_cost_valid(pdb, b)) {
+  if ((!and_sc_n_valid(pdb, a) || !and_sc_n_valid(pdb, b)) &&
+      and_sc_check_cost_valid(pdb, a) && and_sc_check_cost_valid(pdb, b)) {
     cl_log(cl, CL_LEVEL_VERBOSE,
            "and_compare_costs: don't have both "
            "N - prefer the smaller check-cost");
 
-    return pdb_iterator_check_cost(pdb, a) < pdb_iterator_check_cost(pdb, b)
-               ? -1
-               : pdb_iterator_check_cost(pdb, a) >
-                     pdb_iterator_check_cost(pdb, b);
+    cost_a = and_sc_check_cost(pdb, a);
+    cost_b = and_sc_check_cost(pdb, b);
+    return cost_a < cost_b ? -1 : cost_a > cost_b;
   }
 
   /*  If any of a and b haven't even finished their
    *  statistics computation by now,
    *  they're expensive and move to the end.
    */
-  if (!pdb_iterator_check_cost_valid(pdb, a) || !pdb_iterator_n_valid(pdb, a)) {
-    if (pdb_iterator_check_cost_valid(pdb, b) && pdb_iterator_n_valid(pdb, b)) {
+  if (!and_sc_check_cost_valid(pdb, a) || !and_sc_n_valid(pdb, a)) {
+    if (and_sc_check_cost_valid(pdb, b) && and_sc_n_valid(pdb, b)) {
       cl_log(cl, CL_LEVEL_VERBOSE,
              "and_compare_costs: a is invalid, "
              "b is valid -> 1.");
@@ -217,8 +245,7 @@ static int and_compare_costs(pdb_handle *pdb, unsigned long long range_n,
     cl_log(cl, CL_LEVEL_VERBOSE,
            "and_compare_costs: both are invalid "
            "-> sorted");
-  } else if (!pdb_iterator_check_cost_valid(pdb, b) ||
-             !pdb_iterator_n_valid(pdb, b)) {
+  } else if (!and_sc_check_cost_valid(pdb, b) || !and_sc_n_valid(pdb, b)) {
     cl_log(cl, CL_LEVEL_VERBOSE,
            "and_compare_costs: a is valid, "
            "b is invalid -> -1.");
@@ -240,31 +267,26 @@ static int and_compare_costs(pdb_handle *pdb, unsigned long long range_n,
      */
     char buf_a[200], buf_b[200];
     double check_chance_a, check_chance_b;
-    unsigned long long total_n;
-
-    total_n = range_n;
-    if (total_n == 0) total_n = 1;
-
-    check_chance_a = (double)pdb_iterator_n(pdb, a) / total_n;
-    check_chance_b = (double)pdb_iterator_n(pdb, b) / total_n;
+    double check_cost_a, check_cost_b;
 
-    cost_a = pdb_iterator_check_cost(pdb, a) +
-             check_chance_a * pdb_iterator_check_cost(pdb, b);
+    check_chance_a = and_sc_check_chance(pdb, range_n, a);
+    check_chance_b = and_sc_check_chance(pdb, range_n, b);
+    check_cost_a = and_sc_check_cost(pdb, a);
+    check_cost_b = and_sc_check_cost(pdb, b);
 
-    cost_b = pdb_iterator_check_cost(pdb, b) +
-             check_chance_b * pdb_iterator_check_cost(pdb, a);
+    cost_a = check_cost_a + check_chance_a * check_cost_b;
+    cost_b = check_cost_b + check_chance_b * check_cost_a;
 
     cl_log(cl, CL_LEVEL_VERBOSE,
            "and_compare_costs: "
-           "%s: Aco:%lld + Ach:%g * Bco:%lld = %.3lf,"
-           " %s: Bco:%lld + Bch:%g * Aco:%lld = %.3lf",
+           "%s: Aco:%.1f + Ach:%g * Bco:%.1f = %.3lf,"
+           " %s: Bco:%.1f + Bch:%g * Aco:%.1f = %.3lf%s",
 
-           pdb_iterator_to_string(pdb, a, buf_a, sizeof buf_a),
-           (long long)pdb_iterator_check_cost(pdb, a), check_chance_a,
-           (long long)pdb_iterator_check_cost(pdb, b), cost_a,
-           pdb_iterator_to_string(pdb, b, buf_b, sizeof buf_b),
-           (long long)pdb_iterator_check_cost(pdb, b), check_chance_b,
-           (long long)pdb_iterator_check_cost(pdb, a), cost_b);
+           pdb_iterator_to_string(pdb, a->sc_it, buf_a, sizeof buf_a),
+           check_cost_a, check_chance_a, check_cost_b, cost_a,
+           pdb_iterator_to_string(pdb, b->sc_it, buf_b, sizeof buf_b),
+           check_cost_b, check_chance_b, check_cost_a, cost_b,
+           a->sc_run_observed || b->sc_run_observed ? " (observed)" : "");
 
     if (cost_a < cost_b) return -1;
 
@@ -273,8 +295,9 @@ static int and_compare_costs(pdb_handle *pdb, unsigned long long range_n,
 
   /* Among two equally expensive, the sorted is cheaper.
    */
-  if (!pdb_iterator_sorted(pdb, a) != !pdb_iterator_sorted(pdb, b))
-    return pdb_iterator_sorted(pdb, a) ? -1 : 1;
+  if (!pdb_iterator_sorted(pdb, a->sc_it) !=
+      !pdb_iterator_sorted(pdb, b->sc_it))
+    return pdb_iterator_sorted(pdb, a->sc_it) ? -1 : 1;
   return 0;
 }
 
@@ -342,8 +365,8 @@ int graphd_iterator_and_check_sort(pdb_iterator *it) {
     size_t j, tmp;
     char buf[200];
 
-    if (and_compare_costs(pdb, range_n, ogia->gia_sc[ord[i]].sc_it,
-                          ogia->gia_sc[ord[i + 1]].sc_it) <= 0)
+    if (and_compare_costs(pdb, range_n, ogia->gia_sc + ord[i],
+                          ogia->gia_sc + ord[i + 1]) <= 0)
 
       continue;
 
@@ -358,8 +381,8 @@ int graphd_iterator_and_check_sort(pdb_iterator *it) {
      *  i -- bubble it up until it's in the right place.
      */
     for (j = i; j > 0; j--) {
-      if (and_compare_costs(pdb, range_n, ogia->gia_sc[ord[j - 1]].sc_it,
-                            ogia->gia_sc[ord[j]].sc_it) <= 0)
+      if (and_compare_costs(pdb, range_n, ogia->gia_sc + ord[j - 1],
+                            ogia->gia_sc + ord[j]) <= 0)
         break;
 
       tmp = ord[j - 1];
@@ -465,6 +488,80 @@ int graphd_iterator_and_check_sort_refresh(pdb_iterator *it,
   return 0;
 }
 
+/*  Are two positive estimates of the same thing more than
+ *  GRAPHD_AND_REPLAN_FACTOR apart?
+ */
+static bool and_diverged(double a, double b) {
+  return a > b * GRAPHD_AND_REPLAN_FACTOR || b > a * GRAPHD_AND_REPLAN_FACTOR;
+}
+
+/**
+ * @brief Compare observed check costs against the estimates.
+ *
+ *  Called by graphd_iterator_and_run() every
+ *  GRAPHD_AND_REPLAN_INTERVAL candidates.  Once a subcondition's
+ *  observed check cost or pass rate strays from its estimate by
+ *  more than GRAPHD_AND_REPLAN_FACTOR, the check order sorts it
+ *  by what we've seen instead.  The process states pick up a new
+ *  order in graphd_iterator_and_check_sort_refresh(), between
+ *  candidates.
+ *
+ * @param it	AND iterator
+ *
+ * @return 0 normally
+ * @return ENOMEM on allocation error.
+ */
+int graphd_iterator_and_check_observe(pdb_iterator *it) {
+  graphd_iterator_and *ogia = ogia(it);
+  pdb_handle *pdb = ogia->gia_pdb;
+  unsigned long long const range_n = pdb_iterator_spread(pdb, it);
+  bool any = false;
+  size_t i;
+
+  for (i = 0; i < ogia->gia_n; i++) {
+    graphd_subcondition *sc = ogia->gia_sc + i;
+    pdb_iterator_account const *acc = &sc->sc_run_account;
+    double floor, obs_cost, est_cost, obs_chance, est_chance;
+    char buf[200];
+
+    if (sc->sc_run_observed) {
+      any = true;
+      continue;
+    }
+    if (acc->ia_check_n < GRAPHD_AND_REPLAN_MIN_SAMPLES ||
+        !pdb_iterator_check_cost_valid(pdb, sc->sc_it) ||
+        !pdb_iterator_n_valid(pdb, sc->sc_it))
+      continue;
+
+    /*  Below $1 per check, or one pass per sample size,
+     *  we can't tell the difference.
+     */
+    floor = 1.0 / acc->ia_check_n;
+    obs_cost = (double)acc->ia_check_cost / acc->ia_check_n;
+    est_cost = pdb_iterator_check_cost(pdb, sc->sc_it);
+    obs_chance = (double)sc->sc_run_check_yes_n / acc->ia_check_n;
+    est_chance = and_sc_check_chance(pdb, range_n, sc);
+    if (est_chance > 1) est_chance = 1;
+
+    if (!and_diverged(obs_cost < 1 ? 1 : obs_cost,
+                      est_cost < 1 ? 1 : est_cost) &&
+        !and_diverged(obs_chance < floor ? floor : obs_chance,
+                      est_chance < floor ? floor : est_chance))
+      continue;
+
+    cl_log(ogia->gia_cl, CL_LEVEL_DEBUG,
+           "graphd_iterator_and_check_observe: %s: check cost %.1f "
+           "(estimated %.1f), pass rate %.4f (estimated %.4f) over %llu "
+           "checks; sorting by observation",
+           pdb_iterator_to_string(pdb, sc->sc_it, buf, sizeof buf), obs_cost,
+           est_cost, obs_chance, est_chance, acc->ia_check_n);
+
+    sc->sc_run_observed = true;
+    any = true;
+  }
+  return any ? graphd_iterator_and_check_sort(it) : 0;
+}
+
 /*  Set up a slow check() call.
  *
  *  Executed once at the beginning of a check() method
@@ -647,6 +744,17 @@ static int and_iterator_slow_check(pdb_handle *pdb, pdb_iterator *it, pdb_id id,
   return PDB_ERR_MORE;
 }
 
+/*  If checking costs about the same as finding, we find
+ *  instead of checking, and remember what we skipped.
+ */
+static bool and_check_prefers_find(pdb_handle *pdb, pdb_iterator *sub_it) {
+  return pdb_iterator_check_cost_valid(pdb, sub_it) &&
+         pdb_iterator_find_cost_valid(pdb, sub_it) &&
+         pdb_iterator_sorted(pdb, sub_it) &&
+         2 + pdb_iterator_check_cost(pdb, sub_it) >=
+             pdb_iterator_find_cost(pdb, sub_it);
+}
+
 /**
  * @brief Check an ID against a list of subconstraints (iterator method)
  *
@@ -818,11 +926,7 @@ int graphd_iterator_and_check(pdb_handle *const pdb, pdb_iterator *const it,
          *  upper boundary found in the exclude range cache.
          */
 
-        if (pdb_iterator_check_cost_valid(pdb, sub_it) &&
-            pdb_iterator_find_cost_valid(pdb, sub_it) &&
-            pdb_iterator_sorted(pdb, sub_it) &&
-            2 + pdb_iterator_check_cost(pdb, sub_it) >=
-                pdb_iterator_find_cost(pdb, sub_it)) {
+        if (and_check_prefers_find(pdb, sub_it)) {
           err = pdb_iterator_find(pdb, sub_it, id, &ps->ps_id, budget_inout);
           if (err == 0 && ps->ps_id != id) {
             err = GRAPHD_ERR_NO;
@@ -882,6 +986,211 @@ redirect:
   return pdb_iterator_check(pdb, it, id, budget_inout);
 }
 
+/*  The batched counterpart of checking with a find: walk a
+ *  forward subiterator through ascending ids, one find per id
+ *  that the previous find didn't skip past.
+ *
+ *  Like the rest of the batch, this runs to the end, even if
+ *  that overruns the budget.
+ */
+static int and_check_batch_find(pdb_handle *pdb, pdb_iterator *sub_it,
+                                pdb_id const *id_in, size_t n_in,
+                                size_t *n_in_done, pdb_id *id_out,
+                                size_t *n_out, pdb_budget *budget_inout) {
+  pdb_id found = PDB_ID_NONE;
+  size_t i;
+  int err;
+
+  *n_out = 0;
+  for (i = 0; i < n_in; i++) {
+    if (found == PDB_ID_NONE || found < id_in[i]) {
+      pdb_iterator_call_reset(pdb, sub_it);
+      do
+        err = pdb_iterator_find(pdb, sub_it, id_in[i], &found, budget_inout);
+      while (err == PDB_ERR_MORE);
+
+      if (err == GRAPHD_ERR_NO) break;
+      if (err != 0) {
+        *n_in_done = i;
+        return err;
+      }
+    }
+    if (found == id_in[i]) id_out[(*n_out)++] = id_in[i];
+  }
+  *n_in_done = n_in;
+  return 0;
+}
+
+/**
+ * @brief Check an array of IDs against an "and" (iterator method)
+ *
+ *  The first id goes through graphd_iterator_and_check(), which
+ *  brings the statistics, check order and process state up to
+ *  date.  Of the rest, what the exclude range and the cache can't
+ *  decide is checked GRAPHD_AND_BATCH ids at a time: one
+ *  pdb_iterator_check_batch() per subiterator, in check order,
+ *  on the ids that passed the subiterators before it.
+ *
+ *  Subiterators that would rather find than check walk through
+ *  the ids with finds, if they and the ids go the same way;
+ *  otherwise, the ids go through graphd_iterator_and_check()
+ *  one at a time.
+ *
+ * @return 0, PDB_ERR_MORE, or another error,
+ *	as for pdb_iterator_check_batch().
+ */
+int graphd_iterator_and_check_batch(pdb_handle *const pdb,
+                                    pdb_iterator *const it,
+                                    pdb_id const *id_in, size_t n_in,
+                                    size_t *n_in_done, pdb_id *id_out,
+                                    size_t *n_out,
+                                    pdb_budget *const budget_inout) {
+  graphd_iterator_and *gia = it->it_theory;
+  and_process_state *ps;
+  cl_handle *cl = gia->gia_cl;
+  pdb_budget budget_in;
+  pdb_id pending[GRAPHD_AND_BATCH], passed[GRAPHD_AND_BATCH];
+  unsigned char pending_i[GRAPHD_AND_BATCH];
+  bool yes[GRAPHD_AND_BATCH];
+  size_t i, j, k, c, n, n_done, pending_n, passed_n, sub_done, decided_n;
+  pdb_iterator *sub_it;
+  bool ascending;
+  int err;
+
+  if (n_in < 2 || it->it_call_state != 0)
+    return pdb_iterator_check_batch_loop(pdb, it, graphd_iterator_and_check,
+                                         id_in, n_in, n_in_done, id_out, n_out,
+                                         budget_inout);
+
+  *n_out = *n_in_done = 0;
+  err = graphd_iterator_and_check(pdb, it, id_in[0], budget_inout);
+  if (err == 0)
+    id_out[(*n_out)++] = id_in[0];
+  else if (err != GRAPHD_ERR_NO)
+    return err;
+  *n_in_done = 1;
+
+  /*  Did the check turn us into something else, or leave
+   *  us without what a batch needs?
+   */
+  if (it->it_type != &graphd_iterator_and_type) {
+    err = pdb_iterator_check_batch(pdb, it, id_in + 1, n_in - 1, &sub_done,
+                                   id_out + *n_out, &n, budget_inout);
+    *n_in_done += sub_done;
+    *n_out += n;
+    return err;
+  }
+  gia = it->it_theory;
+  ps = &gia->gia_ps;
+
+  ascending = pdb_iterator_batch_is_ascending(id_in + 1, n_in - 1);
+  for (i = 0; i < gia->gia_n; i++)
+    if (ps->ps_it == NULL ||
+        (and_check_prefers_find(pdb, ps->ps_it[i]) &&
+         !(ascending && pdb_iterator_forward(pdb, ps->ps_it[i]))))
+      break;
+  if (!pdb_iterator_statistics_done(pdb, it) || ps->ps_it == NULL ||
+      ps->ps_check_order == NULL || i < gia->gia_n) {
+    err = pdb_iterator_check_batch_loop(
+        pdb, it, graphd_iterator_and_check, id_in + 1, n_in - 1, &sub_done,
+        id_out + *n_out, &n, budget_inout);
+    *n_in_done += sub_done;
+    *n_out += n;
+    return err;
+  }
+
+  budget_in = *budget_inout;
+  decided_n = 0;
+
+  for (i = 1; i < n_in; i += c) {
+    if (*budget_inout < 0) break;
+
+    c = n_in - i;
+    if (c > GRAPHD_AND_BATCH) c = GRAPHD_AND_BATCH;
+
+    /*  Let the exclude range and the cache decide what they can.
+     */
+    for (j = pending_n = 0; j < c; j++) {
+      pdb_id const id = id_in[i + j];
+
+      yes[j] = false;
+      if (ps->ps_check_exclude_low <= id && ps->ps_check_exclude_high > id)
+        err = GRAPHD_ERR_NO;
+      else
+        err = graphd_iterator_cache_check(pdb, it, ogia(it)->gia_cache, id);
+      if (err == PDB_ERR_MORE) {
+        pending[pending_n] = id;
+        pending_i[pending_n++] = j;
+        yes[j] = true;
+      } else {
+        *budget_inout -= PDB_COST_FUNCTION_CALL;
+        yes[j] = (err == 0);
+      }
+    }
+
+    for (ps->ps_check_i = 0; ps->ps_check_i < gia->gia_n && pending_n > 0;
+         ps->ps_check_i++) {
+      sub_it = ps->ps_it[ps->ps_check_order[ps->ps_check_i]];
+      pdb_iterator_call_reset(pdb, sub_it);
+
+      for (n_done = passed_n = 0; n_done < pending_n;) {
+        if (and_check_prefers_find(pdb, sub_it))
+          err = and_check_batch_find(pdb, sub_it, pending + n_done,
+                                     pending_n - n_done, &sub_done,
+                                     passed + passed_n, &n, budget_inout);
+        else
+          err = pdb_iterator_check_batch(pdb, sub_it, pending + n_done,
+                                         pending_n - n_done, &sub_done,
+                                         passed + passed_n, &n, budget_inout);
+        n_done += sub_done;
+        passed_n += n;
+
+        if (err != 0 && err != PDB_ERR_MORE) {
+          char buf[200];
+
+          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_check_batch", err,
+                       "it=%s",
+                       pdb_iterator_to_string(pdb, sub_it, buf, sizeof buf));
+          ps->ps_check_i = 0;
+          goto done;
+        }
+      }
+
+      /*  What didn't pass is out; the rest goes on to
+       *  the next subiterator.
+       */
+      for (j = k = 0, n = pending_n, pending_n = 0; j < n; j++) {
+        if (k < passed_n && passed[k] == pending[j]) {
+          pending[pending_n] = pending[j];
+          pending_i[pending_n++] = pending_i[j];
+          k++;
+        } else
+          yes[pending_i[j]] = false;
+      }
+    }
+    ps->ps_check_i = 0;
+
+    for (j = 0; j < c; j++)
+      if (yes[j]) id_out[(*n_out)++] = id_in[i + j];
+    decided_n += c;
+  }
+  err = i < n_in ? PDB_ERR_MORE : 0;
+
+done:
+  *n_in_done += decided_n;
+  if (it->it_original->it_type == &graphd_iterator_and_type) {
+    ogia(it)->gia_total_cost_check += budget_in - *budget_inout;
+    ogia(it)->gia_n_checked += decided_n;
+  }
+  pdb_rxs_log(pdb, "CHECK-BATCH %p and %zu of %zu, %zu passed: %s ($%lld)",
+              (void *)it, *n_in_done, n_in, *n_out,
+              err == 0 ? "ok" : graphd_strerror(err),
+              (long long)(budget_in - *budget_inout));
+  pdb_iterator_account_charge(pdb, it, check, decided_n,
+                              budget_in - *budget_inout);
+  return err;
+}
+
 /* Free "slow check" resources in an AND iterator.
  */
 void graphd_iterator_and_slow_check_finish(pdb_handle *const pdb,
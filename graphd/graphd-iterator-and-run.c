@@ -36,6 +36,271 @@ static double step_size(pdb_handle const *pdb, pdb_iterator const *it,
   return 1.0;
 }
 
+typedef enum { AND_RUN_NEXT, AND_RUN_FIND, AND_RUN_CHECK } and_run_call;
+
+/*  Charge subiterator #i's run account for a call into it that
+ *  spent <spent> and returned <err>.  Suspended calls add to the
+ *  cost; only calls that finish are counted.
+ *
+ *  The statistics contest keeps its own books; this starts
+ *  once it's over.
+ */
+static void and_run_charge(pdb_handle *pdb, pdb_iterator *it, size_t i,
+                           and_run_call call, pdb_budget spent, int err) {
+  graphd_iterator_and *ogia = ogia(it);
+  graphd_subcondition *sc;
+  unsigned int done = (err != PDB_ERR_MORE);
+
+  if (!pdb_iterator_statistics_done(pdb, it) || i >= ogia->gia_n) return;
+
+  sc = ogia->gia_sc + i;
+  switch (call) {
+    case AND_RUN_NEXT:
+      sc->sc_run_account.ia_next_cost += spent;
+      sc->sc_run_account.ia_next_n += done;
+      break;
+    case AND_RUN_FIND:
+      sc->sc_run_account.ia_find_cost += spent;
+      sc->sc_run_account.ia_find_n += done;
+      break;
+    case AND_RUN_CHECK:
+      sc->sc_run_account.ia_check_cost += spent;
+      sc->sc_run_account.ia_check_n += done;
+      if (err == 0) sc->sc_run_check_yes_n++;
+      break;
+  }
+}
+
+/*  Is it cheaper to test the candidate ps->ps_id against <c_it>
+ *  with a "find", leapfrogging producer and checker, than with
+ *  a "next" from the producer and a "check"?
+ */
+static bool and_run_checker_likes_find(pdb_handle *pdb, pdb_iterator *it,
+                                       and_process_state const *ps,
+                                       size_t producer, pdb_iterator *c_it) {
+  graphd_iterator_and *gia = it->it_theory;
+  cl_handle *cl = gia->gia_cl;
+  double find_cost_per_point, check_cost_per_point;
+  double c_step, p_step, two_find_step;
+  long long step_i_can_use;
+  long long upper_bound = pdb_primitive_n(pdb);
+  char buf[200];
+
+  if (!pdb_iterator_sorted(pdb, c_it) ||
+      !pdb_iterator_sorted(pdb, ps->ps_it[producer]) ||
+      !pdb_iterator_statistics_done(pdb, c_it))
+    return false;
+  if (pdb_iterator_n(pdb, c_it) == 0) return true;
+
+  /*  Each "find" slides us on average stepsize/2
+   *  across the iterator's numerical breadth.
+   *
+   *  So, two pairs of checker and producer finds
+   *  together get us past p_step + c_step IDs.
+   */
+  c_step = step_size(pdb, c_it, upper_bound);
+  p_step = step_size(pdb, ps->ps_it[producer], upper_bound);
+  two_find_step = c_step + p_step;
+
+  step_i_can_use =
+      (pdb_iterator_forward(pdb, it)
+           ? (it->it_high == PDB_ITERATOR_HIGH_ANY ? upper_bound
+                                                   : it->it_high) -
+                 ps->ps_id
+           : ps->ps_id - it->it_low);
+  if (step_i_can_use < 1) step_i_can_use = 0.00001;
+
+  if (c_step > step_i_can_use) c_step = step_i_can_use;
+
+  if (p_step > step_i_can_use) p_step = step_i_can_use;
+
+  if (two_find_step > step_i_can_use) two_find_step = step_i_can_use;
+
+  find_cost_per_point = ((double)(pdb_iterator_find_cost(pdb, c_it) +
+                                  pdb_iterator_find_cost(
+                                      pdb, ps->ps_it[producer])) *
+                         2.0) /
+                        two_find_step;
+
+  /*  Each "next+check" step gets us past
+   *  p_step IDs.
+   */
+  check_cost_per_point =
+      (double)(pdb_iterator_next_cost(pdb, ps->ps_it[producer]) +
+               pdb_iterator_check_cost(pdb, c_it)) /
+      p_step;
+
+  cl_log(cl, CL_LEVEL_VERBOSE,
+         "graphd_iterator_and_run: "
+         "subiterator %s: find cost %.3f, "
+         "(c.fc=%lld + p.fc=%lld)*2"
+         "/(p_step=%.3f+c_step=%.3f;step_i_can_use=%lld);"
+         "check_cost %.3f (nc=%lld + cc=%lld)/p_step=%.3f",
+         pdb_iterator_to_string(pdb, c_it, buf, sizeof buf),
+         find_cost_per_point, (long long)pdb_iterator_find_cost(pdb, c_it),
+         (long long)pdb_iterator_find_cost(pdb, ps->ps_it[producer]), p_step,
+         c_step, step_i_can_use,
+
+         check_cost_per_point,
+         (long long)pdb_iterator_next_cost(pdb, ps->ps_it[producer]),
+         (long long)pdb_iterator_check_cost(pdb, c_it), p_step);
+
+  return find_cost_per_point < check_cost_per_point;
+}
+
+/*  What would it cost per result to produce with subiterator
+ *  #producer and check the others, given <and_n> results overall?
+ *  Checkers whose costs we've watched for long enough are charged
+ *  what they actually cost.
+ */
+static double and_run_cost_per_result(pdb_handle *pdb,
+                                      graphd_iterator_and const *ogia,
+                                      and_process_state const *ps,
+                                      size_t producer, double and_n) {
+  double cost = pdb_iterator_next_cost(pdb, ps->ps_it[producer]);
+  size_t i;
+
+  for (i = 0; i < ps->ps_n && i < ogia->gia_n; i++) {
+    pdb_iterator_account const *acc = &ogia->gia_sc[i].sc_run_account;
+
+    if (i == producer) continue;
+    if (acc->ia_check_n >= GRAPHD_AND_REPLAN_MIN_SAMPLES)
+      cost += (double)acc->ia_check_cost / acc->ia_check_n;
+    else if (pdb_iterator_check_cost_valid(pdb, ps->ps_it[i]))
+      cost += pdb_iterator_check_cost(pdb, ps->ps_it[i]);
+    else
+      cost += UNKNOWN_CHECK_COST;
+  }
+  return cost * pdb_iterator_n(pdb, ps->ps_it[producer]) / and_n;
+}
+
+/*  Can subiterator #i take over producing for <ps>, resuming
+ *  after ps->ps_id with a single find?
+ */
+static bool and_run_can_take_over(pdb_handle *pdb, and_process_state const *ps,
+                                  size_t producer, size_t i) {
+  pdb_iterator *p_it = ps->ps_it[producer];
+  pdb_iterator *c_it = ps->ps_it[i];
+
+  return i != producer && pdb_iterator_statistics_done(pdb, c_it) &&
+         pdb_iterator_n_valid(pdb, c_it) && pdb_iterator_sorted(pdb, c_it) &&
+         !pdb_iterator_forward(pdb, c_it) == !pdb_iterator_forward(pdb, p_it) &&
+         pdb_iterator_find_cost(pdb, c_it) <
+             pdb_iterator_n(pdb, c_it) * pdb_iterator_next_cost(pdb, c_it);
+}
+
+/*  Is <ps> the only process state of this iterator that's
+ *  positioned on anything?  Process states index their
+ *  subiterators by the original's current producer; if we
+ *  change producers, there must not be anyone else who is
+ *  still in the middle of producing with the old one.
+ *
+ *  We know about the original, <it>, and the cache state they
+ *  share; anything beyond that is a clone we can't see.
+ */
+static bool and_run_ps_is_alone(pdb_iterator *it, and_process_state *ps) {
+  graphd_iterator_and *gia = it->it_theory;
+  graphd_iterator_and *ogia = ogia(it);
+  and_process_state const *known[3];
+  size_t i;
+
+  if (it->it_original->it_clones != (it == it->it_original ? 0 : 1))
+    return false;
+
+  known[0] = &ogia->gia_cache_ps;
+  known[1] = &ogia->gia_ps;
+  known[2] = &gia->gia_ps;
+
+  if (ps != known[0] && ps != known[1] && ps != known[2]) return false;
+  for (i = 0; i < sizeof(known) / sizeof(*known); i++)
+    if (known[i] != ps && known[i]->ps_it != NULL && !known[i]->ps_eof)
+      return false;
+  return true;
+}
+
+/*  Called between candidates, every GRAPHD_AND_REPLAN_INTERVAL
+ *  of them: is our producer costing far more than the plan said,
+ *  and would another subiterator do far better?  If yes, switch
+ *  to that, and have the new producer pick up after the last id
+ *  handled with a find.  Since both producers return ids in the
+ *  same sorted order, nothing is produced twice or skipped.
+ *
+ *  Returns true if *producer changed.
+ */
+static bool and_run_replan_producer(pdb_handle *pdb, pdb_iterator *it,
+                                    and_process_state *ps, size_t *producer) {
+  graphd_iterator_and *ogia = ogia(it);
+  double and_n, cost_now, cost_best = 0;
+  size_t i, best = *producer;
+  char buf[200];
+
+  if (ogia->gia_replan_producer_n >= GRAPHD_AND_REPLAN_PRODUCER_MAX ||
+      ogia->gia_replan_produced_n < GRAPHD_AND_REPLAN_MIN_SAMPLES ||
+      ps->ps_it == NULL || ps->ps_eof || ps->ps_id == PDB_ID_NONE ||
+      ps->ps_next_find_resume_id != PDB_ID_NONE ||
+      !pdb_iterator_sorted(pdb, it) || pdb_iterator_ordered(pdb, it) ||
+      !pdb_iterator_sorted(pdb, ps->ps_it[*producer]) ||
+      !pdb_iterator_n_valid(pdb, ps->ps_it[*producer]) ||
+      !and_run_ps_is_alone(it, ps))
+    return false;
+
+  cost_now = (double)ogia->gia_replan_cost /
+             (ogia->gia_replan_result_n ? ogia->gia_replan_result_n : 1);
+  if (cost_now <= (double)GRAPHD_AND_REPLAN_FACTOR *
+                      (pdb_iterator_next_cost(pdb, it) + 1))
+    return false;
+
+  /*  How many results does the producer's size and the
+   *  share of its candidates that made it through suggest?
+   */
+  and_n = (double)pdb_iterator_n(pdb, ps->ps_it[*producer]) *
+          ogia->gia_replan_result_n / ogia->gia_replan_produced_n;
+  if (and_n < 1) and_n = 1;
+
+  for (i = 0; i < ps->ps_n && i < ogia->gia_n; i++) {
+    double cost;
+
+    if (!and_run_can_take_over(pdb, ps, *producer, i)) continue;
+
+    cost = and_run_cost_per_result(pdb, ogia, ps, i, and_n);
+    if (best == *producer || cost < cost_best) {
+      best = i;
+      cost_best = cost;
+    }
+  }
+  if (best == *producer || cost_best * GRAPHD_AND_REPLAN_FACTOR >= cost_now)
+    return false;
+
+  cl_log(ogia->gia_cl, CL_LEVEL_DEBUG,
+         "and_run_replan_producer: %s: producer #%zu costs $%.1f per result "
+         "(planned $%lld); switching to #%zu at $%.1f, after %llx",
+         pdb_iterator_to_string(pdb, it, buf, sizeof buf), *producer, cost_now,
+         (long long)pdb_iterator_next_cost(pdb, it), best, cost_best,
+         (unsigned long long)ps->ps_id);
+
+  /*  A plan cache entry that led us here is no good.
+   */
+  if (ogia->gia_plan_key != NULL)
+    graphd_plan_cache_invalidate(ogia->gia_graphd, ogia->gia_plan_key,
+                                 ogia->gia_plan_key_n, false);
+
+  if (it->it_displayname != NULL) {
+    cm_free(ogia->gia_cm, it->it_displayname);
+    it->it_displayname = NULL;
+  }
+
+  ogia->gia_producer = *producer = best;
+  ogia->gia_replan_producer_n++;
+  ogia->gia_replan_produced_n = 0;
+  ogia->gia_replan_result_n = 0;
+  ogia->gia_replan_cost = 0;
+
+  ps->ps_next_find_resume_id = ps->ps_id;
+  ps->ps_run_call_state = GRAPHD_ITERATOR_AND_RUN_NEXT_CATCH_UP_START;
+
+  return true;
+}
+
 /**
  * @brief Given a producer and some checkers, get the next value.
  *
@@ -52,7 +317,7 @@ static double step_size(pdb_handle const *pdb, pdb_iterator const *it,
  * @return 0 on success, a nonzero error code on failure.
  * @return PDB_ERR_MORE if we ran out of time.
  */
-int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
+int graphd_iterator_and_run(pdb_iterator *const it, size_t producer,
                             and_process_state *const ps,
                             pdb_budget *const budget_inout) {
   graphd_iterator_and *gia = it->it_theory;
@@ -65,6 +330,7 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
   char buf[200];
   bool checker_likes_find;
   size_t check_i;
+  pdb_budget sub_budget_in;
 
   cl_log(cl, CL_LEVEL_DEBUG,
          "graphd_iterator_and_run(it=%p, ps=%p, ps_id=%llx, resume_id=%llx, "
@@ -85,6 +351,15 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
                ? gia->gia_graphd->g_sabotage->gs_countdown
                : 0);
 
+  /*  Between candidates, see whether the plan is still
+   *  holding up.
+   */
+  if ((ps->ps_run_call_state == 0 || ps->ps_run_call_state == 7) &&
+      ogia(it)->gia_replan_due) {
+    ogia(it)->gia_replan_due = false;
+    (void)and_run_replan_producer(pdb, it, ps, &producer);
+  }
+
   switch (ps->ps_run_call_state) {
     default:
       cl_notreached(cl,
@@ -131,8 +406,11 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
 
         case 9:
           p_it = ps->ps_it[producer];
+          sub_budget_in = *budget_inout;
           err = pdb_iterator_find(pdb, p_it, ps->ps_next_find_resume_id,
                                   &id_found, budget_inout);
+          and_run_charge(pdb, it, producer, AND_RUN_FIND,
+                         sub_budget_in - *budget_inout, err);
           if (err == PDB_ERR_MORE) {
             ps->ps_run_call_state = 9;
             goto suspend;
@@ -181,7 +459,10 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
 
           case 10:
             p_it = ps->ps_it[producer];
+            sub_budget_in = *budget_inout;
             err = pdb_iterator_next(pdb, p_it, &id_found, budget_inout);
+            and_run_charge(pdb, it, producer, AND_RUN_NEXT,
+                           sub_budget_in - *budget_inout, err);
             if (err != 0) {
               if (err == PDB_ERR_MORE) {
                 ps->ps_run_call_state = 10;
@@ -320,8 +601,11 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
               p_it = ps->ps_it[producer];
               PDB_IS_ITERATOR(cl, p_it);
 
+              sub_budget_in = *budget_inout;
               err = pdb_iterator_find(pdb, p_it, ps->ps_id, &id_found,
                                       budget_inout);
+              and_run_charge(pdb, it, producer, AND_RUN_FIND,
+                             sub_budget_in - *budget_inout, err);
               if (err == PDB_ERR_MORE) {
                 ps->ps_run_call_state = 2;
                 goto suspend;
@@ -360,7 +644,10 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
              */
             case 3:
               p_it = ps->ps_it[producer];
+              sub_budget_in = *budget_inout;
               err = pdb_iterator_next(pdb, p_it, &ps->ps_id, budget_inout);
+              and_run_charge(pdb, it, producer, AND_RUN_NEXT,
+                             sub_budget_in - *budget_inout, err);
               if (err != 0) {
                 if (err != PDB_ERR_MORE) goto done;
 
@@ -411,6 +698,20 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
            */
           ps->ps_run_produced_n++;
 
+          /*  Every so often, compare what the subiterators
+           *  actually cost with what the plan assumed.  A new
+           *  check order is picked up just below; a new producer
+           *  the next time we're between candidates.
+           */
+          if (pdb_iterator_statistics_done(pdb, it) &&
+              ++ogia(it)->gia_replan_produced_n %
+                      GRAPHD_AND_REPLAN_INTERVAL ==
+                  0) {
+            ogia(it)->gia_replan_due = true;
+            err = graphd_iterator_and_check_observe(it);
+            if (err != 0) goto done;
+          }
+
           cl_log(cl, CL_LEVEL_VERBOSE,
                  "graphd_iterator_and_run: "
                  "producer #%d made %llx (attempt #%llu)",
@@ -490,76 +791,8 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
             c_it = ps->ps_it[check_i];
             pdb_iterator_call_reset(pdb, c_it);
 
-            if (!pdb_iterator_sorted(pdb, c_it) ||
-                !pdb_iterator_sorted(pdb, ps->ps_it[producer]) ||
-                !pdb_iterator_statistics_done(pdb, c_it))
-              checker_likes_find = false;
-            else if (pdb_iterator_n(pdb, c_it) == 0)
-              checker_likes_find = true;
-            else {
-              double find_cost_per_point, check_cost_per_point;
-              double c_step, p_step, two_find_step;
-              long long step_i_can_use;
-              long long upper_bound = pdb_primitive_n(pdb);
-
-              /*  Each "find" slides us on average stepsize/2
-               *  across the iterator's numerical breadth.
-               *
-               *  So, two pairs of checker and producer finds
-               *  together get us past p_step + c_step IDs.
-               */
-              c_step = step_size(pdb, c_it, upper_bound);
-              p_step = step_size(pdb, ps->ps_it[producer], upper_bound);
-              two_find_step = c_step + p_step;
-
-              step_i_can_use =
-                  (pdb_iterator_forward(pdb, it)
-                       ? (it->it_high == PDB_ITERATOR_HIGH_ANY ? upper_bound
-                                                               : it->it_high) -
-                             ps->ps_id
-                       : ps->ps_id - it->it_low);
-              if (step_i_can_use < 1) step_i_can_use = 0.00001;
-
-              if (c_step > step_i_can_use) c_step = step_i_can_use;
-
-              if (p_step > step_i_can_use) p_step = step_i_can_use;
-
-              if (two_find_step > step_i_can_use)
-                two_find_step = step_i_can_use;
-
-              find_cost_per_point =
-                  ((double)(pdb_iterator_find_cost(pdb, c_it) +
-                            pdb_iterator_find_cost(pdb, ps->ps_it[producer])) *
-                   2.0) /
-                  two_find_step;
-
-              /*  Each "next+check" step gets us past
-               *  p_step IDs.
-               */
-              check_cost_per_point =
-                  (double)(pdb_iterator_next_cost(pdb, ps->ps_it[producer]) +
-                           pdb_iterator_check_cost(pdb, c_it)) /
-                  p_step;
-
-              checker_likes_find = find_cost_per_point < check_cost_per_point;
-
-              cl_log(
-                  cl, CL_LEVEL_VERBOSE,
-                  "graphd_iterator_and_run: "
-                  "subiterator %s: find cost %.3f, "
-                  "(c.fc=%lld + p.fc=%lld)*2"
-                  "/(p_step=%.3f+c_step=%.3f;step_i_can_use=%lld);"
-                  "check_cost %.3f (nc=%lld + cc=%lld)/p_step=%.3f",
-                  pdb_iterator_to_string(pdb, c_it, buf, sizeof buf),
-                  find_cost_per_point,
-                  (long long)pdb_iterator_find_cost(pdb, c_it),
-                  (long long)pdb_iterator_find_cost(pdb, ps->ps_it[producer]),
-                  p_step, c_step, step_i_can_use,
-
-                  check_cost_per_point,
-                  (long long)pdb_iterator_next_cost(pdb, ps->ps_it[producer]),
-                  (long long)pdb_iterator_check_cost(pdb, c_it), p_step);
-            }
+            checker_likes_find =
+                and_run_checker_likes_find(pdb, it, ps, producer, c_it);
 
             if (!checker_likes_find) {
               /* Perform a check.
@@ -588,7 +821,10 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
                        pdb_iterator_to_string(pdb, c_it, buf, sizeof buf),
                        *budget_inout);
 
+                sub_budget_in = *budget_inout;
                 err = pdb_iterator_check(pdb, c_it, ps->ps_id, budget_inout);
+                and_run_charge(pdb, it, check_i, AND_RUN_CHECK,
+                               sub_budget_in - *budget_inout, err);
                 if (err != 0) {
                   if (err == PDB_ERR_MORE) {
                     ps->ps_run_call_state = 4;
@@ -632,8 +868,11 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
                    (unsigned long long)ps->ps_id, check_i,
                    pdb_iterator_to_string(pdb, c_it, buf, sizeof buf));
 
+            sub_budget_in = *budget_inout;
             err = pdb_iterator_find(pdb, c_it, ps->ps_id, &id_found,
                                     budget_inout);
+            and_run_charge(pdb, it, check_i, AND_RUN_FIND,
+                           sub_budget_in - *budget_inout, err);
             if (err != 0) {
               if (err != PDB_ERR_MORE) goto done;
               ps->ps_run_call_state = 6;
@@ -668,6 +907,10 @@ int graphd_iterator_and_run(pdb_iterator *const it, size_t const producer,
 
 done:
   ps->ps_run_cost += budget_in - *budget_inout;
+  if (pdb_iterator_statistics_done(pdb, it)) {
+    ogia(it)->gia_replan_cost += budget_in - *budget_inout;
+    if (err == 0) ogia(it)->gia_replan_result_n++;
+  }
   if (err != 0) {
     if (err == GRAPHD_ERR_NO) ps->ps_eof = true;
 
@@ -693,11 +936,217 @@ unexpected_check_error:
 
 suspend:
   ps->ps_run_cost += budget_in - *budget_inout;
+  if (pdb_iterator_statistics_done(pdb, it))
+    ogia(it)->gia_replan_cost += budget_in - *budget_inout;
   cl_leave(cl, CL_LEVEL_VERBOSE, "resume %hd ($%lld)", ps->ps_run_call_state,
            (long long)(budget_in - *budget_inout));
   return PDB_ERR_MORE;
 }
 
+/*  Charge subiterator #i's run account for a batch call that
+ *  spent <spent> and decided <n> ids, <yes_n> of them in favor.
+ */
+static void and_run_charge_batch(pdb_handle *pdb, pdb_iterator *it, size_t i,
+                                 and_run_call call, pdb_budget spent,
+                                 size_t n, size_t yes_n) {
+  graphd_iterator_and *ogia = ogia(it);
+  graphd_subcondition *sc;
+
+  if (!pdb_iterator_statistics_done(pdb, it) || i >= ogia->gia_n) return;
+
+  sc = ogia->gia_sc + i;
+  if (call == AND_RUN_NEXT) {
+    sc->sc_run_account.ia_next_cost += spent;
+    sc->sc_run_account.ia_next_n += n;
+  } else {
+    sc->sc_run_account.ia_check_cost += spent;
+    sc->sc_run_account.ia_check_n += n;
+    sc->sc_run_check_yes_n += yes_n;
+  }
+}
+
+/**
+ * @brief Can graphd_iterator_and_run_batch() take over from here?
+ *
+ *  Only between candidates, going forward with a sorted
+ *  producer, and only if each of the checkers would be
+ *  asked to "check" rather than "find".
+ *
+ * @param it		The and-iterator
+ * @param producer	Index of the producer.
+ * @param ps		process-state, as for graphd_iterator_and_run()
+ */
+bool graphd_iterator_and_run_can_batch(pdb_iterator *it, size_t producer,
+                                       and_process_state const *ps) {
+  graphd_iterator_and *gia = it->it_theory;
+  pdb_handle *pdb = gia->gia_pdb;
+  pdb_iterator *p_it;
+  size_t i;
+
+  if (!pdb_iterator_statistics_done(pdb, it) || ps->ps_it == NULL ||
+      ps->ps_eof || ps->ps_run_call_state != 0 || ps->ps_id == PDB_ID_NONE ||
+      ps->ps_next_find_resume_id != PDB_ID_NONE || ogia(it)->gia_replan_due ||
+      !pdb_iterator_forward(pdb, it))
+    return false;
+
+  p_it = ps->ps_it[producer];
+  if (!pdb_iterator_has_position(pdb, p_it) || !pdb_iterator_sorted(pdb, p_it) ||
+      !pdb_iterator_forward(pdb, p_it))
+    return false;
+
+  for (i = 0; i < ps->ps_n; i++)
+    if (i != producer &&
+        and_run_checker_likes_find(pdb, it, ps, producer, ps->ps_it[i]))
+      return false;
+  return true;
+}
+
+/**
+ * @brief Produce and check a batch of candidates.
+ *
+ *  With the conditions of graphd_iterator_and_run_can_batch()
+ *  met, graphd_iterator_and_run() amounts to a "next" and a row
+ *  of "check"s per candidate.  This does the same for up to
+ *  <m> candidates at a time: one
+ *  pdb_iterator_next_batch() from the producer, and one
+ *  pdb_iterator_check_batch() per checker, in check order.
+ *
+ *  Once started, a batch is checked to the end, even if that
+ *  overruns the budget.  Afterwards, ps->ps_id is the last
+ *  candidate, passed or not, and the process state is between
+ *  candidates, as after a graphd_iterator_and_run() that returned 0.
+ *
+ * @param it		The and-iterator
+ * @param producer	Index of the producer.
+ * @param ps		process-state, as for graphd_iterator_and_run()
+ * @param id_out	out: the ids that passed
+ * @param m		number of candidates to produce, at most
+ *			GRAPHD_AND_BATCH
+ * @param n_out		out: number of ids in id_out; may be 0.
+ * @param budget_inout	budget
+ *
+ * @return 0 on success.
+ * @return GRAPHD_ERR_NO if the producer has run out; the
+ *	ids in id_out, if any, are the last ones.
+ * @return PDB_ERR_MORE if we ran out of time before producing
+ *	anything; graphd_iterator_and_run() continues.
+ */
+int graphd_iterator_and_run_batch(pdb_iterator *const it, size_t producer,
+                                  and_process_state *const ps, pdb_id *id_out,
+                                  size_t m, size_t *n_out,
+                                  pdb_budget *const budget_inout) {
+  graphd_iterator_and *gia = it->it_theory;
+  graphd_iterator_and *ogia = ogia(it);
+  cl_handle *cl = gia->gia_cl;
+  pdb_handle *pdb = gia->gia_pdb;
+  pdb_iterator *p_it = ps->ps_it[producer];
+  pdb_budget budget_in = *budget_inout, sub_budget_in;
+  pdb_id tmp[GRAPHD_AND_BATCH];
+  size_t i, n, n_done, tmp_n, sub_done, sub_n;
+  unsigned long long produced_n;
+  bool eof = false;
+  int err;
+
+  cl_assert(cl, m > 0 && m <= GRAPHD_AND_BATCH);
+  *n_out = 0;
+
+  sub_budget_in = *budget_inout;
+  err = pdb_iterator_next_batch(pdb, p_it, id_out, m, &n, budget_inout);
+  and_run_charge_batch(pdb, it, producer, AND_RUN_NEXT,
+                       sub_budget_in - *budget_inout, n, 0);
+  if (err == GRAPHD_ERR_NO)
+    eof = true;
+  else if (err == PDB_ERR_MORE && n == 0) {
+    /*  Let the single-stepping code resume the producer.
+     */
+    ps->ps_run_call_state = 3;
+    ps->ps_run_cost = budget_in - *budget_inout;
+    goto done;
+  } else if (err != 0 && err != PDB_ERR_MORE)
+    goto done;
+  err = 0;
+
+  if (n > 0) {
+    ps->ps_id = ps->ps_producer_id = id_out[n - 1];
+    ps->ps_run_produced_n += n;
+
+    /*  Catch up with the re-plan schedule; if we crossed an
+     *  interval, graphd_iterator_and_run() re-plans next time.
+     */
+    produced_n = ogia->gia_replan_produced_n;
+    ogia->gia_replan_produced_n += n;
+    if (produced_n / GRAPHD_AND_REPLAN_INTERVAL !=
+        ogia->gia_replan_produced_n / GRAPHD_AND_REPLAN_INTERVAL) {
+      ogia->gia_replan_due = true;
+      if ((err = graphd_iterator_and_check_observe(it)) != 0) goto done;
+    }
+  }
+
+  /*  Drop what's outside our boundaries.
+   */
+  for (i = tmp_n = 0; i < n; i++) {
+    if (id_out[i] >= it->it_high) {
+      eof = true;
+      break;
+    }
+    if (id_out[i] >= it->it_low) id_out[tmp_n++] = id_out[i];
+  }
+  n = tmp_n;
+
+  if ((err = graphd_iterator_and_check_sort_refresh(it, ps)) != 0) goto done;
+
+  for (ps->ps_check_i = 0; ps->ps_check_i < ps->ps_n && n > 0;
+       ps->ps_check_i++) {
+    size_t check_i = ps->ps_check_order[ps->ps_check_i];
+    pdb_iterator *c_it = ps->ps_it[check_i];
+
+    if (check_i == producer) continue;
+
+    pdb_iterator_call_reset(pdb, c_it);
+    for (n_done = tmp_n = 0; n_done < n;) {
+      sub_budget_in = *budget_inout;
+      err = pdb_iterator_check_batch(pdb, c_it, id_out + n_done, n - n_done,
+                                     &sub_done, tmp + tmp_n, &sub_n,
+                                     budget_inout);
+      and_run_charge_batch(pdb, it, check_i, AND_RUN_CHECK,
+                           sub_budget_in - *budget_inout, sub_done, sub_n);
+      n_done += sub_done;
+      tmp_n += sub_n;
+
+      if (err != 0 && err != PDB_ERR_MORE) {
+        char buf[200];
+        cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_check_batch", err,
+                     "iterator=%s",
+                     pdb_iterator_to_string(pdb, c_it, buf, sizeof buf));
+        goto done;
+      }
+    }
+    memcpy(id_out, tmp, tmp_n * sizeof(*tmp));
+    n = tmp_n;
+  }
+  ps->ps_check_i = 0;
+  ps->ps_run_cost = 0;
+  *n_out = n;
+
+  if (eof) {
+    ps->ps_eof = true;
+    err = GRAPHD_ERR_NO;
+  }
+
+done:
+  if (pdb_iterator_statistics_done(pdb, it)) {
+    ogia->gia_replan_cost += budget_in - *budget_inout;
+    ogia->gia_replan_result_n += *n_out;
+  }
+  cl_log(cl, CL_LEVEL_VERBOSE,
+         "graphd_iterator_and_run_batch: producer #%zu, %zu passed, "
+         "last candidate %llx: %s ($%lld)",
+         producer, *n_out, (unsigned long long)ps->ps_id,
+         err ? graphd_strerror(err) : "ok",
+         (long long)(budget_in - *budget_inout));
+  return err;
+}
+
 /*  A "find" is like a next with a slightly different
  *  starting point.
  */
@@ -1211,6 +1211,192 @@ static void sc_completed_run(pdb_handle *pdb, pdb_iterator *it,
   cl_assert(cl, sc->sc_contest_cost >= 0);
 }
 
+/*  Append the direction and subiterator types to the plan
+ *  cache key; a plan is only good for the same subiterators
+ *  in the same order.
+ */
+static int and_plan_key_shape(graphd_iterator_and *ogia) {
+  cm_buffer buf;
+  char *key;
+  size_t i;
+  int err;
+
+  cm_buffer_initialize(&buf, ogia->gia_cm);
+  err = cm_buffer_add_bytes(&buf, ogia->gia_plan_key, ogia->gia_plan_key_n);
+  if (err == 0)
+    err = cm_buffer_sprintf(
+        &buf, "/%c", graphd_iterator_direction_to_char(ogia->gia_direction));
+  for (i = 0; err == 0 && i < ogia->gia_n; i++)
+    err = cm_buffer_sprintf(&buf, "/%s",
+                            ogia->gia_sc[i].sc_it->it_type->itt_name);
+  if (err != 0) {
+    cm_buffer_finish(&buf);
+    return err;
+  }
+
+  key = cm_malloc(ogia->gia_cm, cm_buffer_length(&buf) + 1);
+  if (key == NULL) {
+    cm_buffer_finish(&buf);
+    return ENOMEM;
+  }
+  memcpy(key, cm_buffer_memory(&buf), cm_buffer_length(&buf));
+  key[cm_buffer_length(&buf)] = '\0';
+
+  cm_free(ogia->gia_cm, ogia->gia_plan_key);
+  ogia->gia_plan_key = key;
+  ogia->gia_plan_key_n = cm_buffer_length(&buf);
+  cm_buffer_finish(&buf);
+
+  return 0;
+}
+
+/*  Remember the contest's outcome in the plan cache.
+ */
+static void and_plan_store(pdb_handle *pdb, pdb_iterator *it,
+                           unsigned long long est_n, pdb_budget next_cost) {
+  graphd_iterator_and *ogia = it->it_theory;
+  graphd_plan plan;
+  size_t i;
+  int err;
+
+  memset(&plan, 0, sizeof plan);
+  plan.plan_producer = ogia->gia_producer;
+  plan.plan_n = est_n;
+  plan.plan_next_cost = next_cost;
+  plan.plan_sub_n = ogia->gia_n;
+
+  for (i = 0; i < ogia->gia_n; i++)
+    plan.plan_sub_count[i] =
+        pdb_iterator_n_valid(pdb, ogia->gia_sc[i].sc_it)
+            ? pdb_iterator_n(pdb, ogia->gia_sc[i].sc_it)
+            : GRAPHD_PLAN_N_UNKNOWN;
+
+  err = graphd_plan_cache_store(ogia->gia_graphd, ogia->gia_plan_key,
+                                ogia->gia_plan_key_n, &plan);
+  if (err != 0)
+    cl_log_errno(ogia->gia_cl, CL_LEVEL_FAIL, "graphd_plan_cache_store", err,
+                 "key=%s", ogia->gia_plan_key);
+}
+
+/*  If the plan cache knows which producer to use for an "and"
+ *  of this shape, get everybody's statistics, make sure they
+ *  haven't drifted too far from what they were when the plan was
+ *  made, and set up the producer as if it had won the contest.
+ *
+ *  Sets *planned_out if the contest can be skipped.
+ */
+static int and_iterator_statistics_plan(pdb_handle *pdb, pdb_iterator *it,
+                                        pdb_budget *budget_inout,
+                                        bool *planned_out) {
+  graphd_iterator_and *ogia = it->it_theory;
+  graphd_handle *g = ogia->gia_graphd;
+  cl_handle *cl = ogia->gia_cl;
+  graphd_subcondition *sc;
+  size_t i;
+  int err;
+  char buf[200];
+
+  *planned_out = false;
+
+  /*  A thawed "and" already knows its producer.
+   */
+  if (ogia->gia_plan_key == NULL || ogia->gia_thaw ||
+      ogia->gia_producer_hint != -1 || ogia->gia_n > GRAPHD_PLAN_SUB_MAX)
+    return 0;
+
+  if (!ogia->gia_plan_looked_up) {
+    ogia->gia_plan_looked_up = true;
+
+    /*  Too late - we're already in a contest.
+     */
+    if (ogia->gia_contest_order != NULL) {
+      cm_free(ogia->gia_cm, ogia->gia_plan_key);
+      ogia->gia_plan_key = NULL;
+      ogia->gia_plan_key_n = 0;
+
+      return 0;
+    }
+
+    if ((err = and_plan_key_shape(ogia)) != 0) return err;
+    ogia->gia_planned = graphd_plan_cache_lookup(
+        g, ogia->gia_plan_key, ogia->gia_plan_key_n, &ogia->gia_plan);
+    if (ogia->gia_planned && (ogia->gia_plan.plan_sub_n != ogia->gia_n ||
+                              ogia->gia_plan.plan_producer >= ogia->gia_n))
+      ogia->gia_planned = false;
+  }
+  if (!ogia->gia_planned) return 0;
+
+  for (i = 0, sc = ogia->gia_sc; i < ogia->gia_n; i++, sc++) {
+    if (pdb_iterator_statistics_done(pdb, sc->sc_it)) continue;
+
+    err = pdb_iterator_statistics(pdb, sc->sc_it, budget_inout);
+    if (err != 0) return err;
+
+    err = pdb_iterator_refresh_pointer(pdb, &sc->sc_it);
+    if (err == 0)
+      it->it_id = pdb_iterator_new_id(pdb);
+    else if (err != PDB_ERR_ALREADY) {
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_refresh_pointer", err,
+                   "subiterator #%zu=%s", i,
+                   pdb_iterator_to_string(pdb, sc->sc_it, buf, sizeof buf));
+      return err;
+    }
+    gia_invalidate_cached_setsize(ogia);
+    gia_invalidate_sort(ogia);
+  }
+
+  for (i = 0, sc = ogia->gia_sc; i < ogia->gia_n; i++, sc++)
+    if (graphd_plan_cache_drifted(ogia->gia_plan.plan_sub_count[i],
+                                  pdb_iterator_n(pdb, sc->sc_it))) {
+      cl_log(cl, CL_LEVEL_VERBOSE,
+             "and_iterator_statistics_plan: subiterator #%zu (%s) "
+             "went from %llu to %llu; dropping the plan",
+             i, pdb_iterator_to_string(pdb, sc->sc_it, buf, sizeof buf),
+             ogia->gia_plan.plan_sub_count[i],
+             (unsigned long long)pdb_iterator_n(pdb, sc->sc_it));
+
+      graphd_plan_cache_invalidate(g, ogia->gia_plan_key,
+                                   ogia->gia_plan_key_n, true);
+      ogia->gia_planned = false;
+      return 0;
+    }
+
+  if ((err = graphd_iterator_and_check_sort(it)) != 0) return err;
+
+  /*  Set up the producer the way and_iterator_statistics_work()
+   *  would have.
+   */
+  for (i = 0, sc = ogia->gia_sc; i < ogia->gia_n; i++, sc++)
+    sc->sc_compete = true;
+
+  sc = ogia->gia_sc + ogia->gia_plan.plan_producer;
+  err = graphd_iterator_and_process_state_initialize(pdb, it,
+                                                     &sc->sc_contest_ps);
+  if (err != 0) {
+    cl_log_errno(cl, CL_LEVEL_FAIL,
+                 "graphd_iterator_and_process_state_initialize", err,
+                 "producer: %s",
+                 pdb_iterator_to_string(pdb, sc->sc_it, buf, sizeof buf));
+    return err;
+  }
+  err = pdb_iterator_reset(
+      pdb, sc->sc_contest_ps.ps_it[ogia->gia_plan.plan_producer]);
+  if (err != 0) {
+    cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_reset", err, "producer: %s",
+                 pdb_iterator_to_string(pdb, sc->sc_it, buf, sizeof buf));
+    return err;
+  }
+
+  cl_log(cl, CL_LEVEL_VERBOSE,
+         "and_iterator_statistics_plan: producer #%zu (%s) from the plan "
+         "cache",
+         ogia->gia_plan.plan_producer,
+         pdb_iterator_to_string(pdb, sc->sc_it, buf, sizeof buf));
+
+  *planned_out = true;
+  return 0;
+}
+
 int graphd_iterator_and_statistics(pdb_handle *const pdb,
                                    pdb_iterator *const it,
                                    pdb_budget *const budget_inout) {
@@ -1231,6 +1417,7 @@ int graphd_iterator_and_statistics(pdb_handle *const pdb,
   pdb_budget budget_effective;
   bool any;
   bool cache_contest_results = true;
+  bool planned = false;
   pdb_iterator *sort_it;
 
   if (GRAPHD_SABOTAGE(ogia->gia_graphd, *budget_inout <= 0))
@@ -1291,6 +1478,17 @@ int graphd_iterator_and_statistics(pdb_handle *const pdb,
     goto suspend;
   }
 
+  /*  If we've seen an "and" like this before, don't
+   *  bother with a contest.
+   */
+  err = and_iterator_statistics_plan(pdb, it, budget_inout, &planned);
+  if (err == PDB_ERR_MORE) goto suspend;
+  if (err != 0) goto err;
+  if (planned) {
+    winning_i = ogia->gia_plan.plan_producer;
+    goto done;
+  }
+
 /*  2  Resort; determine upper boundaries, whether or
  *     not we're still running, and how long.
  *  ====================================================
@@ -1541,11 +1739,22 @@ done:
     cache_contest_results = false;
   }
 
-  /*  est_n : sub_n = GRAPHD_AND_CONTEST_GOAL : run_produced_n
-   */
-  cl_assert(cl, sc->sc_contest_ps.ps_run_produced_n > 0);
-  est_n =
-      (GRAPHD_AND_CONTEST_GOAL * sub_n) / sc->sc_contest_ps.ps_run_produced_n;
+  if (planned) {
+    /*  est_n : sub_n = plan_n : the producer's n back then
+     */
+    unsigned long long then_n =
+        ogia->gia_plan.plan_sub_count[ogia->gia_producer];
+
+    est_n = ogia->gia_plan.plan_n;
+    if (then_n != GRAPHD_PLAN_N_UNKNOWN && then_n > 0)
+      est_n = (double)est_n * sub_n / then_n;
+  } else {
+    /*  est_n : sub_n = GRAPHD_AND_CONTEST_GOAL : run_produced_n
+     */
+    cl_assert(cl, sc->sc_contest_ps.ps_run_produced_n > 0);
+    est_n = (GRAPHD_AND_CONTEST_GOAL * sub_n) /
+            sc->sc_contest_ps.ps_run_produced_n;
+  }
 
   /* Limit est_n to the minimum of any subiterator's count.
    */
@@ -1558,8 +1767,8 @@ done:
         x >= GRAPHD_AND_CONTEST_GOAL)
       est_n = x;
   }
-  if (est_n !=
-      (GRAPHD_AND_CONTEST_GOAL * sub_n) / sc->sc_contest_ps.ps_run_produced_n)
+  if (!planned && est_n != (GRAPHD_AND_CONTEST_GOAL * sub_n) /
+                               sc->sc_contest_ps.ps_run_produced_n)
     cl_log(cl, CL_LEVEL_VERBOSE,
            "graphd_iterator_and_statistics: "
            "lowered estimate to %llu",
@@ -1570,7 +1779,9 @@ done:
 
   if (est_n > upper_bound) est_n = upper_bound;
 
-  if (sc->sc_contest_id_n > 0) {
+  if (planned)
+    next_cost = ogia->gia_plan.plan_next_cost;
+  else if (sc->sc_contest_id_n > 0) {
     next_cost = sc->sc_contest_cost / sc->sc_contest_id_n;
     if (next_cost == 0) next_cost = 1;
   } else if (est_n > 0)
@@ -1609,6 +1820,9 @@ done:
   pdb_iterator_n_set(pdb, it, est_n);
   pdb_iterator_statistics_done_set(pdb, it);
 
+  if (!planned && ogia->gia_plan_key != NULL && ogia->gia_plan_looked_up)
+    and_plan_store(pdb, it, est_n, next_cost);
+
   /*  Free non-producer resources.
    */
   and_iterator_statistics_complete(it);
@@ -263,6 +263,59 @@ static int and_iterator_cache_expand(pdb_handle *pdb, pdb_iterator *it,
       }
     }
 
+    /*  At the end of the cache, and between candidates?
+     *  Then maybe we can produce a batch of them at once.
+     *  Don't run past the end of the page -- a cursor that
+     *  ends at the end of the cache can save its producer's
+     *  position.
+     */
+    if (ogia->gia_cache_ps_offset >= gic->gic_n &&
+        graphd_iterator_and_run_can_batch(it, ogia->gia_producer, ps)) {
+      pdb_id id[GRAPHD_AND_BATCH];
+      pdb_budget budget_in = *budget_inout;
+      size_t n, m = GRAPHD_AND_BATCH;
+
+      if (ogia->gia_context_pagesize_valid && ogia->gia_context_pagesize > 0 &&
+          ogia->gia_context_pagesize -
+                  gic->gic_n % ogia->gia_context_pagesize <
+              m)
+        m = ogia->gia_context_pagesize -
+            gic->gic_n % ogia->gia_context_pagesize;
+
+      err = graphd_iterator_and_run_batch(it, ogia->gia_producer, ps, id, m,
+                                          &n, budget_inout);
+      if (err != 0 && err != GRAPHD_ERR_NO) break;
+
+      for (i = 0; i < n; i++) {
+        int add_err = graphd_iterator_cache_add(
+            gic, id[i], (budget_in - *budget_inout) / n);
+        if (add_err != 0) {
+          cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_iterator_cache_add", add_err,
+                       "id=%llx, cache=%p[%zu]", (unsigned long long)id[i],
+                       (void *)gic, gic->gic_n);
+
+          /*  Have the producer go back and make the
+           *  rest of the batch again, one at a time.
+           */
+          ps->ps_id = id[i];
+          ps->ps_eof = false;
+          ps->ps_run_call_state = GRAPHD_ITERATOR_AND_RUN_FIND_START;
+          err = add_err;
+          break;
+        }
+      }
+      ogia->gia_cache_ps_offset = gic->gic_n;
+      if (err != 0) {
+        if (err == GRAPHD_ERR_NO) graphd_iterator_cache_eof(gic);
+        break;
+      }
+      if (gic->gic_n <= desired_offset && *budget_inout <= 0) {
+        err = PDB_ERR_MORE;
+        break;
+      }
+      continue;
+    }
+
     /*  Turn the crank  -- catch up with ps_next_find_resume_id,
      *  if we have one, and then produce another value.
      */
@@ -851,6 +904,7 @@ static void and_finish(pdb_handle *pdb, pdb_iterator *it) {
       }
       cm_free(gia->gia_cm, gia->gia_check_order);
       cm_free(gia->gia_cm, gia->gia_contest_order);
+      cm_free(gia->gia_cm, gia->gia_plan_key);
     }
     cm_free(gia->gia_cm, it->it_displayname);
     it->it_displayname = NULL;
@@ -1166,6 +1220,105 @@ err:
   return err;
 }
 
+/*  After the first id, which takes care of access, redirects
+ *  and resume ids, an "and" that reads from its cache copies
+ *  ids out of the cache, expanding it as needed; one that runs
+ *  on its own returns graphd_iterator_and_run_batch() results
+ *  directly.  Anything else loops over next.
+ */
+static int and_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                          pdb_id *id_out, size_t m, size_t *n_out,
+                          pdb_budget *budget_inout) {
+  graphd_iterator_and *gia = it->it_theory;
+  graphd_iterator_cache *gic;
+  pdb_budget budget_in;
+  size_t n, k;
+  int err;
+
+  if (it->it_call_state != 0)
+    return pdb_iterator_next_batch_loop(pdb, it, and_next_loc, id_out, m,
+                                        n_out, budget_inout);
+
+  *n_out = 0;
+  err = and_next_loc(pdb, it, id_out, budget_inout, __FILE__, __LINE__);
+  if (err != 0) return err;
+
+  *n_out = n = 1;
+  if (n >= m || *budget_inout <= 0 || it->it_type != &graphd_iterator_and_type)
+    return 0;
+
+  gia = it->it_theory;
+  budget_in = *budget_inout;
+  err = 0;
+
+  while (n < m && *budget_inout > 0 && it->it_call_state == 0 &&
+         gia->gia_resume_id == PDB_ID_NONE && !gia->gia_ps.ps_eof) {
+    if (gia->gia_cache_offset_valid) {
+      gic = ogia(it)->gia_cache;
+      if (gia->gia_cache_offset >= gic->gic_n) {
+        if (gic->gic_eof) {
+          gia->gia_ps.ps_id = gia->gia_id = PDB_ID_NONE;
+          gia->gia_ps.ps_eof = true;
+          err = GRAPHD_ERR_NO;
+          break;
+        }
+        err = and_iterator_cache_expand(pdb, it, budget_inout,
+                                        gia->gia_cache_offset + (m - n) - 1);
+        if (err == GRAPHD_ERR_NO) err = 0;
+        if (err != 0 || gia->gia_cache_offset >= gic->gic_n) {
+          /*  Let and_next_loc() deal with it.
+           */
+          if (err != PDB_ERR_MORE) err = 0;
+          break;
+        }
+      }
+      while (n < m && gia->gia_cache_offset < gic->gic_n &&
+             graphd_iterator_cache_index(gic, gia->gia_cache_offset, id_out + n,
+                                         budget_inout) == 0) {
+        gia->gia_ps.ps_id = gia->gia_id = id_out[n++];
+        gia->gia_cache_offset++;
+      }
+      continue;
+    }
+
+    if (!graphd_iterator_and_run_can_batch(it, ogia(it)->gia_producer,
+                                           &gia->gia_ps))
+      break;
+    err = graphd_iterator_and_run_batch(
+        it, ogia(it)->gia_producer, &gia->gia_ps, id_out + n,
+        m - n < GRAPHD_AND_BATCH ? m - n : GRAPHD_AND_BATCH, &k, budget_inout);
+    if (k > 0) gia->gia_id = id_out[n + k - 1];
+    n += k;
+    if (err != 0) {
+      if (err == PDB_ERR_MORE)
+        it->it_call_state = 1;
+      else if (err == GRAPHD_ERR_NO)
+        gia->gia_ps.ps_id = gia->gia_id = PDB_ID_NONE;
+      break;
+    }
+  }
+  if (err == 0 && gia->gia_ps.ps_eof) err = GRAPHD_ERR_NO;
+
+  ogia(it)->gia_n_produced += n - 1;
+  pdb_rxs_log(pdb, "NEXT-BATCH %p and %zu: %s ($%lld)", (void *)it, n - 1,
+              err == 0 ? "ok" : graphd_strerror(err),
+              (long long)(budget_in - *budget_inout));
+  pdb_iterator_account_charge(pdb, it, next, n - 1 + (err == GRAPHD_ERR_NO),
+                              budget_in - *budget_inout);
+  *n_out = n;
+
+  /*  Neither the cache nor a batch run could go on; step
+   *  through the rest.
+   */
+  if (err == 0 && n < m && *budget_inout > 0 &&
+      it->it_type == &graphd_iterator_and_type) {
+    err = pdb_iterator_next_batch_loop(pdb, it, and_next_loc, id_out + n,
+                                       m - n, &k, budget_inout);
+    *n_out += k;
+  }
+  return err;
+}
+
 const pdb_iterator_type graphd_iterator_and_type = {
     "and",
 
@@ -1187,8 +1340,10 @@ const pdb_iterator_type graphd_iterator_and_type = {
     and_iterator_restrict,
 
     NULL, /* suspend */
-    NULL  /* unsuspend */
-};
+    NULL, /* unsuspend */
+
+    and_next_batch,
+    graphd_iterator_and_check_batch};
 
 /**
  * @brief Create an "and" structure.
@@ -1369,6 +1524,41 @@ void graphd_iterator_and_set_context_pagesize(graphd_handle *graphd,
   ogia->gia_context_pagesize_valid = true;
 }
 
+/**
+ * @brief Annotate an "and" with its plan cache key.
+ *
+ *  Iterators that have a key look for their producer in the
+ *  plan cache before running the statistics contest, and
+ *  store the contest's result there afterwards.
+ *
+ * @param graphd	system handle
+ * @param it		the iterator
+ * @param key		signature of the constraint the "and" is for
+ * @param key_n		number of bytes pointed to by key
+ *
+ * @return 0 on success, ENOMEM on allocation error.
+ */
+int graphd_iterator_and_set_plan_key(graphd_handle *graphd, pdb_iterator *it,
+                                     char const *key, size_t key_n) {
+  graphd_iterator_and *ogia;
+
+  if (it->it_type != &graphd_iterator_and_type) return 0;
+
+  ogia = it->it_theory;
+  PDB_IS_ITERATOR(ogia->gia_cl, it);
+
+  cm_free(ogia->gia_cm, ogia->gia_plan_key);
+  if ((ogia->gia_plan_key = cm_malloc(ogia->gia_cm, key_n + 1)) == NULL) {
+    ogia->gia_plan_key_n = 0;
+    return ENOMEM;
+  }
+  memcpy(ogia->gia_plan_key, key, key_n);
+  ogia->gia_plan_key[key_n] = '\0';
+  ogia->gia_plan_key_n = key_n;
+
+  return 0;
+}
+
 /**
  * @brief Finish creating an "and" structure.
  *
@@ -47,6 +47,30 @@ limitations under the License.
  */
 #define GRAPHD_AND_PREEVALUATE_COST_MAX (1024 * 10)
 
+/*  While running, every this many candidates, compare what the
+ *  subiterators actually cost against what the plan assumed.
+ */
+#define GRAPHD_AND_REPLAN_INTERVAL 64
+
+/*  Don't trust observed check costs or pass rates until a
+ *  subiterator has been asked at least this many times.
+ */
+#define GRAPHD_AND_REPLAN_MIN_SAMPLES 32
+
+/*  Only re-plan once observation and estimate differ by more
+ *  than this factor - the estimates are rough to begin with.
+ */
+#define GRAPHD_AND_REPLAN_FACTOR 4
+
+/*  Change producers at most this many times per iterator.
+ */
+#define GRAPHD_AND_REPLAN_PRODUCER_MAX 2
+
+/*  Between candidates, produce and check up to this many
+ *  candidates at once (see graphd_iterator_and_run_batch()).
+ */
+#define GRAPHD_AND_BATCH 32
+
 /*  Magic number to identify GIA state.  (Go Ramones!)
  */
 #define GRAPHD_AND_MAGIC 0x01020304
@@ -177,6 +201,19 @@ typedef struct graphd_subcondition {
    */
   unsigned int sc_compete : 1;
 
+  /*  After the contest: what the subiterator has actually cost
+   *  while running as producer or checker, and how many of its
+   *  checks said yes.  Charged by graphd_iterator_and_run().
+   */
+  pdb_iterator_account sc_run_account;
+  unsigned long long sc_run_check_yes_n;
+
+  /*  Set once the observed check cost or pass rate have strayed
+   *  far enough from the estimates that the check order is
+   *  sorted by observation instead.
+   */
+  unsigned int sc_run_observed : 1;
+
 } graphd_subcondition;
 
 typedef struct graphd_iterator_and {
@@ -320,6 +357,36 @@ typedef struct graphd_iterator_and {
   unsigned int gia_context_setsize_valid : 1;
   unsigned long long gia_context_setsize;
 
+  /*  (Original only.)  The plan cache key: at first, the
+   *  constraint signature; once the contest starts, with the
+   *  shape of the subiterators appended.  NULL if the plan
+   *  cache isn't used for this iterator.
+   */
+  char *gia_plan_key;
+  size_t gia_plan_key_n;
+
+  /*  (Original only.)  Has the plan cache been consulted?
+   *  If gia_planned is set, it had a plan for us, in gia_plan.
+   */
+  unsigned int gia_plan_looked_up : 1;
+  unsigned int gia_planned : 1;
+  graphd_plan gia_plan;
+
+  /*  (Original only.)  Candidates produced, results returned, and
+   *  budget spent by graphd_iterator_and_run() since the producer
+   *  was last chosen; and how often it has been re-chosen.
+   */
+  unsigned long long gia_replan_produced_n;
+  unsigned long long gia_replan_result_n;
+  pdb_budget gia_replan_cost;
+  unsigned int gia_replan_producer_n;
+
+  /*  (Original only.)  Set every GRAPHD_AND_REPLAN_INTERVAL
+   *  candidates; the next process state to get between candidates
+   *  reconsiders the producer.
+   */
+  unsigned int gia_replan_due : 1;
+
 } graphd_iterator_and;
 
 #define ogia_nocheck(it) ((graphd_iterator_and *)((it)->it_original->it_theory))
@@ -344,10 +411,18 @@ int graphd_iterator_and_check(pdb_handle *const _pdb, pdb_iterator *const _it,
                               pdb_id const _id,
                               pdb_budget *const _budget_inout);
 
+int graphd_iterator_and_check_batch(pdb_handle *const _pdb,
+                                    pdb_iterator *const _it,
+                                    pdb_id const *_id_in, size_t _n_in,
+                                    size_t *_n_in_done, pdb_id *_id_out,
+                                    size_t *_n_out,
+                                    pdb_budget *const _budget_inout);
+
 void graphd_iterator_and_slow_check_finish(pdb_handle *const _pdb,
                                            pdb_iterator *const _it);
 
 int graphd_iterator_and_check_sort(pdb_iterator *);
+int graphd_iterator_and_check_observe(pdb_iterator *it);
 int graphd_iterator_and_check_sort_refresh(pdb_iterator *it,
                                            and_process_state *ps);
 void graphd_iterator_and_check_delete_subcondition(pdb_iterator *it, size_t i);
@@ -370,6 +445,14 @@ int graphd_iterator_and_freeze(pdb_handle *_pdb, pdb_iterator *_it,
 int graphd_iterator_and_run(pdb_iterator *it, size_t producer,
                             and_process_state *ps, pdb_budget *budget_inout);
 
+bool graphd_iterator_and_run_can_batch(pdb_iterator *it, size_t producer,
+                                       and_process_state const *ps);
+
+int graphd_iterator_and_run_batch(pdb_iterator *it, size_t producer,
+                                  and_process_state *ps, pdb_id *id_out,
+                                  size_t m, size_t *n_out,
+                                  pdb_budget *budget_inout);
+
 int graphd_iterator_and_find_loc(pdb_handle *pdb, pdb_iterator *it,
                                  pdb_id id_in, pdb_id *id_out,
                                  pdb_budget *budget_inout, char const *file,
@@ -136,6 +136,7 @@ int graphd_iterator_cache_add(graphd_iterator_cache *gic, pdb_id id,
   }
 
   gic->gic_cost_total += id_cost;
+  graphd_storable_cost_add(gic, id_cost);
 
   gic->gic_id[gic->gic_n++] = id;
 
@@ -109,11 +109,35 @@ static unsigned long fixed_storable_hash(void const *data) {
   return hash ^ fb->fb_n;
 }
 
+static graphd_iterator_fixed_base *fixed_base_make(graphd_handle *g,
+                                                   size_t nelems);
+
+/*  Shared copy: the sorted IDs, as an array of pdb_id.  The
+ *  masquerade isn't part of it; the thawed cursor restores that.
+ */
+static int fixed_storable_export(void const *data, cm_buffer *buf) {
+  graphd_iterator_fixed_base const *fb = data;
+
+  return cm_buffer_add_bytes(buf, (char const *)fb->fb_id,
+                             fb->fb_n * sizeof(*fb->fb_id));
+}
+
+static void *fixed_storable_import(graphd_handle *g, char const *s, size_t n) {
+  graphd_iterator_fixed_base *fb;
+
+  if (n == 0 || n % sizeof(*fb->fb_id) != 0) return NULL;
+  if ((fb = fixed_base_make(g, n / sizeof(*fb->fb_id))) == NULL) return NULL;
+
+  memcpy(fb->fb_id, s, n);
+  fb->fb_n = n / sizeof(*fb->fb_id);
+  graphd_storable_size_add(g, fb, n);
+
+  return fb;
+}
+
 static struct graphd_storable_type const fixed_storable_type = {
     "fixed iterator data", fixed_storable_destroy, fixed_storable_equal,
-    fixed_storable_hash
-
-};
+    fixed_storable_hash,   fixed_storable_export,  fixed_storable_import};
 
 static graphd_iterator_fixed_base *fixed_base_make(graphd_handle *g,
                                                    size_t nelems) {
@@ -366,6 +390,84 @@ static int fixed_iterator_check(pdb_handle *pdb, pdb_iterator *it, pdb_id id,
   return 0;
 }
 
+static int fixed_iterator_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                                     pdb_id *id_out, size_t m, size_t *n_out,
+                                     pdb_budget *cost_inout) {
+  graphd_iterator_fixed *fix = it->it_theory;
+  pdb_id const *fix_id = ofix(it)->fix_base->fb_id;
+  size_t i, n;
+
+  if (fix->fix_i >= it->it_n) {
+    *n_out = 0;
+    *cost_inout -= PDB_COST_FUNCTION_CALL;
+    pdb_iterator_account_charge(pdb, it, next, 1, PDB_COST_FUNCTION_CALL);
+    pdb_rxs_log(pdb, "NEXT-BATCH %p fixed EOF ($%lld)", (void *)it,
+                (long long)PDB_COST_FUNCTION_CALL);
+    return GRAPHD_ERR_NO;
+  }
+
+  n = it->it_n - fix->fix_i;
+  if (n > m) n = m;
+
+  if (it->it_forward)
+    memcpy(id_out, fix_id + fix->fix_i, n * sizeof(*id_out));
+  else
+    for (i = 0; i < n; i++)
+      id_out[i] = fix_id[it->it_n - (fix->fix_i + i + 1)];
+
+  fix->fix_i += n;
+  *n_out = n;
+
+  *cost_inout -= n * PDB_COST_FUNCTION_CALL;
+  pdb_iterator_account_charge(pdb, it, next, n, n * PDB_COST_FUNCTION_CALL);
+  pdb_rxs_log(pdb, "NEXT-BATCH %p fixed %llx..%llx (%zu) ($%lld)", (void *)it,
+              (unsigned long long)id_out[0], (unsigned long long)id_out[n - 1],
+              n, (long long)(n * PDB_COST_FUNCTION_CALL));
+
+  return fix->fix_i >= it->it_n ? GRAPHD_ERR_NO : 0;
+}
+
+/*  Sorted input is merged against the fixed array; anything
+ *  else is checked one by one.
+ */
+static int fixed_iterator_check_batch(pdb_handle *pdb, pdb_iterator *it,
+                                      pdb_id const *id_in, size_t n_in,
+                                      size_t *n_in_done, pdb_id *id_out,
+                                      size_t *n_out, pdb_budget *cost_inout) {
+  pdb_id const *fix_id = ofix(it)->fix_base->fb_id;
+  pdb_budget cost;
+  size_t i, j;
+
+  if (n_in < 2 || !pdb_iterator_batch_is_ascending(id_in, n_in))
+    return pdb_iterator_check_batch_loop(pdb, it, fixed_iterator_check, id_in,
+                                         n_in, n_in_done, id_out, n_out,
+                                         cost_inout);
+
+  cost = n_in * pdb_iterator_check_cost(pdb, it);
+  *cost_inout -= cost;
+  pdb_iterator_account_charge(pdb, it, check, n_in,
+                              n_in * PDB_COST_FUNCTION_CALL);
+
+  *n_out = 0;
+  for (i = j = 0; i < n_in && j < it->it_n;) {
+    if (id_in[i] < fix_id[j])
+      i++;
+    else if (id_in[i] > fix_id[j])
+      j++;
+    else {
+      if (id_in[i] >= it->it_low && id_in[i] < it->it_high)
+        id_out[(*n_out)++] = id_in[i];
+      i++;
+      j++;
+    }
+  }
+  *n_in_done = n_in;
+
+  pdb_rxs_log(pdb, "CHECK-BATCH %p fixed %zu -> %zu ($%lld)", (void *)it, n_in,
+              *n_out, (long long)cost);
+  return 0;
+}
+
 static int fixed_iterator_thaw_local_state(graphd_handle *g, char const **s_ptr,
                                            char const *e,
                                            graphd_iterator_fixed **fix_out,
@@ -802,8 +904,10 @@ static const pdb_iterator_type fixed_iterator_type = {
     NULL, /* restrict */
 
     NULL, /* suspend */
-    NULL  /* unsuspend */
-};
+    NULL, /* unsuspend */
+
+    fixed_iterator_next_batch,
+    fixed_iterator_check_batch};
 
 /**
  * @brief Create an iterator that dispenses a fixed set of indices.
@@ -1686,6 +1790,17 @@ int graphd_iterator_fixed_set_masquerade(pdb_iterator *it, char const *mas) {
   return 0;
 }
 
+/*  Charge the fixed iterator's stored ids with <cost>, the budget
+ *  it took to compute them, so that they're evicted from the
+ *  resource cache only after cheaper resources.
+ */
+void graphd_iterator_fixed_cost_add(pdb_iterator *it, pdb_budget cost) {
+  it = it->it_original;
+  if (it->it_type != &fixed_iterator_type) return;
+
+  graphd_storable_cost_add(ofix(it)->fix_base, cost);
+}
+
 /*  Given some other iterator, pull out its contents and turn them
  *  into a fixed iterator.
  *
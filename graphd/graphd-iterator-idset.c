@@ -677,3 +677,18 @@ static int idset_recover(pdb_iterator *it, pdb_budget *budget_inout) {
   }
   return 0;
 }
+
+/**
+ * @brief Create an empty idset for one of the islink or isa caches.
+ *
+ *  Depending on the "idset" property, that's a roaring set
+ *  (compact for dense populations, fast to intersect) or
+ *  a tile set (cheaper for very sparse ones).
+ *
+ * @param g	server handle
+ * @return NULL on allocation error, otherwise a new, empty set.
+ */
+graph_idset *graphd_idset_create(graphd_handle *g) {
+  return g->g_idset_roaring ? graph_idset_roaring_create(g->g_graph)
+                            : graph_idset_tile_create(g->g_graph);
+}
@@ -0,0 +1,365 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+#include "graphd/graphd-iterator-isa.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*  The is-a bitmap is a duplicate detector for is-a iterators
+ *  whose results are dense in a range of ids: one bit per id,
+ *  starting at ib_low, set once the id has been returned.
+ *
+ *  Unlike the isa-storable, it doesn't remember the order in
+ *  which the ids were returned, and so can't be shared between
+ *  iterators at different positions.  Each iterator owns one;
+ *  clones and the resource cache share it copy-on-write.
+ */
+
+/*  Grow the bitmap by at least this many bytes at a time.
+ */
+#define ISA_BITMAP_CHUNK (4 * 1024)
+
+#define ISA_BITMAP_BITS (8 * sizeof(unsigned long long))
+
+/*  Bitmaps whose text form is at most this many bytes are frozen
+ *  into the cursor itself; larger ones go into the resource cache.
+ */
+#define ISA_BITMAP_INLINE_MAX 256
+
+struct graphd_iterator_isa_bitmap {
+  graphd_storable ib_storable;
+
+  graphd_handle *ib_g;
+
+  /*  The id that corresponds to bit 0 of ib_word[0];
+   *  a multiple of ISA_BITMAP_BITS.
+   */
+  pdb_id ib_low;
+
+  /*  ib_m words allocated, of which ib_n may have bits set.
+   */
+  unsigned long long *ib_word;
+  size_t ib_n;
+  size_t ib_m;
+
+  /*  Number of bits set.
+   */
+  size_t ib_count;
+};
+
+static unsigned long isa_bitmap_hash(void const *data) {
+  return (unsigned long)(intptr_t)data;
+}
+
+static void isa_bitmap_destroy(void *data) {
+  graphd_iterator_isa_bitmap *ib = data;
+  cm_handle *cm = ib->ib_g->g_cm;
+
+  cl_log(ib->ib_g->g_cl, CL_LEVEL_VERBOSE, "isa_bitmap_destroy ib=%p",
+         (void *)ib);
+
+  if (ib->ib_word != NULL) cm_free(cm, ib->ib_word);
+  cm_free(cm, ib);
+}
+
+static bool isa_bitmap_equal(void const *A, void const *B) { return A == B; }
+
+/*  Shared copy: the 8-byte low id, followed by the words in
+ *  host byte order.  (The shared segment never leaves the host.)
+ */
+static int isa_bitmap_export(void const *data, cm_buffer *buf) {
+  graphd_iterator_isa_bitmap const *ib = data;
+  unsigned long long low = ib->ib_low;
+  int err;
+
+  err = cm_buffer_add_bytes(buf, (char const *)&low, sizeof low);
+  if (err != 0) return err;
+
+  return cm_buffer_add_bytes(buf, (char const *)ib->ib_word,
+                             ib->ib_n * sizeof(*ib->ib_word));
+}
+
+static void *isa_bitmap_import(graphd_handle *g, char const *s, size_t n) {
+  graphd_iterator_isa_bitmap *ib;
+  unsigned long long low;
+  size_t i;
+
+  if (n < sizeof low || (n - sizeof low) % sizeof(*ib->ib_word) != 0)
+    return NULL;
+
+  memcpy(&low, s, sizeof low);
+  if (low % ISA_BITMAP_BITS != 0) return NULL;
+
+  if ((ib = graphd_iterator_isa_bitmap_alloc(g, low)) == NULL) return NULL;
+
+  ib->ib_n = ib->ib_m = (n - sizeof low) / sizeof(*ib->ib_word);
+  if (ib->ib_m > 0) {
+    ib->ib_word = cm_malloc(g->g_cm, ib->ib_m * sizeof(*ib->ib_word));
+    if (ib->ib_word == NULL) {
+      graphd_storable_unlink(ib);
+      return NULL;
+    }
+    memcpy(ib->ib_word, s + sizeof low, ib->ib_m * sizeof(*ib->ib_word));
+    graphd_storable_size_add(g, ib, ib->ib_m * sizeof(*ib->ib_word));
+  }
+  for (i = 0; i < ib->ib_n; i++)
+    ib->ib_count += __builtin_popcountll(ib->ib_word[i]);
+
+  return ib;
+}
+
+static const graphd_storable_type isa_bitmap_type = {
+    "is-a duplicate bitmap", isa_bitmap_destroy, isa_bitmap_equal,
+    isa_bitmap_hash,         isa_bitmap_export,  isa_bitmap_import};
+
+/*  Create a fresh, empty is-a bitmap for ids starting at LOW.
+ *
+ *  A successful call transfers one reference to the caller.
+ */
+graphd_iterator_isa_bitmap *graphd_iterator_isa_bitmap_alloc(graphd_handle *g,
+                                                             pdb_id low) {
+  graphd_iterator_isa_bitmap *ib;
+
+  ib = cm_malloc(g->g_cm, sizeof(*ib));
+  if (ib == NULL) return NULL;
+
+  memset(ib, 0, sizeof(*ib));
+
+  ib->ib_storable.gs_linkcount = 1;
+  ib->ib_storable.gs_type = &isa_bitmap_type;
+  ib->ib_storable.gs_size = sizeof(*ib);
+
+  ib->ib_g = g;
+  ib->ib_low = low - low % ISA_BITMAP_BITS;
+
+  cl_log(g->g_cl, CL_LEVEL_VERBOSE,
+         "graphd_iterator_isa_bitmap_alloc ib=%p, low=%llx", (void *)ib,
+         (unsigned long long)ib->ib_low);
+  return ib;
+}
+
+/*  Make *IB_PTR safe to modify: if someone else -- a clone,
+ *  or the resource cache -- is holding on to it, replace
+ *  our reference with a private copy.
+ */
+static int isa_bitmap_unshare(graphd_handle *g,
+                              graphd_iterator_isa_bitmap **ib_ptr) {
+  graphd_iterator_isa_bitmap *ib = *ib_ptr, *copy;
+
+  if (ib->ib_storable.gs_linkcount <= 1) return 0;
+
+  copy = graphd_iterator_isa_bitmap_alloc(g, ib->ib_low);
+  if (copy == NULL) return errno ? errno : ENOMEM;
+
+  if (ib->ib_n > 0) {
+    copy->ib_word = cm_malloc(g->g_cm, ib->ib_n * sizeof(*ib->ib_word));
+    if (copy->ib_word == NULL) {
+      graphd_storable_unlink(copy);
+      return errno ? errno : ENOMEM;
+    }
+    memcpy(copy->ib_word, ib->ib_word, ib->ib_n * sizeof(*ib->ib_word));
+    copy->ib_n = copy->ib_m = ib->ib_n;
+    graphd_storable_size_add(g, copy, ib->ib_n * sizeof(*ib->ib_word));
+  }
+  copy->ib_count = ib->ib_count;
+
+  graphd_storable_unlink(ib);
+  *ib_ptr = copy;
+
+  return 0;
+}
+
+/*  Add ID to the bitmap in *IB_PTR, allocating the bitmap (for
+ *  ids from LOW on) if it doesn't exist yet.  If the ID was new,
+ *  set *added_out to true; if it was already there, to false.
+ *
+ *  Returns 0 on success, a nonzero error code on allocation error.
+ */
+int graphd_iterator_isa_bitmap_add(graphd_handle *g,
+                                   graphd_iterator_isa_bitmap **ib_ptr,
+                                   pdb_id low, pdb_id id, bool *added_out) {
+  graphd_iterator_isa_bitmap *ib;
+  unsigned long long bit;
+  size_t word;
+  int err;
+
+  if (*ib_ptr == NULL &&
+      (*ib_ptr = graphd_iterator_isa_bitmap_alloc(g, low)) == NULL)
+    return errno ? errno : ENOMEM;
+
+  if (graphd_iterator_isa_bitmap_check(*ib_ptr, id)) {
+    *added_out = false;
+    return 0;
+  }
+  if ((err = isa_bitmap_unshare(g, ib_ptr)) != 0) return err;
+
+  ib = *ib_ptr;
+  cl_assert(g->g_cl, id >= ib->ib_low);
+
+  word = (id - ib->ib_low) / ISA_BITMAP_BITS;
+  bit = 1ull << ((id - ib->ib_low) % ISA_BITMAP_BITS);
+
+  if (word >= ib->ib_m) {
+    unsigned long long *tmp;
+    size_t m = ib->ib_m * 2;
+
+    if (m < ISA_BITMAP_CHUNK / sizeof(*ib->ib_word))
+      m = ISA_BITMAP_CHUNK / sizeof(*ib->ib_word);
+    if (m <= word) m = word + ISA_BITMAP_CHUNK / sizeof(*ib->ib_word);
+
+    tmp = cm_realloc(g->g_cm, ib->ib_word, m * sizeof(*ib->ib_word));
+    if (tmp == NULL) return errno ? errno : ENOMEM;
+
+    graphd_storable_size_add(g, ib, (m - ib->ib_m) * sizeof(*ib->ib_word));
+    ib->ib_word = tmp;
+    ib->ib_m = m;
+  }
+  if (word >= ib->ib_n) {
+    memset(ib->ib_word + ib->ib_n, 0,
+           (word + 1 - ib->ib_n) * sizeof(*ib->ib_word));
+    ib->ib_n = word + 1;
+  }
+
+  ib->ib_word[word] |= bit;
+  ib->ib_count++;
+  *added_out = true;
+
+  return 0;
+}
+
+/*  Is ID in the bitmap?
+ */
+bool graphd_iterator_isa_bitmap_check(graphd_iterator_isa_bitmap const *ib,
+                                      pdb_id id) {
+  size_t word;
+
+  if (ib == NULL || id < ib->ib_low) return false;
+
+  word = (id - ib->ib_low) / ISA_BITMAP_BITS;
+  if (word >= ib->ib_n) return false;
+
+  return (ib->ib_word[word] >> ((id - ib->ib_low) % ISA_BITMAP_BITS)) & 1;
+}
+
+/*  Was this bitmap allocated for an iterator that starts at <low>?
+ *  (A bitmap thawed from a cursor may not have been.)
+ */
+bool graphd_iterator_isa_bitmap_fits(graphd_iterator_isa_bitmap const *ib,
+                                     pdb_id low) {
+  return ib->ib_low == low - low % ISA_BITMAP_BITS;
+}
+
+/*  How many ids are in the bitmap?
+ */
+size_t graphd_iterator_isa_bitmap_nelems(
+    graphd_iterator_isa_bitmap const *ib) {
+  return ib == NULL ? 0 : ib->ib_count;
+}
+
+/*  Freeze a bitmap: either "@STAMP", a reference to the resource
+ *  cache, or, if it's small enough, LOW:WORD,WORD,... in hex, with
+ *  zero words left empty.
+ */
+int graphd_iterator_isa_bitmap_freeze(graphd_handle *g,
+                                      graphd_iterator_isa_bitmap *ib,
+                                      cm_buffer *buf) {
+  char stamp[GRAPHD_ITERATOR_RESOURCE_STAMP_SIZE];
+  size_t i, size = 0;
+  int err;
+
+  for (i = 0; i < ib->ib_n && size <= ISA_BITMAP_INLINE_MAX; i++)
+    size += 1 + (ib->ib_word[i] == 0
+                     ? 0
+                     : (ISA_BITMAP_BITS - __builtin_clzll(ib->ib_word[i]) + 3) /
+                           4);
+
+  if (size > ISA_BITMAP_INLINE_MAX) {
+    err = graphd_iterator_resource_store(g, (graphd_storable *)ib, stamp,
+                                         sizeof stamp);
+    if (err != 0) return err;
+    return cm_buffer_sprintf(buf, "@%s", stamp);
+  }
+
+  err = cm_buffer_sprintf(buf, "%llx:", (unsigned long long)ib->ib_low);
+  for (i = 0; err == 0 && i < ib->ib_n; i++) {
+    if (i > 0) err = cm_buffer_add_string(buf, ",");
+    if (err == 0 && ib->ib_word[i] != 0)
+      err = cm_buffer_sprintf(buf, "%llx", ib->ib_word[i]);
+  }
+  return err;
+}
+
+static bool isa_bitmap_scan_hex(char const **s_ptr, char const *e,
+                                unsigned long long *ull_out) {
+  char const *s = *s_ptr;
+  unsigned long long ull = 0;
+
+  for (; s < e && isascii(*s) && isxdigit(*s); s++) {
+    if (s - *s_ptr >= 16) return false;
+    ull = (ull << 4) |
+          (isdigit(*s) ? *s - '0' : (tolower(*s) - 'a' + 10));
+  }
+  *s_ptr = s;
+  *ull_out = ull;
+
+  return true;
+}
+
+/*  Thaw a bitmap frozen by graphd_iterator_isa_bitmap_freeze().
+ *
+ *  Return NULL or a fresh reference to the saved state.
+ */
+graphd_iterator_isa_bitmap *graphd_iterator_isa_bitmap_thaw(graphd_handle *g,
+                                                            char const **s_ptr,
+                                                            char const *e) {
+  graphd_iterator_isa_bitmap *ib;
+  unsigned long long low, word;
+  char const *s = *s_ptr;
+  bool added;
+  int err = 0;
+
+  if (s < e && *s == '@') {
+    ++*s_ptr;
+    return graphd_iterator_resource_thaw(g, s_ptr, e, &isa_bitmap_type);
+  }
+
+  if (!isa_bitmap_scan_hex(&s, e, &low) || s >= e || *s++ != ':' ||
+      low % ISA_BITMAP_BITS != 0)
+    return NULL;
+
+  if ((ib = graphd_iterator_isa_bitmap_alloc(g, low)) == NULL) return NULL;
+
+  for (; err == 0 && s < e; low += ISA_BITMAP_BITS) {
+    if (!isa_bitmap_scan_hex(&s, e, &word)) {
+      err = GRAPHD_ERR_LEXICAL;
+      break;
+    }
+    for (; err == 0 && word != 0; word &= word - 1)
+      err = graphd_iterator_isa_bitmap_add(
+          g, &ib, low, low + __builtin_ctzll(word), &added);
+    if (err == 0 && s < e && *s++ != ',') err = GRAPHD_ERR_LEXICAL;
+  }
+  if (err != 0) {
+    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "graphd_iterator_isa_bitmap_thaw",
+                 err, "can't thaw \"%.*s\"", (int)(e - *s_ptr), *s_ptr);
+    graphd_storable_unlink(ib);
+    return NULL;
+  }
+  *s_ptr = s;
+  return ib;
+}
@@ -87,9 +87,44 @@ static void isa_storable_destroy(void *data) {
 
 static bool isa_storable_equal(void const *A, void const *B) { return A == B; }
 
+/*  Shared copy: "e" or "-" for eof, followed by the 5-byte IDs in
+ *  the order they were added.
+ */
+static int isa_storable_export(void const *data, cm_buffer *buf) {
+  graphd_iterator_isa_storable const *is = data;
+  int err;
+
+  err = cm_buffer_add_bytes(buf, is->is_eof ? "e" : "-", 1);
+  if (err != 0) return err;
+
+  return cm_buffer_add_bytes(buf, (char const *)is->is_offset_to_id,
+                             is->is_offset_to_id_n);
+}
+
+static void *isa_storable_import(graphd_handle *g, char const *s, size_t n) {
+  graphd_iterator_isa_storable *is;
+  size_t i;
+
+  if (n < 1 || (n - 1) % 5 != 0) return NULL;
+  if ((is = graphd_iterator_isa_storable_alloc(g)) == NULL) return NULL;
+
+  for (i = 0; i < (n - 1) / 5; i++)
+    if (graphd_iterator_isa_storable_add(g, is, i, get5(s + 1 + 5 * i)) != 0) {
+      graphd_storable_unlink(is);
+      return NULL;
+    }
+  is->is_eof = (*s == 'e');
+
+  return is;
+}
+
 static const graphd_storable_type isa_storable_type = {
-    "is-a duplicate detector & cache", isa_storable_destroy, isa_storable_equal,
-    isa_storable_hash};
+    "is-a duplicate detector & cache",
+    isa_storable_destroy,
+    isa_storable_equal,
+    isa_storable_hash,
+    isa_storable_export,
+    isa_storable_import};
 
 bool graphd_iterator_isa_storable_complete(graphd_iterator_isa_storable *is) {
   return is->is_eof;
@@ -177,7 +212,7 @@ graphd_iterator_isa_storable *graphd_iterator_isa_storable_alloc(
 
   memset(is, 0, sizeof(*is));
 
-  is->is_ids = graph_idset_tile_create(g->g_graph);
+  is->is_ids = graphd_idset_create(g);
   if (is->is_ids == NULL) {
     cm_free(g->g_cm, is);
     return NULL;
@@ -313,8 +348,11 @@ int graphd_iterator_isa_storable_run(graphd_handle *g, pdb_iterator *it,
   if (is->is_eof) return GRAPHD_ERR_NO;
 
   while (*budget_inout >= 0) {
+    pdb_budget const budget_next = *budget_inout;
+
     err = graphd_iterator_isa_run_next(g, it, sub, linkage, NULL, &id,
                                        budget_inout, false);
+    graphd_storable_cost_add(is, budget_next - *budget_inout);
     if (err != 0) {
       if (err == GRAPHD_ERR_NO) {
         is->is_eof = true;
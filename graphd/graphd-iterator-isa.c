@@ -58,6 +58,19 @@ GRAPHD_SABOTAGE_DECL;
 #define GRAPHD_STORABLE_HUGE(hint) \
   (1024 * (hint & GRAPHD_ITERATOR_ISA_HINT_CURSOR ? 512 : 2 * 1024))
 
+/*  Bytes per result in the storable cache: 5 for the ordered
+ *  id, at least 8 for the idset entry.
+ */
+#define GRAPHD_STORABLE_BYTES_PER_ID 13
+
+/*  Use a bitmap if an estimated N results spread over SPAN ids take
+ *  up less space as bits than they would in the storable.  The
+ *  bitmap must also be small enough to save in the resource cache.
+ */
+#define GRAPHD_ISA_BITMAP_DENSE(n, span)             \
+  ((span) / 8 < (n)*GRAPHD_STORABLE_BYTES_PER_ID && \
+   (span) / 8 < GRAPHD_ITERATOR_RESOURCE_MAX)
+
 /*  If a thawed iterator doesn't contain a hint, we treat it as this:
  */
 #define GRAPHD_ITERATOR_ISA_HINT_DEFAULT GRAPHD_ITERATOR_ISA_HINT_CURSOR
@@ -70,8 +83,10 @@ GRAPHD_SABOTAGE_DECL;
  *
  *	Nevertheless, one primitive must only be returned once.
  *
- * 	There are two ways of doing this: a fast way that takes up memory,
- *	and a slow way that requires the subiterator to be sorted.
+ * 	There are three ways of doing this: a fast way that takes up memory,
+ *	a slow way that requires the subiterator to be sorted, and,
+ *	if the results are dense in their id range, a bitmap of the
+ *	ids returned so far.
  */
 typedef struct isa_duplicate_test {
   /**
@@ -114,10 +129,18 @@ typedef struct isa_duplicate_test {
    */
   int dt_n_ok;
 
+  /**
+   * @brief The bitmap check uses this: one bit for each id
+   *	this iterator has returned.  NULL until the first id.
+   *	Shared copy-on-write with clones and the resource cache.
+   */
+  graphd_iterator_isa_bitmap *dt_bitmap;
+
   enum {
     ISA_DT_METHOD_UNSPECIFIED = 0,
     ISA_DT_METHOD_STORABLE = 1,
-    ISA_DT_METHOD_INTERSECT = 2
+    ISA_DT_METHOD_INTERSECT = 2,
+    ISA_DT_METHOD_BITMAP = 3
   } dt_method;
 
 } isa_duplicate_test;
@@ -411,8 +434,7 @@ int graphd_iterator_isa_run_next(graphd_handle *g, pdb_iterator *it,
   pdb_budget budget_in_rxs = *budget_inout;
 
   while (*budget_inout >= 0) {
-    pdb_primitive pr;
-    graph_guid guid;
+    pdb_id linkage_id;
 
     err = pdb_iterator_next(g->g_pdb, sub, &id, budget_inout);
     if (err != 0) {
@@ -446,17 +468,16 @@ int graphd_iterator_isa_run_next(graphd_handle *g, pdb_iterator *it,
       continue;
     }
 
-    err = pdb_id_read(g->g_pdb, id, &pr);
+    err = pdb_column_linkage(g->g_pdb, id, linkage, &linkage_id);
     if (err != 0) {
-      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_read", err, "id=%llx",
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_column_linkage", err, "id=%llx",
                    (unsigned long long)id);
       if (err == GRAPHD_ERR_NO) continue;
       return err;
     }
 
     *budget_inout -= PDB_COST_PRIMITIVE;
-    if (!pdb_primitive_has_linkage(&pr, linkage)) {
-      pdb_primitive_finish(g->g_pdb, &pr);
+    if (linkage_id == PDB_ID_NONE) {
       if (log_rxs) {
         cl_log(cl, CL_LEVEL_DEBUG, "RXS: ISA: %llx skip (no linkage) ($%lld)",
                (unsigned long long)id, budget_in_rxs - *budget_inout);
@@ -464,16 +485,7 @@ int graphd_iterator_isa_run_next(graphd_handle *g, pdb_iterator *it,
       }
       continue;
     }
-    pdb_primitive_linkage_get(&pr, linkage, guid);
-    pdb_primitive_finish(g->g_pdb, &pr);
-
-    err = pdb_id_from_guid(g->g_pdb, &id, &guid);
-    if (err != 0) {
-      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_from_guid", err, "guid=%s",
-                   graph_guid_to_string(&guid, buf, sizeof buf));
-      if (err == GRAPHD_ERR_NO) continue;
-      return err;
-    }
+    id = linkage_id;
 
     if (id < it->it_low || id >= it->it_high) {
       if (log_rxs) {
@@ -773,9 +785,7 @@ static int isa_become_small_set(graphd_handle *g, int linkage,
   pdb_handle *pdb = g->g_pdb;
   cl_handle *cl = g->g_cl;
   pdb_budget budget = GRAPHD_ISA_INLINE_BUDGET_TOTAL;
-  pdb_primitive pr;
-  pdb_id *w;
-  graph_guid guid;
+  pdb_id *w, linkage_id;
   char buf[200];
   pdb_id sub_ids[GRAPHD_ISA_INLINE_BUDGET_TOTAL / PDB_COST_PRIMITIVE + 1];
   pdb_iterator *sub_clone;
@@ -807,24 +817,21 @@ static int isa_become_small_set(graphd_handle *g, int linkage,
       return err;
     }
 
-    /*  Get the primitive for the ID.
+    /*  Get the linkage of the ID, as a local ID.
      */
-    if ((err = pdb_id_read(pdb, *w, &pr)) == GRAPHD_ERR_NO) {
-      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_read", err,
-                   "can't read primitive for %llx "
-                   "(ignored)",
-                   (unsigned long long)*w);
+    if ((err = pdb_column_linkage(pdb, *w, linkage, &linkage_id)) ==
+        GRAPHD_ERR_NO) {
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_column_linkage", err,
+                   "can't resolve <-%s(%llx) (ignored)",
+                   pdb_linkage_to_string(linkage), (unsigned long long)*w);
       continue;
     } else if (err != 0) {
-      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_read", err,
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_column_linkage", err,
                    "cannot read subprimitive %llx", (unsigned long long)*w);
       pdb_iterator_destroy(pdb, &sub_clone);
       return err;
     }
-
-    /*  Get the linkage GUID from the primitive.
-     */
-    if (!pdb_primitive_has_linkage(&pr, linkage)) {
+    if (linkage_id == PDB_ID_NONE) {
       cl_log(cl, CL_LEVEL_VERBOSE,
              "pdb_iterator_next_nonstep: %llx "
              "doesn't have our linkage",
@@ -833,30 +840,9 @@ static int isa_become_small_set(graphd_handle *g, int linkage,
       /*  No error; some primitives just
        *  don't have our linkage.  Skip them.
        */
-      pdb_primitive_finish(pdb, &pr);
       continue;
     }
-
-    pdb_primitive_linkage_get(&pr, linkage, guid);
-    pdb_primitive_finish(pdb, &pr);
-
-    /*  Convert the linkage GUID into a local ID.
-     */
-    err = pdb_id_from_guid(pdb, w, &guid);
-    if (err == GRAPHD_ERR_NO) {
-      cl_log(cl, CL_LEVEL_FAIL,
-             "isa_become_small_set: "
-             "cannot resolve guid %s for <-%s"
-             "(%llx) as a local ID. (Skipped.)",
-             graph_guid_to_string(&guid, buf, sizeof buf),
-             pdb_linkage_to_string(linkage), (unsigned long long)*w);
-      continue;
-    } else if (err) {
-      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_from_guid", err, "guid=%s",
-                   graph_guid_to_string(&guid, buf, sizeof buf));
-      pdb_iterator_destroy(pdb, &sub_clone);
-      return err;
-    }
+    *w = linkage_id;
 
     if (*w >= low && *w < high)
       w++;
@@ -881,6 +867,8 @@ static int isa_become_small_set(graphd_handle *g, int linkage,
         g, sub_ids, (size_t)(w - sub_ids), low, high,
         direction != GRAPHD_DIRECTION_BACKWARD, it_out);
     if (err != 0) return err;
+    graphd_iterator_fixed_cost_add(*it_out,
+                                   GRAPHD_ISA_INLINE_BUDGET_TOTAL - budget);
 
     /*  The fixed iterator is sorted.
      *  If we're ordered ourselves, without
@@ -1147,12 +1135,16 @@ static void isa_dup_finish(pdb_handle *pdb, isa_duplicate_test *dt) {
   pdb_iterator_destroy(pdb, &dt->dt_fanin);
   pdb_iterator_destroy(pdb, &dt->dt_sub);
 
+  graphd_storable_unlink(dt->dt_bitmap);
+  dt->dt_bitmap = NULL;
+
   dt->dt_state = 0;
 }
 
 static int isa_dup_clear(isa_duplicate_test *dt) {
   dt->dt_fanin = NULL;
   dt->dt_sub = NULL;
+  dt->dt_bitmap = NULL;
   dt->dt_state = 0;
   dt->dt_n_ok = 0;
   dt->dt_method = ISA_DT_METHOD_UNSPECIFIED;
@@ -1177,6 +1169,11 @@ static int isa_dup_dup(pdb_handle *pdb, isa_duplicate_test const *in,
       out->dt_storable_position = in->dt_storable_position;
       return 0;
 
+    case ISA_DT_METHOD_BITMAP:
+      if ((out->dt_bitmap = in->dt_bitmap) != NULL)
+        graphd_storable_link(out->dt_bitmap);
+      return 0;
+
     case ISA_DT_METHOD_INTERSECT:
       if (in->dt_fanin != NULL) {
         err = pdb_iterator_clone(pdb, in->dt_fanin, &out->dt_fanin);
@@ -1213,9 +1210,21 @@ static int isa_dup_freeze(graphd_handle *g, pdb_iterator *it,
       (dt->dt_method == ISA_DT_METHOD_INTERSECT && dt->dt_state == 0) ||
       (dt->dt_method == ISA_DT_METHOD_STORABLE &&
        (oisa(it)->isa_cache == NULL ||
-        graphd_iterator_isa_storable_nelems(oisa(it)->isa_cache) == 0)))
+        graphd_iterator_isa_storable_nelems(oisa(it)->isa_cache) == 0)) ||
+      (dt->dt_method == ISA_DT_METHOD_BITMAP &&
+       graphd_iterator_isa_bitmap_nelems(dt->dt_bitmap) == 0))
     return cm_buffer_add_string(buf, "-");
 
+  if (dt->dt_method == ISA_DT_METHOD_BITMAP) {
+    /*  [bd:BITMAP] -- the subiterator position is
+     *  our own, and frozen with the rest of our state.
+     */
+    if ((err = cm_buffer_add_string(buf, "[bd:")) != 0 ||
+        (err = graphd_iterator_isa_bitmap_freeze(g, dt->dt_bitmap, buf)) != 0)
+      return err;
+    return cm_buffer_add_string(buf, "]");
+  }
+
   if (dt->dt_method == ISA_DT_METHOD_STORABLE) {
     /*  [sdup:(SUBPOS/SUBSTATE)@STORABLE]
      */
@@ -1266,11 +1275,14 @@ static void isa_dup_pick_method(pdb_handle *pdb, pdb_iterator *it) {
   graphd_iterator_isa *const isa = it->it_theory;
   cl_handle *const cl = isa->isa_cl;
   char buf[200];
-  unsigned long long n;
+  unsigned long long n, high;
 
   if (oisa(it)->isa_dup.dt_method != ISA_DT_METHOD_UNSPECIFIED) return;
 
-  /*  Use INTERSECT if
+  /*  Use BITMAP if
+   *	- our result set is dense within our id range
+   *
+   *  Use INTERSECT if
    *	- the subiterator is sorted
    *	- our result set is large
    *
@@ -1313,9 +1325,7 @@ static void isa_dup_pick_method(pdb_handle *pdb, pdb_iterator *it) {
           pdb_iterator_to_string(pdb, oisa(it)->isa_sub, buf, sizeof buf));
     else {
       while (budget > 0 && ar_n < sizeof(ar) / sizeof(*ar)) {
-        pdb_primitive pr;
         pdb_id sub_id, id;
-        graph_guid guid;
 
         /* Pull another value from the subiterator.
          */
@@ -1327,30 +1337,15 @@ static void isa_dup_pick_method(pdb_handle *pdb, pdb_iterator *it) {
          */
         if (sub_id < it->it_low) continue;
 
-        /*  Get the corresponding primitive.
-         */
-        err = pdb_id_read(pdb, sub_id, &pr);
-        if (err != 0) {
-          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_read", err, "sub_id=%llu",
-                       (unsigned long long)sub_id);
-          continue;
-        }
-
         /*  Go from the primitive to its linkage.
          */
-        if (!pdb_primitive_has_linkage(&pr, isa->isa_linkage)) {
-          pdb_primitive_finish(pdb, &pr);
-          continue;
-        }
-        pdb_primitive_linkage_get(&pr, isa->isa_linkage, guid);
-        pdb_primitive_finish(pdb, &pr);
-
-        err = pdb_id_from_guid(pdb, &id, &guid);
+        err = pdb_column_linkage(pdb, sub_id, isa->isa_linkage, &id);
         if (err != 0) {
-          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_from_guid", err, "guid=%s",
-                       graph_guid_to_string(&guid, buf, sizeof buf));
+          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_column_linkage", err,
+                       "sub_id=%llu", (unsigned long long)sub_id);
           continue;
         }
+        if (id == PDB_ID_NONE) continue;
 
         /*  If the result is out of range,
          *  throw it out.
@@ -1384,17 +1379,33 @@ static void isa_dup_pick_method(pdb_handle *pdb, pdb_iterator *it) {
           ? ISA_DT_METHOD_INTERSECT
           : ISA_DT_METHOD_STORABLE;
 
+  /*  Our results can't be newer than the database.
+   */
+  high = it->it_high;
+  if (high == PDB_ITERATOR_HIGH_ANY || high > pdb_primitive_n(pdb))
+    high = pdb_primitive_n(pdb);
+
+  if (high > it->it_low &&
+      GRAPHD_ISA_BITMAP_DENSE(
+          pdb_iterator_n_valid(pdb, it) ? pdb_iterator_n(pdb, it) : n,
+          high - it->it_low))
+    oisa(it)->isa_dup.dt_method = ISA_DT_METHOD_BITMAP;
+
   cl_log(cl, CL_LEVEL_VERBOSE,
          "isa %s: dup method %s (sub sorted valid? %d, sub sorted? %d,  n "
-         "valid? %d, n? %llu, sub n? %llu)",
+         "valid? %d, n? %llu, sub n? %llu, span? %llu)",
          pdb_iterator_to_string(pdb, it, buf, sizeof buf),
-         oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_INTERSECT ? "intersect"
-                                                                : "storable",
+         oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_INTERSECT
+             ? "intersect"
+             : (oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_BITMAP
+                    ? "bitmap"
+                    : "storable"),
          pdb_iterator_sorted_valid(pdb, oisa(it)->isa_sub),
          pdb_iterator_sorted(pdb, oisa(it)->isa_sub),
          pdb_iterator_n_valid(pdb, it),
          (unsigned long long)pdb_iterator_n(pdb, it),
-         (unsigned long long)pdb_iterator_n(pdb, oisa(it)->isa_sub));
+         (unsigned long long)pdb_iterator_n(pdb, oisa(it)->isa_sub),
+         high > it->it_low ? high - it->it_low : 0);
 }
 
 /*  Thaw the duplicate detector state.  Possible outcomes:
@@ -1435,6 +1446,49 @@ static int isa_dup_thaw(graphd_handle *g, pdb_iterator *it, char const **s_ptr,
              "don't support @... "
              "anymore; please recover");
     return GRAPHD_ERR_NO;
+  } else if (*s == '[' && e - s >= 4 && strncasecmp(s, "[bd:", 4) == 0) {
+    char const *s0 = s, *bd_e;
+
+    *s_ptr += sizeof("[bd:") - 1;
+
+    graphd_storable_unlink(dt->dt_bitmap);
+    dt->dt_bitmap = NULL;
+
+    if ((bd_e = memchr(*s_ptr, ']', e - *s_ptr)) == NULL) {
+      cl_log(g->g_cl, loglevel,
+             "isa_dup_thaw: expected "
+             "[bd:BITMAP], got \"%.*s\"",
+             (int)(e - s0), s0);
+      cl_leave(g->g_cl, CL_LEVEL_VERBOSE, "missing ]");
+      return GRAPHD_ERR_LEXICAL;
+    }
+    dt->dt_bitmap = graphd_iterator_isa_bitmap_thaw(g, s_ptr, bd_e);
+    dt->dt_method = ISA_DT_METHOD_BITMAP;
+    *s_ptr = bd_e + 1;
+
+    if (dt->dt_bitmap == NULL) {
+      /*  Rebuild the bitmap by replaying up to our
+       *  last returned id.
+       */
+      cl_leave(g->g_cl, CL_LEVEL_VERBOSE, "can't get bitmap");
+      return GRAPHD_ERR_NO;
+    }
+
+    /*  A stale or foreign cursor may carry a bitmap that
+     *  doesn't cover our range.  Rebuild it instead.
+     */
+    if (!graphd_iterator_isa_bitmap_fits(dt->dt_bitmap, it->it_low)) {
+      cl_log(g->g_cl, loglevel,
+             "isa_dup_thaw: bitmap doesn't match "
+             "low %llx; rebuilding",
+             (unsigned long long)it->it_low);
+
+      graphd_storable_unlink(dt->dt_bitmap);
+      dt->dt_bitmap = NULL;
+
+      cl_leave(g->g_cl, CL_LEVEL_VERBOSE, "bitmap low mismatch");
+      return GRAPHD_ERR_NO;
+    }
   } else if (*s == '[' && e - s >= 4 && strncasecmp(s, "[sd:", 4) == 0) {
     char const *s0 = s, *sdup_e;
 
@@ -2043,6 +2097,9 @@ static int isa_reset(pdb_handle *pdb, pdb_iterator *it) {
   pdb_iterator_destroy(pdb, &isa->isa_dup.dt_fanin);
   pdb_iterator_destroy(pdb, &isa->isa_dup.dt_sub);
 
+  graphd_storable_unlink(isa->isa_dup.dt_bitmap);
+  isa->isa_dup.dt_bitmap = NULL;
+
   isa->isa_dup.dt_storable_position = 0;
   isa->isa_dup.dt_id = PDB_ID_NONE;
   isa->isa_dup.dt_state = 0;
@@ -2810,6 +2867,13 @@ static int isa_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
           err = GRAPHD_ERR_NO;
           goto done;
         }
+      } else if (isa->isa_dup.dt_method == ISA_DT_METHOD_BITMAP &&
+                 graphd_iterator_isa_bitmap_check(isa->isa_dup.dt_bitmap,
+                                                  check_id)) {
+        cl_log(cl, CL_LEVEL_VERBOSE, "isa_check: %llx is in the bitmap",
+               (unsigned long long)check_id);
+        err = 0;
+        goto done;
       }
 
       /* (Re)initialize the cached fanin.
@@ -3232,13 +3296,65 @@ static int isa_next_cached(pdb_handle *pdb, pdb_iterator *it, pdb_id *id_out,
   return 0;
 }
 
+/*  Pull the next id out of the subiterator that isn't yet
+ *  in our bitmap of returned ids.
+ *
+ *  If we're replaying up to a resume ID (because we lost our
+ *  bitmap in a freeze/thaw cycle), the ids up to and including
+ *  it only go into the bitmap.
+ */
+static int isa_next_bitmap(pdb_handle *pdb, pdb_iterator *it, pdb_id *id_out,
+                           pdb_budget *budget_inout) {
+  graphd_iterator_isa *isa = it->it_theory;
+  graphd_handle *g = isa->isa_graphd;
+  cl_handle *cl = isa->isa_cl;
+  pdb_budget budget_in = *budget_inout;
+  bool added;
+  pdb_id id;
+  int err;
+
+  *budget_inout -= PDB_COST_FUNCTION_CALL;
+  if (isa->isa_eof) return GRAPHD_ERR_NO;
+
+  for (;;) {
+    err = graphd_iterator_isa_run_next(g, it, isa->isa_sub, isa->isa_linkage,
+                                       NULL, &id, budget_inout, false);
+    if (err != 0) {
+      if (err == GRAPHD_ERR_NO) isa->isa_eof = true;
+      break;
+    }
+
+    err = graphd_iterator_isa_bitmap_add(g, &isa->isa_dup.dt_bitmap,
+                                         it->it_low, id, &added);
+    if (err != 0) {
+      cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_iterator_isa_bitmap_add", err,
+                   "id=%llx", (unsigned long long)id);
+      break;
+    }
+    if (added) {
+      if (isa->isa_resume_id == PDB_ID_NONE) {
+        *id_out = id;
+        break;
+      }
+      if (id == isa->isa_resume_id) isa->isa_resume_id = PDB_ID_NONE;
+    }
+    if (GRAPHD_SABOTAGE(g, *budget_inout <= 0)) {
+      err = PDB_ERR_MORE;
+      break;
+    }
+  }
+
+  cl_log(cl, CL_LEVEL_VERBOSE, "isa_next_bitmap: %s ($%lld)",
+         err == 0 ? "ok" : graphd_strerror(err),
+         (long long)(budget_in - *budget_inout));
+  return err;
+}
+
 static int isa_next_intersect(pdb_handle *pdb, pdb_iterator *it, pdb_id *id_out,
                               pdb_budget *budget_inout) {
   graphd_iterator_isa *isa = it->it_theory;
   cl_handle *cl = isa->isa_cl;
   int err;
-  graph_guid guid;
-  pdb_primitive pr;
   bool is_duplicate;
   char buf[200];
 
@@ -3321,34 +3437,19 @@ static int isa_next_intersect(pdb_handle *pdb, pdb_iterator *it, pdb_id *id_out,
         RESUME_STATE(it, 2)
         *budget_inout -= PDB_COST_PRIMITIVE;
 
-        /*  Read the primitive our subiterator returned.
+        /*  Go from the primitive our subiterator returned
+         *  to its linkage.
          */
         cl_assert(isa->isa_cl, isa->isa_sub_source != PDB_ID_NONE);
-        err = pdb_id_read(pdb, isa->isa_sub_source, &pr);
+        err = pdb_column_linkage(pdb, isa->isa_sub_source, isa->isa_linkage,
+                                 &isa->isa_next_tmp);
         if (err == GRAPHD_ERR_NO) continue;
         if (err != 0) {
-          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_read", err, "id=%lld",
-                       (long long)isa->isa_sub_source);
+          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_column_linkage", err,
+                       "id=%lld", (long long)isa->isa_sub_source);
           goto done;
         }
-
-        /*  Go from the primitive to its linkage.
-         */
-        if (!pdb_primitive_has_linkage(&pr, isa->isa_linkage)) {
-          pdb_primitive_finish(pdb, &pr);
-          continue;
-        }
-        pdb_primitive_linkage_get(&pr, isa->isa_linkage, guid);
-        pdb_primitive_finish(pdb, &pr);
-
-        /*  Convert the linkage GUID to an ID
-         */
-        err = pdb_id_from_guid(pdb, &isa->isa_next_tmp, &guid);
-        if (err == GRAPHD_ERR_NO)
-          continue;
-
-        else if (err != 0)
-          goto done;
+        if (isa->isa_next_tmp == PDB_ID_NONE) continue;
 
         cl_assert(cl, isa->isa_next_tmp != PDB_ID_NONE);
         RESUME_STATE(it, 3)
@@ -3472,6 +3573,10 @@ static int isa_next_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id *id_out,
     err = isa_next_cached(pdb, it, &isa->isa_next_tmp, budget_inout);
     goto done;
   }
+  if (isa->isa_dup.dt_method == ISA_DT_METHOD_BITMAP) {
+    err = isa_next_bitmap(pdb, it, &isa->isa_next_tmp, budget_inout);
+    goto done;
+  }
 
   cl_assert(cl, isa->isa_dup.dt_method == ISA_DT_METHOD_INTERSECT);
   switch (it->it_call_state) {
@@ -3872,8 +3977,11 @@ static char const *isa_to_string(pdb_handle *pdb, pdb_iterator *it, char *buf,
            pdb_iterator_to_string(pdb, isa->isa_sub, sub, sizeof sub),
            oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_STORABLE
                ? " S"
-               : (oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_INTERSECT ? " I"
-                                                                         : ""));
+               : (oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_INTERSECT
+                      ? " I"
+                      : (oisa(it)->isa_dup.dt_method == ISA_DT_METHOD_BITMAP
+                             ? " B"
+                             : "")));
   return buf;
 }
 
@@ -4037,6 +4145,28 @@ static int isa_range_estimate(pdb_handle *pdb, pdb_iterator *it,
   return 0;
 }
 
+/*  No native batching for "isa".  Its results usually aren't
+ *  sorted, and the batch readers -- the loser tree of a wide "or"
+ *  and graphd_iterator_and_run_batch() -- only read from sorted
+ *  iterators; and each check follows its own id's linkage.  Loop
+ *  over our own next and check without going back through the
+ *  vtable.
+ */
+static int isa_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                          pdb_id *id_out, size_t m, size_t *n_out,
+                          pdb_budget *budget_inout) {
+  return pdb_iterator_next_batch_loop(pdb, it, isa_next_loc, id_out, m, n_out,
+                                      budget_inout);
+}
+
+static int isa_check_batch(pdb_handle *pdb, pdb_iterator *it,
+                           pdb_id const *id_in, size_t n_in,
+                           size_t *n_in_done, pdb_id *id_out,
+                           size_t *n_out, pdb_budget *budget_inout) {
+  return pdb_iterator_check_batch_loop(pdb, it, isa_check, id_in, n_in,
+                                       n_in_done, id_out, n_out, budget_inout);
+}
+
 static const pdb_iterator_type isa_type = {
     "isa",
     isa_finish,
@@ -4058,8 +4188,10 @@ static const pdb_iterator_type isa_type = {
     NULL, /* restrict */
 
     NULL /* suspend */,
-    NULL /* unsuspend */
-};
+    NULL /* unsuspend */,
+
+    isa_next_batch,
+    isa_check_batch};
 
 /**
  * @brief Assemble an "isa" iterator structure.
@@ -4650,10 +4782,12 @@ int graphd_iterator_isa_thaw_loc(graphd_handle *graphd,
     (*it_out)->it_call_state = call_state;
   } else {
   recover_state:
-    if (!pdb_iterator_sorted(pdb, isa->isa_sub)) {
+    if (!pdb_iterator_sorted(pdb, isa->isa_sub) ||
+        isa->isa_dup.dt_method == ISA_DT_METHOD_BITMAP) {
       /*  If we're going to use a hashtable
        *  (because the subiterator isn't sorted),
-       *  reset it so we can rebuild the hashtable.
+       *  or a bitmap, reset it so we can rebuild
+       *  the hashtable or bitmap.
        */
       err = pdb_iterator_reset(pdb, isa->isa_sub);
       if (err != 0) {
@@ -19,6 +19,7 @@ limitations under the License.
 #include <stdlib.h>
 
 typedef struct graphd_iterator_isa_storable graphd_iterator_isa_storable;
+typedef struct graphd_iterator_isa_bitmap graphd_iterator_isa_bitmap;
 
 void graphd_iterator_isa_storable_range(graphd_iterator_isa_storable const* _is,
                                         pdb_range_estimate* _range,
@@ -55,6 +56,30 @@ int graphd_iterator_isa_storable_run(graphd_handle* _g, pdb_iterator* _it,
                                      graphd_iterator_isa_storable* _is,
                                      pdb_budget* _budget_inout);
 
+/* graphd-iterator-isa-bitmap.c */
+graphd_iterator_isa_bitmap* graphd_iterator_isa_bitmap_alloc(graphd_handle* _g,
+                                                             pdb_id _low);
+
+int graphd_iterator_isa_bitmap_add(graphd_handle* _g,
+                                   graphd_iterator_isa_bitmap** _ib_ptr,
+                                   pdb_id _low, pdb_id _id, bool* _added_out);
+
+bool graphd_iterator_isa_bitmap_check(graphd_iterator_isa_bitmap const* _ib,
+                                      pdb_id _id);
+
+bool graphd_iterator_isa_bitmap_fits(graphd_iterator_isa_bitmap const* _ib,
+                                     pdb_id _low);
+
+size_t graphd_iterator_isa_bitmap_nelems(
+    graphd_iterator_isa_bitmap const* _ib);
+
+int graphd_iterator_isa_bitmap_freeze(graphd_handle* _g,
+                                      graphd_iterator_isa_bitmap* _ib,
+                                      cm_buffer* _buf);
+
+graphd_iterator_isa_bitmap* graphd_iterator_isa_bitmap_thaw(
+    graphd_handle* _g, char const** _s_ptr, char const* _e);
+
 /* graphd-iterator-isa.c */
 int graphd_iterator_isa_run_next(graphd_handle* _g, pdb_iterator* _it,
                                  pdb_iterator* _sub, int _linkage,
@@ -122,7 +122,7 @@ static int islink_recover_callback(void *data, graphd_handle *g,
   if (*idset_inout != NULL)
     graph_idset_link(*idset_inout);
   else {
-    *idset_inout = graph_idset_tile_create(g->g_graph);
+    *idset_inout = graphd_idset_create(g);
     if (*idset_inout == NULL) return errno ? errno : ENOMEM;
   }
   return 0;
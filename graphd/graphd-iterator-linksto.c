@@ -11,6 +11,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "graphd/graphd.h"
+#include "graphd/graphd-iterator-isa.h"
 
 #include <errno.h>
 #include <stdbool.h>
@@ -63,6 +64,26 @@ GRAPHD_SABOTAGE_DECL;
  */
 #define GRAPHD_LINKSTO_FANIN_FIXED_MAX 25
 
+/*  Don't consider a semi-join unless the subiterator has at
+ *  least this many elements; below that, the nested lookups
+ *  are cheap enough.
+ */
+#define GRAPHD_LINKSTO_SEMIJOIN_MIN (10 * 1024)
+
+/*  Don't consider a semi-join if the bitmap over the
+ *  subiterator's id range would be larger than this many bytes.
+ */
+#define GRAPHD_LINKSTO_SEMIJOIN_BITMAP_MAX (16 * 1024 * 1024)
+
+/*  What the semi-join pays per candidate to read its
+ *  fixed-size column record.  The reads are in id order and
+ *  mostly hit the same page as the last one, so they cost
+ *  about as much as a function call.  On top of that, a
+ *  candidate taken from the hint costs a gmap element; one
+ *  taken from the range of all primitives costs nothing.
+ */
+#define GRAPHD_LINKSTO_SEMIJOIN_COST_COLUMN PDB_COST_FUNCTION_CALL
+
 typedef enum {
   LTO_TYPECHECK_INITIAL = 0,
   LTO_TYPECHECK_USE_ID = 1,
@@ -74,8 +95,14 @@ typedef enum {
 
 #define LTO_NEXT_SUBFANIN 0
 #define LTO_NEXT_TYPECHECK 1
+#define LTO_NEXT_SEMIJOIN 2
 #define LTO_NEXT_UNSPECIFIED (-1)
 
+/*  Call state of a semi-join "find" that is pulling more
+ *  candidates after the initial positioning.
+ */
+#define LTO_SEMIJOIN_NEXT_MORE 1
+
 typedef struct graphd_iterator_linksto {
   graphd_handle *lto_graphd;
   pdb_handle *lto_pdb;
@@ -144,7 +171,8 @@ typedef struct graphd_iterator_linksto {
   pdb_id lto_id;
 
   /*  PDB_ID_NONE or the position we need to go to
-   *  before resuming, and our method is TYPECHECK.
+   *  before resuming, and our method is TYPECHECK
+   *  or SEMIJOIN.
    */
   pdb_id lto_resume_id;
 
@@ -169,6 +197,16 @@ typedef struct graphd_iterator_linksto {
    */
   pdb_iterator *lto_hint_it;
 
+  /*  Original only: if the method is LTO_NEXT_SEMIJOIN, the
+   *  subiterator's ids, as a bitmap, and a clone of the
+   *  subiterator that we're pulling them out of.  Once the
+   *  bitmap is complete, lto_sj_done is set, and lto_sj_sub
+   *  is free'd.
+   */
+  graphd_iterator_isa_bitmap *lto_sj_set;
+  pdb_iterator *lto_sj_sub;
+  unsigned int lto_sj_done : 1;
+
   unsigned int lto_thawed : 1;
 
 } graphd_iterator_linksto;
@@ -711,6 +749,256 @@ static int linksto_next_resume(pdb_iterator *it, pdb_budget *budget_inout) {
   return 0;
 }
 
+/*  Semi-join: rather than looking up the fan-in of each of the
+ *  subiterator's ids, or checking each candidate link against the
+ *  subiterator, pull all of the subiterator's ids into a bitmap
+ *  once, then stream the candidates -- instances of the hint, or
+ *  all primitives in our range -- through it, reading each
+ *  candidate's linkage from the column file.
+ *
+ *  The bitmap is built by, and kept in, the original iterator;
+ *  clones share it.  Building is restartable -- the clone of the
+ *  subiterator we're reading from keeps our place.
+ */
+static int linksto_semijoin_build(pdb_handle *pdb, pdb_iterator *it,
+                                  pdb_budget *budget_inout) {
+  graphd_iterator_linksto *olto = it->it_original->it_theory;
+  cl_handle *cl = olto->lto_cl;
+  char buf[200];
+  pdb_id id;
+  bool added;
+  int err;
+
+  if (olto->lto_sj_done) return 0;
+
+  if (olto->lto_sj_sub == NULL) {
+    err = pdb_iterator_clone(pdb, olto->lto_sub, &olto->lto_sj_sub);
+    if (err != 0) {
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_clone", err, "sub=%s",
+                   pdb_iterator_to_string(pdb, olto->lto_sub, buf, sizeof buf));
+      return err;
+    }
+    if ((err = pdb_iterator_reset(pdb, olto->lto_sj_sub)) != 0) {
+      cl_log_errno(
+          cl, CL_LEVEL_FAIL, "pdb_iterator_reset", err, "sub=%s",
+          pdb_iterator_to_string(pdb, olto->lto_sj_sub, buf, sizeof buf));
+      pdb_iterator_destroy(pdb, &olto->lto_sj_sub);
+      return err;
+    }
+  }
+
+  for (;;) {
+    err = pdb_iterator_next(pdb, olto->lto_sj_sub, &id, budget_inout);
+    if (err != 0) {
+      if (err == GRAPHD_ERR_NO) break;
+      if (err != PDB_ERR_MORE)
+        cl_log_errno(
+            cl, CL_LEVEL_FAIL, "pdb_iterator_next", err, "sub=%s",
+            pdb_iterator_to_string(pdb, olto->lto_sj_sub, buf, sizeof buf));
+      return err;
+    }
+
+    *budget_inout -= PDB_COST_FUNCTION_CALL;
+    err = graphd_iterator_isa_bitmap_add(olto->lto_graphd, &olto->lto_sj_set,
+                                         olto->lto_sj_sub->it_low, id, &added);
+    if (err != 0) {
+      cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_iterator_isa_bitmap_add", err,
+                   "id=%llx", (unsigned long long)id);
+      return err;
+    }
+    if (GRAPHD_SABOTAGE(olto->lto_graphd, *budget_inout <= 0))
+      return PDB_ERR_MORE;
+  }
+  pdb_iterator_destroy(pdb, &olto->lto_sj_sub);
+  olto->lto_sj_done = true;
+
+  cl_log(cl, CL_LEVEL_DEBUG, "linksto_semijoin_build: %zu id(s) for %s",
+         graphd_iterator_isa_bitmap_nelems(olto->lto_sj_set),
+         pdb_iterator_to_string(pdb, it, buf, sizeof buf));
+  return 0;
+}
+
+/*  Does the candidate ID point into the semi-join bitmap?
+ *
+ *  Returns 0 for yes, GRAPHD_ERR_NO for no, other nonzero
+ *  error codes on system error.
+ */
+static int linksto_semijoin_test(pdb_handle *pdb, pdb_iterator *it, pdb_id id,
+                                 pdb_budget *budget_inout) {
+  graphd_iterator_linksto *lto = it->it_theory;
+  graphd_iterator_linksto *olto = it->it_original->it_theory;
+  pdb_id endpoint;
+  int err;
+
+  *budget_inout -= PDB_COST_HMAP_ELEMENT;
+  err = pdb_column_linkage(pdb, id, lto->lto_linkage, &endpoint);
+  if (err != 0) {
+    if (err != GRAPHD_ERR_NO)
+      cl_log_errno(lto->lto_cl, CL_LEVEL_FAIL, "pdb_column_linkage", err,
+                   "id=%llx", (unsigned long long)id);
+    return err;
+  }
+  if (endpoint == PDB_ID_NONE ||
+      !graphd_iterator_isa_bitmap_check(olto->lto_sj_set, endpoint))
+    return GRAPHD_ERR_NO;
+
+  lto->lto_sub_id = endpoint;
+  return 0;
+}
+
+static int linksto_next_semijoin(pdb_handle *pdb, pdb_iterator *it,
+                                 pdb_id *id_out, pdb_budget *budget_inout) {
+  graphd_iterator_linksto *lto = it->it_theory;
+  graphd_iterator_linksto *olto = it->it_original->it_theory;
+  cl_handle *cl = lto->lto_cl;
+  pdb_budget budget_in = *budget_inout;
+  pdb_id id_found;
+  char buf[200];
+  int err;
+
+  cl_enter(cl, CL_LEVEL_VERBOSE, "%s; budget=%lld",
+           pdb_iterator_to_string(pdb, it, buf, sizeof buf),
+           (long long)*budget_inout);
+
+  if ((err = linksto_semijoin_build(pdb, it, budget_inout)) != 0) {
+    cl_leave(cl, CL_LEVEL_VERBOSE, "%s ($%lld)",
+             err == PDB_ERR_MORE ? "suspended in build" : graphd_strerror(err),
+             (long long)(budget_in - *budget_inout));
+    return err;
+  }
+  if (graphd_iterator_isa_bitmap_nelems(olto->lto_sj_set) == 0) {
+    cl_leave(cl, CL_LEVEL_VERBOSE, "done - empty subiterator ($%lld)",
+             (long long)(budget_in - *budget_inout));
+    return GRAPHD_ERR_NO;
+  }
+  if (lto->lto_hint_it == NULL &&
+      (err = linksto_hint_it(pdb, it, &lto->lto_hint_it)) != 0) {
+    cl_leave(cl, CL_LEVEL_VERBOSE, "error: %s", graphd_strerror(err));
+    return err;
+  }
+
+  /*  If we were thawed, reposition on the last id we looked at.
+   */
+  if (lto->lto_resume_id != PDB_ID_NONE) {
+    err = pdb_iterator_find(pdb, lto->lto_hint_it, lto->lto_resume_id,
+                            &id_found, budget_inout);
+    if (err != 0) {
+      if (err != PDB_ERR_MORE) lto->lto_resume_id = PDB_ID_NONE;
+      cl_leave(cl, CL_LEVEL_VERBOSE, "%s in find ($%lld)",
+               err == PDB_ERR_MORE ? "suspended" : graphd_strerror(err),
+               (long long)(budget_in - *budget_inout));
+      return err;
+    }
+    lto->lto_id = id_found;
+    if (id_found != lto->lto_resume_id) {
+      lto->lto_resume_id = PDB_ID_NONE;
+      goto have_next;
+    }
+    lto->lto_resume_id = PDB_ID_NONE;
+  }
+
+  do {
+    err = pdb_iterator_next(pdb, lto->lto_hint_it, &lto->lto_id, budget_inout);
+    if (err != 0) {
+      if (err != PDB_ERR_MORE && err != GRAPHD_ERR_NO)
+        cl_log_errno(
+            cl, CL_LEVEL_FAIL, "pdb_iterator_next", err, "it=%s",
+            pdb_iterator_to_string(pdb, lto->lto_hint_it, buf, sizeof buf));
+      cl_leave(cl, CL_LEVEL_VERBOSE, "%s ($%lld)",
+               err == PDB_ERR_MORE ? "suspended in next" : graphd_strerror(err),
+               (long long)(budget_in - *budget_inout));
+      return err;
+    }
+
+  have_next:
+    err = linksto_semijoin_test(pdb, it, lto->lto_id, budget_inout);
+    if (err == 0) {
+      *id_out = lto->lto_id;
+      cl_leave(cl, CL_LEVEL_VERBOSE, "%llx ($%lld)",
+               (unsigned long long)lto->lto_id,
+               (long long)(budget_in - *budget_inout));
+      return 0;
+    }
+    if (err != GRAPHD_ERR_NO) {
+      cl_leave(cl, CL_LEVEL_VERBOSE, "error: %s", graphd_strerror(err));
+      return err;
+    }
+  } while (!GRAPHD_SABOTAGE(lto->lto_graphd, *budget_inout <= 0));
+
+  cl_leave(cl, CL_LEVEL_VERBOSE, "suspended ($%lld)",
+           (long long)(budget_in - *budget_inout));
+  return PDB_ERR_MORE;
+}
+
+/*  Find for the semi-join.  In state 0, we're positioning the
+ *  candidate iterator on or after ID_IN; in LTO_SEMIJOIN_NEXT_MORE,
+ *  we've tested the candidate it gave us, and are pulling more.
+ */
+static int linksto_find_semijoin(pdb_handle *pdb, pdb_iterator *it,
+                                 pdb_id id_in, pdb_id *id_out,
+                                 pdb_budget *budget_inout) {
+  graphd_iterator_linksto *lto = it->it_theory;
+  graphd_iterator_linksto *olto = it->it_original->it_theory;
+  cl_handle *cl = lto->lto_cl;
+  char buf[200];
+  int err;
+
+  if ((err = linksto_semijoin_build(pdb, it, budget_inout)) != 0) return err;
+
+  if (graphd_iterator_isa_bitmap_nelems(olto->lto_sj_set) == 0)
+    return GRAPHD_ERR_NO;
+
+  /*  A fresh candidate iterator has no position to continue
+   *  from; start over with the find.
+   */
+  if (lto->lto_hint_it == NULL) {
+    if ((err = linksto_hint_it(pdb, it, &lto->lto_hint_it)) != 0) return err;
+    it->it_call_state = 0;
+  }
+
+  switch (it->it_call_state) {
+    case 0:
+      lto->lto_resume_id = PDB_ID_NONE;
+      err = pdb_iterator_find(pdb, lto->lto_hint_it, id_in, &lto->lto_id,
+                              budget_inout);
+      if (err != 0) return err;
+      break;
+
+    case LTO_SEMIJOIN_NEXT_MORE:
+      it->it_call_state = 0;
+      goto next;
+
+    default:
+      cl_notreached(cl, "linksto_find_semijoin: unexpected call_state %d",
+                    it->it_call_state);
+  }
+
+  for (;;) {
+    err = linksto_semijoin_test(pdb, it, lto->lto_id, budget_inout);
+    if (err == 0) {
+      *id_out = lto->lto_id;
+      return 0;
+    }
+    if (err != GRAPHD_ERR_NO) return err;
+
+    if (GRAPHD_SABOTAGE(lto->lto_graphd, *budget_inout <= 0)) {
+      it->it_call_state = LTO_SEMIJOIN_NEXT_MORE;
+      return PDB_ERR_MORE;
+    }
+  next:
+    err = pdb_iterator_next(pdb, lto->lto_hint_it, &lto->lto_id, budget_inout);
+    if (err != 0) {
+      if (err == PDB_ERR_MORE)
+        it->it_call_state = LTO_SEMIJOIN_NEXT_MORE;
+      else if (err != GRAPHD_ERR_NO)
+        cl_log_errno(
+            cl, CL_LEVEL_FAIL, "pdb_iterator_next", err, "it=%s",
+            pdb_iterator_to_string(pdb, lto->lto_hint_it, buf, sizeof buf));
+      return err;
+    }
+  }
+}
+
 static int linksto_find_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
                             pdb_id *id_out, pdb_budget *budget_inout,
                             char const *file, int line) {
@@ -736,7 +1024,7 @@ static int linksto_find_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
 
   /*  Only sorted iterators can be called with "find".
    *  If we're getting called, we must either be someone
-   *  else or have a LTO_NEXT_TYPECHECK method.
+   *  else or have a LTO_NEXT_TYPECHECK or LTO_NEXT_SEMIJOIN method.
    */
   if (it->it_original != it && it->it_type != it->it_original->it_type) {
     /* We're really someone else. */
@@ -755,6 +1043,11 @@ static int linksto_find_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
     goto unexpected_error;
   }
 
+  if (olto->lto_next_method == LTO_NEXT_SEMIJOIN) {
+    err = linksto_find_semijoin(pdb, it, id_in, id_out, budget_inout);
+    goto done;
+  }
+
   /* We're a TYPECHECK.
    */
   cl_assert(cl, olto->lto_next_method == LTO_NEXT_TYPECHECK);
@@ -1019,11 +1312,10 @@ err:
  */
 static int linksto_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
                          pdb_budget *budget_inout) {
-  graphd_iterator_linksto *lto = it->it_theory;
+  graphd_iterator_linksto *lto = it->it_theory, *olto;
   int err = 0;
   cl_handle *cl = lto->lto_cl;
-  pdb_primitive pr;
-  graph_guid guid;
+  pdb_column_record pcr;
   pdb_budget budget_in = *budget_inout;
   char buf[200];
 
@@ -1074,8 +1366,11 @@ static int linksto_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
 
       *budget_inout -= PDB_COST_PRIMITIVE;
 
-      if ((err = pdb_id_read(pdb, check_id, &pr)) != 0) {
-        cl_log_errno(lto->lto_cl, CL_LEVEL_FAIL, "pdb_id_read", err,
+      /*  The column file has the linkages as ids; no need to
+       *  read and decompress the primitive.
+       */
+      if ((err = pdb_column_read(pdb, check_id, &pcr)) != 0) {
+        cl_log_errno(lto->lto_cl, CL_LEVEL_FAIL, "pdb_column_read", err,
                      "couldn't read id %llx", (unsigned long long)check_id);
         pdb_rxs_pop(pdb, "CHECK %p linksto %llx: %s ($%lld)", (void *)it,
                     (unsigned long long)check_id, graphd_strerror(err),
@@ -1083,8 +1378,7 @@ static int linksto_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
         goto err;
       }
 
-      if (!pdb_primitive_has_linkage(&pr, lto->lto_linkage)) {
-        pdb_primitive_finish(pdb, &pr);
+      if (pcr.pcr_linkage[lto->lto_linkage] == PDB_ID_NONE) {
         pdb_rxs_pop(pdb, "CHECK %p linksto %llx no ($%lld)", (void *)it,
                     (unsigned long long)check_id,
                     (long long)(budget_in - *budget_inout));
@@ -1092,9 +1386,7 @@ static int linksto_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
         goto err;
       }
       if (!GRAPH_GUID_IS_NULL(lto->lto_hint_guid)) {
-        graph_guid tmp_guid;
-        if (!pdb_primitive_has_linkage(&pr, lto->lto_hint_linkage)) {
-          pdb_primitive_finish(pdb, &pr);
+        if (pcr.pcr_linkage[lto->lto_hint_linkage] == PDB_ID_NONE) {
           pdb_rxs_pop(pdb,
                       "CHECK %p linksto %llx no hint "
                       "linkage ($%lld)",
@@ -1103,9 +1395,7 @@ static int linksto_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
           err = GRAPHD_ERR_NO;
           goto err;
         }
-        pdb_primitive_linkage_get(&pr, lto->lto_hint_linkage, tmp_guid);
-        if (!GRAPH_GUID_EQ(tmp_guid, lto->lto_hint_guid)) {
-          pdb_primitive_finish(pdb, &pr);
+        if (lto->lto_hint_id != pcr.pcr_linkage[lto->lto_hint_linkage]) {
           pdb_rxs_pop(pdb,
                       "CHECK %p linksto %llx wrong "
                       "hint linkage ($%lld)",
@@ -1115,28 +1405,34 @@ static int linksto_check(pdb_handle *pdb, pdb_iterator *it, pdb_id check_id,
           goto err;
         }
       }
-      pdb_primitive_linkage_get(&pr, lto->lto_linkage, guid);
-      pdb_primitive_finish(pdb, &pr);
+      lto->lto_sub_id = pcr.pcr_linkage[lto->lto_linkage];
 
-      err = pdb_id_from_guid(pdb, &lto->lto_sub_id, &guid);
-      if (err != 0)
-        cl_log_errno(lto->lto_cl, CL_LEVEL_FAIL, "pdb_id_from_guid", err,
-                     "guid=%s", graph_guid_to_string(&guid, buf, sizeof buf));
-      else {
-        pdb_iterator_call_reset(pdb, lto->lto_sub);
-        RESUME_STATE(it, 1)
-        err = pdb_iterator_check(pdb, lto->lto_sub, lto->lto_sub_id,
-                                 budget_inout);
-        if (err != 0) {
-          if (err == PDB_ERR_MORE)
-            it->it_call_state = 1;
+      /*  If we have a complete semi-join bitmap, look
+       *  the endpoint up in that instead.
+       */
+      olto = it->it_original->it_theory;
+      if (olto->lto_sj_done) {
+        *budget_inout -= PDB_COST_FUNCTION_CALL;
+        err = graphd_iterator_isa_bitmap_check(olto->lto_sj_set,
+                                               lto->lto_sub_id)
+                  ? 0
+                  : GRAPHD_ERR_NO;
+        break;
+      }
 
-          else if (err != GRAPHD_ERR_NO)
-            cl_log_errno(
-                lto->lto_cl, CL_LEVEL_FAIL, "pdb_iterator_check", err,
-                "unexpected error from %s",
-                pdb_iterator_to_string(pdb, lto->lto_sub, buf, sizeof buf));
-        }
+      pdb_iterator_call_reset(pdb, lto->lto_sub);
+      RESUME_STATE(it, 1)
+      err =
+          pdb_iterator_check(pdb, lto->lto_sub, lto->lto_sub_id, budget_inout);
+      if (err != 0) {
+        if (err == PDB_ERR_MORE)
+          it->it_call_state = 1;
+
+        else if (err != GRAPHD_ERR_NO)
+          cl_log_errno(
+              lto->lto_cl, CL_LEVEL_FAIL, "pdb_iterator_check", err,
+              "unexpected error from %s",
+              pdb_iterator_to_string(pdb, lto->lto_sub, buf, sizeof buf));
       }
       break;
   }
@@ -1781,6 +2077,58 @@ static bool typecheck_coverage(pdb_handle *pdb, pdb_iterator *it,
   return true;
 }
 
+/*  What would a semi-join cost, all told?
+ *
+ *  Building the bitmap costs a "next" in the subiterator for
+ *  each of its ids; after that, each candidate costs a column
+ *  read, plus a gmap element if it's a hint instance rather than
+ *  just the next primitive in our range.  The existing methods
+ *  pay instead for a fan-in lookup per subiterator id, or a
+ *  subiterator check per candidate.
+ *
+ *  Returns false if a semi-join isn't worth considering: the
+ *  subiterator is small, or its id range too wide for a bitmap.
+ */
+static bool linksto_semijoin_cost(pdb_handle *pdb, pdb_iterator *it,
+                                  pdb_budget *cost_out) {
+  graphd_iterator_linksto *lto = it->it_theory;
+  unsigned long long upper_bound = pdb_primitive_n(pdb);
+  unsigned long long sub_n, cand_n, low, high;
+  pdb_budget cand_cost = GRAPHD_LINKSTO_SEMIJOIN_COST_COLUMN;
+
+  if (!pdb_iterator_n_valid(pdb, lto->lto_sub) ||
+      !pdb_iterator_next_cost_valid(pdb, lto->lto_sub))
+    return false;
+
+  sub_n = pdb_iterator_n(pdb, lto->lto_sub);
+  if (sub_n < GRAPHD_LINKSTO_SEMIJOIN_MIN) return false;
+
+  low = lto->lto_sub->it_low;
+  high = lto->lto_sub->it_high;
+  if (high > upper_bound) high = upper_bound;
+  if (high <= low || (high - low) / 8 > GRAPHD_LINKSTO_SEMIJOIN_BITMAP_MAX)
+    return false;
+
+  if (GRAPH_GUID_IS_NULL(lto->lto_hint_guid) ||
+      lto->lto_hint_linkage >= PDB_LINKAGE_N) {
+    high = it->it_high;
+    if (high > upper_bound) high = upper_bound;
+    cand_n = high > it->it_low ? high - it->it_low : 0;
+  } else {
+    if (lto->lto_hint_id == PDB_ID_NONE ||
+        pdb_linkage_count_est(pdb, lto->lto_hint_linkage, lto->lto_hint_id,
+                              it->it_low, it->it_high, PDB_COUNT_UNBOUNDED,
+                              &cand_n) != 0)
+      return false;
+    cand_cost += PDB_COST_GMAP_ELEMENT;
+  }
+
+  *cost_out = sub_n * (pdb_iterator_next_cost(pdb, lto->lto_sub) +
+                       PDB_COST_FUNCTION_CALL) +
+              cand_n * cand_cost;
+  return true;
+}
+
 static int linksto_statistics(pdb_handle *pdb, pdb_iterator *it,
                               pdb_budget *budget_inout) {
   pdb_budget budget_in = *budget_inout;
@@ -1794,6 +2142,8 @@ static int linksto_statistics(pdb_handle *pdb, pdb_iterator *it,
   pdb_id me;
   char const *sub_ordering;
   bool have_preference = false;
+  bool semijoin;
+  pdb_budget sj_cost;
 
   PDB_IS_ITERATOR(cl, it);
   if (GRAPHD_SABOTAGE(lto->lto_graphd, *budget_inout <= 0)) return PDB_ERR_MORE;
@@ -1867,7 +2217,8 @@ static int linksto_statistics(pdb_handle *pdb, pdb_iterator *it,
        */
       if (lto->lto_next_method != LTO_NEXT_UNSPECIFIED) {
         cl_assert(lto->lto_cl, lto->lto_next_method == LTO_NEXT_SUBFANIN ||
-                                   lto->lto_next_method == LTO_NEXT_TYPECHECK);
+                                   lto->lto_next_method == LTO_NEXT_TYPECHECK ||
+                                   lto->lto_next_method == LTO_NEXT_SEMIJOIN);
         goto have_method;
       }
 
@@ -2037,7 +2388,16 @@ static int linksto_statistics(pdb_handle *pdb, pdb_iterator *it,
 
 have_method:
   cl_assert(lto->lto_cl, lto->lto_next_method == LTO_NEXT_SUBFANIN ||
-                             lto->lto_next_method == LTO_NEXT_TYPECHECK);
+                             lto->lto_next_method == LTO_NEXT_TYPECHECK ||
+                             lto->lto_next_method == LTO_NEXT_SEMIJOIN);
+
+  /*  The semi-join's estimates start out from those of
+   *  whichever method finished its trial.
+   */
+  if ((semijoin = lto->lto_next_method == LTO_NEXT_SEMIJOIN))
+    lto->lto_next_method = lto->lto_stat_tc_id_n >= GRAPHD_LINKSTO_N_SAMPLES
+                               ? LTO_NEXT_TYPECHECK
+                               : LTO_NEXT_SUBFANIN;
 
   /*  is-sorted:
    * 	as long as we have a tractable (small) number of destinations,
@@ -2259,6 +2619,37 @@ have_method:
     }
   }
 
+  /*  Would a semi-join beat that?  Compare its total cost
+   *  to that of producing all our results the other way.
+   *  (If the subfanin gives us a useful ordering, keep it.)
+   */
+  if (linksto_semijoin_cost(pdb, it, &sj_cost) &&
+      (semijoin ||
+       ((lto->lto_next_method != LTO_NEXT_SUBFANIN ||
+         !pdb_iterator_ordered(pdb, it)) &&
+        (double)sj_cost < (double)pdb_iterator_next_cost(pdb, it) *
+                              pdb_iterator_n(pdb, it)))) {
+    unsigned long long n = pdb_iterator_n(pdb, it);
+
+    cl_log(cl, CL_LEVEL_VERBOSE,
+           "linksto_statistics: semi-join $%lld vs. %s $%lld * %llu",
+           (long long)sj_cost,
+           lto->lto_next_method == LTO_NEXT_TYPECHECK ? "typecheck"
+                                                      : "subfanin",
+           (long long)pdb_iterator_next_cost(pdb, it), n);
+
+    if (lto->lto_next_method == LTO_NEXT_SUBFANIN) {
+      pdb_iterator_ordered_set(pdb, it, false);
+      pdb_iterator_ordering_set(pdb, it, NULL);
+    }
+    lto->lto_next_method = LTO_NEXT_SEMIJOIN;
+
+    pdb_iterator_next_cost_set(pdb, it, 1 + sj_cost / (n > 0 ? n : 1));
+    pdb_iterator_find_cost_set(
+        pdb, it, PDB_COST_GMAP_ARRAY + pdb_iterator_next_cost(pdb, it));
+    pdb_iterator_sorted_set(pdb, it, true);
+  }
+
   /*  Free subiterators used only during statistics.
    */
   pdb_iterator_destroy(pdb, &lto->lto_stat_tc_hint);
@@ -2554,6 +2945,10 @@ static int linksto_next_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id *id_out,
     err = linksto_next_typecheck(pdb, it, id_out, budget_inout);
     goto done;
   }
+  if (olto->lto_next_method == LTO_NEXT_SEMIJOIN) {
+    err = linksto_next_semijoin(pdb, it, id_out, budget_inout);
+    goto done;
+  }
 
   switch (it->it_call_state)
     for (;;) {
@@ -3150,6 +3545,10 @@ static int linksto_clone(pdb_handle *pdb, pdb_iterator *it,
   lto_out->lto_stat_tc_sub = NULL;
   lto_out->lto_source = PDB_ID_NONE;
 
+  lto_out->lto_sj_set = NULL;
+  lto_out->lto_sj_sub = NULL;
+  lto_out->lto_sj_done = false;
+
   if ((err = pdb_iterator_make_clone(pdb, it_orig, it_out)) != 0) {
     pdb_iterator_destroy(pdb, &lto_out->lto_sub);
     cm_free(lto->lto_cm, lto_out);
@@ -3175,6 +3574,8 @@ static void linksto_finish(pdb_handle *pdb, pdb_iterator *it) {
     pdb_iterator_destroy(pdb, &lto->lto_hint_it);
     pdb_iterator_destroy(pdb, &lto->lto_stat_tc_hint);
     pdb_iterator_destroy(pdb, &lto->lto_stat_tc_sub);
+    pdb_iterator_destroy(pdb, &lto->lto_sj_sub);
+    graphd_storable_unlink(lto->lto_sj_set);
 
     cm_free(lto->lto_cm, it->it_displayname);
     it->it_displayname = NULL;
@@ -3312,6 +3713,7 @@ static int linksto_range_estimate(pdb_handle *pdb, pdb_iterator *it,
 
   switch (lto->lto_next_method) {
     case LTO_NEXT_TYPECHECK:
+    case LTO_NEXT_SEMIJOIN:
       if (lto->lto_hint_it == NULL) {
         err = linksto_hint_it(pdb, it, &lto->lto_hint_it);
         if (err != 0) return err;
@@ -3549,12 +3951,20 @@ static int linksto_create(graphd_request *greq, int linkage, int hint_linkage,
   lto->lto_next_method = next_method;
   lto->lto_stat_budget_max = 50;
 
+  lto->lto_hint_id = PDB_ID_NONE;
   if (hint_guid == NULL || GRAPH_GUID_IS_NULL(*hint_guid)) {
     GRAPH_GUID_MAKE_NULL(lto->lto_hint_guid);
     lto->lto_hint_linkage = PDB_LINKAGE_N;
   } else {
     lto->lto_hint_guid = *hint_guid;
     lto->lto_hint_linkage = hint_linkage;
+
+    /*  Resolve the hint once; checks compare against the id.
+     *  A hint that isn't in the database stays PDB_ID_NONE,
+     *  which matches nothing.
+     */
+    if (pdb_id_from_guid(lto->lto_pdb, &lto->lto_hint_id, hint_guid) != 0)
+      lto->lto_hint_id = PDB_ID_NONE;
   }
 
   cl_assert(cl, PDB_IS_LINKAGE(linkage));
@@ -4512,7 +4922,8 @@ int graphd_iterator_linksto_thaw_loc(
       pdb_iterator_n_set(pdb, it, estimate_n);
 
       pdb_iterator_sorted_set(pdb, it,
-                              lto->lto_next_method == LTO_NEXT_TYPECHECK);
+                              lto->lto_next_method == LTO_NEXT_TYPECHECK ||
+                                  lto->lto_next_method == LTO_NEXT_SEMIJOIN);
 
       /*  If we thawed an ordering, and we're finished
        *  with statistics, that ordering was relevant -
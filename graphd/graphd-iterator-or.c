@@ -25,11 +25,16 @@ GRAPHD_SABOTAGE_DECL;
 #define GRAPHD_OR_PRODUCTION_COST_MERGE_MAX 200
 #define GRAPHD_OR_N_MERGE_MAX 20
 
-/*  How much production cost are we going to spend on turning
- *  into a fixed array?
+/*  Sorted "or"s with at least this many subconditions merge their
+ *  subconditions' ids with a loser tree, at O(log n) comparisons
+ *  per id; smaller ones keep them in a sorted list.
  */
-#define GRAPHD_OR_PRODUCTION_COST_FIXED_MAX 5000
-#define GRAPHD_OR_N_FIXED_MAX 200
+#define GRAPHD_OR_TOURNAMENT_MIN 16
+
+/*  In the loser tree, subconditions pull ids from their subiterators
+ *  with pdb_iterator_next_batch(), up to this many at a time.
+ */
+#define GRAPHD_OR_BATCH 16
 
 /*  Maximum cost we're willing to spend to produce and check the
  *  contents of the easiest available producer during create-commit.
@@ -100,6 +105,20 @@ typedef struct graphd_or_subcondition {
 
   unsigned int oc_eof : 1;
 
+  /*  Set once the subiterator has returned the last of its ids
+   *  into oc_buf.
+   */
+  unsigned int oc_buf_eof : 1;
+
+  /*  Used by the loser tree only: ids oc_buf[oc_buf_i..oc_buf_n-1]
+   *  have been read from oc_it, but not yet moved into oc_id.
+   *  oc_buf_m is the size of the most recent batch.
+   */
+  unsigned short oc_buf_i;
+  unsigned short oc_buf_n;
+  unsigned short oc_buf_m;
+  pdb_id oc_buf[GRAPHD_OR_BATCH];
+
 } graphd_or_subcondition;
 
 static const cm_list_offsets graphd_or_subcondition_offsets =
@@ -150,6 +169,19 @@ typedef struct graphd_iterator_or {
 
   unsigned int gio_eof : 1;
 
+  /*  If there are at least GRAPHD_OR_TOURNAMENT_MIN sorted
+   *  subconditions, the sorted "next" and "find" use a loser tree
+   *  instead of the active chain.  gio_tree[0] is the index of the
+   *  subcondition with the earliest pending id; gio_tree[1..n-1]
+   *  are the losers of the matches at the inner nodes of a binary
+   *  tree whose leaves n..2n-1 are the subconditions.
+   *
+   *  A subcondition that holds the id returned last is a duplicate
+   *  that hasn't been consumed yet.
+   */
+  size_t *gio_tree;
+  unsigned int gio_tree_valid : 1;
+
   /*  Set if we're thawing; makes commit be more gentle.
    */
   unsigned int gio_thaw : 1;
@@ -337,6 +369,8 @@ static void or_activate_all(pdb_iterator *it) {
   for (i = gio->gio_n, oc = gio->gio_oc; i--; oc++) {
     oc->oc_id = PDB_ID_NONE;
     oc->oc_eof = false;
+    oc->oc_buf_eof = false;
+    oc->oc_buf_i = oc->oc_buf_n = oc->oc_buf_m = 0;
     oc->oc_next = oc + 1;
     oc->oc_prev = oc - 1;
   }
@@ -351,6 +385,7 @@ static void or_activate_all(pdb_iterator *it) {
   gio->gio_eof_head = gio->gio_eof_tail = NULL;
   gio->gio_this_oc = NULL;
   gio->gio_active_last = NULL;
+  gio->gio_tree_valid = false;
 
   or_chain_invariant(it);
 }
@@ -865,6 +900,7 @@ static int or_refile_all(pdb_iterator *it) {
   gio->gio_active_head = gio->gio_active_tail = NULL;
   gio->gio_this_oc = NULL;
   gio->gio_active_last = NULL;
+  gio->gio_tree_valid = false;
 
   gio->gio_sort_me_n = 0;
 
@@ -900,6 +936,360 @@ static int or_refile_all(pdb_iterator *it) {
   return 0;
 }
 
+/*  Does <a>'s pending id come before <b>'s?  Subconditions that
+ *  have run out lose against everybody.
+ */
+static bool or_tournament_beats(pdb_iterator *it,
+                                graphd_or_subcondition const *a,
+                                graphd_or_subcondition const *b) {
+  if (a->oc_eof) return false;
+  if (b->oc_eof) return true;
+
+  return GRAPHD_OR_BEFORE(it, a->oc_id, b->oc_id);
+}
+
+/*  Play out the subtree at <node>, recording the losers;
+ *  return the index of the winner.
+ */
+static size_t or_tournament_play(pdb_iterator *it, size_t node) {
+  graphd_iterator_or *gio = it->it_theory;
+  size_t a, b;
+
+  if (node >= gio->gio_n) return node - gio->gio_n;
+
+  a = or_tournament_play(it, 2 * node);
+  b = or_tournament_play(it, 2 * node + 1);
+
+  if (or_tournament_beats(it, gio->gio_oc + b, gio->gio_oc + a)) {
+    gio->gio_tree[node] = a;
+    return b;
+  }
+  gio->gio_tree[node] = b;
+  return a;
+}
+
+/*  The pending id of the winner, subcondition <i>, has changed;
+ *  replay its matches on the way back up to the root.
+ */
+static void or_tournament_replay(pdb_iterator *it, size_t i) {
+  graphd_iterator_or *gio = it->it_theory;
+  size_t node, tmp;
+
+  for (node = (gio->gio_n + i) / 2; node > 0; node /= 2)
+    if (or_tournament_beats(it, gio->gio_oc + gio->gio_tree[node],
+                            gio->gio_oc + i)) {
+      tmp = gio->gio_tree[node];
+      gio->gio_tree[node] = i;
+      i = tmp;
+    }
+  gio->gio_tree[0] = i;
+}
+
+/*  Move <oc>'s next id into oc->oc_id, reading another batch
+ *  from its subiterator if its buffer is empty.  Once the
+ *  subiterator has run out, set oc->oc_eof instead.
+ *
+ *  The batches start out with a single id and double from
+ *  there, so that a caller who only wants a few ids -- like
+ *  someone sampling our costs -- doesn't pay for many more.
+ */
+static int or_tournament_pull(pdb_handle *pdb, graphd_or_subcondition *oc,
+                              pdb_budget *budget_inout) {
+  size_t n;
+  int err;
+
+  if (oc->oc_buf_i >= oc->oc_buf_n) {
+    if (oc->oc_buf_eof) {
+      oc->oc_eof = true;
+      return 0;
+    }
+    if (oc->oc_buf_m < GRAPHD_OR_BATCH)
+      oc->oc_buf_m = oc->oc_buf_m ? 2 * oc->oc_buf_m : 1;
+    err = pdb_iterator_next_batch(pdb, oc->oc_it, oc->oc_buf, oc->oc_buf_m, &n,
+                                  budget_inout);
+    oc->oc_buf_i = 0;
+    oc->oc_buf_n = n;
+
+    if (err == GRAPHD_ERR_NO)
+      oc->oc_buf_eof = true;
+    else if (err != 0 && (err != PDB_ERR_MORE || n == 0))
+      return err;
+
+    if (n == 0) {
+      oc->oc_eof = true;
+      return 0;
+    }
+  }
+  oc->oc_id = oc->oc_buf[oc->oc_buf_i++];
+  return 0;
+}
+
+/*  Move <oc>'s first id on or after <id> into oc->oc_id -- out of
+ *  its buffer if it's there, otherwise with a find.
+ */
+static int or_tournament_seek(pdb_handle *pdb, pdb_iterator *it,
+                              graphd_or_subcondition *oc, pdb_id id,
+                              pdb_budget *budget_inout) {
+  pdb_id id_found;
+  int err;
+
+  while (oc->oc_buf_i < oc->oc_buf_n) {
+    id_found = oc->oc_buf[oc->oc_buf_i++];
+    if (!GRAPHD_OR_BEFORE(it, id_found, id)) {
+      oc->oc_id = id_found;
+      return 0;
+    }
+  }
+  if (oc->oc_buf_eof) {
+    oc->oc_eof = true;
+    return 0;
+  }
+
+  err = pdb_iterator_find(pdb, oc->oc_it, id, &id_found, budget_inout);
+  if (err == GRAPHD_ERR_NO)
+    oc->oc_eof = true;
+  else if (err != 0)
+    return err;
+  else
+    oc->oc_id = id_found;
+  return 0;
+}
+
+/*  Are there ids in the subconditions' buffers?  Their
+ *  subiterators are already past them, so a frozen position
+ *  doesn't include them.
+ */
+static bool or_tournament_has_buffered(graphd_iterator_or const *gio) {
+  graphd_or_subcondition const *oc;
+  size_t i;
+
+  for (i = gio->gio_n, oc = gio->gio_oc; i--; oc++)
+    if (oc->oc_buf_i < oc->oc_buf_n) return true;
+  return false;
+}
+
+/*  Rewind all subconditions to their beginning.
+ */
+static int or_tournament_restart(pdb_handle *pdb, pdb_iterator *it) {
+  graphd_iterator_or *gio = it->it_theory;
+  graphd_or_subcondition *oc;
+  size_t i;
+  int err;
+
+  for (i = gio->gio_n, oc = gio->gio_oc; i--; oc++)
+    if ((err = pdb_iterator_reset(pdb, oc->oc_it)) != 0) return err;
+
+  or_activate_all(it);
+  return 0;
+}
+
+/*  Give every subcondition from gio_this_oc on that doesn't
+ *  have one a pending id -- the next one, or, if <id> isn't
+ *  PDB_ID_NONE, the first on or after <id> -- and build the tree.
+ */
+static int or_tournament_fill(pdb_handle *pdb, pdb_iterator *it, pdb_id id,
+                              pdb_budget *budget_inout) {
+  graphd_iterator_or *gio = it->it_theory;
+  graphd_or_subcondition *oc;
+  int err;
+
+  for (; gio->gio_this_oc < gio->gio_oc + gio->gio_n; gio->gio_this_oc++) {
+    oc = gio->gio_this_oc;
+    if (oc->oc_eof || oc->oc_id != PDB_ID_NONE) continue;
+
+    if (id == PDB_ID_NONE)
+      err = or_tournament_pull(pdb, oc, budget_inout);
+    else
+      err = or_tournament_seek(pdb, it, oc, id, budget_inout);
+    if (err != 0) return err;
+  }
+
+  if (gio->gio_tree == NULL) {
+    gio->gio_tree =
+        cm_malloc(gio->gio_cm, gio->gio_n * sizeof(*gio->gio_tree));
+    if (gio->gio_tree == NULL) return errno ? errno : ENOMEM;
+  }
+  gio->gio_tree[0] = or_tournament_play(it, 1);
+  gio->gio_tree_valid = true;
+
+  return 0;
+}
+
+/*  The sorted "next" for wide "or"s.
+ */
+static int or_tournament_next(pdb_handle *pdb, pdb_iterator *it,
+                              pdb_id *id_out, pdb_budget *budget_inout) {
+  graphd_iterator_or *gio = it->it_theory;
+  graphd_or_subcondition *oc;
+  int err;
+
+  switch (it->it_call_state) {
+    default:
+      RESUME_STATE(it, 0)
+      if (!gio->gio_tree_valid || gio->gio_resume_id != PDB_ID_NONE) {
+        /*  If we haven't returned anything yet, start from
+         *  scratch; pending ids may have been thawed without
+         *  the buffered ids that came before them.
+         */
+        if (gio->gio_resume_id != PDB_ID_NONE)
+          or_activate_all(it);
+        else if (gio->gio_id == PDB_ID_NONE &&
+                 (err = or_tournament_restart(pdb, it)) != 0)
+          return err;
+        gio->gio_this_oc = gio->gio_oc;
+
+        RESUME_STATE(it, 1)
+        err = or_tournament_fill(pdb, it, gio->gio_resume_id, budget_inout);
+        if (err != 0) {
+          if (err == PDB_ERR_MORE) it->it_call_state = 1;
+          return err;
+        }
+
+        /*  Everything that holds the resume id counts
+         *  as already returned.
+         */
+        if (gio->gio_resume_id != PDB_ID_NONE) {
+          gio->gio_id = gio->gio_resume_id;
+          gio->gio_resume_id = PDB_ID_NONE;
+        }
+      }
+
+      for (;;) {
+        oc = gio->gio_oc + gio->gio_tree[0];
+        if (oc->oc_eof) return GRAPHD_ERR_NO;
+
+        if (oc->oc_id != PDB_ID_NONE && oc->oc_id != gio->gio_id) break;
+
+        /*  The winner's id has been returned already;
+         *  replace it with its next one.
+         */
+        oc->oc_id = PDB_ID_NONE;
+
+        RESUME_STATE(it, 2)
+        oc = gio->gio_oc + gio->gio_tree[0];
+        err = or_tournament_pull(pdb, oc, budget_inout);
+        if (err != 0) {
+          if (err == PDB_ERR_MORE) it->it_call_state = 2;
+          return err;
+        }
+
+        or_tournament_replay(it, gio->gio_tree[0]);
+        if (GRAPHD_SABOTAGE(gio->gio_graphd, *budget_inout <= 0))
+          return PDB_ERR_MORE;
+      }
+  }
+
+  *id_out = gio->gio_id = oc->oc_id;
+  oc->oc_id = PDB_ID_NONE;
+
+  return 0;
+}
+
+/*  The "find" for wide "or"s.
+ */
+static int or_tournament_find(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
+                              pdb_id *id_out, pdb_budget *budget_inout) {
+  graphd_iterator_or *gio = it->it_theory;
+  graphd_or_subcondition *oc;
+  int err;
+
+  switch (it->it_call_state) {
+    default:
+      RESUME_STATE(it, 0)
+
+      /*  If we're past the position we want, or were still
+       *  catching up with a thawed one, start over.
+       */
+      if (gio->gio_id == PDB_ID_NONE || gio->gio_resume_id != PDB_ID_NONE ||
+          GRAPHD_OR_AFTER(it, gio->gio_id, id_in)) {
+        or_activate_all(it);
+        gio->gio_resume_id = PDB_ID_NONE;
+      }
+
+      if (!gio->gio_tree_valid) {
+        gio->gio_this_oc = gio->gio_oc;
+
+        RESUME_STATE(it, 1)
+        err = or_tournament_fill(pdb, it, id_in, budget_inout);
+        if (err != 0) {
+          if (err == PDB_ERR_MORE) it->it_call_state = 1;
+          return err;
+        }
+      }
+
+      for (;;) {
+        RESUME_STATE(it, 3)
+        oc = gio->gio_oc + gio->gio_tree[0];
+        if (oc->oc_eof) return GRAPHD_ERR_NO;
+
+        if (oc->oc_id != PDB_ID_NONE &&
+            !GRAPHD_OR_BEFORE(it, oc->oc_id, id_in))
+          break;
+
+        RESUME_STATE(it, 2)
+        oc = gio->gio_oc + gio->gio_tree[0];
+        err = or_tournament_seek(pdb, it, oc, id_in, budget_inout);
+        if (err != 0) {
+          if (err == PDB_ERR_MORE) it->it_call_state = 2;
+          return err;
+        }
+
+        or_tournament_replay(it, gio->gio_tree[0]);
+        if (GRAPHD_SABOTAGE(gio->gio_graphd, *budget_inout <= 0)) {
+          it->it_call_state = 3;
+          return PDB_ERR_MORE;
+        }
+      }
+  }
+
+  *id_out = gio->gio_id = oc->oc_id;
+  oc->oc_id = PDB_ID_NONE;
+
+  return 0;
+}
+
+/*  The batched "next" for wide "or"s whose tree is built:
+ *  drain the loser tree into <id_out>, up to <m> ids.
+ *
+ *  If a subcondition suspends while refilling, the call
+ *  returns PDB_ERR_MORE in the state or_tournament_next()
+ *  resumes from; the ids returned so far are valid.
+ */
+static int or_tournament_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                                    pdb_id *id_out, size_t m, size_t *n_out,
+                                    pdb_budget *budget_inout) {
+  graphd_iterator_or *gio = it->it_theory;
+  graphd_or_subcondition *oc;
+  int err;
+
+  cl_assert(gio->gio_cl, gio->gio_tree_valid);
+  *n_out = 0;
+
+  for (;;) {
+    oc = gio->gio_oc + gio->gio_tree[0];
+    if (oc->oc_eof) return GRAPHD_ERR_NO;
+
+    if (oc->oc_id != PDB_ID_NONE && oc->oc_id != gio->gio_id) {
+      id_out[(*n_out)++] = gio->gio_id = oc->oc_id;
+      oc->oc_id = PDB_ID_NONE;
+
+      if (*n_out >= m || *budget_inout <= 0) return 0;
+      continue;
+    }
+
+    oc->oc_id = PDB_ID_NONE;
+    err = or_tournament_pull(pdb, oc, budget_inout);
+    if (err != 0) {
+      if (err == PDB_ERR_MORE) it->it_call_state = 2;
+      return err;
+    }
+    or_tournament_replay(it, gio->gio_tree[0]);
+
+    if (*n_out == 0 && GRAPHD_SABOTAGE(gio->gio_graphd, *budget_inout <= 0))
+      return PDB_ERR_MORE;
+  }
+}
+
 static int or_iterator_find_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
                                 pdb_id *id_out, pdb_budget *budget_inout,
                                 char const *file, int line) {
@@ -908,6 +1298,7 @@ static int or_iterator_find_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
   graphd_or_subcondition *oc;
   pdb_budget budget_in = *budget_inout;
   int err;
+  char ibuf[200];
 
 #undef LEAVE_SAVE_STATE
 #define LEAVE_SAVE_STATE(it, state)                                     \
@@ -931,6 +1322,17 @@ static int or_iterator_find_loc(pdb_handle *pdb, pdb_iterator *it, pdb_id id_in,
    */
   cl_assert(cl, pdb_iterator_sorted(pdb, it));
 
+  if (gio->gio_n >= GRAPHD_OR_TOURNAMENT_MIN) {
+    err = or_tournament_find(pdb, it, id_in, id_out, budget_inout);
+    if (err == GRAPHD_ERR_NO) gio->gio_eof = true;
+    pdb_rxs_pop(pdb, "FIND %p or %llx -> %s [%s:%d] ($%lld)", (void *)it,
+                (unsigned long long)id_in,
+                err == 0 ? pdb_id_to_string(pdb, *id_out, ibuf, sizeof ibuf)
+                         : graphd_strerror(err),
+                file, line, (long long)(budget_in - *budget_inout));
+    goto err;
+  }
+
   switch (it->it_call_state) {
     default:
       RESUME_STATE(it, 0)
@@ -1191,6 +1593,16 @@ static int or_iterator_next_loc(pdb_handle *pdb, pdb_iterator *it,
 
   if (!pdb_iterator_sorted(pdb, it)) goto unsorted;
 
+  if (gio->gio_n >= GRAPHD_OR_TOURNAMENT_MIN) {
+    err = or_tournament_next(pdb, it, id_out, budget_inout);
+    if (err == GRAPHD_ERR_NO) gio->gio_eof = true;
+    pdb_rxs_pop(pdb, "NEXT %p or %s ($%lld)", (void *)it,
+                err == 0 ? pdb_id_to_string(pdb, *id_out, buf, sizeof buf)
+                         : graphd_strerror(err),
+                (long long)(budget_in - *budget_inout));
+    goto err;
+  }
+
   /*
    *  The SORTED algorithm:
    *
@@ -1542,6 +1954,7 @@ static int or_iterator_freeze(pdb_handle *pdb, pdb_iterator *it,
   size_t i;
   int err;
   char const *sep = "";
+  pdb_id resume_id;
 
   if (graphd_request_timer_check(gio->gio_greq)) return GRAPHD_ERR_TOO_HARD;
 
@@ -1592,8 +2005,17 @@ static int or_iterator_freeze(pdb_handle *pdb, pdb_iterator *it,
              "FYI - freeze during resume?  That's not good...");
     }
 
+    /*  Ids buffered by the loser tree aren't part of the
+     *  subiterators' positions; have the thawed iterator
+     *  catch up with a find instead.
+     */
+    resume_id = gio->gio_resume_id;
+    if (resume_id == PDB_ID_NONE && gio->gio_id != PDB_ID_NONE &&
+        or_tournament_has_buffered(gio))
+      resume_id = gio->gio_id;
+
     err = graphd_iterator_util_freeze_position(pdb, gio->gio_eof, gio->gio_id,
-                                               gio->gio_resume_id, buf);
+                                               resume_id, buf);
     if (err != 0) return err;
 
     sep = "/";
@@ -1744,6 +2166,7 @@ static int or_iterator_clone(pdb_handle *pdb, pdb_iterator *it,
   /* Use that of the original */
   gio_out->gio_masquerade = NULL;
   gio_out->gio_check_it = NULL;
+  gio_out->gio_tree = NULL;
 
   cl_assert(cl, gio->gio_sort_me_n == 0);
   gio_out->gio_sort_me =
@@ -1818,6 +2241,7 @@ static void or_iterator_finish(pdb_handle *pdb, pdb_iterator *it) {
     it->it_displayname = NULL;
 
     cm_free(gio->gio_cm, gio->gio_sort_me);
+    cm_free(gio->gio_cm, gio->gio_tree);
     cm_free(gio->gio_cm, gio->gio_masquerade);
     cm_free(gio->gio_cm, gio);
 
@@ -2234,6 +2658,146 @@ static int or_range_estimate(pdb_handle *pdb, pdb_iterator *it,
   return 0;
 }
 
+/*  A wide sorted "or" drains its loser tree; everybody else
+ *  loops over next.  The first id of a batch goes through
+ *  or_iterator_next_loc(), which builds the tree or catches
+ *  up with a thawed position.
+ */
+static int or_iterator_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                                  pdb_id *id_out, size_t m, size_t *n_out,
+                                  pdb_budget *budget_inout) {
+  graphd_iterator_or *gio = it->it_theory;
+  pdb_budget budget_in;
+  size_t n;
+  int err;
+
+  if (gio->gio_n < GRAPHD_OR_TOURNAMENT_MIN || !pdb_iterator_sorted(pdb, it) ||
+      it->it_call_state != 0 || gio->gio_eof)
+    return pdb_iterator_next_batch_loop(pdb, it, or_iterator_next_loc, id_out,
+                                        m, n_out, budget_inout);
+
+  *n_out = 0;
+  if (!gio->gio_tree_valid || gio->gio_resume_id != PDB_ID_NONE) {
+    err = or_iterator_next_loc(pdb, it, id_out, budget_inout, __FILE__,
+                               __LINE__);
+    if (err != 0) return err;
+
+    *n_out = 1;
+    if (m <= 1 || *budget_inout <= 0 || it->it_type != &or_iterator_type ||
+        it->it_call_state != 0 || !gio->gio_tree_valid)
+      return 0;
+  }
+
+  budget_in = *budget_inout;
+  pdb_rxs_push(pdb, "NEXT-BATCH %p or (%zu)", (void *)it, m - *n_out);
+
+  err = or_tournament_next_batch(pdb, it, id_out + *n_out, m - *n_out, &n,
+                                 budget_inout);
+  *n_out += n;
+  if (err == GRAPHD_ERR_NO) gio->gio_eof = true;
+
+  pdb_rxs_pop(pdb, "NEXT-BATCH %p or %zu: %s ($%lld)", (void *)it, n,
+              err == 0 ? "ok" : graphd_strerror(err),
+              (long long)(budget_in - *budget_inout));
+  pdb_iterator_account_charge(pdb, it, next, n + (err == GRAPHD_ERR_NO),
+                              budget_in - *budget_inout);
+  return err;
+}
+
+/*  Check a batch against each subcondition in turn, passing on
+ *  only the ids that no earlier subcondition accepted.  The
+ *  input is worked through GRAPHD_OR_BATCH ids at a time; once
+ *  started, those are checked to the end, even if that overruns
+ *  the budget.
+ */
+static int or_iterator_check_batch(pdb_handle *pdb, pdb_iterator *it,
+                                   pdb_id const *id_in, size_t n_in,
+                                   size_t *n_in_done, pdb_id *id_out,
+                                   size_t *n_out, pdb_budget *budget_inout) {
+  graphd_iterator_or *gio = it->it_theory;
+  cl_handle *cl = gio->gio_cl;
+  graphd_or_subcondition *oc;
+  pdb_budget budget_in = *budget_inout;
+  pdb_id pending[GRAPHD_OR_BATCH], passed[GRAPHD_OR_BATCH];
+  unsigned char pending_i[GRAPHD_OR_BATCH];
+  bool yes[GRAPHD_OR_BATCH];
+  size_t i, j, k, c, n, n_done, pending_n, passed_n, sub_done;
+  int err = 0;
+
+  if (n_in < 2 || it->it_call_state != 0)
+    return pdb_iterator_check_batch_loop(pdb, it, or_iterator_check, id_in,
+                                         n_in, n_in_done, id_out, n_out,
+                                         budget_inout);
+
+  if (ogio(it)->gio_check_it != NULL) {
+    err = pdb_iterator_check_batch(pdb, ogio(it)->gio_check_it, id_in, n_in,
+                                   n_in_done, id_out, n_out, budget_inout);
+    pdb_iterator_account_charge(pdb, it, check, *n_in_done,
+                                budget_in - *budget_inout);
+    return err;
+  }
+
+  *n_out = 0;
+  for (i = 0; i < n_in; i += c) {
+    if (i > 0 && *budget_inout < 0) break;
+
+    c = n_in - i;
+    if (c > GRAPHD_OR_BATCH) c = GRAPHD_OR_BATCH;
+
+    for (j = 0; j < c; j++) {
+      pending[j] = id_in[i + j];
+      pending_i[j] = j;
+      yes[j] = false;
+    }
+    pending_n = c;
+
+    for (oc = gio->gio_oc; oc < gio->gio_oc + gio->gio_n && pending_n > 0;
+         oc++) {
+      pdb_iterator_call_reset(pdb, oc->oc_it);
+      for (n_done = passed_n = 0; n_done < pending_n;) {
+        err = pdb_iterator_check_batch(pdb, oc->oc_it, pending + n_done,
+                                       pending_n - n_done, &sub_done,
+                                       passed + passed_n, &n, budget_inout);
+        n_done += sub_done;
+        passed_n += n;
+
+        if (err != 0 && err != PDB_ERR_MORE) {
+          char buf[200];
+          cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_iterator_check_batch", err,
+                       "it=%s", pdb_iterator_to_string(pdb, oc->oc_it, buf,
+                                                       sizeof buf));
+          goto done;
+        }
+      }
+
+      /*  Mark what passed; keep the rest pending.
+       */
+      for (j = k = 0, n = pending_n, pending_n = 0; j < n; j++) {
+        if (k < passed_n && passed[k] == pending[j]) {
+          yes[pending_i[j]] = true;
+          k++;
+        } else {
+          pending[pending_n] = pending[j];
+          pending_i[pending_n++] = pending_i[j];
+        }
+      }
+    }
+    for (j = 0; j < c; j++)
+      if (yes[j]) id_out[(*n_out)++] = id_in[i + j];
+  }
+  err = i < n_in ? PDB_ERR_MORE : 0;
+
+done:
+  *n_in_done = i;
+  pdb_rxs_log(pdb, "CHECK-BATCH %p or %zu of %zu, %zu passed: %s ($%lld)",
+              (void *)it, *n_in_done, n_in, *n_out,
+              err == 0 ? "ok" : graphd_strerror(err),
+              (long long)(budget_in - *budget_inout));
+  pdb_iterator_account_charge(pdb, it, check, *n_in_done,
+                              budget_in - *budget_inout);
+  return err;
+}
+
 static const pdb_iterator_type or_iterator_type = {
     "or",
 
@@ -2256,7 +2820,9 @@ static const pdb_iterator_type or_iterator_type = {
 
     NULL, /* suspend */
     NULL, /* unsuspend */
-};
+
+    or_iterator_next_batch,
+    or_iterator_check_batch};
 
 /**
  * @brief Create an "or" iterator.
@@ -2306,6 +2872,7 @@ int graphd_iterator_or_create_loc(graphd_request *greq, size_t n, bool forward,
   gio->gio_check_id = PDB_ID_NONE;
   gio->gio_sort_me = NULL;
   gio->gio_sort_me_n = 0;
+  gio->gio_tree = NULL;
   gio->gio_this_oc = NULL;
   gio->gio_statistics_oc = NULL;
   gio->gio_fixed = NULL;
@@ -0,0 +1,435 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "libsrv/srv.h"
+
+/**
+ * @file graphd-iterator-resource-share.c
+ * @brief Iterator resources shared between processes.
+ *
+ *  This is a configuration file only option.  If set, graphd
+ *  maps a segment of the given size before it forks its SMP
+ *  leader and followers.  Exportable storables (e.g. the sort
+ *  and is-a caches) are copied into it under their cursor stamp
+ *  when they're frozen; a process that can't find a stamp in its
+ *  own resource cache looks for it here before rebuilding.
+ *
+ *  The stamps already contain the process ID of the process that
+ *  made them, so they're unique across processes.
+ *
+ *  The segment is divided into GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS
+ *  equal-sized slots; anything larger than a slot isn't shared.
+ *  When all slots are in use, the one with the lowest
+ *  greedy-dual-size-frequency priority is replaced, as in the
+ *  per-process cache.
+ *
+ *  Sample usage:  iterator-resource-share 64m
+ */
+
+#define GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS 64
+
+/*  Smallest acceptable segment.
+ */
+#define GRAPHD_ITERATOR_RESOURCE_SHARE_MIN \
+  (GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS * 4096ull)
+
+typedef struct graphd_iterator_resource_share_slot {
+  char grss_stamp[GRAPHD_ITERATOR_RESOURCE_STAMP_SIZE];
+
+  /*  The processes sharing the segment are forked from the
+   *  same image, so type pointers mean the same thing in all
+   *  of them.
+   */
+  graphd_storable_type const *grss_type;
+
+  double grss_priority;
+  pdb_budget grss_cost;
+
+  /*  Bytes used in the slot's data area; 0 if the slot is free.
+   */
+  size_t grss_size;
+
+} graphd_iterator_resource_share_slot;
+
+struct graphd_iterator_resource_share {
+  pthread_mutex_t grs_mutex;
+
+  /*  Slot being written to, or -1.  If its writer dies, the
+   *  slot is cleared.
+   */
+  int grs_writing;
+
+  double grs_clock;
+  size_t grs_map_size;
+  size_t grs_slot_size;
+
+  unsigned long long grs_published;
+  unsigned long long grs_hit;
+  unsigned long long grs_miss;
+
+  graphd_iterator_resource_share_slot grs_slot
+      [GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS];
+};
+
+#define share_data(grs, i) \
+  ((char *)((grs) + 1) + (size_t)(i) * (grs)->grs_slot_size)
+
+static void share_lock(graphd_iterator_resource_share *grs) {
+  if (pthread_mutex_lock(&grs->grs_mutex) != EOWNERDEAD) return;
+
+  /*  A process died holding the lock.  Whatever it was
+   *  copying is incomplete.
+   */
+  if (grs->grs_writing >= 0) {
+    grs->grs_slot[grs->grs_writing].grss_size = 0;
+    grs->grs_slot[grs->grs_writing].grss_stamp[0] = '\0';
+    grs->grs_writing = -1;
+  }
+  (void)pthread_mutex_consistent(&grs->grs_mutex);
+}
+
+static void share_unlock(graphd_iterator_resource_share *grs) {
+  (void)pthread_mutex_unlock(&grs->grs_mutex);
+}
+
+static graphd_iterator_resource_share_slot *share_find(
+    graphd_iterator_resource_share *grs, char const *s, char const *e) {
+  size_t i, n = e - s;
+
+  for (i = 0; i < GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS; i++) {
+    graphd_iterator_resource_share_slot *grss = grs->grs_slot + i;
+
+    if (grss->grss_size > 0 && strncmp(grss->grss_stamp, s, n) == 0 &&
+        grss->grss_stamp[n] == '\0')
+      return grss;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Map the shared segment, if one is configured.
+ *
+ *  Called once at startup, before the SMP processes are forked.
+ *
+ * @param g	graphd handle
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_iterator_resource_share_initialize(graphd_handle *g) {
+  graphd_iterator_resource_share *grs;
+  pthread_mutexattr_t attr;
+  size_t size = g->g_iterator_resource_share_size;
+  int err;
+
+  g->g_iterator_resource_share = NULL;
+  if (size == 0) return 0;
+
+  grs = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+             -1, 0);
+  if (grs == MAP_FAILED) {
+    err = errno ? errno : ENOMEM;
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "mmap", err,
+                 "can't map %zu bytes for shared iterator resources", size);
+    return err;
+  }
+
+  /*  The mapping starts out zeroed.
+   */
+  grs->grs_writing = -1;
+  grs->grs_map_size = size;
+  grs->grs_slot_size =
+      (size - sizeof(*grs)) / GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS;
+
+  if ((err = pthread_mutexattr_init(&attr)) != 0 ||
+      (err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED)) !=
+          0 ||
+      (err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST)) != 0 ||
+      (err = pthread_mutex_init(&grs->grs_mutex, &attr)) != 0) {
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "pthread_mutex_init", err,
+                 "can't initialize shared iterator resource lock");
+    (void)munmap(grs, size);
+    return err;
+  }
+  (void)pthread_mutexattr_destroy(&attr);
+
+  g->g_iterator_resource_share = grs;
+  cl_log(g->g_cl, CL_LEVEL_DEBUG,
+         "graphd_iterator_resource_share_initialize: %zu slots of %zu bytes",
+         (size_t)GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS, grs->grs_slot_size);
+  return 0;
+}
+
+/**
+ * @brief Unmap this process's view of the shared segment.
+ * @param g	graphd handle
+ */
+void graphd_iterator_resource_share_finish(graphd_handle *g) {
+  graphd_iterator_resource_share *grs = g->g_iterator_resource_share;
+
+  if (grs == NULL) return;
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG,
+         "graphd_iterator_resource_share_finish: "
+         "%llu published, %llu hits, %llu misses",
+         grs->grs_published, grs->grs_hit, grs->grs_miss);
+
+  (void)munmap(grs, grs->grs_map_size);
+  g->g_iterator_resource_share = NULL;
+}
+
+/**
+ * @brief Offer a stored resource to the other processes.
+ *
+ *  Storables whose type can't export, or that don't fit
+ *  into a slot, are silently skipped.
+ *
+ * @param g		graphd handle
+ * @param gs		the storable
+ * @param stamp_s	beginning of the stamp it's stored under
+ * @param stamp_e	end of the stamp
+ */
+void graphd_iterator_resource_share_publish(graphd_handle *g,
+                                            graphd_storable const *gs,
+                                            char const *stamp_s,
+                                            char const *stamp_e) {
+  graphd_iterator_resource_share *grs = g->g_iterator_resource_share;
+  graphd_iterator_resource_share_slot *grss;
+  cm_buffer buf;
+  size_t i, n;
+  int err;
+
+  if (grs == NULL || gs->gs_type->st_export == NULL ||
+      stamp_e - stamp_s >= GRAPHD_ITERATOR_RESOURCE_STAMP_SIZE)
+    return;
+
+  cm_buffer_initialize(&buf, g->g_cm);
+  if ((err = (*gs->gs_type->st_export)(gs, &buf)) != 0) {
+    cl_log_errno(g->g_cl, CL_LEVEL_FAIL, "st_export", err,
+                 "can't export %s", gs->gs_type->st_name);
+    cm_buffer_finish(&buf);
+    return;
+  }
+  if ((n = cm_buffer_length(&buf)) == 0 || n > grs->grs_slot_size) {
+    cl_log(g->g_cl, CL_LEVEL_DEBUG,
+           "graphd_iterator_resource_share_publish: "
+           "not sharing %zu bytes of %s",
+           n, gs->gs_type->st_name);
+    cm_buffer_finish(&buf);
+    return;
+  }
+
+  share_lock(grs);
+
+  /*  Replace an older copy of the same resource, a free
+   *  slot, or the cheapest one.
+   */
+  if ((grss = share_find(grs, stamp_s, stamp_e)) == NULL) {
+    grss = grs->grs_slot;
+    for (i = 0; i < GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS; i++) {
+      if (grs->grs_slot[i].grss_size == 0) {
+        grss = grs->grs_slot + i;
+        break;
+      }
+      if (grs->grs_slot[i].grss_priority < grss->grss_priority)
+        grss = grs->grs_slot + i;
+    }
+    if (grss->grss_size > 0) grs->grs_clock = grss->grss_priority;
+  }
+
+  grs->grs_writing = grss - grs->grs_slot;
+  memcpy(share_data(grs, grs->grs_writing), cm_buffer_memory(&buf), n);
+  memcpy(grss->grss_stamp, stamp_s, stamp_e - stamp_s);
+  grss->grss_stamp[stamp_e - stamp_s] = '\0';
+  grss->grss_type = gs->gs_type;
+  grss->grss_cost = graphd_storable_cost(gs);
+  grss->grss_size = n;
+  grss->grss_priority = grs->grs_clock + (double)(grss->grss_cost + 1) / n;
+  grs->grs_writing = -1;
+  grs->grs_published++;
+
+  share_unlock(grs);
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG,
+         "graphd_iterator_resource_share_publish: %.*s: %zu bytes of %s "
+         "($%lld)",
+         (int)(stamp_e - stamp_s), stamp_s, n, gs->gs_type->st_name,
+         (long long)graphd_storable_cost(gs));
+  cm_buffer_finish(&buf);
+}
+
+/**
+ * @brief Look for a resource that another process published.
+ *
+ * @param g		graphd handle
+ * @param stamp_s	beginning of the stamp
+ * @param stamp_e	end of the stamp
+ * @param expected_type	NULL or the type the caller wants
+ *
+ * @return NULL if there's no such resource, otherwise a
+ *	fresh storable holding one reference.
+ */
+graphd_storable *graphd_iterator_resource_share_lookup(
+    graphd_handle *g, char const *stamp_s, char const *stamp_e,
+    graphd_storable_type const *expected_type) {
+  graphd_iterator_resource_share *grs = g->g_iterator_resource_share;
+  graphd_iterator_resource_share_slot *grss;
+  graphd_storable_type const *type;
+  graphd_storable *gs;
+  pdb_budget cost;
+  char *data;
+  size_t n;
+
+  if (grs == NULL || stamp_e - stamp_s >= GRAPHD_ITERATOR_RESOURCE_STAMP_SIZE)
+    return NULL;
+
+  share_lock(grs);
+  if ((grss = share_find(grs, stamp_s, stamp_e)) == NULL ||
+      (expected_type != NULL && grss->grss_type != expected_type) ||
+      grss->grss_type->st_import == NULL) {
+    grs->grs_miss++;
+    share_unlock(grs);
+    return NULL;
+  }
+
+  /*  Copy the data out, so we don't hold the lock
+   *  while rebuilding the storable.
+   */
+  n = grss->grss_size;
+  if ((data = cm_malloc(g->g_cm, n)) == NULL) {
+    share_unlock(grs);
+    return NULL;
+  }
+  memcpy(data, share_data(grs, grss - grs->grs_slot), n);
+  type = grss->grss_type;
+  cost = grss->grss_cost;
+  grss->grss_priority = grs->grs_clock + (double)(cost + 1) / n;
+  grs->grs_hit++;
+  share_unlock(grs);
+
+  gs = (*type->st_import)(g, data, n);
+  cm_free(g->g_cm, data);
+
+  if (gs == NULL) {
+    cl_log(g->g_cl, CL_LEVEL_FAIL,
+           "graphd_iterator_resource_share_lookup: can't import "
+           "%zu bytes of %s",
+           n, type->st_name);
+    return NULL;
+  }
+  graphd_storable_cost(gs) = cost;
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG,
+         "graphd_iterator_resource_share_lookup: %.*s: %zu bytes of %s",
+         (int)(stamp_e - stamp_s), stamp_s, n, type->st_name);
+  return gs;
+}
+
+/**
+ * @brief Report on the shared segment, for "status (resource)".
+ *
+ * @param g		graphd handle
+ * @param used_out	out: number of slots holding a resource
+ * @param hit_out	out: lookups that found their resource
+ * @param miss_out	out: lookups that didn't
+ */
+void graphd_iterator_resource_share_counts(graphd_handle *g, size_t *used_out,
+                                           unsigned long long *hit_out,
+                                           unsigned long long *miss_out) {
+  graphd_iterator_resource_share *grs = g->g_iterator_resource_share;
+  size_t i;
+
+  *used_out = 0;
+  *hit_out = *miss_out = 0;
+  if (grs == NULL) return;
+
+  share_lock(grs);
+  for (i = 0; i < GRAPHD_ITERATOR_RESOURCE_SHARE_SLOTS; i++)
+    *used_out += grs->grs_slot[i].grss_size > 0;
+  *hit_out = grs->grs_hit;
+  *miss_out = grs->grs_miss;
+  share_unlock(grs);
+}
+
+/**
+ * @brief Parse an option from the configuration file.  (Method.)
+ *
+ *  This is a method of the generic libsrv parameter mechanism,
+ *  passed in via a srv_config_parameter[] structure declared in graphd.c.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ * @param s		in/out: current position in the configuration file
+ * @param e		in: end of the buffered configuration file
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_iterator_resource_share_config_read(void *data, srv_handle *srv,
+                                               void *config_data,
+                                               srv_config *srv_cf, char **s,
+                                               char const *e) {
+  cl_handle *cl = srv_log(srv);
+  graphd_config *gcf = config_data;
+  unsigned long long n = 0;
+  int err;
+
+  err = srv_config_read_number(
+      srv_cf, cl, "size of the shared iterator resource segment, in bytes", s,
+      e, &n);
+  if (err != 0) return err;
+
+  if (n != 0 && (n < GRAPHD_ITERATOR_RESOURCE_SHARE_MIN || n > (size_t)-1)) {
+    cl_log(cl, CL_LEVEL_OPERATOR_ERROR,
+           "configuration file %s, line %d: iterator-resource-share %llu "
+           "must be 0 or between %llu and %llu",
+           srv_config_file_name(srv_cf), srv_config_line_number(srv_cf, e), n,
+           GRAPHD_ITERATOR_RESOURCE_SHARE_MIN, (unsigned long long)(size_t)-1);
+    return ERANGE;
+  }
+
+  gcf->gcf_iterator_resource_share = n;
+  return 0;
+}
+
+/**
+ * @brief Set an option as configured.  (Method.)
+ *
+ *  This is a method of the generic libsrv parameter mechanism,
+ *  passed in via a srv_config_parameter[] structure declared in graphd.c.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_iterator_resource_share_config_open(void *data, srv_handle *srv,
+                                               void *config_data,
+                                               srv_config *srv_cf) {
+  graphd_handle *g = data;
+  graphd_config *gcf = config_data;
+
+  cl_assert(srv_log(srv), g != NULL);
+  cl_assert(srv_log(srv), config_data != NULL);
+
+  g->g_iterator_resource_share_size = gcf->gcf_iterator_resource_share;
+  return 0;
+}
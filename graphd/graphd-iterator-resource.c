@@ -16,12 +16,13 @@ limitations under the License.
 #include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*  resource/storable pointers
  *
- *  gir_next/gir_prev			doubly linked queue.  Deletions
- *					start at head.
+ *  gir_next/gir_prev			doubly linked queue, least
+ *					recently used first.
  *
  *  gir_storable_next			singly linked hash chain.
  *
@@ -98,6 +99,21 @@ static size_t resource_size(graphd_handle *g,
                                         graphd_iterator_resource, gir));
 }
 
+/*  Eviction uses greedy-dual-size-frequency: a resource's
+ *  priority is the value of a clock at its last use, plus the
+ *  budget it took to compute per byte it occupies.  The cheapest
+ *  resources are evicted first; each eviction advances the clock
+ *  to the evicted priority, so that entries that haven't been
+ *  used in a while eventually lose out to new ones, no matter
+ *  how expensive they were.
+ */
+static void resource_touch(graphd_handle *g, graphd_iterator_resource *gir) {
+  gir->gir_priority =
+      g->g_iterator_resource_clock +
+      (double)(graphd_storable_cost(gir->gir_storable) + 1) /
+          resource_size(g, gir);
+}
+
 static void resource_flush(graphd_handle *g, graphd_iterator_resource *gir) {
   cl_handle *cl = g->g_cl;
   size_t size;
@@ -164,13 +180,20 @@ static void resource_flush(graphd_handle *g, graphd_iterator_resource *gir) {
       /* Replace entry with successor;
        * free successor's memory
        */
-      void *data = gir->gir_storable_next;
-
-      move_stamp(g, data, gir);
-      move_chain(g, data, gir);
-
-      *gir = *gir->gir_storable_next;
-      cm_free(g->g_cm, data);
+      graphd_iterator_resource *next = gir->gir_storable_next;
+
+      gir->gir_stamp = NULL;
+      move_stamp(g, next, gir);
+      move_chain(g, next, gir);
+
+      gir->gir_storable = next->gir_storable;
+      gir->gir_storable_next = next->gir_storable_next;
+      gir->gir_callback = next->gir_callback;
+      gir->gir_callback_data = next->gir_callback_data;
+      gir->gir_used = next->gir_used;
+      gir->gir_priority = next->gir_priority;
+      gir->gir_shared_size = next->gir_shared_size;
+      cm_free(g->g_cm, next);
     } else {
       /* Remove the record from
        * the hashtable; it's the only
@@ -185,7 +208,7 @@ static void resource_flush(graphd_handle *g, graphd_iterator_resource *gir) {
     while (*girp != NULL && *girp != gir) girp = &(*girp)->gir_storable_next;
     cl_assert(cl, *girp == gir);
 
-    *girp = (*girp)->gir_next;
+    *girp = (*girp)->gir_storable_next;
     cm_free(g->g_cm, gir);
   }
 
@@ -250,7 +273,7 @@ static graphd_iterator_resource *graphd_iterator_resource_storable_allocate(
   if (gir->gir_storable != NULL && graphd_storable_equal(gir->gir_storable, gs))
     return gir;
 
-  girp = &gir->gir_next;
+  girp = &gir->gir_storable_next;
   while (*girp != NULL) {
     if ((*girp)->gir_storable != NULL &&
         graphd_storable_equal((*girp)->gir_storable, gs))
@@ -275,7 +298,12 @@ int graphd_iterator_resource_initialize(graphd_handle *g) {
   g->g_iterator_resource_head = NULL;
   g->g_iterator_resource_tail = NULL;
   g->g_iterator_resource_size = 0;
-  g->g_iterator_resource_max = GRAPHD_ITERATOR_RESOURCE_MAX;
+  if (g->g_iterator_resource_max == 0)
+    g->g_iterator_resource_max = GRAPHD_ITERATOR_RESOURCE_MAX;
+  g->g_iterator_resource_clock = 0;
+  g->g_iterator_resource_hit = 0;
+  g->g_iterator_resource_miss = 0;
+  g->g_iterator_resource_evicted = 0;
 
   err = cm_hashinit(cm, &g->g_iterator_resource,
                     sizeof(graphd_iterator_resource), 100);
@@ -288,6 +316,18 @@ int graphd_iterator_resource_initialize(graphd_handle *g) {
     return err;
   }
 
+  /*  With predictable stamps, different processes would hand
+   *  out the same stamps for different resources.
+   */
+  if (g->g_predictable && g->g_smp_processes > 1)
+    g->g_iterator_resource_share_size = 0;
+
+  err = graphd_iterator_resource_share_initialize(g);
+  if (err != 0) {
+    cm_hashfinish(&g->g_iterator_resource);
+    cm_hashfinish(&g->g_iterator_resource_stamp);
+    return err;
+  }
   return 0;
 }
 
@@ -297,6 +337,120 @@ void graphd_iterator_resource_finish(graphd_handle *g) {
 
   cm_hashfinish(&g->g_iterator_resource);
   cm_hashfinish(&g->g_iterator_resource_stamp);
+
+  graphd_iterator_resource_share_finish(g);
+}
+
+typedef struct resource_victim {
+  double rv_priority;
+  size_t rv_order;
+  graphd_storable *rv_storable;
+
+} resource_victim;
+
+static int resource_victim_compare(void const *A, void const *B) {
+  resource_victim const *a = A, *b = B;
+
+  if (a->rv_priority != b->rv_priority)
+    return a->rv_priority < b->rv_priority ? -1 : 1;
+
+  /*  Among equals, least recently used first.
+   */
+  return a->rv_order < b->rv_order ? -1 : a->rv_order > b->rv_order;
+}
+
+/*  We're over the limit.  Free resources, lowest priority
+ *  first, until we're down to half the limit.  The most
+ *  recently stored resource -- the one at the tail -- stays;
+ *  we just handed out its stamp.
+ */
+static void resource_shrink(graphd_handle *g) {
+  graphd_iterator_resource *gir;
+  resource_victim *rv;
+  size_t i, n = 0;
+  unsigned long long old = g->g_iterator_resource_size;
+
+  for (gir = g->g_iterator_resource_head;
+       gir != g->g_iterator_resource_tail; gir = gir->gir_next)
+    n++;
+
+  if (n == 0 || (rv = cm_malloc(g->g_cm, n * sizeof(*rv))) == NULL) {
+    /*  Fall back to plain LRU.
+     */
+    while (g->g_iterator_resource_size > g->g_iterator_resource_max / 2) {
+      cl_assert(g->g_cl, g->g_iterator_resource_head);
+      resource_flush(g, g->g_iterator_resource_head);
+      g->g_iterator_resource_evicted++;
+    }
+  } else {
+    for (i = 0, gir = g->g_iterator_resource_head; i < n;
+         i++, gir = gir->gir_next) {
+      rv[i].rv_priority = gir->gir_priority;
+      rv[i].rv_order = i;
+      rv[i].rv_storable = gir->gir_storable;
+    }
+    qsort(rv, n, sizeof(*rv), resource_victim_compare);
+
+    /*  Flushing can move records around in the hashtable;
+     *  look each one up again by its storable.
+     */
+    for (i = 0;
+         i < n && g->g_iterator_resource_size > g->g_iterator_resource_max / 2;
+         i++) {
+      gir = graphd_iterator_resource_storable_lookup(g, rv[i].rv_storable);
+      cl_assert(g->g_cl, gir != NULL);
+
+      g->g_iterator_resource_clock = rv[i].rv_priority;
+      resource_flush(g, gir);
+      g->g_iterator_resource_evicted++;
+    }
+    cm_free(g->g_cm, rv);
+  }
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG,
+         "graphd_iterator_resource_store: freed "
+         "%llu bytes of iterator resources",
+         (unsigned long long)(old - g->g_iterator_resource_size));
+}
+
+/*  Enter the storable <gs> into a fresh resource record <gir>,
+ *  under the stamp <stamp_s>...<stamp_e>.
+ */
+static int resource_insert(graphd_handle *g, graphd_iterator_resource *gir,
+                           graphd_storable *gs, char const *stamp_s,
+                           char const *stamp_e) {
+  graphd_iterator_resource **gir_stamp;
+  size_t size = graphd_storable_size(gs);
+
+  gir_stamp = cm_hexcl(&g->g_iterator_resource_stamp,
+                       graphd_iterator_resource *, stamp_s, stamp_e - stamp_s);
+  if (gir_stamp == NULL) return errno ? errno : ENOMEM;
+
+  /*  Account for the claims ticket in the
+   *  iterator size.
+   */
+  g->g_iterator_resource_size += size + sizeof(*gir);
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG, "iterator-resource %p size=%zu, total %llu",
+         (void *)gir, size + sizeof(*gir), g->g_iterator_resource_size);
+
+  /*  Link from the ticket to the gir, and from the
+   *  gir to the ticket.
+   */
+  *gir_stamp = gir;
+  gir->gir_stamp = (void *)gir_stamp;
+
+  gir->gir_next = NULL;
+  gir->gir_prev = NULL;
+
+  /*  Place the storable in the resource record.
+   */
+  gir->gir_storable = gs;
+  graphd_storable_link(gs);
+  gs->gs_stored = true;
+
+  cl_assert(g->g_cl, gir->gir_storable == gs);
+  return 0;
 }
 
 /**
@@ -331,39 +485,13 @@ int graphd_iterator_resource_store(graphd_handle *g, graphd_storable *data,
   if (gir == NULL) return ENOMEM;
 
   if (gir->gir_stamp == NULL) {
-    graphd_iterator_resource **gir_stamp;
+    int err;
 
     /*  Make a new claims ticket for this resource.
      */
     stamp = resource_stamp(g, stamp_buf, stamp_size);
-    gir_stamp = cm_hexcl(&g->g_iterator_resource_stamp,
-                         graphd_iterator_resource *, stamp, strlen(stamp));
-    if (gir_stamp == NULL) return errno ? errno : ENOMEM;
-
-    /*  Account for the claims ticket in the
-     *  iterator size.
-     */
-    g->g_iterator_resource_size += size + sizeof(*gir);
-
-    cl_log(g->g_cl, CL_LEVEL_DEBUG, "iterator-resource %p size=%zu, total %llu",
-           (void *)gir, size + sizeof(*gir), g->g_iterator_resource_size);
-
-    /*  Link from the ticket to the gir, and from the
-     *  gir to the ticket.
-     */
-    *gir_stamp = gir;
-    gir->gir_stamp = (void *)gir_stamp;
-
-    gir->gir_next = NULL;
-    gir->gir_prev = NULL;
-
-    /*  Place the storable in the resource record.
-     */
-    gir->gir_storable = gs;
-    graphd_storable_link(gs);
-    gs->gs_stored = true;
-
-    cl_assert(g->g_cl, gir->gir_storable == gs);
+    err = resource_insert(g, gir, gs, stamp, stamp + strlen(stamp));
+    if (err != 0) return err;
   } else {
     size_t size;
 
@@ -400,23 +528,51 @@ int graphd_iterator_resource_store(graphd_handle *g, graphd_storable *data,
   cm_list_enqueue(graphd_iterator_resource, graphd_iterator_resource_offsets,
                   &g->g_iterator_resource_head, &g->g_iterator_resource_tail,
                   gir);
+  resource_touch(g, gir);
 
-  /*  If that put us over the allowed size, free some old records.
+  /*  If it's new or has grown since, offer it to the
+   *  other processes.
    */
-  if (g->g_iterator_resource_size > g->g_iterator_resource_max) {
-    size_t old = g->g_iterator_resource_size;
-    while (g->g_iterator_resource_size > g->g_iterator_resource_max / 2) {
-      cl_assert(g->g_cl, g->g_iterator_resource_head);
-      resource_flush(g, g->g_iterator_resource_head);
-    }
-    cl_log(g->g_cl, CL_LEVEL_DEBUG,
-           "graphd_iterator_resource_store: freed "
-           "%llu bytes of iterator resources",
-           (unsigned long long)(old - g->g_iterator_resource_size));
+  if (g->g_iterator_resource_share != NULL &&
+      gir->gir_shared_size != graphd_storable_size(gs)) {
+    graphd_iterator_resource_share_publish(g, gs, stamp_buf,
+                                           stamp_buf + strlen(stamp_buf));
+    gir->gir_shared_size = graphd_storable_size(gs);
   }
+
+  /*  If that put us over the allowed size, free some old records.
+   */
+  if (g->g_iterator_resource_size > g->g_iterator_resource_max)
+    resource_shrink(g);
   return 0;
 }
 
+/*  Keep a storable we got from the shared segment in the
+ *  local cache, under the stamp it was published with.
+ */
+static void resource_adopt(graphd_handle *g, graphd_storable *gs,
+                           char const *stamp_s, char const *stamp_e) {
+  graphd_iterator_resource *gir;
+
+  if (graphd_storable_size(gs) + sizeof(*gir) >
+      g->g_iterator_resource_max / 2)
+    return;
+
+  gir = graphd_iterator_resource_storable_allocate(g, gs);
+  if (gir == NULL || gir->gir_stamp != NULL ||
+      resource_insert(g, gir, gs, stamp_s, stamp_e) != 0)
+    return;
+
+  cm_list_enqueue(graphd_iterator_resource, graphd_iterator_resource_offsets,
+                  &g->g_iterator_resource_head, &g->g_iterator_resource_tail,
+                  gir);
+  resource_touch(g, gir);
+  gir->gir_shared_size = graphd_storable_size(gs);
+
+  if (g->g_iterator_resource_size > g->g_iterator_resource_max)
+    resource_shrink(g);
+}
+
 /*  If a storable is found, return a shared link to it.
  */
 static void *graphd_iterator_resource_lookup(graphd_handle *g,
@@ -443,11 +599,14 @@ static void *graphd_iterator_resource_lookup(graphd_handle *g,
            "graphd_iterator_resource_lookup: MISS can't "
            "find \"%.*s\"",
            (int)(stamp_e - stamp_s), stamp_s);
+    g->g_iterator_resource_miss++;
     return NULL;
   }
 
+  g->g_iterator_resource_hit++;
   cl_assert(cl, (*gir_stamp)->gir_storable != NULL);
   (*gir_stamp)->gir_used = true;
+  resource_touch(g, *gir_stamp);
 
   return (*gir_stamp)->gir_storable;
 }
@@ -467,9 +626,17 @@ void *graphd_iterator_resource_thaw(graphd_handle *g, char const **s_ptr,
   while (s < e && isascii(*s) && (isxdigit(*s) || *s == 'x')) s++;
 
   gs = graphd_iterator_resource_lookup(g, *s_ptr, s);
-  *s_ptr = s;
+  if (gs == NULL) {
+    /*  Maybe another process made it?  If yes, we
+     *  get a fresh storable with one link for the caller.
+     */
+    gs = graphd_iterator_resource_share_lookup(g, *s_ptr, s, expected_type);
+    if (gs != NULL) resource_adopt(g, gs, *s_ptr, s);
+    *s_ptr = s;
 
-  if (gs == NULL) return NULL;
+    return gs;
+  }
+  *s_ptr = s;
 
   if (expected_type != NULL && gs->gs_type != expected_type) return NULL;
 
@@ -480,3 +647,140 @@ void *graphd_iterator_resource_thaw(graphd_handle *g, char const **s_ptr,
   graphd_storable_link(gs);
   return gs;
 }
+
+static int resource_status_pair(graphd_handle *g, cm_handle *cm,
+                                cl_handle *cl, graphd_value *val,
+                                char const *name, unsigned long long n) {
+  int err;
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 2);
+  if (err != 0) return err;
+
+  err = graphd_value_text_strdup(cm, val->val_list_contents,
+                                 GRAPHD_VALUE_STRING, name,
+                                 name + strlen(name));
+  if (err != 0) return err;
+
+  graphd_value_number_set(val->val_list_contents + 1, n);
+  return 0;
+}
+
+/*
+ *  resource: (("entries" n) ("bytes" n) ("max" n)
+ *		("hit" n) ("miss" n) ("evicted" n)
+ *		("shared" n) ("shared-hit" n) ("shared-miss" n))
+ *
+ *  The "shared" counts are those of the segment, summed over
+ *  all processes that use it; they're 0 if there isn't one.
+ */
+int graphd_iterator_resource_status(graphd_request *greq, graphd_value *val) {
+  cl_handle *cl = graphd_request_cl(greq);
+  cm_handle *cm = greq->greq_req.req_cm;
+  graphd_handle *g = graphd_request_graphd(greq);
+  graphd_iterator_resource const *gir;
+  unsigned long long n = 0, share_hit, share_miss;
+  size_t share_used;
+  graphd_value *el;
+  int err;
+
+  for (gir = g->g_iterator_resource_head; gir != NULL; gir = gir->gir_next)
+    n++;
+  graphd_iterator_resource_share_counts(g, &share_used, &share_hit,
+                                        &share_miss);
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 9);
+  if (err != 0) return err;
+
+  el = val->val_list_contents;
+  err = resource_status_pair(g, cm, cl, el++, "entries", n);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "bytes",
+                               g->g_iterator_resource_size);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "max",
+                               g->g_iterator_resource_max);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "hit",
+                               g->g_iterator_resource_hit);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "miss",
+                               g->g_iterator_resource_miss);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "evicted",
+                               g->g_iterator_resource_evicted);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "shared", share_used);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "shared-hit", share_hit);
+  if (err == 0)
+    err = resource_status_pair(g, cm, cl, el++, "shared-miss", share_miss);
+  if (err != 0) graphd_value_finish(cl, val);
+
+  return err;
+}
+
+/**
+ * @brief Parse an option from the configuration file.  (Method.)
+ *
+ *  "iterator-resource-max <size>" sets how many bytes the
+ *  per-process resource cache may hold before it starts evicting.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ * @param s		in/out: current position in the configuration file
+ * @param e		in: end of the buffered configuration file
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_iterator_resource_config_read(void *data, srv_handle *srv,
+                                         void *config_data, srv_config *srv_cf,
+                                         char **s, char const *e) {
+  cl_handle *cl = srv_log(srv);
+  graphd_config *gcf = config_data;
+  unsigned long long n = 0;
+  int err;
+
+  err = srv_config_read_number(
+      srv_cf, cl, "maximum size of the iterator resource cache, in bytes", s,
+      e, &n);
+  if (err != 0) return err;
+
+  if (n < 4096) {
+    cl_log(cl, CL_LEVEL_OPERATOR_ERROR,
+           "configuration file %s, line %d: iterator-resource-max %llu "
+           "must be at least 4096",
+           srv_config_file_name(srv_cf), srv_config_line_number(srv_cf, e), n);
+    return ERANGE;
+  }
+
+  gcf->gcf_iterator_resource_max = n;
+  return 0;
+}
+
+/**
+ * @brief Set an option as configured.  (Method.)
+ *
+ *  This is a method of the generic libsrv parameter mechanism,
+ *  passed in via a srv_config_parameter[] structure declared in graphd.c.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_iterator_resource_config_open(void *data, srv_handle *srv,
+                                         void *config_data,
+                                         srv_config *srv_cf) {
+  graphd_handle *g = data;
+  graphd_config *gcf = config_data;
+
+  cl_assert(srv_log(srv), g != NULL);
+  cl_assert(srv_log(srv), config_data != NULL);
+
+  g->g_iterator_resource_max = gcf->gcf_iterator_resource_max;
+  return 0;
+}
@@ -88,6 +88,12 @@ typedef struct graphd_iterator_sort {
    */
   pdb_id sort_idset_last_added;
 
+  /**
+   * @brief Budget spent filling the idset before it had
+   *	a storable to charge it to.
+   */
+  pdb_budget sort_idset_cost;
+
   /**
    * @brief Only in the original - the most recently
    *	returned ID.
@@ -224,9 +230,62 @@ static void sort_storable_destroy(void *data) {
 
 static bool sort_storable_equal(void const *A, void const *B) { return A == B; }
 
+static graphd_iterator_sort_storable *graphd_iterator_sort_storable_alloc(
+    cm_handle *cm, cl_handle *cl, graph_idset *idset, pdb_id idset_last_added);
+
+/*  Shared copy: the last-added ID and the contents of the
+ *  idset, in ascending order, as 5-byte big-endian numbers.
+ *  (A last-added PDB_ID_NONE comes out as all ones.)
+ */
+static int sort_storable_export(void const *data, cm_buffer *buf) {
+  graphd_iterator_sort_storable const *sos = data;
+  graph_idset_position pos;
+  unsigned long long id = sos->sos_idset_last_added;
+  char b5[5];
+  int i, err;
+
+  graph_idset_next_reset(sos->sos_idset, &pos);
+  do {
+    for (i = 0; i < 5; i++) b5[i] = (char)(id >> (8 * (4 - i)));
+    if ((err = cm_buffer_add_bytes(buf, b5, sizeof b5)) != 0) return err;
+  } while (graph_idset_next(sos->sos_idset, &id, &pos));
+
+  return 0;
+}
+
+static void *sort_storable_import(graphd_handle *g, char const *s,
+                                  size_t n) {
+  graphd_iterator_sort_storable *sos;
+  graph_idset *idset;
+  unsigned long long id, last_added = PDB_ID_NONE;
+  size_t k;
+  int i;
+
+  if (n < 5 || n % 5 != 0) return NULL;
+  if ((idset = graph_idset_tile_create(g->g_graph)) == NULL) return NULL;
+
+  for (k = 0; k < n / 5; k++) {
+    for (id = 0, i = 0; i < 5; i++) id = id << 8 | (unsigned char)*s++;
+    if (k == 0)
+      last_added = id == 0xFFFFFFFFFFull ? PDB_ID_NONE : id;
+    else if (graph_idset_insert(idset, id) != 0) {
+      graph_idset_free(idset);
+      return NULL;
+    }
+  }
+
+  sos =
+      graphd_iterator_sort_storable_alloc(g->g_cm, g->g_cl, idset, last_added);
+  if (sos == NULL) {
+    graph_idset_free(idset);
+    return NULL;
+  }
+  return sos;
+}
+
 static const graphd_storable_type sort_storable_type = {
-    "sort cache", sort_storable_destroy, sort_storable_equal,
-    sort_storable_hash};
+    "sort cache",         sort_storable_destroy, sort_storable_equal,
+    sort_storable_hash,   sort_storable_export,  sort_storable_import};
 
 /*  Create a fresh sort-storable
  *  You will allocate in CM and log through CL.
@@ -244,7 +303,10 @@ static graphd_iterator_sort_storable *graphd_iterator_sort_storable_alloc(
 
   sos->sos_storable.gs_linkcount = 1;
   sos->sos_storable.gs_type = &sort_storable_type;
-  sos->sos_storable.gs_size = sizeof(*sos);
+
+  /*  Each idset entry takes up about 8 bytes.
+   */
+  sos->sos_storable.gs_size = sizeof(*sos) + idset->gi_n * 8;
 
   sos->sos_cm = cm;
   sos->sos_cl = cl;
@@ -264,6 +326,8 @@ static int store_idset(pdb_iterator *it) {
         g->g_cm, g->g_cl, sort->sort_idset, sort->sort_idset_last_added);
     if (sort->sort_idset_storable == NULL) return ENOMEM;
 
+    graphd_storable_cost_add(sort->sort_idset_storable, sort->sort_idset_cost);
+    sort->sort_idset_cost = 0;
     sort->sort_idset = sort->sort_idset_storable->sos_idset;
     sort->sort_idset_last_added =
         sort->sort_idset_storable->sos_idset_last_added;
@@ -348,12 +412,24 @@ static int update_horizon(pdb_iterator *it) {
 static int expand_cache(pdb_handle *pdb, pdb_iterator *it,
                         pdb_budget *budget_inout) {
   cl_handle *cl = osort(it)->sort_cl;
+  graphd_iterator_sort_storable *sos = osort(it)->sort_idset_storable;
+  pdb_budget const budget_in = *budget_inout;
+  unsigned long long n;
   int err;
   pdb_id id;
 
   cl_assert(cl, osort(it)->sort_idset != NULL);
 
   err = pdb_iterator_next(pdb, osort(it)->sort_sub, &id, budget_inout);
+
+  /*  Remember what it cost to compute the set, for the
+   *  benefit of the resource cache.
+   */
+  if (sos != NULL)
+    graphd_storable_cost_add(sos, budget_in - *budget_inout);
+  else
+    osort(it)->sort_idset_cost += budget_in - *budget_inout;
+
   if (err != 0) {
     cl_log(cl, CL_LEVEL_VERBOSE,
            "expand_cache: "
@@ -376,9 +452,13 @@ static int expand_cache(pdb_handle *pdb, pdb_iterator *it,
     return err;
   }
 
+  n = osort(it)->sort_idset->gi_n;
   err = graph_idset_insert(osort(it)->sort_idset, id);
   if (err != 0) return err;
 
+  if (sos != NULL && osort(it)->sort_idset->gi_n > n)
+    graphd_storable_size_add(osort(it)->sort_graphd, sos, 8);
+
   if (id == osort(it)->sort_idset_resume)
     osort(it)->sort_idset_resume = PDB_ID_NONE;
   osort(it)->sort_idset_last_added = id;
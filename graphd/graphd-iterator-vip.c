@@ -105,40 +105,20 @@ static int vip_iterator_check(pdb_handle *pdb, pdb_iterator *it,
 
     err = pdb_iterator_check(pdb, vip->vip_sub, check_id, budget_inout);
   else {
-    graph_guid guid;
-    pdb_primitive pr;
+    pdb_column_record pcr;
 
-    if ((err = pdb_id_read(pdb, check_id, &pr)) != 0) {
-      cl_log_errno(vip->vip_cl, CL_LEVEL_ERROR, "pdb_id_read", err, "id=%lld",
-                   (long long)check_id);
+    if ((err = pdb_column_read(pdb, check_id, &pcr)) != 0) {
+      cl_log_errno(vip->vip_cl, CL_LEVEL_ERROR, "pdb_column_read", err,
+                   "id=%lld", (long long)check_id);
       goto err;
     }
 
     *budget_inout -= PDB_COST_PRIMITIVE;
 
-    if (!pdb_primitive_has_linkage(&pr, vip->vip_linkage) ||
-        !pdb_primitive_has_linkage(&pr, PDB_LINKAGE_TYPEGUID)) {
-    not_this_primitive:
+    found_id = pcr.pcr_linkage[vip->vip_linkage];
+    if (found_id == PDB_ID_NONE || found_id != vip->vip_source_id ||
+        pcr.pcr_linkage[PDB_LINKAGE_TYPEGUID] != vip->vip_type_id)
       err = PDB_ERR_NO;
-      pdb_primitive_finish(pdb, &pr);
-      goto err;
-    }
-
-    pdb_primitive_linkage_get(&pr, vip->vip_linkage, guid);
-    err = pdb_id_from_guid(pdb, &found_id, &guid);
-    if (err != 0) {
-      char buf[200];
-      cl_log_errno(vip->vip_cl, CL_LEVEL_ERROR, "pdb_id_from_guid", err,
-                   "guid=%s", graph_guid_to_string(&guid, buf, sizeof buf));
-      pdb_primitive_finish(pdb, &pr);
-      goto err;
-    }
-    if (found_id != vip->vip_source_id) goto not_this_primitive;
-
-    pdb_primitive_linkage_get(&pr, PDB_LINKAGE_TYPEGUID, guid);
-    if (!GRAPH_GUID_EQ(vip->vip_type_guid, guid)) goto not_this_primitive;
-
-    pdb_primitive_finish(pdb, &pr);
   }
 
 err:
@@ -0,0 +1,327 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsrv/srv.h"
+
+/**
+ * @file graphd-plan-cache.c
+ * @brief Remember which producer an "and" iterator picked.
+ *
+ *  Applications tend to send the same few query shapes over and
+ *  over, with different GUIDs.  The statistics contest that picks
+ *  a producer for an "and" iterator is expensive, and usually
+ *  comes to the same conclusion every time.
+ *
+ *  The cache is keyed by the constraint's signature (without
+ *  cursor, and with GUIDs other than VIP type GUIDs blanked out),
+ *  plus the direction and types of the "and" subiterators.  It
+ *  stores the contest's winner and estimates; the next "and" with
+ *  the same key skips the contest.
+ *
+ *  Along with the plan, we store the subiterators' counts.  If
+ *  one of them has since changed by more than a factor of
+ *  GRAPHD_PLAN_CACHE_DRIFT, the plan is dropped and the contest
+ *  reruns.
+ *
+ *  The number of plans is set with "plan-cache <n>" in the
+ *  configuration file; 0 turns the cache off.
+ */
+
+/*  A subiterator count may change by this factor before
+ *  we stop trusting a plan made with it...
+ */
+#define GRAPHD_PLAN_CACHE_DRIFT 4
+
+/*  ...plus this much, so that small sets don't flap.
+ */
+#define GRAPHD_PLAN_CACHE_DRIFT_SLACK 64
+
+struct graphd_plan_cache_entry {
+  graphd_plan pce_plan;
+
+  /*  LRU list, least recently used first.
+   */
+  graphd_plan_cache_entry *pce_next;
+  graphd_plan_cache_entry *pce_prev;
+
+  unsigned long long pce_hits;
+};
+
+static const cm_list_offsets graphd_plan_cache_offsets =
+    CM_LIST_OFFSET_INIT(graphd_plan_cache_entry, pce_next, pce_prev);
+
+static void plan_cache_delete(graphd_handle *g, graphd_plan_cache_entry *pce) {
+  cm_list_remove(graphd_plan_cache_entry, graphd_plan_cache_offsets,
+                 &g->g_plan_cache_head, &g->g_plan_cache_tail, pce);
+  cm_hdelete(&g->g_plan_cache, graphd_plan_cache_entry, pce);
+}
+
+int graphd_plan_cache_initialize(graphd_handle *g) {
+  g->g_plan_cache_head = NULL;
+  g->g_plan_cache_tail = NULL;
+  g->g_plan_cache_hits = 0;
+  g->g_plan_cache_misses = 0;
+  g->g_plan_cache_invalidations = 0;
+
+  return cm_hashinit(pdb_mem(g->g_pdb), &g->g_plan_cache,
+                     sizeof(graphd_plan_cache_entry), 64);
+}
+
+void graphd_plan_cache_finish(graphd_handle *g) {
+  cm_hashfinish(&g->g_plan_cache);
+  g->g_plan_cache_head = NULL;
+  g->g_plan_cache_tail = NULL;
+}
+
+/**
+ * @brief Look up a plan.
+ *
+ * @param g		graphd handle
+ * @param key		signature and shape of the "and"
+ * @param key_n		number of bytes pointed to by key
+ * @param plan_out	on success, assign the plan to this.
+ *
+ * @return true if there was a plan, false otherwise.
+ */
+bool graphd_plan_cache_lookup(graphd_handle *g, char const *key, size_t key_n,
+                              graphd_plan *plan_out) {
+  graphd_plan_cache_entry *pce;
+
+  if (g->g_plan_cache_max == 0) return false;
+
+  pce = cm_haccess(&g->g_plan_cache, graphd_plan_cache_entry, key, key_n);
+  if (pce == NULL) {
+    g->g_plan_cache_misses++;
+    return false;
+  }
+
+  /*  Move to the most recently used end.
+   */
+  cm_list_remove(graphd_plan_cache_entry, graphd_plan_cache_offsets,
+                 &g->g_plan_cache_head, &g->g_plan_cache_tail, pce);
+  cm_list_enqueue(graphd_plan_cache_entry, graphd_plan_cache_offsets,
+                  &g->g_plan_cache_head, &g->g_plan_cache_tail, pce);
+
+  pce->pce_hits++;
+  g->g_plan_cache_hits++;
+
+  *plan_out = pce->pce_plan;
+  return true;
+}
+
+/**
+ * @brief Remember a plan, replacing any previous one for the key.
+ *
+ * @param g		graphd handle
+ * @param key		signature and shape of the "and"
+ * @param key_n		number of bytes pointed to by key
+ * @param plan		the plan to remember
+ *
+ * @return 0 on success, ENOMEM on allocation error.
+ */
+int graphd_plan_cache_store(graphd_handle *g, char const *key, size_t key_n,
+                            graphd_plan const *plan) {
+  graphd_plan_cache_entry *pce;
+
+  if (g->g_plan_cache_max == 0) return 0;
+
+  pce = cm_haccess(&g->g_plan_cache, graphd_plan_cache_entry, key, key_n);
+  if (pce != NULL)
+    cm_list_remove(graphd_plan_cache_entry, graphd_plan_cache_offsets,
+                   &g->g_plan_cache_head, &g->g_plan_cache_tail, pce);
+  else {
+    while (cm_hashnelems(&g->g_plan_cache) >= g->g_plan_cache_max &&
+           g->g_plan_cache_head != NULL)
+      plan_cache_delete(g, g->g_plan_cache_head);
+
+    pce = cm_hnew(&g->g_plan_cache, graphd_plan_cache_entry, key, key_n);
+    if (pce == NULL) return ENOMEM;
+
+    pce->pce_next = NULL;
+    pce->pce_prev = NULL;
+  }
+  pce->pce_plan = *plan;
+  pce->pce_hits = 0;
+
+  cm_list_enqueue(graphd_plan_cache_entry, graphd_plan_cache_offsets,
+                  &g->g_plan_cache_head, &g->g_plan_cache_tail, pce);
+  return 0;
+}
+
+/**
+ * @brief Forget a plan that no longer fits the data.
+ *
+ * @param g		graphd handle
+ * @param key		signature and shape of the "and"
+ * @param key_n		number of bytes pointed to by key
+ * @param unused	true if the caller just looked the plan up and
+ *			is running the contest instead; its lookup then
+ *			counts as a miss rather than a hit.
+ */
+void graphd_plan_cache_invalidate(graphd_handle *g, char const *key,
+                                  size_t key_n, bool unused) {
+  graphd_plan_cache_entry *pce;
+
+  pce = cm_haccess(&g->g_plan_cache, graphd_plan_cache_entry, key, key_n);
+  if (pce == NULL) return;
+
+  plan_cache_delete(g, pce);
+  g->g_plan_cache_invalidations++;
+
+  if (unused && g->g_plan_cache_hits > 0) {
+    g->g_plan_cache_hits--;
+    g->g_plan_cache_misses++;
+  }
+}
+
+/**
+ * @brief Has a subiterator count changed too much for a plan?
+ *
+ * @param then	the count when the plan was made
+ * @param now	the count now
+ *
+ * @return true if a plan made with <then> shouldn't be used with <now>.
+ */
+bool graphd_plan_cache_drifted(unsigned long long then,
+                               unsigned long long now) {
+  if (then == GRAPHD_PLAN_N_UNKNOWN) return false;
+  if (then > now) {
+    unsigned long long tmp = then;
+    then = now;
+    now = tmp;
+  }
+  return now > then * GRAPHD_PLAN_CACHE_DRIFT + GRAPHD_PLAN_CACHE_DRIFT_SLACK;
+}
+
+static void plan_cache_status_pair(graphd_value *val, char const *name,
+                                   unsigned long long n) {
+  graphd_value_text_set(val->val_list_contents, GRAPHD_VALUE_STRING, name,
+                        name + strlen(name), NULL);
+  graphd_value_number_set(val->val_list_contents + 1, n);
+}
+
+/*
+ *  plan: (("entries" n) ("max" n) ("hits" n) ("misses" n)
+ *	   ("invalidations" n) ("hit-rate" "percent"))
+ */
+int graphd_plan_cache_status(graphd_request *greq, graphd_value *val) {
+  cl_handle *cl = graphd_request_cl(greq);
+  cm_handle *cm = greq->greq_req.req_cm;
+  graphd_handle *g = graphd_request_graphd(greq);
+  unsigned long long total;
+  graphd_value *el;
+  char buf[42];
+  size_t i;
+  int err;
+
+  if ((err = graphd_value_list_alloc(g, cm, cl, val, 6)) != 0) return err;
+  for (i = 0; i < 6; i++) {
+    err = graphd_value_list_alloc(g, cm, cl, val->val_list_contents + i, 2);
+    if (err != 0) goto err;
+  }
+
+  el = val->val_list_contents;
+  plan_cache_status_pair(el++, "entries", cm_hashnelems(&g->g_plan_cache));
+  plan_cache_status_pair(el++, "max", g->g_plan_cache_max);
+  plan_cache_status_pair(el++, "hits", g->g_plan_cache_hits);
+  plan_cache_status_pair(el++, "misses", g->g_plan_cache_misses);
+  plan_cache_status_pair(el++, "invalidations", g->g_plan_cache_invalidations);
+
+  /*  Plans that were found, but then dropped for drift, have
+   *  already been moved from the hits to the misses.
+   */
+  total = g->g_plan_cache_hits + g->g_plan_cache_misses;
+  snprintf(buf, sizeof buf, "%.1f",
+           total ? (100.0 * g->g_plan_cache_hits) / total : 0.0);
+
+  plan_cache_status_pair(el, "hit-rate", 0);
+  err = graphd_value_text_strdup(cm, el->val_list_contents + 1,
+                                 GRAPHD_VALUE_STRING, buf, buf + strlen(buf));
+  if (err != 0) goto err;
+
+  return 0;
+
+err:
+  graphd_value_finish(cl, val);
+  return err;
+}
+
+/**
+ * @brief Parse the plan cache size from the configuration file.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ * @param s		in/out: current position in configuration file
+ * @param e		in: end of the buffered configuration file
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_plan_cache_config_read(void *data, srv_handle *srv,
+                                  void *config_data, srv_config *srv_cf,
+                                  char **s, char const *e) {
+  cl_handle *cl = srv_log(srv);
+  graphd_config *gcf = config_data;
+  unsigned long long n = 0;
+  int err;
+
+  err = srv_config_read_number(srv_cf, cl, "number of cached query plans", s,
+                               e, &n);
+  if (err != 0) return err;
+
+  if (n > (size_t)-1) {
+    cl_log(cl, CL_LEVEL_OPERATOR_ERROR,
+           "configuration file %s, line %d: plan-cache %llu "
+           "exceeds the largest internally representable size "
+           "value, %llu",
+           srv_config_file_name(srv_cf), srv_config_line_number(srv_cf, e), n,
+           (unsigned long long)(size_t)-1);
+    return ERANGE;
+  }
+
+  gcf->gcf_plan_cache = n;
+  gcf->gcf_plan_cache_valid = true;
+
+  return 0;
+}
+
+/**
+ * @brief Set an option as configured.  (Method.)
+ *
+ *  This is a method of the generic libsrv parameter mechanism,
+ *  passed in via a srv_config_parameter[] structure declared in graphd.c.
+ *
+ * @param data		opaque application data handle (i.e., graphd)
+ * @param srv 		generic libsrv handle
+ * @param config_data	opaque application config data (i.e., graphd_config)
+ * @param srv_cf	generic libsrv parameters
+ *
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_plan_cache_config_open(void *data, srv_handle *srv,
+                                  void *config_data, srv_config *srv_cf) {
+  graphd_handle *g = data;
+  graphd_config *gcf = config_data;
+
+  cl_assert(srv_log(srv), g != NULL);
+  cl_assert(srv_log(srv), config_data != NULL);
+
+  if (gcf->gcf_plan_cache_valid) g->g_plan_cache_max = gcf->gcf_plan_cache;
+  return 0;
+}
@@ -229,6 +229,38 @@ static int prop_cost_status(graphd_property const* prop, graphd_request* greq,
                                   cost + strlen(cost));
 }
 
+/* ----------------------------------------------------------------------
+   IDSET -- set type for the islink and isa caches                 graphd
+   ---------------------------------------------------------------------- */
+
+static int prop_idset_set(graphd_property const* prop, graphd_request* greq,
+                          graphd_set_subject const* su) {
+  graphd_handle* g = graphd_request_graphd(greq);
+
+  if (IS_LIT(su->set_value_s, su->set_value_e, "roaring"))
+    g->g_idset_roaring = true;
+  else if (IS_LIT(su->set_value_s, su->set_value_e, "tile"))
+    g->g_idset_roaring = false;
+  else {
+    graphd_request_errprintf(
+        greq, 0,
+        "SYNTAX \"idset\" can be set to \"roaring\" or \"tile\", "
+        "got \"%.*s\"",
+        (int)(su->set_value_e - su->set_value_s), su->set_value_s);
+    return GRAPHD_ERR_SYNTAX;
+  }
+  return 0;
+}
+
+static int prop_idset_status(graphd_property const* prop, graphd_request* greq,
+                             graphd_value* val) {
+  char const* s = graphd_request_graphd(greq)->g_idset_roaring ? "roaring"
+                                                               : "tile";
+
+  graphd_value_text_set(val, GRAPHD_VALUE_STRING, s, s + strlen(s), NULL);
+  return 0;
+}
+
 /* ----------------------------------------------------------------------
    LOGFLUSH -- flush policy for log files 		    	    libcl
    ---------------------------------------------------------------------- */
@@ -642,6 +674,7 @@ static graphd_property const graphd_properties[] = {
     {"core", prop_core_set, prop_core_status},
     {"cost", prop_cost_set, prop_cost_status},
     {"hostname", NULL, prop_hostname_status},
+    {"idset", prop_idset_set, prop_idset_status},
     {"instanceid", prop_instanceid_set, prop_instanceid_status},
     {"logflush", prop_logflush_set, prop_logflush_status},
     {"loglevel", prop_loglevel_set, prop_loglevel_status},
@@ -51,7 +51,9 @@ int graphd_read_set_cursor_get_value(graphd_read_set_context* grsc,
         prefix + n, sizeof(prefix) - n, "[n:%llu]",
         (grsc->grsc_con && grsc->grsc_con->con_high != PDB_ITERATOR_HIGH_ANY)
             ? grsc->grsc_con->con_high
-            : pdb_primitive_n(g->g_pdb));
+            : greq->greq_snapshot != PDB_ITERATOR_HIGH_ANY
+                  ? greq->greq_snapshot
+                  : pdb_primitive_n(g->g_pdb));
   }
 
   return grsc->grsc_sort
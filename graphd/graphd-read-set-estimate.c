@@ -111,3 +111,35 @@ int graphd_read_set_estimate_get(graphd_request* greq, pdb_iterator* it,
 
   return 0;
 }
+
+/**
+ * @brief Roughly what will it cost to read everything <it> returns?
+ *
+ *  The number of results times the cost of producing each one,
+ *  in iterator budget units.  That leaves out the cost of
+ *  subconstraints; it's meant for comparing requests, not for
+ *  predicting their runtime.
+ *
+ * @param greq		request we're working for
+ * @param it 		The constraint iterator the caller is asking about.
+ *
+ * @return the estimate, or -1 if the iterator doesn't know
+ *	how many results it has yet.
+ */
+pdb_budget graphd_read_set_estimate_cost(graphd_request* greq,
+                                         pdb_iterator* it) {
+  pdb_handle* pdb = graphd_request_pdb(greq);
+  unsigned long long n;
+  pdb_budget next_cost = PDB_COST_ITERATOR;
+
+  (void)pdb;
+  if (!pdb_iterator_n_valid(pdb, it)) return -1;
+  n = pdb_iterator_n(pdb, it);
+
+  if (pdb_iterator_next_cost_valid(pdb, it) &&
+      pdb_iterator_next_cost(pdb, it) > 0)
+    next_cost = pdb_iterator_next_cost(pdb, it);
+
+  if (n > 0 && (unsigned long long)next_cost > LLONG_MAX / n) return LLONG_MAX;
+  return (pdb_budget)n * next_cost;
+}
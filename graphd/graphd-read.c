@@ -588,11 +588,43 @@ int graphd_read(graphd_request* greq, unsigned long long deadline) {
 
   graphd_request_diary_log(greq, 0, "RUN");
 
-  /*  Nothing on the stack?
+  /*  Nothing on the stack?  Then we're just starting; pin the
+   *  snapshot we're reading.  Writes that happen while we're
+   *  suspended append above it and don't change what we see.
    */
-  if (graphd_stack_top(&greq->greq_stack) == NULL)
+  if (graphd_stack_top(&greq->greq_stack) == NULL) {
+    if (greq->greq_snapshot == PDB_ITERATOR_HIGH_ANY)
+      greq->greq_snapshot = pdb_primitive_n(graphd_request_pdb(greq));
     graphd_read_push(greq, greq->greq_constraint, &greq->greq_reply,
                      &greq->greq_reply_err);
+  }
+
+  /*  Before a read first runs, admission control may make it
+   *  wait its turn, or turn it away.
+   */
+  if (greq->greq_reply_err == 0 && !greq->greq_admitted &&
+      greq->greq_request == GRAPHD_REQUEST_READ) {
+    err = graphd_admission_check(greq, greq->greq_constraint->con_it);
+    if (err == GRAPHD_ERR_MORE) {
+      /*  Don't hold up writes that are waiting behind us.
+       */
+      if (graphd_request_xstate_break(greq) &&
+          (err = graphd_request_push_back(greq)) != 0) {
+        cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_request_push_back", err,
+                     "unexpected error");
+        greq->greq_reply_err = err;
+        graphd_request_errprintf(greq, 0, "SYSTEM %s", graphd_strerror(err));
+        err = 0;
+      }
+      cl_leave(cl, CL_LEVEL_SPEW, "%s", err ? "deferred" : "error");
+      return err;
+    } else if (err != 0) {
+      /*  Shed; the error message is already set.
+       */
+      greq->greq_reply_err = err;
+      err = 0;
+    }
+  }
 
   if (greq->greq_reply_err == 0)
     err = graphd_stack_run_until_deadline(greq, &greq->greq_stack, deadline);
@@ -638,12 +670,13 @@ int graphd_read(graphd_request* greq, unsigned long long deadline) {
  *
  */
 int graphd_read_suspend(graphd_request* greq) {
-  /*  If we don't have an "as-of" deadline, add one.
-   *  That way, the request's results are going to stay
-   *  as if it had run all the way through.
+  /*  If we don't have an "as-of" deadline, add one at our
+   *  snapshot.  That way, the request's results are going to
+   *  stay as if it had run all the way through.
    */
   if (greq->greq_asof == NULL)
-    greq->greq_asof = graphd_dateline(graphd_request_graphd(greq));
+    greq->greq_asof = graphd_dateline_snapshot(graphd_request_graphd(greq),
+                                               greq->greq_snapshot);
 
   return graphd_stack_suspend(&greq->greq_stack);
 }
@@ -431,5 +431,7 @@ int graphd_read_set_defer_results(graphd_read_set_context *_grsc,
 
 int graphd_read_set_estimate_get(graphd_request *_greq, pdb_iterator *_it,
                                  graphd_value *_val_out);
+pdb_budget graphd_read_set_estimate_cost(graphd_request *_greq,
+                                         pdb_iterator *_it);
 
 #endif /* GRAPHD_READ_H */
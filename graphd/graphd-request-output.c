@@ -1305,41 +1305,53 @@ static int graphd_format_error(graphd_handle *g, srv_handle *srv,
 typedef struct graphd_format_checkpoint {
   graphd_handle *check_g;
   pdb_id check_horizon;
+
+  /*  The group commit batch we're waiting with, if any.
+   */
+  unsigned long long check_batch;
 } graphd_format_checkpoint;
 
 /* This is a callback which is called immediately before writing
  * a response to a command which wrote primitives
  * We ensure that all primitives have been committed to disk.
  *
+ * If group commit is configured, a non-blocking call waits for the
+ * group commit window to close first, so that other writes arriving
+ * in the meantime can share the checkpoint.
+ *
  * @return SRV_ERR_MORE to say "we need more time to run."
  */
 static int graphd_format_sync_horizon(void *data, bool block, bool *any) {
   graphd_format_checkpoint *const cpd = data;
   graphd_handle *const g = cpd->check_g;
   pdb_id marker_id;
-  int err = 0;
+  int err;
 
   if (cpd->check_horizon > pdb_primitive_n(g->g_pdb))
     return 0; /* we've had an intervening restore */
 
-  cl_log(g->g_cl, CL_LEVEL_DEBUG, "Mandatory checkpoint to %llx",
-         (unsigned long long)cpd->check_horizon);
-
   marker_id = pdb_checkpoint_id_on_disk(g->g_pdb);
   if (cpd->check_horizon > marker_id) {
     pdb_id next_id = (pdb_id)pdb_primitive_n(g->g_pdb);
 
-    err = pdb_checkpoint_mandatory(g->g_pdb, block);
+    if (graphd_group_commit_wait(g, &cpd->check_batch) && !block)
+      return SRV_ERR_MORE;
+
+    cl_log(g->g_cl, CL_LEVEL_DEBUG, "Mandatory checkpoint to %llx",
+           (unsigned long long)cpd->check_horizon);
+
+    err = pdb_checkpoint_mandatory(g->g_pdb, true);
 
     /*
      * Start replicating these primitives as soon as they hit disk
      */
-    if (err == 0 || err == PDB_ERR_ALREADY)
+    if (err == 0 || err == PDB_ERR_ALREADY) {
+      graphd_group_commit_done(g);
       graphd_replicate_primitives(g, marker_id, next_id);
-    if (err && err != PDB_ERR_ALREADY && err != GRAPHD_ERR_MORE) return err;
-    if (err == GRAPHD_ERR_MORE) err = SRV_ERR_MORE;
+    }
+    if (err && err != PDB_ERR_ALREADY) return err;
   }
-  return err;
+  return 0;
 }
 
 /**
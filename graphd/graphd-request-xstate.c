@@ -63,6 +63,13 @@ int graphd_request_xstate_get_ticket(graphd_request* greq) {
         break;
     }
 
+  /*  If we're a parked SMP follower, we have to ask
+   *  the leader before this can run.
+   */
+  if (err == 0 && greq->greq_xstate_ticket != NULL &&
+      !graphd_xstate_ticket_is_running(g, greq->greq_xstate_ticket))
+    graphd_smp_wake(g);
+
   return err;
 }
 
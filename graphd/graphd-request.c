@@ -138,6 +138,9 @@ int graphd_request_initialize(void *data, srv_handle *srv, void *session_data,
 
   greq->greq_end = PDB_ID_NONE;
   greq->greq_start = PDB_ID_NONE;
+  greq->greq_snapshot = PDB_ITERATOR_HIGH_ANY;
+  greq->greq_admitted = false;
+  greq->greq_admission_deferred = false;
   greq->greq_loglevel_valid = false;
   greq->greq_dateline_wanted = false;
 
@@ -679,6 +682,7 @@ void graphd_request_finish_running(graphd_request *greq) {
   /*  Mark us as done running.
    */
   srv_request_run_done(&greq->greq_req);
+  graphd_admission_done(greq);
 
   /*  If the request wants a dateline, give it one.
    */
@@ -690,7 +694,9 @@ void graphd_request_finish_running(graphd_request *greq) {
       graph_dateline_destroy(greq->greq_dateline);
       greq->greq_dateline = NULL;
     }
-    greq->greq_dateline = graphd_dateline(graphd_request_graphd(greq));
+    greq->greq_dateline =
+        graphd_dateline_snapshot(graphd_request_graphd(greq),
+                                 greq->greq_snapshot);
     if (greq->greq_dateline == NULL) {
       greq->greq_dateline_wanted = false;
       graphd_request_error(greq,
@@ -979,6 +985,7 @@ void graphd_request_arrived(graphd_request *greq) {
          graphd_request_to_string(greq, buf, sizeof buf));
 
   greq->greq_xstate = graphd_request_xstate_type(greq);
+  graphd_admission_arrived(greq);
   if (!(greq->greq_req.req_done & (1 << SRV_OUTPUT)))
     graphd_request_start(greq);
 
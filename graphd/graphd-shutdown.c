@@ -51,8 +51,12 @@ void graphd_shutdown(void* data, srv_handle* srv) {
    */
   graphd_idle_finish(g);
 
-  /* Free the is-a/linksto cache
+  /* Save, then free the is-a/linksto cache.  (Bulk loads
+   * haven't indexed what they wrote yet.)
    */
+  if (g->g_pdb != NULL && !g->g_bulk_load &&
+      graphd_should_write_on_shutdown(g))
+    (void)graphd_islink_save(g);
   graphd_islink_finish(g);
 
   /* Make sure database details are written out to disk. */
@@ -74,6 +78,14 @@ void graphd_shutdown(void* data, srv_handle* srv) {
       result = err;
     }
 
+    /* If we were bulk loading, index what we loaded.
+     */
+    err = pdb_bulk_finish(g->g_pdb);
+    if (err != 0 && result == 0) {
+      result_func = "pdb_bulk_finish";
+      result = err;
+    }
+
     /* We do checkpoint optional twice, once to finish up an
      * in-progress checkpoint and the second time to get ourselves
      * caught up from wherever the in-progress checkpoint left off.
@@ -116,6 +128,14 @@ void graphd_shutdown(void* data, srv_handle* srv) {
    */
   graphd_iterator_resource_finish(g);
 
+  /* Unmap the SMP horizon page.
+   */
+  graphd_smp_horizon_finish(g);
+
+  /* Free the plan cache.
+   */
+  graphd_plan_cache_finish(g);
+
   /* Free the interface ID.
    */
   if (g->g_interface_id != NULL) {
@@ -0,0 +1,354 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "graphd/graphd.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file graphd-smp-horizon.c
+ * @brief The horizon page shared between SMP leader and followers.
+ *
+ *  graphd maps one small anonymous page before it forks its SMP
+ *  processes.  After each write, the leader publishes its primitive
+ *  count there, before it tells the followers to refresh.  Each
+ *  follower records, in its own slot, the horizon it last refreshed
+ *  to and when.
+ *
+ *  A follower that is told to refresh but already is at the published
+ *  horizon skips pdb_refresh() and the marker file reads that come
+ *  with it.  That's the common case for followers that are woken up
+ *  without anything having been written in between.  (When there is
+ *  something new, pdb_refresh() already only stretches the last
+ *  partitions and maps new ones.)
+ *
+ *  Because the page is visible to every process, "status (smp)"
+ *  reports each follower's lag without asking the leader.
+ */
+
+/*  Remember this many publications, to tell how long ago a
+ *  follower's horizon was overtaken.
+ */
+#define GRAPHD_SMP_HORIZON_HISTORY 64
+
+typedef struct graphd_smp_horizon_slot {
+  pid_t gshs_pid;
+
+  /*  Primitive count the process last refreshed to, and when,
+   *  in microseconds on the monotonic clock.
+   */
+  unsigned long long gshs_horizon;
+  unsigned long long gshs_refreshed;
+
+  unsigned long long gshs_refreshes;
+  unsigned long long gshs_skipped;
+
+} graphd_smp_horizon_slot;
+
+struct graphd_smp_horizon {
+  size_t gsh_map_size;
+  size_t gsh_slot_n;
+
+  /*  The leader's primitive count as of its last completed write.
+   */
+  unsigned long long gsh_horizon;
+
+  /*  Number of times the horizon moved; the last
+   *  GRAPHD_SMP_HORIZON_HISTORY of them are in gsh_history.
+   */
+  unsigned long long gsh_published;
+  struct {
+    unsigned long long gshh_horizon;
+    unsigned long long gshh_when;
+  } gsh_history[GRAPHD_SMP_HORIZON_HISTORY];
+
+  graphd_smp_horizon_slot gsh_slot[1];
+};
+
+static unsigned long long horizon_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*  How long ago was the horizon first published past <horizon>?
+ */
+static unsigned long long horizon_lag_micros(graphd_smp_horizon const *gsh,
+                                             unsigned long long horizon,
+                                             unsigned long long now) {
+  unsigned long long published, i, oldest;
+
+  published = __atomic_load_n(&gsh->gsh_published, __ATOMIC_ACQUIRE);
+  if (published == 0) return 0;
+
+  oldest = published > GRAPHD_SMP_HORIZON_HISTORY
+               ? published - GRAPHD_SMP_HORIZON_HISTORY
+               : 0;
+  for (i = oldest; i < published; i++)
+    if (gsh->gsh_history[i % GRAPHD_SMP_HORIZON_HISTORY].gshh_horizon >
+        horizon)
+      break;
+  if (i == published) return 0;
+
+  /*  If even the oldest publication we remember is past
+   *  <horizon>, the lag is at least that old.
+   */
+  return now - gsh->gsh_history[i % GRAPHD_SMP_HORIZON_HISTORY].gshh_when;
+}
+
+/**
+ * @brief Map the horizon page.
+ *
+ *  Called once at startup, before the SMP processes are forked,
+ *  and only if there are any.
+ *
+ * @param g	graphd handle
+ * @return 0 on success, a nonzero errno on error.
+ */
+int graphd_smp_horizon_initialize(graphd_handle *g) {
+  graphd_smp_horizon *gsh;
+  size_t size;
+  int err;
+
+  g->g_smp_horizon = NULL;
+  g->g_smp_horizon_index = 0;
+
+  size = sizeof(*gsh) + (g->g_smp_processes - 1) * sizeof(gsh->gsh_slot[0]);
+  gsh = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+             -1, 0);
+  if (gsh == MAP_FAILED) {
+    err = errno ? errno : ENOMEM;
+    cl_log_errno(g->g_cl, CL_LEVEL_ERROR, "mmap", err,
+                 "can't map %zu bytes for the SMP horizon page", size);
+    return err;
+  }
+
+  /*  The mapping starts out zeroed.
+   */
+  gsh->gsh_map_size = size;
+  gsh->gsh_slot_n = g->g_smp_processes;
+  gsh->gsh_horizon = pdb_primitive_n(g->g_pdb);
+
+  g->g_smp_horizon = gsh;
+  return 0;
+}
+
+/**
+ * @brief Unmap this process's view of the horizon page.
+ * @param g	graphd handle
+ */
+void graphd_smp_horizon_finish(graphd_handle *g) {
+  graphd_smp_horizon *gsh = g->g_smp_horizon;
+
+  if (gsh == NULL) return;
+
+  (void)munmap(gsh, gsh->gsh_map_size);
+  g->g_smp_horizon = NULL;
+}
+
+/**
+ * @brief Take over a slot in the horizon page.
+ *
+ *  Called in each SMP process as it starts; a follower that is
+ *  restarted takes over the slot of the one it replaces.
+ *
+ * @param g	graphd handle
+ * @param index	SMP process index; 0 is the leader.
+ */
+void graphd_smp_horizon_attach(graphd_handle *g, size_t index) {
+  graphd_smp_horizon *gsh = g->g_smp_horizon;
+  graphd_smp_horizon_slot *gshs;
+
+  if (gsh == NULL || index >= gsh->gsh_slot_n) return;
+
+  g->g_smp_horizon_index = index;
+  gshs = gsh->gsh_slot + index;
+
+  gshs->gshs_refreshes = 0;
+  gshs->gshs_skipped = 0;
+  gshs->gshs_refreshed = horizon_now();
+  __atomic_store_n(&gshs->gshs_horizon, pdb_primitive_n(g->g_pdb),
+                   __ATOMIC_RELEASE);
+  gshs->gshs_pid = getpid();
+
+  if (index == 0) graphd_smp_horizon_publish(g);
+}
+
+/**
+ * @brief Leader: the database is consistent; publish its horizon.
+ *
+ *  Called before the followers are told to refresh.
+ *
+ * @param g	graphd handle
+ */
+void graphd_smp_horizon_publish(graphd_handle *g) {
+  graphd_smp_horizon *gsh = g->g_smp_horizon;
+  unsigned long long horizon, now;
+  size_t i;
+
+  if (gsh == NULL) return;
+
+  horizon = pdb_primitive_n(g->g_pdb);
+  now = horizon_now();
+
+  gsh->gsh_slot[0].gshs_horizon = horizon;
+  gsh->gsh_slot[0].gshs_refreshed = now;
+
+  if (horizon == gsh->gsh_horizon && gsh->gsh_published > 0) return;
+
+  i = gsh->gsh_published % GRAPHD_SMP_HORIZON_HISTORY;
+  gsh->gsh_history[i].gshh_horizon = horizon;
+  gsh->gsh_history[i].gshh_when = now;
+
+  __atomic_store_n(&gsh->gsh_horizon, horizon, __ATOMIC_RELEASE);
+  __atomic_store_n(&gsh->gsh_published, gsh->gsh_published + 1,
+                   __ATOMIC_RELEASE);
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG, "graphd_smp_horizon_publish: %llu",
+         horizon);
+}
+
+/**
+ * @brief Follower: is there nothing new to refresh to?
+ *
+ * @param g	graphd handle
+ * @return true if our primitive count is the leader's published one.
+ */
+bool graphd_smp_horizon_current(graphd_handle *g) {
+  graphd_smp_horizon const *gsh = g->g_smp_horizon;
+
+  return gsh != NULL && __atomic_load_n(&gsh->gsh_horizon, __ATOMIC_ACQUIRE) ==
+                            pdb_primitive_n(g->g_pdb);
+}
+
+/**
+ * @brief Follower: record the horizon we've refreshed to.
+ *
+ * @param g		graphd handle
+ * @param skipped	true if graphd_smp_horizon_current() let us
+ *			skip the refresh.
+ */
+void graphd_smp_horizon_refreshed(graphd_handle *g, bool skipped) {
+  graphd_smp_horizon *gsh = g->g_smp_horizon;
+  graphd_smp_horizon_slot *gshs;
+
+  if (gsh == NULL) return;
+
+  gshs = gsh->gsh_slot + g->g_smp_horizon_index;
+  if (skipped)
+    gshs->gshs_skipped++;
+  else
+    gshs->gshs_refreshes++;
+
+  gshs->gshs_refreshed = horizon_now();
+  __atomic_store_n(&gshs->gshs_horizon, pdb_primitive_n(g->g_pdb),
+                   __ATOMIC_RELEASE);
+}
+
+static int horizon_status_follower(graphd_handle *g, cm_handle *cm,
+                                   cl_handle *cl, graphd_value *val,
+                                   graphd_smp_horizon const *gsh, size_t index,
+                                   unsigned long long now) {
+  static char const name[] = "follower";
+  graphd_smp_horizon_slot const *gshs = gsh->gsh_slot + index;
+  unsigned long long horizon, published;
+  graphd_value *el;
+  int err;
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 8);
+  if (err != 0) return err;
+
+  el = val->val_list_contents;
+  err = graphd_value_text_strdup(cm, el++, GRAPHD_VALUE_STRING, name,
+                                 name + sizeof(name) - 1);
+  if (err != 0) return err;
+
+  horizon = __atomic_load_n(&gshs->gshs_horizon, __ATOMIC_ACQUIRE);
+  published = __atomic_load_n(&gsh->gsh_horizon, __ATOMIC_ACQUIRE);
+
+  graphd_value_number_set(el++, index);
+  graphd_value_number_set(el++, gshs->gshs_pid);
+  graphd_value_number_set(el++, horizon);
+  graphd_value_number_set(el++, published > horizon ? published - horizon : 0);
+  graphd_value_number_set(el++, horizon_lag_micros(gsh, horizon, now));
+  graphd_value_number_set(el++, gshs->gshs_refreshes);
+  graphd_value_number_set(el++, gshs->gshs_skipped);
+
+  return 0;
+}
+
+/*
+ *  smp: (("horizon" n) ("published" n)
+ *	  ("follower" index pid horizon lag-primitives lag-micros
+ *			refreshes skipped) ...)
+ */
+int graphd_smp_horizon_status(graphd_request *greq, graphd_value *val) {
+  static char const horizon_name[] = "horizon";
+  static char const published_name[] = "published";
+  cl_handle *cl = graphd_request_cl(greq);
+  cm_handle *cm = greq->greq_req.req_cm;
+  graphd_handle *g = graphd_request_graphd(greq);
+  graphd_smp_horizon const *gsh = g->g_smp_horizon;
+  unsigned long long now = horizon_now();
+  size_t i, n = 0;
+  graphd_value *el;
+  int err;
+
+  if (gsh != NULL)
+    for (i = 1; i < gsh->gsh_slot_n; i++)
+      if (gsh->gsh_slot[i].gshs_pid != 0) n++;
+
+  err = graphd_value_list_alloc(g, cm, cl, val, 2 + n);
+  if (err != 0) return err;
+
+  el = val->val_list_contents;
+  if ((err = graphd_value_list_alloc(g, cm, cl, el, 2)) != 0 ||
+      (err = graphd_value_text_strdup(
+           cm, el->val_list_contents, GRAPHD_VALUE_STRING, horizon_name,
+           horizon_name + sizeof(horizon_name) - 1)) != 0)
+    goto err;
+  graphd_value_number_set(el->val_list_contents + 1,
+                          gsh != NULL ? __atomic_load_n(&gsh->gsh_horizon,
+                                                        __ATOMIC_ACQUIRE)
+                                      : pdb_primitive_n(g->g_pdb));
+  el++;
+
+  if ((err = graphd_value_list_alloc(g, cm, cl, el, 2)) != 0 ||
+      (err = graphd_value_text_strdup(
+           cm, el->val_list_contents, GRAPHD_VALUE_STRING, published_name,
+           published_name + sizeof(published_name) - 1)) != 0)
+    goto err;
+  graphd_value_number_set(el->val_list_contents + 1,
+                          gsh != NULL ? gsh->gsh_published : 0);
+  el++;
+
+  /*  A follower that started since we counted has to wait
+   *  for the next status.
+   */
+  if (gsh != NULL)
+    for (i = 1; i < gsh->gsh_slot_n && el < val->val_list_contents + 2 + n;
+         i++) {
+      if (gsh->gsh_slot[i].gshs_pid == 0) continue;
+      err = horizon_status_follower(g, cm, cl, el++, gsh, i, now);
+      if (err != 0) goto err;
+    }
+  return 0;
+
+err:
+  graphd_value_finish(cl, val);
+  return err;
+}
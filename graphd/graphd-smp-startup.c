@@ -112,6 +112,7 @@ int graphd_smp_startup(void *data, srv_handle *srv, size_t index) {
 
     g->g_smp_follower_timeout = srv_timeout_create(srv, 5);
     g->g_smp_request = NULL;
+    graphd_smp_horizon_attach(g, index);
 
     /* Close the open interfaces -- leaders do not accept
        connections from the outside world.
@@ -144,6 +145,7 @@ int graphd_smp_startup(void *data, srv_handle *srv, size_t index) {
         return err;
       }
     }
+    graphd_smp_horizon_attach(g, index);
 
     err = graphd_smp_connect(g);
     if (err) return err;
@@ -50,6 +50,17 @@ static size_t smp_get_follower_status(graphd_handle* g) {
   return count;
 }
 
+/*  A parked follower counts as paused.
+ */
+static bool smp_follower_in_state(graphd_session const* gses,
+                                  graphd_session_smp_state state) {
+  graphd_session_smp_state const have =
+      gses->gses_data.gd_smp_follower.gdsf_smp_state;
+
+  return have == state || (state == GRAPHD_SMP_SESSION_PAUSE &&
+                           have == GRAPHD_SMP_SESSION_PARKED);
+}
+
 static size_t smp_get_count_followers_in_state(
     graphd_handle* g, graphd_session_smp_state const state) {
   size_t count = 0;
@@ -57,7 +68,7 @@ static size_t smp_get_count_followers_in_state(
 
   for (gses = g->g_smp_sessions; gses != NULL;
        gses = gses->gses_data.gd_smp_follower.gdsf_next) {
-    if (state == gses->gses_data.gd_smp_follower.gdsf_smp_state) count += 1;
+    if (smp_follower_in_state(gses, state)) count += 1;
   }
   return count;
 }
@@ -67,8 +78,7 @@ static void smp_set_timeout_on_unpaused_followers(graphd_handle* g,
   graphd_session* gses;
   for (gses = g->g_smp_sessions; gses != NULL;
        gses = gses->gses_data.gd_smp_follower.gdsf_next) {
-    if (gses->gses_data.gd_smp_follower.gdsf_smp_state !=
-        GRAPHD_SMP_SESSION_PAUSE) {
+    if (!smp_follower_in_state(gses, GRAPHD_SMP_SESSION_PAUSE)) {
       cl_log(g->g_cl, CL_LEVEL_DEBUG, "Setting follower timeout on %s",
              gses->gses_ses.ses_displayname);
       srv_session_set_timeout(&gses->gses_ses, timeout);
@@ -82,7 +92,7 @@ int graphd_smp_test_follower_state(graphd_handle* g,
   graphd_session* gses;
   for (gses = g->g_smp_sessions; gses != NULL;
        gses = gses->gses_data.gd_smp_follower.gdsf_next) {
-    if (gses->gses_data.gd_smp_follower.gdsf_smp_state != state) {
+    if (!smp_follower_in_state(gses, state)) {
       return false;
     }
   }
@@ -385,15 +395,27 @@ int graphd_smp_broadcast(graphd_handle* g, graphd_smp_command cmd) {
 
   cl_assert(g->g_cl, cmd == GRAPHD_SMP_PREWRITE || cmd == GRAPHD_SMP_POSTWRITE);
 
+  /*  Let the followers see what they'll be refreshing to.
+   */
+  if (cmd == GRAPHD_SMP_POSTWRITE) graphd_smp_horizon_publish(g);
+
   for (gses = g->g_smp_sessions; gses != NULL;
        gses = gses->gses_data.gd_smp_follower.gdsf_next) {
     graphd_request* greq;
 
+    /*  Parked followers don't read, so they don't need to
+     *  pause; they pick up what we wrote once they ask to run.
+     */
+    if (gses->gses_data.gd_smp_follower.gdsf_smp_state ==
+        GRAPHD_SMP_SESSION_PARKED) {
+      if (cmd == GRAPHD_SMP_PREWRITE ||
+          !gses->gses_data.gd_smp_follower.gdsf_smp_wake)
+        continue;
+      gses->gses_data.gd_smp_follower.gdsf_smp_wake = false;
+    }
     if (cmd == GRAPHD_SMP_POSTWRITE) {
       gses->gses_data.gd_smp_follower.gdsf_smp_state = GRAPHD_SMP_SESSION_RUN;
     }
-    if (cmd == GRAPHD_SMP_PREWRITE) {
-    }
 
     greq = graphd_smp_out_request(g, gses, cmd);
     if (!greq) return ENOMEM;
@@ -409,23 +431,46 @@ static int graphd_smp_in_postwrite(graphd_request* greq) {
   pdb_handle* pdb = g->g_pdb;
   pdb_id start, end;
 
-  graphd_dateline_expire(g);
-
   start = pdb_primitive_n(pdb);
 
-  cl_log(cl, CL_LEVEL_VERBOSE, "running pdb_refresh!");
+  /*  If we're already at the horizon the leader published,
+   *  there's nothing to refresh.
+   */
+  if (graphd_smp_horizon_current(g)) {
+    cl_log(cl, CL_LEVEL_VERBOSE, "graphd_smp_in_postwrite: current at %llu",
+           (unsigned long long)start);
+    graphd_smp_horizon_refreshed(g, true);
+  } else {
+    graphd_dateline_expire(g);
 
-  if ((err = pdb_refresh(pdb))) {
-    /* XXX */
-    cl_notreached(cl,
-                  "graphd_smp_in_postwrite: error %s while trying"
-                  " to refresh database. Giving up.",
-                  graphd_strerror(err));
-  }
+    cl_log(cl, CL_LEVEL_VERBOSE, "running pdb_refresh!");
+
+    if ((err = pdb_refresh(pdb))) {
+      /* XXX */
+      cl_notreached(cl,
+                    "graphd_smp_in_postwrite: error %s while trying"
+                    " to refresh database. Giving up.",
+                    graphd_strerror(err));
+    }
+
+    end = pdb_primitive_n(pdb);
+    graphd_smp_horizon_refreshed(g, false);
 
-  end = pdb_primitive_n(pdb);
+    graphd_replicate_primitives(g, start, end);
+  }
 
-  graphd_replicate_primitives(g, start, end);
+  /*  If nobody is waiting to read, keep holding the ticket
+   *  and stay paused on this snapshot.  The leader then won't
+   *  ask us before its next write; we'll ask it, via the
+   *  "smp (paused)" it sends us, once someone wants to run.
+   */
+  if (g->g_smp_xstate_ticket != NULL &&
+      !graphd_xstate_any_waiting_behind(g->g_smp_xstate_ticket)) {
+    cl_log(cl, CL_LEVEL_VERBOSE, "graphd_smp_in_postwrite: parking");
+    graphd_request_output_text(greq, NULL, "ok (paused)\n");
+    srv_request_output_ready(&greq->greq_req);
+    return 0;
+  }
 
   graphd_xstate_ticket_delete(g, &g->g_smp_xstate_ticket);
 
@@ -438,13 +483,69 @@ static int graphd_smp_in_postwrite(graphd_request* greq) {
   return 0;
 }
 
+/*  I am a parked follower, and the leader is asking me to tell
+ *  it when I want to run again.  Answer once somebody is waiting
+ *  behind my ticket; the leader then sends a post-write, and I
+ *  refresh and let them run.
+ */
+static int graphd_smp_in_park(graphd_request* greq) {
+  graphd_handle* g = graphd_request_graphd(greq);
+
+  if (g->g_smp_xstate_ticket != NULL &&
+      !graphd_xstate_any_waiting_behind(g->g_smp_xstate_ticket)) {
+    srv_request_suspend(&greq->greq_req);
+    return GRAPHD_ERR_SUSPEND;
+  }
+
+  graphd_request_output_text(greq, NULL, "ok (running)\n");
+  srv_request_output_ready(&greq->greq_req);
+
+  return 0;
+}
+
+/**
+ * @brief Someone is waiting for the SMP ticket; unpark.
+ *
+ *  Called on a follower whenever a request has to wait for its
+ *  ticket.  If we're parked, answer the leader's "smp (paused)".
+ *
+ * @param g	graphd handle
+ */
+void graphd_smp_wake(graphd_handle* g) {
+  srv_request* req;
+
+  if (g->g_smp_proc_type != GRAPHD_SMP_PROCESS_FOLLOWER ||
+      g->g_smp_leader == NULL || g->g_smp_xstate_ticket == NULL)
+    return;
+
+  for (req = g->g_smp_leader->gses_ses.ses_request_head; req != NULL;
+       req = req->req_next) {
+    graphd_request* greq = (graphd_request*)req;
+
+    if (greq->greq_request == GRAPHD_REQUEST_SMP &&
+        greq->greq_data.gd_smp.gds_smpcmd == GRAPHD_SMP_PAUSED &&
+        !(req->req_done & (1 << SRV_RUN)) &&
+        !(req->req_ready & (1 << SRV_RUN))) {
+      cl_log(g->g_cl, CL_LEVEL_VERBOSE, "graphd_smp_wake: unparking");
+      srv_request_run_ready(req);
+      break;
+    }
+  }
+}
+
 /*  I am the leader.  greq is an incoming request from one of my followers.
  */
 static int graphd_smp_in_paused(graphd_request* greq) {
   graphd_session* gses = graphd_request_session(greq);
   graphd_handle* g = graphd_request_graphd(greq);
 
-  gses->gses_data.gd_smp_follower.gdsf_smp_state = GRAPHD_SMP_SESSION_PAUSE;
+  /*  A follower that parked before it saw our pre-write
+   *  stays parked; it still owes us an answer to the
+   *  "smp (paused)" we sent it.
+   */
+  if (gses->gses_data.gd_smp_follower.gdsf_smp_state !=
+      GRAPHD_SMP_SESSION_PARKED)
+    gses->gses_data.gd_smp_follower.gdsf_smp_state = GRAPHD_SMP_SESSION_PAUSE;
 
   cl_log(g->g_cl, CL_LEVEL_DEBUG, "Removing follower timeout on %s",
          gses->gses_ses.ses_displayname);
@@ -455,6 +556,59 @@ static int graphd_smp_in_paused(graphd_request* greq) {
   return 0;
 }
 
+/*  I am the leader.  A follower answered our post-write with
+ *  "ok (paused)": it has nothing to read and stays on its old
+ *  snapshot.  Ask it to tell us when that changes.
+ */
+static void graphd_smp_in_parked(graphd_request* greq) {
+  graphd_session* gses = graphd_request_session(greq);
+  graphd_handle* g = graphd_request_graphd(greq);
+
+  gses->gses_data.gd_smp_follower.gdsf_smp_state = GRAPHD_SMP_SESSION_PARKED;
+  gses->gses_data.gd_smp_follower.gdsf_smp_wake = false;
+
+  if (graphd_smp_out_request(g, gses, GRAPHD_SMP_PAUSED) == NULL) {
+    /*  Without a way to wake up, it mustn't stay parked.
+     */
+    gses->gses_data.gd_smp_follower.gdsf_smp_state = GRAPHD_SMP_SESSION_RUN;
+    (void)graphd_smp_out_request(g, gses, GRAPHD_SMP_POSTWRITE);
+    return;
+  }
+  cl_log(g->g_cl, CL_LEVEL_DEBUG, "%s parked", gses->gses_ses.ses_displayname);
+
+  /*  If a write was waiting for this follower, it may go ahead now.
+   */
+  if (g->g_smp_state == GRAPHD_SMP_SESSION_SENT_PAUSE)
+    graphd_smp_leader_state_machine(g, GRAPHD_SMP_SESSION_PAUSE);
+}
+
+/*  I am the leader.  A parked follower has something to read.
+ *  Unless we're in the middle of a write, let it refresh and run;
+ *  otherwise, that happens once the write is done.
+ */
+static void graphd_smp_in_unpark(graphd_request* greq) {
+  graphd_session* gses = graphd_request_session(greq);
+  graphd_handle* g = graphd_request_graphd(greq);
+
+  if (gses->gses_data.gd_smp_follower.gdsf_smp_state !=
+      GRAPHD_SMP_SESSION_PARKED)
+    return;
+
+  cl_log(g->g_cl, CL_LEVEL_DEBUG, "%s unparks%s",
+         gses->gses_ses.ses_displayname,
+         g->g_smp_state == GRAPHD_SMP_SESSION_RUN ? "" : " after this write");
+
+  if (g->g_smp_state != GRAPHD_SMP_SESSION_RUN) {
+    gses->gses_data.gd_smp_follower.gdsf_smp_wake = true;
+    return;
+  }
+  gses->gses_data.gd_smp_follower.gdsf_smp_state = GRAPHD_SMP_SESSION_RUN;
+  if (graphd_smp_out_request(g, gses, GRAPHD_SMP_POSTWRITE) == NULL)
+    cl_notreached(g->g_cl,
+                  "Could not create post-write to unpark a follower. "
+                  "This failure is critical.");
+}
+
 static int graphd_smp_in_prewrite(graphd_request* greq) {
   graphd_handle* g = graphd_request_graphd(greq);
 
@@ -547,6 +701,10 @@ static int graphd_smp_in_run(graphd_request* greq,
       err = graphd_smp_in_postwrite(greq);
       break;
 
+    case GRAPHD_SMP_PAUSED:
+      err = graphd_smp_in_park(greq);
+      break;
+
     case GRAPHD_SMP_STATUS:
       if (g->g_smp_proc_type == GRAPHD_SMP_PROCESS_LEADER) {
         graphd_request_output_text(
@@ -571,7 +729,7 @@ static int graphd_smp_in_run(graphd_request* greq,
       err = graphd_smp_in_connect(greq);
       break;
     default:
-      /*  PAUSED and CONNECT are handled upon input.
+      /*  RUNNING is handled upon input.
        */
       cl_notreached(cl, "unexpected SMP (in) run for %d",
                     (int)greq->greq_data.gd_smp.gds_smpcmd);
@@ -594,9 +752,11 @@ static void graphd_smp_in_input_arrived(graphd_request* greq) {
       break;
 
     case GRAPHD_SMP_PAUSED:
-      cl_notreached(cl, "Paused command is depricated");
-      (void)graphd_smp_in_paused(greq);
-      srv_request_complete(&greq->greq_req);
+      /*  The leader wants to know when we'd like to
+       *  stop being parked.
+       */
+      srv_request_input_done(&greq->greq_req);
+      srv_request_run_ready(&greq->greq_req);
       break;
 
     case GRAPHD_SMP_STATUS:
@@ -630,12 +790,18 @@ int graphd_smp_initialize(graphd_request* greq) {
 static void graphd_smp_out_input_arrived(graphd_request* greq) {
   cl_handle* cl = graphd_request_cl(greq);
 
-  switch (greq->greq_data.gd_smp.gds_smpcmd) {
+  switch (greq->greq_data.gd_smp_out.gdso_smpcmd) {
     case GRAPHD_SMP_PREWRITE:
       (void)graphd_smp_in_paused(greq);
       srv_request_complete(&greq->greq_req);
       break;
     case GRAPHD_SMP_POSTWRITE:
+      if (greq->greq_data.gd_smp_out.gdso_reply == GRAPHD_SMP_PAUSED)
+        graphd_smp_in_parked(greq);
+      srv_request_complete(&greq->greq_req);
+      break;
+    case GRAPHD_SMP_PAUSED:
+      graphd_smp_in_unpark(greq);
       srv_request_complete(&greq->greq_req);
       break;
     case GRAPHD_SMP_CONNECT:
@@ -674,6 +840,7 @@ graphd_request* graphd_smp_out_request(graphd_handle* g, graphd_session* gses,
   greq->greq_type = &graphd_smp_out_request_type;
   greq->greq_xstate = GRAPHD_XSTATE_NONE;
   greq->greq_data.gd_smp_out.gdso_smpcmd = smpcmd;
+  greq->greq_data.gd_smp_out.gdso_reply = GRAPHD_SMP_UNSPECIFIED;
 
   switch (smpcmd) {
     case GRAPHD_SMP_PREWRITE:
@@ -686,6 +853,11 @@ graphd_request* graphd_smp_out_request(graphd_handle* g, graphd_session* gses,
       cl_assert(cl, err == 0);
       break;
 
+    case GRAPHD_SMP_PAUSED:
+      err = graphd_request_output_text(greq, NULL, "smp (paused)\n");
+      cl_assert(cl, err == 0);
+      break;
+
     case GRAPHD_SMP_CONNECT:
       /* This command is asynchronus. After we send it, we become a
        * normal, receiving, server session
@@ -728,7 +900,16 @@ int graphd_smp_pause_for_write(graphd_request* greq) {
   if (g->g_smp_proc_type == GRAPHD_SMP_PROCESS_LEADER) {
     switch (g->g_smp_state) {
       case GRAPHD_SMP_SESSION_RUN:
-        if (g->g_smp_sessions) {
+        if (g->g_smp_sessions &&
+            graphd_smp_test_follower_state(g, GRAPHD_SMP_SESSION_PAUSE)) {
+          /*  Everybody's parked; nobody is reading what
+           *  we're about to change.
+           */
+          cl_assert(cl, g->g_smp_request == NULL);
+          g->g_smp_request = greq;
+          g->g_smp_state = GRAPHD_SMP_SESSION_PAUSE;
+          g->g_smp_cycles++;
+        } else if (g->g_smp_sessions) {
           graphd_suspend_for_smp(greq);
           state_changed = graphd_smp_leader_state_machine(
               graphd_request_graphd(greq), GRAPHD_SMP_SESSION_SENT_PAUSE);
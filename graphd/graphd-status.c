@@ -876,6 +876,50 @@ int graphd_status(graphd_request* greq) {
                        "unexpected error");
         break;
 
+      case GRAPHD_STATUS_PLAN:
+        cl_cover(cl);
+        err =
+            graphd_plan_cache_status(gsc.gsc_greq, val->val_list_contents + n);
+        if (err != 0)
+          cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_plan_cache_status", err,
+                       "unexpected error");
+        break;
+
+      case GRAPHD_STATUS_COMMIT:
+        cl_cover(cl);
+        err = graphd_group_commit_status(gsc.gsc_greq,
+                                         val->val_list_contents + n);
+        if (err != 0)
+          cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_group_commit_status", err,
+                       "unexpected error");
+        break;
+
+      case GRAPHD_STATUS_SMP:
+        cl_cover(cl);
+        err = graphd_smp_horizon_status(gsc.gsc_greq,
+                                        val->val_list_contents + n);
+        if (err != 0)
+          cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_smp_horizon_status", err,
+                       "unexpected error");
+        break;
+
+      case GRAPHD_STATUS_ADMISSION:
+        cl_cover(cl);
+        err = graphd_admission_status(gsc.gsc_greq, val->val_list_contents + n);
+        if (err != 0)
+          cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_admission_status", err,
+                       "unexpected error");
+        break;
+
+      case GRAPHD_STATUS_RESOURCE:
+        cl_cover(cl);
+        err = graphd_iterator_resource_status(gsc.gsc_greq,
+                                              val->val_list_contents + n);
+        if (err != 0)
+          cl_log_errno(cl, CL_LEVEL_FAIL, "graphd_iterator_resource_status",
+                       err, "unexpected error");
+        break;
+
       default:
         cl_notreached(cl, "unexpected status subject %d", su->stat_subject);
     }
@@ -58,6 +58,14 @@ static int graphd_force_option_set(void* data, srv_handle* srv, cm_handle* cm,
   return 0;
 }
 
+static int graphd_bulk_load_option_set(void* data, srv_handle* srv,
+                                       cm_handle* cm, int opt,
+                                       char const* opt_arg) {
+  graphd_handle* g = data;
+  g->g_bulk_load = true;
+  return 0;
+}
+
 static int graphd_database_exists_option_set(void* data, srv_handle* srv,
                                              cm_handle* cm, int opt,
                                              char const* opt_arg) {
@@ -163,6 +171,8 @@ static const srv_option graphd_srv_options[] = {
      graphd_noverify_option_set, NULL},
     {"b", "  -b               (Boring) make server predictable\n",
      graphd_predictable_option_set, graphd_predictable_option_configure},
+    {"B", "  -B               bulk load; index restored records in bulk\n",
+     graphd_bulk_load_option_set, NULL},
     {"C", "  -C               (continue) force graphd to start\n",
      graphd_force_option_set, NULL},
     {"D", "  -D               graphd fails without a database dir\n",
@@ -218,6 +228,16 @@ static const srv_config_parameter graphd_srv_configs[] = {
     {"leader-socket", graphd_smp_leader_config_read,
      graphd_smp_leader_config_open},
     {"cost", graphd_cost_config_read, graphd_cost_config_open},
+    {"iterator-resource-max", graphd_iterator_resource_config_read,
+     graphd_iterator_resource_config_open},
+    {"iterator-resource-share", graphd_iterator_resource_share_config_read,
+     graphd_iterator_resource_share_config_open},
+    {"plan-cache", graphd_plan_cache_config_read,
+     graphd_plan_cache_config_open},
+    {"group-commit", graphd_group_commit_config_read,
+     graphd_group_commit_config_open},
+    {"admission-slo", graphd_admission_config_read,
+     graphd_admission_config_open},
     {"instance-id", graphd_instance_id_config_read,
      graphd_instance_id_config_open},
     {NULL} /* sentinel */
@@ -359,6 +379,9 @@ static int graphd_startup(void* data, srv_handle* srv) {
      * writes) */
     g->g_smp_processes += 1;
     srv_set_smp_processes(srv, g->g_smp_processes);
+
+    err = graphd_smp_horizon_initialize(g);
+    if (err != 0) return err;
   }
 
   g->g_diary = cl_diary_create(cl);
@@ -383,6 +406,21 @@ static int graphd_startup(void* data, srv_handle* srv) {
 
   graphd_runtime_statistics_max(&g->g_runtime_statistics_allowance);
 
+  /*  A bulk load accepts nothing but restores until
+   *  someone sets a different access mode.
+   */
+  if (g->g_bulk_load) {
+    if (g->g_access != GRAPHD_ACCESS_READ_WRITE) {
+      cl_log(cl, CL_LEVEL_OPERATOR_ERROR,
+             "graphd: -B (bulk load) can't be combined with "
+             "access mode \"%s\"",
+             graphd_access_global_to_string(g->g_access));
+      srv_shared_set_restart(g->g_srv, false);
+      return GRAPHD_ERR_SEMANTICS;
+    }
+    g->g_access = GRAPHD_ACCESS_RESTORE;
+  }
+
   err = graphd_access_set_global(g, g->g_access, &err_retriable, err_buf,
                                  sizeof err_buf);
   if (err) {
@@ -404,12 +442,24 @@ static int graphd_startup(void* data, srv_handle* srv) {
                  "can't initialize iterator resource hashtable");
     return err;
   }
+  err = graphd_plan_cache_initialize(g);
+  if (err != 0) {
+    cl_log_errno(cl, CL_LEVEL_ERROR, "graphd_plan_cache_initialize", err,
+                 "can't initialize plan cache hashtable");
+    return err;
+  }
   err = graphd_islink_initialize(g);
   if (err != 0) {
     cl_log_errno(cl, CL_LEVEL_ERROR, "graphd_islink_initialize", err,
                  "can't initialize is-a/linksto cache");
     return err;
   }
+  err = graphd_islink_load(g);
+  if (err != 0) {
+    cl_log_errno(cl, CL_LEVEL_ERROR, "graphd_islink_load", err,
+                 "can't load is-a/linksto cache");
+    return err;
+  }
 
   graphd_idle_initialize(g);
 
@@ -466,6 +516,8 @@ int main(int argc, char** argv) {
   g->g_verify = true;
   g->g_force = false;
   g->g_database_must_exist = false;
+  g->g_plan_cache_max = GRAPHD_PLAN_CACHE_MAX;
+  g->g_idset_roaring = true;
 
   return srv_main(argc, argv, g, &graphd_srv_application);
 }
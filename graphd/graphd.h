@@ -103,6 +103,29 @@ typedef struct graphd_startup_todo_item graphd_startup_todo_item;
  */
 #define GRAPHD_ITERATOR_RESOURCE_MAX (1024ull * 1024 * 20)
 
+/*  The default number of "and" plans in the plan cache.
+ */
+#define GRAPHD_PLAN_CACHE_MAX 1024
+
+/*  "and" iterators with more subiterators than this aren't cached.
+ */
+#define GRAPHD_PLAN_SUB_MAX 16
+
+/*  Subiterator count recorded as unknown in a plan.
+ */
+#define GRAPHD_PLAN_N_UNKNOWN ((unsigned long long)-1)
+
+/*  Group commit batch sizes are counted in this many buckets:
+ *  1, 2-3, 4-7, ..., and everything from 2^(n-1) up.
+ */
+#define GRAPHD_GROUP_COMMIT_BUCKETS 8
+
+/*  Admission control shares out work in windows of this many
+ *  milliseconds; usage from earlier windows counts half as much
+ *  per window gone by.
+ */
+#define GRAPHD_ADMISSION_WINDOW_MILLIS 1000
+
 typedef unsigned int graphd_iterator_hint;
 
 #define GRAPHD_ITERATOR_HINT_OR 0x0001
@@ -262,6 +285,14 @@ typedef struct graphd_storable_type {
   bool (*st_equal)(void const *, void const *);
   unsigned long (*st_hash)(void const *);
 
+  /*  Optional; if present, the storable can be copied into the
+   *  shared iterator resource segment and read back by another
+   *  process.  st_export appends a flat copy of the data to a
+   *  buffer; st_import returns a fresh storable made from one.
+   */
+  int (*st_export)(void const *, cm_buffer *);
+  void *(*st_import)(graphd_handle *, char const *, size_t);
+
 } graphd_storable_type;
 
 typedef struct graphd_storable {
@@ -274,6 +305,11 @@ typedef struct graphd_storable {
   unsigned int gs_stored : 1;
   size_t gs_size;
 
+  /*  Budget spent computing this data.  Together with gs_size,
+   *  determines how long the resource cache keeps it around.
+   */
+  pdb_budget gs_cost;
+
 } graphd_storable;
 
 #define GRAPHD_STORABLE(s) ((graphd_storable *)(s))
@@ -299,6 +335,10 @@ typedef struct graphd_storable {
     graphd_storable_size(gs) += (s);                                          \
   } while (0)
 
+#define graphd_storable_cost(gs) (GRAPHD_STORABLE(gs)->gs_cost)
+#define graphd_storable_cost_add(gs, c) \
+  ((void)(GRAPHD_STORABLE(gs)->gs_cost += (c)))
+
 #define graphd_storable_equal(A, B)                        \
   ((GRAPHD_STORABLE_TYPE(A) == GRAPHD_STORABLE_TYPE(B)) && \
    (*GRAPHD_STORABLE_TYPE(A)->st_equal)((void const *)(A), (void const *)(B)))
@@ -1577,7 +1617,13 @@ typedef enum {
   GRAPHD_SMP_SESSION_RUN,
   GRAPHD_SMP_SESSION_SENT_PAUSE,
   GRAPHD_SMP_SESSION_PAUSE,
-  GRAPHD_SMP_SESSION_SENT_RUN
+  GRAPHD_SMP_SESSION_SENT_RUN,
+
+  /*  The follower has nothing to read, and stays paused
+   *  on its current snapshot until it does.  Writes don't
+   *  wait for it.
+   */
+  GRAPHD_SMP_SESSION_PARKED
 } graphd_session_smp_state;
 
 /**
@@ -1595,7 +1641,12 @@ typedef struct graphd_status_subject {
     GRAPHD_STATUS_PROPERTY = 6,
     GRAPHD_STATUS_TILES = 7,
     GRAPHD_STATUS_REPLICA = 8,
-    GRAPHD_STATUS_ISLINK = 9
+    GRAPHD_STATUS_ISLINK = 9,
+    GRAPHD_STATUS_PLAN = 10,
+    GRAPHD_STATUS_COMMIT = 11,
+    GRAPHD_STATUS_SMP = 12,
+    GRAPHD_STATUS_ADMISSION = 13,
+    GRAPHD_STATUS_RESOURCE = 14
   } stat_subject;
   unsigned long long stat_number;
   graphd_property const *stat_property;
@@ -2026,6 +2077,13 @@ struct graphd_request {
    */
   unsigned long long greq_horizon;
 
+  /*  The snapshot a read runs against: the number of primitives
+   *  in the database when it started.  Primitives written while
+   *  the read is suspended are at or above this and stay invisible
+   *  to it.  PDB_ITERATOR_HIGH_ANY until the read starts.
+   */
+  pdb_id greq_snapshot;
+
   /*  Per-request loglevel, and is it valid?
    */
   cl_loglevel_configuration greq_loglevel;
@@ -2095,6 +2153,15 @@ struct graphd_request {
    */
   unsigned int greq_pushed_back : 1;
 
+  /*  Admission control (graphd-admission.c): when the request
+   *  arrived, whether it has been let run, and, if it has been
+   *  deferred, since when.
+   */
+  srv_msclock_t greq_admission_arrived;
+  srv_msclock_t greq_admission_deferred_since;
+  unsigned int greq_admitted : 1;
+  unsigned int greq_admission_deferred : 1;
+
   /* When we time out, return a cursor rather than an error.
    */
   unsigned int greq_soft_timeout : 1;
@@ -2195,6 +2262,10 @@ struct graphd_request {
       graphd_smp_command gdso_smpcmd;
       unsigned long long gdso_smppid;
 
+      /*  The state the follower replied with, if any.
+       */
+      graphd_smp_command gdso_reply;
+
     } gd_smp_out;
 
     struct {
@@ -2262,6 +2333,32 @@ typedef struct graphd_tokenizer {
 struct graphd_iterator_resource;
 struct graphd_sabotage_handle;
 
+typedef struct graphd_iterator_resource_share graphd_iterator_resource_share;
+typedef struct graphd_smp_horizon graphd_smp_horizon;
+
+/*  What an "and" iterator's statistics contest decided, remembered
+ *  in the plan cache under the constraint's signature.
+ */
+typedef struct graphd_plan {
+  /*  Index of the winning producer among the subiterators.
+   */
+  size_t plan_producer;
+
+  /*  Estimated result count and per-result cost of the "and".
+   */
+  unsigned long long plan_n;
+  pdb_budget plan_next_cost;
+
+  /*  The subiterators' own counts at the time; if they drift
+   *  too far from these, the plan is thrown out.
+   */
+  size_t plan_sub_n;
+  unsigned long long plan_sub_count[GRAPHD_PLAN_SUB_MAX];
+
+} graphd_plan;
+
+typedef struct graphd_plan_cache_entry graphd_plan_cache_entry;
+
 typedef void graphd_iterator_resource_free(void *, void const *, size_t);
 typedef struct graphd_iterator_resource {
   /*  NULL for non-storables, otherwise a
@@ -2275,6 +2372,17 @@ typedef struct graphd_iterator_resource {
 
   unsigned int gir_used : 1;
 
+  /*  Eviction priority (greedy-dual-size-frequency): the
+   *  cache clock at the last use, plus cost per byte.  Lowest
+   *  goes first.
+   */
+  double gir_priority;
+
+  /*  Size of the storable when we last copied it into the
+   *  shared segment, or 0.
+   */
+  size_t gir_shared_size;
+
   struct graphd_iterator_resource *gir_next, *gir_prev;
 
   /* Points to the entry in the resource stamp hashtable.
@@ -2510,6 +2618,16 @@ struct graphd_handle {
    */
   bool g_database_must_exist;
 
+  /*  Bulk load (command line option -B): start in "restore"
+   *  access mode, and index what's restored only when leaving it.
+   */
+  bool g_bulk_load;
+
+  /*  Should the islink and isa caches use roaring idsets
+   *  (rather than tile idsets)?  Set with the "idset" property.
+   */
+  bool g_idset_roaring;
+
   /* Specifies the max memory parameter used when sizing a new database
    * on disk. The default is 0, which will then use sysinfo, sysctl, etc
    * to determine.
@@ -2540,6 +2658,62 @@ struct graphd_handle {
   unsigned long long g_iterator_resource_max;
   graphd_iterator_resource *g_iterator_resource_head, *g_iterator_resource_tail;
 
+  /*  GDSF "inflation" clock: the priority of the last resource
+   *  evicted.
+   */
+  double g_iterator_resource_clock;
+
+  /*  Thaws that found their resource, thaws that didn't, and
+   *  resources flushed to make room; for "status (resource)".
+   */
+  unsigned long long g_iterator_resource_hit;
+  unsigned long long g_iterator_resource_miss;
+  unsigned long long g_iterator_resource_evicted;
+
+  /*  Optional segment shared between SMP leader and followers;
+   *  managed by graphd-iterator-resource-share.c.
+   */
+  graphd_iterator_resource_share *g_iterator_resource_share;
+  unsigned long long g_iterator_resource_share_size;
+
+  /*  "and" plans keyed by constraint signature, least recently
+   *  used first; managed by graphd-plan-cache.c.
+   */
+  cm_hashtable g_plan_cache;
+  graphd_plan_cache_entry *g_plan_cache_head, *g_plan_cache_tail;
+  size_t g_plan_cache_max;
+  unsigned long long g_plan_cache_hits;
+  unsigned long long g_plan_cache_misses;
+  unsigned long long g_plan_cache_invalidations;
+
+  /*  Group commit: write acknowledgements that need a checkpoint
+   *  within g_group_commit_window milliseconds of each other share
+   *  one; managed by graphd-group-commit.c.
+   */
+  unsigned long g_group_commit_window;
+  pdb_msclock_t g_group_commit_start;
+  unsigned long long g_group_commit_batch;
+  size_t g_group_commit_waiting;
+  unsigned long long g_group_commit_requests;
+  unsigned long long g_group_commit_largest;
+  unsigned long long g_group_commit_sizes[GRAPHD_GROUP_COMMIT_BUCKETS];
+
+  /*  Admission control: once requests wait longer than
+   *  g_admission_slo milliseconds to run, expensive reads are
+   *  deferred or shed; managed by graphd-admission.c.
+   */
+  unsigned long g_admission_slo;
+  unsigned long long g_admission_delay;
+  srv_msclock_t g_admission_delay_updated;
+  unsigned long long g_admission_mean_cost;
+  unsigned long long g_admission_usage;
+  unsigned long long g_admission_window;
+  size_t g_admission_sessions;
+  size_t g_admission_sessions_previous;
+  unsigned long long g_admission_admitted;
+  unsigned long long g_admission_deferred;
+  unsigned long long g_admission_shed;
+
   graphd_sabotage_handle *g_sabotage;
 
   /* Freeze-factor.  If non-0, freeze at every <g_freeze>th chance.
@@ -2563,6 +2737,13 @@ struct graphd_handle {
    */
   graphd_xstate_ticket *g_smp_xstate_ticket;
 
+  /*  Page shared between SMP leader and followers, with the
+   *  leader's published horizon and each follower's; managed by
+   *  graphd-smp-horizon.c.  g_smp_horizon_index is our slot in it.
+   */
+  graphd_smp_horizon *g_smp_horizon;
+  size_t g_smp_horizon_index;
+
   /*  A map for a concentric graph.
    */
   graph_grmap *g_concentric;
@@ -2595,6 +2776,12 @@ typedef struct graphd_config {
   graphd_database_config *gcf_database_cf;
   graphd_replica_config *gcf_replica_cf;
   unsigned long long gcf_request_size_max;
+  unsigned long long gcf_iterator_resource_max;
+  unsigned long long gcf_iterator_resource_share;
+  unsigned long long gcf_plan_cache;
+  unsigned int gcf_plan_cache_valid : 1;
+  unsigned long gcf_group_commit;
+  unsigned long gcf_admission_slo;
   unsigned long long gcf_smp_processes;
   char const *gcf_smp_leader;
   graphd_runtime_statistics gcf_runtime_statistics_allowance;
@@ -2683,6 +2870,14 @@ struct graphd_session {
   graphd_request *gses_request_wait_head;
   graphd_request *gses_request_wait_tail;
 
+  /*  Admission control: when the session's last request
+   *  finished running, and its share of recent reads.
+   */
+  srv_msclock_t gses_admission_done;
+  unsigned long long gses_admission_usage;
+  unsigned long long gses_admission_window;
+  unsigned long long gses_admission_active;
+
   unsigned int gses_loglevel_valid : 1;
   unsigned int gses_skipping : 1;
 
@@ -2708,6 +2903,10 @@ struct graphd_session {
       graphd_session_smp_state gdsf_smp_state;
       pid_t gdsf_smp_pid;
 
+      /*  A parked follower has asked to run again.
+       */
+      bool gdsf_smp_wake;
+
       /* linked list of SMP followers
        */
       graphd_session *gdsf_next;
@@ -2760,6 +2959,18 @@ bool graphd_access_allow_global(graphd_handle *_g, graphd_request *_greq);
 graphd_access_global graphd_access_global_from_string(const char *s,
                                                       const char *e);
 
+/* graphd-admission.c */
+
+void graphd_admission_arrived(graphd_request *_greq);
+void graphd_admission_done(graphd_request *_greq);
+int graphd_admission_check(graphd_request *_greq, pdb_iterator *_it);
+int graphd_admission_status(graphd_request *_greq, graphd_value *_val);
+int graphd_admission_config_read(void *_data, srv_handle *_srv,
+                                 void *_config_data, srv_config *_srv_cf,
+                                 char **_s, char const *_e);
+int graphd_admission_config_open(void *_data, srv_handle *_srv,
+                                 void *_config_data, srv_config *_srv_cf);
+
 /* graphd-assignment.c */
 
 int graphd_assignment_infer(graphd_request *greq, graphd_constraint *con);
@@ -3126,6 +3337,7 @@ void graphd_dateline_constraint_hash(cl_handle *_cl,
                                      unsigned long *_hash_inout);
 
 graph_dateline *graphd_dateline(graphd_handle *);
+graph_dateline *graphd_dateline_snapshot(graphd_handle *_g, pdb_id _n);
 void graphd_dateline_expire(graphd_handle *);
 
 pdb_id graphd_dateline_low(graphd_handle const *_g,
@@ -3138,6 +3350,17 @@ pdb_id graphd_dateline_high(graphd_handle const *_g,
 
 void graphd_dump_initialize(graphd_request *greq);
 
+/* graphd-group-commit.c */
+
+bool graphd_group_commit_wait(graphd_handle *_g, unsigned long long *_batch);
+void graphd_group_commit_done(graphd_handle *_g);
+int graphd_group_commit_status(graphd_request *_greq, graphd_value *_val);
+int graphd_group_commit_config_read(void *_data, srv_handle *_srv,
+                                    void *_config_data, srv_config *_srv_cf,
+                                    char **_s, char const *_e);
+int graphd_group_commit_config_open(void *_data, srv_handle *_srv,
+                                    void *_config_data, srv_config *_srv_cf);
+
 /* graphd-guid-constraint.c */
 
 bool graphd_guid_constraint_single_linkage(graphd_constraint const *_con,
@@ -3244,6 +3467,8 @@ int graphd_islink(graphd_request *_greq, unsigned long long _deadline);
 int graphd_islink_initialize(graphd_handle *);
 void graphd_islink_finish(graphd_handle *);
 int graphd_islink_truncate(graphd_handle *);
+int graphd_islink_save(graphd_handle *);
+int graphd_islink_load(graphd_handle *);
 int graphd_islink_idle(graphd_handle *);
 int graphd_islink_donate(graphd_handle *, pdb_budget *);
 int graphd_islink_add_type_guid(graphd_handle *, graph_guid const *);
@@ -3429,6 +3654,7 @@ int graphd_iterator_fixed_intersect(cl_handle *_cl, pdb_id *_a_base,
                                     size_t _id_m);
 
 int graphd_iterator_fixed_set_masquerade(pdb_iterator *_it, char const *_mas);
+void graphd_iterator_fixed_cost_add(pdb_iterator *_it, pdb_budget _cost);
 int graphd_iterator_fixed_set_offset(pdb_handle *pdb, pdb_iterator *it,
                                      unsigned long long off);
 
@@ -3451,6 +3677,9 @@ void graphd_iterator_and_set_context_pagesize(graphd_handle *_g,
                                               pdb_iterator *_it,
                                               unsigned long long _size);
 
+int graphd_iterator_and_set_plan_key(graphd_handle *_g, pdb_iterator *_it,
+                                     char const *_key, size_t _key_n);
+
 void graphd_iterator_and_set_context_setsize(graphd_handle *_g,
                                              pdb_iterator *_it,
                                              unsigned long long _size);
@@ -3549,6 +3778,7 @@ void graphd_iterator_idset_recover(graphd_handle *graphd, pdb_iterator *it,
                                                            graph_idset **,
                                                            pdb_budget *),
                                    void *recover_callback_data);
+graph_idset *graphd_idset_create(graphd_handle *g);
 
 /* graphd-iterator-isa.c */
 
@@ -3681,6 +3911,37 @@ void graphd_iterator_resource_finish(graphd_handle *g);
 void *graphd_iterator_resource_thaw(graphd_handle *g, char const **s_ptr,
                                     char const *e,
                                     graphd_storable_type const *expected_type);
+int graphd_iterator_resource_status(graphd_request *_greq, graphd_value *_val);
+int graphd_iterator_resource_config_read(void *_data, srv_handle *_srv,
+                                         void *_config_data,
+                                         srv_config *_srv_cf, char **_s,
+                                         char const *_e);
+int graphd_iterator_resource_config_open(void *_data, srv_handle *_srv,
+                                         void *_config_data,
+                                         srv_config *_srv_cf);
+
+/* graphd-iterator-resource-share.c */
+
+int graphd_iterator_resource_share_initialize(graphd_handle *_g);
+void graphd_iterator_resource_share_finish(graphd_handle *_g);
+void graphd_iterator_resource_share_publish(graphd_handle *_g,
+                                            graphd_storable const *_gs,
+                                            char const *_stamp_s,
+                                            char const *_stamp_e);
+graphd_storable *graphd_iterator_resource_share_lookup(
+    graphd_handle *_g, char const *_stamp_s, char const *_stamp_e,
+    graphd_storable_type const *_expected_type);
+void graphd_iterator_resource_share_counts(graphd_handle *_g, size_t *_used,
+                                           unsigned long long *_hit,
+                                           unsigned long long *_miss);
+
+int graphd_iterator_resource_share_config_read(void *_data, srv_handle *_srv,
+                                               void *_config_data,
+                                               srv_config *_srv_cf, char **_s,
+                                               char const *_e);
+int graphd_iterator_resource_share_config_open(void *_data, srv_handle *_srv,
+                                               void *_config_data,
+                                               srv_config *_srv_cf);
 
 /* graphd-iterator-sort.c */
 
@@ -3911,6 +4172,25 @@ int graphd_pattern_frame_create(graphd_request *_greq, graphd_constraint *_con);
 char const *graphd_pattern_frame_to_string(graphd_pattern_frame const *_pf,
                                            char *_buf, size_t _size);
 
+/* graphd-plan-cache.c */
+
+int graphd_plan_cache_initialize(graphd_handle *_g);
+void graphd_plan_cache_finish(graphd_handle *_g);
+bool graphd_plan_cache_lookup(graphd_handle *_g, char const *_key,
+                              size_t _key_n, graphd_plan *_plan_out);
+int graphd_plan_cache_store(graphd_handle *_g, char const *_key, size_t _key_n,
+                            graphd_plan const *_plan);
+void graphd_plan_cache_invalidate(graphd_handle *_g, char const *_key,
+                                  size_t _key_n, bool _unused);
+bool graphd_plan_cache_drifted(unsigned long long _then,
+                               unsigned long long _now);
+int graphd_plan_cache_status(graphd_request *_greq, graphd_value *_val);
+int graphd_plan_cache_config_read(void *_data, srv_handle *_srv,
+                                  void *_config_data, srv_config *_srv_cf,
+                                  char **_s, char const *_e);
+int graphd_plan_cache_config_open(void *_data, srv_handle *_srv,
+                                  void *_config_data, srv_config *_srv_cf);
+
 /* graphd-predictable.c */
 
 int graphd_predictable_option_set(void *_data, srv_handle *_srv, cm_handle *_cm,
@@ -4315,6 +4595,18 @@ int graphd_smp_pause_for_write(graphd_request *greq);
 
 int graphd_smp_resume_for_write(graphd_request *greq);
 
+void graphd_smp_wake(graphd_handle *g);
+
+/* graphd-smp-horizon.c */
+
+int graphd_smp_horizon_initialize(graphd_handle *_g);
+void graphd_smp_horizon_finish(graphd_handle *_g);
+void graphd_smp_horizon_attach(graphd_handle *_g, size_t _index);
+void graphd_smp_horizon_publish(graphd_handle *_g);
+bool graphd_smp_horizon_current(graphd_handle *_g);
+void graphd_smp_horizon_refreshed(graphd_handle *_g, bool _skipped);
+int graphd_smp_horizon_status(graphd_request *_greq, graphd_value *_val);
+
 /* graphd-smp-startup.c */
 
 int graphd_smp_manage(graphd_handle *g);
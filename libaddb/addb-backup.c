@@ -68,6 +68,16 @@ limitations under the License.
  *
  *  addb_backup_publish
  *	Remove the backup file.  It is no longer necessary.
+ *
+ *  Redo Logs
+ *
+ *  If the database runs with a redo log (addb_set_redo_log()),
+ *  the same functions write the new contents of pages rather than
+ *  the old ones.  The file is then a series of segments, one per
+ *  checkpoint, each with its own header.  While a log is published,
+ *  the segment of the next checkpoint is appended to it in place
+ *  rather than written to a *.clx file; the tiled module removes
+ *  the log once the pages it holds have been synced into the file.
  */
 
 /** the backup file header
@@ -111,6 +121,27 @@ typedef struct addb_bkr {
 
 #define ADDB_BKR_DATA(B__) ((char*)((B__) + 1))
 
+/** @brief a redo log segment header
+ *
+ *	Backup records of the segment (rdh_size bytes) follow.
+ */
+
+typedef struct addb_rdh {
+  addb_u4 rdh_magic;   /* redo magic */
+  addb_u5 rdh_horizon; /* horizon the segment's checkpoint started from */
+  addb_u8 rdh_size;    /* bytes of records following the header */
+} addb_rdh;
+
+#define ADDB_RDH_HORIZON(R__) ADDB_GET_U5((R__)->rdh_horizon)
+#define ADDB_RDH_HORIZON_SET(R__, V__) ADDB_PUT_U5((R__)->rdh_horizon, (V__))
+
+#define ADDB_RDH_SIZE(R__) ADDB_GET_U8((R__)->rdh_size)
+#define ADDB_RDH_SIZE_SET(R__, V__) ADDB_PUT_U8((R__)->rdh_size, (V__))
+
+/*  Are we appending a segment to the published redo log?
+ */
+#define ADDB_TBKF_APPENDING(TBK__, F__) ((F__)->path == (TBK__)->tbk_v_path)
+
 /**
  * @brief Initialize backup information for a tiled file
  */
@@ -159,6 +190,19 @@ int addb_backup_init(addb_handle* addb, addb_tbk* tbk, char const* a0_path,
  */
 
 void addb_backup_punt(addb_tbk* tbk) {
+  if (ADDB_TBKF_APPENDING(tbk, &tbk->tbk_a)) {
+    /*  Cut the segment off the published log; the rest
+     *  of the log is still good.
+     */
+    if (-1 != tbk->tbk_a.fd) {
+      (void)ftruncate(tbk->tbk_a.fd, tbk->tbk_a.start);
+      (void)close(tbk->tbk_a.fd);
+    }
+    tbk->tbk_a.fd = -1;
+    tbk->tbk_a.path = (char*)0;
+    return;
+  }
+
   if (-1 != tbk->tbk_a.fd) (void)close(tbk->tbk_a.fd);
 
   if (tbk->tbk_a.path != NULL) (void)unlink(tbk->tbk_a.path);
@@ -184,12 +228,44 @@ void addb_backup_punt(addb_tbk* tbk) {
 static int addb_backup_open(addb_handle* addb, addb_tbk* tbk) {
   cl_handle* const cl = addb->addb_cl;
   addb_bkh bkh;
+  addb_rdh rdh;
+  void* header;
+  size_t header_size;
   int err = 0;
   ssize_t bytes;
 
   cl_assert(cl, -1 == tbk->tbk_a.fd);
   cl_assert(cl, !tbk->tbk_a.path);
 
+  tbk->tbk_a.start = 0;
+
+  if (addb->addb_redo_log && tbk->tbk_published) {
+    off_t off;
+
+    /*  Append a segment to the published redo log.
+     */
+    tbk->tbk_a.path = tbk->tbk_v_path;
+    tbk->tbk_a.fd = open(tbk->tbk_a.path, O_RDWR);
+    if (-1 == tbk->tbk_a.fd) {
+      err = errno;
+      cl_log_errno(cl, CL_LEVEL_ERROR, "open", err,
+                   "cannot open redo log for appending: %s", tbk->tbk_a.path);
+      tbk->tbk_a.path = (char*)0;
+      return err;
+    }
+    if ((off = lseek(tbk->tbk_a.fd, 0, SEEK_END)) < 0) {
+      err = errno;
+      cl_log_errno(cl, CL_LEVEL_ERROR, "lseek", err,
+                   "cannot seek to the end of redo log %s", tbk->tbk_a.path);
+      (void)close(tbk->tbk_a.fd);
+      tbk->tbk_a.fd = -1;
+      tbk->tbk_a.path = (char*)0;
+      return err;
+    }
+    tbk->tbk_a.start = off;
+    goto have_file;
+  }
+
   tbk->tbk_a.path = tbk->tbk_a_path[0];
   tbk->tbk_a.fd = open(tbk->tbk_a.path, O_CREAT | O_RDWR | O_EXCL, 0666);
 
@@ -215,23 +291,34 @@ static int addb_backup_open(addb_handle* addb, addb_tbk* tbk) {
     (void)addb_file_advise_log(cl, tbk->tbk_a.fd, tbk->tbk_a.path);
   }
 
+have_file:
   cl_log(addb->addb_cl, CL_LEVEL_SPEW, "addb_backup_open: \"%s\" fd=%d",
          tbk->tbk_a.path, tbk->tbk_a.fd);
 
-  memcpy(bkh.bkh_magic, ADDB_BACKUP_MAGIC, sizeof bkh.bkh_magic);
-  ADDB_BKH_HORIZON_SET(&bkh, ADDB_U5_MAX);
+  if (addb->addb_redo_log) {
+    memcpy(rdh.rdh_magic, ADDB_REDO_MAGIC, sizeof rdh.rdh_magic);
+    ADDB_RDH_HORIZON_SET(&rdh, ADDB_U5_MAX);
+    ADDB_RDH_SIZE_SET(&rdh, 0);
+    header = &rdh;
+    header_size = sizeof rdh;
+  } else {
+    memcpy(bkh.bkh_magic, ADDB_BACKUP_MAGIC, sizeof bkh.bkh_magic);
+    ADDB_BKH_HORIZON_SET(&bkh, ADDB_U5_MAX);
+    header = &bkh;
+    header_size = sizeof bkh;
+  }
   errno = 0;
-  bytes = write(tbk->tbk_a.fd, &bkh, sizeof bkh);
+  bytes = write(tbk->tbk_a.fd, header, header_size);
   if (bytes < 0) {
     err = errno;
     cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "write", err,
-                 "cannot write %zu byte header to \"%s\"", sizeof bkh,
+                 "cannot write %zu byte header to \"%s\"", header_size,
                  tbk->tbk_a.path);
-  } else if (bytes != sizeof bkh) {
+  } else if (bytes != header_size) {
     cl_log(addb->addb_cl, CL_LEVEL_ERROR,
            "cannot write %zu byte header to \"%s\" "
            "(only wrote %ld bytes)",
-           sizeof bkh, tbk->tbk_a.path, (long)bytes);
+           header_size, tbk->tbk_a.path, (long)bytes);
     err = errno ? errno : ENOSPC;
   }
 
@@ -331,6 +418,37 @@ int addb_backup_finish(addb_handle* addb, addb_tbk* tbk,
   cl_assert(addb->addb_cl, -1 != tbk->tbk_a.fd);
   cl_assert(addb->addb_cl, -1 == tbk->tbk_w.fd);
 
+  if (addb->addb_redo_log) {
+    addb_rdh rdh;
+    off_t end;
+
+    /*  Fill in the horizon and size of the segment.  The
+     *  two are adjacent in the header.
+     */
+    if ((end = lseek(tbk->tbk_a.fd, 0, SEEK_END)) < 0) {
+      err = errno;
+      cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "lseek", err,
+                   "cannot seek to the end of \"%s\"", tbk->tbk_a.path);
+      addb_backup_punt(tbk);
+      return err;
+    }
+    ADDB_RDH_HORIZON_SET(&rdh, horizon);
+    ADDB_RDH_SIZE_SET(&rdh, end - tbk->tbk_a.start - sizeof rdh);
+
+    err = addb_file_lseek(addb, tbk->tbk_a.fd, tbk->tbk_a.path,
+                          tbk->tbk_a.start + offsetof(addb_rdh, rdh_horizon),
+                          SEEK_SET);
+    if (!err)
+      err = addb_file_write(addb, tbk->tbk_a.fd, tbk->tbk_a.path,
+                            (char*)rdh.rdh_horizon,
+                            sizeof rdh.rdh_horizon + sizeof rdh.rdh_size);
+    if (err) {
+      addb_backup_punt(tbk);
+      return err;
+    }
+    goto finished;
+  }
+
   ADDB_BKH_HORIZON_SET(&bkh, horizon);
 
   err = addb_file_lseek(addb, tbk->tbk_a.fd, tbk->tbk_a.path,
@@ -347,11 +465,11 @@ int addb_backup_finish(addb_handle* addb, addb_tbk* tbk,
     return err;
   }
 
+finished:
   cl_log(addb->addb_cl, CL_LEVEL_SPEW, "addb_backup_finish: \"%s\"",
          tbk->tbk_a.path);
 
-  tbk->tbk_w.fd = tbk->tbk_a.fd;
-  tbk->tbk_w.path = tbk->tbk_a.path;
+  tbk->tbk_w = tbk->tbk_a;
   tbk->tbk_a.fd = -1;
   tbk->tbk_a.path = (char*)0;
 
@@ -373,10 +491,13 @@ int addb_backup_publish(addb_handle* addb, addb_tbk* tbk) {
 
   /*
    * Use a non-sync, rename because we know we're going to go off and sync the
-   * directory soon
+   * directory soon.  A segment appended to a published redo log is already
+   * where it belongs.
    */
-  err = addb_file_rename(addb, tbk->tbk_w.path, tbk->tbk_v_path, false);
-  if (err && ENOENT != err) return err;
+  if (!ADDB_TBKF_APPENDING(tbk, &tbk->tbk_w)) {
+    err = addb_file_rename(addb, tbk->tbk_w.path, tbk->tbk_v_path, false);
+    if (err && ENOENT != err) return err;
+  }
 
   tbk->tbk_w.path = (char*)0;
   tbk->tbk_published = 1;
@@ -401,6 +522,7 @@ int addb_backup_unpublish(addb_handle* addb, addb_tbk* tbk) {
   if (tbk->tbk_published) {
     err = addb_file_unlink(addb, tbk->tbk_v_path);
     tbk->tbk_published = 0;
+    tbk->tbk_v_size = 0;
     cl_log(addb->addb_cl, CL_LEVEL_SPEW, "addb_backup_unpublish: \"%s\"",
            tbk->tbk_v_path);
   }
@@ -457,11 +579,20 @@ int addb_backup_abort(addb_handle* addb, addb_tbk* tbk) {
     cl_log(addb->addb_cl, CL_LEVEL_SPEW, "addb_backup_abort: removing \"%s\"",
            tbk->tbk_a.path);
 
-    e = addb_file_close(addb, tbk->tbk_a.fd, tbk->tbk_a.path);
-    if (!err) err = e;
+    if (ADDB_TBKF_APPENDING(tbk, &tbk->tbk_a)) {
+      e = addb_file_truncate(addb, tbk->tbk_a.fd, tbk->tbk_a.path,
+                             tbk->tbk_a.start);
+      if (!err) err = e;
 
-    e = addb_file_unlink(addb, tbk->tbk_a.path);
-    if (!err) err = e;
+      e = addb_file_close(addb, tbk->tbk_a.fd, tbk->tbk_a.path);
+      if (!err) err = e;
+    } else {
+      e = addb_file_close(addb, tbk->tbk_a.fd, tbk->tbk_a.path);
+      if (!err) err = e;
+
+      e = addb_file_unlink(addb, tbk->tbk_a.path);
+      if (!err) err = e;
+    }
 
     tbk->tbk_a.fd = -1;
     tbk->tbk_a.path = (char*)0;
@@ -479,8 +610,17 @@ int addb_backup_abort(addb_handle* addb, addb_tbk* tbk) {
                               tbk->tbk_w.path);
     if (!err && e != 0 && e != ECANCELED) err = e;
 
-    e = addb_file_unlink(addb, tbk->tbk_w.path);
-    if (!err) err = e;
+    if (ADDB_TBKF_APPENDING(tbk, &tbk->tbk_w)) {
+      e = addb_file_truncate(addb, tbk->tbk_w.fd, tbk->tbk_w.path,
+                             tbk->tbk_w.start);
+      if (!err) err = e;
+
+      e = addb_file_close(addb, tbk->tbk_w.fd, tbk->tbk_w.path);
+      if (!err) err = e;
+    } else {
+      e = addb_file_unlink(addb, tbk->tbk_w.path);
+      if (!err) err = e;
+    }
 
     tbk->tbk_w.fd = -1;
     tbk->tbk_w.path = (char*)0;
@@ -511,15 +651,17 @@ int addb_backup_close(addb_handle* addb, addb_tbk* tbk,
     cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "lseek", err,
                  "Unable seek end of backup file: %s", tbk->tbk_w.path);
   }
-  *bytes_written = off;
+  *bytes_written = off - tbk->tbk_w.start;
 
   e = addb_file_close(addb, tbk->tbk_w.fd, tbk->tbk_w.path);
   if (e && !err) err = e;
 
   /*  Unlink the file if there was no error,
-   *  and if we only wrote a header.
+   *  and if we only wrote a header.  (Segments appended to
+   *  a redo log always hold records.)
    */
-  if (!err && sizeof(addb_bkh) == off)
+  if (!err && !ADDB_TBKF_APPENDING(tbk, &tbk->tbk_w) &&
+      (addb->addb_redo_log ? sizeof(addb_rdh) : sizeof(addb_bkh)) == off)
     err = addb_file_unlink(addb, tbk->tbk_w.path);
 
   tbk->tbk_w.fd = -1;
@@ -527,6 +669,95 @@ int addb_backup_close(addb_handle* addb, addb_tbk* tbk,
   return err;
 }
 
+/**
+ * @brief Replay a redo log.
+ *
+ *  Segments whose checkpoint started from a horizon before the
+ *  one we know we're synced to made it past their marker write;
+ *  their pages may or may not have reached the file, so apply
+ *  them, in order.  The first segment that doesn't qualify, and
+ *  everything after it, belongs to a checkpoint that never
+ *  finished; its pages were never copied into the file.
+ *
+ * @param addb 		Addb handle for cl
+ * @param td		tiled file to apply the log to
+ * @param tbk		backup information for the file
+ * @param mem		the mapped log
+ * @param size		number of bytes in the log
+ * @param horizon	We *know* we're sync'ed up to this point.
+ *
+ * @return 0 success, a nonzero error code for error.
+ * @return ENOENT if there was nothing to replay.
+ */
+static int addb_backup_redo(addb_handle* addb, addb_tiled* td, addb_tbk* tbk,
+                            char* mem, size_t size,
+                            unsigned long long horizon) {
+  cl_handle* const cl = addb->addb_cl;
+  char* const end = mem + size;
+  char* seg = mem;
+  size_t n = 0;
+
+  while (seg + sizeof(addb_rdh) <= end) {
+    addb_rdh* const rdh = (addb_rdh*)seg;
+    unsigned long long const seg_horizon = ADDB_RDH_HORIZON(rdh);
+    unsigned long long const seg_size = ADDB_RDH_SIZE(rdh);
+    char* const seg_end = seg + sizeof(*rdh) + seg_size;
+    addb_bkr* bkr;
+
+    if (memcmp(rdh->rdh_magic, ADDB_REDO_MAGIC, ADDB_MAGIC_SIZE) != 0 ||
+        ADDB_U5_MAX == seg_horizon || seg_size > end - (seg + sizeof(*rdh))) {
+      cl_log(cl, CL_LEVEL_DEBUG,
+             "%s: ignoring incomplete redo log segment at %llu",
+             tbk->tbk_v_path, (unsigned long long)(seg - mem));
+      break;
+    }
+    if (seg_horizon >= horizon) break;
+
+    /*  A record that runs past the end of its segment means the
+     *  log is damaged; check the whole segment before applying any
+     *  of it, and don't replay from there on.
+     */
+    for (bkr = (addb_bkr*)(rdh + 1); (char*)bkr < seg_end;) {
+      char* const data = ADDB_BKR_DATA(bkr);
+
+      if (data > seg_end || ADDB_BKR_SIZE(bkr) > (size_t)(seg_end - data)) {
+        cl_log(cl, CL_LEVEL_ERROR,
+               "%s: redo log record at %llu runs past the end of its "
+               "segment; stopping replay after %zu segment%s",
+               tbk->tbk_v_path, (unsigned long long)((char*)bkr - mem), n,
+               n == 1 ? "" : "s");
+        goto done;
+      }
+      bkr = (addb_bkr*)(data + ADDB_BKR_SIZE(bkr));
+    }
+
+    for (bkr = (addb_bkr*)(rdh + 1); (char*)bkr < seg_end;) {
+      unsigned long long const offset = ADDB_BKR_OFFSET(bkr);
+      unsigned long long const rec_size = ADDB_BKR_SIZE(bkr);
+      char* const data = ADDB_BKR_DATA(bkr);
+      int err;
+
+      err = addb_tiled_apply_backup_record(td, offset, data, rec_size);
+      if (err) {
+        cl_log_errno(cl, CL_LEVEL_FAIL, "addb_tiled_apply_backup_record", err,
+                     "%s: error while replaying page %llu[%llu] from "
+                     "horizon %llu",
+                     tbk->tbk_v_path, offset, rec_size, seg_horizon);
+        return err;
+      }
+      bkr = (addb_bkr*)(data + rec_size);
+    }
+    n++;
+    seg = seg_end;
+  }
+
+done:
+  cl_log(cl, CL_LEVEL_DEBUG, "%s: replayed %zu redo log segment%s up to %llu",
+         tbk->tbk_v_path, n, n == 1 ? "" : "s", horizon);
+
+  return n ? 0 : ENOENT;
+}
+
 /**
  * @brief Read a backup file.
  *
@@ -582,6 +813,12 @@ int addb_backup_read(addb_handle* addb, addb_tiled* td, addb_tbk* tbk,
     goto unmap;
   }
 
+  if (st.st_size >= ADDB_MAGIC_SIZE &&
+      memcmp(mem, ADDB_REDO_MAGIC, ADDB_MAGIC_SIZE) == 0) {
+    err = addb_backup_redo(addb, td, tbk, mem, st.st_size, horizon);
+    goto unmap;
+  }
+
   bkh = (addb_bkh*)mem;
   if (memcmp(bkh->bkh_magic, ADDB_BACKUP_MAGIC, 4) != 0) {
     cl_log(cl, CL_LEVEL_ERROR, "%s: unexpected magic; expected %s, got %.4s",
@@ -685,5 +922,12 @@ unmap : {
   if (e && !err) err = e;
 }
 
+  /*  Nothing in the redo log needs replaying; the file
+   *  is in sync without it.
+   */
+  if (err == ENOENT) {
+    int e = addb_file_unlink(addb, tbk->tbk_v_path);
+    if (e) err = e;
+  }
   return err;
 }
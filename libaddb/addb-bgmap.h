@@ -33,10 +33,22 @@ int addb_bgmap_check(struct addb_gmap *gm, struct addb_bgmap *bg,
 int addb_bgmap_append(struct addb_gmap *gm, struct addb_bgmap *bg,
                       addb_gmap_id s);
 
+int addb_bgmap_count_range(struct addb_gmap *gm, struct addb_bgmap *bg,
+                           addb_gmap_id low, addb_gmap_id high,
+                           unsigned long long *n_out);
+
+int addb_bgmap_count_masked(struct addb_gmap *gm, struct addb_bgmap *bg,
+                            addb_bmap *mask, addb_gmap_id low,
+                            addb_gmap_id high, unsigned long long *n_out);
+
 int addb_bgmap_next(struct addb_gmap *gm, struct addb_bgmap *bm,
                     addb_gmap_id *start, addb_gmap_id low, addb_gmap_id high,
                     bool direction);
 
+int addb_bgmap_next_masked(struct addb_gmap *gm, struct addb_bgmap *bm,
+                           addb_bmap *mask, addb_gmap_id *start,
+                           addb_gmap_id low, addb_gmap_id high, bool direction);
+
 int addb_bgmap_checkpoint(addb_gmap *gm, unsigned long long horizon,
                           bool hard_sync, bool block,
                           addb_tiled_checkpoint_fn *cpfn);
@@ -0,0 +1,435 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ADDB_BMAP_SIMD_X86 1
+#endif
+
+/*  Word kernels for bitmaps.
+ *
+ *  addb-bmap.c maps a tile of the bitmap file and hands runs of
+ *  whole 64-bit words inside it to the kernels below; partial
+ *  words at either end of a range are masked and handled there.
+ *
+ *  The kernel set is picked once, at first use, based on what
+ *  the CPU we're running on supports.
+ */
+
+static size_t first_scalar(unsigned long long const *w, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (w[i] != 0) break;
+  return i;
+}
+
+static size_t last_scalar(unsigned long long const *w, size_t n) {
+  size_t i = n;
+
+  while (i > 0)
+    if (w[--i] != 0) return i;
+  return n;
+}
+
+static unsigned long long count_scalar(unsigned long long const *w,
+                                       size_t n) {
+  unsigned long long c = 0;
+  size_t i;
+
+  for (i = 0; i < n; i++) c += __builtin_popcountll(w[i]);
+  return c;
+}
+
+static void and_scalar(unsigned long long const *a,
+                       unsigned long long const *b, unsigned long long *out,
+                       size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) out[i] = a[i] & b[i];
+}
+
+static size_t test_scalar(unsigned long long const *w,
+                          unsigned long long base, addb_id const *id,
+                          size_t n, addb_id *out) {
+  addb_id *const out0 = out;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    unsigned long long bit = id[i] - base;
+    if ((w[bit >> 6] >> (bit & 63)) & 1) *out++ = id[i];
+  }
+  return out - out0;
+}
+
+static const addb_bmap_kernel addb_bmap_kernel_scalar = {
+    "scalar", first_scalar, last_scalar, count_scalar, and_scalar,
+    test_scalar};
+
+#ifdef ADDB_BMAP_SIMD_X86
+
+/**
+ * @brief SSE2: find the first nonzero word, four words at a time.
+ */
+__attribute__((target("sse2"))) static size_t first_sse2(
+    unsigned long long const *w, size_t n) {
+  __m128i const zero = _mm_setzero_si128();
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i x = _mm_or_si128(_mm_loadu_si128((__m128i const *)(w + i)),
+                             _mm_loadu_si128((__m128i const *)(w + i + 2)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF)
+      return i + first_scalar(w + i, 4);
+  }
+  return i + first_scalar(w + i, n - i);
+}
+
+__attribute__((target("sse2"))) static size_t last_sse2(
+    unsigned long long const *w, size_t n) {
+  __m128i const zero = _mm_setzero_si128();
+  size_t i = n, k;
+
+  for (; i >= 4; i -= 4) {
+    __m128i x = _mm_or_si128(_mm_loadu_si128((__m128i const *)(w + i - 4)),
+                             _mm_loadu_si128((__m128i const *)(w + i - 2)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF)
+      return i - 4 + last_scalar(w + i - 4, 4);
+  }
+  return (k = last_scalar(w, i)) == i ? n : k;
+}
+
+/**
+ * @brief SSE2 population count.
+ *
+ *  SSE2 has no byte shuffle; add up bit pairs, nibbles, and
+ *  bytes in place, then sum the bytes with PSADBW.
+ */
+__attribute__((target("sse2"))) static unsigned long long count_sse2(
+    unsigned long long const *w, size_t n) {
+  __m128i const m1 = _mm_set1_epi8(0x55);
+  __m128i const m2 = _mm_set1_epi8(0x33);
+  __m128i const m4 = _mm_set1_epi8(0x0F);
+  __m128i acc = _mm_setzero_si128();
+  size_t i;
+
+  for (i = 0; i + 2 <= n; i += 2) {
+    __m128i x = _mm_loadu_si128((__m128i const *)(w + i));
+
+    x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi64(x, 1), m1));
+    x = _mm_add_epi8(_mm_and_si128(x, m2),
+                     _mm_and_si128(_mm_srli_epi64(x, 2), m2));
+    x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi64(x, 4)), m4);
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(x, _mm_setzero_si128()));
+  }
+  return (unsigned long long)_mm_cvtsi128_si64(acc) +
+         (unsigned long long)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)) +
+         count_scalar(w + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void and_sse2(
+    unsigned long long const *a, unsigned long long const *b,
+    unsigned long long *out, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    _mm_storeu_si128(
+        (__m128i *)(out + i),
+        _mm_and_si128(_mm_loadu_si128((__m128i const *)(a + i)),
+                      _mm_loadu_si128((__m128i const *)(b + i))));
+  and_scalar(a + i, b + i, out + i, n - i);
+}
+
+/*  SSE2 has no gather; bitmap-by-id tests stay scalar.
+ */
+static const addb_bmap_kernel addb_bmap_kernel_sse2 = {
+    "sse2", first_sse2, last_sse2, count_sse2, and_sse2, test_scalar};
+
+/*  Append the elements of a[0..w) whose bit is set in mask.
+ */
+#define ADDB_BMAP_EMIT(out, a, mask)     \
+  do {                                   \
+    unsigned int m_ = (mask);            \
+    while (m_ != 0) {                    \
+      *(out)++ = (a)[__builtin_ctz(m_)]; \
+      m_ &= m_ - 1;                      \
+    }                                    \
+  } while (0)
+
+/**
+ * @brief AVX2: find the first nonzero word, eight words at a time.
+ */
+__attribute__((target("avx2"))) static size_t first_avx2(
+    unsigned long long const *w, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i x =
+        _mm256_or_si256(_mm256_loadu_si256((__m256i const *)(w + i)),
+                        _mm256_loadu_si256((__m256i const *)(w + i + 4)));
+    if (!_mm256_testz_si256(x, x)) return i + first_scalar(w + i, 8);
+  }
+  return i + first_scalar(w + i, n - i);
+}
+
+__attribute__((target("avx2"))) static size_t last_avx2(
+    unsigned long long const *w, size_t n) {
+  size_t i = n, k;
+
+  for (; i >= 8; i -= 8) {
+    __m256i x =
+        _mm256_or_si256(_mm256_loadu_si256((__m256i const *)(w + i - 8)),
+                        _mm256_loadu_si256((__m256i const *)(w + i - 4)));
+    if (!_mm256_testz_si256(x, x)) return i - 8 + last_scalar(w + i - 8, 8);
+  }
+  return (k = last_scalar(w, i)) == i ? n : k;
+}
+
+/**
+ * @brief AVX2 population count.
+ *
+ *  Look up the bit count of each nibble with VPSHUFB, then sum
+ *  the bytes with VPSADBW.
+ */
+__attribute__((target("avx2"))) static unsigned long long count_avx2(
+    unsigned long long const *w, size_t n) {
+  __m256i const lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                       3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                       2, 3, 2, 3, 3, 4);
+  __m256i const low = _mm256_set1_epi8(0x0F);
+  __m256i acc = _mm256_setzero_si256();
+  __m128i sum;
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256((__m256i const *)(w + i));
+    __m256i c = _mm256_add_epi8(
+        _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+        _mm256_shuffle_epi8(lut,
+                            _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+  }
+  sum = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                      _mm256_extracti128_si256(acc, 1));
+  return (unsigned long long)_mm_cvtsi128_si64(sum) +
+         (unsigned long long)_mm_extract_epi64(sum, 1) +
+         count_scalar(w + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void and_avx2(
+    unsigned long long const *a, unsigned long long const *b,
+    unsigned long long *out, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_si256(
+        (__m256i *)(out + i),
+        _mm256_and_si256(_mm256_loadu_si256((__m256i const *)(a + i)),
+                         _mm256_loadu_si256((__m256i const *)(b + i))));
+  and_scalar(a + i, b + i, out + i, n - i);
+}
+
+/**
+ * @brief AVX2: test four ids at a time.
+ *
+ *  Gather the word holding each id's bit, shift the bit down,
+ *  and keep the ids whose bit is 1.
+ */
+__attribute__((target("avx2"))) static size_t test_avx2(
+    unsigned long long const *w, unsigned long long base, addb_id const *id,
+    size_t n, addb_id *out) {
+  __m256i const vbase = _mm256_set1_epi64x((long long)base);
+  __m256i const one = _mm256_set1_epi64x(1);
+  __m256i const m63 = _mm256_set1_epi64x(63);
+  addb_id *const out0 = out;
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m256i bit = _mm256_sub_epi64(
+        _mm256_loadu_si256((__m256i const *)(id + i)), vbase);
+    __m256i word = _mm256_i64gather_epi64((long long const *)w,
+                                          _mm256_srli_epi64(bit, 6), 8);
+    __m256i x = _mm256_and_si256(
+        _mm256_srlv_epi64(word, _mm256_and_si256(bit, m63)), one);
+    unsigned int mask = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(x, one)));
+
+    ADDB_BMAP_EMIT(out, id + i, mask);
+  }
+  out += test_scalar(w, base, id + i, n - i, out);
+  return out - out0;
+}
+
+static const addb_bmap_kernel addb_bmap_kernel_avx2 = {
+    "avx2", first_avx2, last_avx2, count_avx2, and_avx2, test_avx2};
+
+/**
+ * @brief AVX-512: find the first nonzero word, sixteen at a time.
+ */
+__attribute__((target("avx512f"))) static size_t first_avx512(
+    unsigned long long const *w, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m512i x = _mm512_or_si512(_mm512_loadu_si512(w + i),
+                                _mm512_loadu_si512(w + i + 8));
+    if (_mm512_test_epi64_mask(x, x) != 0)
+      return i + first_scalar(w + i, 16);
+  }
+  return i + first_scalar(w + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static size_t last_avx512(
+    unsigned long long const *w, size_t n) {
+  size_t i = n, k;
+
+  for (; i >= 16; i -= 16) {
+    __m512i x = _mm512_or_si512(_mm512_loadu_si512(w + i - 16),
+                                _mm512_loadu_si512(w + i - 8));
+    if (_mm512_test_epi64_mask(x, x) != 0)
+      return i - 16 + last_scalar(w + i - 16, 16);
+  }
+  return (k = last_scalar(w, i)) == i ? n : k;
+}
+
+/**
+ * @brief AVX-512BW population count.
+ *
+ *  Same nibble lookup as the AVX2 version, on 512-bit vectors.
+ *  (VPOPCNTQ would be faster still, but few CPUs that run this
+ *  have it.)
+ */
+__attribute__((target("avx512f,avx512bw"))) static unsigned long long
+count_avx512(unsigned long long const *w, size_t n) {
+  __m512i const lut = _mm512_broadcast_i32x4(
+      _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+  __m512i const low = _mm512_set1_epi8(0x0F);
+  __m512i acc = _mm512_setzero_si512();
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m512i x = _mm512_loadu_si512(w + i);
+    __m512i c = _mm512_add_epi8(
+        _mm512_shuffle_epi8(lut, _mm512_and_si512(x, low)),
+        _mm512_shuffle_epi8(lut,
+                            _mm512_and_si512(_mm512_srli_epi16(x, 4), low)));
+    acc = _mm512_add_epi64(acc, _mm512_sad_epu8(c, _mm512_setzero_si512()));
+  }
+  return (unsigned long long)_mm512_reduce_add_epi64(acc) +
+         count_scalar(w + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static void and_avx512(
+    unsigned long long const *a, unsigned long long const *b,
+    unsigned long long *out, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm512_storeu_si512(out + i, _mm512_and_si512(_mm512_loadu_si512(a + i),
+                                                  _mm512_loadu_si512(b + i)));
+  and_scalar(a + i, b + i, out + i, n - i);
+}
+
+/**
+ * @brief AVX-512: test eight ids at a time.
+ *
+ *  Like the AVX2 version, but the hits are written with a
+ *  compressing store rather than one at a time.
+ */
+__attribute__((target("avx512f"))) static size_t test_avx512(
+    unsigned long long const *w, unsigned long long base, addb_id const *id,
+    size_t n, addb_id *out) {
+  __m512i const vbase = _mm512_set1_epi64((long long)base);
+  __m512i const one = _mm512_set1_epi64(1);
+  addb_id *const out0 = out;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m512i ids = _mm512_loadu_si512(id + i);
+    __m512i bit = _mm512_sub_epi64(ids, vbase);
+    __m512i word =
+        _mm512_i64gather_epi64(_mm512_srli_epi64(bit, 6), w, 8);
+    __mmask8 mask = _mm512_test_epi64_mask(
+        _mm512_srlv_epi64(word, _mm512_and_si512(bit, _mm512_set1_epi64(63))),
+        one);
+
+    _mm512_mask_compressstoreu_epi64(out, mask, ids);
+    out += __builtin_popcount(mask);
+  }
+  out += test_scalar(w, base, id + i, n - i, out);
+  return out - out0;
+}
+
+static const addb_bmap_kernel addb_bmap_kernel_avx512 = {
+    "avx512", first_avx512, last_avx512, count_avx512, and_avx512,
+    test_avx512};
+
+#endif /* ADDB_BMAP_SIMD_X86 */
+
+static addb_bmap_kernel const *addb_bmap_kernel_chosen;
+
+/*  Pick the best kernels the CPU supports; if <want> is
+ *  non-NULL, only consider the kernels of that name.
+ */
+static void bmap_kernel_pick(char const *want) {
+  addb_bmap_kernel const *k = &addb_bmap_kernel_scalar;
+
+#ifdef ADDB_BMAP_SIMD_X86
+  __builtin_cpu_init();
+  if (want == NULL || strcasecmp(want, "scalar") != 0) {
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw") &&
+        (want == NULL || strcasecmp(want, "avx512") == 0))
+      k = &addb_bmap_kernel_avx512;
+    else if (__builtin_cpu_supports("avx2") &&
+             (want == NULL || strcasecmp(want, "avx2") == 0))
+      k = &addb_bmap_kernel_avx2;
+    else if (__builtin_cpu_supports("sse2") &&
+             (want == NULL || strcasecmp(want, "sse2") == 0))
+      k = &addb_bmap_kernel_sse2;
+  }
+#else
+  (void)want;
+#endif
+  addb_bmap_kernel_chosen = k;
+}
+
+/**
+ * @brief Pick the bitmap kernels for this CPU.
+ *
+ * @return the kernels to use.
+ */
+addb_bmap_kernel const *addb_bmap_kernel_select(void) {
+  if (addb_bmap_kernel_chosen == NULL) bmap_kernel_pick(NULL);
+  return addb_bmap_kernel_chosen;
+}
+
+/**
+ * @brief Use specific bitmap kernels from now on.
+ *
+ *  That's useful for testing and benchmarking; the server
+ *  always lets addb_bmap_kernel_select() choose.
+ *
+ * @param name	"scalar", "sse2", "avx2", or "avx512"
+ * @return 0 on success, ENOENT if the CPU doesn't support
+ *	those kernels; the scalar kernels are used then.
+ */
+int addb_bmap_kernel_force(char const *name) {
+  bmap_kernel_pick(name);
+  return strcasecmp(name, addb_bmap_kernel_chosen->bk_name) ? ENOENT : 0;
+}
@@ -0,0 +1,370 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#define _XOPEN_SOURCE 700 /* needed for mkdtemp, nftw */
+
+#include "libaddb/addb-bmap.h"
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(expr)                          \
+  do {                                      \
+    if (!(expr)) {                          \
+      fprintf(stderr,                       \
+              "test \"%s\", line %d: test " \
+              "failed: %s\n",               \
+              __FILE__, __LINE__, #expr);   \
+      except_throw(err);                    \
+    }                                       \
+  } while (0)
+
+/*  User bits in a tile; the first tile loses ADDB_BMAP_HEADER
+ *  bytes to the header.
+ */
+#define TILE_BITS (ADDB_TILE_SIZE * 8)
+#define HEADER_BITS (ADDB_BMAP_HEADER * 8)
+
+/*  Three tiles, less a bit -- the last one is partial,
+ *  and ends in the middle of a word.
+ */
+#define N_BITS (3 * TILE_BITS - 1000)
+
+/*  The bits of two bitmaps, their intersection, and for each
+ *  of those, the number of bits set below i, and the next bit
+ *  set at or above (at or below) i, or N_BITS if there is none.
+ */
+typedef struct shadow {
+  unsigned char *sh_bit;
+  unsigned long long *sh_below;
+  unsigned long long *sh_next;
+  unsigned long long *sh_prev;
+} shadow;
+
+static void shadow_index(shadow *sh) {
+  unsigned long long i, n = 0, last = N_BITS;
+
+  sh->sh_below = malloc((N_BITS + 1) * sizeof(*sh->sh_below));
+  sh->sh_next = malloc((N_BITS + 1) * sizeof(*sh->sh_next));
+  sh->sh_prev = malloc(N_BITS * sizeof(*sh->sh_prev));
+  if (!sh->sh_below || !sh->sh_next || !sh->sh_prev) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  for (i = 0; i < N_BITS; i++) {
+    sh->sh_below[i] = n;
+    n += sh->sh_bit[i];
+    if (sh->sh_bit[i]) last = i;
+    sh->sh_prev[i] = last;
+  }
+  sh->sh_below[N_BITS] = n;
+
+  sh->sh_next[N_BITS] = N_BITS;
+  for (i = N_BITS; i-- > 0;)
+    sh->sh_next[i] = sh->sh_bit[i] ? i : sh->sh_next[i + 1];
+}
+
+static void shadow_finish(shadow *sh) {
+  free(sh->sh_bit);
+  free(sh->sh_below);
+  free(sh->sh_next);
+  free(sh->sh_prev);
+}
+
+/*  The first bit set in s..e-1, and the last one set in s..e.
+ */
+static int shadow_first(shadow const *sh, unsigned long long s,
+                        unsigned long long e, unsigned long long *out) {
+  if (sh->sh_next[s] >= e) return ADDB_ERR_NO;
+  *out = sh->sh_next[s];
+  return 0;
+}
+
+static int shadow_last(shadow const *sh, unsigned long long s,
+                       unsigned long long e, unsigned long long *out) {
+  if (sh->sh_prev[e] == N_BITS || sh->sh_prev[e] < s) return ADDB_ERR_NO;
+  *out = sh->sh_prev[e];
+  return 0;
+}
+
+/*  Bit offsets where the word loops, the AND chunks, or the
+ *  tiles start and stop.
+ */
+static unsigned long long edge[128];
+static size_t edge_n;
+
+static void edge_add(long long b) {
+  int d;
+
+  for (d = -1; d <= 1; d++)
+    if (b + d >= 0 && b + d < N_BITS) edge[edge_n++] = b + d;
+}
+
+static void edge_make(void) {
+  int t;
+
+  edge_n = 0;
+  edge[edge_n++] = 0;
+  edge_add(63);
+  edge_add(128);
+  edge_add(256);
+  edge_add(512);
+  edge_add(1000);
+  for (t = 1; t <= 3; t++) {
+    edge_add(t * TILE_BITS - HEADER_BITS);
+    edge_add(t * TILE_BITS - HEADER_BITS - 64 * 17);
+    edge_add((t - 1) * TILE_BITS - HEADER_BITS + 512 * 64);
+  }
+  edge[edge_n++] = N_BITS - 1;
+}
+
+/*  Check scan, count, and their intersecting versions
+ *  on s..e against the shadows.
+ */
+static int range_agrees(addb_bmap *a, addb_bmap *b, shadow const *sa,
+                        shadow const *sab, unsigned long long s,
+                        unsigned long long e) {
+  unsigned long long want, got, n;
+  int want_err;
+
+  TEST(addb_bmap_count_range(a, s, e, &n) == 0);
+  TEST(n == sa->sh_below[e] - sa->sh_below[s]);
+
+  TEST(addb_bmap_intersect_count(a, b, s, e, &n) == 0);
+  TEST(n == sab->sh_below[e] - sab->sh_below[s]);
+
+  want_err = shadow_first(sa, s, e, &want);
+  TEST(addb_bmap_scan(a, s, e, &got, true) == want_err);
+  TEST(want_err != 0 || got == want);
+
+  want_err = shadow_first(sab, s, e, &want);
+  TEST(addb_bmap_intersect_scan(a, b, s, e, &got, true) == want_err);
+  TEST(want_err != 0 || got == want);
+
+  if (e < N_BITS) {
+    want_err = shadow_last(sa, s, e, &want);
+    TEST(addb_bmap_scan(a, s, e, &got, false) == want_err);
+    TEST(want_err != 0 || got == want);
+
+    want_err = shadow_last(sab, s, e, &want);
+    TEST(addb_bmap_intersect_scan(a, b, s, e, &got, false) == want_err);
+    TEST(want_err != 0 || got == want);
+  }
+
+  except_catch(err) {
+    fprintf(stderr, "\t[range %llu..%llu]\n", s, e);
+    return 1;
+  }
+  return 0;
+}
+
+/*  Run the kernels themselves against the scalar ones on runs
+ *  of up to 40 words, starting at every word offset within
+ *  a 64-byte line, so that both the vector loops and their
+ *  tails see unaligned starts.
+ */
+static int kernel_words_agree(addb_bmap_kernel const *k,
+                              addb_bmap_kernel const *scalar) {
+  static unsigned long long wa[48], wb[48], out_k[48], out_s[48];
+  addb_id id[64], got[64], want[64];
+  size_t off, n, i, j, want_n;
+
+  for (off = 0; off < 8; off++)
+    for (n = 0; n <= 40; n++) {
+      unsigned long long *a = wa + off, *b = wb + off;
+
+      /*  Zero except for one word, somewhere.
+       */
+      memset(wa, 0, sizeof wa);
+      for (i = 0; i <= n; i++) {
+        if (i < n) a[i] = 1ull << (random() % 64);
+        TEST((*k->bk_first)(a, n) == (*scalar->bk_first)(a, n));
+        TEST((*k->bk_last)(a, n) == (*scalar->bk_last)(a, n));
+        if (i < n) a[i] = 0;
+      }
+
+      for (i = 0; i < n; i++) {
+        a[i] = (unsigned long long)random() << 33 ^ random();
+        b[i] = (unsigned long long)random() << 33 ^ random();
+      }
+      TEST((*k->bk_count)(a, n) == (*scalar->bk_count)(a, n));
+
+      (*k->bk_and)(a, b, out_k + off, n);
+      (*scalar->bk_and)(a, b, out_s + off, n);
+      TEST(memcmp(out_k + off, out_s + off, n * sizeof(*a)) == 0);
+
+      for (j = 0; j < n && j < 64; j++) id[j] = 1000 + random() % (n * 64);
+      want_n = (*scalar->bk_test)(a, 1000, id, j, want);
+      TEST((*k->bk_test)(a, 1000, id, j, got) == want_n);
+      TEST(memcmp(got, want, want_n * sizeof(*got)) == 0);
+    }
+
+  except_catch(err) {
+    fprintf(stderr, "\t[%zu words at offset %zu]\n", n, off);
+    return 1;
+  }
+  return 0;
+}
+
+/*  Force the kernels <name>, and check bitmap scans, counts,
+ *  and intersections with them against the shadows, on ranges
+ *  that start and end on, next to, and between the edges.
+ */
+static int kernel_check(char const *name, addb_bmap *a, addb_bmap *b,
+                        shadow const *sa, shadow const *sb,
+                        shadow const *sab) {
+  addb_bmap_kernel const *scalar;
+  addb_id id[1000], got[1000], want[1000];
+  size_t i, j, n, want_n;
+
+  /*  Kernels this CPU can't run are skipped.
+   */
+  TEST(addb_bmap_kernel_force("scalar") == 0);
+  scalar = addb_bmap_kernel_select();
+  if (addb_bmap_kernel_force(name) != 0) return 0;
+  TEST(strcmp(addb_bmap_kernel_select()->bk_name, name) == 0);
+
+  TEST(!kernel_words_agree(addb_bmap_kernel_select(), scalar));
+
+  for (i = 0; i < edge_n; i++)
+    for (j = 0; j < edge_n; j++)
+      if (edge[i] < edge[j])
+        TEST(!range_agrees(a, b, sa, sab, edge[i], edge[j]));
+
+  for (i = 0; i < 2000; i++) {
+    unsigned long long s = random() % N_BITS, e = random() % N_BITS;
+
+    if (s > e) {
+      unsigned long long tmp = s;
+      s = e;
+      e = tmp;
+    }
+    if (s < e) TEST(!range_agrees(a, b, sa, sab, s, e));
+  }
+
+  /*  Sorted ids, bunched so that some runs fall into one tile.
+   */
+  for (i = 0, n = 0; i < sizeof(id) / sizeof(*id); i++) {
+    n += 1 + random() % (i % 100 < 50 ? 8 : 4000);
+    id[i] = n % N_BITS;
+    if (i > 0 && id[i] <= id[i - 1]) break;
+  }
+  for (j = 0, want_n = 0; j < i; j++)
+    if (sb->sh_bit[id[j]]) want[want_n++] = id[j];
+  TEST(addb_bmap_fixed_intersect(b->bmap_addb, b, id, i, got, &n, i) == 0);
+  TEST(n == want_n);
+  TEST(memcmp(got, want, n * sizeof(*got)) == 0);
+
+  except_catch(err) {
+    fprintf(stderr, "\t[%s kernels]\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+static int remove_one(char const *path, struct stat const *st, int flag,
+                      struct FTW *ftw) {
+  return remove(path);
+}
+
+/*  Fill a bitmap and its shadow; tile by tile, the density
+ *  goes from dense to nearly empty to sparse.  Bits set in
+ *  <also> are set with probability 1/2.
+ */
+static void bmap_fill(addb_bmap *bm, shadow *sh, shadow const *also) {
+  static const unsigned int one_in[] = {3, 20000, 200};
+  unsigned long long i;
+
+  sh->sh_bit = calloc(N_BITS + 1, 1);
+  if (sh->sh_bit == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < N_BITS; i++)
+    if (random() % one_in[(i + HEADER_BITS) / TILE_BITS] == 0 ||
+        (also != NULL && also->sh_bit[i] && random() % 2)) {
+      sh->sh_bit[i] = 1;
+      if (addb_bmap_set(bm, i) != 0) {
+        fprintf(stderr, "addb_bmap_set %llu fails\n", i);
+        exit(1);
+      }
+    }
+  shadow_index(sh);
+}
+
+int main(int ac, char **av) {
+  cl_handle *cl = cl_create();
+  cm_handle *cm = cm_c();
+  addb_handle *addb;
+  addb_bmap *a, *b;
+  shadow sa, sb, sab;
+  char path[1024];
+  unsigned long long i;
+  int result = 0;
+
+  srandom(42);
+  edge_make();
+
+  snprintf(path, sizeof path, "/tmp/addb-bmap-test.XXXXXX");
+  if (mkdtemp(path) == NULL) {
+    fprintf(stderr, "mkdtemp %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  if ((addb = addb_create(cm, cl, 256ull * 1024 * 1024, false)) == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  strcat(path, "/a");
+  if (addb_bmap_open(addb, path, N_BITS, 0, true, &a) != 0) {
+    fprintf(stderr, "can't open bmap %s\n", path);
+    return 1;
+  }
+  strcpy(strrchr(path, '/'), "/b");
+  if (addb_bmap_open(addb, path, N_BITS, 0, true, &b) != 0) {
+    fprintf(stderr, "can't open bmap %s\n", path);
+    return 1;
+  }
+
+  bmap_fill(a, &sa, NULL);
+  bmap_fill(b, &sb, &sa);
+
+  sab.sh_bit = calloc(N_BITS + 1, 1);
+  if (sab.sh_bit == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  for (i = 0; i < N_BITS; i++) sab.sh_bit[i] = sa.sh_bit[i] & sb.sh_bit[i];
+  shadow_index(&sab);
+
+  result |= kernel_check("scalar", a, b, &sa, &sb, &sab);
+  result |= kernel_check("sse2", a, b, &sa, &sb, &sab);
+  result |= kernel_check("avx2", a, b, &sa, &sb, &sab);
+  result |= kernel_check("avx512", a, b, &sa, &sb, &sab);
+
+  (void)addb_bmap_close(a);
+  (void)addb_bmap_close(b);
+  addb_destroy(addb);
+
+  shadow_finish(&sa);
+  shadow_finish(&sb);
+  shadow_finish(&sab);
+
+  *strrchr(path, '/') = '\0';
+  (void)nftw(path, remove_one, 16, FTW_DEPTH | FTW_PHYS);
+  return result;
+}
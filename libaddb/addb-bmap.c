@@ -482,87 +482,26 @@ int addb_bmap_set(addb_bmap *bmap, unsigned long long bit) {
 }
 
 /*
- * Search qword aligned data for the first occurence of a non-zero qword
- * wills earch forwards or backwards and returns a pointer to the qword
+ * Clear a bit.  Return zero on success, an error code on error.
  */
-static unsigned long long *qmemzero(unsigned long long *start,
-                                    unsigned long long *end, bool forward) {
-  if (forward) {
-    for (; start < end; start++)
-      if (*start) return start;
-    return NULL;
-  } else {
-    while (start < end)
-      if (*--end) return end;
-    return NULL;
-  }
-}
+int addb_bmap_clear(addb_bmap *bmap, unsigned long long bit) {
+  addb_tiled_reference r;
+  unsigned char *p;
 
-/*
- * Table of the position of the most significant bit for numbers in the range
- * 0..255 (value is wrong for zero).
- */
-static const char msb_table[] = {
-    0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7};
+  cl_log(bmap->bmap_cl, CL_LEVEL_SPEW, "addb_bmap_clear: %llx", bit);
 
-/*
- * Table for the position of the least significant bit for numbers in the range
- * 0..255. (value is wrong for zero)
- */
-static const char lsb_table[] = {
-    8, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0,
-    3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0,
-    3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0,
-    3, 0, 1, 0, 2, 0, 1, 0, 7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0,
-    3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-    6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0,
-    3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+  /*  Bits past the end are already clear.
+   */
+  if (bit > bmap->bmap_bits) return 0;
 
-/*
- * Calculate the position of the most significant bit of u
- */
-static int msb(unsigned long long u) {
-  int o = 56;
+  p = addb_tiled_alloc(bmap->bmap_tiled, bit / 8 + ADDB_BMAP_HEADER,
+                       bit / 8 + ADDB_BMAP_HEADER + 1, &r);
+  if (!p) return errno;
 
-  while (u) {
-    if (u & (0xff00000000000000ull)) {
-      o += msb_table[u >> 56];
-      return o;
-    }
-    u <<= 8;
-    o -= 8;
-  }
-  return -1;
-}
+  *p &= ~(1u << (bit % 8));
+  addb_tiled_free(bmap->bmap_tiled, &r);
 
-/*
- * Calculate the position of the least significant bit of u
- */
-static int lsb(unsigned long long u) {
-  int o = 0;
-  while (u) {
-    if (u & (0xffull)) {
-      o += lsb_table[u & 0xff];
-      return o;
-    }
-    u >>= 8;
-    o += 8;
-  }
-  return -1;
+  return 0;
 }
 
 /*
@@ -587,12 +526,12 @@ static unsigned long long extract_bit_range(unsigned long long u, int s,
  * first or last one in the map.
  * start and end should be bit offsets into the bitmap.
  */
-static int bitscan(unsigned char *bp, size_t start, size_t end, bool forward,
-                   unsigned long long *result_out) {
+static int bitscan(addb_bmap_kernel const *k, unsigned char *bp, size_t start,
+                   size_t end, bool forward, unsigned long long *result_out) {
   size_t es; /* This is the bit offset of the first full qword to scan */
   size_t ee; /* This is the bit offset of the last full qword to scan */
   unsigned long long *res;
-  size_t r;
+  size_t r, n, i;
 
   /*
    * Check the first qword as start or end may not be aligned to a 64 bit
@@ -626,7 +565,7 @@ static int bitscan(unsigned char *bp, size_t start, size_t end, bool forward,
      */
     data = extract_bit_range(data, start - s, e - s);
     if (data) {
-      *result_out = lsb(data) + s;
+      *result_out = __builtin_ctzll(data) + s;
       return 0;
     }
     if (e == end) return ADDB_ERR_NO;
@@ -648,7 +587,7 @@ static int bitscan(unsigned char *bp, size_t start, size_t end, bool forward,
     data = extract_bit_range(data, e - s, end - s);
 
     if (data) {
-      *result_out = msb(data) + s;
+      *result_out = 63 - __builtin_clzll(data) + s;
       return 0;
     }
     if (e == start) return ADDB_ERR_NO;
@@ -657,23 +596,24 @@ static int bitscan(unsigned char *bp, size_t start, size_t end, bool forward,
   }
 
   /*
-   * qmemzero takes aligned byte offsets marking the first and one-after-last
-   * qword to scan
+   * Let the kernel find the first (or last) nonzero qword between
+   * the aligned bit offsets es and ee.
    */
-  res = qmemzero((unsigned long long *)(bp + es / 8ull),
-                 (unsigned long long *)(bp + ee / 8ull), forward);
-
-  if (!res) return ADDB_ERR_NO;
+  res = (unsigned long long *)(void *)(bp + es / 8ull);
+  n = (ee - es) / 64;
+  i = forward ? (*k->bk_first)(res, n) : (*k->bk_last)(res, n);
+  if (i >= n) return ADDB_ERR_NO;
+  res += i;
 
   /*
    * We have a qword with a set bit. Find out which one it is and add
    * the bit address of the qword it lives in to get the result
    */
   if (forward) {
-    r = lsb(*res) + ((void *)res - (void *)bp) * 8;
+    r = __builtin_ctzll(*res) + ((void *)res - (void *)bp) * 8;
     if (r >= end) return ADDB_ERR_NO;
   } else {
-    r = msb(*res) + ((void *)res - (void *)bp) * 8;
+    r = 63 - __builtin_clzll(*res) + ((void *)res - (void *)bp) * 8;
     if (r < start) return ADDB_ERR_NO;
   }
 
@@ -718,6 +658,7 @@ int addb_bmap_scan(addb_bmap *bmap, unsigned long long start,
 
   unsigned char *tp;
   addb_tiled_reference r;
+  addb_bmap_kernel const *const k = addb_bmap_kernel_select();
 
   int err;
 
@@ -775,7 +716,7 @@ int addb_bmap_scan(addb_bmap *bmap, unsigned long long start,
      */
     cl_assert(bmap->bmap_cl, tp);
 
-    err = bitscan(tp, tile_offset_s, tile_offset_e, forward, result_out);
+    err = bitscan(k, tp, tile_offset_s, tile_offset_e, forward, result_out);
 
     addb_tiled_free(bmap->bmap_tiled, &r);
     /*
@@ -802,32 +743,327 @@ int addb_bmap_scan(addb_bmap *bmap, unsigned long long start,
   return ADDB_ERR_NO;
 }
 
+/*
+ * Count the bits between start (included) and end (excluded) in a
+ * bitmap pointed to by bp (which must be qword aligned).
+ */
+static unsigned long long bitcount(addb_bmap_kernel const *k,
+                                   unsigned char const *bp, size_t start,
+                                   size_t end) {
+  unsigned long long const *w = (unsigned long long const *)(void const *)bp;
+  size_t ws = start / 64;
+  size_t we = end / 64;
+  unsigned long long n;
+
+  if (ws == we)
+    return __builtin_popcountll(
+        extract_bit_range(w[ws], start - ws * 64, end - ws * 64));
+
+  n = __builtin_popcountll(w[ws] >> (start % 64));
+  n += (*k->bk_count)(w + ws + 1, we - ws - 1);
+  if (end % 64)
+    n += __builtin_popcountll(extract_bit_range(w[we], 0, end % 64));
+
+  return n;
+}
+
+/*
+ * Get the tile that holds <bit>.  Tiles past the end of the file
+ * have never been written to; they read as zeros, and we return
+ * ADDB_ERR_NO for them.
+ */
+static int bmap_tile(addb_bmap *bmap, unsigned long long bit,
+                     unsigned long long *tile_bit_out, unsigned char **tp_out,
+                     addb_tiled_reference *r) {
+  unsigned long long tile_byte;
+  int err;
+
+  tile_byte = ((bit + ADDB_BMAP_HEADER * 8) / 8) & ~(ADDB_TILE_SIZE - 1);
+  *tile_bit_out = tile_byte * 8;
+
+  *tp_out = addb_tiled_get(bmap->bmap_tiled, tile_byte,
+                           tile_byte + ADDB_TILE_SIZE, ADDB_MODE_READ, r);
+  if (*tp_out == NULL) {
+    if ((err = errno) == E2BIG) return ADDB_ERR_NO;
+
+    cl_log_errno(bmap->bmap_cl, CL_LEVEL_ERROR, "addb_tiled_get", err,
+                 "%s: can't get tile for bit %llx", bmap->bmap_path, bit);
+    return err;
+  }
+  return 0;
+}
+
+/**
+ * @brief Count the bits set in a range of a bitmap.
+ *
+ * @param bmap	the bitmap
+ * @param start	first bit to count
+ * @param end	first bit not to count
+ * @param n_out	out: number of bits set in start..end-1.
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_bmap_count_range(addb_bmap *bmap, unsigned long long start,
+                          unsigned long long end, unsigned long long *n_out) {
+  addb_bmap_kernel const *const k = addb_bmap_kernel_select();
+
+  *n_out = 0;
+  if (end > bmap->bmap_bits) end = bmap->bmap_bits + 1;
+
+  while (start < end) {
+    unsigned long long tile_bit, s, e;
+    addb_tiled_reference r;
+    unsigned char *tp;
+    int err;
+
+    err = bmap_tile(bmap, start, &tile_bit, &tp, &r);
+    if (err == ADDB_ERR_NO) break;
+    if (err != 0) return err;
+
+    s = start + ADDB_BMAP_HEADER * 8 - tile_bit;
+    e = end + ADDB_BMAP_HEADER * 8 - tile_bit;
+    if (e > ADDB_TILE_SIZE * 8) e = ADDB_TILE_SIZE * 8;
+
+    *n_out += bitcount(k, tp, s, e);
+    addb_tiled_free(bmap->bmap_tiled, &r);
+
+    start += e - s;
+  }
+  return 0;
+}
+
+/*  Words of two tiles that are ANDed at a time, on the stack.
+ */
+#define ADDB_BMAP_AND_CHUNK 512
+
+/**
+ * @brief Count the bits set in both of two bitmaps.
+ *
+ * @param a	one bitmap
+ * @param b	the other bitmap
+ * @param start	first bit to count
+ * @param end	first bit not to count
+ * @param n_out	out: number of bits set in a and b in start..end-1.
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_bmap_intersect_count(addb_bmap *a, addb_bmap *b,
+                              unsigned long long start, unsigned long long end,
+                              unsigned long long *n_out) {
+  addb_bmap_kernel const *const k = addb_bmap_kernel_select();
+  unsigned long long buf[ADDB_BMAP_AND_CHUNK];
+
+  *n_out = 0;
+  if (end > a->bmap_bits) end = a->bmap_bits + 1;
+  if (end > b->bmap_bits) end = b->bmap_bits + 1;
+
+  while (start < end) {
+    unsigned long long tile_bit, s, e, cs;
+    addb_tiled_reference ra, rb;
+    unsigned char *ta, *tb;
+    int err;
+
+    err = bmap_tile(a, start, &tile_bit, &ta, &ra);
+    if (err == ADDB_ERR_NO) break;
+    if (err != 0) return err;
+
+    err = bmap_tile(b, start, &tile_bit, &tb, &rb);
+    if (err != 0) {
+      addb_tiled_free(a->bmap_tiled, &ra);
+      if (err == ADDB_ERR_NO) break;
+      return err;
+    }
+
+    s = start + ADDB_BMAP_HEADER * 8 - tile_bit;
+    e = end + ADDB_BMAP_HEADER * 8 - tile_bit;
+    if (e > ADDB_TILE_SIZE * 8) e = ADDB_TILE_SIZE * 8;
+
+    /*  AND a chunk of words into buf, then count that.
+     */
+    for (cs = s & ~63ull; cs < e; cs += ADDB_BMAP_AND_CHUNK * 64) {
+      unsigned long long ce = cs + ADDB_BMAP_AND_CHUNK * 64;
+      size_t nw;
+
+      if (ce > e) ce = e;
+      nw = (ce - cs + 63) / 64;
+      (*k->bk_and)((unsigned long long *)(void *)ta + cs / 64,
+                   (unsigned long long *)(void *)tb + cs / 64, buf, nw);
+      *n_out += bitcount(k, (unsigned char *)buf, (cs < s ? s : cs) - cs,
+                         ce - cs);
+    }
+    addb_tiled_free(b->bmap_tiled, &rb);
+    addb_tiled_free(a->bmap_tiled, &ra);
+
+    start += e - s;
+  }
+  return 0;
+}
+
+/**
+ * @brief Find the first (or last) bit set in both of two bitmaps.
+ *
+ *  Like addb_bmap_scan(), searching forward finds the lowest
+ *  bit in start..end-1; searching backward finds the highest
+ *  bit in start..end (inclusive).
+ *
+ * @param a		one bitmap
+ * @param b		the other bitmap
+ * @param start		lower end of the range
+ * @param end		upper end of the range
+ * @param result_out	out: the bit that was found
+ * @param forward	search forward or backward?
+ *
+ * @return 0 on success, ADDB_ERR_NO if there is no such bit,
+ *	a nonzero error code on error.
+ */
+int addb_bmap_intersect_scan(addb_bmap *a, addb_bmap *b,
+                             unsigned long long start, unsigned long long end,
+                             unsigned long long *result_out, bool forward) {
+  addb_bmap_kernel const *const k = addb_bmap_kernel_select();
+  unsigned long long buf[ADDB_BMAP_AND_CHUNK];
+
+  if (!forward) end++;
+  if (end > a->bmap_bits) end = a->bmap_bits + 1;
+  if (end > b->bmap_bits) end = b->bmap_bits + 1;
+
+  while (start < end) {
+    unsigned long long tile_bit, s, e, cs, ce;
+    addb_tiled_reference ra, rb;
+    unsigned char *ta, *tb;
+    int err;
+
+    /*  Forward, we walk up from start; backward, down from end.
+     */
+    err = bmap_tile(a, forward ? start : end - 1, &tile_bit, &ta, &ra);
+    if (err == 0) {
+      err = bmap_tile(b, forward ? start : end - 1, &tile_bit, &tb, &rb);
+      if (err != 0) addb_tiled_free(a->bmap_tiled, &ra);
+    }
+    if (err != 0 && err != ADDB_ERR_NO) return err;
+
+    s = start + ADDB_BMAP_HEADER * 8 > tile_bit
+            ? start + ADDB_BMAP_HEADER * 8 - tile_bit
+            : 0;
+    e = end + ADDB_BMAP_HEADER * 8 - tile_bit;
+    if (e > ADDB_TILE_SIZE * 8) e = ADDB_TILE_SIZE * 8;
+
+    /*  A tile past the end of either file has nothing in it.
+     */
+    if (err == ADDB_ERR_NO) {
+      if (forward) break;
+      end = tile_bit + s - ADDB_BMAP_HEADER * 8;
+      continue;
+    }
+
+    /*  AND a chunk of words into buf, then scan that.
+     */
+    err = ADDB_ERR_NO;
+    if (forward) {
+      for (cs = s & ~63ull; err == ADDB_ERR_NO && cs < e;
+           cs += ADDB_BMAP_AND_CHUNK * 64) {
+        ce = cs + ADDB_BMAP_AND_CHUNK * 64;
+        if (ce > e) ce = e;
+
+        (*k->bk_and)((unsigned long long *)(void *)ta + cs / 64,
+                     (unsigned long long *)(void *)tb + cs / 64, buf,
+                     (ce - cs + 63) / 64);
+        err = bitscan(k, (unsigned char *)buf, (cs < s ? s : cs) - cs,
+                      ce - cs, true, result_out);
+        if (err == 0) *result_out += cs;
+      }
+    } else {
+      for (ce = e; err == ADDB_ERR_NO && ce > s; ce = cs) {
+        cs = ((ce + 63) & ~63ull) - ADDB_BMAP_AND_CHUNK * 64;
+        if ((ce + 63) / 64 <= ADDB_BMAP_AND_CHUNK || cs < (s & ~63ull))
+          cs = s & ~63ull;
+
+        (*k->bk_and)((unsigned long long *)(void *)ta + cs / 64,
+                     (unsigned long long *)(void *)tb + cs / 64, buf,
+                     (ce - cs + 63) / 64);
+        err = bitscan(k, (unsigned char *)buf, (cs < s ? s : cs) - cs,
+                      ce - cs, false, result_out);
+        if (err == 0) *result_out += cs;
+      }
+    }
+    addb_tiled_free(b->bmap_tiled, &rb);
+    addb_tiled_free(a->bmap_tiled, &ra);
+
+    if (err == 0) {
+      *result_out += tile_bit - ADDB_BMAP_HEADER * 8;
+      return 0;
+    }
+    if (err != ADDB_ERR_NO) return err;
+
+    if (forward)
+      start = tile_bit + e - ADDB_BMAP_HEADER * 8;
+    else
+      end = tile_bit + s - ADDB_BMAP_HEADER * 8;
+  }
+  return ADDB_ERR_NO;
+}
+
+/*  Ids tested against one tile at a time.
+ */
+#define ADDB_BMAP_TEST_BATCH 256
+
 int addb_bmap_fixed_intersect(addb_handle *addb, struct addb_bmap *bm,
                               addb_id const *id_in, size_t n_in,
                               addb_id *id_out, size_t *n_out, size_t m) {
-  addb_id *const id_out_start = id_out;
-  addb_id *const id_out_end = id_out + m;
-
-  for (*n_out = 0; n_in-- > 0; id_in++) {
-    /* This is initialized so blaze will compile
-     * in an optimizing fashion,
-     * the value _always_ set in addb_bmap_check, so
-     * don't worry about it.
-     */
-    bool val = false;
+  addb_bmap_kernel const *const k = addb_bmap_kernel_select();
+  addb_id buf[ADDB_BMAP_TEST_BATCH];
+  size_t i = 0;
+
+  *n_out = 0;
+  while (i < n_in) {
+    unsigned long long tile_bit, lo, hi;
+    addb_tiled_reference r;
+    unsigned char *tp;
+    addb_id *dst;
+    size_t j, n;
     int err;
 
-    if ((err = addb_bmap_check(bm, *id_in, &val)) != 0) return err;
+    /*  Bits past the end of the bitmap are unset.
+     */
+    if (id_in[i] > bm->bmap_bits) {
+      i++;
+      continue;
+    }
+
+    err = bmap_tile(bm, id_in[i], &tile_bit, &tp, &r);
+    if (err != 0 && err != ADDB_ERR_NO) return err;
+
+    /*  The run of ids starting at i that fall into this tile.
+     */
+    lo = tile_bit;
+    hi = tile_bit + ADDB_TILE_SIZE * 8;
+    for (j = i + 1; j < n_in && j - i < ADDB_BMAP_TEST_BATCH; j++)
+      if (id_in[j] + ADDB_BMAP_HEADER * 8 < lo ||
+          id_in[j] + ADDB_BMAP_HEADER * 8 >= hi || id_in[j] > bm->bmap_bits)
+        break;
+
+    if (err == ADDB_ERR_NO) {
+      i = j;
+      continue;
+    }
 
-    if (val) {
-      if (id_out >= id_out_end) {
-        *n_out = id_out - id_out_start;
+    /*  If there's room for all of them, write results
+     *  directly into id_out.
+     */
+    dst = m - *n_out >= j - i ? id_out + *n_out : buf;
+    n = (*k->bk_test)((unsigned long long const *)(void *)tp,
+                      tile_bit - ADDB_BMAP_HEADER * 8, id_in + i, j - i, dst);
+    addb_tiled_free(bm->bmap_tiled, &r);
+
+    if (dst == buf) {
+      if (n > m - *n_out) {
+        memcpy(id_out + *n_out, buf, (m - *n_out) * sizeof(*buf));
+        *n_out = m;
         return ADDB_ERR_MORE;
       }
-      *id_out++ = *id_in;
+      memcpy(id_out + *n_out, buf, n * sizeof(*buf));
     }
+    *n_out += n;
+    i = j;
   }
-  *n_out = id_out - id_out_start;
-
   return 0;
 }
@@ -64,10 +64,23 @@ int addb_bmap_check(addb_bmap *bmap, unsigned long long bit, bool *value);
 
 int addb_bmap_set(addb_bmap *bmap, unsigned long long bit);
 
+int addb_bmap_clear(addb_bmap *bmap, unsigned long long bit);
+
 int addb_bmap_scan(addb_bmap *bmap, unsigned long long start,
                    unsigned long long end, unsigned long long *result,
                    bool forward);
 
+int addb_bmap_count_range(addb_bmap *bmap, unsigned long long start,
+                          unsigned long long end, unsigned long long *n_out);
+
+int addb_bmap_intersect_count(addb_bmap *a, addb_bmap *b,
+                              unsigned long long start, unsigned long long end,
+                              unsigned long long *n_out);
+
+int addb_bmap_intersect_scan(addb_bmap *a, addb_bmap *b,
+                             unsigned long long start, unsigned long long end,
+                             unsigned long long *result_out, bool forward);
+
 int addb_bmap_close(addb_bmap *bmap);
 int addb_bmap_truncate(addb_bmap *bmap);
 int addb_bmap_status(addb_bmap *bmap, cm_prefix const *prefix,
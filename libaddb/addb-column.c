@@ -0,0 +1,315 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libaddb/addb-column.h"
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*  Initial map size of a new column file: room for a million
+ *  32-byte records.
+ */
+#define ADDB_COLUMN_INIT_MAP (32ull * 1024 * 1024)
+
+#define ADDB_COLUMN_OFFSET(col, id) \
+  (ADDB_COLUMN_HEADER + (unsigned long long)(id) * (col)->col_size)
+
+/* Open a column, creating it if need be.
+ *
+ * The record size must be a power of two no larger than
+ * ADDB_COLUMN_RECORD_MAX.  If the column already exists, it
+ * must have been created with the same record size.
+ */
+int addb_column_open(addb_handle *addb, const char *path, size_t size,
+                     unsigned long long horizon, addb_column **out) {
+  addb_column *col;
+  addb_tiled_reference r;
+  unsigned char *p;
+  int err = 0;
+
+  cl_assert(addb->addb_cl, size > 0 && size <= ADDB_COLUMN_RECORD_MAX);
+  cl_assert(addb->addb_cl, (size & (size - 1)) == 0);
+
+  cl_log(addb->addb_cl, CL_LEVEL_DEBUG, "addb_column_open: open %s. size: %zu",
+         path, size);
+
+  col = cm_malloc(addb->addb_cm, sizeof(addb_column));
+  if (!col) return ENOMEM;
+
+  col->col_addb = addb;
+  col->col_cl = addb->addb_cl;
+  col->col_cm = addb->addb_cm;
+  col->col_size = size;
+  col->col_horizon = horizon;
+
+  col->col_path = cm_strmalcpy(addb->addb_cm, path);
+  if (col->col_path == NULL) {
+    err = errno ? errno : ENOMEM;
+    goto free_col;
+  }
+
+  col->col_tiled =
+      addb_tiled_create(addb->addb_master_tiled_pool, col->col_path, O_RDWR,
+                        ADDB_COLUMN_INIT_MAP);
+  if (!col->col_tiled) {
+    err = errno;
+    cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "addb_tiled_create", err,
+                 "Can't open %s", col->col_path);
+    goto free_path;
+  }
+
+  /*  A new (empty) file gets its header now.
+   */
+  if (addb_tiled_physical_file_size(col->col_tiled) == 0) {
+    cl_log(addb->addb_cl, CL_LEVEL_DEBUG,
+           "file %s did not exist. Creating and initializing", col->col_path);
+
+    p = addb_tiled_alloc(col->col_tiled, 0, ADDB_COLUMN_HEADER, &r);
+    if (!p) {
+      err = errno;
+      goto free_tiled;
+    }
+    memcpy(p + ADDB_COLUMN_MAGIC_OFFSET, ADDB_COLUMN_MAGIC,
+           ADDB_COLUMN_MAGIC_LEN);
+    ADDB_PUT_U4(p + ADDB_COLUMN_SIZE_OFFSET, size);
+    addb_tiled_free(col->col_tiled, &r);
+  }
+
+  /*
+   * Check the header and that the record size matches
+   */
+  p = addb_tiled_get(col->col_tiled, 0, ADDB_COLUMN_HEADER, ADDB_MODE_READ,
+                     &r);
+  if (!p) {
+    err = errno;
+    cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "addb_tiled_get", err,
+                 "Can't get first tile of column: %s", col->col_path);
+    goto free_tiled;
+  }
+
+  if (memcmp(p + ADDB_COLUMN_MAGIC_OFFSET, ADDB_COLUMN_MAGIC,
+             ADDB_COLUMN_MAGIC_LEN)) {
+    err = EINVAL;
+    cl_log(addb->addb_cl, CL_LEVEL_ERROR,
+           "Column magic for %s is %c%c%c%c. Should be %s.", col->col_path,
+           p[0], p[1], p[2], p[3], ADDB_COLUMN_MAGIC);
+    goto free_tile;
+  }
+  if (ADDB_GET_U4(p + ADDB_COLUMN_SIZE_OFFSET) != size) {
+    err = EINVAL;
+    cl_log(addb->addb_cl, CL_LEVEL_ERROR,
+           "Column %s has %lu-byte records; expected %zu.", col->col_path,
+           (unsigned long)ADDB_GET_U4(p + ADDB_COLUMN_SIZE_OFFSET), size);
+    goto free_tile;
+  }
+  addb_tiled_free(col->col_tiled, &r);
+
+  *out = col;
+  cl_log(addb->addb_cl, CL_LEVEL_DEBUG, "Successfully initialized column: %s",
+         col->col_path);
+  return 0;
+
+free_tile:
+  addb_tiled_free(col->col_tiled, &r);
+
+free_tiled : {
+  int othererror;
+
+  othererror = addb_tiled_destroy(col->col_tiled);
+  if (othererror)
+    cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "addb_tiled_destroy",
+                 othererror, "can't destroy tile for %s", col->col_path);
+}
+
+free_path:
+  cm_free(addb->addb_cm, col->col_path);
+
+free_col:
+  cm_free(addb->addb_cm, col);
+
+  return err;
+}
+
+/*
+ * File may have changed on disk. Refresh as needbe.
+ */
+int addb_column_refresh(addb_column *col, unsigned long long max_id) {
+  int err;
+
+  err = addb_tiled_stretch(col->col_tiled);
+  if (err)
+    cl_log_errno(col->col_cl, CL_LEVEL_ERROR, "addb_tiled_stretch", err,
+                 "Unable to stretch tile for column %s", col->col_path);
+  return err;
+}
+
+static void addb_column_free(addb_column *col) {
+  cm_free(col->col_cm, col->col_path);
+  cm_free(col->col_cm, col);
+}
+
+int addb_column_close(addb_column *col) {
+  int err;
+
+  if (!col) return 0;
+
+  cl_log(col->col_cl, CL_LEVEL_DEBUG, "Closing column: %s", col->col_path);
+
+  err = addb_tiled_destroy(col->col_tiled);
+  if (err) {
+    cl_log_errno(col->col_cl, CL_LEVEL_FAIL, "addb_tiled_destroy", err,
+                 "Cannot destroy tile for %s", col->col_path);
+    return err;
+  }
+
+  addb_column_free(col);
+  return 0;
+}
+
+/*
+ * Close and delete a column.
+ */
+int addb_column_truncate(addb_column *col) {
+  int err;
+
+  err = addb_tiled_destroy(col->col_tiled);
+  if (err) {
+    cl_log_errno(col->col_cl, CL_LEVEL_ERROR, "addb_tiled_destroy", err,
+                 "Can't get rid of tiles for %s", col->col_path);
+    return err;
+  }
+
+  if (unlink(col->col_path)) {
+    err = errno;
+    cl_log_errno(col->col_cl, CL_LEVEL_ERROR, "unlink", err,
+                 "addb_column_truncate: cannot unlink %s", col->col_path);
+    return err;
+  }
+
+  addb_column_free(col);
+  return 0;
+}
+
+int addb_column_status(addb_column *col, cm_prefix const *prefix,
+                       addb_status_callback *callback, void *cb_data) {
+  cm_prefix col_pre;
+  char data[100];
+
+  if (!col) return 0;
+
+  col_pre = cm_prefix_pushf(prefix, "column:%s", col->col_path);
+
+  snprintf(data, sizeof data, "%zu", col->col_size);
+  return (*callback)(cb_data, cm_prefix_end(&col_pre, "record-size"), data);
+}
+
+int addb_column_status_tiles(addb_column *col, cm_prefix const *prefix,
+                             addb_status_callback *callback, void *cb_data) {
+  cm_prefix col_pre;
+
+  if (!col) return 0;
+
+  col_pre = cm_prefix_pushf(prefix, "column:%s", col->col_path);
+  return addb_tiled_status_tiles(col->col_tiled, &col_pre, callback, cb_data);
+}
+
+unsigned long long addb_column_horizon(addb_column *col) {
+  return col->col_horizon;
+}
+
+void addb_column_horizon_set(addb_column *col, unsigned long long h) {
+  col->col_horizon = h;
+}
+
+/*  Records above the horizon are simply written again when their
+ *  ids are re-indexed after a rollback, so there is no backup;
+ *  a checkpoint just flushes what has been written.
+ */
+int addb_column_checkpoint_start_writes(addb_column *col, bool hard_sync,
+                                        bool block) {
+  return addb_tiled_checkpoint_linear_start(col->col_tiled, hard_sync, block);
+}
+
+int addb_column_checkpoint_finish_writes(addb_column *col, bool hard_sync,
+                                         bool block) {
+  return addb_tiled_checkpoint_linear_finish(col->col_tiled, hard_sync, block);
+}
+
+/**
+ * @brief Read a single record from a column.
+ *
+ * @param col	the column
+ * @param id	the index of the record
+ * @param buf	out: col_size bytes of record.
+ *
+ * @return 0 on success,
+ * @return ADDB_ERR_NO if the record is past the end of the file,
+ * @return a nonzero error code on error.
+ */
+int addb_column_read(addb_column *col, unsigned long long id, void *buf) {
+  unsigned long long const offset = ADDB_COLUMN_OFFSET(col, id);
+  addb_tiled_reference r;
+  unsigned char const *p;
+  int err;
+
+  if ((p = addb_tiled_peek(col->col_tiled, offset, col->col_size)) != NULL) {
+    memcpy(buf, p, col->col_size);
+    return 0;
+  }
+
+  p = addb_tiled_get(col->col_tiled, offset, offset + col->col_size,
+                     ADDB_MODE_READ, &r);
+  if (!p) {
+    err = errno;
+
+    /*  Past the end of the file: never written.
+     */
+    if (err == E2BIG) return ADDB_ERR_NO;
+
+    cl_log_errno(col->col_cl, CL_LEVEL_ERROR, "addb_tiled_get", err,
+                 "%s: can't read record %llx", col->col_path, id);
+    return err;
+  }
+  memcpy(buf, p, col->col_size);
+  addb_tiled_free(col->col_tiled, &r);
+
+  return 0;
+}
+
+/**
+ * @brief Write a single record to a column.
+ *
+ * @param col	the column
+ * @param id	the index of the record
+ * @param buf	col_size bytes of record.
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_column_write(addb_column *col, unsigned long long id,
+                      void const *buf) {
+  unsigned long long const offset = ADDB_COLUMN_OFFSET(col, id);
+  addb_tiled_reference r;
+  unsigned char *p;
+
+  p = addb_tiled_alloc(col->col_tiled, offset, offset + col->col_size, &r);
+  if (!p) return errno ? errno : ENOMEM;
+
+  memcpy(p, buf, col->col_size);
+  addb_tiled_free(col->col_tiled, &r);
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ADDB_COLUMN_H
+#define ADDB_COLUMN_H
+
+#include "libaddb/addb.h"
+
+#include "libcm/cm.h"
+
+/*  A column is a file of fixed-size records, indexed by id.
+ *
+ *  Records are written once, when the id they belong to is
+ *  allocated, and only ever appended to; the file is checkpointed
+ *  like the istore, without backups.  Records that have never
+ *  been written read as zeros.
+ */
+#define ADDB_COLUMN_MAGIC "acv1"
+
+#define ADDB_COLUMN_MAGIC_OFFSET 0
+#define ADDB_COLUMN_MAGIC_LEN 4
+#define ADDB_COLUMN_SIZE_OFFSET 4
+#define ADDB_COLUMN_SIZE_LEN 4
+
+/*  The header is as large as the largest record, so that no
+ *  record (whose size must be a power of two) crosses a tile.
+ */
+#define ADDB_COLUMN_HEADER 64
+#define ADDB_COLUMN_RECORD_MAX ADDB_COLUMN_HEADER
+
+struct addb_column {
+  /* The addb handle we are part of */
+  struct addb_handle *col_addb;
+
+  cl_handle *col_cl;
+  cm_handle *col_cm;
+
+  /* The path to the column file */
+  char *col_path;
+
+  /* The tiled accessor to the file */
+  addb_tiled *col_tiled;
+
+  /* Size of a single record, in bytes */
+  size_t col_size;
+
+  /* What is our horizon */
+  unsigned long long col_horizon;
+};
+
+int addb_column_open(addb_handle *addb, const char *path, size_t size,
+                     unsigned long long horizon, addb_column **out);
+
+int addb_column_read(addb_column *col, unsigned long long id, void *buf);
+
+int addb_column_write(addb_column *col, unsigned long long id,
+                      void const *buf);
+
+int addb_column_close(addb_column *col);
+int addb_column_truncate(addb_column *col);
+int addb_column_status(addb_column *col, cm_prefix const *prefix,
+                       addb_status_callback *callback, void *cb_data);
+
+int addb_column_status_tiles(addb_column *col, cm_prefix const *prefix,
+                             addb_status_callback *callback, void *cb_data);
+unsigned long long addb_column_horizon(addb_column *col);
+void addb_column_horizon_set(addb_column *col, unsigned long long h);
+
+int addb_column_checkpoint_start_writes(addb_column *col, bool hard_sync,
+                                        bool block);
+
+int addb_column_checkpoint_finish_writes(addb_column *col, bool hard_sync,
+                                         bool block);
+
+int addb_column_refresh(addb_column *col, unsigned long long max);
+#endif
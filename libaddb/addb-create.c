@@ -38,6 +38,7 @@ addb_handle* addb_create(cm_handle* cm, cl_handle* cl,
   addb->addb_bytes_locked = -1; /* no memory locking */
   addb->addb_mlock_max = 0;
   addb->addb_transactional = transactional;
+  addb->addb_parallel_min = ADDB_IDARRAY_PARALLEL_MIN;
 
   addb->addb_master_tiled_pool = addb_tiled_pool_create(addb);
   if (addb->addb_master_tiled_pool == NULL) {
@@ -55,3 +56,38 @@ addb_handle* addb_create(cm_handle* cm, cl_handle* cl,
 
   return addb;
 }
+
+/**
+ * @brief Set how far ahead of their cursor iterators read.
+ *
+ *  Iterators over large gmap arrays and over the primitive
+ *  store ask the kernel to read this many bytes ahead of
+ *  where they are, so that they don't stop on a page fault
+ *  at every new page.
+ *
+ * @param addb	opaque module handle
+ * @param bytes	distance in bytes; 0 turns read-ahead off.
+ */
+void addb_set_prefetch(addb_handle* addb, unsigned long long bytes) {
+  addb->addb_prefetch = bytes;
+}
+
+/**
+ * @brief Checkpoint with redo logs rather than backup files.
+ *
+ *  By default, a checkpoint saves the old contents of the pages
+ *  it is about to overwrite into a backup file, then writes and
+ *  syncs the pages in place.  With a redo log, it appends the new
+ *  contents of the pages to a log and syncs only that; the pages
+ *  are copied into the mapped file afterwards and left to the
+ *  kernel to write back.  Once a log has grown past <bytes>, the
+ *  file is synced and the log removed.
+ *
+ *  This must be set before any tables are opened.
+ *
+ * @param addb	opaque module handle
+ * @param bytes	log size at which to retire it; 0 turns redo logs off.
+ */
+void addb_set_redo_log(addb_handle* addb, unsigned long long bytes) {
+  addb->addb_redo_log = bytes;
+}
@@ -28,7 +28,9 @@ limitations under the License.
 void addb_destroy(addb_handle* addb) {
   if (addb != NULL) {
     cl_cover(addb->addb_cl);
+    addb_worker_finish(addb);
     addb_tiled_pool_destroy(addb->addb_master_tiled_pool);
+    addb_writeback_finish(addb);
     cm_free(addb->addb_cm, addb);
   }
 }
@@ -15,6 +15,7 @@ limitations under the License.
 #include "libaddb/addb-gmap.h"
 #include "libaddb/addb.h"
 #include "libaddb/addb-largefile-file.h"
+#include "libaddb/addbp.h"
 
 #include <errno.h>
 #include <stdio.h>
@@ -121,6 +122,41 @@ int addb_gmap_accessor_clear(addb_gmap_accessor* ac) {
   return 0;
 }
 
+/**
+ * @brief Start reading part of an array into memory.
+ *
+ * @param ac 	the accessor to read through
+ * @param s 	first byte, counting from the start of the array
+ * @param n 	number of bytes
+ * @param stalled	the caller has already caught up with
+ *			its last read-ahead; count that.
+ */
+void addb_gmap_accessor_prefetch(addb_gmap_accessor const* ac,
+                                 unsigned long long s, unsigned long long n,
+                                 bool stalled) {
+  addb_tiled* td;
+
+  s += ac->gac_offset;
+  if (ac->gac_lf != NULL) {
+    unsigned long long const pack_end = addb_largefile_pack_end(ac->gac_lf);
+
+    /*  Packed ids are in memory already.
+     */
+    if (s + n <= pack_end || (td = ac->gac_lf->lf_td) == NULL) return;
+    if (s < pack_end) {
+      n -= pack_end - s;
+      s = pack_end;
+    }
+  } else if (ac->gac_bgmap != NULL || ac->gac_part == NULL ||
+             ac->gac_length <= 1)
+    return;
+  else
+    td = ac->gac_part->part_td;
+
+  if (stalled) addb_tiled_prefetch_stall(td);
+  (void)addb_tiled_prefetch(td, s, n);
+}
+
 const char* addb_gmap_accessor_display_name_i(addb_gmap_accessor const* ac) {
   char* dn;
 
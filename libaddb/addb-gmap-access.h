@@ -57,6 +57,10 @@ int addb_gmap_accessor_set(struct addb_gmap *gm, addb_gmap_id id,
 
 int addb_gmap_accessor_clear(addb_gmap_accessor *ac);
 
+void addb_gmap_accessor_prefetch(addb_gmap_accessor const *ac,
+                                 unsigned long long s, unsigned long long n,
+                                 bool stalled);
+
 const char *addb_gmap_accessor_display_name_i(addb_gmap_accessor const *ac);
 
 #endif
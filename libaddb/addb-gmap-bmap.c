@@ -120,16 +120,17 @@ addb_bgmap_handle *addb_bgmap_create(addb_handle *addb, const char *gpath) {
   return r;
 }
 
+/*
+ * How many of the ids from low (included) to high (excluded) are
+ * in the bgmap for source?  The name is historical; this used to
+ * sample the bitmap at random, but counting is exact and cheap.
+ */
 int addb_bgmap_estimate(addb_gmap *gm, addb_gmap_id source, addb_gmap_id low,
                         addb_gmap_id high, unsigned long long *result) {
-  const unsigned long long tries = 500;
-  unsigned long long range = high - low;
-  int i;
-  unsigned long long count = 0;
   int err;
   addb_bgmap *bg;
 
-  if (range == 0) {
+  if (high <= low) {
     *result = 0;
     return 0;
   }
@@ -140,23 +141,7 @@ int addb_bgmap_estimate(addb_gmap *gm, addb_gmap_id source, addb_gmap_id low,
                  "Can't find bgmap for %llu", (unsigned long long)source);
     return err;
   }
-
-  for (i = 0; i < tries; i++) {
-    unsigned long long p = random() % range + low;
-    bool b;
-    err = addb_bgmap_check(gm, bg, p, &b);
-    if (err == 0) {
-      count += b;
-    } else {
-      cl_log_errno(gm->gm_addb->addb_cl, CL_LEVEL_FAIL, "addb_bgmap_check", err,
-                   "Can't check bgmap %llu at id %llu",
-                   (unsigned long long)source, p);
-      return err;
-    }
-  }
-
-  *result = count * (high - low) / tries;
-  return 0;
+  return addb_bgmap_count_range(gm, bg, low, high, result);
 }
 
 int addb_bgmap_refresh(addb_gmap *gm, unsigned long long max) {
@@ -278,6 +263,43 @@ int addb_bgmap_check(addb_gmap *gm, addb_bgmap *bg, addb_gmap_id s, bool *out) {
   return 0;
 }
 
+/*
+ * Count the ids from low (included) to high (excluded) in a bgmap.
+ */
+int addb_bgmap_count_range(addb_gmap *gm, addb_bgmap *bg, addb_gmap_id low,
+                           addb_gmap_id high, unsigned long long *n_out) {
+  int err;
+
+  err = addb_bmap_count_range(bg->bgm_bmap, low, high, n_out);
+  if (err) {
+    cl_log_errno(gm->gm_addb->addb_cl, CL_LEVEL_ERROR, "addb_bmap_count_range",
+                 err, "Can't count bits in %s from %llu to %llu", bg->bgm_name,
+                 (unsigned long long)low, (unsigned long long)high);
+    return err;
+  }
+  return 0;
+}
+
+/*
+ * Count the ids from low (included) to high (excluded) in a bgmap
+ * that are also set in <mask>.
+ */
+int addb_bgmap_count_masked(addb_gmap *gm, addb_bgmap *bg, addb_bmap *mask,
+                            addb_gmap_id low, addb_gmap_id high,
+                            unsigned long long *n_out) {
+  int err;
+
+  err = addb_bmap_intersect_count(bg->bgm_bmap, mask, low, high, n_out);
+  if (err) {
+    cl_log_errno(gm->gm_addb->addb_cl, CL_LEVEL_ERROR,
+                 "addb_bmap_intersect_count", err,
+                 "Can't count bits in %s from %llu to %llu", bg->bgm_name,
+                 (unsigned long long)low, (unsigned long long)high);
+    return err;
+  }
+  return 0;
+}
+
 /*
  * Scan a bgmap for the next ID set. Start is should be the first ID to check.
  * The function returns ADDB_ERR_NO when we reach the end.
@@ -290,8 +312,9 @@ int addb_bgmap_check(addb_gmap *gm, addb_bgmap *bg, addb_gmap_id s, bool *out) {
  */
 
 static int addb_bgmap_next_fast(addb_gmap *gm, addb_bgmap *bg,
-                                addb_gmap_id *start, addb_gmap_id low,
-                                addb_gmap_id high, bool direction) {
+                                addb_bmap *mask, addb_gmap_id *start,
+                                addb_gmap_id low, addb_gmap_id high,
+                                bool direction) {
   int err;
   unsigned long scan_at_once = 1000000;
 
@@ -317,9 +340,12 @@ static int addb_bgmap_next_fast(addb_gmap *gm, addb_bgmap *bg,
 
   /*
    * Scan from s to e and find the first bit that is set
-   * (not including e)
+   * (not including e) -- in the mask, too, if we have one.
    */
-  err = addb_bmap_scan(bg->bgm_bmap, s, e, &res, direction);
+  if (mask != NULL)
+    err = addb_bmap_intersect_scan(bg->bgm_bmap, mask, s, e, &res, direction);
+  else
+    err = addb_bmap_scan(bg->bgm_bmap, s, e, &res, direction);
   if (err == ADDB_ERR_NO) {
     if (direction) {
       if (e >= high) return ADDB_ERR_NO;
@@ -347,6 +373,16 @@ static int addb_bgmap_next_fast(addb_gmap *gm, addb_bgmap *bg,
 
 int addb_bgmap_next(addb_gmap *gm, addb_bgmap *bg, addb_gmap_id *start,
                     addb_gmap_id low, addb_gmap_id high, bool forward) {
+  return addb_bgmap_next_masked(gm, bg, NULL, start, low, high, forward);
+}
+
+/*
+ * Like addb_bgmap_next, but only return ids that are also set
+ * in <mask>, if it isn't NULL.
+ */
+int addb_bgmap_next_masked(addb_gmap *gm, addb_bgmap *bg, addb_bmap *mask,
+                           addb_gmap_id *start, addb_gmap_id low,
+                           addb_gmap_id high, bool forward) {
   int err;
 
   /*
@@ -354,7 +390,7 @@ int addb_bgmap_next(addb_gmap *gm, addb_bgmap *bg, addb_gmap_id *start,
    */
   if (*start == high) return ADDB_ERR_NO;
 
-  err = addb_bgmap_next_fast(gm, bg, start, low, high, forward);
+  err = addb_bgmap_next_fast(gm, bg, mask, start, low, high, forward);
 
   /*
    *  Note that err==0 means that *start-1 is set.  (Or +1, if backwards)
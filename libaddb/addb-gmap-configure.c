@@ -39,6 +39,7 @@ void addb_gmap_configure(addb_gmap* gm, addb_gmap_configuration* gcf) {
   }
 
   addb_largefile_set_maxlf(gm->gm_lfhandle, gcf->gcf_max_lf);
+  addb_largefile_set_pack(gm->gm_lfhandle, gcf->gcf_pack);
   gm->gm_bitmap = gcf->gcf_allow_bgmaps;
   if (!gm->gm_bitmap) {
     cl_log(gm->gm_addb->addb_cl, CL_LEVEL_INFO,
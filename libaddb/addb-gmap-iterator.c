@@ -82,6 +82,7 @@ int addb_gmap_iterator_set_position(addb_gmap* gm, addb_gmap_id source,
   cl_assert(cl, pos != NULL);
   if (!addb_gmap_accessor_is_set(&iter->iter_ac)) {
     iter->iter_i = 0;
+    iter->iter_prefetch = 0;
     iter->iter_n = 0;
 
     err = addb_gmap_accessor_set(gm, source, &iter->iter_ac);
@@ -151,6 +152,30 @@ void addb_gmap_iterator_unget(addb_gmap* gm, addb_gmap_id source,
  * @return 0 on success, otherwise a nonzero error code.
  * @return ADDB_ERR_NO if we've hit the end of the id list.
  */
+/*  Keep read-ahead addb_prefetch bytes in front of the cursor.
+ *  We top it up once the cursor has used half of it.
+ */
+static void addb_gmap_iterator_prefetch(addb_gmap* gm,
+                                        addb_gmap_iterator* iter) {
+  unsigned long long const dist =
+      gm->gm_addb->addb_prefetch / ADDB_GMAP_ENTRY_SIZE;
+  unsigned long long s, e;
+
+  if (dist == 0 || iter->iter_n * ADDB_GMAP_ENTRY_SIZE < ADDB_PREFETCH_MIN ||
+      iter->iter_i + dist / 2 < iter->iter_prefetch)
+    return;
+
+  s = iter->iter_i > iter->iter_prefetch ? iter->iter_i : iter->iter_prefetch;
+  e = iter->iter_i + dist < iter->iter_n ? iter->iter_i + dist : iter->iter_n;
+  if (s >= e) return;
+
+  addb_gmap_accessor_prefetch(
+      &iter->iter_ac,
+      (iter->iter_forward ? s : iter->iter_n - e) * ADDB_GMAP_ENTRY_SIZE,
+      (e - s) * ADDB_GMAP_ENTRY_SIZE, iter->iter_i >= iter->iter_prefetch);
+  iter->iter_prefetch = e;
+}
+
 int addb_gmap_iterator_next_loc(addb_gmap* gm, addb_gmap_id source,
                                 addb_gmap_iterator* iter, addb_gmap_id* out,
                                 char const* file, int line) {
@@ -165,6 +190,7 @@ int addb_gmap_iterator_next_loc(addb_gmap* gm, addb_gmap_id source,
     unsigned long long n;
 
     iter->iter_i = 0;
+    iter->iter_prefetch = 0;
 
     err = addb_gmap_accessor_set(gm, source, &(iter->iter_ac));
     if (err) return err;
@@ -191,6 +217,7 @@ int addb_gmap_iterator_next_loc(addb_gmap* gm, addb_gmap_id source,
   }
 
   cl_cover(gm->gm_addb->addb_cl);
+  addb_gmap_iterator_prefetch(gm, iter);
 
   i = iter->iter_i++;
   if (!iter->iter_forward) i = iter->iter_n - (i + 1);
@@ -265,6 +292,7 @@ int addb_gmap_iterator_find_loc(addb_gmap* gm, addb_gmap_id source,
     unsigned long long n;
 
     iter->iter_i = 0;
+    iter->iter_prefetch = 0;
 
     err = addb_gmap_accessor_set(gm, source, &(iter->iter_ac));
     if (err) return err;
@@ -295,7 +323,27 @@ int addb_gmap_iterator_find_loc(addb_gmap* gm, addb_gmap_id source,
     return ADDB_ERR_NO;
   }
 
-  if (iter->iter_forward) {
+  if (iter->iter_forward && iter->iter_ac.gac_lf != NULL &&
+      iter->iter_ac.gac_lf->lf_pack != NULL) {
+    addb_id id;
+
+    /*  Search the packed prefix via its skip table
+     *  rather than one id at a time.
+     */
+    err = addb_largefile_search(iter->iter_ac.gac_lf, 0, nelem, *id_in_out,
+                                &found, &id);
+    if (err != 0) {
+      iter->iter_i = iter->iter_n;
+      return err;
+    }
+    if (found >= nelem) return ADDB_ERR_NO;
+
+    *changed_out = (id != *id_in_out);
+    *id_in_out = id;
+    iter->iter_i = found + 1;
+
+    return 0;
+  } else if (iter->iter_forward) {
     do {
       middle = nelem / 2;
       found = base + middle;
@@ -427,6 +475,7 @@ int addb_gmap_iterator_n(addb_gmap* gm, addb_gmap_id source,
 
   if (!addb_gmap_accessor_is_set(&iter->iter_ac)) {
     iter->iter_i = 0;
+    iter->iter_prefetch = 0;
 
     err = addb_gmap_accessor_set(gm, source, &iter->iter_ac);
     if (err != 0) return err;
@@ -462,6 +511,7 @@ void addb_gmap_iterator_initialize(addb_gmap_iterator* iter) {
   addb_gmap_accessor_clear(&iter->iter_ac);
   iter->iter_n = 0;
   iter->iter_i = 0;
+  iter->iter_prefetch = 0;
   iter->iter_forward = true;
 }
 
@@ -509,6 +559,7 @@ int addb_gmap_iterator_set_offset(addb_gmap* gm, addb_gmap_id source,
 
       addb_gmap_accessor_clear(&(iter->iter_ac));
       iter->iter_i = 0;
+      iter->iter_prefetch = 0;
       iter->iter_n = 0;
 
       return 0;
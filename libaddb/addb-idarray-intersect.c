@@ -13,6 +13,7 @@ limitations under the License.
 #include "libaddb/addbp.h"
 
 #include <errno.h>
+#include <string.h>
 
 /*  Recursive intersect for relatively small sets.
  *
@@ -23,20 +24,21 @@ limitations under the License.
  * @return ADDB_ERR_MORE	more results than we have
  *				space for.
  */
-int addb_idarray_intersect(addb_handle *addb,
+static int idarray_intersect_recursive(addb_handle *addb,
 
-                           addb_idarray *a, unsigned long long a_s,
-                           unsigned long long a_e,
+                                       addb_idarray *a, unsigned long long a_s,
+                                       unsigned long long a_e,
 
-                           addb_idarray *b, unsigned long long b_s,
-                           unsigned long long b_e,
+                                       addb_idarray *b, unsigned long long b_s,
+                                       unsigned long long b_e,
 
-                           addb_id *id_inout, size_t *n_inout, size_t m) {
+                                       addb_id *id_inout, size_t *n_inout,
+                                       size_t m) {
   int err;
   cl_handle *cl = addb->addb_cl;
 
   cl_log(cl, CL_LEVEL_VERBOSE,
-         "addb_idarray_intersect "
+         "idarray_intersect_recursive "
          "%p, %llu..%llu vs. %p, %llu...%llu",
          (void *)a, a_s, a_e - 1, (void *)b, b_s, b_e - 1);
 
@@ -94,10 +96,10 @@ int addb_idarray_intersect(addb_handle *addb,
     /*  Recursion: (1) The entries before a_off.
      */
     if (a_off > a_s) {
-      err = addb_idarray_intersect(addb, a, a_s, a_off, b, b_s, b_off, id_inout,
-                                   n_inout, m);
+      err = idarray_intersect_recursive(addb, a, a_s, a_off, b, b_s, b_off,
+                                        id_inout, n_inout, m);
       if (err != 0) {
-        cl_log_errno(cl, CL_LEVEL_FAIL, "addb_idarray_intersect", err,
+        cl_log_errno(cl, CL_LEVEL_FAIL, "idarray_intersect_recursive", err,
                      "%p %llu..%llu and %p %llu..%llu", (void *)a, a_s, a_e,
                      (void *)b, b_s, b_e);
         return err;
@@ -108,7 +110,7 @@ int addb_idarray_intersect(addb_handle *addb,
      */
     if (b_off < b_e && b_id == a_id) {
       cl_log(cl, CL_LEVEL_VERBOSE,
-             "addb_idarray_intersect "
+             "idarray_intersect_recursive "
              "found %llu at a=%llu, b=%llu",
              (unsigned long long)a_id, a_off, b_off);
 
@@ -118,7 +120,7 @@ int addb_idarray_intersect(addb_handle *addb,
       b_off++;
     } else
       cl_log(cl, CL_LEVEL_VERBOSE,
-             "addb_idarray_intersect: "
+             "idarray_intersect_recursive: "
              "middle for a_id %llu is a=%llu, b=%llu",
              (unsigned long long)a_id, a_off, b_off);
 
@@ -130,40 +132,28 @@ int addb_idarray_intersect(addb_handle *addb,
   return 0;
 }
 
-/**
- * @brief Intersect between an idarray and a fixed set of ids.
+/*  Recursive intersect between an idarray and a fixed set of ids.
  *
  *  The first set is an idarray and start/end boundaries.
  *  The second set is a fixed set of ids with start and end point.
  *  The boundaries change through the course of the recursion.
  *
- * @param addb 		opaque addb module handle
- *
- * @param a		one idarray
- * @param a_s		start index
- * @param a_e		end index
- *
- * @param b_base	a fixed set of indices
- * @param b_n		number of indices pointed to by b_base.
- *
- * @param id_out	out: elements shared by a and b.
- * @param n_out		out: number of occupied slots in id_out.
- * @param m		maximum number of slots available.
- *
  * @return ADDB_ERR_MORE	ran out of slots
  */
-int addb_idarray_fixed_intersect(addb_handle *addb,
+static int idarray_fixed_intersect_recursive(addb_handle *addb,
 
-                                 addb_idarray *a, unsigned long long a_s,
-                                 unsigned long long a_e,
+                                             addb_idarray *a,
+                                             unsigned long long a_s,
+                                             unsigned long long a_e,
 
-                                 addb_id *b_base, size_t b_n,
+                                             addb_id *b_base, size_t b_n,
 
-                                 addb_id *id_out, size_t *n_out, size_t m) {
+                                             addb_id *id_out, size_t *n_out,
+                                             size_t m) {
   int err;
 
   cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
-         "addb_idarray_fixed_intersect "
+         "idarray_fixed_intersect_recursive "
          "%p, %llu..%llu vs. fixed[%llu]",
          (void *)a, a_s, a_e - 1, (unsigned long long)b_n);
 
@@ -202,11 +192,11 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
       /*  Recursion: (1) The entries before b_off.
        */
       if (b_off > 0) {
-        err = addb_idarray_fixed_intersect(addb, a, a_s, a_off, b_base, b_off,
-                                           id_out, n_out, m);
+        err = idarray_fixed_intersect_recursive(addb, a, a_s, a_off, b_base,
+                                                b_off, id_out, n_out, m);
         if (err != 0) {
           cl_log_errno(addb->addb_cl, CL_LEVEL_FAIL,
-                       "addb_idarray_fixed_intersect", err,
+                       "idarray_fixed_intersect_recursive", err,
                        "fixed[..%llu] and %p %llu..%llu",
                        (unsigned long long)b_off, (void *)a, a_s, a_e);
           return err;
@@ -217,7 +207,7 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
        */
       if (a_id == b_id && a_off < a_e) {
         cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
-               "addb_idarray_fixed_intersect "
+               "idarray_fixed_intersect_recursive "
                "found %llu at a=%llu, b=%llu",
                (unsigned long long)b_id, a_off, b_off);
 
@@ -227,7 +217,7 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
         a_off++;
       } else
         cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
-               "addb_idarray_fixed_intersect: "
+               "idarray_fixed_intersect_recursive: "
                "middle for b_id %llu is a=%llu/b=%llu",
                (unsigned long long)b_id, a_off, b_off);
 
@@ -296,11 +286,12 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
         cl_assert(addb->addb_cl, b_base[b_off - 1] < b_id);
         cl_assert(addb->addb_cl, b_off == b_n || b_base[b_off] >= b_id);
 
-        err = addb_idarray_fixed_intersect(addb, a, a_s, a_off, b_base, b_off,
-                                           id_out, n_out, m);
+        err = idarray_fixed_intersect_recursive(addb, a, a_s, a_off, b_base,
+                                                b_off, id_out, n_out, m);
         if (err != 0) {
           cl_log_errno(
-              addb->addb_cl, CL_LEVEL_FAIL, "addb_idarray_fixed_intersect", err,
+              addb->addb_cl, CL_LEVEL_FAIL, "idarray_fixed_intersect_recursive",
+              err,
               "%p %llu..%llu and fixed[%zd]", (void *)a, a_s, a_e, b_n);
           return err;
         }
@@ -311,7 +302,7 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
       if (b_off < b_n && b_id == a_id) {
         cl_assert(addb->addb_cl, b_base[b_off] == b_id);
         cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
-               "addb_idarray_fixed_intersect "
+               "idarray_fixed_intersect_recursive "
                "found %llu at a=%llu, b=%llu",
                (unsigned long long)a_id, a_off, b_off);
 
@@ -321,7 +312,7 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
       } else {
         cl_assert(addb->addb_cl, b_off == b_n || b_base[b_off] > a_id);
         cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
-               "addb_idarray_fixed_intersect: "
+               "idarray_fixed_intersect_recursive: "
                "middle for a_id %llu is a=%llu, "
                "b=%llu",
                (unsigned long long)a_id, a_off, b_off);
@@ -337,3 +328,596 @@ int addb_idarray_fixed_intersect(addb_handle *addb,
   }
   return 0;
 }
+
+/*  Block intersection.
+ *
+ *  For larger sets, the recursion above pays for one tile
+ *  lookup and one 5-byte decode per probe.  Instead, walk both
+ *  sets in parallel, a block of ADDB_IDARRAY_BLOCK ids at a time:
+ *  decode each block into 64-bit ids, and let one of the kernels
+ *  in addb-idarray-simd.c intersect the overlapping parts.
+ *
+ *  If a freshly decoded block lies entirely below the other
+ *  side's next id, we binary-search past it in the idarray
+ *  rather than decoding our way forward; that's the galloping
+ *  part, and it keeps skewed intersections proportional to
+ *  the smaller set.
+ */
+typedef struct idarray_block {
+  /*  The array we're reading from, or NULL if we're
+   *  reading from ib_fixed or ib_pin.
+   */
+  addb_idarray *ib_ida;
+  addb_id const *ib_fixed;
+  addb_idarray_pinned const *ib_pin;
+
+  /*  Not yet decoded: [ib_s...ib_e)
+   */
+  unsigned long long ib_s;
+  unsigned long long ib_e;
+
+  /*  Decoded and not yet consumed: ib_ptr[0...ib_n)
+   */
+  addb_id const *ib_ptr;
+  size_t ib_n;
+
+  addb_id ib_buf[ADDB_IDARRAY_BLOCK];
+
+} idarray_block;
+
+static void idarray_block_initialize(idarray_block *ib, addb_idarray *ida,
+                                     addb_id const *fixed,
+                                     unsigned long long s,
+                                     unsigned long long e) {
+  ib->ib_ida = ida;
+  ib->ib_fixed = fixed;
+  ib->ib_pin = NULL;
+  ib->ib_s = s;
+  ib->ib_e = e;
+  ib->ib_ptr = ib->ib_buf;
+  ib->ib_n = 0;
+}
+
+/*  Decode the next block, starting at ib_s.
+ */
+static int idarray_block_decode(idarray_block *ib) {
+  unsigned long long n = ib->ib_e - ib->ib_s;
+  unsigned long long raw_end;
+  unsigned char const *ptr;
+  int err;
+
+  if (n > ADDB_IDARRAY_BLOCK) n = ADDB_IDARRAY_BLOCK;
+
+  if (ib->ib_pin != NULL) {
+    addb_idarray_span const *sp = ib->ib_pin->pin_span;
+    size_t lo = 0, hi = ib->ib_pin->pin_span_n;
+
+    /*  Decode no further than the end of the span.
+     */
+    while (hi - lo > 1) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (sp[mid].sp_s <= ib->ib_s)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    sp += lo;
+    if (n > sp->sp_s + sp->sp_n - ib->ib_s) n = sp->sp_s + sp->sp_n - ib->ib_s;
+
+    addb_idarray_decode(
+        sp->sp_ptr + (ib->ib_s - sp->sp_s) * ADDB_GMAP_ENTRY_SIZE, n,
+        ib->ib_buf);
+    ib->ib_ptr = ib->ib_buf;
+    ib->ib_n = n;
+    ib->ib_s += n;
+
+    return 0;
+  }
+  if (ib->ib_ida == NULL) {
+    ib->ib_ptr = ib->ib_fixed + ib->ib_s;
+    ib->ib_n = n;
+    ib->ib_s += n;
+
+    return 0;
+  }
+
+  /*  Usually, the whole block is in one tile and we can
+   *  decode straight out of the mapped memory.
+   */
+  err = addb_idarray_read_raw(ib->ib_ida, ib->ib_s * ADDB_GMAP_ENTRY_SIZE,
+                              (ib->ib_s + n) * ADDB_GMAP_ENTRY_SIZE, &ptr,
+                              &raw_end);
+  if (err != 0) return err;
+
+  if (raw_end == (ib->ib_s + n) * ADDB_GMAP_ENTRY_SIZE)
+    addb_idarray_decode(ptr, n, ib->ib_buf);
+  else {
+    /*  Straddles a tile boundary; take the slow path.
+     */
+    unsigned long long end;
+
+    err = addb_idarray_read(ib->ib_ida, ib->ib_s, ib->ib_s + n, ib->ib_buf,
+                            &end);
+    if (err != 0) return err;
+    n = end - ib->ib_s;
+  }
+
+  ib->ib_ptr = ib->ib_buf;
+  ib->ib_n = n;
+  ib->ib_s += n;
+
+  return 0;
+}
+
+/*  Make sure there's at least one decoded id >= min available.
+ *
+ * @return 0 on success
+ * @return ADDB_ERR_NO if the array has run out.
+ */
+static int idarray_block_fill(idarray_block *ib, addb_id min) {
+  int err;
+
+  if (ib->ib_n == 0) {
+    if (ib->ib_s >= ib->ib_e) return ADDB_ERR_NO;
+
+    err = idarray_block_decode(ib);
+    if (err != 0) return err;
+    if (ib->ib_n == 0) return ADDB_ERR_NO;
+  }
+  if (ib->ib_ptr[ib->ib_n - 1] >= min) return 0;
+  if (ib->ib_s >= ib->ib_e) return ADDB_ERR_NO;
+
+  /*  Everything we've decoded is smaller than min.  Skip
+   *  ahead to min without decoding what's in between.
+   */
+  if (ib->ib_ida != NULL) {
+    unsigned long long off;
+    addb_id id;
+
+    err = addb_idarray_search(ib->ib_ida, ib->ib_s, ib->ib_e, min, &off, &id);
+    if (err != 0) return err;
+    ib->ib_s = off;
+  } else if (ib->ib_pin != NULL) {
+    unsigned long long lo = ib->ib_s, hi = ib->ib_e;
+
+    while (lo < hi) {
+      unsigned long long mid = lo + (hi - lo) / 2;
+      if (addb_idarray_pin_get(ib->ib_pin, mid) < min)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    ib->ib_s = lo;
+  } else {
+    unsigned long long lo = ib->ib_s, hi = ib->ib_e;
+
+    while (lo < hi) {
+      unsigned long long mid = lo + (hi - lo) / 2;
+      if (ib->ib_fixed[mid] < min)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    ib->ib_s = lo;
+  }
+  ib->ib_n = 0;
+  if (ib->ib_s >= ib->ib_e) return ADDB_ERR_NO;
+
+  err = idarray_block_decode(ib);
+  if (err != 0) return err;
+  return ib->ib_n == 0 ? ADDB_ERR_NO : 0;
+}
+
+/*  How many of base[0..n) are <= id?
+ */
+static size_t idarray_block_upper_bound(addb_id const *base, size_t n,
+                                        addb_id id) {
+  size_t lo = 0, hi = n;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (base[mid] <= id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int idarray_block_intersect(addb_handle *addb, idarray_block *a,
+                                   idarray_block *b, addb_id *id_inout,
+                                   size_t *n_inout, size_t m) {
+  addb_id tmp[ADDB_IDARRAY_BLOCK];
+  int err;
+
+  for (;;) {
+    addb_id lim;
+    size_t a_n, b_n, k;
+    addb_id *out;
+
+    /*  Refill each side, skipping to the other side's
+     *  first pending id if we can.
+     */
+    err = idarray_block_fill(a, b->ib_n > 0 ? b->ib_ptr[0] : 0);
+    if (err == 0) err = idarray_block_fill(b, a->ib_ptr[0]);
+    if (err == 0 && a->ib_ptr[a->ib_n - 1] < b->ib_ptr[0])
+      err = idarray_block_fill(a, b->ib_ptr[0]);
+    if (err != 0) break;
+
+    /*  Intersect the overlap, up to the smaller of
+     *  the two block maxima.
+     */
+    lim = a->ib_ptr[a->ib_n - 1];
+    if (b->ib_ptr[b->ib_n - 1] < lim) lim = b->ib_ptr[b->ib_n - 1];
+
+    a_n = idarray_block_upper_bound(a->ib_ptr, a->ib_n, lim);
+    b_n = idarray_block_upper_bound(b->ib_ptr, b->ib_n, lim);
+
+    /*  Write straight into the caller's buffer if
+     *  the worst case fits.
+     */
+    out = (m - *n_inout >= (a_n < b_n ? a_n : b_n)) ? id_inout + *n_inout
+                                                     : tmp;
+    k = addb_idarray_intersect_block(a->ib_ptr, a_n, b->ib_ptr, b_n, out);
+    if (out == tmp) {
+      size_t room = m - *n_inout;
+
+      memcpy(id_inout + *n_inout, tmp, (k < room ? k : room) * sizeof(*tmp));
+      if (k > room) {
+        *n_inout = m;
+        return ADDB_ERR_MORE;
+      }
+    }
+    *n_inout += k;
+
+    a->ib_ptr += a_n;
+    a->ib_n -= a_n;
+    b->ib_ptr += b_n;
+    b->ib_n -= b_n;
+  }
+
+  if (err != ADDB_ERR_NO) {
+    cl_log_errno(addb->addb_cl, CL_LEVEL_FAIL, "idarray_block_fill", err,
+                 "a %llu..%llu, b %llu..%llu", a->ib_s, a->ib_e, b->ib_s,
+                 b->ib_e);
+    return err;
+  }
+  return 0;
+}
+
+/*  Parallel block intersection.
+ *
+ *  If both sides are large and we have worker threads, cut
+ *  the id space into partitions at ids taken from the larger
+ *  side, and intersect the partitions in parallel, each into
+ *  a buffer of its own.  The buffers are then concatenated
+ *  in order.
+ *
+ *  The workers can't use the tile cache; the main thread pins
+ *  both ranges first, and they read from the pinned spans.
+ */
+typedef struct idarray_part {
+  unsigned long long ip_a_s, ip_a_e;
+  unsigned long long ip_b_s, ip_b_e;
+
+  addb_id *ip_id;
+  size_t ip_n;
+  size_t ip_m;
+  int ip_err;
+
+} idarray_part;
+
+typedef struct idarray_parallel {
+  addb_handle *ipl_addb;
+  addb_idarray_pinned ipl_a;
+  addb_idarray_pinned ipl_b;
+  idarray_part *ipl_part;
+
+  /*  The partitions being worked on.
+   */
+  idarray_part *ipl_wave;
+
+} idarray_parallel;
+
+static void idarray_parallel_task(void *data, size_t i) {
+  idarray_parallel *ipl = data;
+  idarray_part *ip = ipl->ipl_wave + i;
+  idarray_block a_ib, b_ib;
+
+  ip->ip_n = 0;
+  ip->ip_err = 0;
+  if (ip->ip_a_s >= ip->ip_a_e || ip->ip_b_s >= ip->ip_b_e) return;
+
+  idarray_block_initialize(&a_ib, NULL, NULL, ip->ip_a_s, ip->ip_a_e);
+  a_ib.ib_pin = &ipl->ipl_a;
+  idarray_block_initialize(&b_ib, NULL, NULL, ip->ip_b_s, ip->ip_b_e);
+  b_ib.ib_pin = &ipl->ipl_b;
+
+  ip->ip_err = idarray_block_intersect(ipl->ipl_addb, &a_ib, &b_ib, ip->ip_id,
+                                       &ip->ip_n, ip->ip_m);
+}
+
+/*  Returns ADDB_ERR_NO if the caller should do this serially.
+ */
+static int idarray_parallel_intersect(addb_handle *addb,
+
+                                      addb_idarray *a, unsigned long long a_s,
+                                      unsigned long long a_e,
+
+                                      addb_idarray *b, unsigned long long b_s,
+                                      unsigned long long b_e,
+
+                                      addb_id *id_inout, size_t *n_inout,
+                                      size_t m) {
+  idarray_parallel ipl;
+  idarray_part *ip;
+  addb_id *buf = NULL;
+  size_t threads, n_part, wave, i, total, buf_m = 0;
+  unsigned long long total_n = (a_e - a_s) + (b_e - b_s);
+  unsigned long long parallel_min, part;
+  unsigned long long big_s, big_e, small_s, small_e;
+  addb_idarray_pinned const *big, *small;
+  bool a_larger;
+  int err = 0;
+
+  if (*n_inout >= m || total_n < (parallel_min = addb->addb_parallel_min) ||
+      (threads = addb_worker_threads(addb)) == 0)
+    return ADDB_ERR_NO;
+
+  if ((part = parallel_min / 8) > ADDB_IDARRAY_PARALLEL_PART)
+    part = ADDB_IDARRAY_PARALLEL_PART;
+  else if (part == 0)
+    part = 1;
+
+  /*  A few partitions per thread, so that stealing can even
+   *  out the differences between them.
+   */
+  n_part = 4 * (threads + 1);
+  if (n_part > total_n / part) n_part = total_n / part;
+  if (n_part < 2) return ADDB_ERR_NO;
+
+  memset(&ipl, 0, sizeof ipl);
+  ipl.ipl_addb = addb;
+  ipl.ipl_part = cm_talloc(addb->addb_cm, idarray_part, n_part);
+  if (ipl.ipl_part == NULL) return ADDB_ERR_NO;
+
+  if ((err = addb_idarray_pin(addb, a, a_s, a_e, &ipl.ipl_a)) != 0 ||
+      (err = addb_idarray_pin(addb, b, b_s, b_e, &ipl.ipl_b)) != 0) {
+    addb_idarray_unpin(&ipl.ipl_a);
+    cm_free(addb->addb_cm, ipl.ipl_part);
+    return err == ENOMEM ? ADDB_ERR_NO : err;
+  }
+
+  /*  Cut the larger side into equal parts by index, and the
+   *  smaller one at the ids where the larger one was cut.
+   */
+  a_larger = a_e - a_s >= b_e - b_s;
+  big = a_larger ? &ipl.ipl_a : &ipl.ipl_b;
+  small = a_larger ? &ipl.ipl_b : &ipl.ipl_a;
+  big_s = a_larger ? a_s : b_s;
+  big_e = a_larger ? a_e : b_e;
+  small_s = a_larger ? b_s : a_s;
+  small_e = a_larger ? b_e : a_e;
+
+  for (i = 0; i < n_part; i++) {
+    unsigned long long cut, lo, hi;
+    addb_id id;
+
+    ip = ipl.ipl_part + i;
+    if (i == n_part - 1) {
+      cut = big_e;
+      lo = small_e;
+    } else {
+      cut = big_s + (big_e - big_s) * (i + 1) / n_part;
+      id = addb_idarray_pin_get(big, cut);
+
+      lo = i == 0 ? small_s : (a_larger ? ip[-1].ip_b_e : ip[-1].ip_a_e);
+      hi = small_e;
+      while (lo < hi) {
+        unsigned long long mid = lo + (hi - lo) / 2;
+        if (addb_idarray_pin_get(small, mid) < id)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+    }
+    if (a_larger) {
+      ip->ip_a_s = i == 0 ? a_s : ip[-1].ip_a_e;
+      ip->ip_a_e = cut;
+      ip->ip_b_s = i == 0 ? b_s : ip[-1].ip_b_e;
+      ip->ip_b_e = lo;
+    } else {
+      ip->ip_b_s = i == 0 ? b_s : ip[-1].ip_b_e;
+      ip->ip_b_e = cut;
+      ip->ip_a_s = i == 0 ? a_s : ip[-1].ip_a_e;
+      ip->ip_a_e = lo;
+    }
+  }
+
+  cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
+         "addb_idarray_intersect: %zu partitions, %zu threads, "
+         "%zu + %zu spans",
+         n_part, threads, ipl.ipl_a.pin_span_n, ipl.ipl_b.pin_span_n);
+
+  /*  The kernel is chosen once, lazily; do that here, not
+   *  in the threads.
+   */
+  (void)addb_idarray_intersect_kernel_select(NULL);
+
+  /*  Run the partitions one wave of threads + 1 at a time,
+   *  so that we can stop early, like the serial version,
+   *  once the caller's buffer is full.
+   */
+  for (wave = 0; wave < n_part; wave += threads + 1) {
+    size_t wave_n = n_part - wave < threads + 1 ? n_part - wave : threads + 1;
+
+    for (total = 0, i = 0; i < wave_n; i++) {
+      ip = ipl.ipl_part + wave + i;
+      ip->ip_m = ip->ip_a_e - ip->ip_a_s;
+      if (ip->ip_m > ip->ip_b_e - ip->ip_b_s)
+        ip->ip_m = ip->ip_b_e - ip->ip_b_s;
+      if (ip->ip_m > m - *n_inout) ip->ip_m = m - *n_inout;
+      total += ip->ip_m;
+    }
+    if (total > buf_m) {
+      addb_id *tmp = cm_trealloc(addb->addb_cm, addb_id, buf, total);
+      if (tmp == NULL) {
+        err = errno ? errno : ENOMEM;
+        cl_log_errno(addb->addb_cl, CL_LEVEL_FAIL, "cm_trealloc", err,
+                     "%zu ids", total);
+        break;
+      }
+      buf = tmp;
+      buf_m = total;
+    }
+    for (total = 0, i = 0; i < wave_n; i++) {
+      ipl.ipl_part[wave + i].ip_id = buf + total;
+      total += ipl.ipl_part[wave + i].ip_m;
+    }
+
+    ipl.ipl_wave = ipl.ipl_part + wave;
+    addb_worker_run(addb, wave_n, idarray_parallel_task, &ipl);
+
+    for (i = 0; i < wave_n; i++) {
+      ip = ipl.ipl_wave + i;
+
+      if (ip->ip_err == 0 && ip->ip_n <= m - *n_inout) {
+        memcpy(id_inout + *n_inout, ip->ip_id, ip->ip_n * sizeof(*buf));
+        *n_inout += ip->ip_n;
+        continue;
+      }
+      if (ip->ip_err != 0 && ip->ip_err != ADDB_ERR_MORE) {
+        err = ip->ip_err;
+        cl_log_errno(addb->addb_cl, CL_LEVEL_FAIL, "idarray_parallel_task",
+                     err, "a %llu..%llu, b %llu..%llu", ip->ip_a_s,
+                     ip->ip_a_e, ip->ip_b_s, ip->ip_b_e);
+        break;
+      }
+
+      /*  Out of room.
+       */
+      memcpy(id_inout + *n_inout, ip->ip_id,
+             (m - *n_inout < ip->ip_n ? m - *n_inout : ip->ip_n) *
+                 sizeof(*buf));
+      *n_inout = m;
+      err = ADDB_ERR_MORE;
+      break;
+    }
+    if (err != 0) break;
+  }
+
+  if (buf != NULL) cm_free(addb->addb_cm, buf);
+  addb_idarray_unpin(&ipl.ipl_b);
+  addb_idarray_unpin(&ipl.ipl_a);
+  cm_free(addb->addb_cm, ipl.ipl_part);
+
+  return err;
+}
+
+/**
+ * @brief Intersect two idarrays.
+ *
+ *  Both sets are given as an idarray and start and end boundaries.
+ *  Results are appended to id_inout[*n_inout...m-1] in ascending order.
+ *
+ *  Small or very lopsided sets (and single ids) are intersected by
+ *  recursive binary search; others by decoding blocks and merging
+ *  or galloping them with the best kernel this CPU supports.
+ *  Large sets are split into partitions that worker threads
+ *  intersect in parallel, if there are any.
+ *
+ * @param addb 		opaque addb module handle
+ *
+ * @param a		one idarray
+ * @param a_s		start index
+ * @param a_e		end index
+ *
+ * @param b		the other idarray
+ * @param b_s		start index
+ * @param b_e		end index
+ *
+ * @param id_inout	out: elements shared by a and b.
+ * @param n_inout	in/out: number of occupied slots in id_inout.
+ * @param m		maximum number of slots available.
+ *
+ * @return ADDB_ERR_MORE	more results than we have
+ *				space for.
+ */
+int addb_idarray_intersect(addb_handle *addb,
+
+                           addb_idarray *a, unsigned long long a_s,
+                           unsigned long long a_e,
+
+                           addb_idarray *b, unsigned long long b_s,
+                           unsigned long long b_e,
+
+                           addb_id *id_inout, size_t *n_inout, size_t m) {
+  idarray_block a_ib, b_ib;
+  int err;
+
+  if (a->ida_is_single || b->ida_is_single || a_s >= a_e || b_s >= b_e ||
+      !ADDB_IDARRAY_USE_BLOCKS(a_e - a_s, b_e - b_s))
+    return idarray_intersect_recursive(addb, a, a_s, a_e, b, b_s, b_e,
+                                       id_inout, n_inout, m);
+
+  err = idarray_parallel_intersect(addb, a, a_s, a_e, b, b_s, b_e, id_inout,
+                                   n_inout, m);
+  if (err != ADDB_ERR_NO) return err;
+
+  cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
+         "addb_idarray_intersect: "
+         "%p, %llu..%llu vs. %p, %llu...%llu",
+         (void *)a, a_s, a_e - 1, (void *)b, b_s, b_e - 1);
+
+  idarray_block_initialize(&a_ib, a, NULL, a_s, a_e);
+  idarray_block_initialize(&b_ib, b, NULL, b_s, b_e);
+
+  return idarray_block_intersect(addb, &a_ib, &b_ib, id_inout, n_inout, m);
+}
+
+/**
+ * @brief Intersect between an idarray and a fixed set of ids.
+ *
+ *  The first set is an idarray and start/end boundaries.
+ *  The second set is a fixed set of ids with start and end point.
+ *
+ * @param addb 		opaque addb module handle
+ *
+ * @param a		one idarray
+ * @param a_s		start index
+ * @param a_e		end index
+ *
+ * @param b_base	a fixed set of indices
+ * @param b_n		number of indices pointed to by b_base.
+ *
+ * @param id_out	out: elements shared by a and b.
+ * @param n_out		out: number of occupied slots in id_out.
+ * @param m		maximum number of slots available.
+ *
+ * @return ADDB_ERR_MORE	ran out of slots
+ */
+int addb_idarray_fixed_intersect(addb_handle *addb,
+
+                                 addb_idarray *a, unsigned long long a_s,
+                                 unsigned long long a_e,
+
+                                 addb_id *b_base, size_t b_n,
+
+                                 addb_id *id_out, size_t *n_out, size_t m) {
+  idarray_block a_ib, b_ib;
+
+  if (a->ida_is_single || a_s >= a_e || b_n == 0 ||
+      !ADDB_IDARRAY_USE_BLOCKS(a_e - a_s, b_n))
+    return idarray_fixed_intersect_recursive(addb, a, a_s, a_e, b_base, b_n,
+                                             id_out, n_out, m);
+
+  cl_log(addb->addb_cl, CL_LEVEL_VERBOSE,
+         "addb_idarray_fixed_intersect "
+         "%p, %llu..%llu vs. fixed[%llu]",
+         (void *)a, a_s, a_e - 1, (unsigned long long)b_n);
+
+  idarray_block_initialize(&a_ib, a, NULL, a_s, a_e);
+  idarray_block_initialize(&b_ib, NULL, b_base, 0, b_n);
+
+  return idarray_block_intersect(addb, &a_ib, &b_ib, id_out, n_out, m);
+}
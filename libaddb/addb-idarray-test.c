@@ -0,0 +1,145 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libaddb/addbp.h"
+
+#define TEST(expr)                          \
+  do {                                      \
+    if (!(expr)) {                          \
+      fprintf(stderr,                       \
+              "test \"%s\", line %d: test " \
+              "failed: %s\n",               \
+              __FILE__, __LINE__, #expr);   \
+      except_throw(err);                    \
+    }                                       \
+  } while (0)
+
+/*  The largest id an idarray can hold.
+ */
+#define ID_MAX ((1ull << 34) - 1)
+
+/*  Fill <id> with <n> sorted, distinct ids, starting at or after
+ *  <base>, with gaps of 1 to <gap>.
+ */
+static void ids_make(addb_id *id, size_t n, addb_id base, unsigned int gap) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    base += 1 + (gap > 1 ? random() % gap : 0);
+    id[i] = base;
+  }
+}
+
+/*  Run <kernel> and the scalar merge over a and b, both ways
+ *  around, and compare.
+ */
+static int kernel_agrees(addb_idarray_intersect_kernel *kernel,
+                         addb_id const *a, size_t a_n, addb_id const *b,
+                         size_t b_n, char const *file, int line) {
+  addb_id want[ADDB_IDARRAY_BLOCK], got[ADDB_IDARRAY_BLOCK];
+  size_t want_n, got_n;
+
+  want_n = addb_idarray_intersect_scalar(a, a_n, b, b_n, want);
+
+  got_n = (*kernel)(a, a_n, b, b_n, got);
+  TEST(got_n == want_n);
+  TEST(memcmp(got, want, want_n * sizeof(*want)) == 0);
+
+  got_n = (*kernel)(b, b_n, a, a_n, got);
+  TEST(got_n == want_n);
+  TEST(memcmp(got, want, want_n * sizeof(*want)) == 0);
+
+  got_n = addb_idarray_intersect_block(a, a_n, b, b_n, got);
+  TEST(got_n == want_n);
+  TEST(memcmp(got, want, want_n * sizeof(*want)) == 0);
+
+  except_catch(err) {
+    fprintf(stderr, "\t[%zu vs. %zu ids, from \"%s\", line %d]\n", a_n, b_n,
+            file, line);
+    return 1;
+  }
+  return 0;
+}
+
+/*  Force the kernel <name>, and check that it agrees with the
+ *  scalar merge on blocks of every size up to ADDB_IDARRAY_BLOCK
+ *  -- so every remainder past the vector width -- at several
+ *  densities, and on a few hand-picked shapes.
+ */
+static int kernel_check(char const *name, char const *file, int line) {
+  static const unsigned int gap[] = {1, 2, 4, 64};
+  addb_idarray_intersect_kernel *kernel;
+  addb_id a[ADDB_IDARRAY_BLOCK], b[ADDB_IDARRAY_BLOCK];
+  char const *selected;
+  size_t a_n, b_n, i, g;
+
+  /*  Kernels this CPU can't run are skipped.
+   */
+  if (addb_idarray_intersect_kernel_force(name) != 0) return 0;
+  kernel = addb_idarray_intersect_kernel_select(&selected);
+  TEST(strcmp(selected, name) == 0);
+
+  for (g = 0; g < sizeof(gap) / sizeof(*gap); g++)
+    for (a_n = 0; a_n <= ADDB_IDARRAY_BLOCK; a_n++) {
+      b_n = random() % (ADDB_IDARRAY_BLOCK + 1);
+      ids_make(a, a_n, random() % 16, gap[g]);
+      ids_make(b, b_n, random() % 16, gap[g]);
+      TEST(!kernel_agrees(kernel, a, a_n, b, b_n, file, line));
+    }
+
+  /*  Equal; interleaved without a match; one side entirely
+   *  below the other; a single match at either end.
+   */
+  for (i = 0; i < ADDB_IDARRAY_BLOCK; i++) {
+    a[i] = 2 * i;
+    b[i] = 2 * i;
+  }
+  TEST(!kernel_agrees(kernel, a, 37, b, 37, file, line));
+  for (i = 0; i < ADDB_IDARRAY_BLOCK; i++) b[i] = 2 * i + 1;
+  TEST(!kernel_agrees(kernel, a, 100, b, 100, file, line));
+  for (i = 0; i < ADDB_IDARRAY_BLOCK; i++) b[i] = 1000 + i;
+  TEST(!kernel_agrees(kernel, a, 100, b, 100, file, line));
+  b[0] = a[0];
+  TEST(!kernel_agrees(kernel, a, 100, b, 5, file, line));
+  b[4] = a[99] = 2000;
+  TEST(!kernel_agrees(kernel, a, 100, b, 5, file, line));
+
+  /*  The top of the id space.
+   */
+  for (i = 0; i < ADDB_IDARRAY_BLOCK; i++) {
+    a[i] = ID_MAX - 2 * (ADDB_IDARRAY_BLOCK - i);
+    b[i] = ID_MAX - 3 * (ADDB_IDARRAY_BLOCK - i);
+  }
+  TEST(!kernel_agrees(kernel, a, ADDB_IDARRAY_BLOCK, b, ADDB_IDARRAY_BLOCK,
+                      file, line));
+
+  except_catch(err) {
+    fprintf(stderr, "\t[%s kernel, from \"%s\", line %d]\n", name, file, line);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int ac, char **av) {
+  int result = 0;
+
+  srandom(42);
+
+  result |= kernel_check("scalar", __FILE__, __LINE__);
+  result |= kernel_check("avx2", __FILE__, __LINE__);
+
+  return result;
+}
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 
 /*  An IDARRAY is a big piece of vitual storage that contains
  *  IDs.
@@ -156,7 +157,31 @@ int addb_idarray_read_raw(addb_idarray *ida, unsigned long long start_offset,
       return ADDB_ERR_NO;
     }
 
-    if (ida->ida_gac.gac_lf != NULL) {
+    if (ida->ida_gac.gac_lf != NULL &&
+        ida->ida_gac.gac_offset + start_offset <
+            addb_largefile_pack_end(ida->ida_gac.gac_lf)) {
+      addb_largefile* const lf = ida->ida_gac.gac_lf;
+
+      /*  Packed ids are expanded into a buffer of our own;
+       *  there's no tile to hold on to.
+       */
+      err = addb_largefile_read_packed(
+          lf, ida->ida_gac.gac_offset + start_offset,
+          ida->ida_gac.gac_offset + end_offset, ida->ida_pack_bytes,
+          sizeof ida->ida_pack_bytes, ptr_out, &accessor_end_offset);
+      if (err != 0) {
+        cl_log_errno(ida->ida_cl, CL_LEVEL_FAIL, "addb_largefile_read_packed",
+                     err, "%llu..%llu", ida->ida_gac.gac_offset + start_offset,
+                     ida->ida_gac.gac_offset + end_offset - 1);
+        return err;
+      }
+      *end_offset_out = accessor_end_offset - ida->ida_gac.gac_offset;
+
+      if (lf->lf_td != NULL) addb_tiled_free(lf->lf_td, &ida->ida_tref);
+      ida->ida_tref = ADDB_TILED_REFERENCE_EMPTY;
+
+      return 0;
+    } else if (ida->ida_gac.gac_lf != NULL) {
       err = addb_largefile_read_raw(ida->ida_gac.gac_lf,
                                     ida->ida_gac.gac_offset + start_offset,
                                     ida->ida_gac.gac_offset + end_offset,
@@ -408,6 +433,15 @@ int addb_idarray_search(addb_idarray *ida, unsigned long long s,
     return 0;
   }
 
+  /*  Largefiles with a packed prefix know how to search
+   *  it without expanding it.
+   */
+  if (ida->ida_gac.gac_lf != NULL && ida->ida_gac.gac_lf->lf_pack != NULL) {
+    err = addb_largefile_search(ida->ida_gac.gac_lf, s, e, id, off_out, id_out);
+    if (err != 0) return err;
+    goto done;
+  }
+
   while (s < e) {
     unsigned long long val, middle, e_new;
     unsigned char const *ptr;
@@ -496,6 +530,25 @@ unsigned long long addb_idarray_n(addb_idarray const *ida) {
   return addb_gmap_accessor_n(&ida->ida_gac);
 }
 
+/**
+ * @brief Start reading elements of an idarray into memory.
+ *
+ * @param ida 		idarray
+ * @param s		index of the first element
+ * @param e		index of the first element not included
+ * @param stalled	the caller has caught up with its previous
+ *			read-ahead; count that.
+ */
+void addb_idarray_prefetch(addb_idarray const *ida, unsigned long long s,
+                           unsigned long long e, bool stalled) {
+  if (ida->ida_is_single || s >= e ||
+      (e - s) * ADDB_GMAP_ENTRY_SIZE < ADDB_PREFETCH_MIN / 2)
+    return;
+
+  addb_gmap_accessor_prefetch(&ida->ida_gac, s * ADDB_GMAP_ENTRY_SIZE,
+                              (e - s) * ADDB_GMAP_ENTRY_SIZE, stalled);
+}
+
 /**
  * @brief Create an idarray with a single ID in it.
  *
@@ -540,3 +593,217 @@ void addb_idarray_multiple(cl_handle *cl, addb_idarray *ida) {
   ADDB_TILED_REFERENCE_INITIALIZE(ida->ida_tref);
   ida->ida_is_single = false;
 }
+
+/*  Pinning.
+ *
+ *  To let worker threads read an idarray, the main thread
+ *  walks it once, takes an extra reference to each tile that
+ *  holds part of it, and records where the ids are.  Ids that
+ *  have no tile of their own -- packed largefile prefixes, or
+ *  the one id that straddles a tile boundary -- are copied.
+ */
+struct addb_idarray_pin_ref {
+  addb_tiled *pr_td;
+  addb_tiled_reference pr_tref;
+};
+
+static int idarray_pin_copy(addb_idarray_pinned *pin, unsigned long long i,
+                            unsigned char const *ptr, size_t n) {
+  cm_handle *cm = pin->pin_addb->addb_cm;
+  addb_idarray_span *sp;
+
+  if (pin->pin_copy_n + n * ADDB_GMAP_ENTRY_SIZE > pin->pin_copy_m) {
+    size_t m = pin->pin_copy_m * 2 + n * ADDB_GMAP_ENTRY_SIZE + 1024;
+    unsigned char *tmp = cm_trealloc(cm, unsigned char, pin->pin_copy, m);
+    if (tmp == NULL) return errno ? errno : ENOMEM;
+
+    pin->pin_copy = tmp;
+    pin->pin_copy_m = m;
+  }
+  memcpy(pin->pin_copy + pin->pin_copy_n, ptr, n * ADDB_GMAP_ENTRY_SIZE);
+
+  /*  Until we're done, copied spans have a NULL sp_ptr and
+   *  remember their offset into pin_copy; the buffer may
+   *  still move.
+   */
+  sp = pin->pin_span_n > 0 ? pin->pin_span + pin->pin_span_n - 1 : NULL;
+  if (sp != NULL && sp->sp_ptr == NULL && sp->sp_s + sp->sp_n == i &&
+      sp->sp_copy + sp->sp_n * ADDB_GMAP_ENTRY_SIZE == pin->pin_copy_n) {
+    sp->sp_n += n;
+  } else {
+    if (pin->pin_span_n >= pin->pin_span_m) {
+      size_t m = pin->pin_span_m * 2 + 16;
+      sp = cm_trealloc(cm, addb_idarray_span, pin->pin_span, m);
+      if (sp == NULL) return errno ? errno : ENOMEM;
+
+      pin->pin_span = sp;
+      pin->pin_span_m = m;
+    }
+    sp = pin->pin_span + pin->pin_span_n++;
+    sp->sp_ptr = NULL;
+    sp->sp_copy = pin->pin_copy_n;
+    sp->sp_s = i;
+    sp->sp_n = n;
+  }
+  pin->pin_copy_n += n * ADDB_GMAP_ENTRY_SIZE;
+  return 0;
+}
+
+static int idarray_pin_tile(addb_idarray_pinned *pin, addb_idarray *ida,
+                            unsigned long long i, unsigned char const *ptr,
+                            size_t n) {
+  cm_handle *cm = pin->pin_addb->addb_cm;
+  addb_idarray_span *sp;
+  struct addb_idarray_pin_ref *pr;
+  addb_tiled *td = ida->ida_gac.gac_lf != NULL ? ida->ida_gac.gac_lf->lf_td
+                                               : ida->ida_gac.gac_part->part_td;
+
+  if (pin->pin_span_n >= pin->pin_span_m) {
+    size_t m = pin->pin_span_m * 2 + 16;
+    sp = cm_trealloc(cm, addb_idarray_span, pin->pin_span, m);
+    if (sp == NULL) return errno ? errno : ENOMEM;
+
+    pin->pin_span = sp;
+    pin->pin_span_m = m;
+  }
+  if (pin->pin_ref_n >= pin->pin_ref_m) {
+    size_t m = pin->pin_ref_m * 2 + 16;
+    pr = cm_trealloc(cm, struct addb_idarray_pin_ref, pin->pin_ref, m);
+    if (pr == NULL) return errno ? errno : ENOMEM;
+
+    pin->pin_ref = pr;
+    pin->pin_ref_m = m;
+  }
+
+  pr = pin->pin_ref + pin->pin_ref_n++;
+  pr->pr_td = td;
+  pr->pr_tref = ida->ida_tref;
+  addb_tiled_link(td, &pr->pr_tref);
+
+  sp = pin->pin_span + pin->pin_span_n++;
+  sp->sp_ptr = ptr;
+  sp->sp_copy = 0;
+  sp->sp_s = i;
+  sp->sp_n = n;
+
+  return 0;
+}
+
+/**
+ * @brief Pin a range of an idarray in memory.
+ *
+ *  Until the pin is released with addb_idarray_unpin(), the
+ *  ids in [s...e) can be read with addb_idarray_pin_get() or
+ *  directly out of pin->pin_span[], from any thread.
+ *
+ * @param addb	opaque module handle
+ * @param ida	a multi-element idarray
+ * @param s	first index to pin
+ * @param e	first index not to pin
+ * @param pin	out: the pinned range
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_idarray_pin(addb_handle *addb, addb_idarray *ida,
+                     unsigned long long s, unsigned long long e,
+                     addb_idarray_pinned *pin) {
+  unsigned long long i;
+  size_t k;
+  int err = 0;
+
+  memset(pin, 0, sizeof *pin);
+  pin->pin_addb = addb;
+
+  for (i = s; i < e;) {
+    unsigned char const *ptr;
+    unsigned long long raw_end, n;
+
+    err = addb_idarray_read_raw(ida, i * ADDB_GMAP_ENTRY_SIZE,
+                                e * ADDB_GMAP_ENTRY_SIZE, &ptr, &raw_end);
+    if (err != 0) break;
+
+    n = (raw_end - i * ADDB_GMAP_ENTRY_SIZE) / ADDB_GMAP_ENTRY_SIZE;
+    if (n == 0) {
+      unsigned char buf[ADDB_GMAP_ENTRY_SIZE];
+      addb_id id;
+
+      if ((err = addb_idarray_read1(ida, i, &id)) != 0) break;
+
+      buf[0] = 0x03 & (id >> 32);
+      buf[1] = 0xFF & (id >> 24);
+      buf[2] = 0xFF & (id >> 16);
+      buf[3] = 0xFF & (id >> 8);
+      buf[4] = 0xFF & id;
+
+      err = idarray_pin_copy(pin, i, buf, 1);
+      n = 1;
+    } else if (ida->ida_is_single ||
+               ida->ida_tref == ADDB_TILED_REFERENCE_EMPTY)
+      err = idarray_pin_copy(pin, i, ptr, n);
+    else
+      err = idarray_pin_tile(pin, ida, i, ptr, n);
+    if (err != 0) break;
+
+    i += n;
+  }
+  if (err != 0) {
+    cl_log_errno(ida->ida_cl, CL_LEVEL_FAIL, "addb_idarray_pin", err,
+                 "%llu..%llu, at %llu", s, e, i);
+    addb_idarray_unpin(pin);
+    return err;
+  }
+
+  /*  Resolve the copy offsets, now that the buffer stays put.
+   */
+  for (k = 0; k < pin->pin_span_n; k++) {
+    addb_idarray_span *sp = pin->pin_span + k;
+    if (sp->sp_ptr == NULL) sp->sp_ptr = pin->pin_copy + sp->sp_copy;
+  }
+  return 0;
+}
+
+/**
+ * @brief Release a pin acquired with addb_idarray_pin().
+ *
+ * @param pin	pin to release; may be released more than once.
+ */
+void addb_idarray_unpin(addb_idarray_pinned *pin) {
+  cm_handle *cm;
+  size_t i;
+
+  if (pin->pin_addb == NULL) return;
+  cm = pin->pin_addb->addb_cm;
+
+  for (i = 0; i < pin->pin_ref_n; i++)
+    addb_tiled_free(pin->pin_ref[i].pr_td, &pin->pin_ref[i].pr_tref);
+
+  if (pin->pin_ref != NULL) cm_free(cm, pin->pin_ref);
+  if (pin->pin_span != NULL) cm_free(cm, pin->pin_span);
+  if (pin->pin_copy != NULL) cm_free(cm, pin->pin_copy);
+
+  memset(pin, 0, sizeof *pin);
+}
+
+/**
+ * @brief Return the id at index i of a pinned range.
+ *
+ *  Safe to call from a worker thread.
+ *
+ * @param pin	the pinned range
+ * @param i	index, within the pinned range
+ */
+addb_id addb_idarray_pin_get(addb_idarray_pinned const *pin,
+                             unsigned long long i) {
+  addb_idarray_span const *sp = pin->pin_span;
+  size_t lo = 0, hi = pin->pin_span_n;
+
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (sp[mid].sp_s <= i)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return ADDB_GMAP_LOW_34(ADDB_GET_U5(sp[lo].sp_ptr + (i - sp[lo].sp_s) *
+                                                       ADDB_GMAP_ENTRY_SIZE));
+}
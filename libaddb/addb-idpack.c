@@ -0,0 +1,486 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libaddb/addb-largefile-file.h"
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*  Packed largefile prefixes.
+ *
+ *  Largefiles only ever grow at the end, so once a stretch of
+ *  a largefile has been checkpointed, it never changes again.
+ *  Those stretches are copied into a sidecar ".glp" file as
+ *  delta-encoded, bit-packed blocks of ADDB_IDPACK_BLOCK ids
+ *  (see addb-largefile-file.h), and the disk space behind
+ *  them in the largefile is released.
+ *
+ *  The pack is mapped read-only.  In memory, we keep a skip
+ *  table with the first id and byte offset of each block; a
+ *  lookup binary-searches the skip table, then decodes at
+ *  most one block, and only as far as it needs to.
+ */
+
+#define ADDB_IDPACK_WIDTH(blk) ((blk)[5])
+#define ADDB_IDPACK_BLOCK_SIZE(w) \
+  (6 + ((ADDB_IDPACK_BLOCK - 1) * (size_t)(w) + 7) / 8)
+
+/**
+ * @brief Encode one block of ids.
+ *
+ * @param id	ADDB_IDPACK_BLOCK ids, strictly ascending.
+ * @param out	buffer with room for ADDB_IDPACK_BLOCK_MAX bytes
+ *
+ * @return the number of bytes written to out, or 0 if the
+ *	ids aren't strictly ascending 34-bit values.
+ */
+size_t addb_idpack_encode(addb_id const *id, unsigned char *out) {
+  unsigned long long acc = 0, max_d = 0;
+  unsigned char *p = out + 6;
+  unsigned int w = 0, bits = 0;
+  size_t i;
+
+  for (i = 1; i < ADDB_IDPACK_BLOCK; i++) {
+    if (id[i] <= id[i - 1]) return 0;
+    max_d |= id[i] - id[i - 1] - 1;
+  }
+  if (id[ADDB_IDPACK_BLOCK - 1] > ADDB_GMAP_LOW_34(~0ull)) return 0;
+
+  while (max_d >> w) w++;
+
+  ADDB_PUT_U5(out, id[0]);
+  ADDB_IDPACK_WIDTH(out) = w;
+
+  for (i = 1; i < ADDB_IDPACK_BLOCK; i++) {
+    acc |= (id[i] - id[i - 1] - 1) << bits;
+    for (bits += w; bits >= 8; bits -= 8) {
+      *p++ = acc;
+      acc >>= 8;
+    }
+  }
+  if (bits > 0) *p++ = acc;
+
+  return p - out;
+}
+
+/*  Return the offset of the first id >= <id> at or after
+ *  <from> and before <to> in a block, or <to> if there is none.
+ *  Decodes only as many deltas as it has to.
+ */
+static size_t idpack_block_search(unsigned char const *blk, size_t from,
+                                  size_t to, addb_id id, addb_id *val_out) {
+  unsigned int const w = ADDB_IDPACK_WIDTH(blk);
+  unsigned long long const mask = (1ull << w) - 1;
+  unsigned long long acc = 0;
+  unsigned char const *p = blk + 6;
+  unsigned int bits = 0;
+  addb_id val = ADDB_GET_U5(blk);
+  size_t i;
+
+  for (i = 0; i < to; i++) {
+    if (i > 0) {
+      for (; bits < w; bits += 8) acc |= (unsigned long long)*p++ << bits;
+      val += (acc & mask) + 1;
+      acc >>= w;
+      bits -= w;
+    }
+    if (i >= from && val >= id) {
+      *val_out = val;
+      return i;
+    }
+  }
+  return to;
+}
+
+/**
+ * @brief Decode the first n ids of a block.
+ */
+void addb_idpack_unpack(unsigned char const *blk, size_t n, addb_id *out) {
+  unsigned int const w = ADDB_IDPACK_WIDTH(blk);
+  unsigned long long const mask = (1ull << w) - 1;
+  unsigned long long acc = 0;
+  unsigned char const *p = blk + 6;
+  unsigned int bits = 0;
+  addb_id val = ADDB_GET_U5(blk);
+  addb_id *const end = out + n;
+
+  if (out >= end) return;
+  *out++ = val;
+
+  if (w == 0) {
+    while (out < end) *out++ = ++val;
+    return;
+  }
+  while (out < end) {
+    for (; bits < w; bits += 8) acc |= (unsigned long long)*p++ << bits;
+    val += (acc & mask) + 1;
+    acc >>= w;
+    bits -= w;
+    *out++ = val;
+  }
+}
+
+/*  (Re)map the pack file and extend the skip table to cover
+ *  whatever blocks have been added since the last call.
+ *  On error, the previous mapping stays intact.
+ */
+static int idpack_map(addb_handle *addb, addb_idpack *ip) {
+  cl_handle *const cl = addb->addb_cl;
+  unsigned char const *base;
+  unsigned long long n, b;
+  struct stat st;
+  size_t off;
+  void *m;
+  int fd, err;
+
+  if ((fd = open(ip->ip_path, O_RDONLY)) < 0) {
+    err = errno;
+    if (err != ENOENT)
+      cl_log_errno(cl, CL_LEVEL_ERROR, "open", err, "%s", ip->ip_path);
+    return err;
+  }
+  err = addb_file_fstat(cl, fd, ip->ip_path, &st);
+  if (err != 0) {
+    (void)close(fd);
+    return err;
+  }
+  if (st.st_size < ADDB_IDPACK_HEADER) {
+    cl_log(cl, CL_LEVEL_ERROR, "%s: truncated header (%llu bytes)",
+           ip->ip_path, (unsigned long long)st.st_size);
+    (void)close(fd);
+    return EINVAL;
+  }
+  m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  err = errno;
+  (void)close(fd);
+  if (m == MAP_FAILED) {
+    cl_log_errno(cl, CL_LEVEL_ERROR, "mmap", err, "%s", ip->ip_path);
+    return err;
+  }
+  base = m;
+
+  n = ADDB_GET_U8(((addb_idpack_header const *)base)->lph_n);
+  if (memcmp(base, ADDB_IDPACK_MAGIC, ADDB_MAGIC_SIZE) != 0 ||
+      n % ADDB_IDPACK_BLOCK != 0 || n < ip->ip_n) {
+    cl_log(cl, CL_LEVEL_ERROR, "%s: bad header (n=%llu, had %llu)",
+           ip->ip_path, n, ip->ip_n);
+    err = EINVAL;
+    goto unmap;
+  }
+
+  if (n / ADDB_IDPACK_BLOCK > ip->ip_block_m) {
+    size_t m_new = n / ADDB_IDPACK_BLOCK + 64;
+    addb_id *first;
+    size_t *offset;
+
+    first = cm_realloc(addb->addb_cm, ip->ip_first, m_new * sizeof(*first));
+    if (first == NULL) {
+      err = ENOMEM;
+      goto unmap;
+    }
+    ip->ip_first = first;
+
+    offset = cm_realloc(addb->addb_cm, ip->ip_offset, m_new * sizeof(*offset));
+    if (offset == NULL) {
+      err = ENOMEM;
+      goto unmap;
+    }
+    ip->ip_offset = offset;
+    ip->ip_block_m = m_new;
+  }
+
+  off = ip->ip_size;
+  for (b = ip->ip_n / ADDB_IDPACK_BLOCK; b < n / ADDB_IDPACK_BLOCK; b++) {
+    if (off + 6 > (size_t)st.st_size ||
+        ADDB_IDPACK_WIDTH(base + off) > 34 ||
+        off + ADDB_IDPACK_BLOCK_SIZE(ADDB_IDPACK_WIDTH(base + off)) >
+            (size_t)st.st_size) {
+      cl_log(cl, CL_LEVEL_ERROR, "%s: block %llu at %zu is damaged",
+             ip->ip_path, b, off);
+      err = EINVAL;
+      goto unmap;
+    }
+    ip->ip_first[b] = ADDB_GET_U5(base + off);
+    ip->ip_offset[b] = off;
+    off += ADDB_IDPACK_BLOCK_SIZE(ADDB_IDPACK_WIDTH(base + off));
+  }
+
+  if (ip->ip_base != NULL)
+    (void)addb_file_munmap(cl, ip->ip_path, (char *)ip->ip_base,
+                           ip->ip_map_size);
+  ip->ip_base = base;
+  ip->ip_map_size = st.st_size;
+  ip->ip_size = off;
+  ip->ip_n = n;
+
+  return 0;
+
+unmap:
+  (void)addb_file_munmap(cl, ip->ip_path, m, st.st_size);
+  return err;
+}
+
+/**
+ * @brief Open a pack file.
+ *
+ * @param addb		database handle
+ * @param path		name of the .glp file
+ * @param ip_out	assign the new pack here
+ *
+ * @return 0 on success
+ * @return ENOENT if there is no such file
+ * @return other nonzero error codes on error.
+ */
+int addb_idpack_open(addb_handle *addb, char const *path,
+                     addb_idpack **ip_out) {
+  addb_idpack *ip;
+  int err;
+
+  *ip_out = NULL;
+
+  ip = cm_zalloc(addb->addb_cm, sizeof(*ip) + strlen(path) + 1);
+  if (ip == NULL) return errno ? errno : ENOMEM;
+
+  ip->ip_path = (char *)(ip + 1);
+  strcpy(ip->ip_path, path);
+  ip->ip_size = ADDB_IDPACK_HEADER;
+  ip->ip_cache_block = (unsigned long long)-1;
+
+  err = idpack_map(addb, ip);
+  if (err != 0) {
+    addb_idpack_close(addb, ip);
+    return err;
+  }
+  *ip_out = ip;
+  return 0;
+}
+
+/**
+ * @brief Free a pack and its mapping.  The file stays on disk.
+ */
+void addb_idpack_close(addb_handle *addb, addb_idpack *ip) {
+  if (ip == NULL) return;
+
+  if (ip->ip_base != NULL)
+    (void)addb_file_munmap(addb->addb_cl, ip->ip_path, (char *)ip->ip_base,
+                           ip->ip_map_size);
+  if (ip->ip_first != NULL) cm_free(addb->addb_cm, ip->ip_first);
+  if (ip->ip_offset != NULL) cm_free(addb->addb_cm, ip->ip_offset);
+  cm_free(addb->addb_cm, ip);
+}
+
+/**
+ * @brief Append ids to a pack, creating it if needed.
+ *
+ *  The new blocks are flushed to disk before the header that
+ *  makes them visible is updated (and flushed in turn); a new
+ *  pack file is written under a temporary name and renamed
+ *  into place.  Once this returns successfully, the ids are
+ *  safe on disk.
+ *
+ * @param addb		database handle
+ * @param path		name of the .glp file
+ * @param ip_inout	the pack, or NULL if there isn't one yet.
+ * @param id		ids to append; they must continue the
+ *			ascending sequence already in the pack.
+ * @param n		number of ids, a multiple of ADDB_IDPACK_BLOCK
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_idpack_append(addb_handle *addb, char const *path,
+                       addb_idpack **ip_inout, addb_id const *id, size_t n) {
+  cl_handle *const cl = addb->addb_cl;
+  addb_idpack *const ip = *ip_inout;
+  unsigned char *buf, *p;
+  char const *fname = path;
+  char *tmp = NULL;
+  addb_u8 n_buf;
+  size_t i;
+  int fd, err;
+
+  cl_assert(cl, n % ADDB_IDPACK_BLOCK == 0);
+  if (n == 0) return 0;
+
+  if (ip != NULL && ip->ip_n > 0 &&
+      id[0] <= addb_idpack_get(ip, ip->ip_n - 1)) {
+    cl_log(cl, CL_LEVEL_ERROR, "%s: out-of-order append of %llu",
+           path, (unsigned long long)id[0]);
+    return EINVAL;
+  }
+
+  p = buf = cm_malloc(addb->addb_cm, ADDB_IDPACK_HEADER +
+                                         n / ADDB_IDPACK_BLOCK *
+                                             ADDB_IDPACK_BLOCK_MAX);
+  if (buf == NULL) return errno ? errno : ENOMEM;
+
+  if (ip == NULL) {
+    memset(p, 0, ADDB_IDPACK_HEADER);
+    memcpy(p, ADDB_IDPACK_MAGIC, ADDB_MAGIC_SIZE);
+    ADDB_PUT_U8(((addb_idpack_header *)p)->lph_n, n);
+    p += ADDB_IDPACK_HEADER;
+  }
+  for (i = 0; i < n; i += ADDB_IDPACK_BLOCK) {
+    size_t sz = addb_idpack_encode(id + i, p);
+    if (sz == 0) {
+      cl_log(cl, CL_LEVEL_ERROR, "%s: ids %llu..%llu are not ascending", path,
+             (unsigned long long)id[i],
+             (unsigned long long)id[i + ADDB_IDPACK_BLOCK - 1]);
+      err = EINVAL;
+      goto err;
+    }
+    p += sz;
+  }
+
+  if (ip == NULL) {
+    tmp = cm_sprintf(addb->addb_cm, "%s.tmp", path);
+    if (tmp == NULL) {
+      err = errno ? errno : ENOMEM;
+      goto err;
+    }
+    fname = tmp;
+    fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  } else
+    fd = open(fname, O_WRONLY);
+  if (fd < 0) {
+    err = errno;
+    cl_log_errno(cl, CL_LEVEL_ERROR, "open", err, "%s", fname);
+    goto err;
+  }
+
+  if ((ip != NULL &&
+       (err = addb_file_lseek(addb, fd, fname, ip->ip_size, SEEK_SET)) != 0) ||
+      (err = addb_file_write(addb, fd, fname, (char *)buf, p - buf)) != 0 ||
+      (err = addb_file_sync(addb, fd, fname)) != 0)
+    goto close;
+
+  if (ip != NULL) {
+    /*  The blocks are on disk; now make them count.
+     */
+    ADDB_PUT_U8(n_buf, ip->ip_n + n);
+    if ((err = addb_file_lseek(addb, fd, fname,
+                               offsetof(addb_idpack_header, lph_n),
+                               SEEK_SET)) != 0 ||
+        (err = addb_file_write(addb, fd, fname, (char *)n_buf,
+                               sizeof n_buf)) != 0 ||
+        (err = addb_file_sync(addb, fd, fname)) != 0)
+      goto close;
+  }
+
+  if ((err = addb_file_close(addb, fd, fname)) != 0) goto err;
+  fd = -1;
+
+  if (ip == NULL) {
+    if ((err = addb_file_rename(addb, tmp, path, true)) != 0 ||
+        (err = addb_idpack_open(addb, path, ip_inout)) != 0)
+      goto err;
+  } else if ((err = idpack_map(addb, ip)) != 0)
+    goto err;
+
+  cl_log(cl, CL_LEVEL_DEBUG, "%s: packed %zu ids into %zu bytes", path, n,
+         (size_t)(p - buf));
+  if (tmp != NULL) cm_free(addb->addb_cm, tmp);
+  cm_free(addb->addb_cm, buf);
+  return 0;
+
+close:
+  (void)close(fd);
+err:
+  if (tmp != NULL) {
+    (void)unlink(tmp);
+    cm_free(addb->addb_cm, tmp);
+  }
+  cm_free(addb->addb_cm, buf);
+  return err;
+}
+
+/**
+ * @brief Get the id at an offset in a pack.
+ *
+ *  Decodes (and caches) the block the id lives in.
+ *
+ * @param ip	the pack
+ * @param i	offset, less than ip->ip_n.
+ */
+addb_id addb_idpack_get(addb_idpack *ip, unsigned long long i) {
+  unsigned long long const b = i / ADDB_IDPACK_BLOCK;
+
+  if (b != ip->ip_cache_block) {
+    addb_idpack_unpack(ip->ip_base + ip->ip_offset[b], ADDB_IDPACK_BLOCK,
+                       ip->ip_cache);
+    ip->ip_cache_block = b;
+  }
+  return ip->ip_cache[i % ADDB_IDPACK_BLOCK];
+}
+
+/**
+ * @brief Find the first id >= id in a range of a pack.
+ *
+ *  Same contract as addb_idarray_search(): if there is no
+ *  such id in s..e-1, *off_out is set to e and *id_out to id.
+ *
+ * @param ip	the pack
+ * @param s	first offset to consider
+ * @param e	first offset not to consider, at most ip->ip_n
+ * @param id	id to search for
+ * @param off_out	assign the offset of the id or its successor here
+ * @param id_out	assign the id at *off_out here.
+ */
+void addb_idpack_search(addb_idpack const *ip, unsigned long long s,
+                        unsigned long long e, addb_id id,
+                        unsigned long long *off_out, addb_id *id_out) {
+  unsigned long long lo, hi, b_s;
+  size_t from, to, pos;
+  addb_id val;
+
+  if (s >= e) {
+    *off_out = e;
+    *id_out = id;
+    return;
+  }
+
+  /*  The last block in range that starts at or below id.
+   */
+  lo = s / ADDB_IDPACK_BLOCK;
+  hi = (e - 1) / ADDB_IDPACK_BLOCK + 1;
+  while (hi - lo > 1) {
+    unsigned long long mid = lo + (hi - lo) / 2;
+    if (ip->ip_first[mid] <= id)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  b_s = lo * ADDB_IDPACK_BLOCK;
+  from = s > b_s ? s - b_s : 0;
+  to = e - b_s < ADDB_IDPACK_BLOCK ? e - b_s : ADDB_IDPACK_BLOCK;
+
+  pos = idpack_block_search(ip->ip_base + ip->ip_offset[lo], from, to, id,
+                            &val);
+  if (pos < to) {
+    *off_out = b_s + pos;
+    *id_out = val;
+  } else if (b_s + ADDB_IDPACK_BLOCK < e) {
+    /*  Everything in the next block is larger.
+     */
+    *off_out = b_s + ADDB_IDPACK_BLOCK;
+    *id_out = ip->ip_first[lo + 1];
+  } else {
+    *off_out = e;
+    *id_out = id;
+  }
+}
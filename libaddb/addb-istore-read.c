@@ -67,3 +67,55 @@ int addb_istore_read_loc(addb_istore* is, addb_istore_id id,
   return addb_istore_partition_data_loc(is, part, id % ADDB_ISTORE_INDEX_N,
                                         data_out, file, line);
 }
+
+/**
+ * @brief Start reading a range of primitives into memory.
+ *
+ *  Asks for read-ahead of both the index entries and the data
+ *  of the primitives in [s, e).  Finding where the data ends
+ *  may read one index entry synchronously.
+ *
+ * @param is	istore object, returned by addb_istore_open()
+ * @param s 	first id
+ * @param e 	first id not included
+ * @param stalled	the caller has caught up with its previous
+ *			read-ahead; count that.
+ */
+void addb_istore_prefetch(addb_istore* is, addb_istore_id s, addb_istore_id e,
+                          bool stalled) {
+  addb_istore_id const next = addb_istore_next_id(is);
+
+  if (e > next) e = next;
+  while (s < e) {
+    addb_istore_partition* const part = is->is_partition + (s >> 24);
+    addb_istore_id const part_e = ((s >> 24) + 1) << 24;
+    addb_istore_id const chunk_e = e < part_e ? e : part_e;
+    unsigned long long index_s;
+    off_t data_s, data_e;
+
+    if (part->ipart_td == NULL) break;
+
+    /*  The index entry before s holds the start of s's data.
+     */
+    index_s = ADDB_ISTORE_INDEX_OFFSET(s % ADDB_ISTORE_INDEX_N);
+    if (s % ADDB_ISTORE_INDEX_N != 0) index_s -= ADDB_ISTORE_INDEX_SIZE;
+
+    if (stalled) {
+      addb_tiled_prefetch_stall(part->ipart_td);
+      stalled = false;
+    }
+    (void)addb_tiled_prefetch(
+        part->ipart_td, index_s,
+        ADDB_ISTORE_INDEX_OFFSET((chunk_e - 1) % ADDB_ISTORE_INDEX_N) +
+            ADDB_ISTORE_INDEX_SIZE - index_s);
+
+    if (addb_istore_index_boundaries_get(is, part, s % ADDB_ISTORE_INDEX_N,
+                                         &data_s, &data_e) == 0 &&
+        addb_istore_index_get(is, part, (chunk_e - 1) % ADDB_ISTORE_INDEX_N,
+                              &data_e) == 0 &&
+        data_e > data_s)
+      (void)addb_tiled_prefetch(part->ipart_td, data_s, data_e - data_s);
+
+    s = chunk_e;
+  }
+}
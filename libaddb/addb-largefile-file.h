@@ -27,4 +27,35 @@ typedef struct {
 
 } addb_large_header;
 
+/*
+ * A largefile's sidecar "pack" file, <id>.glp, holds a copy of
+ * the first lph_n ids of the largefile, in blocks of
+ * ADDB_IDPACK_BLOCK ids each:
+ *
+ *    +--------------+
+ *    | first id [5] |  the block's first id
+ *    +--------------+
+ *    | width [1]    |  bits per delta, 0..34
+ *    +--------------+
+ *    | deltas       |  ADDB_IDPACK_BLOCK - 1 values of (id[i] - id[i-1] - 1),
+ *    :              :  <width> bits each, packed little-endian into
+ *    :              :  ceil((ADDB_IDPACK_BLOCK - 1) * width / 8) bytes.
+ *    +--------------+
+ *
+ * The blocks follow a header of ADDB_IDPACK_HEADER bytes.
+ */
+#define ADDB_IDPACK_HEADER 32
+#define ADDB_IDPACK_MAGIC "lpv1"
+#define ADDB_IDPACK_BLOCK 128
+
+/* Largest possible encoded block.
+ */
+#define ADDB_IDPACK_BLOCK_MAX (6 + ((ADDB_IDPACK_BLOCK - 1) * 34 + 7) / 8)
+
+typedef struct {
+  addb_u4 lph_magic;
+  addb_u8 lph_n;
+
+} addb_idpack_header;
+
 #endif
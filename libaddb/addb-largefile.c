@@ -73,7 +73,21 @@ limitations under the License.
  *
  * addb_largefile_append() appends data to file given the handle and id.
  *
+ * Packing.
+ * ========
+ *
+ * If packing is enabled, once a checkpoint has made a stretch of a
+ * largefile durable, that stretch is appended to a sidecar file
+ * <id>.glp in delta-encoded, bit-packed form (see addb-idpack.c),
+ * and the disk blocks behind it in the .glf are released.  From
+ * then on, reads below addb_largefile_pack_end() go to the pack.
+ * A .glp, once there, is always used, whether or not packing is
+ * enabled.
+ */
+
+/*  Don't bother packing fewer new ids than this.
  */
+#define ADDB_LARGEFILE_PACK_STEP (16 * ADDB_IDPACK_BLOCK)
 
 /*
  * One of these structures exists per gmap. (i.e. to, from, type...)
@@ -84,6 +98,8 @@ limitations under the License.
  * largefile structure in the system for debugging.
  */
 struct addb_largefile_handle {
+  addb_handle* lh_addb;
+
   /* Tiled pool to use
    */
   addb_tiled_pool* lh_tdp;
@@ -120,6 +136,10 @@ struct addb_largefile_handle {
   lh_size_get_callback lh_size_get;
   lh_size_set_callback lh_size_set;
   bool lh_no_more_remaps;
+
+  /* Pack checkpointed largefile contents?
+   */
+  bool lh_pack;
 };
 
 /*  Passed to cm_list_.*(addb_largefile, ...) calls
@@ -244,6 +264,67 @@ static char* addb_largefile_name(addb_largefile_handle* handle,
   return fname;
 }
 
+/*
+ * Calculate the file name of a largefile's pack
+ */
+static char* addb_largefile_pack_name(addb_largefile_handle* handle,
+                                      unsigned long long id) {
+  const char *dir_s, *dir_e;
+  getbasedir(handle->lh_basepath, &dir_s, &dir_e);
+
+  return cm_sprintf(handle->lh_cm, "%.*s/large/%llu.glp", (int)(dir_e - dir_s),
+                    dir_s, id);
+}
+
+/*
+ * Drop a largefile's pack from memory; if <delete_on_disk> is set,
+ * remove the .glp file as well.
+ */
+static void addb_largefile_pack_drop(addb_largefile_handle* handle,
+                                     addb_largefile* lf, bool delete_on_disk) {
+  char* pname;
+
+  addb_idpack_close(handle->lh_addb, lf->lf_pack);
+  lf->lf_pack = NULL;
+
+  if (!delete_on_disk) return;
+
+  pname = addb_largefile_pack_name(handle, lf->lf_id);
+  if (pname == NULL) {
+    cl_log(handle->lh_cl, CL_LEVEL_ERROR,
+           "addb_largefile_pack_drop: out of memory");
+    return;
+  }
+  if (unlink(pname) != 0 && errno != ENOENT)
+    cl_log_errno(handle->lh_cl, CL_LEVEL_ERROR, "unlink", errno,
+                 "Can't unlink %s", pname);
+  cm_free(handle->lh_cm, pname);
+}
+
+/*
+ * Load a largefile's pack, if it has one.
+ */
+static int addb_largefile_pack_load(addb_largefile_handle* handle,
+                                    addb_largefile* lf) {
+  char* pname;
+  int err;
+
+  if (lf->lf_pack != NULL) return 0;
+
+  pname = addb_largefile_pack_name(handle, lf->lf_id);
+  if (pname == NULL) return errno ? errno : ENOMEM;
+
+  err = addb_idpack_open(handle->lh_addb, pname, &lf->lf_pack);
+  if (err == ENOENT)
+    err = 0;
+  else if (err != 0)
+    cl_log_errno(handle->lh_cl, CL_LEVEL_ERROR, "addb_idpack_open", err,
+                 "Can't load pack for largefile %llu", lf->lf_id);
+  cm_free(handle->lh_cm, pname);
+
+  return err;
+}
+
 /**
  * @brief open a largefile.
  *
@@ -328,6 +409,11 @@ static int addb_largefile_load(addb_largefile_handle* handle,
 
     memcpy(h->lhr_magic, ADDB_LARGE_MAGIC, ADDB_MAGIC_SIZE);
     lf->lf_size = ADDB_LARGE_HEADER;
+
+    /* A pack left over from an earlier life of this id
+     * would shadow the new contents.
+     */
+    addb_largefile_pack_drop(handle, lf, true);
   } else {
     h = addb_tiled_get(lf->lf_td, 0, ADDB_LARGE_HEADER, ADDB_MODE_READ, &r);
     if (!h) {
@@ -362,9 +448,22 @@ static int addb_largefile_load(addb_largefile_handle* handle,
     goto free_td;
   }
 
-  cm_free(handle->lh_cm, fname);
   addb_tiled_free(lf->lf_td, &r);
 
+  if (!(flags & O_CREAT)) {
+    err = addb_largefile_pack_load(handle, lf);
+    if (err) goto free_td;
+
+    if (!lf->lf_setting_up && lf->lf_size < addb_largefile_pack_end(lf)) {
+      cl_log(handle->lh_cl, CL_LEVEL_ERROR,
+             "Largefile %s: size %llu is inside its pack (%llu ids)", fname,
+             (unsigned long long)lf->lf_size, lf->lf_pack->ip_n);
+      err = ADDB_ERR_DATABASE;
+      goto free_td;
+    }
+  }
+  cm_free(handle->lh_cm, fname);
+
   lf->lf_dirty = false;
 
   return 0;
@@ -372,6 +471,7 @@ static int addb_largefile_load(addb_largefile_handle* handle,
 free_td:
   addb_tiled_destroy(lf->lf_td);
   lf->lf_td = (addb_tiled*)0;
+  addb_largefile_pack_drop(handle, lf, false);
 
 free_fname:
   cm_free(handle->lh_cm, fname);
@@ -432,6 +532,8 @@ static int addb_largefile_open(addb_largefile_handle* handle,
     lf->lf_td = NULL;
     lf->lf_setting_up = false;
     lf->lf_delete = false;
+    lf->lf_pack = NULL;
+    lf->lf_pack_mark = 0;
   }
 
   if (lf->lf_td) {
@@ -500,6 +602,13 @@ void addb_largefile_set_maxlf(addb_largefile_handle* handle, int m) {
   handle->lh_max_lf = m;
 }
 
+/**
+ * @brief turn packing of checkpointed largefile contents on or off
+ */
+void addb_largefile_set_pack(addb_largefile_handle* handle, bool pack) {
+  handle->lh_pack = pack;
+}
+
 /**
  * @brief create a addb_largefile_handle
  *
@@ -527,6 +636,7 @@ addb_largefile_handle* addb_largefile_init(char* path, addb_handle* addb,
 
   if (!lh) return NULL;
 
+  lh->lh_addb = addb;
   lh->lh_tdp = addb->addb_master_tiled_pool;
   cl_assert(cl, lh->lh_tdp != NULL);
 
@@ -552,6 +662,7 @@ addb_largefile_handle* addb_largefile_init(char* path, addb_handle* addb,
   lh->lh_file_thrash_count_step = 0;
   lh->lh_soft_limit_exceeded = false;
   lh->lh_no_more_remaps = false;
+  lh->lh_pack = false;
 
   cl_log(cl, CL_LEVEL_DEBUG, "Initializing largefiles under path: %s", path);
 
@@ -576,6 +687,7 @@ void addb_largefile_close(addb_largefile_handle* handle) {
       lf->lf_td = NULL;
     }
     if (lf->lf_display_name) cm_free(handle->lh_cm, lf->lf_display_name);
+    addb_idpack_close(handle->lh_addb, lf->lf_pack);
   }
   cm_hashdestroy(handle->lh_hash);
   cm_free(handle->lh_cm, handle);
@@ -680,6 +792,12 @@ int addb_largefile_read5(addb_largefile* lf, size_t offset,
     }
   }
 
+  if (offset < addb_largefile_pack_end(lf)) {
+    *out = addb_idpack_get(lf->lf_pack, (offset - ADDB_LARGE_HEADER) /
+                                            ADDB_GMAP_ENTRY_SIZE);
+    return 0;
+  }
+
   if (addb_tiled_peek5(lf->lf_td, offset, out)) return 0;
 
   if (offset / ADDB_TILE_SIZE ==
@@ -772,6 +890,105 @@ int addb_largefile_read_raw(addb_largefile* lf, unsigned long long offset,
   return 0;
 }
 
+/**
+ * @brief Expand packed ids into their five-byte representation.
+ *
+ *  Like addb_largefile_read_raw(), but for offsets below
+ *  addb_largefile_pack_end(); the bytes are written to a
+ *  caller-supplied buffer.
+ *
+ * @param lf		largefile management structure
+ * @param offset	first byte to retrieve
+ * @param end		first byte to not retrieve
+ * @param buf		buffer to expand into
+ * @param buf_size	size of buf, at least ADDB_GMAP_ENTRY_SIZE bytes.
+ * @param ptr_out	assign data pointer to this
+ * @param end_out	assign adjusted "end" offset to this
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_largefile_read_packed(addb_largefile* lf, unsigned long long offset,
+                               unsigned long long end, unsigned char* buf,
+                               size_t buf_size, unsigned char const** ptr_out,
+                               unsigned long long* end_out) {
+  unsigned long long const pack_end = addb_largefile_pack_end(lf);
+  unsigned long long i, i_end;
+  unsigned char* p = buf;
+
+  if (lf->lf_pack == NULL || offset >= pack_end || offset < ADDB_LARGE_HEADER)
+    return EINVAL;
+
+  if (end > pack_end) end = pack_end;
+
+  i = (offset - ADDB_LARGE_HEADER) / ADDB_GMAP_ENTRY_SIZE;
+  i_end = (end - ADDB_LARGE_HEADER + ADDB_GMAP_ENTRY_SIZE - 1) /
+          ADDB_GMAP_ENTRY_SIZE;
+  if (i_end - i > buf_size / ADDB_GMAP_ENTRY_SIZE)
+    i_end = i + buf_size / ADDB_GMAP_ENTRY_SIZE;
+
+  *ptr_out = buf + (offset - ADDB_LARGE_HEADER) % ADDB_GMAP_ENTRY_SIZE;
+  *end_out = ADDB_LARGE_HEADER + i_end * ADDB_GMAP_ENTRY_SIZE;
+  if (*end_out > end) *end_out = end;
+
+  for (; i < i_end; i++, p += ADDB_GMAP_ENTRY_SIZE)
+    ADDB_PUT_U5(p, addb_idpack_get(lf->lf_pack, i));
+
+  return 0;
+}
+
+/**
+ * @brief Find the offset of an id in a largefile.
+ *
+ *  Same contract as addb_idarray_search(), with s and e
+ *  counting ids from the start of the data.  The packed part
+ *  is searched via its skip table, the rest by bisection.
+ *
+ * @param lf		largefile management structure
+ * @param s		the start of the offset range in which to search
+ * @param e		first excluded offset
+ * @param id		id to search for
+ * @param off_out 	assign the offset of id, or of the next larger id, here
+ * @param id_out	assign the id at offset here
+ *
+ * @return 0 on success, a nonzero error code on unexpected error.
+ */
+int addb_largefile_search(addb_largefile* lf, unsigned long long s,
+                          unsigned long long e, addb_id id,
+                          unsigned long long* off_out, addb_id* id_out) {
+  unsigned long long const e_orig = e;
+  addb_id endval = id;
+  int err;
+
+  if (lf->lf_pack != NULL && s < lf->lf_pack->ip_n) {
+    unsigned long long pe = e < lf->lf_pack->ip_n ? e : lf->lf_pack->ip_n;
+
+    addb_idpack_search(lf->lf_pack, s, pe, id, off_out, id_out);
+    if (*off_out < pe) return 0;
+    s = pe;
+  }
+
+  while (s < e) {
+    unsigned long long middle = s + (e - s) / 2;
+    unsigned long long val;
+
+    err = addb_largefile_read5(
+        lf, ADDB_LARGE_HEADER + middle * ADDB_GMAP_ENTRY_SIZE, &val);
+    if (err != 0) return err;
+
+    val = ADDB_GMAP_LOW_34(val);
+    if (val < id)
+      s = middle + 1;
+    else {
+      e = middle;
+      endval = val;
+    }
+  }
+  *off_out = s;
+  *id_out = s < e_orig ? endval : id;
+
+  return 0;
+}
+
 /**
  * @brief append some data to a largefile
  *
@@ -965,6 +1182,17 @@ int addb_largefile_status(addb_largefile_handle* handle,
                    val)))
     return err;
 
+  total_size = 0;
+  if (handle) {
+    for (c = handle->lh_list; c; c = c->lf_next)
+      if (c->lf_pack != NULL) total_size += c->lf_pack->ip_n;
+  }
+
+  snprintf(val, sizeof val, "%llu", total_size);
+  if ((err = (*cb)(cb_handle, cm_prefix_end(&lf_pre, "open-files-packed-ids"),
+                   val)))
+    return err;
+
   snprintf(val, sizeof val, "%i", handle ? handle->lh_soft_limit_exceeded : 0);
 
   if ((err = (*cb)(cb_handle,
@@ -1020,8 +1248,8 @@ int addb_largefile_status_tiles(addb_largefile_handle* handle,
 
 /*
  * delete every glf file under <basepath>/large. Only delete
- * files ending in .glf.  We cannot check for valid magic
- * numbers because the largefile may be deleted before being
+ * files ending in .glf and their packs.  We cannot check for valid
+ * magic numbers because the largefile may be deleted before being
  * flushed to disk.
  */
 int addb_largefile_remove(const char* p, cl_handle* cl, cm_handle* cm) {
@@ -1049,7 +1277,10 @@ int addb_largefile_remove(const char* p, cl_handle* cl, cm_handle* cm) {
     if (!strcmp(de->d_name, ".")) continue;
     if (!strcmp(de->d_name, "..")) continue;
     suffix = strrchr(de->d_name, '.');
-    if (!suffix || strcmp(suffix, ".glf")) {
+    if (!suffix ||
+        (strcmp(suffix, ".glf") && strcmp(suffix, ".glp") &&
+         (strcmp(suffix, ".tmp") || suffix - de->d_name < 4 ||
+          strncmp(suffix - 4, ".glp", 4)))) {
       cl_log(cl, CL_LEVEL_ERROR,
              "Refusing to delete unknown file:"
              " %s living in %s.",
@@ -1125,6 +1356,8 @@ static void addb_largefile_dead(addb_largefile_handle* lh, addb_largefile* lf,
                  lf->lf_display_name);
   }
 
+  addb_largefile_pack_drop(lh, lf, delete_on_disk);
+
   if (delete_on_disk) {
     rv = unlink(fname);
 
@@ -1145,6 +1378,62 @@ static void addb_largefile_dead(addb_largefile_handle* lh, addb_largefile* lf,
   cm_free(lh->lh_cm, fname);
 }
 
+/*
+ * Pack what the last checkpoint made durable, if there's enough of it,
+ * and release the disk space behind it.
+ */
+static int addb_largefile_pack(addb_largefile_handle* lh, addb_largefile* lf) {
+  unsigned long long have, want, i, old_end, new_end;
+  addb_id* ids;
+  char* pname;
+  int err = 0;
+
+  have = lf->lf_pack == NULL ? 0 : lf->lf_pack->ip_n;
+  want = lf->lf_pack_mark <= ADDB_LARGE_HEADER
+             ? 0
+             : (lf->lf_pack_mark - ADDB_LARGE_HEADER) / ADDB_GMAP_ENTRY_SIZE;
+  want -= want % ADDB_IDPACK_BLOCK;
+  if (want < have + ADDB_LARGEFILE_PACK_STEP) return 0;
+
+  ids = cm_malloc(lh->lh_cm, (want - have) * sizeof(*ids));
+  if (ids == NULL) return errno ? errno : ENOMEM;
+
+  for (i = have; i < want; i++) {
+    unsigned long long val;
+
+    err = addb_largefile_read5(
+        lf, ADDB_LARGE_HEADER + i * ADDB_GMAP_ENTRY_SIZE, &val);
+    if (err != 0) goto done;
+    ids[i - have] = ADDB_GMAP_LOW_34(val);
+  }
+
+  pname = addb_largefile_pack_name(lh, lf->lf_id);
+  if (pname == NULL) {
+    err = errno ? errno : ENOMEM;
+    goto done;
+  }
+
+  old_end = addb_largefile_pack_end(lf);
+  err = addb_idpack_append(lh->lh_addb, pname, &lf->lf_pack, ids, want - have);
+  cm_free(lh->lh_cm, pname);
+  if (err != 0) goto done;
+
+  /*  The pack is on disk; give back the tiles that are now
+   *  entirely packed.  (Never the first one; it has the header.)
+   */
+  old_end = addb_round_down(old_end, ADDB_TILE_SIZE);
+  if (old_end < ADDB_TILE_SIZE) old_end = ADDB_TILE_SIZE;
+  new_end = addb_round_down(addb_largefile_pack_end(lf), ADDB_TILE_SIZE);
+  if (old_end < new_end) err = addb_tiled_punch(lf->lf_td, old_end, new_end);
+
+  cl_log(lh->lh_cl, CL_LEVEL_DEBUG,
+         "addb_largefile_pack: %s:%llu: packed %llu..%llu", lh->lh_basepath,
+         lf->lf_id, have, want);
+done:
+  cm_free(lh->lh_cm, ids);
+  return err;
+}
+
 /* Iterate over large files, applying a checkpoint function
  */
 int addb_largefile_checkpoint(addb_largefile_handle* lh,
@@ -1186,10 +1475,21 @@ int addb_largefile_checkpoint(addb_largefile_handle* lh,
       return err;
     }
 
+    if (cpfn == addb_tiled_checkpoint_start_writes)
+      lf->lf_pack_mark = lf->lf_size;
+
     if (cpfn == addb_tiled_checkpoint_remove_backup) {
       if (lf->lf_delete) {
         lf->lf_delete_count--;
         if (lf->lf_delete_count == 0) addb_largefile_dead(lh, lf, true);
+      } else if (lh->lh_pack && !lf->lf_setting_up) {
+        /* Packing is an optimization; if it fails,
+         * the data simply stays where it is.
+         */
+        int e = addb_largefile_pack(lh, lf);
+        if (e != 0)
+          cl_log_errno(lh->lh_cl, CL_LEVEL_FAIL, "addb_largefile_pack", e,
+                       "%s:%llu", lh->lh_basepath, lf->lf_id);
       }
     }
   }
@@ -1231,6 +1531,8 @@ int addb_largefile_rollback(addb_largefile_handle* lh,
       continue;
     }
 
+    if (lf->lf_pack_mark > lf->lf_size) lf->lf_pack_mark = lf->lf_size;
+
     if (lf->lf_size == 0) {
       /*
        *  If there's no error, but the size was set to zero,
@@ -1239,6 +1541,7 @@ int addb_largefile_rollback(addb_largefile_handle* lh,
        */
 
       addb_tiled_destroy(lf->lf_td);
+      addb_largefile_pack_drop(lh, lf, true);
 
       /*
        * Delete the largefile
@@ -1278,6 +1581,15 @@ int addb_largefile_rollback(addb_largefile_handle* lh,
       cm_list_remove(addb_largefile, addb_largefile_offsets, &lh->lh_list,
                      &lh->lh_list_tail, lf);
       cm_hashdelete(lh->lh_hash, lf);
+    } else if (lf->lf_size < addb_largefile_pack_end(lf)) {
+      /*  We only pack what a completed checkpoint wrote,
+       *  so this shouldn't happen.
+       */
+      cl_log(lh->lh_cl, CL_LEVEL_ERROR,
+             "addb_largefile_rollback: largefile %llu rolled back to "
+             "%llu bytes, inside its pack of %llu ids",
+             lf->lf_id, (unsigned long long)lf->lf_size, lf->lf_pack->ip_n);
+      if (!err) err = ADDB_ERR_DATABASE;
     }
   }
 
@@ -1353,6 +1665,16 @@ int addb_largefile_refresh(addb_largefile_handle* lh) {
       continue;
     }
 
+    /*
+     * The pack may have grown, too.
+     */
+    addb_largefile_pack_drop(lh, lf, false);
+    err = addb_largefile_pack_load(lh, lf);
+    if (err) {
+      cm_free(lh->lh_cm, name);
+      return err;
+    }
+
     lf->lf_size = size;
     cm_free(lh->lh_cm, name);
   }
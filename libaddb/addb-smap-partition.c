@@ -348,6 +348,22 @@ int addb_smap_partition_open(addb_smap_partition *part, int mode) {
   err = addb_tiled_read_backup(part->part_td, sm->sm_horizon);
   if (err) goto err;
 
+  /*  Replaying a redo log may have grown the partition past the
+   *  size we read from the header earlier.
+   */
+  if (addb->addb_redo_log != 0) {
+    addb_tiled_reference tref;
+    char const *hdr = addb_tiled_get(part->part_td, 0, ADDB_GMAP_HEADER_SIZE,
+                                     ADDB_MODE_READ, &tref);
+    if (hdr == NULL) {
+      err = errno ? errno : ENOMEM;
+      goto err;
+    }
+    if (ADDB_GET_U8(hdr + ADDB_GMAP_VSIZE_OFFSET) > part->part_size)
+      part->part_size = ADDB_GET_U8(hdr + ADDB_GMAP_VSIZE_OFFSET);
+    addb_tiled_free(part->part_td, &tref);
+  }
+
   cl_log(cl, CL_LEVEL_DEBUG, "addb: open \"%s\": size %llu", part->part_path,
          (unsigned long long)part->part_size);
 
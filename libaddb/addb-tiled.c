@@ -117,8 +117,25 @@ struct addb_tile {
   unsigned short tile_dirty_bits;
   /*  dirty bit for each page in the tile */
   unsigned short tile_scheduled_bits;
+
+  /*  When did the tile last go from clean to dirty?
+   */
+  addb_msclock_t tile_dirty_since;
 };
 
+/*  Buckets of the dirty tile age histogram: tiles that were
+ *  dirty for up to 10ms, 100ms, 1s, 10s, 1min, or longer when
+ *  a checkpoint picked them up.
+ */
+#define ADDB_TILED_DIRTY_AGE_N 6
+
+static const struct {
+  addb_msclock_t age_max;
+  char const* age_name;
+} addb_tiled_dirty_age[ADDB_TILED_DIRTY_AGE_N] = {
+    {10, "10ms"},    {100, "100ms"}, {1000, "1s"},
+    {10000, "10s"}, {60000, "1m"},  {(addb_msclock_t)-1, "more"}};
+
 #define ADDB_TILE_IS_DIRTY(T__) \
   ((T__) && ((T__)->tile_dirty_bits || (T__)->tile_scheduled_bits))
 
@@ -189,6 +206,25 @@ struct addb_tiled {
   /* Have we started mmapping individual tiles?
    */
   unsigned int td_mmap_indv_tile : 1;
+
+  /*  Read-ahead statistics (addb_tiled_prefetch()): requests
+   *  that found their pages in core already, requests that
+   *  had to ask the kernel, and readers that overtook their
+   *  read-ahead.
+   */
+  unsigned long long td_prefetch_hit;
+  unsigned long long td_prefetch_miss;
+  unsigned long long td_prefetch_stall;
+
+  /*  Dirty tiles by age when they were scheduled; see
+   *  addb_tiled_dirty_age.
+   */
+  unsigned long long td_dirty_age[ADDB_TILED_DIRTY_AGE_N];
+
+  /*  NULL, or where we tell the writeback thread about
+   *  tiles written in place.
+   */
+  addb_writeback_file* td_writeback;
 };
 
 /* Compute the number of tiles in the initial mmap region
@@ -246,6 +282,13 @@ struct addb_tiled_pool {
   bool tdp_have_mmapped_tile;
 };
 
+/*  Does this tiled file checkpoint through a redo log rather
+ *  than through backup files?  (See addb_set_redo_log().)
+ */
+static bool addb_tiled_redo(addb_tiled const* td) {
+  return td->td_tbk.tbk_do_backup && td->td_pool->tdp_addb->addb_redo_log != 0;
+}
+
 #define ADDB_TILED_TREF_MAKE_INITMAP(size) ((size_t)(-1L - (long)(size)))
 #define ADDB_TILED_TREF_IS_INITMAP(ref) ((long)(ref) < -1)
 #define ADDB_TILED_TREF_INITMAP_SIZE(ref) (-((long)(ref) + 1))
@@ -842,7 +885,8 @@ static int addb_tiled_modify_start(addb_tiled* const td, addb_tile* const tile,
   cl_assert(cl, new_dirty_bits);
 
   if (tile->tile_dirty_bits != (tile->tile_dirty_bits | new_dirty_bits)) {
-    if (td->td_tbk.tbk_do_backup && td->td_advance_backup) {
+    if (td->td_tbk.tbk_do_backup && td->td_advance_backup &&
+        !addb_tiled_redo(td)) {
       int err = addb_tiled_page_backup(
           td, tile, (tile->tile_dirty_bits ^ new_dirty_bits) & new_dirty_bits);
 
@@ -882,6 +926,7 @@ static int addb_tiled_modify_start(addb_tiled* const td, addb_tile* const tile,
 
       if (!tile->tile_memory_disk) tile->tile_memory_disk = tile->tile_memory;
       tile->tile_memory = mem;
+      tile->tile_dirty_since = addb_msclock(td->td_pool->tdp_addb);
 
       td->td_tile_dirty++;
     }
@@ -957,6 +1002,16 @@ void* addb_tiled_get_loc(addb_tiled* const td, unsigned long long s,
     return NULL;
   }
 
+  /*  Writes that go to the file in place can be written
+   *  back in the background.
+   */
+  if ((mode & ADDB_MODE_WRITE) && td->td_writeback != NULL &&
+      !(tdp->tdp_addb->addb_transactional && td->td_tbk.tbk_do_backup)) {
+    addb_writeback_note(tdp->tdp_addb, td->td_writeback, tile_min);
+    if (tile_max != tile_min)
+      addb_writeback_note(tdp->tdp_addb, td->td_writeback, tile_max);
+  }
+
   /* Use the initial mmap if:
    *
    *	(a) we are not writing transactionally, and
@@ -1401,6 +1456,40 @@ static int addb_tiled_backup_abort(addb_tiled* td) {
   return 0;
 }
 
+/**
+ * @brief Remove a redo log whose pages are in the file.
+ *
+ *  A published redo log stays around after its pages have been
+ *  copied into the mapped file, until the file is synced.  If a
+ *  checkpoint started that sync, wait for it to finish; if <now>
+ *  is set, sync the file ourselves.  Then remove the log.
+ *
+ * @param td	tiled handle
+ * @param now	sync the file if no sync is running.
+ * @return 0 on success, a nonzero error code otherwise
+ */
+static int addb_tiled_redo_retire(addb_tiled* td, bool now) {
+  addb_handle* const addb = td->td_pool->tdp_addb;
+  addb_tbk* const tbk = &td->td_tbk;
+  int err;
+
+  if (tbk->tbk_retiring) {
+    tbk->tbk_retiring = 0;
+    err =
+        addb_file_sync_finish(addb->addb_cl, &tbk->tbk_fsc, true, td->td_path);
+  } else if (now && tbk->tbk_published && addb_tiled_redo(td))
+    err = addb_file_sync(addb, td->td_fd, td->td_path);
+  else
+    return 0;
+
+  if (err) return err;
+
+  cl_log(addb->addb_cl, CL_LEVEL_SPEW | ADDB_FACILITY_TILE,
+         "%s: retiring %llu bytes of redo log.", td->td_path, tbk->tbk_v_size);
+
+  return addb_backup_unpublish(addb, tbk);
+}
+
 /**
  * @brief Free a tiled file handle.
  * @param td	NULL or a tiled descriptor to destroy.
@@ -1416,6 +1505,12 @@ int addb_tiled_destroy(addb_tiled* td) {
     cl_log(tdp->tdp_cl, CL_LEVEL_ERROR | ADDB_FACILITY_TILE,
            "addb_tiled_destroy %s losing uncommited changes", td->td_path);
 
+  /*  Between checkpoints, everything in the redo log is
+   *  in the file already.
+   */
+  err = addb_tiled_redo_retire(td, td->td_checkpoint_stage == ADDB_CKS_DONE);
+  if (!result) result = err;
+
   err = addb_tiled_backup_abort(td);
   if (!result) result = err;
   if (td->td_first_map_size &&
@@ -1458,6 +1553,8 @@ int addb_tiled_destroy(addb_tiled* td) {
     cm_free(tdp->tdp_cm, td->td_tile);
   }
 
+  addb_writeback_file_destroy(tdp->tdp_addb, td->td_writeback);
+
   if (close(td->td_fd) < 0) {
     err = errno;
     cl_log_errno(tdp->tdp_cl, CL_LEVEL_ERROR, "close", err,
@@ -1541,6 +1638,19 @@ int addb_tiled_apply_backup_record(addb_tiled* td, unsigned long long offset,
   cl_assert(td->td_pool->tdp_cl,
             td->td_pool->tdp_total >= td->td_pool->tdp_total_linked);
 
+  /*  A redo log can hold pages past the end of a file whose
+   *  growth didn't make it to disk before a crash.
+   */
+  if (offset + size > td->td_physical_file_size) {
+    unsigned long long const phys_size =
+        addb_round_up(offset + size, ADDB_TILE_SIZE);
+
+    err = addb_file_grow(td->td_pool->tdp_cl, td->td_fd, td->td_path,
+                         phys_size);
+    if (err) return err;
+    td->td_physical_file_size = phys_size;
+  }
+
   target = addb_tiled_get(td, offset, offset + size, ADDB_MODE_BACKUP, &tref);
   if (!target) {
     err = errno;
@@ -1707,6 +1817,7 @@ addb_tiled* addb_tiled_create(addb_tiled_pool* tdp, char* path, int mode,
   }
 
   td->td_fd = fd;
+  td->td_writeback = addb_writeback_file_create(tdp->tdp_addb, fd);
   td->td_pool = tdp;
   td->td_physical_file_size = file_size;
   td->td_first_map_size = first_map_size;
@@ -1738,6 +1849,8 @@ int addb_tiled_backup(addb_tiled* td, bool on) {
      * the file in question.  Abort changes and remove any published
      * backup files.
      */
+    e = addb_tiled_redo_retire(td, false);
+    if (e) err = e;
     e = addb_tiled_backup_abort(td);
     if (e) err = e;
     e = addb_backup_unpublish(td->td_pool->tdp_addb, &td->td_tbk);
@@ -1768,6 +1881,9 @@ int addb_tiled_read_backup(addb_tiled* td, unsigned long long horizon) {
   cl_assert(tdp->tdp_cl, td->td_tbk.tbk_v_path);
   cl_assert(tdp->tdp_cl, tdp->tdp_total >= tdp->tdp_total_linked);
 
+  err = addb_tiled_redo_retire(td, false);
+  if (err) return err;
+
   /* Abort any planned modifications, we're going back into the past.
    */
   err = addb_tiled_backup_abort(td);
@@ -1801,6 +1917,11 @@ int addb_tiled_read_backup(addb_tiled* td, unsigned long long horizon) {
     if (err) return err;
   }
 
+  /*  Either way, the backup file is gone now.
+   */
+  td->td_tbk.tbk_published = 0;
+  td->td_tbk.tbk_v_size = 0;
+
   cl_log(tdp->tdp_addb->addb_cl, CL_LEVEL_SPEW | ADDB_FACILITY_TILE,
          "[%llu] %s: done reading backup.",
          (unsigned long long)addb_msclock(tdp->tdp_addb), td->td_path);
@@ -1808,6 +1929,93 @@ int addb_tiled_read_backup(addb_tiled* td, unsigned long long horizon) {
   return err;
 }
 
+/*  Are all pages in [ptr, ptr + n) in core?  <ptr> is page-aligned.
+ */
+static bool addb_tiled_in_core(char* ptr, size_t n, size_t page_size) {
+  unsigned char v[256];
+
+  while (n > 0) {
+    size_t chunk = n > sizeof(v) * page_size ? sizeof(v) * page_size : n;
+    size_t i, n_pages = (chunk + page_size - 1) / page_size;
+
+    if (mincore(ptr, chunk, v) != 0) return false;
+    for (i = 0; i < n_pages; i++)
+      if (!(v[i] & 1)) return false;
+
+    ptr += chunk;
+    n -= chunk;
+  }
+  return true;
+}
+
+/**
+ * @brief Start reading part of a tiled file into memory.
+ *
+ *  Asks the kernel to read [s, s + n) in the background, so
+ *  that a later addb_tiled_get() or addb_tiled_peek() of that
+ *  range doesn't stop on a page fault.  Parts that are covered
+ *  by the initial map are checked with mincore() first, and
+ *  left alone if they're in core already.
+ *
+ *  This is advice; nothing breaks if it fails.
+ *
+ * @param td	tiled partition to read
+ * @param s	first byte
+ * @param n	number of bytes
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int addb_tiled_prefetch(addb_tiled* td, unsigned long long s,
+                        unsigned long long n) {
+  cl_handle* const cl = td->td_pool->tdp_cl;
+  size_t const page_size = getpagesize();
+  unsigned long long e = s + n;
+  int err = 0;
+
+  if (e > td->td_physical_file_size) e = td->td_physical_file_size;
+  if (s >= e) return 0;
+
+  s = addb_round_down(s, page_size);
+  e = addb_round_up(e, page_size);
+
+  if (s < td->td_first_map_size && td->td_first_map != NULL) {
+    unsigned long long const map_e =
+        e < td->td_first_map_size ? e : td->td_first_map_size;
+    char* const ptr = (char*)td->td_first_map + s;
+
+    if (map_e >= e && addb_tiled_in_core(ptr, map_e - s, page_size)) {
+      td->td_prefetch_hit++;
+      return 0;
+    }
+    if (madvise(ptr, map_e - s, MADV_WILLNEED) != 0) {
+      err = errno;
+      cl_log_errno(cl, CL_LEVEL_VERBOSE | ADDB_FACILITY_TILE, "madvise", err,
+                   "%s: %llu..%llu", td->td_path, s, map_e);
+    }
+    s = map_e;
+  }
+  if (s < e) {
+    /*  Beyond the initial map, tiles come and go; have the
+     *  kernel read the file into its page cache instead.
+     */
+    int fa_err = posix_fadvise(td->td_fd, s, e - s, POSIX_FADV_WILLNEED);
+    if (fa_err != 0) {
+      err = fa_err;
+      cl_log_errno(cl, CL_LEVEL_VERBOSE | ADDB_FACILITY_TILE, "posix_fadvise",
+                   err, "%s: %llu..%llu", td->td_path, s, e);
+    }
+  }
+  td->td_prefetch_miss++;
+  return err;
+}
+
+/**
+ * @brief Count a reader that got ahead of its read-ahead.
+ *
+ * @param td	tiled partition the reader is reading
+ */
+void addb_tiled_prefetch_stall(addb_tiled* td) { td->td_prefetch_stall++; }
+
 #ifdef SHOW_STATUS_IN_CORE
 
 static double addb_tiled_percent_in_core(addb_tiled* td) {
@@ -1876,6 +2084,53 @@ int addb_tiled_status(addb_tiled* td, cm_prefix const* prefix,
   err = (*cb)(cb_data, cm_prefix_end(&tile_pre, "init-map"), num_buf);
   if (err) return err;
 
+  /*  Read-ahead
+   */
+  snprintf(num_buf, sizeof num_buf, "%llu", td->td_prefetch_hit);
+  err = (*cb)(cb_data, cm_prefix_end(&tile_pre, "prefetch-hit"), num_buf);
+  if (err) return err;
+
+  snprintf(num_buf, sizeof num_buf, "%llu", td->td_prefetch_miss);
+  err = (*cb)(cb_data, cm_prefix_end(&tile_pre, "prefetch-miss"), num_buf);
+  if (err) return err;
+
+  snprintf(num_buf, sizeof num_buf, "%llu", td->td_prefetch_stall);
+  err = (*cb)(cb_data, cm_prefix_end(&tile_pre, "prefetch-stall"), num_buf);
+  if (err) return err;
+
+  /*  How old dirty tiles were when a checkpoint picked them up.
+   */
+  {
+    cm_prefix age_pre = cm_prefix_push(&tile_pre, "dirty-age");
+    size_t i;
+
+    for (i = 0; i < ADDB_TILED_DIRTY_AGE_N; i++) {
+      snprintf(num_buf, sizeof num_buf, "%llu", td->td_dirty_age[i]);
+      err = (*cb)(cb_data,
+                  cm_prefix_end_string(&age_pre,
+                                       addb_tiled_dirty_age[i].age_name),
+                  num_buf);
+      if (err) return err;
+    }
+  }
+
+  /*  Background writeback.
+   */
+  if (td->td_writeback != NULL) {
+    unsigned long long bytes, rate;
+
+    addb_writeback_file_stats(td->td_pool->tdp_addb, td->td_writeback, &bytes,
+                              &rate);
+
+    snprintf(num_buf, sizeof num_buf, "%llu", bytes);
+    err = (*cb)(cb_data, cm_prefix_end(&tile_pre, "writeback-bytes"), num_buf);
+    if (err) return err;
+
+    snprintf(num_buf, sizeof num_buf, "%llu", rate);
+    err = (*cb)(cb_data, cm_prefix_end(&tile_pre, "writeback-rate"), num_buf);
+    if (err) return err;
+  }
+
 #ifdef SHOW_STATUS_IN_CORE
 
   /*  The percentage of this file in core
@@ -1981,6 +2236,7 @@ int addb_tiled_status_tiles(addb_tiled* td, cm_prefix const* prefix,
  */
 
 static void addb_schedule_dirty_tiles(cl_handle* cl, addb_tiled* td) {
+  addb_msclock_t const now = addb_msclock(td->td_pool->tdp_addb);
   addb_tile* tile;
   addb_tile* last_tile;
 
@@ -1994,11 +2250,17 @@ static void addb_schedule_dirty_tiles(cl_handle* cl, addb_tiled* td) {
   tile = td->td_scheduled_head;
   last_tile = tile;
   while (tile) {
+    size_t age_i = 0;
+
     cl_assert(cl, tile->tile_dirty_bits);
     cl_assert(cl, tile->tile_memory);
     cl_assert(cl, !tile->tile_memory_scheduled);
     cl_assert(cl, !tile->tile_scheduled_bits);
 
+    while (now - tile->tile_dirty_since > addb_tiled_dirty_age[age_i].age_max)
+      age_i++;
+    td->td_dirty_age[age_i]++;
+
     tile->tile_memory_scheduled = tile->tile_memory;
     tile->tile_scheduled_bits = tile->tile_dirty_bits;
     tile->tile_dirty_bits = 0;
@@ -2009,6 +2271,159 @@ static void addb_schedule_dirty_tiles(cl_handle* cl, addb_tiled* td) {
   td->td_tile_dirty = 0;
 }
 
+/*  Copy the scheduled pages into the mapped file, and return
+ *  the tiles to the dirty- or free-lists as appropriate.
+ *  Returns the number of tiles that were scheduled.
+ */
+static size_t addb_tiled_write_scheduled(addb_tiled* td) {
+  cl_handle* const cl = td->td_pool->tdp_cl;
+  size_t const ps = getpagesize();
+  size_t const pages_per_tile = ADDB_TILE_SIZE / ps;
+  addb_tile* tile;
+  addb_tile* last_tile;
+  size_t n_scheduled = 0;
+
+  /* Copy modified tile contents into the memory mapped file
+   * Note that the tile may have been written again which
+   * would cause tile_memory to be different from
+   * tile_memory_scheduled.
+   */
+
+  tile = td->td_scheduled_head;
+  last_tile = tile;
+  while (tile) {
+    size_t page_i;
+
+    cl_assert(cl, tile->tile_memory_disk);
+    cl_assert(cl, tile->tile_memory_scheduled);
+    cl_assert(cl, tile->tile_scheduled_bits);
+
+    for (page_i = 0; page_i < pages_per_tile; page_i++)
+      if ((1 << page_i) & tile->tile_scheduled_bits)
+        memcpy(tile->tile_memory_disk + (page_i * ps),
+               tile->tile_memory_scheduled + (page_i * ps), ps);
+
+    /*  With a redo log, nobody is going to sync these right away.
+     */
+    if (td->td_writeback != NULL && addb_tiled_redo(td))
+      addb_writeback_note(td->td_pool->tdp_addb, td->td_writeback,
+                          tile->tile_i);
+
+    cm_free(td->td_pool->tdp_cm, tile->tile_memory_scheduled);
+    if (tile->tile_memory == tile->tile_memory_scheduled) {
+      cl_assert(cl, !tile->tile_dirty_bits);
+
+      tile->tile_memory = tile->tile_memory_disk;
+      tile->tile_memory_disk = (addb_tile*)0;
+    }
+    tile->tile_memory_scheduled = (addb_tile*)0;
+
+    tile = tile->tile_next;
+    if (last_tile == tile) tile = 0;
+    n_scheduled++;
+  }
+
+  /*  Return scheduled tiles to the dirty- or free-lists as appropriate
+   */
+  if (td->td_scheduled_head) {
+    addb_tile* tile = td->td_scheduled_head;
+    addb_tile* const last_tile = tile;
+
+    while (tile) {
+      addb_tile* const next_tile = tile->tile_next;
+
+      tile->tile_scheduled_bits = 0;
+      tile->tile_next = (addb_tile*)0;
+      tile->tile_prev = (addb_tile*)0;
+      tile_chain_in(tile);
+
+      tile = next_tile;
+      if (last_tile == tile) tile = 0;
+    }
+    td->td_scheduled_head = (addb_tile*)0;
+  }
+  return n_scheduled;
+}
+
+/**
+ * @brief Phase 1 of a disk flush, with a redo log.
+ *
+ *  Append the new contents of the dirty pages to the redo log,
+ *  and start syncing it.  The pages are copied into the file only
+ *  after the marker has been written, in
+ *  addb_tiled_checkpoint_remove_backup().
+ *
+ * @param td		opaque tile manager handle
+ * @param horizon	the state the file is in before the pages
+ *			in the log are copied into it.
+ * @param hard_sync	wait for writes to hit disk?
+ *
+ * @return 0 on success, other nonzero error codes on error.
+ */
+static int addb_tiled_checkpoint_redo_log(addb_tiled* td,
+                                          unsigned long long horizon,
+                                          bool hard_sync) {
+  addb_handle* addb = td->td_pool->tdp_addb;
+  cl_handle* cl = td->td_pool->tdp_cl;
+  addb_tile* tile;
+  addb_tile* last_tile;
+  int err;
+
+  cl_assert(cl, td->td_tbk.tbk_a.fd == -1);
+  cl_assert(cl, !td->td_tile_dirty == !td->td_dirty_head);
+  cl_assert(cl, !td->td_scheduled_head);
+
+  if (!td->td_tile_dirty) {
+    td->td_checkpoint_stage = ADDB_CKS_DONE;
+    return 0;
+  }
+  cl_assert(cl, addb->addb_transactional);
+
+  /*  If the previous checkpoint started retiring the log,
+   *  that has to finish before we write a new one.
+   */
+  err = addb_tiled_redo_retire(td, false);
+  if (err) return err;
+
+  td->td_checkpoint_stage = ADDB_CKS_FINISH_BACKUP;
+
+  tile = td->td_dirty_head;
+  last_tile = tile;
+  while (tile) {
+    err = addb_tiled_page_backup(td, tile, tile->tile_dirty_bits);
+    if (err) {
+      td->td_checkpoint_stage = ADDB_CKS_DONE;
+      return err;
+    }
+    tile = tile->tile_next;
+    if (last_tile == tile) tile = 0;
+  }
+
+  err = addb_backup_finish(addb, &td->td_tbk, horizon);
+  if (err) {
+    td->td_checkpoint_stage = ADDB_CKS_DONE;
+    return err;
+  }
+
+  if (hard_sync) {
+    err = addb_backup_sync_start(addb, &td->td_tbk);
+    if (err) {
+      td->td_checkpoint_stage = ADDB_CKS_DONE;
+      return err;
+    }
+  }
+
+  addb_schedule_dirty_tiles(cl, td);
+
+  td->td_checkpoint_stage++;
+
+  cl_log(addb->addb_cl, CL_LEVEL_SPEW | ADDB_FACILITY_TILE,
+         "%s: checkpoint (1): redo log written; horizon=%llu", td->td_path,
+         horizon);
+
+  return 0;
+}
+
 /**
  * @brief Catch up on a backup that failed earlier.
  *
@@ -2102,6 +2517,9 @@ int addb_tiled_checkpoint_finish_backup(addb_tiled* td,
    */
   cl_assert(cl, td->td_tbk.tbk_do_backup);
 
+  if (addb_tiled_redo(td))
+    return addb_tiled_checkpoint_redo_log(td, horizon, hard_sync);
+
   /* Iff there are dirty tiles then we have an open backup file.
    */
   if (td->td_tile_dirty > 0 && td->td_tbk.tbk_a.fd == -1) {
@@ -2211,6 +2629,7 @@ int addb_tiled_checkpoint_sync_backup(addb_tiled* td,
 
   err = addb_backup_publish(addb, &td->td_tbk);
   if (err) return err;
+  td->td_tbk.tbk_v_size += bytes_written;
 
   td->td_checkpoint_stage++;
 
@@ -2240,10 +2659,6 @@ int addb_tiled_checkpoint_start_writes(addb_tiled* td,
                                        bool hard_sync, bool block) {
   addb_handle* const addb = td->td_pool->tdp_addb;
   cl_handle* const cl = addb->addb_cl;
-  size_t const ps = getpagesize();
-  size_t const pages_per_tile = ADDB_TILE_SIZE / ps;
-  addb_tile* tile;
-  addb_tile* last_tile;
   size_t n_scheduled = 0;
   int err = 0;
 
@@ -2262,59 +2677,10 @@ int addb_tiled_checkpoint_start_writes(addb_tiled* td,
       cl_assert(cl, td->td_tbk.tbk_do_backup);
       cl_assert(cl, td->td_scheduled_head);
 
-      /* Copy modified tile contents into the memory mapped file
-       * Note that the tile may have been written again which
-       * would cause tile_memory to be different from
-       * tile_memory_scheduled.
-       */
-
-      tile = td->td_scheduled_head;
-      last_tile = tile;
-      while (tile) {
-        size_t page_i;
-
-        cl_assert(cl, tile->tile_memory_disk);
-        cl_assert(cl, tile->tile_memory_scheduled);
-        cl_assert(cl, tile->tile_scheduled_bits);
-
-        for (page_i = 0; page_i < pages_per_tile; page_i++)
-          if ((1 << page_i) & tile->tile_scheduled_bits)
-            memcpy(tile->tile_memory_disk + (page_i * ps),
-                   tile->tile_memory_scheduled + (page_i * ps), ps);
-
-        cm_free(td->td_pool->tdp_cm, tile->tile_memory_scheduled);
-        if (tile->tile_memory == tile->tile_memory_scheduled) {
-          cl_assert(cl, !tile->tile_dirty_bits);
-
-          tile->tile_memory = tile->tile_memory_disk;
-          tile->tile_memory_disk = (addb_tile*)0;
-        }
-        tile->tile_memory_scheduled = (addb_tile*)0;
-
-        tile = tile->tile_next;
-        if (last_tile == tile) tile = 0;
-        n_scheduled++;
-      }
-
-      /*  Return scheduled tiles to the dirty- or free-lists as appropriate
+      /*  With a redo log, the pages stay scheduled until the
+       *  marker has been written.
        */
-      if (td->td_scheduled_head) {
-        addb_tile* tile = td->td_scheduled_head;
-        addb_tile* const last_tile = tile;
-
-        while (tile) {
-          addb_tile* const next_tile = tile->tile_next;
-
-          tile->tile_scheduled_bits = 0;
-          tile->tile_next = (addb_tile*)0;
-          tile->tile_prev = (addb_tile*)0;
-          tile_chain_in(tile);
-
-          tile = next_tile;
-          if (last_tile == tile) tile = 0;
-        }
-        td->td_scheduled_head = (addb_tile*)0;
-      }
+      if (!addb_tiled_redo(td)) n_scheduled = addb_tiled_write_scheduled(td);
 
       td->td_checkpoint_stage++;
       /* falls through */
@@ -2325,7 +2691,7 @@ int addb_tiled_checkpoint_start_writes(addb_tiled* td,
         return 0;
       }
 
-      if (hard_sync) {
+      if (hard_sync && !addb_tiled_redo(td)) {
         err = addb_file_sync_start(cl, td->td_fd, &td->td_tbk.tbk_fsc,
                                    td->td_path, false);
         if (err) return err; /* enclosing switch allows this to be retried */
@@ -2375,7 +2741,7 @@ int addb_tiled_checkpoint_finish_writes(addb_tiled* td,
     return 0;
 
   cl_assert(cl, ADDB_CKS_FINISH_WRITES == td->td_checkpoint_stage);
-  cl_assert(cl, !td->td_scheduled_head);
+  cl_assert(cl, addb_tiled_redo(td) || !td->td_scheduled_head);
   cl_assert(cl, addb->addb_transactional);
 
   if (hard_sync) {
@@ -2431,6 +2797,40 @@ int addb_tiled_checkpoint_remove_backup(addb_tiled* td,
   cl_assert(cl, ADDB_CKS_REMOVE_BACKUP == td->td_checkpoint_stage);
   cl_assert(cl, addb->addb_transactional);
 
+  if (addb_tiled_redo(td)) {
+    size_t const n_scheduled = addb_tiled_write_scheduled(td);
+
+    td->td_checkpoint_stage = ADDB_CKS_DONE;
+
+    /*  The marker is out; it's safe to update the file in place.
+     *  Once enough has accumulated in the redo log, start syncing
+     *  the file; the next checkpoint waits for that to finish and
+     *  then throws the log away.
+     */
+    if (td->td_tbk.tbk_published &&
+        td->td_tbk.tbk_v_size >= addb->addb_redo_log) {
+      if (hard_sync) {
+        err = addb_file_sync_start(cl, td->td_fd, &td->td_tbk.tbk_fsc,
+                                   td->td_path, false);
+        if (err)
+          cl_log_errno(cl, CL_LEVEL_FAIL, "addb_file_sync_start", err,
+                       "%s: can't start retiring redo log; will retry",
+                       td->td_path);
+        else
+          td->td_tbk.tbk_retiring = 1;
+      } else {
+        err = addb_backup_unpublish(addb, &td->td_tbk);
+        if (err) return err;
+      }
+    }
+
+    cl_log(cl, CL_LEVEL_SPEW | ADDB_FACILITY_TILE,
+           "%s: checkpoint (5): %zu tiles written; redo log at %llu bytes%s",
+           td->td_path, n_scheduled, td->td_tbk.tbk_v_size,
+           td->td_tbk.tbk_retiring ? ", retiring" : "");
+    return 0;
+  }
+
   if (!td->td_tbk.tbk_published) return 0;
 
   /*  OK, at this point we know we're consistent, and we know
@@ -2662,6 +3062,35 @@ unsigned long long addb_tiled_physical_file_size(addb_tiled* td) {
   return td->td_physical_file_size;
 }
 
+/*
+ * Release the disk blocks behind [s, e) of a file, which must be
+ * tile-aligned.  The range reads back as zeros afterwards; the caller
+ * promises not to look at it again.  File systems that can't punch
+ * holes just keep the blocks.
+ */
+int addb_tiled_punch(addb_tiled* td, unsigned long long s,
+                     unsigned long long e) {
+  cl_handle* cl = td->td_pool->tdp_cl;
+
+  cl_assert(cl, s % ADDB_TILE_SIZE == 0 && e % ADDB_TILE_SIZE == 0);
+  if (s >= e) return 0;
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+  if (fallocate(td->td_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, s,
+                e - s) != 0) {
+    int err = errno;
+    if (err == EOPNOTSUPP || err == ENOSYS) return 0;
+
+    cl_log_errno(cl, CL_LEVEL_FAIL, "fallocate", err,
+                 "Can't release %llu..%llu of %s", s, e, td->td_path);
+    return err;
+  }
+  cl_log(cl, CL_LEVEL_VERBOSE, "addb_tiled_punch: released %llu..%llu of %s",
+         s, e, td->td_path);
+#endif
+  return 0;
+}
+
 /*
  * Update tiled data structures for a file that may have changed on disk.
  * This extends the tiled limit counters and remaps data as required.
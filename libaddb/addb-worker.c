@@ -0,0 +1,400 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libcl/cl.h"
+#include "libcm/cm.h"
+
+/*  Worker threads.
+ *
+ *  A small pool of threads that help the main thread with a
+ *  job that splits into independent, numbered tasks -- for
+ *  example, the partitions of a large idarray intersection.
+ *
+ *  The calling thread distributes the task numbers over one
+ *  queue per thread (its own included), wakes the workers, and
+ *  then works alongside them until all tasks are done.  Each
+ *  thread takes tasks from the front of its own queue; a thread
+ *  whose queue runs dry steals the back half of someone else's.
+ *
+ *  Nothing that runs in a task may call into cm, cl, or the
+ *  tile cache; those belong to the main thread.  Data that
+ *  tasks read must be pinned by the caller beforehand.
+ */
+
+typedef struct addb_worker_queue {
+  pthread_mutex_t wq_mutex;
+
+  /*  Task numbers not yet started: [wq_s...wq_e)
+   */
+  size_t wq_s;
+  size_t wq_e;
+
+} addb_worker_queue;
+
+typedef struct addb_worker_self {
+  struct addb_worker_pool *ws_pool;
+  size_t ws_queue;
+
+} addb_worker_self;
+
+struct addb_worker_pool {
+  /*  The process that started the threads.  After a fork(),
+   *  the child has the memory, but not the threads.
+   */
+  pid_t wp_pid;
+
+  size_t wp_n;
+  pthread_t *wp_thread;
+  addb_worker_self *wp_self;
+
+  /*  wp_n + 1 queues; the last one belongs to the caller.
+   */
+  addb_worker_queue *wp_queue;
+
+  pthread_mutex_t wp_mutex;
+  pthread_cond_t wp_wake; /* new job, or time to stop */
+  pthread_cond_t wp_done; /* job done, or a worker left it */
+
+  /*  Incremented for each job.
+   */
+  unsigned long long wp_job;
+  addb_worker_task *wp_task;
+  void *wp_data;
+
+  /*  Tasks that haven't finished yet.
+   */
+  size_t wp_pending;
+
+  /*  Workers that are working on a job.
+   */
+  size_t wp_busy;
+
+  bool wp_stop;
+};
+
+/*  Take one task number for queue <q>, stealing if needed.
+ */
+static bool worker_take(addb_worker_pool *wp, size_t q, size_t *i_out) {
+  addb_worker_queue *own = wp->wp_queue + q;
+  size_t k;
+
+  pthread_mutex_lock(&own->wq_mutex);
+  if (own->wq_s < own->wq_e) {
+    *i_out = own->wq_s++;
+    pthread_mutex_unlock(&own->wq_mutex);
+    return true;
+  }
+  pthread_mutex_unlock(&own->wq_mutex);
+
+  for (k = 1; k <= wp->wp_n; k++) {
+    addb_worker_queue *victim = wp->wp_queue + (q + k) % (wp->wp_n + 1);
+    size_t s, e;
+
+    pthread_mutex_lock(&victim->wq_mutex);
+    if (victim->wq_s >= victim->wq_e) {
+      pthread_mutex_unlock(&victim->wq_mutex);
+      continue;
+    }
+
+    /*  Take the back half, rounded up.
+     */
+    e = victim->wq_e;
+    s = e - (e - victim->wq_s + 1) / 2;
+    victim->wq_e = s;
+    pthread_mutex_unlock(&victim->wq_mutex);
+
+    *i_out = s;
+
+    pthread_mutex_lock(&own->wq_mutex);
+    own->wq_s = s + 1;
+    own->wq_e = e;
+    pthread_mutex_unlock(&own->wq_mutex);
+
+    return true;
+  }
+  return false;
+}
+
+static void worker_drain(addb_worker_pool *wp, size_t q, addb_worker_task *task,
+                         void *data) {
+  size_t i;
+
+  while (worker_take(wp, q, &i)) {
+    (*task)(data, i);
+
+    if (__atomic_sub_fetch(&wp->wp_pending, 1, __ATOMIC_ACQ_REL) == 0) {
+      pthread_mutex_lock(&wp->wp_mutex);
+      pthread_cond_broadcast(&wp->wp_done);
+      pthread_mutex_unlock(&wp->wp_mutex);
+    }
+  }
+}
+
+static void *worker_main(void *arg) {
+  addb_worker_self *ws = arg;
+  addb_worker_pool *wp = ws->ws_pool;
+  unsigned long long job = 0;
+
+  pthread_mutex_lock(&wp->wp_mutex);
+  for (;;) {
+    addb_worker_task *task;
+    void *data;
+
+    while (!wp->wp_stop && wp->wp_job == job)
+      pthread_cond_wait(&wp->wp_wake, &wp->wp_mutex);
+    if (wp->wp_stop) break;
+
+    job = wp->wp_job;
+    task = wp->wp_task;
+    data = wp->wp_data;
+    wp->wp_busy++;
+    pthread_mutex_unlock(&wp->wp_mutex);
+
+    worker_drain(wp, ws->ws_queue, task, data);
+
+    pthread_mutex_lock(&wp->wp_mutex);
+    if (--wp->wp_busy == 0) pthread_cond_broadcast(&wp->wp_done);
+  }
+  pthread_mutex_unlock(&wp->wp_mutex);
+
+  return NULL;
+}
+
+static void worker_pool_free(addb_handle *addb, addb_worker_pool *wp) {
+  cm_handle *cm = addb->addb_cm;
+  size_t i;
+
+  for (i = 0; i <= wp->wp_n; i++)
+    pthread_mutex_destroy(&wp->wp_queue[i].wq_mutex);
+
+  pthread_cond_destroy(&wp->wp_done);
+  pthread_cond_destroy(&wp->wp_wake);
+  pthread_mutex_destroy(&wp->wp_mutex);
+
+  cm_free(cm, wp->wp_queue);
+  cm_free(cm, wp->wp_self);
+  cm_free(cm, wp->wp_thread);
+  cm_free(cm, wp);
+}
+
+/*  Stop and join the threads of a pool we started.
+ */
+static void worker_pool_stop(addb_handle *addb, addb_worker_pool *wp) {
+  size_t i;
+
+  pthread_mutex_lock(&wp->wp_mutex);
+  wp->wp_stop = true;
+  pthread_cond_broadcast(&wp->wp_wake);
+  pthread_mutex_unlock(&wp->wp_mutex);
+
+  for (i = 0; i < wp->wp_n; i++) pthread_join(wp->wp_thread[i], NULL);
+
+  worker_pool_free(addb, wp);
+}
+
+static addb_worker_pool *worker_pool_create(addb_handle *addb, size_t n) {
+  cm_handle *cm = addb->addb_cm;
+  addb_worker_pool *wp;
+  sigset_t all, saved;
+  size_t i;
+  int err;
+
+  if ((wp = cm_talloc(cm, addb_worker_pool, 1)) == NULL) return NULL;
+  memset(wp, 0, sizeof *wp);
+
+  wp->wp_pid = getpid();
+  wp->wp_thread = cm_talloc(cm, pthread_t, n);
+  wp->wp_self = cm_talloc(cm, addb_worker_self, n);
+  wp->wp_queue = cm_talloc(cm, addb_worker_queue, n + 1);
+  if (wp->wp_thread == NULL || wp->wp_self == NULL || wp->wp_queue == NULL) {
+    cm_free(cm, wp->wp_queue);
+    cm_free(cm, wp->wp_self);
+    cm_free(cm, wp->wp_thread);
+    cm_free(cm, wp);
+    return NULL;
+  }
+
+  pthread_mutex_init(&wp->wp_mutex, NULL);
+  pthread_cond_init(&wp->wp_wake, NULL);
+  pthread_cond_init(&wp->wp_done, NULL);
+  for (i = 0; i <= n; i++) {
+    pthread_mutex_init(&wp->wp_queue[i].wq_mutex, NULL);
+    wp->wp_queue[i].wq_s = wp->wp_queue[i].wq_e = 0;
+  }
+
+  /*  Signals go to the main thread, not to the workers;
+   *  the threads inherit the mask they're created with.
+   */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &saved);
+
+  for (i = 0; i < n; i++) {
+    wp->wp_self[i].ws_pool = wp;
+    wp->wp_self[i].ws_queue = i;
+
+    err = pthread_create(wp->wp_thread + i, NULL, worker_main, wp->wp_self + i);
+    if (err != 0) {
+      cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "pthread_create", err,
+                   "worker %zu of %zu; continuing with %zu", i + 1, n, i);
+      break;
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+  /*  Shrink to the threads we actually got.
+   */
+  wp->wp_n = i;
+  if (wp->wp_n == 0) {
+    worker_pool_free(addb, wp);
+    return NULL;
+  }
+
+  cl_log(addb->addb_cl, CL_LEVEL_DEBUG, "addb: started %zu worker threads",
+         wp->wp_n);
+  return wp;
+}
+
+/*  Return the pool, starting it if necessary; NULL if we
+ *  don't have one.
+ */
+static addb_worker_pool *worker_pool(addb_handle *addb) {
+  if (addb->addb_workers != NULL && addb->addb_workers->wp_pid != getpid()) {
+    /*  We're a forked child; the threads stayed with the
+     *  parent, and their locks may have been held at the
+     *  time of the fork.  Leave the structure alone.
+     */
+    addb->addb_workers = NULL;
+  }
+  if (addb->addb_workers == NULL && addb->addb_workers_max > 0 &&
+      !addb->addb_workers_failed) {
+    addb->addb_workers = worker_pool_create(addb, addb->addb_workers_max);
+    if (addb->addb_workers == NULL) addb->addb_workers_failed = true;
+  }
+  return addb->addb_workers;
+}
+
+/**
+ * @brief Configure the number of worker threads.
+ *
+ *  The threads are started the first time they're needed, in
+ *  the process that needs them.
+ *
+ * @param addb	opaque module handle
+ * @param n	number of threads to use in addition to the
+ *		calling thread; 0 to do everything in the caller.
+ */
+void addb_set_workers(addb_handle *addb, unsigned long long n) {
+  if (n > ADDB_WORKER_MAX) n = ADDB_WORKER_MAX;
+  if (n == addb->addb_workers_max) return;
+
+  addb_worker_finish(addb);
+  addb->addb_workers_max = n;
+  addb->addb_workers_failed = false;
+}
+
+/**
+ * @brief Set how large an intersection must be to use the workers.
+ *
+ *  Partitions shrink along with the minimum, so that a small
+ *  value lets tests compare parallel and serial results on
+ *  small databases.
+ *
+ * @param addb	opaque module handle
+ * @param n	number of ids on both sides together; 0 for
+ *		the default, ADDB_IDARRAY_PARALLEL_MIN.
+ */
+void addb_set_parallel_min(addb_handle *addb, unsigned long long n) {
+  if (n == 0)
+    n = ADDB_IDARRAY_PARALLEL_MIN;
+  else if (n < 2)
+    n = 2;
+  addb->addb_parallel_min = n;
+}
+
+/**
+ * @brief How many threads besides the caller would run a job?
+ */
+size_t addb_worker_threads(addb_handle *addb) {
+  addb_worker_pool *wp = worker_pool(addb);
+  return wp == NULL ? 0 : wp->wp_n;
+}
+
+/**
+ * @brief Run task(data, 0) ... task(data, n - 1), in parallel.
+ *
+ *  Returns once all tasks have finished.  If there are no
+ *  worker threads, the tasks run, in order, in the caller.
+ *
+ * @param addb	opaque module handle
+ * @param n	number of tasks
+ * @param task	function to call for each task
+ * @param data	opaque application data passed to the task
+ */
+void addb_worker_run(addb_handle *addb, size_t n, addb_worker_task *task,
+                     void *data) {
+  addb_worker_pool *wp;
+  size_t i, q;
+
+  if (n < 2 || (wp = worker_pool(addb)) == NULL) {
+    for (i = 0; i < n; i++) (*task)(data, i);
+    return;
+  }
+
+  pthread_mutex_lock(&wp->wp_mutex);
+
+  /*  Wait for stragglers from the previous job to let go
+   *  of it before we reuse the queues.
+   */
+  while (wp->wp_busy > 0) pthread_cond_wait(&wp->wp_done, &wp->wp_mutex);
+
+  q = wp->wp_n + 1;
+  for (i = 0; i < q; i++) {
+    wp->wp_queue[i].wq_s = i * n / q;
+    wp->wp_queue[i].wq_e = (i + 1) * n / q;
+  }
+  wp->wp_task = task;
+  wp->wp_data = data;
+  __atomic_store_n(&wp->wp_pending, n, __ATOMIC_RELEASE);
+  wp->wp_job++;
+
+  pthread_cond_broadcast(&wp->wp_wake);
+  pthread_mutex_unlock(&wp->wp_mutex);
+
+  worker_drain(wp, wp->wp_n, task, data);
+
+  pthread_mutex_lock(&wp->wp_mutex);
+  while (__atomic_load_n(&wp->wp_pending, __ATOMIC_ACQUIRE) > 0)
+    pthread_cond_wait(&wp->wp_done, &wp->wp_mutex);
+  pthread_mutex_unlock(&wp->wp_mutex);
+}
+
+/**
+ * @brief Stop the worker threads, if any.
+ *
+ *  They'll be restarted if they're needed again.
+ */
+void addb_worker_finish(addb_handle *addb) {
+  addb_worker_pool *wp = addb->addb_workers;
+
+  if (wp == NULL) return;
+  addb->addb_workers = NULL;
+
+  if (wp->wp_pid == getpid()) worker_pool_stop(addb, wp);
+}
@@ -0,0 +1,532 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#define _GNU_SOURCE /* needed for sync_file_range */
+
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libcl/cl.h"
+#include "libcm/cm.h"
+
+/*  Background writeback.
+ *
+ *  Pages that are written into the mapped files in place --
+ *  the primitive store, files that aren't written
+ *  transactionally, and, with a redo log, index pages after
+ *  the checkpoint that logged them -- sit dirty in the page
+ *  cache until the next fsync forces all of them out at once.
+ *
+ *  A single background thread trickles them out ahead of
+ *  time, within a budget of bytes per second, so that the
+ *  fsync only finds a small residue.  It only ever starts
+ *  writeback with sync_file_range(); it doesn't wait for it,
+ *  and it doesn't make anything durable.  The fsync still
+ *  does that.
+ *
+ *  The main thread marks tiles in a per-file bitmap as it
+ *  writes to them; the thread takes the bits and passes the
+ *  tiles to the kernel.  Like the worker threads, it never
+ *  calls into cm, cl, or the tile cache.
+ */
+
+/*  The thread wakes up this many times per second while
+ *  there's work.
+ */
+#define ADDB_WRITEBACK_TICKS 10
+
+/*  Tiles taken from a file at a time.
+ */
+#define ADDB_WRITEBACK_BATCH 64
+
+#define ADDB_WRITEBACK_WORD_BITS (8 * sizeof(unsigned long long))
+
+struct addb_writeback_file {
+  addb_writeback_file *wbf_next;
+  int wbf_fd;
+
+  /*  One bit per tile that has been written since the
+   *  thread last looked at it.  The main thread sets bits
+   *  without locking; the thread clears them, and the main
+   *  thread reallocates the bitmap, with wb_mutex held.
+   */
+  unsigned long long *wbf_bits;
+  size_t wbf_words;
+
+  /*  Set whenever a bit is set; cleared by the thread before
+   *  it looks for bits.
+   */
+  bool wbf_pending;
+
+  /*  Where the thread continues its scan.
+   */
+  size_t wbf_cursor;
+
+  /*  Bytes passed to the kernel, in total, at the end of the
+   *  previous second, and during the previous second.
+   */
+  unsigned long long wbf_bytes;
+  unsigned long long wbf_bytes_last;
+  unsigned long long wbf_rate;
+};
+
+struct addb_writeback {
+  /*  The process that started the thread.
+   */
+  pid_t wb_pid;
+  pthread_t wb_thread;
+  bool wb_running;
+  bool wb_failed;
+
+  pthread_mutex_t wb_mutex;
+  pthread_cond_t wb_wake; /* work, or time to stop */
+  pthread_cond_t wb_idle; /* thread let go of wb_busy */
+
+  addb_writeback_file *wb_head;
+  addb_writeback_file *wb_busy;
+
+  /*  Budget in bytes per second.
+   */
+  unsigned long long wb_rate;
+
+  /*  Set while the thread waits for work without a timeout.
+   */
+  bool wb_sleeping;
+  bool wb_stop;
+};
+
+/*  Take up to <m> tiles that need writing from <wbf>, in
+ *  ascending order.  Called with wb_mutex held.
+ */
+static size_t writeback_take(addb_writeback_file *wbf, size_t *tiles,
+                             size_t m) {
+  size_t n = 0, k;
+
+  for (k = 0; k < wbf->wbf_words && n < m; k++) {
+    size_t const i = (wbf->wbf_cursor + k) % wbf->wbf_words;
+    unsigned long long w, rest = 0;
+
+    if (__atomic_load_n(wbf->wbf_bits + i, __ATOMIC_RELAXED) == 0) continue;
+    w = __atomic_exchange_n(wbf->wbf_bits + i, 0, __ATOMIC_ACQ_REL);
+
+    while (w != 0) {
+      int const b = __builtin_ctzll(w);
+
+      w &= w - 1;
+      if (n >= m) {
+        rest |= 1ull << b;
+        continue;
+      }
+      tiles[n++] = i * ADDB_WRITEBACK_WORD_BITS + b;
+    }
+    if (rest != 0) {
+      __atomic_fetch_or(wbf->wbf_bits + i, rest, __ATOMIC_RELEASE);
+      wbf->wbf_cursor = i;
+      return n;
+    }
+  }
+  if (n == m) wbf->wbf_cursor = (wbf->wbf_cursor + k) % wbf->wbf_words;
+  return n;
+}
+
+/*  Start writeback of <n> tiles, coalescing runs of
+ *  neighbours into one call.
+ */
+static void writeback_tiles(int fd, size_t const *tiles, size_t n) {
+  size_t i = 0;
+
+  while (i < n) {
+    size_t j = i + 1;
+
+    while (j < n && tiles[j] == tiles[j - 1] + 1) j++;
+
+#ifdef SYNC_FILE_RANGE_WRITE
+    (void)sync_file_range(fd, (off_t)tiles[i] * ADDB_TILE_SIZE,
+                          (off_t)(j - i) * ADDB_TILE_SIZE,
+                          SYNC_FILE_RANGE_WRITE);
+#endif
+    i = j;
+  }
+}
+
+/*  Spend up to <budget> tiles on the files that have work, round
+ *  robin.  Called with wb_mutex held; returns the budget left.
+ */
+static size_t writeback_round(addb_writeback *wb, size_t budget) {
+  size_t tiles[ADDB_WRITEBACK_BATCH];
+  addb_writeback_file *wbf;
+  bool more = true;
+
+  while (budget > 0 && more) {
+    more = false;
+    for (wbf = wb->wb_head; wbf != NULL && budget > 0; wbf = wbf->wbf_next) {
+      size_t n;
+
+      if (!__atomic_exchange_n(&wbf->wbf_pending, false, __ATOMIC_SEQ_CST))
+        continue;
+
+      n = writeback_take(wbf, tiles,
+                         budget < ADDB_WRITEBACK_BATCH ? budget
+                                                       : ADDB_WRITEBACK_BATCH);
+      if (n == 0) continue;
+
+      /*  There may be more where that came from.
+       */
+      __atomic_store_n(&wbf->wbf_pending, true, __ATOMIC_SEQ_CST);
+      more = true;
+
+      wb->wb_busy = wbf;
+      pthread_mutex_unlock(&wb->wb_mutex);
+
+      writeback_tiles(wbf->wbf_fd, tiles, n);
+
+      pthread_mutex_lock(&wb->wb_mutex);
+      wb->wb_busy = NULL;
+      pthread_cond_broadcast(&wb->wb_idle);
+
+      wbf->wbf_bytes += (unsigned long long)n * ADDB_TILE_SIZE;
+      budget -= n;
+    }
+  }
+  return budget;
+}
+
+static bool writeback_pending(addb_writeback *wb) {
+  addb_writeback_file *wbf;
+
+  for (wbf = wb->wb_head; wbf != NULL; wbf = wbf->wbf_next)
+    if (__atomic_load_n(&wbf->wbf_pending, __ATOMIC_SEQ_CST)) return true;
+  return false;
+}
+
+/*  Called once a second while we're busy, and with <idle> set
+ *  when we go to sleep.
+ */
+static void writeback_rates(addb_writeback *wb, bool idle) {
+  addb_writeback_file *wbf;
+
+  for (wbf = wb->wb_head; wbf != NULL; wbf = wbf->wbf_next) {
+    wbf->wbf_rate = idle ? 0 : wbf->wbf_bytes - wbf->wbf_bytes_last;
+    wbf->wbf_bytes_last = wbf->wbf_bytes;
+  }
+}
+
+static void *writeback_main(void *arg) {
+  addb_writeback *wb = arg;
+  struct timespec tick, now;
+  unsigned int ticks = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &tick);
+
+  pthread_mutex_lock(&wb->wb_mutex);
+  for (;;) {
+    size_t const budget = wb->wb_rate / ADDB_WRITEBACK_TICKS / ADDB_TILE_SIZE;
+
+    /*  Wait for the next tick.  After a nap, that's right
+     *  away; either way, rounds are at least a tick apart.
+     */
+    tick.tv_nsec += 1000000000 / ADDB_WRITEBACK_TICKS;
+    if (tick.tv_nsec >= 1000000000) {
+      tick.tv_nsec -= 1000000000;
+      tick.tv_sec++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > tick.tv_sec ||
+        (now.tv_sec == tick.tv_sec && now.tv_nsec > tick.tv_nsec))
+      tick = now;
+
+    while (!wb->wb_stop &&
+           pthread_cond_timedwait(&wb->wb_wake, &wb->wb_mutex, &tick) == 0)
+      ;
+    if (wb->wb_stop) break;
+
+    (void)writeback_round(wb, budget > 0 ? budget : 1);
+
+    if (++ticks >= ADDB_WRITEBACK_TICKS) {
+      writeback_rates(wb, false);
+      ticks = 0;
+    }
+
+    if (!writeback_pending(wb)) {
+      /*  Nothing to do.  Sleep until someone has something
+       *  for us; addb_writeback_note() checks wb_sleeping
+       *  after setting wbf_pending, we check wbf_pending
+       *  after setting wb_sleeping.
+       */
+      writeback_rates(wb, true);
+      ticks = 0;
+
+      __atomic_store_n(&wb->wb_sleeping, true, __ATOMIC_SEQ_CST);
+      while (!wb->wb_stop && !writeback_pending(wb))
+        pthread_cond_wait(&wb->wb_wake, &wb->wb_mutex);
+      __atomic_store_n(&wb->wb_sleeping, false, __ATOMIC_SEQ_CST);
+    }
+  }
+  pthread_mutex_unlock(&wb->wb_mutex);
+
+  return NULL;
+}
+
+static void writeback_init_sync(addb_writeback *wb) {
+  pthread_condattr_t attr;
+
+  pthread_mutex_init(&wb->wb_mutex, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&wb->wb_wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_cond_init(&wb->wb_idle, NULL);
+}
+
+/*  Return the writeback state, or NULL if writeback is off.
+ */
+static addb_writeback *writeback(addb_handle *addb) {
+  addb_writeback *wb = addb->addb_writeback;
+
+  if (wb != NULL && wb->wb_running && wb->wb_pid != getpid()) {
+    /*  We're a forked child; the thread stayed with the
+     *  parent, and may have held the lock at the time of
+     *  the fork.  It'll be restarted when it's needed.
+     */
+    writeback_init_sync(wb);
+    wb->wb_running = false;
+    wb->wb_busy = NULL;
+    wb->wb_sleeping = false;
+  }
+  return wb;
+}
+
+/*  Make sure the thread is running.
+ */
+static void writeback_start(addb_handle *addb, addb_writeback *wb) {
+  sigset_t all, saved;
+  int err;
+
+  if (wb->wb_running || wb->wb_failed) return;
+
+  wb->wb_pid = getpid();
+  wb->wb_stop = false;
+
+  /*  Signals go to the main thread.
+   */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &saved);
+  err = pthread_create(&wb->wb_thread, NULL, writeback_main, wb);
+  pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+  if (err != 0) {
+    cl_log_errno(addb->addb_cl, CL_LEVEL_ERROR, "pthread_create", err,
+                 "can't start writeback thread; continuing without");
+    wb->wb_failed = true;
+    return;
+  }
+  wb->wb_running = true;
+
+  cl_log(addb->addb_cl, CL_LEVEL_DEBUG,
+         "addb: started writeback thread, %llu bytes/s", wb->wb_rate);
+}
+
+/**
+ * @brief Configure background writeback.
+ *
+ *  Tiles that are written in place are passed on to the kernel
+ *  for writing in the background, at up to <rate> bytes per
+ *  second, rather than all at once by the next fsync.
+ *
+ *  This must be set before any tables are opened; files opened
+ *  while writeback is off never take part in it.
+ *
+ * @param addb	opaque module handle
+ * @param rate	bytes per second; 0 turns writeback off.
+ */
+void addb_set_writeback(addb_handle *addb, unsigned long long rate) {
+  addb_writeback *wb = writeback(addb);
+
+  if (wb == NULL) {
+    if (rate == 0) return;
+
+    if ((wb = cm_talloc(addb->addb_cm, addb_writeback, 1)) == NULL) {
+      cl_log(addb->addb_cl, CL_LEVEL_ERROR,
+             "addb_set_writeback: out of memory; continuing without");
+      return;
+    }
+    memset(wb, 0, sizeof *wb);
+    writeback_init_sync(wb);
+    addb->addb_writeback = wb;
+  }
+
+  pthread_mutex_lock(&wb->wb_mutex);
+  wb->wb_rate = rate;
+  pthread_mutex_unlock(&wb->wb_mutex);
+}
+
+/**
+ * @brief Register a file for background writeback.
+ *
+ * @param addb	opaque module handle
+ * @param fd	the file's descriptor; it must stay open until
+ *		addb_writeback_file_destroy() is called.
+ *
+ * @return NULL if writeback is off, or we're out of memory.
+ */
+addb_writeback_file *addb_writeback_file_create(addb_handle *addb, int fd) {
+  addb_writeback *wb = writeback(addb);
+  addb_writeback_file *wbf;
+
+  if (wb == NULL) return NULL;
+  if ((wbf = cm_talloc(addb->addb_cm, addb_writeback_file, 1)) == NULL)
+    return NULL;
+
+  memset(wbf, 0, sizeof *wbf);
+  wbf->wbf_fd = fd;
+
+  pthread_mutex_lock(&wb->wb_mutex);
+  wbf->wbf_next = wb->wb_head;
+  wb->wb_head = wbf;
+  pthread_mutex_unlock(&wb->wb_mutex);
+
+  return wbf;
+}
+
+/**
+ * @brief Unregister a file.
+ *
+ *  Once this returns, the thread no longer uses the file's
+ *  descriptor.
+ *
+ * @param addb	opaque module handle
+ * @param wbf	NULL or a file created with addb_writeback_file_create()
+ */
+void addb_writeback_file_destroy(addb_handle *addb, addb_writeback_file *wbf) {
+  addb_writeback *wb = writeback(addb);
+
+  if (wbf == NULL) return;
+  if (wb != NULL) {
+    addb_writeback_file **p;
+
+    pthread_mutex_lock(&wb->wb_mutex);
+    for (p = &wb->wb_head; *p != NULL; p = &(*p)->wbf_next)
+      if (*p == wbf) {
+        *p = wbf->wbf_next;
+        break;
+      }
+    while (wb->wb_busy == wbf) pthread_cond_wait(&wb->wb_idle, &wb->wb_mutex);
+    pthread_mutex_unlock(&wb->wb_mutex);
+  }
+  cm_free(addb->addb_cm, wbf->wbf_bits);
+  cm_free(addb->addb_cm, wbf);
+}
+
+/**
+ * @brief Note that a tile has been written to in place.
+ *
+ * @param addb	opaque module handle
+ * @param wbf	NULL or a file created with addb_writeback_file_create()
+ * @param i	index of the tile that was written
+ */
+void addb_writeback_note(addb_handle *addb, addb_writeback_file *wbf,
+                         size_t i) {
+  addb_writeback *wb = writeback(addb);
+  size_t const word = i / ADDB_WRITEBACK_WORD_BITS;
+  unsigned long long const bit = 1ull << (i % ADDB_WRITEBACK_WORD_BITS);
+
+  if (wbf == NULL || wb == NULL || wb->wb_rate == 0) return;
+
+  if (word >= wbf->wbf_words) {
+    size_t n = wbf->wbf_words ? 2 * wbf->wbf_words : 16;
+    unsigned long long *bits;
+
+    while (n <= word) n *= 2;
+
+    pthread_mutex_lock(&wb->wb_mutex);
+    bits = cm_trealloc(addb->addb_cm, unsigned long long, wbf->wbf_bits, n);
+    if (bits != NULL) {
+      memset(bits + wbf->wbf_words, 0,
+             (n - wbf->wbf_words) * sizeof(*wbf->wbf_bits));
+      wbf->wbf_bits = bits;
+      wbf->wbf_words = n;
+    }
+    pthread_mutex_unlock(&wb->wb_mutex);
+
+    /*  Out of memory; the fsync will get this one.
+     */
+    if (bits == NULL) return;
+  }
+
+  if (__atomic_load_n(wbf->wbf_bits + word, __ATOMIC_RELAXED) & bit) return;
+  __atomic_fetch_or(wbf->wbf_bits + word, bit, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&wbf->wbf_pending, __ATOMIC_SEQ_CST)) return;
+  __atomic_store_n(&wbf->wbf_pending, true, __ATOMIC_SEQ_CST);
+
+  writeback_start(addb, wb);
+  if (__atomic_load_n(&wb->wb_sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&wb->wb_mutex);
+    pthread_cond_signal(&wb->wb_wake);
+    pthread_mutex_unlock(&wb->wb_mutex);
+  }
+}
+
+/**
+ * @brief How much has been written back for a file?
+ *
+ * @param addb		opaque module handle
+ * @param wbf		NULL or a file created with
+ *			addb_writeback_file_create()
+ * @param bytes_out	total bytes passed to the kernel
+ * @param rate_out	bytes per second, during the last second
+ */
+void addb_writeback_file_stats(addb_handle *addb,
+                               addb_writeback_file const *wbf,
+                               unsigned long long *bytes_out,
+                               unsigned long long *rate_out) {
+  addb_writeback *wb = writeback(addb);
+
+  *bytes_out = *rate_out = 0;
+  if (wbf == NULL || wb == NULL) return;
+
+  pthread_mutex_lock(&wb->wb_mutex);
+  *bytes_out = wbf->wbf_bytes;
+  *rate_out = wbf->wbf_rate;
+  pthread_mutex_unlock(&wb->wb_mutex);
+}
+
+/**
+ * @brief Stop the writeback thread, if any, and free its state.
+ */
+void addb_writeback_finish(addb_handle *addb) {
+  addb_writeback *wb = addb->addb_writeback;
+
+  if (wb == NULL) return;
+  addb->addb_writeback = NULL;
+
+  if (wb->wb_running && wb->wb_pid == getpid()) {
+    pthread_mutex_lock(&wb->wb_mutex);
+    wb->wb_stop = true;
+    pthread_cond_broadcast(&wb->wb_wake);
+    pthread_mutex_unlock(&wb->wb_mutex);
+
+    pthread_join(wb->wb_thread, NULL);
+  }
+
+  pthread_cond_destroy(&wb->wb_idle);
+  pthread_cond_destroy(&wb->wb_wake);
+  pthread_mutex_destroy(&wb->wb_mutex);
+  cm_free(addb->addb_cm, wb);
+}
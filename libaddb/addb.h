@@ -99,6 +99,11 @@ typedef struct addb_gmap addb_gmap;
 typedef struct addb_hmap addb_hmap;
 typedef struct addb_bmap addb_bmap;
 
+/**
+ * @brief Fixed-size records, indexed by id.
+ */
+typedef struct addb_column addb_column;
+
 /**
  * @brief An istore marker file (horizon or next-id).
  */
@@ -228,6 +233,14 @@ typedef struct addb_gmap_configuration {
 
   bool gcf_allow_bgmaps;
 
+  /**
+   * @brief Pack the checkpointed parts of largefiles into
+   *  delta-encoded blocks, and release their disk space.
+   *  Off by default; a binary that doesn't know about packs
+   *  can't read a database that has them.
+   */
+  bool gcf_pack;
+
 } addb_gmap_configuration;
 
 /**
@@ -392,6 +405,12 @@ typedef struct addb_idarray {
    */
   unsigned char ida_single_bytes[5];
 
+  /**
+   * @brief Buffer for ids re-expanded out of a packed largefile,
+   *	in the five-byte "raw" representation.
+   */
+  unsigned char ida_pack_bytes[64 * 5];
+
   /**
    * @param Tiled reference for accessing tiled partitions.
    *	Only one valid at a time.
@@ -434,6 +453,12 @@ typedef struct addb_gmap_iterator {
    */
   unsigned int iter_forward : 1;
 
+  /**
+   * @brief Read-ahead has been requested for elements
+   *	before this one (counted like iter_i).
+   */
+  unsigned long long iter_prefetch;
+
   /**
    * @brief File access abstraction
    *
@@ -489,6 +514,21 @@ struct addb_largefile {
    */
   bool lf_dirty;
 
+  /**
+   * @brief Packed copy of the start of the file, or NULL.
+   *
+   *  Ids below addb_largefile_pack_end() must be read from
+   *  here; their bytes in the file itself may be gone.
+   */
+  struct addb_idpack* lf_pack;
+
+  /**
+   * @brief lf_size as of the most recent checkpoint's start.
+   *  Once the checkpoint completes, everything below it is on
+   *  disk and may be packed.
+   */
+  size_t lf_pack_mark;
+
   struct addb_largefile_handle* lf_lfhandle;
 };
 
@@ -652,6 +692,8 @@ addb_msclock_t addb_msclock(addb_handle*);
 
 addb_handle* addb_create(cm_handle* cm, cl_handle* cl,
                          unsigned long long total_memory, bool transactional);
+void addb_set_prefetch(addb_handle* _addb, unsigned long long _bytes);
+void addb_set_redo_log(addb_handle* _addb, unsigned long long _bytes);
 
 /*
  * addb-statuc.c */
@@ -663,6 +705,19 @@ int addb_status(addb_handle* abbb, cm_prefix* prefix, addb_status_callback* cb,
 
 void addb_destroy(addb_handle*);
 
+/* addb-worker.c */
+
+typedef void addb_worker_task(void* _data, size_t _i);
+
+void addb_set_workers(addb_handle* _addb, unsigned long long _n);
+void addb_set_parallel_min(addb_handle* _addb, unsigned long long _n);
+void addb_worker_run(addb_handle* _addb, size_t _n, addb_worker_task* _task,
+                     void* _data);
+
+/* addb-writeback.c */
+
+void addb_set_writeback(addb_handle* _addb, unsigned long long _rate);
+
 addb_istore* addb_istore_open(addb_handle* _addb, char const* _path, int _mode,
                               addb_istore_configuration* icf);
 int addb_istore_close(addb_istore*);
@@ -694,6 +749,8 @@ int addb_istore_truncate(addb_istore* is, char const* path);
   addb_istore_read_loc(is, id, data, __FILE__, __LINE__)
 int addb_istore_read_loc(addb_istore* _is, addb_istore_id _id, addb_data* _data,
                          char const* _file, int _line);
+void addb_istore_prefetch(addb_istore* _is, addb_istore_id _s,
+                          addb_istore_id _e, bool _stalled);
 
 /**
  * @brief Release a record that was read from an istore database.
@@ -1155,6 +1212,9 @@ int addb_idarray_search(addb_idarray* ida, unsigned long long s,
 
 unsigned long long addb_idarray_n(addb_idarray const* ida);
 
+void addb_idarray_prefetch(addb_idarray const* _ida, unsigned long long _s,
+                           unsigned long long _e, bool _stalled);
+
 /* addb-idarray-intersect.c */
 
 int addb_idarray_intersect(addb_handle* _addb, addb_idarray* _a,
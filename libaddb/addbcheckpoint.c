@@ -0,0 +1,208 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#define _XOPEN_SOURCE 700 /* needed for mkdtemp, nftw */
+
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+
+/*  addbcheckpoint -- microbenchmark for index checkpoints.
+ *
+ *  Adds random links to a gmap in a scratch directory, and
+ *  checkpoints it after every round, the way pdb does, once with
+ *  undo backups and once with a redo log.  For each, prints
+ *
+ *	add	  the average time of an addb_gmap_add();
+ *	p50..max  the latency of a complete checkpoint;
+ *	written	  the bytes the process wrote, according to
+ *		  /proc/self/io.
+ */
+
+#define PROCNAME "addbcheckpoint"
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: %s [-d tmpdir] [-n adds-per-round] [-r rounds] "
+          "[-l redo-log-size] [-s seed]\n",
+          PROCNAME);
+  exit(EX_USAGE);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long write_bytes(void) {
+  unsigned long long ull = 0;
+  char line[256];
+  FILE *fp;
+
+  if ((fp = fopen("/proc/self/io", "r")) == NULL) return 0;
+  while (fgets(line, sizeof line, fp) != NULL)
+    if (sscanf(line, "write_bytes: %llu", &ull) == 1) break;
+  fclose(fp);
+  return ull;
+}
+
+static int remove_one(char const *path, struct stat const *st, int flag,
+                      struct FTW *ftw) {
+  return remove(path);
+}
+
+static int double_compare(void const *a, void const *b) {
+  double const *x = a, *y = b;
+  return *x < *y ? -1 : *x > *y;
+}
+
+/*  Run the checkpoint stages in the order pdb_checkpoint_optional()
+ *  runs them.
+ */
+static int checkpoint(addb_gmap *gm) {
+  static int (*const stage[])(addb_gmap *, bool, bool) = {
+      addb_gmap_checkpoint_finish_backup,  addb_gmap_checkpoint_sync_backup,
+      addb_gmap_checkpoint_sync_directory, addb_gmap_checkpoint_start_writes,
+      addb_gmap_checkpoint_finish_writes,  addb_gmap_checkpoint_remove_backup};
+  size_t i;
+  int err;
+
+  for (i = 0; i < sizeof(stage) / sizeof(*stage); i++)
+    if ((err = (*stage[i])(gm, true, true)) != 0 && err != ADDB_ERR_ALREADY)
+      return err;
+  return 0;
+}
+
+static void run(char const *tmpdir, char const *name,
+                unsigned long long redo_log, size_t n, int rounds,
+                unsigned int seed) {
+  cl_handle *cl = cl_create();
+  cm_handle *cm = cm_c();
+  addb_handle *addb;
+  addb_gmap *gm;
+  char path[1024];
+  unsigned long long wb, next_id = 0;
+  double *lat, t_add = 0;
+  int r, err;
+
+  snprintf(path, sizeof path, "%s/%s.XXXXXX", tmpdir, PROCNAME);
+  if (mkdtemp(path) == NULL) {
+    fprintf(stderr, "%s: mkdtemp %s: %s\n", PROCNAME, path, strerror(errno));
+    exit(EX_CANTCREAT);
+  }
+  strcat(path, "/gmap");
+
+  if ((lat = malloc(rounds * sizeof(*lat))) == NULL ||
+      (addb = addb_create(cm, cl, 256ull * 1024 * 1024, true)) == NULL) {
+    fprintf(stderr, "%s: out of memory\n", PROCNAME);
+    exit(EX_OSERR);
+  }
+  addb_set_redo_log(addb, redo_log);
+
+  if ((gm = addb_gmap_open(addb, path, ADDB_MODE_READ_WRITE, 0, NULL)) ==
+          NULL ||
+      (err = addb_gmap_backup(gm, 0)) != 0) {
+    fprintf(stderr, "%s: can't open gmap %s\n", PROCNAME, path);
+    exit(EX_SOFTWARE);
+  }
+
+  srandom(seed);
+  wb = write_bytes();
+
+  for (r = 0; r < rounds; r++) {
+    double t0;
+    size_t i;
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+      err = addb_gmap_add(gm, random() % (16 * n), next_id++, false);
+      if (err != 0 && err != ADDB_ERR_EXISTS) {
+        fprintf(stderr, "%s: addb_gmap_add: %s\n", PROCNAME,
+                addb_xstrerror(err));
+        exit(EX_SOFTWARE);
+      }
+    }
+    t_add += now() - t0;
+
+    t0 = now();
+    if ((err = checkpoint(gm)) != 0) {
+      fprintf(stderr, "%s: checkpoint: %s\n", PROCNAME, addb_xstrerror(err));
+      exit(EX_SOFTWARE);
+    }
+    addb_gmap_horizon_set(gm, next_id);
+    lat[r] = now() - t0;
+  }
+
+  if ((err = addb_gmap_close(gm)) != 0) {
+    fprintf(stderr, "%s: addb_gmap_close: %s\n", PROCNAME,
+            addb_xstrerror(err));
+    exit(EX_SOFTWARE);
+  }
+  wb = write_bytes() - wb;
+  addb_destroy(addb);
+
+  qsort(lat, rounds, sizeof(*lat), double_compare);
+  printf("%-8s %10.3f %10.3f %10.3f %10.3f %12llu\n", name,
+         1e6 * t_add / (n * (double)rounds), 1e3 * lat[rounds / 2],
+         1e3 * lat[(rounds * 99) / 100], 1e3 * lat[rounds - 1], wb);
+
+  *strrchr(path, '/') = '\0';
+  (void)nftw(path, remove_one, 16, FTW_DEPTH | FTW_PHYS);
+  free(lat);
+}
+
+int main(int argc, char **argv) {
+  char const *tmpdir = "/tmp";
+  unsigned long long redo_log = 64 * 1024 * 1024;
+  size_t n = 10000;
+  int rounds = 200, opt;
+  unsigned int seed = 42;
+
+  while ((opt = getopt(argc, argv, "d:l:n:r:s:h")) != EOF) switch (opt) {
+      case 'd':
+        tmpdir = optarg;
+        break;
+      case 'l':
+        redo_log = strtoull(optarg, NULL, 0);
+        break;
+      case 'n':
+        n = strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        rounds = atoi(optarg);
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage();
+    }
+  if (n == 0 || rounds <= 0 || redo_log == 0) usage();
+
+  printf("# %zu adds per round, %d rounds; redo log retired at %llu bytes\n",
+         n, rounds, redo_log);
+  printf("%-8s %10s %10s %10s %10s %12s\n", "mode", "add us", "p50 ms",
+         "p99 ms", "max ms", "written");
+
+  run(tmpdir, "backup", 0, n, rounds, seed);
+  run(tmpdir, "redo", redo_log, n, rounds, seed);
+
+  return 0;
+}
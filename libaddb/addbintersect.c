@@ -0,0 +1,284 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#define _XOPEN_SOURCE 700 /* needed for mkdtemp, nftw */
+
+#include "libaddb/addbp.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sysexits.h>
+#include <time.h>
+
+/*  addbintersect -- microbenchmark for the idarray intersection kernels.
+ *
+ *  Builds pairs of sorted id sets with balanced and skewed sizes
+ *  as gmap arrays in a scratch directory, and times
+ *  addb_idarray_intersect() on them once with each merge kernel
+ *  the CPU supports, forced with addb_idarray_intersect_kernel_force().
+ *
+ *  The last column names the kernel idarray_kernel_pick() chooses
+ *  on this CPU, and marks it with a "*" if another kernel was more
+ *  than 5% faster on that row.  Rows marked "(no kernel)" are below
+ *  ADDB_IDARRAY_USE_BLOCKS(); addb_idarray_intersect() searches
+ *  those without decoding blocks, so every column times the same code.
+ *
+ *  Results are checked against a merge of the sets in memory.
+ */
+
+#define PROCNAME "addbintersect"
+
+static char const *const kernel_name[] = {"scalar", "avx2"};
+#define KERNEL_N (sizeof(kernel_name) / sizeof(*kernel_name))
+
+typedef struct bench_set {
+  addb_id *bs_id;
+  size_t bs_n;
+  addb_gmap_id bs_source;
+  addb_idarray bs_ida;
+} bench_set;
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: %s [-d tmpdir] [-k scalar|avx2] [-n large-size] "
+          "[-r repeat] [-s seed]\n",
+          PROCNAME);
+  exit(EX_USAGE);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int remove_one(char const *path, struct stat const *st, int flag,
+                      struct FTW *ftw) {
+  return remove(path);
+}
+
+/*  Pick n distinct ids out of [0...universe), sorted, and store
+ *  them as the gmap array of <source>.
+ */
+static void bench_set_make(addb_gmap *gm, bench_set *bs, addb_gmap_id source,
+                           size_t n, unsigned long long universe) {
+  unsigned long long step = universe / n;
+  size_t i;
+  int err;
+
+  bs->bs_n = n;
+  bs->bs_source = source;
+  bs->bs_id = malloc(n * sizeof(*bs->bs_id));
+  if (bs->bs_id == NULL) {
+    fprintf(stderr, "%s: out of memory\n", PROCNAME);
+    exit(EX_OSERR);
+  }
+
+  for (i = 0; i < n; i++) {
+    bs->bs_id[i] = i * step + (step > 1 ? random() % step : 0);
+    err = addb_gmap_add(gm, source, bs->bs_id[i], false);
+    if (err != 0) {
+      fprintf(stderr, "%s: addb_gmap_add: %s\n", PROCNAME,
+              addb_xstrerror(err));
+      exit(EX_SOFTWARE);
+    }
+  }
+
+  addb_idarray_initialize(&bs->bs_ida);
+  if ((err = addb_gmap_idarray(gm, source, &bs->bs_ida)) != 0) {
+    fprintf(stderr, "%s: addb_gmap_idarray: %s\n", PROCNAME,
+            addb_xstrerror(err));
+    exit(EX_SOFTWARE);
+  }
+}
+
+static void bench_set_free(bench_set *bs) {
+  addb_idarray_finish(&bs->bs_ida);
+  free(bs->bs_id);
+}
+
+/*  The expected intersection.
+ */
+static size_t merge(bench_set const *a, bench_set const *b, addb_id *out) {
+  size_t i = 0, j = 0, n = 0;
+
+  while (i < a->bs_n && j < b->bs_n) {
+    if (a->bs_id[i] < b->bs_id[j])
+      i++;
+    else if (a->bs_id[i] > b->bs_id[j])
+      j++;
+    else {
+      out[n++] = a->bs_id[i];
+      i++;
+      j++;
+    }
+  }
+  return n;
+}
+
+static size_t intersect(addb_handle *addb, bench_set *a, bench_set *b,
+                        addb_id *out, size_t m) {
+  size_t n = 0;
+  int err;
+
+  err = addb_idarray_intersect(addb, &a->bs_ida, 0, a->bs_n, &b->bs_ida, 0,
+                               b->bs_n, out, &n, m);
+  if (err != 0) {
+    fprintf(stderr, "%s: addb_idarray_intersect: %s\n", PROCNAME,
+            addb_xstrerror(err));
+    exit(EX_SOFTWARE);
+  }
+  return n;
+}
+
+int main(int argc, char **argv) {
+  static const size_t ratio[] = {1, 2, 8, 64, 1024, 65536};
+  cl_handle *cl = cl_create();
+  cm_handle *cm = cm_c();
+  addb_handle *addb;
+  addb_gmap *gm;
+  char const *tmpdir = "/tmp", *only = NULL, *picked;
+  char path[1024];
+  bool have[KERNEL_N];
+  size_t large = 4 * 1024 * 1024, r, k;
+  int repeat = 5, opt;
+  unsigned int seed = 42;
+
+  while ((opt = getopt(argc, argv, "d:k:n:r:s:h")) != EOF) switch (opt) {
+      case 'd':
+        tmpdir = optarg;
+        break;
+      case 'k':
+        only = optarg;
+        break;
+      case 'n':
+        large = strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        repeat = atoi(optarg);
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage();
+    }
+  if (large == 0 || repeat <= 0) usage();
+  srandom(seed);
+
+  (void)addb_idarray_intersect_kernel_select(&picked);
+  for (k = 0; k < KERNEL_N; k++) {
+    have[k] = (only == NULL || strcasecmp(only, kernel_name[k]) == 0) &&
+              addb_idarray_intersect_kernel_force(kernel_name[k]) == 0;
+    if (only != NULL && strcasecmp(only, kernel_name[k]) == 0 && !have[k]) {
+      fprintf(stderr, "%s: this CPU can't run the \"%s\" kernel\n", PROCNAME,
+              only);
+      exit(EX_UNAVAILABLE);
+    }
+  }
+
+  snprintf(path, sizeof path, "%s/%s.XXXXXX", tmpdir, PROCNAME);
+  if (mkdtemp(path) == NULL) {
+    fprintf(stderr, "%s: mkdtemp %s: %s\n", PROCNAME, path, strerror(errno));
+    exit(EX_CANTCREAT);
+  }
+  strcat(path, "/gmap");
+
+  if ((addb = addb_create(cm, cl, 256ull * 1024 * 1024, false)) == NULL) {
+    fprintf(stderr, "%s: out of memory\n", PROCNAME);
+    exit(EX_OSERR);
+  }
+  if ((gm = addb_gmap_open(addb, path, ADDB_MODE_READ_WRITE, 0, NULL)) ==
+      NULL) {
+    fprintf(stderr, "%s: can't open gmap %s\n", PROCNAME, path);
+    exit(EX_SOFTWARE);
+  }
+
+  printf("# addb_idarray_intersect(); picked kernel: %s; %d repetitions; "
+         "times in ms\n",
+         picked, repeat);
+  printf("%10s %10s %8s", "|a|", "|b|", "|a&b|");
+  for (k = 0; k < KERNEL_N; k++)
+    if (have[k]) printf(" %10s", kernel_name[k]);
+  printf("  picked\n");
+
+  for (r = 0; r < sizeof(ratio) / sizeof(*ratio); r++) {
+    bench_set a, b;
+    addb_id *expected, *out;
+    double t[KERNEL_N], best = 0, t_picked = 0;
+    size_t small = large / ratio[r], n;
+    int i;
+
+    if (small == 0) continue;
+
+    /*  Both sets out of a universe twice the size
+     *  of the larger set, so about half of the small
+     *  set ends up in the intersection.
+     */
+    bench_set_make(gm, &a, 2 * r, small, 2ull * large);
+    bench_set_make(gm, &b, 2 * r + 1, large, 2ull * large);
+
+    expected = malloc(small * sizeof(addb_id));
+    out = malloc(small * sizeof(addb_id));
+    if (expected == NULL || out == NULL) {
+      fprintf(stderr, "%s: out of memory\n", PROCNAME);
+      exit(EX_OSERR);
+    }
+    n = merge(&a, &b, expected);
+
+    for (k = 0; k < KERNEL_N; k++) {
+      if (!have[k]) continue;
+      (void)addb_idarray_intersect_kernel_force(kernel_name[k]);
+
+      /*  Once to page the arrays in and check the result,
+       *  then timed.
+       */
+      if (intersect(addb, &a, &b, out, small) != n ||
+          memcmp(out, expected, n * sizeof(addb_id))) {
+        fprintf(stderr, "%s: %s kernel: wrong intersection of %zu and %zu\n",
+                PROCNAME, kernel_name[k], a.bs_n, b.bs_n);
+        exit(EX_SOFTWARE);
+      }
+      t[k] = now();
+      for (i = 0; i < repeat; i++) (void)intersect(addb, &a, &b, out, small);
+      t[k] = (now() - t[k]) / repeat;
+
+      if (best == 0 || t[k] < best) best = t[k];
+      if (strcmp(kernel_name[k], picked) == 0) t_picked = t[k];
+    }
+
+    printf("%10zu %10zu %8zu", a.bs_n, b.bs_n, n);
+    for (k = 0; k < KERNEL_N; k++)
+      if (have[k]) printf(" %10.3f", 1000 * t[k]);
+    if (!ADDB_IDARRAY_USE_BLOCKS(a.bs_n, b.bs_n))
+      printf("  (no kernel)\n");
+    else
+      printf("  %s%s\n", picked, t_picked > 1.05 * best ? "*" : "");
+
+    free(expected);
+    free(out);
+    bench_set_free(&a);
+    bench_set_free(&b);
+  }
+
+  (void)addb_gmap_close(gm);
+  addb_destroy(addb);
+
+  *strrchr(path, '/') = '\0';
+  (void)nftw(path, remove_one, 16, FTW_DEPTH | FTW_PHYS);
+  return 0;
+}
@@ -14,6 +14,7 @@ limitations under the License.
 #define ADDBP_H
 
 #include "libaddb/addb.h"
+#include "libaddb/addb-largefile-file.h"
 #include "libaddb/addb-scalar.h"
 
 #include <stdbool.h> /* bool */
@@ -28,6 +29,9 @@ limitations under the License.
 /*  Opaque handle structure managed by addb.c.
  */
 typedef struct addb_tiled_pool addb_tiled_pool;
+typedef struct addb_worker_pool addb_worker_pool;
+typedef struct addb_writeback addb_writeback;
+typedef struct addb_writeback_file addb_writeback_file;
 struct addb_bmap;
 
 struct addb_handle {
@@ -62,10 +66,44 @@ struct addb_handle {
 
   size_t addb_fsync_started;
   size_t addb_fsync_finished;
+
+  /*  Worker threads (addb-worker.c), started on demand.
+   *  addb_workers_max is the configured number; 0 means
+   *  we don't use any.
+   */
+  size_t addb_workers_max;
+  addb_worker_pool *addb_workers;
+  bool addb_workers_failed;
+
+  /*  Intersections of at least this many ids go to the
+   *  workers; defaults to ADDB_IDARRAY_PARALLEL_MIN.
+   */
+  unsigned long long addb_parallel_min;
+
+  /*  Iterators read this many bytes ahead of their cursor;
+   *  0 turns read-ahead off.
+   */
+  unsigned long long addb_prefetch;
+
+  /*  If nonzero, checkpoints write redo logs rather than
+   *  backup files, and a log is retired once it grows past
+   *  this many bytes.  See addb_set_redo_log().
+   */
+  unsigned long long addb_redo_log;
+
+  /*  Background writeback (addb-writeback.c); NULL if it's
+   *  never been turned on.
+   */
+  addb_writeback *addb_writeback;
 };
 
+/*  Don't bother reading ahead in arrays smaller than this.
+ */
+#define ADDB_PREFETCH_MIN (8 * 1024)
+
 #define ADDB_MAGIC_SIZE 4
 #define ADDB_BACKUP_MAGIC "ab1t" /* Addb Backup v1 Tiles */
+#define ADDB_REDO_MAGIC "ar1t"   /* Addb Redo v1 Tiles */
 
 #define addb_round_up(v, f) ((((v) + ((f)-1)) / (f)) * (f))
 #define addb_round_down(v, f) (((v) / (f)) * (f))
@@ -208,6 +246,10 @@ int addb_tiled_status_tiles(addb_tiled *_td, cm_prefix const *_prefix,
 
 int addb_tiled_align(addb_tiled *_td, off_t *_s, off_t *_e);
 
+int addb_tiled_prefetch(addb_tiled *_td, unsigned long long _s,
+                        unsigned long long _n);
+void addb_tiled_prefetch_stall(addb_tiled *_td);
+
 void addb_tiled_pool_set_max(addb_tiled_pool *, unsigned long long);
 /*
 int 		  addb_tiled_pool_set_initial_map_tiles(
@@ -269,6 +311,8 @@ void *addb_tiled_read_array_loc(addb_tiled *const td, unsigned long long s,
 
 cl_handle *addb_tiled_cl(addb_tiled *td);
 int addb_tiled_stretch(addb_tiled *td);
+int addb_tiled_punch(addb_tiled *td, unsigned long long s,
+                     unsigned long long e);
 unsigned long long addb_tiled_physical_file_size(addb_tiled *td);
 
 /* addb-backup.c */
@@ -279,6 +323,7 @@ unsigned long long addb_tiled_physical_file_size(addb_tiled *td);
 typedef struct addb_tbkf {
   int fd;           /* backup file file descriptor, -1 -> none */
   char const *path; /* backup file path */
+  off_t start;      /* offset of the redo log segment we're writing */
 } addb_tbkf;
 
 typedef struct addb_tbk {
@@ -288,9 +333,18 @@ typedef struct addb_tbk {
   addb_tbkf tbk_w;           /* waiting backup file 	*/
   addb_fsync_ctx tbk_fsc;    /* context for cloned fsync */
 
+  /*  Size of the published redo log, in bytes.
+   */
+  unsigned long long tbk_v_size;
+
   unsigned int tbk_do_backup : 1;
   unsigned int tbk_published : 1;
 
+  /*  The tiled file is being synced so that its published
+   *  redo log can be removed.
+   */
+  unsigned int tbk_retiring : 1;
+
 } addb_tbk;
 
 int addb_backup_init(addb_handle *_addb, addb_tbk *tbk, char const *a0_path,
@@ -393,6 +447,71 @@ int addb_largefile_rollback(addb_largefile_handle *lh,
 
 int addb_largefile_refresh(addb_largefile_handle *lh);
 
+void addb_largefile_set_pack(addb_largefile_handle *lh, bool pack);
+
+int addb_largefile_read_packed(addb_largefile *lf, unsigned long long offset,
+                               unsigned long long end, unsigned char *buf,
+                               size_t buf_size, unsigned char const **ptr_out,
+                               unsigned long long *end_out);
+
+int addb_largefile_search(addb_largefile *lf, unsigned long long s,
+                          unsigned long long e, addb_id id,
+                          unsigned long long *off_out, addb_id *id_out);
+
+/*  Byte offset, in the largefile, of the first id that isn't packed.
+ */
+#define addb_largefile_pack_end(lf)             \
+  (ADDB_LARGE_HEADER + ((lf)->lf_pack == NULL  \
+                            ? 0                 \
+                            : (lf)->lf_pack->ip_n * ADDB_GMAP_ENTRY_SIZE))
+
+/* addb-idpack.c */
+
+/*  The packed, read-only prefix of a largefile.
+ */
+typedef struct addb_idpack {
+  char *ip_path;
+
+  /*  Read-only mapping of the .glp file.  The first ip_size
+   *  bytes -- the header and ip_n / ADDB_IDPACK_BLOCK blocks --
+   *  are valid.
+   */
+  unsigned char const *ip_base;
+  size_t ip_map_size;
+  size_t ip_size;
+  unsigned long long ip_n;
+
+  /*  Skip table: first id and byte offset of each block.
+   */
+  addb_id *ip_first;
+  size_t *ip_offset;
+  size_t ip_block_m;
+
+  /*  The most recently decoded block.
+   */
+  unsigned long long ip_cache_block;
+  addb_id ip_cache[ADDB_IDPACK_BLOCK];
+
+} addb_idpack;
+
+size_t addb_idpack_encode(addb_id const *_id, unsigned char *_out);
+
+void addb_idpack_unpack(unsigned char const *_blk, size_t _n, addb_id *_out);
+
+int addb_idpack_open(addb_handle *_addb, char const *_path,
+                     addb_idpack **_ip_out);
+
+void addb_idpack_close(addb_handle *_addb, addb_idpack *_ip);
+
+int addb_idpack_append(addb_handle *_addb, char const *_path,
+                       addb_idpack **_ip_inout, addb_id const *_id, size_t _n);
+
+addb_id addb_idpack_get(addb_idpack *_ip, unsigned long long _i);
+
+void addb_idpack_search(addb_idpack const *_ip, unsigned long long _s,
+                        unsigned long long _e, addb_id _id,
+                        unsigned long long *_off_out, addb_id *_id_out);
+
 /* addb-bmap.c */
 
 int addb_bmap_checkpoint(struct addb_bmap *bmap, bool hard_sync, bool bloc,
@@ -402,4 +521,155 @@ int addb_bmap_fixed_intersect(addb_handle *addb, struct addb_bmap *a,
                               addb_id const *id_in, size_t n_in,
                               addb_id *id_out, size_t *n_out, size_t m);
 
+/* addb-bmap-simd.c */
+
+/*  Kernels for runs of whole 64-bit bitmap words, picked once
+ *  per process by addb_bmap_kernel_select().
+ */
+typedef struct addb_bmap_kernel {
+  char const *bk_name;
+
+  /*  Index of the first (last) nonzero word in w[0..n),
+   *  or n if they're all zero.
+   */
+  size_t (*bk_first)(unsigned long long const *_w, size_t _n);
+  size_t (*bk_last)(unsigned long long const *_w, size_t _n);
+
+  /*  Number of bits set in w[0..n).
+   */
+  unsigned long long (*bk_count)(unsigned long long const *_w, size_t _n);
+
+  /*  out[i] = a[i] & b[i], for i in 0..n.
+   */
+  void (*bk_and)(unsigned long long const *_a, unsigned long long const *_b,
+                 unsigned long long *_out, size_t _n);
+
+  /*  Copy those of id[0..n) whose bit, id - base, is set in w
+   *  to out, in order; return how many there were.
+   */
+  size_t (*bk_test)(unsigned long long const *_w, unsigned long long _base,
+                    addb_id const *_id, size_t _n, addb_id *_out);
+
+} addb_bmap_kernel;
+
+addb_bmap_kernel const *addb_bmap_kernel_select(void);
+int addb_bmap_kernel_force(char const *_name);
+
+/* addb-idarray-simd.c */
+
+/*  Size, in ids, of the blocks addb_idarray_intersect() decodes
+ *  at a time, and the size ratio past which two blocks are
+ *  intersected by galloping rather than merging.
+ */
+#define ADDB_IDARRAY_BLOCK 256
+#define ADDB_IDARRAY_GALLOP_RATIO 16
+
+/*  Below this many ids on the smaller side, or if the larger
+ *  side is more than ADDB_IDARRAY_SKEW_MAX times larger, the
+ *  recursive binary-search intersection is cheaper than
+ *  decoding blocks.
+ */
+#define ADDB_IDARRAY_BLOCK_MIN 32
+#define ADDB_IDARRAY_SKEW_MAX 32
+
+#define ADDB_IDARRAY_USE_BLOCKS(a_n, b_n)                                    \
+  ((a_n) >= ADDB_IDARRAY_BLOCK_MIN && (b_n) >= ADDB_IDARRAY_BLOCK_MIN &&     \
+   (a_n) / ADDB_IDARRAY_SKEW_MAX <= (b_n) &&                                 \
+   (b_n) / ADDB_IDARRAY_SKEW_MAX <= (a_n))
+
+/*  With worker threads, intersections of at least this many
+ *  ids (on both sides together) are split into partitions of
+ *  at least ADDB_IDARRAY_PARALLEL_PART ids and run in parallel.
+ *  addb_set_parallel_min() changes the minimum.
+ */
+#define ADDB_IDARRAY_PARALLEL_MIN (256 * 1024)
+#define ADDB_IDARRAY_PARALLEL_PART (32 * 1024)
+
+typedef size_t addb_idarray_intersect_kernel(addb_id const *_a, size_t _a_n,
+                                             addb_id const *_b, size_t _b_n,
+                                             addb_id *_out);
+
+void addb_idarray_decode(unsigned char const *_ptr, size_t _n, addb_id *_out);
+
+addb_idarray_intersect_kernel addb_idarray_intersect_scalar;
+addb_idarray_intersect_kernel addb_idarray_intersect_gallop;
+addb_idarray_intersect_kernel addb_idarray_intersect_block;
+
+addb_idarray_intersect_kernel *addb_idarray_intersect_kernel_select(
+    char const **_name_out);
+int addb_idarray_intersect_kernel_force(char const *_name);
+
+/* addb-idarray.c */
+
+/*  A run of consecutive ids in an idarray, in their five-byte
+ *  raw representation, that stays put while the idarray is
+ *  pinned.
+ */
+typedef struct addb_idarray_span {
+  unsigned char const *sp_ptr;
+  size_t sp_copy;          /* while pinning: offset into pin_copy */
+  unsigned long long sp_s; /* index of the first id */
+  unsigned long long sp_n; /* number of ids */
+
+} addb_idarray_span;
+
+/*  A range of an idarray that can be read without going
+ *  through the tile cache -- and therefore from a worker
+ *  thread -- until it is unpinned.
+ */
+typedef struct addb_idarray_pinned {
+  addb_handle *pin_addb;
+
+  addb_idarray_span *pin_span;
+  size_t pin_span_n;
+  size_t pin_span_m;
+
+  /*  Tile references we hold on to.
+   */
+  struct addb_idarray_pin_ref *pin_ref;
+  size_t pin_ref_n;
+  size_t pin_ref_m;
+
+  /*  Copies of ids that aren't in a tile (because they were
+   *  packed) or don't fit into one (because they straddle
+   *  a tile boundary).
+   */
+  unsigned char *pin_copy;
+  size_t pin_copy_n;
+  size_t pin_copy_m;
+
+} addb_idarray_pinned;
+
+int addb_idarray_pin(addb_handle *_addb, addb_idarray *_ida,
+                     unsigned long long _s, unsigned long long _e,
+                     addb_idarray_pinned *_pin);
+
+void addb_idarray_unpin(addb_idarray_pinned *_pin);
+
+addb_id addb_idarray_pin_get(addb_idarray_pinned const *_pin,
+                             unsigned long long _i);
+
+/* addb-worker.c */
+
+/*  Upper limit for the number of worker threads.
+ */
+#define ADDB_WORKER_MAX 64
+
+size_t addb_worker_threads(addb_handle *_addb);
+
+void addb_worker_finish(addb_handle *_addb);
+
+/* addb-writeback.c */
+
+addb_writeback_file *addb_writeback_file_create(addb_handle *_addb, int _fd);
+void addb_writeback_file_destroy(addb_handle *_addb,
+                                 addb_writeback_file *_wbf);
+void addb_writeback_note(addb_handle *_addb, addb_writeback_file *_wbf,
+                         size_t _i);
+void addb_writeback_file_stats(addb_handle *_addb,
+                               addb_writeback_file const *_wbf,
+                               unsigned long long *_bytes_out,
+                               unsigned long long *_rate_out);
+void addb_writeback_finish(addb_handle *_addb);
+
 #endif /* ADDBP_H */
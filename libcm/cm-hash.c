@@ -12,12 +12,15 @@ limitations under the License.
 */
 #include "libcm/cm.h"
 
-#include <assert.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CM_HASH_SSE2 1
+#endif
 
 /* cm-hash.c -- A binary cm_hashtable.
  *
@@ -26,13 +29,30 @@ limitations under the License.
  * and retrieved, traversed in some random, but complete order;
  * given the pointer to an object, its key can be retrieved in
  * constant size.
+ *
+ * The table is open-addressed.  Next to the array of pointers to
+ * the objects, it keeps a control byte per slot: CM_HASH_EMPTY,
+ * CM_HASH_DELETED, or, if the slot is in use, the low 7 bits of
+ * the hash of its object's key.  Slots are probed in aligned groups
+ * of CM_HASH_GROUP; one compare (an SSE2 instruction, where we have
+ * it) finds the slots in a group whose control byte matches, and
+ * only their objects are looked at.  A lookup ends at the first
+ * group with an empty slot.
  */
 
+#define CM_HASH_GROUP 16
+#define CM_HASH_EMPTY 0x80
+#define CM_HASH_DELETED 0xFE
+
+/*  Grow (or clean up) once 7/8 of the slots are in use or deleted.
+ */
+#define CM_HASH_LIMIT(m) ((m) - (m) / 8)
+
 typedef struct slot {
   /* application data, possibly of size 0, sits here.
    */
 
-  void *sl_next;         /* collision chain		   */
+  size_t sl_index;       /* index of the slot in h_table	   */
   unsigned long sl_hash; /* hash value of name		   */
   size_t sl_size;        /* size of application byte string */
 
@@ -45,18 +65,73 @@ typedef struct slot {
  *  {h} is the cm_hashtable.
  */
 #define INFO(h, base) ((slot *)((char *)(base) + (h)->h_value_size))
-#define NEXT(h, base) (INFO(h, base)->sl_next)
 #define SIZE(h, base) (INFO(h, base)->sl_size)
 #define MEM(h, base) \
   ((void *)((char *)(base) + (h)->h_value_size + sizeof(slot)))
 
-/*  Turn an array of {n} bytes into an unsigned long.
+#define HASH_K0 0xa0761d6478bd642full
+#define HASH_K1 0xe7037ed1a0b428dbull
+#define HASH_K2 0x8ebc6af09c88c6e3ull
+
+/*  Multiply two 64-bit numbers; fold the 128-bit product.
  */
-static unsigned long hashf(unsigned char const *mem, size_t size) {
-  register unsigned long i = 0;
+static unsigned long long hash_mum(unsigned long long a, unsigned long long b) {
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 r = (unsigned __int128)a * b;
+
+  return (unsigned long long)r ^ (unsigned long long)(r >> 64);
+#else
+  unsigned long long ha = a >> 32, la = a & 0xFFFFFFFFull;
+  unsigned long long hb = b >> 32, lb = b & 0xFFFFFFFFull;
+  unsigned long long m0 = ha * lb, m1 = la * hb, lo, hi, t;
+
+  lo = la * lb;
+  t = lo + (m0 << 32);
+  hi = ha * hb + (m0 >> 32) + (m1 >> 32) + (t < lo);
+  lo = t + (m1 << 32);
+  hi += lo < t;
+
+  return lo ^ hi;
+#endif
+}
 
-  while (size--) i = i * 33 + *mem++;
-  return i;
+static unsigned long long hash_load8(unsigned char const *p) {
+  unsigned long long w;
+
+  memcpy(&w, p, sizeof w);
+  return w;
+}
+
+static unsigned long long hash_load4(unsigned char const *p) {
+  unsigned int w;
+
+  memcpy(&w, p, sizeof w);
+  return w;
+}
+
+/*  Turn an array of {n} bytes into an unsigned long, 16 bytes
+ *  at a time.
+ */
+static unsigned long hashf(unsigned char const *mem, size_t size) {
+  unsigned long long seed = HASH_K0 ^ size, a, b;
+
+  for (; size > 16; size -= 16, mem += 16)
+    seed = hash_mum(hash_load8(mem) ^ HASH_K1, hash_load8(mem + 8) ^ seed);
+
+  if (size >= 8) {
+    a = hash_load8(mem);
+    b = hash_load8(mem + size - 8);
+  } else if (size >= 4) {
+    a = hash_load4(mem);
+    b = hash_load4(mem + size - 4);
+  } else if (size > 0) {
+    a = ((unsigned long long)mem[0] << 16) | (mem[size / 2] << 8) |
+        mem[size - 1];
+    b = 0;
+  } else
+    a = b = 0;
+
+  return hash_mum(hash_mum(a ^ HASH_K1, b ^ seed) ^ HASH_K2, HASH_K1);
 }
 
 /*  The power of 2 that is greater or equal to {size}.
@@ -71,6 +146,93 @@ static unsigned long hash_round(unsigned long size) {
   return i;
 }
 
+/*  Bit i of the result is set if the i'th control byte of
+ *  the group at {ctrl} is {c}.
+ */
+static unsigned int group_match(unsigned char const *ctrl, unsigned char c) {
+#ifdef CM_HASH_SSE2
+  __m128i g = _mm_loadu_si128((__m128i const *)ctrl);
+
+  return (unsigned int)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#else
+  unsigned int i, m = 0;
+
+  for (i = 0; i < CM_HASH_GROUP; i++)
+    if (ctrl[i] == c) m |= 1u << i;
+  return m;
+#endif
+}
+
+/*  Bit i of the result is set if the i'th slot of the group
+ *  at {ctrl} is empty or deleted.
+ */
+static unsigned int group_free(unsigned char const *ctrl) {
+#ifdef CM_HASH_SSE2
+  return (unsigned int)_mm_movemask_epi8(
+      _mm_loadu_si128((__m128i const *)ctrl));
+#else
+  unsigned int i, m = 0;
+
+  for (i = 0; i < CM_HASH_GROUP; i++)
+    if (ctrl[i] & CM_HASH_EMPTY) m |= 1u << i;
+  return m;
+#endif
+}
+
+/*  The first group on the probe sequence for {hash}, and
+ *  the ones after it.  Stepping by 1, 2, 3, ... groups visits
+ *  every group of a table whose size is a power of two.
+ */
+#define GROUP_FIRST(h, hash) \
+  (((hash) >> 7) & (h)->h_mask & ~(unsigned long)(CM_HASH_GROUP - 1))
+#define GROUP_NEXT(h, g, step) \
+  (((g) + ((step) += CM_HASH_GROUP)) & (h)->h_mask)
+
+/*  Find the slot for the key <mem, size> with hash {hash}.
+ *  If it isn't in the table, return h_m, and set *free_out to
+ *  the first slot on its probe sequence that could hold it.
+ */
+static unsigned long hash_find(cm_hashtable const *h, void const *mem,
+                               size_t size, unsigned long hash,
+                               unsigned long *free_out) {
+  unsigned long g = GROUP_FIRST(h, hash), step = 0, i;
+  unsigned long free_i = h->h_m;
+  unsigned char const *ctrl;
+  unsigned int m;
+  void *e;
+
+  for (;; g = GROUP_NEXT(h, g, step)) {
+    ctrl = h->h_ctrl + g;
+    for (m = group_match(ctrl, hash & 0x7F); m != 0; m &= m - 1) {
+      i = g + __builtin_ctz(m);
+      e = h->h_table[i];
+      if (INFO(h, e)->sl_hash == hash && SIZE(h, e) == size &&
+          !memcmp(MEM(h, e), mem, size))
+        return i;
+    }
+    if (free_i == h->h_m && (m = group_free(ctrl)) != 0)
+      free_i = g + __builtin_ctz(m);
+    if (group_match(ctrl, CM_HASH_EMPTY) != 0) break;
+  }
+  *free_out = free_i;
+  return h->h_m;
+}
+
+/*  Allocate a table of {m} slots, all empty.
+ */
+static void **hash_table_alloc(cm_handle *cm, unsigned long m) {
+  void **table;
+
+  table = cm_malloc(cm, m * (sizeof(void *) + 1));
+  if (table == NULL) return NULL;
+
+  memset(table, 0, m * sizeof(void *));
+  memset(table + m, CM_HASH_EMPTY, m);
+
+  return table;
+}
+
 /**
  * @brief Initialize a hashtable-sized piece of storage.
  * Given the size of the fixed-size application data @b elsize
@@ -102,20 +264,18 @@ int cm_hashinit(cm_handle *cm, cm_hashtable *h, size_t elsize, int m) {
   /*  Round the chunk size until table selection and indexing become
    *  simple masking steps; initialize housekeeping information.
    */
+  if (m < CM_HASH_GROUP) m = CM_HASH_GROUP;
   h->h_m = m = hash_round((unsigned long)m);
-  h->h_mask = m - 1;      /* mask index in a table 	 */
-  h->h_limit = m * 2 / 3; /* resize when two thidrs full	*/
-  h->h_n = 0;             /* # of allocated elements.	 */
+  h->h_mask = m - 1;              /* mask index in a table 	 */
+  h->h_limit = CM_HASH_LIMIT(m); /* resize when 7/8 full	 */
+  h->h_n = 0;                     /* # of allocated elements.	 */
+  h->h_deleted = 0;               /* # of deleted slots.	 */
 
-  /* Create the actual table of buckets.
+  /* Create the actual table of slots.
    */
-  {
-    register void **c, **e;
+  if (!(h->h_table = hash_table_alloc(h->h_cm, m))) return ENOMEM;
+  h->h_ctrl = (unsigned char *)(h->h_table + m);
 
-    if (!(c = h->h_table = cm_talloc(h->h_cm, void *, m))) return -1;
-    for (e = c + m; c < e; *c++ = (void *)0)
-      ;
-  }
   return 0;
 }
 
@@ -145,53 +305,42 @@ cm_hashtable *cm_hashcreate(cm_handle *cm, size_t elsize, int m) {
   return h;
 }
 
-/*  Double the number of slots available in a cm_hashtable.
+/*  Move the elements of a cm_hashtable into a new table with {m}
+ *  slots.  That drops the deleted slots, and, if {m} is larger than
+ *  the current size, makes room.
  */
-static int cm_hashgrow(cm_hashtable *h) {
-  void **c;
-
-  c = (void **)cm_realloc(h->h_cm, h->h_table, sizeof(void *) * h->h_m * 2);
-  if (c == NULL) return ENOMEM;
-  h->h_table = c;
-
-  /*  Move entries into new chain slots if their hash value
-   *  has the new bit set.
-   */
-  {
-    register unsigned long const newbit = h->h_m;
-    register void **o = (void **)h->h_table, **n = o + h->h_m,
-                  **const N = n + h->h_m, **ne, **p;
-
-    /* 	|--- old buckets ---|--- new buckets ---|
-     *    o >>>               n >>>               N
-     */
-    for (; n < N; n++, o++) {
-      ne = n; /*  ne points to the current end of the new chain */
-      p = o;  /*  p  walks the old chain.			   */
-
-      while (*p)
-        if (INFO(h, *p)->sl_hash & newbit) {
-          /* make *p skip an item; chain that item
-           * into *ne instead; make the pointer to *p
-           * point to next of *p.  (Pull on the rope.)
-           */
-
-          *ne = *p;
-          ne = &NEXT(h, *ne);
-          *p = *ne;
-        } else
-          p = &NEXT(h, *p); /* move along the rope */
-
-      /*
-       * Terminate the new chain.  (*p inherits the old terminator.)
-       */
-      *ne = (void *)0;
-    }
+static int cm_hashresize(cm_hashtable *h, unsigned long m) {
+  void **table, *e;
+  unsigned char *ctrl;
+  unsigned long g, i, mask = m - 1, step;
+  unsigned long hash;
+
+  if ((table = hash_table_alloc(h->h_cm, m)) == NULL) return ENOMEM;
+  ctrl = (unsigned char *)(table + m);
+
+  for (i = 0; i < h->h_m; i++) {
+    if (h->h_ctrl[i] & CM_HASH_EMPTY) continue;
+
+    e = h->h_table[i];
+    hash = INFO(h, e)->sl_hash;
+    step = 0;
+    g = (hash >> 7) & mask & ~(unsigned long)(CM_HASH_GROUP - 1);
+    while (group_free(ctrl + g) == 0)
+      g = (g + (step += CM_HASH_GROUP)) & mask;
+
+    g += __builtin_ctz(group_free(ctrl + g));
+    table[g] = e;
+    ctrl[g] = hash & 0x7F;
+    INFO(h, e)->sl_index = g;
   }
+  cm_free(h->h_cm, h->h_table);
 
-  h->h_mask |= h->h_m;
-  h->h_m *= 2;
-  h->h_limit = h->h_m * 2 / 3; /* recalculate limit	*/
+  h->h_table = table;
+  h->h_ctrl = ctrl;
+  h->h_m = m;
+  h->h_mask = mask;
+  h->h_limit = CM_HASH_LIMIT(m);
+  h->h_deleted = 0;
 
   return 0;
 }
@@ -224,30 +373,43 @@ static int cm_hashgrow(cm_hashtable *h) {
  * @return a pointer to the value data, or NULL if the call failed.
  */
 void *cm_hash(cm_hashtable *h, void const *mem, size_t size, int alloc) {
-  unsigned long i = hashf((unsigned char *)mem, size);
-  void **s;
+  unsigned long const hash = hashf((unsigned char const *)mem, size);
+  unsigned long i, found;
   void *e;
   slot *sl;
 
-  for (s = h->h_table + (i & h->h_mask); *s; s = &sl->sl_next) {
-    sl = INFO(h, *s);
-    if (sl->sl_hash >= i) {
-      if (sl->sl_hash > i) break;
-
-      if (SIZE(h, *s) == size && !memcmp(MEM(h, *s), mem, SIZE(h, *s))) {
-        if (alloc == CM_HASH_CREATE_ONLY) {
-          errno = EEXIST;
-          return NULL;
-        }
-        return *s;
-      }
+  if ((found = hash_find(h, mem, size, hash, &i)) < h->h_m) {
+    if (alloc == CM_HASH_CREATE_ONLY) {
+      errno = EEXIST;
+      return NULL;
     }
+    return h->h_table[found];
   }
   if (alloc == CM_HASH_READ_ONLY) {
     errno = ENOENT;
     return NULL;
   }
 
+  /*  Taking an empty slot in a table that's full enough?
+   *  Grow it -- or, if it's mostly deleted slots, just
+   *  clean it up -- and look for a slot again.
+   */
+  if (h->h_ctrl[i] == CM_HASH_EMPTY &&
+      h->h_n + h->h_deleted + 1 >= h->h_limit) {
+    unsigned long m = h->h_deleted >= h->h_n / 2 ? h->h_m : h->h_m * 2;
+
+    if (cm_hashresize(h, m) == 0)
+      (void)hash_find(h, mem, size, hash, &i);
+
+    /*  We can limp along without growing until the
+     *  last empty slot.
+     */
+    else if (h->h_n + h->h_deleted + 2 >= h->h_m) {
+      errno = ENOMEM;
+      return NULL;
+    }
+  }
+
   e = cm_malloc(h->h_cm, h->h_value_size + sizeof(slot) + size + 1);
   if (e == NULL) return NULL;
 
@@ -256,17 +418,15 @@ void *cm_hash(cm_hashtable *h, void const *mem, size_t size, int alloc) {
   ((char *)MEM(h, e))[size] = 0;
   sl = INFO(h, e);
   sl->sl_size = size;
-  sl->sl_hash = i;
+  sl->sl_hash = hash;
+  sl->sl_index = i;
 
-  /* chain in
-   */
-  sl->sl_next = *s;
-  *s = e;
-
-  /* count and do housekeeping if necessary.
+  /* file in, and count.
    */
+  if (h->h_ctrl[i] == CM_HASH_DELETED) h->h_deleted--;
+  h->h_ctrl[i] = hash & 0x7F;
+  h->h_table[i] = e;
   h->h_n++;
-  if (h->h_n >= h->h_limit) cm_hashgrow(h);
 
   return e;
 }
@@ -285,25 +445,27 @@ void *cm_hash(cm_hashtable *h, void const *mem, size_t size, int alloc) {
  * When cm_hashnext() returns a null pointer, all elements have been visited
  * exactly once.
  *
+ * The order is that of the slots, and depends on the hash function,
+ * the table size, and the order in which colliding keys were added.
+ * Deleting an element once its successor has been fetched is safe;
+ * adding one during a traversal may resize the table, after which
+ * elements may be skipped or visited twice.
+ *
  * @param h the hashtable
  * @param prev NULL or the previous value returned by a call.
  * @return NULL at the end, otherwise the element following @b prev
  *	(in some arbitrary, but fixed, order.)
  */
 void *cm_hashnext(cm_hashtable const *h, void const *prev) {
+  unsigned long i;
+
   if (h == NULL) return NULL;
-  if (prev && NEXT(h, prev))
-    return NEXT(h, prev); /* same bucket chain */
-  else {
-    register void **s = h->h_table, **const e = s + h->h_m;
 
-    /* linear scan for next bucket.
-     */
-    if (prev) s += (INFO(h, prev)->sl_hash & h->h_mask) + 1;
-    while (s < e)
-      if (*s++) return s[-1];
-    return (void *)0;
-  }
+  /* linear scan for the next slot in use.
+   */
+  for (i = prev ? INFO(h, prev)->sl_index + 1 : 0; i < h->h_m; i++)
+    if (!(h->h_ctrl[i] & CM_HASH_EMPTY)) return h->h_table[i];
+  return (void *)0;
 }
 
 /**
@@ -314,23 +476,16 @@ void *cm_hashnext(cm_hashtable const *h, void const *prev) {
  * @param h the hashtable
  */
 void cm_hashfinish(cm_hashtable *h) {
-  void **s;
-  void **e;
+  unsigned long i;
 
-  if (h == NULL || (s = h->h_table) == NULL) return;
+  if (h == NULL || h->h_table == NULL) return;
 
-  s = h->h_table;
-  e = s + h->h_m;
+  for (i = 0; i < h->h_m; i++)
+    if (!(h->h_ctrl[i] & CM_HASH_EMPTY)) cm_free(h->h_cm, h->h_table[i]);
 
-  while (s < e) {
-    register char *n = *s++, *p;
-    while ((p = n) != NULL) {
-      n = NEXT(h, p);
-      cm_free(h->h_cm, p);
-    }
-  }
   cm_free(h->h_cm, h->h_table);
   h->h_table = NULL;
+  h->h_ctrl = NULL;
   h->h_m = 0;
 }
 
@@ -382,13 +537,23 @@ size_t cm_hashsize(cm_hashtable const *h, void const *value) {
  * @param value pointer to a hash table value
  */
 void cm_hashdelete(cm_hashtable *h, void *value) {
-  void **s;
+  unsigned long i;
 
   if (h == NULL || value == NULL) return;
 
-  s = h->h_table + (h->h_mask & INFO(h, value)->sl_hash);
-  while (*s != value) s = &NEXT(h, *s);
-  *s = NEXT(h, value);
+  /*  If the slot's group has an empty slot, no lookup
+   *  ever goes past it, and the slot can simply be emptied;
+   *  otherwise, it must stay a stepping stone.
+   */
+  i = INFO(h, value)->sl_index;
+  if (group_match(h->h_ctrl + (i & ~(unsigned long)(CM_HASH_GROUP - 1)),
+                  CM_HASH_EMPTY) != 0)
+    h->h_ctrl[i] = CM_HASH_EMPTY;
+  else {
+    h->h_ctrl[i] = CM_HASH_DELETED;
+    h->h_deleted++;
+  }
+  h->h_table[i] = NULL;
 
   cm_free(h->h_cm, value);
   h->h_n--;
@@ -402,33 +567,46 @@ void cm_hashdelete(cm_hashtable *h, void *value) {
  * Return out, if the copy was successful, null otherwise (ENOMEM)
  */
 cm_hashtable *cm_hashcopy(cm_hashtable const *h, cm_hashtable *out) {
+  unsigned long i;
+
   if (!out) return 0;
 
   bool const out_initialized = out->h_cm && out->h_table && out->h_m &&
                                out->h_m == out->h_mask + 1 &&
-                               out->h_limit == out->h_m * 2 / 3;
+                               out->h_limit == CM_HASH_LIMIT(out->h_m);
 
   if (out_initialized) cm_hashfinish(out);
 
   *out = *h;
 
-  out->h_table = cm_talloc(out->h_cm, void *, out->h_m);
-  memcpy(out->h_table, h->h_table, out->h_m * sizeof(void *));
-
-  void **s = out->h_table;
-  void **e = s + out->h_m;
-  while (s < e) {
-    void **p = s;
-    void *hte = *s;
+  out->h_table = cm_malloc(out->h_cm, out->h_m * (sizeof(void *) + 1));
+  if (out->h_table == NULL) goto err;
+  out->h_ctrl = (unsigned char *)(out->h_table + out->h_m);
+  memcpy(out->h_ctrl, h->h_ctrl, out->h_m);
 
-    while (hte) {
-      *p = cm_malcpy(h->h_cm, hte,
-                     h->h_value_size + sizeof(slot) + SIZE(h, hte) + 1);
-      p = &NEXT(out, *p);
-      hte = NEXT(out, hte);
+  for (i = 0; i < out->h_m; i++) {
+    if (h->h_ctrl[i] & CM_HASH_EMPTY) {
+      out->h_table[i] = NULL;
+      continue;
+    }
+    out->h_table[i] = cm_malcpy(h->h_cm, h->h_table[i],
+                                h->h_value_size + sizeof(slot) +
+                                    SIZE(h, h->h_table[i]) + 1);
+    if (out->h_table[i] == NULL) {
+      while (i-- > 0)
+        if (!(h->h_ctrl[i] & CM_HASH_EMPTY))
+          cm_free(out->h_cm, out->h_table[i]);
+      cm_free(out->h_cm, out->h_table);
+      goto err;
     }
-    s++;
   }
-
   return out;
+
+err:
+  out->h_table = NULL;
+  out->h_ctrl = NULL;
+  out->h_m = 0;
+  out->h_n = 0;
+
+  return NULL;
 }
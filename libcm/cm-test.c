@@ -144,9 +144,9 @@ static int hashtable(cm_handle *cm, char const *file, int line) {
 
   elem = cm_haccess(h, char *, "blue", 5);
   TEST(elem != NULL);
-  TEST(strcmp(*elem, "fish"));
+  TEST(!strcmp(*elem, "fish"));
 
-  elem = cm_hexcl(h, char *, "red", 5);
+  elem = cm_hexcl(h, char *, "red", 4);
   TEST(elem != NULL);
   TEST(*elem == NULL);
 
@@ -163,6 +163,146 @@ static int hashtable(cm_handle *cm, char const *file, int line) {
   return 0;
 }
 
+/*  Check that <h> contains exactly the keys i < n with present[i]
+ *  set, each mapped to itself.
+ */
+static int hashtable_check(cm_hashtable *h, unsigned char const *present,
+                           unsigned long n, char const *file, int line) {
+  unsigned long i, n_present = 0, n_seen = 0;
+  unsigned long *val;
+
+  for (i = 0; i < n; i++) {
+    val = cm_haccess(h, unsigned long, &i, sizeof i);
+    if (present[i]) {
+      n_present++;
+      TEST(val != NULL);
+      TEST(*val == i);
+      TEST(cm_hsize(h, unsigned long, val) == sizeof i);
+      TEST(!memcmp(cm_hmem(h, unsigned long, val), &i, sizeof i));
+    } else
+      TEST(val == NULL);
+  }
+  TEST(cm_hashnelems(h) == n_present);
+
+  for (val = NULL; (val = cm_hnext(h, unsigned long, val)) != NULL; n_seen++) {
+    TEST(*val < n);
+    TEST(present[*val]);
+  }
+  TEST(n_seen == n_present);
+
+  except_catch(err) {
+    fprintf(stderr, "\t[from \"%s\", line %d]\n", file, line);
+    return 1;
+  }
+  return 0;
+}
+
+/*  Deleting and reinserting keys, growing the table while
+ *  that's going on, and copying it.
+ */
+static int hashtable_churn(cm_handle *cm, char const *file, int line) {
+  enum { N = 20000 };
+  static unsigned char present[N], copied[N];
+  cm_hashtable *h, copy;
+  unsigned long i, m, seed = 1;
+  unsigned long *val;
+
+  memset(present, 0, sizeof present);
+  memset(&copy, 0, sizeof copy);
+
+  h = cm_hcreate(cm, unsigned long, 4);
+  TEST(h != NULL);
+
+  /*  Fill, then delete every other key.  Deleted slots either
+   *  become empty again or turn into tombstones; reinserting
+   *  the same keys must find them, not grow the table.
+   */
+  for (i = 0; i < 1000; i++) {
+    val = cm_hnew(h, unsigned long, &i, sizeof i);
+    TEST(val != NULL);
+    *val = i;
+    present[i] = 1;
+  }
+  TEST(!hashtable_check(h, present, N, __FILE__, __LINE__));
+
+  m = h->h_m;
+  for (i = 0; i < 1000; i += 2) {
+    val = cm_haccess(h, unsigned long, &i, sizeof i);
+    TEST(val != NULL);
+    cm_hdelete(h, unsigned long, val);
+    present[i] = 0;
+  }
+  TEST(!hashtable_check(h, present, N, __FILE__, __LINE__));
+
+  for (i = 0; i < 1000; i += 2) {
+    val = cm_hexcl(h, unsigned long, &i, sizeof i);
+    TEST(val != NULL);
+    *val = i;
+    present[i] = 1;
+  }
+  TEST(h->h_m == m);
+  TEST(!hashtable_check(h, present, N, __FILE__, __LINE__));
+
+  /*  Random inserts and deletes, with the table growing from
+   *  1,000 to about N/2 elements along the way.
+   */
+  for (m = 0; m < 200000; m++) {
+    seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+    i = (seed >> 33) % (m < 100000 ? N / 4 + m / 7 : N);
+    if (present[i]) {
+      val = cm_haccess(h, unsigned long, &i, sizeof i);
+      TEST(val != NULL);
+      TEST(*val == i);
+      cm_hdelete(h, unsigned long, val);
+      present[i] = 0;
+    } else {
+      val = cm_hexcl(h, unsigned long, &i, sizeof i);
+      TEST(val != NULL);
+      *val = i;
+      present[i] = 1;
+    }
+    TEST(h->h_n + h->h_deleted <= h->h_limit);
+  }
+  TEST(!hashtable_check(h, present, N, __FILE__, __LINE__));
+
+  /*  A copy has the same contents, and doesn't change
+   *  when the original does.
+   */
+  TEST(cm_hashcopy(h, &copy) == &copy);
+  TEST(!hashtable_check(&copy, present, N, __FILE__, __LINE__));
+
+  memcpy(copied, present, sizeof copied);
+  for (i = 0; i < N; i += 3) {
+    if (present[i]) {
+      val = cm_haccess(h, unsigned long, &i, sizeof i);
+      TEST(val != NULL);
+      cm_hdelete(h, unsigned long, val);
+      present[i] = 0;
+    } else {
+      val = cm_hnew(h, unsigned long, &i, sizeof i);
+      TEST(val != NULL);
+      *val = i;
+      present[i] = 1;
+    }
+  }
+  TEST(!hashtable_check(h, present, N, __FILE__, __LINE__));
+  TEST(!hashtable_check(&copy, copied, N, __FILE__, __LINE__));
+
+  /*  Copying into an initialized table replaces its contents.
+   */
+  TEST(cm_hashcopy(h, &copy) == &copy);
+  TEST(!hashtable_check(&copy, present, N, __FILE__, __LINE__));
+
+  cm_hashfinish(&copy);
+  cm_hdestroy(h, unsigned long);
+
+  except_catch(err) {
+    fprintf(stderr, "\t[from \"%s\", line %d]\n", file, line);
+    return 1;
+  }
+  return 0;
+}
+
 int main(int ac, char **av) {
   cm_handle *h_c, *cm;
   int result = 0;
@@ -179,6 +319,8 @@ int main(int ac, char **av) {
   result |= malloc_realloc_free(cm, __FILE__, __LINE__);
   result |= mallocing_sprintf(cm, __FILE__, __LINE__);
   result |= test_malcpy(cm);
+  result |= hashtable(cm, __FILE__, __LINE__);
+  result |= hashtable_churn(cm, __FILE__, __LINE__);
   cm_trace_destroy(cm);
 
   /* A round with the error library. */
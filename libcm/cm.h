@@ -418,7 +418,13 @@ typedef struct cm_hashtable {
   unsigned long h_n;
 
   /**
-   * @brief If h_n >= h_limit, the hashtable should grow.
+   * @brief Number of slots whose element has been deleted,
+   *	but that lookups still have to step over.
+   */
+  unsigned long h_deleted;
+
+  /**
+   * @brief If h_n + h_deleted >= h_limit, the hashtable should grow.
    */
   unsigned long h_limit;
 
@@ -428,10 +434,17 @@ typedef struct cm_hashtable {
   size_t h_value_size;
 
   /**
-   * @brief Table of pointers to individual hash table slot arrays.
+   * @brief Table of pointers to the elements in the slots.
    */
   void **h_table;
 
+  /**
+   * @brief One control byte per slot: empty, deleted, or the
+   *	low bits of the hash of the element in it.  Allocated
+   *	together with h_table.
+   */
+  unsigned char *h_ctrl;
+
 } cm_hashtable;
 
 cm_hashtable *cm_hashcreate(cm_handle *, size_t, int);
@@ -0,0 +1,228 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libcm/cm.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+
+/*  cmhashbench -- microbenchmark for cm_hashtable.
+ *
+ *  For each table size n, times, in nanoseconds per operation:
+ *
+ *	dedup	  2n cm_hnew() calls with 8-byte ids drawn uniformly
+ *		  from [0...n), counting the ones that are new;
+ *	isa	  the same, with ids shaped like what an "isa" iterator
+ *		  weeds duplicates out of: the linkage targets of 2n
+ *		  sources read in id order.  Most point to a few
+ *		  hubs, some far more popular than others; the rest
+ *		  point to a neighbor a little below the source;
+ *	hit	  cm_haccess() of ids that are in the table;
+ *	miss	  cm_haccess() of ids that aren't;
+ *	churn	  cm_hdelete() of one element and cm_hnew() of
+ *		  another, at a constant size;
+ *	names	  cm_hnew() + cm_haccess() of short strings, like
+ *		  variable names.
+ *
+ *  The distinct-id counts are cross-checked against a bitmap.
+ *  (The "isa" iterator itself keeps its ids in a graph_idset;
+ *  cm_hashtable is what the rest of graphd uses for such sets.)
+ */
+
+#define PROCNAME "cmhashbench"
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [-n max-size] [-r repeat] [-s seed]\n",
+          PROCNAME);
+  exit(EX_USAGE);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long random_id(unsigned long long n) {
+  return (((unsigned long long)random() << 31) ^ random()) % n;
+}
+
+/*  The linkage target of source i, 0 <= i < 2n, in [0...n):
+ *  three out of four go to one of n/100 hubs, with low-numbered
+ *  hubs more popular; the rest to a neighbor of i/2.
+ */
+static unsigned long long isa_target(unsigned long long i,
+                                     unsigned long long n) {
+  unsigned long long const hubs = n / 100 + 1;
+
+  if (random() % 4 != 0)
+    return (random_id(hubs) * random_id(hubs) / hubs) * (n / hubs);
+  return (i / 2 + n - random_id(64)) % n;
+}
+
+static void fail(char const *what, unsigned long long id) {
+  fprintf(stderr, "%s: %s failed for %llu\n", PROCNAME, what, id);
+  exit(EX_SOFTWARE);
+}
+
+int main(int ac, char **av) {
+  cm_handle *cm = cm_c();
+  size_t max = 1000 * 1000, n;
+  unsigned long seed = 42;
+  int opt, repeat = 3;
+
+  while ((opt = getopt(ac, av, "n:r:s:")) != EOF) switch (opt) {
+      case 'n':
+        max = strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        repeat = atoi(optarg);
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage();
+    }
+  if (max == 0 || repeat <= 0) usage();
+  srandom(seed);
+
+  printf("# %d repetitions; times in ns per operation\n", repeat);
+  printf("%10s %10s %8s %8s %8s %8s %8s %8s\n", "n", "distinct", "dedup",
+         "isa", "hit", "miss", "churn", "names");
+
+  for (n = 1000; n <= max; n *= 10) {
+    unsigned long long *draw, *target, id;
+    unsigned char *seen;
+    size_t i, distinct = 0, expected = 0, isa_expected = 0;
+    double t[6] = {0, 0, 0, 0, 0, 0};
+    char name[32];
+    int r;
+
+    draw = malloc(2 * n * sizeof(*draw));
+    target = malloc(2 * n * sizeof(*target));
+    seen = calloc(n, 1);
+    if (draw == NULL || target == NULL || seen == NULL) {
+      fprintf(stderr, "%s: out of memory\n", PROCNAME);
+      exit(EX_OSERR);
+    }
+    for (i = 0; i < 2 * n; i++) {
+      draw[i] = random_id(n);
+      if (!seen[draw[i]]) {
+        seen[draw[i]] = 1;
+        expected++;
+      }
+    }
+    memset(seen, 0, n);
+    for (i = 0; i < 2 * n; i++) {
+      target[i] = isa_target(i, n);
+      if (!seen[target[i]]) {
+        seen[target[i]] = 1;
+        isa_expected++;
+      }
+    }
+
+    for (r = 0; r < repeat; r++) {
+      cm_hashtable h, h_isa;
+      size_t isa_distinct;
+      char *v;
+      double t0;
+
+      if (cm_hashinit(cm, &h, sizeof(char), 16)) fail("cm_hashinit", n);
+
+      t0 = now();
+      for (distinct = 0, i = 0; i < 2 * n; i++) {
+        if ((v = cm_hnew(&h, char, draw + i, sizeof *draw)) == NULL)
+          fail("cm_hnew", draw[i]);
+        if (*v == 0) {
+          *v = 1;
+          distinct++;
+        }
+      }
+      t[0] += now() - t0;
+      if (distinct != expected || cm_hashnelems(&h) != expected) {
+        fprintf(stderr, "%s: %zu distinct ids, expected %zu\n", PROCNAME,
+                distinct, expected);
+        exit(EX_SOFTWARE);
+      }
+
+      if (cm_hashinit(cm, &h_isa, sizeof(char), 16)) fail("cm_hashinit", n);
+      t0 = now();
+      for (isa_distinct = 0, i = 0; i < 2 * n; i++) {
+        if ((v = cm_hnew(&h_isa, char, target + i, sizeof *target)) == NULL)
+          fail("cm_hnew", target[i]);
+        if (*v == 0) {
+          *v = 1;
+          isa_distinct++;
+        }
+      }
+      t[5] += now() - t0;
+      cm_hashfinish(&h_isa);
+      if (isa_distinct != isa_expected) {
+        fprintf(stderr, "%s: %zu distinct targets, expected %zu\n", PROCNAME,
+                isa_distinct, isa_expected);
+        exit(EX_SOFTWARE);
+      }
+
+      t0 = now();
+      for (i = 0; i < n; i++)
+        if (cm_haccess(&h, char, draw + i, sizeof *draw) == NULL)
+          fail("cm_haccess", draw[i]);
+      t[1] += now() - t0;
+
+      t0 = now();
+      for (i = 0; i < n; i++) {
+        id = n + draw[i];
+        if (cm_haccess(&h, char, &id, sizeof id) != NULL)
+          fail("cm_haccess (miss)", id);
+      }
+      t[2] += now() - t0;
+
+      t0 = now();
+      for (i = 0; i < n; i++) {
+        if ((v = cm_haccess(&h, char, draw + i, sizeof *draw)) != NULL)
+          cm_hdelete(&h, char, v);
+        id = 2 * n + i;
+        if (cm_hnew(&h, char, &id, sizeof id) == NULL) fail("cm_hnew", id);
+      }
+      t[3] += now() - t0;
+      cm_hashfinish(&h);
+
+      if (cm_hashinit(cm, &h, sizeof(char), 16)) fail("cm_hashinit", n);
+      t0 = now();
+      for (i = 0; i < 2 * n; i++) {
+        snprintf(name, sizeof name, "$var%llu", draw[i]);
+        if (cm_hnew(&h, char, name, strlen(name)) == NULL)
+          fail("cm_hnew", draw[i]);
+        if (cm_haccess(&h, char, name, strlen(name)) == NULL)
+          fail("cm_haccess", draw[i]);
+      }
+      t[4] += now() - t0;
+      cm_hashfinish(&h);
+    }
+
+    printf("%10zu %10zu %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", n, distinct,
+           1e9 * t[0] / (2.0 * n * repeat), 1e9 * t[5] / (2.0 * n * repeat),
+           1e9 * t[1] / ((double)n * repeat),
+           1e9 * t[2] / ((double)n * repeat), 1e9 * t[3] / ((double)n * repeat),
+           1e9 * t[4] / (4.0 * n * repeat));
+
+    free(draw);
+    free(target);
+    free(seen);
+  }
+  return 0;
+}
@@ -22,6 +22,18 @@ void es_application_event_loc(es_handle *es, es_descriptor *ed,
   if (!ed->ed_application_event) {
     cl_log(es->es_cl, CL_LEVEL_DEBUG, "%p: application event [%s:%d]",
            (void *)ed, file, line);
+
+    /*  es_loop() visits the descriptors on this list, rather
+     *  than looking for the flag everywhere.
+     */
+    if (ed->ed_poll != (size_t)-1 &&
+        es_fd_list_add(es, &es->es_app, &es->es_app_n, &es->es_app_m,
+                       es->es_poll[ed->ed_poll].fd) != 0) {
+      cl_log(es->es_cl, CL_LEVEL_ERROR,
+             "%p: out of memory for application event [%s:%d]", (void *)ed,
+             file, line);
+      return;
+    }
     ed->ed_application_event = true;
     es->es_application_event_n++;
   }
@@ -0,0 +1,203 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libes/esp.h"
+
+#if ES_HAVE_EPOLL
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+/*  epoll(7), level-triggered.
+ *
+ *  Edge-triggered notification would require every callback to
+ *  read or write until EAGAIN; ours stop when their buffers are
+ *  full and expect to be called again.
+ */
+
+/*  At most this many events per wait.
+ */
+#define ES_EPOLL_EVENTS 1024
+
+typedef struct es_epoll {
+  int ep_fd;
+
+  /*  File descriptors epoll can't watch.
+   */
+  int *ep_always;
+  size_t ep_always_n;
+  size_t ep_always_m;
+
+  struct epoll_event ep_event[ES_EPOLL_EVENTS];
+
+} es_epoll;
+
+static void epoll_always_remove(es_handle *es, es_epoll *ep, int fd) {
+  size_t i;
+
+  es->es_backend_fd[fd].ebf_always = false;
+  for (i = 0; i < ep->ep_always_n; i++)
+    if (ep->ep_always[i] == fd) {
+      ep->ep_always[i] = ep->ep_always[--ep->ep_always_n];
+      break;
+    }
+}
+
+static int epoll_sync(es_handle *es, int fd) {
+  es_epoll *ep = es->es_backend_data;
+  es_backend_fd *ebf = es->es_backend_fd + fd;
+  es_descriptor *ed = es_backend_descriptor(es, fd);
+  struct epoll_event ev;
+  int op;
+
+  memset(&ev, 0, sizeof ev);
+  ev.data.fd = fd;
+
+  if (ebf->ebf_always) {
+    if (ed == NULL) epoll_always_remove(es, ep, fd);
+    return 0;
+  }
+  if (ed == NULL) {
+    if (!ebf->ebf_added) return 0;
+    op = EPOLL_CTL_DEL;
+  } else {
+    /*  EPOLLIN and EPOLLOUT are POLLIN and POLLOUT.
+     */
+    ev.events = es->es_poll[ed->ed_poll].events & (POLLIN | POLLOUT);
+    if (ebf->ebf_added && ebf->ebf_events == ev.events) return 0;
+    op = ebf->ebf_added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  }
+
+  if (epoll_ctl(ep->ep_fd, op, fd, &ev) != 0) {
+    int err = errno;
+
+    /*  The file descriptor was closed and reopened behind
+     *  our back, or closed before es_close().
+     */
+    if (op == EPOLL_CTL_MOD && err == ENOENT)
+      err = epoll_ctl(ep->ep_fd, op = EPOLL_CTL_ADD, fd, &ev) ? errno : 0;
+    else if (op == EPOLL_CTL_DEL && (err == EBADF || err == ENOENT))
+      err = 0;
+    else if (op == EPOLL_CTL_ADD && err == EPERM) {
+      if ((err = es_fd_list_add(es, &ep->ep_always, &ep->ep_always_n,
+                                &ep->ep_always_m, fd)) == 0) {
+        ebf->ebf_always = true;
+        return 0;
+      }
+    }
+
+    if (err != 0) {
+      cl_log_errno(es->es_cl, CL_LEVEL_FAIL, "epoll_ctl", err, "fd=%d, op=%d",
+                   fd, op);
+      ebf->ebf_added = false;
+      return err;
+    }
+  }
+  ebf->ebf_added = op != EPOLL_CTL_DEL;
+  ebf->ebf_events = ev.events;
+
+  return 0;
+}
+
+static void epoll_stop(es_handle *es, bool forked) {
+  es_epoll *ep = es->es_backend_data;
+
+  if (ep == NULL) return;
+
+  if (ep->ep_always != NULL) cm_free(es->es_cm, ep->ep_always);
+  (void)close(ep->ep_fd);
+  cm_free(es->es_cm, ep);
+  es->es_backend_data = NULL;
+}
+
+static int epoll_start(es_handle *es) {
+  es_epoll *ep;
+  int err;
+
+  if ((ep = cm_talloc(es->es_cm, es_epoll, 1)) == NULL) return ENOMEM;
+  memset(ep, 0, sizeof *ep);
+
+  if ((ep->ep_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    err = errno;
+    cm_free(es->es_cm, ep);
+    return err;
+  }
+  es->es_backend_data = ep;
+
+  return 0;
+}
+
+static void epoll_close(es_handle *es, int fd) {
+  es_epoll *ep = es->es_backend_data;
+  es_backend_fd *ebf = es->es_backend_fd + fd;
+  struct epoll_event ev;
+
+  if (ebf->ebf_always) epoll_always_remove(es, ep, fd);
+  if (!ebf->ebf_added) return;
+
+  /*  Usually, the application has closed the file descriptor
+   *  already, and this fails; that's fine.
+   */
+  memset(&ev, 0, sizeof ev);
+  (void)epoll_ctl(ep->ep_fd, EPOLL_CTL_DEL, fd, &ev);
+  ebf->ebf_added = false;
+}
+
+static int epoll_wait_events(es_handle *es, int millis) {
+  es_epoll *ep = es->es_backend_data;
+  size_t i;
+  int n, k;
+
+  cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: epoll [%lu] timeout=%d",
+         (unsigned long)es->es_desc_n, millis);
+
+  n = epoll_wait(ep->ep_fd, ep->ep_event, ES_EPOLL_EVENTS,
+                 ep->ep_always_n > 0 ? 0 : millis);
+  if (n < 0) return n;
+
+  for (k = 0; k < n; k++) {
+    int fd = ep->ep_event[k].data.fd;
+    es_descriptor *ed;
+
+    if ((ed = es_backend_descriptor(es, fd)) == NULL) continue;
+
+    /*  EPOLLERR and EPOLLHUP are POLLERR and POLLHUP, too.
+     */
+    es->es_poll[ed->ed_poll].revents =
+        ep->ep_event[k].events & (POLLIN | POLLOUT | POLLERR | POLLHUP);
+    es_backend_ready(es, fd);
+  }
+
+  for (i = 0; i < ep->ep_always_n; i++) {
+    es_descriptor *ed = es_backend_descriptor(es, ep->ep_always[i]);
+    struct pollfd *pfd;
+
+    if (ed == NULL) continue;
+    pfd = es->es_poll + ed->ed_poll;
+    if ((pfd->revents = pfd->events & (POLLIN | POLLOUT)) == 0) continue;
+
+    es_backend_ready(es, ep->ep_always[i]);
+    n++;
+  }
+
+  cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: epoll results: %d", n);
+  return n;
+}
+
+es_backend const es_backend_epoll = {"epoll",    epoll_start,
+                                     epoll_stop, epoll_sync,
+                                     epoll_close, epoll_wait_events};
+
+#endif /* ES_HAVE_EPOLL */
@@ -0,0 +1,338 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libes/esp.h"
+
+#if ES_HAVE_IO_URING
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*  io_uring(7), with one-shot poll requests.
+ *
+ *  Each file descriptor we're interested in has one outstanding
+ *  IORING_OP_POLL_ADD.  When it completes, the file descriptor
+ *  goes back onto the change list, and the next sync re-arms it;
+ *  if it's still ready, that completes right away, which gives
+ *  us the same level-triggered behavior as poll(2).
+ *
+ *  Requests are tagged with the file descriptor and a serial
+ *  number; completions of requests we've since cancelled or
+ *  replaced are ignored.
+ */
+
+/*  Size of the submission queue; the completion queue is
+ *  four times as large.
+ */
+#define ES_URING_ENTRIES 1024
+
+/*  user_data of requests whose completions we don't care about.
+ */
+#define ES_URING_IGNORE (~0ull)
+
+typedef struct es_uring {
+  int eu_fd;
+  unsigned int eu_serial;
+
+  void *eu_sq_ring;
+  size_t eu_sq_ring_size;
+  unsigned int *eu_sq_head;
+  unsigned int *eu_sq_tail;
+  unsigned int *eu_sq_mask;
+  unsigned int *eu_sq_array;
+  unsigned int eu_sq_entries;
+
+  struct io_uring_sqe *eu_sqe;
+  size_t eu_sqe_size;
+
+  void *eu_cq_ring;
+  size_t eu_cq_ring_size;
+  unsigned int *eu_cq_head;
+  unsigned int *eu_cq_tail;
+  unsigned int *eu_cq_mask;
+  struct io_uring_cqe *eu_cqe;
+
+} es_uring;
+
+static int uring_enter(es_uring *eu, unsigned int to_submit,
+                       unsigned int min_complete, unsigned int flags,
+                       void *arg, size_t arg_size) {
+  return (int)syscall(__NR_io_uring_enter, eu->eu_fd, to_submit, min_complete,
+                      flags, arg, arg_size);
+}
+
+static unsigned int uring_unsubmitted(es_uring *eu) {
+  return *eu->eu_sq_tail - __atomic_load_n(eu->eu_sq_head, __ATOMIC_ACQUIRE);
+}
+
+/*  Get a submission queue entry, submitting what we have
+ *  if the queue is full.
+ */
+static struct io_uring_sqe *uring_sqe(es_handle *es, es_uring *eu) {
+  struct io_uring_sqe *sqe;
+  unsigned int tail = *eu->eu_sq_tail, i;
+
+  if (uring_unsubmitted(eu) >= eu->eu_sq_entries) {
+    if (uring_enter(eu, uring_unsubmitted(eu), 0, 0, NULL, 0) < 0) {
+      cl_log_errno(es->es_cl, CL_LEVEL_FAIL, "io_uring_enter", errno,
+                   "can't submit %u requests", uring_unsubmitted(eu));
+      return NULL;
+    }
+    if (uring_unsubmitted(eu) >= eu->eu_sq_entries) return NULL;
+  }
+
+  i = tail & *eu->eu_sq_mask;
+  sqe = eu->eu_sqe + i;
+  memset(sqe, 0, sizeof *sqe);
+  eu->eu_sq_array[i] = i;
+
+  return sqe;
+}
+
+static void uring_push(es_uring *eu) {
+  __atomic_store_n(eu->eu_sq_tail, *eu->eu_sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_sync(es_handle *es, int fd) {
+  es_uring *eu = es->es_backend_data;
+  es_backend_fd *ebf = es->es_backend_fd + fd;
+  es_descriptor *ed = es_backend_descriptor(es, fd);
+  struct io_uring_sqe *sqe;
+  unsigned int events = 0;
+
+  if (ed != NULL)
+    events = es->es_poll[ed->ed_poll].events & (POLLIN | POLLOUT);
+
+  if (ebf->ebf_added) {
+    if (ed != NULL && ebf->ebf_events == events) return 0;
+
+    /*  Cancel the old request.
+     */
+    if ((sqe = uring_sqe(es, eu)) == NULL) return ENOMEM;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = ((unsigned long long)ebf->ebf_serial << 32) | (unsigned)fd;
+    sqe->user_data = ES_URING_IGNORE;
+    uring_push(eu);
+
+    ebf->ebf_added = false;
+  }
+  if (ed == NULL) return 0;
+
+  if ((sqe = uring_sqe(es, eu)) == NULL) {
+    /*  Try again next time.
+     */
+    es->es_resync = true;
+    return ENOMEM;
+  }
+  ebf->ebf_serial = ++eu->eu_serial;
+  ebf->ebf_events = events;
+  ebf->ebf_added = true;
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = events;
+  sqe->user_data = ((unsigned long long)ebf->ebf_serial << 32) | (unsigned)fd;
+  uring_push(eu);
+
+  return 0;
+}
+
+static void uring_close(es_handle *es, int fd) {
+  es_uring *eu = es->es_backend_data;
+  es_backend_fd *ebf = es->es_backend_fd + fd;
+  struct io_uring_sqe *sqe;
+
+  if (!ebf->ebf_added) return;
+  ebf->ebf_added = false;
+
+  /*  If we can't cancel, the serial number still tells
+   *  us to ignore the request when it completes.
+   */
+  if ((sqe = uring_sqe(es, eu)) == NULL) return;
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = ((unsigned long long)ebf->ebf_serial << 32) | (unsigned)fd;
+  sqe->user_data = ES_URING_IGNORE;
+  uring_push(eu);
+}
+
+static void uring_stop(es_handle *es, bool forked) {
+  es_uring *eu = es->es_backend_data;
+
+  if (eu == NULL) return;
+
+  if (eu->eu_sqe != NULL && eu->eu_sqe != MAP_FAILED)
+    munmap(eu->eu_sqe, eu->eu_sqe_size);
+  if (eu->eu_cq_ring != NULL && eu->eu_cq_ring != MAP_FAILED &&
+      eu->eu_cq_ring != eu->eu_sq_ring)
+    munmap(eu->eu_cq_ring, eu->eu_cq_ring_size);
+  if (eu->eu_sq_ring != NULL && eu->eu_sq_ring != MAP_FAILED)
+    munmap(eu->eu_sq_ring, eu->eu_sq_ring_size);
+  if (eu->eu_fd >= 0) (void)close(eu->eu_fd);
+
+  cm_free(es->es_cm, eu);
+  es->es_backend_data = NULL;
+}
+
+static int uring_start(es_handle *es) {
+  struct io_uring_params p;
+  es_uring *eu;
+  char *sq, *cq;
+  int err;
+
+  if ((eu = cm_talloc(es->es_cm, es_uring, 1)) == NULL) return ENOMEM;
+  memset(eu, 0, sizeof *eu);
+  es->es_backend_data = eu;
+
+  memset(&p, 0, sizeof p);
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = 4 * ES_URING_ENTRIES;
+
+  eu->eu_fd = (int)syscall(__NR_io_uring_setup, ES_URING_ENTRIES, &p);
+  if (eu->eu_fd < 0) {
+    err = errno;
+    goto err;
+  }
+
+  /*  We need timeouts on io_uring_enter() (Linux 5.11).
+   */
+  if (!(p.features & IORING_FEAT_EXT_ARG)) {
+    err = ENOSYS;
+    goto err;
+  }
+
+  eu->eu_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  eu->eu_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(*eu->eu_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (eu->eu_cq_ring_size > eu->eu_sq_ring_size)
+      eu->eu_sq_ring_size = eu->eu_cq_ring_size;
+    eu->eu_cq_ring_size = eu->eu_sq_ring_size;
+  }
+
+  eu->eu_sq_ring =
+      mmap(NULL, eu->eu_sq_ring_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, eu->eu_fd, IORING_OFF_SQ_RING);
+  if (eu->eu_sq_ring == MAP_FAILED) {
+    err = errno;
+    goto err;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    eu->eu_cq_ring = eu->eu_sq_ring;
+  else {
+    eu->eu_cq_ring =
+        mmap(NULL, eu->eu_cq_ring_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, eu->eu_fd, IORING_OFF_CQ_RING);
+    if (eu->eu_cq_ring == MAP_FAILED) {
+      err = errno;
+      goto err;
+    }
+  }
+  eu->eu_sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  eu->eu_sqe = mmap(NULL, eu->eu_sqe_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, eu->eu_fd, IORING_OFF_SQES);
+  if (eu->eu_sqe == MAP_FAILED) {
+    err = errno;
+    goto err;
+  }
+
+  sq = eu->eu_sq_ring;
+  eu->eu_sq_head = (unsigned int *)(sq + p.sq_off.head);
+  eu->eu_sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+  eu->eu_sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+  eu->eu_sq_array = (unsigned int *)(sq + p.sq_off.array);
+  eu->eu_sq_entries = p.sq_entries;
+
+  cq = eu->eu_cq_ring;
+  eu->eu_cq_head = (unsigned int *)(cq + p.cq_off.head);
+  eu->eu_cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+  eu->eu_cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+  eu->eu_cqe = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  return 0;
+
+err:
+  uring_stop(es, false);
+  return err;
+}
+
+static int uring_wait(es_handle *es, int millis) {
+  es_uring *eu = es->es_backend_data;
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  unsigned int head, tail;
+  int n = 0;
+
+  memset(&arg, 0, sizeof arg);
+  if (millis >= 0) {
+    ts.tv_sec = millis / 1000;
+    ts.tv_nsec = (millis % 1000) * 1000000ll;
+    arg.ts = (unsigned long long)(size_t)&ts;
+  }
+
+  cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: io_uring [%lu] timeout=%d",
+         (unsigned long)es->es_desc_n, millis);
+
+  /*  Don't wait if there's something in the queue already.
+   */
+  head = *eu->eu_cq_head;
+  tail = __atomic_load_n(eu->eu_cq_tail, __ATOMIC_ACQUIRE);
+
+  if (uring_enter(eu, uring_unsubmitted(eu),
+                  millis == 0 || head != tail ? 0 : 1,
+                  IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                  sizeof arg) < 0 &&
+      errno != ETIME && errno != EBUSY)
+    return -1;
+
+  tail = __atomic_load_n(eu->eu_cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    struct io_uring_cqe const *cqe = eu->eu_cqe + (head & *eu->eu_cq_mask);
+    int fd = (int)(cqe->user_data & 0xFFFFFFFFu);
+    unsigned int serial = (unsigned int)(cqe->user_data >> 32);
+    es_backend_fd *ebf;
+    es_descriptor *ed;
+
+    if (cqe->user_data == ES_URING_IGNORE || fd >= es->es_backend_fd_m)
+      continue;
+
+    ebf = es->es_backend_fd + fd;
+    if (!ebf->ebf_added || ebf->ebf_serial != serial) continue;
+
+    /*  The request is done; re-arm it before the next wait.
+     */
+    ebf->ebf_added = false;
+    es_backend_changed(es, fd);
+
+    if ((ed = es_backend_descriptor(es, fd)) == NULL) continue;
+
+    es->es_poll[ed->ed_poll].revents =
+        cqe->res < 0 ? POLLERR
+                     : cqe->res & (POLLIN | POLLOUT | POLLERR | POLLHUP);
+    es_backend_ready(es, fd);
+    n++;
+  }
+  __atomic_store_n(eu->eu_cq_head, head, __ATOMIC_RELEASE);
+
+  cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: io_uring results: %d", n);
+  return n;
+}
+
+es_backend const es_backend_io_uring = {"io_uring", uring_start, uring_stop,
+                                        uring_sync, uring_close, uring_wait};
+
+#endif /* ES_HAVE_IO_URING */
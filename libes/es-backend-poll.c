@@ -0,0 +1,155 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libes/esp.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+
+#if ES_EMULATE_POLL_WITH_SELECT
+
+/*  In Tiger (MacOS 10.4), a previously emulated poll was moved
+ *  into the kernel ... breaking it for, oh, named pipes and terminal I/O.
+ *  See: http://marc.theaimsgroup.com/?l=log&m=111515776629581&w=2
+ */
+#include <sys/types.h>
+#include <sys/select.h>
+
+int es_emulate_poll(struct pollfd *pfd, int n_pfd, int millis) {
+  fd_set rfds, wfds;
+  int i, max_fd = -1, total;
+  struct timeval tv, *tvp = NULL;
+
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+
+  for (i = 0; i < n_pfd; i++) {
+    if (pfd[i].events & POLLIN) FD_SET(pfd[i].fd, &rfds);
+    if (pfd[i].events & POLLOUT) FD_SET(pfd[i].fd, &wfds);
+    if (pfd[i].fd > max_fd) max_fd = pfd[i].fd;
+  }
+  if (millis >= 0) {
+    tvp = &tv;
+    tv.tv_sec = millis / 1000;
+    tv.tv_usec = 1000 * (millis % 1000);
+  }
+
+  i = select(max_fd + 1, &rfds, &wfds, NULL, tvp);
+  if (i < 0) return i;
+
+  for (i = 0, total = 0; i < n_pfd; i++) {
+    pfd[i].revents = 0;
+
+    if (FD_ISSET(pfd[i].fd, &rfds)) pfd[i].revents |= POLLIN;
+    if (FD_ISSET(pfd[i].fd, &wfds)) pfd[i].revents |= POLLOUT;
+
+    if (pfd[i].revents != 0) total++;
+  }
+  return total;
+}
+
+#endif /* ES_EMULATE_POLL_WITH_SELECT */
+
+static char const *pollfd_dump_results(struct pollfd *pfd, int n, char *buf,
+                                       size_t size) {
+  char *w = buf, *e = buf + size;
+  int i;
+
+  if (n <= 0) return "{}";
+  if (size <= 2) return "{...}";
+
+  *w++ = '{';
+  *w = '\0';
+
+  for (i = 0; i < n && e - w >= 10; i++) {
+    if (pfd[i].revents != 0) {
+      snprintf(w, (size_t)(e - w), " %d%s%s%s%s", pfd[i].fd,
+               pfd[i].revents & POLLIN ? "r" : "",
+               pfd[i].revents & POLLOUT ? "w" : "",
+               pfd[i].revents & POLLERR ? "e" : "",
+               pfd[i].revents & POLLNVAL ? "n" : "");
+      w += strlen(w);
+    }
+  }
+
+  if (i < n && e - w >= 5)
+    memcpy(w, "...}", 5);
+  else if (e - w >= 3)
+    memcpy(w, " }", 3);
+
+  return buf;
+}
+
+static char const *pollfd_dump(struct pollfd *pfd, int n, char *buf,
+                               size_t size) {
+  char *w = buf, *e = buf + size;
+  int i;
+
+  if (n == 0) return "{}";
+  if (size <= 2) return "{...}";
+
+  *w++ = '{';
+  *w = '\0';
+
+  for (i = 0; i < n && e - w >= 10; i++) {
+    snprintf(w, (size_t)(e - w), " %d%s%s", pfd[i].fd,
+             pfd[i].events & POLLIN ? "r" : "",
+             pfd[i].events & POLLOUT ? "w" : "");
+    w += strlen(w);
+  }
+
+  if (i < n && e - w >= 5)
+    memcpy(w, "...}", 5);
+  else if (e - w >= 3)
+    memcpy(w, " }", 3);
+
+  return buf;
+}
+
+/*  The poll backend hands es_poll[] to the kernel as a whole,
+ *  each time; it has no state of its own.
+ */
+static int poll_start(es_handle *es) { return 0; }
+
+static void poll_stop(es_handle *es, bool forked) {}
+
+static int poll_wait(es_handle *es, int millis) {
+  char buf[200];
+  size_t i;
+  int n, err = 0;
+
+  cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: poll [%lu] %s timeout=%d",
+         (unsigned long)es->es_poll_n,
+         pollfd_dump(es->es_poll, es->es_poll_n, buf, sizeof buf), millis);
+
+  n = poll(es->es_poll, es->es_poll_n, millis);
+  if (n < 0) err = errno;
+
+  cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: poll [%lu] results: %d %s%s%s",
+         (unsigned long)es->es_poll_n, n,
+         pollfd_dump_results(es->es_poll, es->es_poll_n, buf, sizeof buf),
+         n < 0 ? ": " : "", n < 0 ? strerror(err) : "");
+
+  if (n <= 0) {
+    errno = err;
+    return n;
+  }
+  for (i = 0; i < es->es_poll_n; i++)
+    if (es->es_poll[i].revents != 0) es_backend_ready(es, es->es_poll[i].fd);
+
+  return n;
+}
+
+es_backend const es_backend_poll = {"poll", poll_start, poll_stop, NULL,
+                                    NULL,   poll_wait};
@@ -0,0 +1,262 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libes/esp.h"
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+/*  Backends, in order of preference for "auto".
+ */
+static es_backend const *const es_backends[] = {
+#if ES_HAVE_EPOLL
+    &es_backend_epoll,
+#endif
+    &es_backend_poll,
+#if ES_HAVE_IO_URING
+    &es_backend_io_uring,
+#endif
+    NULL};
+
+/*  Append <fd> to a growing list of file descriptors.
+ */
+int es_fd_list_add(es_handle *es, int **list, size_t *n, size_t *m, int fd) {
+  if (*n >= *m) {
+    int *tmp = cm_trealloc(es->es_cm, int, *list, *m + 1024);
+    if (tmp == NULL) return ENOMEM;
+
+    *list = tmp;
+    *m += 1024;
+  }
+  (*list)[(*n)++] = fd;
+  return 0;
+}
+
+static int es_backend_fd_grow(es_handle *es, int fd) {
+  es_backend_fd *tmp;
+
+  if (fd < es->es_backend_fd_m) return 0;
+
+  tmp = cm_trealloc(es->es_cm, es_backend_fd, es->es_backend_fd, fd + 1024);
+  if (tmp == NULL) return ENOMEM;
+
+  memset(tmp + es->es_backend_fd_m, 0,
+         (fd + 1024 - es->es_backend_fd_m) * sizeof(*tmp));
+  es->es_backend_fd = tmp;
+  es->es_backend_fd_m = fd + 1024;
+
+  return 0;
+}
+
+/*  Is the backend running in this process?  If we're the child
+ *  of a fork(), let go of the parent's kernel state.
+ */
+static bool es_backend_running(es_handle *es) {
+  if (es->es_backend_pid == 0) return false;
+  if (es->es_backend_pid == getpid()) return true;
+
+  cl_log(es->es_cl, CL_LEVEL_DEBUG,
+         "es: restarting %s backend after a fork", es->es_backend->eb_name);
+  (*es->es_backend->eb_stop)(es, true);
+  es->es_backend_pid = 0;
+
+  return false;
+}
+
+/**
+ * @brief Choose how to wait for events.
+ *
+ *  "poll" uses poll(2) (or select(2), on some systems); "epoll"
+ *  and "io_uring" keep the interest list in the kernel, so that
+ *  waiting costs time in proportion to the number of active,
+ *  not of connected, file descriptors.  "auto" (or NULL) picks
+ *  the best one available.
+ *
+ *  If the chosen backend can't start, es_loop() falls back
+ *  to poll.
+ *
+ * @param es opaque module handle, created with es_create()
+ * @param name name of the backend
+ *
+ * @return 0 on success
+ * @return ENOENT if there is no backend by that name.
+ */
+int es_set_backend(es_handle *es, char const *name) {
+  es_backend const *const *eb;
+
+  if (name == NULL || strcasecmp(name, "auto") == 0)
+    eb = es_backends;
+  else {
+    for (eb = es_backends; *eb != NULL; eb++)
+      if (strcasecmp((*eb)->eb_name, name) == 0) break;
+    if (*eb == NULL) {
+      cl_log(es->es_cl, CL_LEVEL_OPERATOR_ERROR,
+             "es: unknown or unsupported event loop \"%s\"", name);
+      return ENOENT;
+    }
+  }
+  if (*eb == es->es_backend) return 0;
+
+  if (es_backend_running(es)) {
+    (*es->es_backend->eb_stop)(es, false);
+    es->es_backend_pid = 0;
+  }
+  es->es_backend = *eb;
+
+  return 0;
+}
+
+/**
+ * @brief Name of the backend that waits for events.
+ *
+ * @param es opaque module handle, created with es_create()
+ */
+char const *es_backend_name(es_handle const *es) {
+  return es->es_backend == NULL ? "poll" : es->es_backend->eb_name;
+}
+
+/*  The interest in <fd> changed; tell a running mirroring backend.
+ */
+void es_backend_changed(es_handle *es, int fd) {
+  if (es->es_backend_pid == 0 || es->es_backend->eb_sync == NULL) return;
+
+  if (es_backend_fd_grow(es, fd) != 0) {
+    es->es_resync = true;
+    return;
+  }
+  if (es->es_backend_fd[fd].ebf_changed) return;
+
+  if (es_fd_list_add(es, &es->es_changed, &es->es_changed_n,
+                     &es->es_changed_m, fd) != 0) {
+    es->es_resync = true;
+    return;
+  }
+  es->es_backend_fd[fd].ebf_changed = true;
+}
+
+/*  <fd> is being closed.
+ */
+void es_backend_close(es_handle *es, int fd) {
+  if (es->es_backend_pid == 0 || es->es_backend->eb_sync == NULL) return;
+
+  if (es->es_backend_pid == getpid() && fd < es->es_backend_fd_m)
+    (*es->es_backend->eb_close)(es, fd);
+  es_backend_changed(es, fd);
+}
+
+/*  Report events on <fd>.  If we can't remember that, the
+ *  event will come back the next time around.
+ */
+void es_backend_ready(es_handle *es, int fd) {
+  (void)es_fd_list_add(es, &es->es_ready, &es->es_ready_n, &es->es_ready_m,
+                       fd);
+}
+
+/*  The descriptor for <fd>, if there is one.
+ */
+es_descriptor *es_backend_descriptor(es_handle const *es, int fd) {
+  return fd >= 0 && fd < es->es_desc_m ? es->es_desc[fd] : NULL;
+}
+
+/*  Bring the backend's interest list up to date.
+ */
+static void es_backend_sync(es_handle *es) {
+  size_t i;
+
+  if (es->es_resync) {
+    /*  Look at everything we have, or had.
+     */
+    if (es->es_desc_m > 0 && es_backend_fd_grow(es, es->es_desc_m - 1) != 0)
+      return;
+
+    es->es_resync = false;
+    for (i = 0; i < es->es_backend_fd_m; i++)
+      if (es_backend_descriptor(es, i) != NULL ||
+          es->es_backend_fd[i].ebf_added)
+        (void)(*es->es_backend->eb_sync)(es, (int)i);
+  }
+
+  for (i = 0; i < es->es_changed_n; i++) {
+    int fd = es->es_changed[i];
+
+    es->es_backend_fd[fd].ebf_changed = false;
+    (void)(*es->es_backend->eb_sync)(es, fd);
+  }
+  es->es_changed_n = 0;
+}
+
+/*  Wait for events, starting the backend if needed.
+ */
+int es_backend_wait(es_handle *es, int millis) {
+  if (es->es_backend == NULL) es->es_backend = es_backends[0];
+
+  if (!es_backend_running(es)) {
+    int err;
+
+    es->es_changed_n = 0;
+    es->es_resync = false;
+    if (es->es_backend_fd_m > 0)
+      memset(es->es_backend_fd, 0,
+             es->es_backend_fd_m * sizeof(*es->es_backend_fd));
+
+    err = (*es->es_backend->eb_start)(es);
+    if (err != 0) {
+      cl_log_errno(es->es_cl, CL_LEVEL_ERROR, es->es_backend->eb_name, err,
+                   "es: can't start %s backend; falling back to poll",
+                   es->es_backend->eb_name);
+      es->es_backend = &es_backend_poll;
+      (void)(*es->es_backend->eb_start)(es);
+    } else
+      cl_log(es->es_cl, CL_LEVEL_DEBUG, "es: using %s backend",
+             es->es_backend->eb_name);
+    es->es_backend_pid = getpid();
+
+    /*  Tell the new backend about everything.
+     */
+    es->es_resync = true;
+  }
+  if (es->es_backend->eb_sync != NULL) es_backend_sync(es);
+  es->es_ready_n = 0;
+
+  return (*es->es_backend->eb_wait)(es, millis);
+}
+
+/*  Release the backend and its tables.
+ */
+void es_backend_stop(es_handle *es) {
+  if (es_backend_running(es)) {
+    (*es->es_backend->eb_stop)(es, false);
+    es->es_backend_pid = 0;
+  }
+  if (es->es_backend_fd != NULL) {
+    cm_free(es->es_cm, es->es_backend_fd);
+    es->es_backend_fd = NULL;
+    es->es_backend_fd_m = 0;
+  }
+  if (es->es_changed != NULL) {
+    cm_free(es->es_cm, es->es_changed);
+    es->es_changed = NULL;
+    es->es_changed_n = es->es_changed_m = 0;
+  }
+  if (es->es_ready != NULL) {
+    cm_free(es->es_cm, es->es_ready);
+    es->es_ready = NULL;
+    es->es_ready_n = es->es_ready_m = 0;
+  }
+  if (es->es_app != NULL) {
+    cm_free(es->es_cm, es->es_app);
+    es->es_app = NULL;
+    es->es_app_n = es->es_app_m = 0;
+  }
+}
@@ -47,6 +47,7 @@ void es_close(es_handle *es, es_descriptor *ed) {
     cl_assert(es->es_cl, es->es_desc[pfd->fd] != NULL);
     es->es_desc[pfd->fd] = NULL;
     es->es_desc_n--;
+    es_backend_close(es, pfd->fd);
 
     /*  During the event processing loop, closed pollfd
      *  structs are not overwritten, only marked as free.
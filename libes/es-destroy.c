@@ -79,6 +79,8 @@ void es_destroy(es_handle *es) {
   }
   while (es->es_null_n > 0) es_close(es, es->es_null[0]);
 
+  es_backend_stop(es);
+
   if (es->es_null != NULL) {
     cm_free(es->es_cm, es->es_null);
     es->es_null = NULL;
@@ -18,106 +18,6 @@ limitations under the License.
 #include <stdio.h>
 #include <string.h>
 
-#if ES_EMULATE_POLL_WITH_SELECT
-
-/*  In Tiger (MacOS 10.4), a previously emulated poll was moved
- *  into the kernel ... breaking it for, oh, named pipes and terminal I/O.
- *  See: http://marc.theaimsgroup.com/?l=log&m=111515776629581&w=2
- */
-#include <sys/types.h>
-#include <sys/select.h>
-
-int es_emulate_poll(struct pollfd *pfd, int n_pfd, int millis) {
-  fd_set rfds, wfds;
-  int i, max_fd = -1, total;
-  struct timeval tv, *tvp = NULL;
-
-  FD_ZERO(&rfds);
-  FD_ZERO(&wfds);
-
-  for (i = 0; i < n_pfd; i++) {
-    if (pfd[i].events & POLLIN) FD_SET(pfd[i].fd, &rfds);
-    if (pfd[i].events & POLLOUT) FD_SET(pfd[i].fd, &wfds);
-    if (pfd[i].fd > max_fd) max_fd = pfd[i].fd;
-  }
-  if (millis >= 0) {
-    tvp = &tv;
-    tv.tv_sec = millis / 1000;
-    tv.tv_usec = 1000 * (millis % 1000);
-  }
-
-  i = select(max_fd + 1, &rfds, &wfds, NULL, tvp);
-  if (i < 0) return i;
-
-  for (i = 0, total = 0; i < n_pfd; i++) {
-    pfd[i].revents = 0;
-
-    if (FD_ISSET(pfd[i].fd, &rfds)) pfd[i].revents |= POLLIN;
-    if (FD_ISSET(pfd[i].fd, &wfds)) pfd[i].revents |= POLLOUT;
-
-    if (pfd[i].revents != 0) total++;
-  }
-  return total;
-}
-
-#endif /* ES_EMULATE_POLL_WITH_SELECT */
-
-static char const *pollfd_dump_results(struct pollfd *pfd, int n, char *buf,
-                                       size_t size) {
-  char *w = buf, *e = buf + size;
-  int i;
-
-  if (n <= 0) return "{}";
-  if (size <= 2) return "{...}";
-
-  *w++ = '{';
-  *w = '\0';
-
-  for (i = 0; i < n && e - w >= 10; i++) {
-    if (pfd[i].revents != 0) {
-      snprintf(w, (size_t)(e - w), " %d%s%s%s%s", pfd[i].fd,
-               pfd[i].revents & POLLIN ? "r" : "",
-               pfd[i].revents & POLLOUT ? "w" : "",
-               pfd[i].revents & POLLERR ? "e" : "",
-               pfd[i].revents & POLLNVAL ? "n" : "");
-      w += strlen(w);
-    }
-  }
-
-  if (i < n && e - w >= 5)
-    memcpy(w, "...}", 5);
-  else if (e - w >= 3)
-    memcpy(w, " }", 3);
-
-  return buf;
-}
-
-static char const *pollfd_dump(struct pollfd *pfd, int n, char *buf,
-                               size_t size) {
-  char *w = buf, *e = buf + size;
-  int i;
-
-  if (n == 0) return "{}";
-  if (size <= 2) return "{...}";
-
-  *w++ = '{';
-  *w = '\0';
-
-  for (i = 0; i < n && e - w >= 10; i++) {
-    snprintf(w, (size_t)(e - w), " %d%s%s", pfd[i].fd,
-             pfd[i].events & POLLIN ? "r" : "",
-             pfd[i].events & POLLOUT ? "w" : "");
-    w += strlen(w);
-  }
-
-  if (i < n && e - w >= 5)
-    memcpy(w, "...}", 5);
-  else if (e - w >= 3)
-    memcpy(w, " }", 3);
-
-  return buf;
-}
-
 /**
  * @brief Dispatch events to descriptors.
  *
@@ -148,10 +48,8 @@ int es_loop(es_handle *es) {
     int millis;
     time_t next_timeout;
     es_descriptor *ed;
-    char buf[200];
     int err = 0;
-    int i = 0;
-    size_t end_i;
+    size_t i, ready_n, app_n;
 
     time(&es->es_now);
 
@@ -246,32 +144,17 @@ int es_loop(es_handle *es) {
 
     /*  Get events from the operating system.
      */
-    cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: poll [%lu] %s timeout=%d",
-           (unsigned long)es->es_poll_n,
-           pollfd_dump(es->es_poll, es->es_poll_n, buf, sizeof buf),
-           (es->es_idle_callback_head != NULL || es->es_application_event_n > 0)
-               ? 0
-               : millis);
-
-    n_poll_events =
-        poll(es->es_poll, es->es_poll_n,
-             es->es_idle_callback_head != NULL || es->es_application_event_n > 0
-                 ? 0
-                 : millis);
-    if (n_poll_events < 0) err = errno;
-
-    cl_log(es->es_cl, CL_LEVEL_VERBOSE, "es: poll [%lu] results: %d %s%s%s",
-           (unsigned long)es->es_poll_n, n_poll_events,
-           pollfd_dump_results(es->es_poll, es->es_poll_n, buf, sizeof buf),
-           n_poll_events < 0 ? ": " : "",
-           n_poll_events < 0 ? strerror(err) : "");
-
+    n_poll_events = es_backend_wait(
+        es, es->es_idle_callback_head != NULL || es->es_application_event_n > 0
+                ? 0
+                : millis);
     if (n_poll_events < 0) {
       size_t i;
 
+      err = errno;
       if (err == EINTR) continue;
 
-      cl_log_errno(es->es_cl, CL_LEVEL_ERROR, "poll", err,
+      cl_log_errno(es->es_cl, CL_LEVEL_ERROR, es_backend_name(es), err,
                    "es_loop: catastrophic poll failure");
 
       /*  Pass an error event to all descriptors,
@@ -308,33 +191,33 @@ int es_loop(es_handle *es) {
       cl_cover(es->es_cl);
     }
 
-    end_i = es->es_poll_n;
-
-    while (i < end_i && i < es->es_poll_n &&
-           n_poll_events + es->es_application_event_n > 0 &&
-           !es->es_destroyed) {
-      struct pollfd const *const pfd = es->es_poll + i++;
+    /*  Visit the file descriptors the backend reported, then
+     *  those with application events that were pending when
+     *  we started.  (Application events that come up while
+     *  we're dispatching wait for the next round.)
+     */
+    ready_n = es->es_ready_n;
+    app_n = es->es_app_n;
 
-      if (pfd->fd < 0 || es->es_desc[pfd->fd] == NULL ||
-          (!pfd->revents && !es->es_desc[pfd->fd]->ed_application_event))
+    for (i = 0; i < ready_n + app_n && !es->es_destroyed; i++) {
+      struct pollfd *pfd;
+      unsigned int ev;
+      int fd = i < ready_n ? es->es_ready[i] : es->es_app[i - ready_n];
 
+      if (fd < 0 || fd >= es->es_desc_m || (ed = es->es_desc[fd]) == NULL)
         continue;
 
-      cl_assert(es->es_cl, pfd->fd >= 0);
-      cl_assert(es->es_cl, pfd->fd < es->es_desc_m);
+      pfd = es->es_poll + ed->ed_poll;
+      if (!pfd->revents && !ed->ed_application_event) continue;
 
-      ed = es->es_desc[pfd->fd];
-      cl_assert(es->es_cl, ed != NULL);
-
-      /*  Decrement the network event counter,
-       *  if there were network events.
+      /*  Each event is delivered once, even if the descriptor
+       *  is on both lists.
        */
-      if (pfd->revents) n_poll_events--;
+      ev = pfd->revents;
+      pfd->revents = 0;
 
       if (pfd->events || ed->ed_application_event ||
-          (~(POLLIN | POLLOUT) & pfd->revents)) {
-        unsigned int ev = pfd->revents;
-
+          (~(POLLIN | POLLOUT) & ev)) {
         if (ed->ed_application_event) {
           /* Decrement es->es_application_event_n,
            * if there was an application event.
@@ -356,18 +239,26 @@ int es_loop(es_handle *es) {
          *  closing the socket.
          *
          */
-        if (pfd->revents & (POLLERR | POLLHUP)) {
-          if (pfd->revents & POLLERR)
-            cl_log(es->es_cl, CL_LEVEL_FAIL, "POLLERR on %d", pfd->fd);
+        if (ev & (POLLERR | POLLHUP)) {
+          if (ev & POLLERR)
+            cl_log(es->es_cl, CL_LEVEL_FAIL, "POLLERR on %d", fd);
 
           if (pfd->events & POLLIN) ev |= ES_INPUT;
           if (pfd->events & POLLOUT) ev |= ES_OUTPUT;
         }
         ed->ed_activity = es->es_now;
-        (*ed->ed_callback)(ed, pfd->fd, ev);
+        (*ed->ed_callback)(ed, fd, ev);
       }
     }
 
+    /*  Drop the application events we've visited.
+     */
+    if (!es->es_destroyed && app_n > 0) {
+      memmove(es->es_app, es->es_app + app_n,
+              (es->es_app_n - app_n) * sizeof(*es->es_app));
+      es->es_app_n -= app_n;
+    }
+
     /* Time-out idle events that have been pending for
      * too long without the system actually *being* idle.
      */
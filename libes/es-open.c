@@ -107,6 +107,7 @@ int es_open(es_handle *es, int fd, unsigned int events, es_descriptor *ed) {
   pfd->fd = fd;
   pfd->events = events;
   pfd->revents = 0;
+  es_backend_changed(es, fd);
 
   /* Initialize the timeout management structure as empty. */
   ed->ed_timeout = NULL;
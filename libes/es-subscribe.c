@@ -30,7 +30,10 @@ void es_subscribe_loc(es_handle *es, es_descriptor *ed, unsigned int events,
                : (events == ES_INPUT ? "input" : "output"),
            file, line);
 
-  es->es_poll[ed->ed_poll].events |= events;
+  if ((es->es_poll[ed->ed_poll].events & events) != events) {
+    es->es_poll[ed->ed_poll].events |= events;
+    es_backend_changed(es, es->es_poll[ed->ed_poll].fd);
+  }
 
   cl_cover(es->es_cl);
 }
@@ -33,7 +33,8 @@ void es_unsubscribe_loc(es_handle *es, es_descriptor *ed, unsigned int events,
                ? "input-output"
                : (events == ES_INPUT ? "input" : "output"),
            file, line);
+    es->es_poll[ed->ed_poll].events &= ~events;
+    es_backend_changed(es, es->es_poll[ed->ed_poll].fd);
     cl_cover(es->es_cl);
   }
-  es->es_poll[ed->ed_poll].events &= ~events;
 }
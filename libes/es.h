@@ -341,6 +341,11 @@ void es_demon(es_handle *, es_descriptor *, bool);
 void es_set_pre_dispatch(es_handle *, es_iteration_callback *, void *);
 void es_set_post_dispatch(es_handle *, es_iteration_callback *, void *);
 
+/* es-backend.c */
+
+int es_set_backend(es_handle *_es, char const *_name);
+char const *es_backend_name(es_handle const *_es);
+
 /* es-idle.c */
 
 void es_idle_callback_cancel(es_handle *, es_idle_callback *);
@@ -0,0 +1,219 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libes/esp.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+
+/*  esbench -- microbenchmark for the es_loop() backends.
+ *
+ *  Opens N idle pipes, subscribed for input, and one socket
+ *  that's always readable: its callback reads a byte and
+ *  writes one back.  Reports the time per loop iteration,
+ *  for each backend and each N; with poll, that grows with
+ *  N, with epoll and io_uring, it shouldn't.
+ */
+
+#define PROCNAME "esbench"
+
+typedef struct bench_conn {
+  es_descriptor bc_ed;
+  int bc_fd;
+  int bc_peer;
+  unsigned long bc_rounds;
+  unsigned long bc_max;
+  es_handle *bc_es;
+} bench_conn;
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: %s [-b backend] [-n max-idle] [-r rounds]\n"
+          "  (backends: poll, epoll, io_uring; default: all of them)\n",
+          PROCNAME);
+  exit(EX_USAGE);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void idle_callback(es_descriptor *ed, int fd, unsigned int events) {}
+
+static void active_callback(es_descriptor *ed, int fd, unsigned int events) {
+  bench_conn *bc = (bench_conn *)ed;
+  char c;
+
+  if (!(events & ES_INPUT)) return;
+
+  if (read(bc->bc_fd, &c, 1) != 1 || write(bc->bc_peer, &c, 1) != 1) {
+    fprintf(stderr, "%s: ping-pong failed: %s\n", PROCNAME, strerror(errno));
+    exit(EX_OSERR);
+  }
+  if (++bc->bc_rounds >= bc->bc_max) es_break(bc->bc_es);
+}
+
+/*  Time one backend with <n> idle descriptors; returns
+ *  microseconds per iteration, or a negative number on error.
+ */
+static double bench(cm_handle *cm, cl_handle *cl, char const *backend,
+                    size_t n, unsigned long rounds) {
+  es_handle *es;
+  es_descriptor *idle;
+  int *idle_fd;
+  bench_conn bc;
+  int sv[2];
+  double t0, t;
+  size_t i;
+
+  if ((es = es_create(cm, cl)) == NULL) return -1;
+  if (es_set_backend(es, backend) != 0) {
+    es_destroy(es);
+    return -1;
+  }
+
+  idle = calloc(n + 1, sizeof(*idle));
+  idle_fd = calloc(2 * (n + 1), sizeof(*idle_fd));
+  if (idle == NULL || idle_fd == NULL) {
+    fprintf(stderr, "%s: out of memory\n", PROCNAME);
+    exit(EX_OSERR);
+  }
+
+  for (i = 0; i < n; i++) {
+    if (pipe(idle_fd + 2 * i) != 0) {
+      fprintf(stderr, "%s: pipe: %s (raise the file descriptor limit?)\n",
+              PROCNAME, strerror(errno));
+      exit(EX_OSERR);
+    }
+    idle[i].ed_callback = idle_callback;
+    idle[i].ed_displayname = "idle";
+    if (es_open(es, idle_fd[2 * i], ES_INPUT, idle + i) != 0) {
+      fprintf(stderr, "%s: es_open failed\n", PROCNAME);
+      exit(EX_SOFTWARE);
+    }
+  }
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+    fprintf(stderr, "%s: socketpair: %s\n", PROCNAME, strerror(errno));
+    exit(EX_OSERR);
+  }
+  memset(&bc, 0, sizeof bc);
+  bc.bc_ed.ed_callback = active_callback;
+  bc.bc_ed.ed_displayname = "active";
+  bc.bc_fd = sv[0];
+  bc.bc_peer = sv[1];
+  bc.bc_es = es;
+  if (es_open(es, sv[0], ES_INPUT, &bc.bc_ed) != 0) {
+    fprintf(stderr, "%s: es_open failed\n", PROCNAME);
+    exit(EX_SOFTWARE);
+  }
+
+  /*  Warm up -- start the backend and tell it about everything.
+   */
+  bc.bc_max = 10;
+  (void)write(bc.bc_peer, "x", 1);
+  (void)es_loop(es);
+
+  bc.bc_rounds = 0;
+  bc.bc_max = rounds;
+  t0 = now();
+  (void)es_loop(es);
+  t = now() - t0;
+
+  es_close(es, &bc.bc_ed);
+  close(sv[0]);
+  close(sv[1]);
+  for (i = 0; i < n; i++) {
+    es_close(es, idle + i);
+    close(idle_fd[2 * i]);
+    close(idle_fd[2 * i + 1]);
+  }
+  es_destroy(es);
+  free(idle);
+  free(idle_fd);
+
+  return bc.bc_rounds ? t * 1e6 / bc.bc_rounds : -1;
+}
+
+int main(int argc, char **argv) {
+  static char const *const backends[] = {"poll", "epoll", "io_uring", NULL};
+  char const *const *b;
+  char const *only = NULL;
+  unsigned long rounds = 20000;
+  size_t max_n = 10000, n;
+  struct rlimit rl;
+  cm_handle *cm;
+  cl_handle *cl;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:n:r:")) != EOF) switch (opt) {
+      case 'b':
+        only = optarg;
+        break;
+      case 'n':
+        max_n = strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        rounds = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage();
+    }
+  if (optind != argc || rounds == 0) usage();
+
+  /*  Two file descriptors per idle pipe.
+   */
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 2 * max_n + 64) {
+    rl.rlim_cur = 2 * max_n + 64;
+    if (rl.rlim_max != RLIM_INFINITY && rl.rlim_cur > rl.rlim_max)
+      rl.rlim_cur = rl.rlim_max;
+    (void)setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+      rl.rlim_cur < 2 * max_n + 64) {
+    while (max_n > 0 && rl.rlim_cur < 2 * max_n + 64) max_n /= 10;
+    fprintf(stderr, "%s: file descriptor limit %lu; stopping at %zu\n",
+            PROCNAME, (unsigned long)rl.rlim_cur, max_n);
+  }
+
+  cm = cm_c();
+  cl = cl_create();
+  cl_set_loglevel_full(cl, CL_LEVEL_ERROR);
+
+  printf("%-10s %8s %12s\n", "backend", "idle", "usec/iter");
+  for (b = backends; *b != NULL; b++) {
+    if (only != NULL && strcmp(only, *b) != 0) continue;
+
+    for (n = 10; n <= max_n; n *= 10) {
+      double us = bench(cm, cl, *b, n, rounds);
+
+      if (us < 0)
+        printf("%-10s %8zu %12s\n", *b, n, "n/a");
+      else
+        printf("%-10s %8zu %12.3f\n", *b, n, us);
+      fflush(stdout);
+    }
+  }
+  cl_destroy(cl);
+
+  return 0;
+}
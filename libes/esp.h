@@ -16,10 +16,21 @@ limitations under the License.
 #include "libes/es.h"
 
 #include <stdlib.h>
+#include <sys/types.h>
 
 #include "libcm/cm.h"
 #include "libcl/cl.h"
 
+#if defined(__linux__) && !defined(ES_HAVE_EPOLL)
+#define ES_HAVE_EPOLL 1
+#endif
+
+#if defined(__linux__) && !defined(ES_HAVE_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ES_HAVE_IO_URING 1
+#endif
+#endif
+
 struct es_timeout {
   unsigned long et_seconds;
 
@@ -31,6 +42,70 @@ struct es_timeout {
   struct es_timeout *et_next;
 };
 
+/*  A way of waiting for events (es-backend-*.c).
+ *
+ *  es_poll[] and es_desc[] stay the authoritative record of who
+ *  is interested in what.  Backends that keep an interest list
+ *  in the kernel catch up with the file descriptors on
+ *  es_changed[] each time before they wait.
+ */
+typedef struct es_backend {
+  char const *eb_name;
+
+  /*  Set up kernel state.
+   */
+  int (*eb_start)(es_handle *);
+
+  /*  Release kernel state.  If the state was inherited from
+   *  the parent of a fork(), just let go of it.
+   */
+  void (*eb_stop)(es_handle *, bool _forked);
+
+  /*  Tell the kernel what we're now interested in for a file
+   *  descriptor -- whatever es_desc[] and es_poll[] say.  NULL
+   *  for backends that don't keep an interest list.
+   */
+  int (*eb_sync)(es_handle *, int _fd);
+
+  /*  A file descriptor is being closed; forget about it
+   *  right away, before its number can be reused.
+   */
+  void (*eb_close)(es_handle *, int _fd);
+
+  /*  Wait up to <millis> milliseconds (-1: forever) for events;
+   *  set revents in es_poll[] and report the file descriptors
+   *  that have them with es_backend_ready().  Returns -1 and
+   *  sets errno on error.
+   */
+  int (*eb_wait)(es_handle *, int _millis);
+
+} es_backend;
+
+/*  What a mirroring backend last told the kernel about a file
+ *  descriptor.
+ */
+typedef struct es_backend_fd {
+  unsigned int ebf_events;
+
+  /*  io_uring: serial number of the outstanding poll request.
+   */
+  unsigned int ebf_serial;
+
+  /*  Registered with epoll; an io_uring poll is outstanding.
+   */
+  unsigned int ebf_added : 1;
+
+  /*  epoll: a regular file or other descriptor epoll refuses;
+   *  like poll(2), we treat it as always ready.
+   */
+  unsigned int ebf_always : 1;
+
+  /*  On the es_changed list.
+   */
+  unsigned int ebf_changed : 1;
+
+} es_backend_fd;
+
 struct es_handle {
   cm_handle *es_cm;
   cl_handle *es_cl;
@@ -92,12 +167,58 @@ struct es_handle {
   es_idle_callback *es_idle_callback_head;
   es_idle_callback **es_idle_callback_tail;
 
+  /*  The backend that waits for events, and the process that
+   *  started it (0 if it isn't running).
+   */
+  es_backend const *es_backend;
+  pid_t es_backend_pid;
+  void *es_backend_data;
+
+  /*  Indexed by file descriptor; see es_backend_fd above.
+   */
+  es_backend_fd *es_backend_fd;
+  size_t es_backend_fd_m;
+
+  /*  File descriptors whose interest changed since the backend
+   *  last caught up.  If we couldn't keep track, es_resync is
+   *  set, and the backend looks at all of them.
+   */
+  int *es_changed;
+  size_t es_changed_n;
+  size_t es_changed_m;
+  unsigned int es_resync : 1;
+
+  /*  File descriptors with events from the last wait, and
+   *  file descriptors with application events.
+   */
+  int *es_ready;
+  size_t es_ready_n;
+  size_t es_ready_m;
+
+  int *es_app;
+  size_t es_app_n;
+  size_t es_app_m;
+
   unsigned int es_looping : 1;
   unsigned int es_interrupted : 1;
   unsigned int es_destroyed : 1;
   unsigned int es_dispatching : 1;
 };
 
+/* es-backend.c */
+
+extern es_backend const es_backend_poll;
+extern es_backend const es_backend_epoll;
+extern es_backend const es_backend_io_uring;
+
+int es_backend_wait(es_handle *, int);
+es_descriptor *es_backend_descriptor(es_handle const *, int);
+void es_backend_changed(es_handle *, int);
+void es_backend_close(es_handle *, int);
+void es_backend_ready(es_handle *, int);
+void es_backend_stop(es_handle *);
+int es_fd_list_add(es_handle *, int **, size_t *, size_t *, int);
+
 /* es-application-event.c */
 
 void es_application_event_clear(es_handle *, es_descriptor *);
@@ -3491,6 +3491,36 @@ fail_ID:
   return notify_error(ctx, err, &tok, "invalid start of a replica reply");
 }
 
+/*
+ * SmpReply <-- `(' SmpCommand `)'
+ *
+ *  The state a follower reports back to the leader,
+ *  as in "ok (paused)" or "ok (running)".
+ */
+static int parse_smp_reply(gdp_context *ctx) {
+  gdp_ast_ops const *ast = &ctx->ctx_out->out_ops;
+  gdp_smpcmd_t *smpcmd;
+  unsigned long long *smppid;
+  gdp_token tok;
+  int err;
+
+  if ((err = lookahead(ctx, 1, &tok))) return err;
+  if (tok.tkn_kind != TOK_OPAR) return 0;
+  if ((err = next(ctx, NULL))) return err;
+
+  if ((err = match(ctx, TOK_ATOM, &tok))) goto fail_ATOM;
+  if ((err = ast->smpcmd_new(ctx->ctx_out, &smpcmd, &smppid))) return err;
+  if ((err = ast->smpcmd_set(ctx->ctx_out, smpcmd, &tok))) return err;
+
+  if ((err = match(ctx, TOK_CPAR, &tok))) goto fail_CPAR;
+  return 0;
+
+fail_ATOM:
+  return notify_error(ctx, err, &tok, "expected SMP state after '('");
+fail_CPAR:
+  return notify_error(ctx, err, &tok, "expected ')' after SMP state");
+}
+
 /*
  * Reply   <-- OK / ERROR stuff...
  */
@@ -3505,7 +3535,11 @@ static int parse_reply(gdp_context *ctx) {
       (ok = gdp_token_matches(&tok, "rok")) ||
       gdp_token_matches(&tok, "error")) {
     gdp_ast_ops const *ast = &ctx->ctx_out->out_ops;
-    return ast->request_new_response(ctx->ctx_out, ctx->ctx_modlist, ok);
+
+    err = ast->request_new_response(ctx->ctx_out, ctx->ctx_modlist, ok);
+    if (err == 0 && ok && ctx->ctx_cmd == GRAPHD_REQUEST_SMP_OUT)
+      err = parse_smp_reply(ctx);
+    return err;
   }
 
   return notify_error(ctx, GDP_ERR_SYNTAX, &tok, "no such reply");
@@ -0,0 +1,917 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+
+#include "libgraph/graphp.h"
+
+/*  A "roaring" idset.
+ *
+ *  Ids are grouped into 64k chunks by their high bits.  Each chunk
+ *  stores the low 16 bits of its members in whichever of three
+ *  containers is smallest for them:
+ *
+ *	array	-- sorted unsigned shorts, at most ROARING_ARRAY_MAX
+ *		   of them; two bytes per id.
+ *	bitmap	-- one bit per possible id; 8k, no matter how many
+ *		   are set.
+ *	run	-- sorted, disjoint [start..last] ranges; four bytes
+ *		   per run of consecutive ids.
+ *
+ *  Every chunk tracks both its count and its number of runs, so
+ *  we always know which container would be smallest.  We only
+ *  switch once the current container is half again as large as
+ *  the best one, to keep an unlucky insert pattern from flipping
+ *  a chunk back and forth.
+ *
+ *  Use of graph_idset_position:
+ *
+ *	gip_ull  -- the next id to look at.
+ *	gip_size -- the index of the first chunk that may contain
+ *		    that id (a hint; checked before use), or
+ *		    ROARING_POS_END if we're past the end of the set.
+ *
+ *  Since positions are ids rather than indices, they survive
+ *  inserts and container changes.
+ */
+
+#define ROARING_CHUNK_BITS 16
+#define ROARING_CHUNK_SIZE (1u << ROARING_CHUNK_BITS)
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_ARRAY_SMALL (sizeof(void *) / sizeof(unsigned short))
+#define ROARING_RUN_MAX (ROARING_CHUNK_SIZE / 2)
+#define ROARING_BITMAP_WORDS (ROARING_CHUNK_SIZE / 64)
+#define ROARING_BITMAP_SIZE (ROARING_BITMAP_WORDS * sizeof(unsigned long long))
+#define ROARING_POS_END ((size_t)-1)
+
+#define ROARING_KEY(id) ((id) >> ROARING_CHUNK_BITS)
+#define ROARING_LOW(id) ((unsigned int)((id) & (ROARING_CHUNK_SIZE - 1)))
+#define ROARING_ID(key, low) (((key) << ROARING_CHUNK_BITS) | (low))
+
+typedef enum chunk_kind { CHUNK_ARRAY, CHUNK_BITMAP, CHUNK_RUN } chunk_kind;
+
+typedef struct chunk_run {
+  unsigned short cr_start;
+  unsigned short cr_last;
+
+} chunk_run;
+
+typedef struct chunk {
+  /* The high bits shared by all ids in this chunk.
+   */
+  unsigned long long c_key;
+
+  chunk_kind c_kind;
+
+  /* Number of ids, and number of runs of consecutive ids.
+   * (For a run container, c_runs is also the number of
+   * chunk_runs in use.)
+   */
+  unsigned int c_n;
+  unsigned int c_runs;
+
+  /* Allocated slots in the array or run container.  An array
+   * with c_m == 0 keeps its (at most ROARING_ARRAY_SMALL) members
+   * in u_small, so a chunk with a lone id doesn't need a malloc.
+   */
+  unsigned int c_m;
+
+  union {
+    unsigned short u_small[ROARING_ARRAY_SMALL];
+    unsigned short *u_array;
+    unsigned long long *u_bitmap;
+    chunk_run *u_run;
+    void *u_data;
+  } c_u;
+
+} chunk;
+
+#define chunk_array(c) ((c)->c_m ? (c)->c_u.u_array : (c)->c_u.u_small)
+#define c_bitmap c_u.u_bitmap
+#define c_run c_u.u_run
+#define c_data c_u.u_data
+
+typedef struct graph_idset_roaring {
+  /* Generic part */
+
+  graph_idset_type const *idr_type;
+  graph_handle *idr_graph;
+  unsigned long long idr_n;
+  unsigned int idr_linkcount;
+
+  /* Specific part */
+
+  /* Sorted by c_key; no chunk is empty.
+   */
+  chunk *idr_chunk;
+  size_t idr_chunk_n;
+  size_t idr_chunk_m;
+
+} graph_idset_roaring;
+
+static const graph_idset_type graph_idset_roaring_type[1];
+
+/*  Bitmap utilities.
+ */
+static void bitmap_set_range(unsigned long long *w, unsigned int s,
+                             unsigned int last) {
+  unsigned int ws = s / 64, we = last / 64;
+  unsigned long long ms = ~0ull << (s % 64);
+  unsigned long long me = ~0ull >> (63 - last % 64);
+
+  if (ws == we) {
+    w[ws] |= ms & me;
+    return;
+  }
+  w[ws] |= ms;
+  for (ws++; ws < we; ws++) w[ws] = ~0ull;
+  w[we] |= me;
+}
+
+static void bitmap_stats(unsigned long long const *w, unsigned int *n_out,
+                         unsigned int *runs_out) {
+  unsigned long long carry = 0;
+  unsigned int n = 0, runs = 0, i;
+
+  for (i = 0; i < ROARING_BITMAP_WORDS; i++) {
+    /*  A run starts at every set bit whose
+     *  predecessor is clear.
+     */
+    n += __builtin_popcountll(w[i]);
+    runs += __builtin_popcountll(w[i] & ~((w[i] << 1) | carry));
+    carry = w[i] >> 63;
+  }
+  *n_out = n;
+  *runs_out = runs;
+}
+
+/*  First index i in a[0..n) with a[i] >= lo.
+ */
+static unsigned int array_lower_bound(unsigned short const *a, unsigned int n,
+                                      unsigned int lo) {
+  unsigned int s = 0, e = n;
+
+  while (s < e) {
+    unsigned int middle = s + (e - s) / 2;
+    if (a[middle] < lo)
+      s = middle + 1;
+    else
+      e = middle;
+  }
+  return s;
+}
+
+/*  First index i in r[0..n) with r[i].cr_last >= lo.
+ */
+static unsigned int run_lower_bound(chunk_run const *r, unsigned int n,
+                                    unsigned int lo) {
+  unsigned int s = 0, e = n;
+
+  while (s < e) {
+    unsigned int middle = s + (e - s) / 2;
+    if (r[middle].cr_last < lo)
+      s = middle + 1;
+    else
+      e = middle;
+  }
+  return s;
+}
+
+/*  Chunk operations.  <lo> is always the low 16 bits of an id.
+ */
+static bool chunk_contains(chunk const *c, unsigned int lo) {
+  unsigned int i;
+
+  switch (c->c_kind) {
+    case CHUNK_ARRAY:
+      i = array_lower_bound(chunk_array(c), c->c_n, lo);
+      return i < c->c_n && chunk_array(c)[i] == lo;
+
+    case CHUNK_BITMAP:
+      return (c->c_bitmap[lo / 64] >> (lo % 64)) & 1;
+
+    case CHUNK_RUN:
+      i = run_lower_bound(c->c_run, c->c_runs, lo);
+      return i < c->c_runs && c->c_run[i].cr_start <= lo;
+  }
+  return false;
+}
+
+/*  Smallest member >= lo.
+ */
+static bool chunk_next(chunk const *c, unsigned int lo, unsigned int *lo_out) {
+  unsigned long long w;
+  unsigned int i;
+
+  switch (c->c_kind) {
+    case CHUNK_ARRAY:
+      i = array_lower_bound(chunk_array(c), c->c_n, lo);
+      if (i >= c->c_n) return false;
+      *lo_out = chunk_array(c)[i];
+      return true;
+
+    case CHUNK_BITMAP:
+      i = lo / 64;
+      w = c->c_bitmap[i] & (~0ull << (lo % 64));
+      while (w == 0) {
+        if (++i >= ROARING_BITMAP_WORDS) return false;
+        w = c->c_bitmap[i];
+      }
+      *lo_out = i * 64 + __builtin_ctzll(w);
+      return true;
+
+    case CHUNK_RUN:
+      i = run_lower_bound(c->c_run, c->c_runs, lo);
+      if (i >= c->c_runs) return false;
+      *lo_out = c->c_run[i].cr_start > lo ? c->c_run[i].cr_start : lo;
+      return true;
+  }
+  return false;
+}
+
+/*  Largest member < lo.  (lo may be ROARING_CHUNK_SIZE.)
+ */
+static bool chunk_prev(chunk const *c, unsigned int lo, unsigned int *lo_out) {
+  unsigned long long w;
+  unsigned int i;
+
+  switch (c->c_kind) {
+    case CHUNK_ARRAY:
+      i = array_lower_bound(chunk_array(c), c->c_n, lo);
+      if (i == 0) return false;
+      *lo_out = chunk_array(c)[i - 1];
+      return true;
+
+    case CHUNK_BITMAP:
+      if (lo == 0) return false;
+      lo--;
+      i = lo / 64;
+      w = c->c_bitmap[i] & (~0ull >> (63 - lo % 64));
+      while (w == 0) {
+        if (i == 0) return false;
+        w = c->c_bitmap[--i];
+      }
+      *lo_out = i * 64 + 63 - __builtin_clzll(w);
+      return true;
+
+    case CHUNK_RUN:
+      i = run_lower_bound(c->c_run, c->c_runs, lo);
+      if (i < c->c_runs && c->c_run[i].cr_start < lo) {
+        *lo_out = lo - 1;
+        return true;
+      }
+      if (i == 0) return false;
+      *lo_out = c->c_run[i - 1].cr_last;
+      return true;
+  }
+  return false;
+}
+
+/*  How many members are < lo?  (lo may be ROARING_CHUNK_SIZE.)
+ */
+static unsigned int chunk_rank(chunk const *c, unsigned int lo) {
+  unsigned int i, n = 0;
+
+  switch (c->c_kind) {
+    case CHUNK_ARRAY:
+      return array_lower_bound(chunk_array(c), c->c_n, lo);
+
+    case CHUNK_BITMAP:
+      for (i = 0; i < lo / 64; i++) n += __builtin_popcountll(c->c_bitmap[i]);
+      if (lo % 64 != 0)
+        n += __builtin_popcountll(c->c_bitmap[i] &
+                                  ((1ull << (lo % 64)) - 1));
+      return n;
+
+    case CHUNK_RUN:
+      for (i = 0; i < c->c_runs && c->c_run[i].cr_start < lo; i++)
+        if (c->c_run[i].cr_last < lo)
+          n += c->c_run[i].cr_last - c->c_run[i].cr_start + 1;
+        else
+          n += lo - c->c_run[i].cr_start;
+      return n;
+  }
+  return 0;
+}
+
+static void chunk_to_bitmap(chunk const *c, unsigned long long *w) {
+  unsigned int i;
+
+  if (c->c_kind == CHUNK_BITMAP) {
+    memcpy(w, c->c_bitmap, ROARING_BITMAP_SIZE);
+    return;
+  }
+  memset(w, 0, ROARING_BITMAP_SIZE);
+  if (c->c_kind == CHUNK_ARRAY)
+    for (i = 0; i < c->c_n; i++)
+      w[chunk_array(c)[i] / 64] |= 1ull << (chunk_array(c)[i] % 64);
+  else
+    for (i = 0; i < c->c_runs; i++)
+      bitmap_set_range(w, c->c_run[i].cr_start, c->c_run[i].cr_last);
+}
+
+/*  How many bytes would a container of this kind need?
+ *  An array that's too large is impossible, not just big.
+ */
+static size_t chunk_kind_size(chunk_kind kind, unsigned int n,
+                              unsigned int runs) {
+  switch (kind) {
+    case CHUNK_ARRAY:
+      return n > ROARING_ARRAY_MAX ? (size_t)-1 : n * sizeof(unsigned short);
+    case CHUNK_BITMAP:
+      return ROARING_BITMAP_SIZE;
+    case CHUNK_RUN:
+      return runs * sizeof(chunk_run);
+  }
+  return (size_t)-1;
+}
+
+static chunk_kind chunk_kind_best(unsigned int n, unsigned int runs) {
+  chunk_kind best = CHUNK_ARRAY;
+
+  if (chunk_kind_size(CHUNK_BITMAP, n, runs) < chunk_kind_size(best, n, runs))
+    best = CHUNK_BITMAP;
+  if (chunk_kind_size(CHUNK_RUN, n, runs) < chunk_kind_size(best, n, runs))
+    best = CHUNK_RUN;
+  return best;
+}
+
+static void chunk_free(graph_handle *g, chunk *c) {
+  if (c->c_kind == CHUNK_BITMAP || c->c_m != 0)
+    cm_free(g->graph_cm, c->c_data);
+  c->c_data = NULL;
+  c->c_m = 0;
+}
+
+/*  Replace c's container with the best one for the
+ *  members in w[].  On error, c is unchanged.
+ */
+static int chunk_from_bitmap(graph_handle *g, chunk *c,
+                             unsigned long long const *w) {
+  unsigned short small[ROARING_ARRAY_SMALL];
+  unsigned int n, runs, m = 0, k = 0, i;
+  chunk_kind kind;
+  void *data;
+
+  bitmap_stats(w, &n, &runs);
+  kind = chunk_kind_best(n, runs);
+
+  if (kind == CHUNK_BITMAP)
+    data = cm_malloc(g->graph_cm, ROARING_BITMAP_SIZE);
+  else if (kind == CHUNK_RUN)
+    data = cm_malloc(g->graph_cm, (m = runs) * sizeof(chunk_run));
+  else if (n > ROARING_ARRAY_SMALL)
+    data = cm_malloc(g->graph_cm, (m = n) * sizeof(unsigned short));
+  else
+    data = small;
+  if (data == NULL) return errno ? errno : ENOMEM;
+
+  if (kind == CHUNK_BITMAP)
+    memcpy(data, w, ROARING_BITMAP_SIZE);
+  else
+    for (i = 0; i < ROARING_BITMAP_WORDS; i++) {
+      unsigned long long x;
+
+      for (x = w[i]; x != 0; x &= x - 1) {
+        unsigned int lo = i * 64 + __builtin_ctzll(x);
+
+        if (kind == CHUNK_ARRAY)
+          ((unsigned short *)data)[k++] = lo;
+        else {
+          chunk_run *r = data;
+
+          if (k > 0 && r[k - 1].cr_last + 1 == lo)
+            r[k - 1].cr_last = lo;
+          else {
+            r[k].cr_start = r[k].cr_last = lo;
+            k++;
+          }
+        }
+      }
+    }
+
+  chunk_free(g, c);
+  if (data == small)
+    memcpy(c->c_u.u_small, small, sizeof(small));
+  else
+    c->c_data = data;
+  c->c_kind = kind;
+  c->c_n = n;
+  c->c_runs = runs;
+  c->c_m = m;
+
+  return 0;
+}
+
+/*  If c's container has become much larger than it needs to be,
+ *  switch to a better one.  Failing to do that isn't an error; the
+ *  chunk is still correct, just bigger.
+ */
+static void chunk_optimize(graph_handle *g, chunk *c) {
+  unsigned long long w[ROARING_BITMAP_WORDS];
+  chunk_kind best = chunk_kind_best(c->c_n, c->c_runs);
+  size_t have, want;
+
+  if (best == c->c_kind) return;
+
+  have = chunk_kind_size(c->c_kind, c->c_n, c->c_runs);
+  want = chunk_kind_size(best, c->c_n, c->c_runs);
+  if (have != (size_t)-1 && 2 * have <= 3 * want) return;
+
+  chunk_to_bitmap(c, w);
+  (void)chunk_from_bitmap(g, c, w);
+}
+
+static int chunk_grow(graph_handle *g, chunk *c, size_t size,
+                      unsigned int max) {
+  unsigned int m = c->c_m ? 2 * c->c_m : 2 * ROARING_ARRAY_SMALL;
+  void *tmp;
+
+  if (m > max) m = max;
+
+  /*  Move a small array out of the chunk.
+   */
+  if (c->c_kind == CHUNK_ARRAY && c->c_m == 0) {
+    tmp = cm_malloc(g->graph_cm, m * size);
+    if (tmp == NULL) return errno ? errno : ENOMEM;
+    memcpy(tmp, c->c_u.u_small, c->c_n * size);
+  } else {
+    tmp = cm_realloc(g->graph_cm, c->c_data, m * size);
+    if (tmp == NULL) return errno ? errno : ENOMEM;
+  }
+
+  c->c_data = tmp;
+  c->c_m = m;
+
+  return 0;
+}
+
+static int chunk_insert(graph_handle *g, chunk *c, unsigned int lo,
+                        bool *added_out) {
+  bool left, right;
+  unsigned int i;
+  int err;
+
+  *added_out = false;
+  if (chunk_contains(c, lo)) return 0;
+
+  /*  A full array turns into something else.
+   */
+  if (c->c_kind == CHUNK_ARRAY && c->c_n >= ROARING_ARRAY_MAX) {
+    unsigned long long w[ROARING_BITMAP_WORDS];
+
+    chunk_to_bitmap(c, w);
+    w[lo / 64] |= 1ull << (lo % 64);
+
+    if ((err = chunk_from_bitmap(g, c, w)) != 0) return err;
+
+    *added_out = true;
+    return 0;
+  }
+
+  /*  Does lo extend or join existing runs?
+   */
+  left = lo > 0 && chunk_contains(c, lo - 1);
+  right = lo < ROARING_CHUNK_SIZE - 1 && chunk_contains(c, lo + 1);
+
+  switch (c->c_kind) {
+    case CHUNK_ARRAY:
+      if (c->c_n >= (c->c_m ? c->c_m : ROARING_ARRAY_SMALL) &&
+          (err = chunk_grow(g, c, sizeof(*chunk_array(c)), ROARING_ARRAY_MAX)) !=
+              0)
+        return err;
+
+      i = array_lower_bound(chunk_array(c), c->c_n, lo);
+      if (i < c->c_n)
+        memmove(chunk_array(c) + i + 1, chunk_array(c) + i,
+                (c->c_n - i) * sizeof(*chunk_array(c)));
+      chunk_array(c)[i] = lo;
+      break;
+
+    case CHUNK_BITMAP:
+      c->c_bitmap[lo / 64] |= 1ull << (lo % 64);
+      break;
+
+    case CHUNK_RUN:
+      i = run_lower_bound(c->c_run, c->c_runs, lo);
+      if (left && right) {
+        /*  Merge runs i - 1 and i.
+         */
+        c->c_run[i - 1].cr_last = c->c_run[i].cr_last;
+        memmove(c->c_run + i, c->c_run + i + 1,
+                (c->c_runs - (i + 1)) * sizeof(*c->c_run));
+      } else if (left)
+        c->c_run[i - 1].cr_last = lo;
+      else if (right)
+        c->c_run[i].cr_start = lo;
+      else {
+        if (c->c_runs >= c->c_m &&
+            (err = chunk_grow(g, c, sizeof(*c->c_run), ROARING_RUN_MAX)) != 0)
+          return err;
+        if (i < c->c_runs)
+          memmove(c->c_run + i + 1, c->c_run + i,
+                  (c->c_runs - i) * sizeof(*c->c_run));
+        c->c_run[i].cr_start = c->c_run[i].cr_last = lo;
+      }
+      break;
+  }
+
+  c->c_n++;
+  c->c_runs = c->c_runs + 1 - left - right;
+  *added_out = true;
+
+  chunk_optimize(g, c);
+  return 0;
+}
+
+static unsigned long long chunk_intersect_count(chunk const *a,
+                                                chunk const *b) {
+  unsigned long long wa[ROARING_BITMAP_WORDS], wb[ROARING_BITMAP_WORDS];
+  unsigned long long n = 0;
+  unsigned int i;
+
+  if (b->c_kind == CHUNK_ARRAY &&
+      (a->c_kind != CHUNK_ARRAY || b->c_n < a->c_n)) {
+    chunk const *tmp = a;
+    a = b;
+    b = tmp;
+  }
+  if (a->c_kind == CHUNK_ARRAY) {
+    for (i = 0; i < a->c_n; i++) n += chunk_contains(b, chunk_array(a)[i]);
+    return n;
+  }
+  if (a->c_kind == CHUNK_BITMAP && b->c_kind == CHUNK_BITMAP) {
+    for (i = 0; i < ROARING_BITMAP_WORDS; i++)
+      n += __builtin_popcountll(a->c_bitmap[i] & b->c_bitmap[i]);
+    return n;
+  }
+  chunk_to_bitmap(a, wa);
+  chunk_to_bitmap(b, wb);
+  for (i = 0; i < ROARING_BITMAP_WORDS; i++)
+    n += __builtin_popcountll(wa[i] & wb[i]);
+  return n;
+}
+
+/*  Chunk table.
+ */
+static size_t idr_chunk_lower_bound(graph_idset_roaring const *idr,
+                                    unsigned long long key) {
+  size_t s = 0, e = idr->idr_chunk_n;
+
+  while (s < e) {
+    size_t middle = s + (e - s) / 2;
+    if (idr->idr_chunk[middle].c_key < key)
+      s = middle + 1;
+    else
+      e = middle;
+  }
+  return s;
+}
+
+/*  Like idr_chunk_lower_bound, but try <hint> first.
+ */
+static size_t idr_chunk_hint(graph_idset_roaring const *idr,
+                             unsigned long long key, size_t hint) {
+  if (hint <= idr->idr_chunk_n &&
+      (hint == idr->idr_chunk_n || idr->idr_chunk[hint].c_key >= key) &&
+      (hint == 0 || idr->idr_chunk[hint - 1].c_key < key))
+    return hint;
+  return idr_chunk_lower_bound(idr, key);
+}
+
+/*  Make room for one more chunk at the end.
+ */
+static int idr_chunk_reserve(graph_idset_roaring *idr) {
+  chunk *tmp;
+
+  if (idr->idr_chunk_n < idr->idr_chunk_m) return 0;
+
+  tmp = cm_realloc(idr->idr_graph->graph_cm, idr->idr_chunk,
+                   (idr->idr_chunk_m + 16) * 2 * sizeof(*tmp));
+  if (tmp == NULL) return errno ? errno : ENOMEM;
+
+  idr->idr_chunk = tmp;
+  idr->idr_chunk_m = (idr->idr_chunk_m + 16) * 2;
+
+  return 0;
+}
+
+static void graph_idset_roaring_next_reset(graph_idset *gi,
+                                           graph_idset_position *pos) {
+  pos->gip_ull = 0;
+  pos->gip_size = 0;
+}
+
+static bool graph_idset_roaring_next(graph_idset *gi,
+                                     unsigned long long *id_out,
+                                     graph_idset_position *pos) {
+  graph_idset_roaring const *idr = (graph_idset_roaring const *)gi;
+  unsigned long long key;
+  unsigned int lo, lo_found;
+  size_t i;
+
+  if (pos->gip_size == ROARING_POS_END) return false;
+
+  key = ROARING_KEY(pos->gip_ull);
+  lo = ROARING_LOW(pos->gip_ull);
+
+  for (i = idr_chunk_hint(idr, key, pos->gip_size); i < idr->idr_chunk_n;
+       i++) {
+    chunk const *c = idr->idr_chunk + i;
+
+    if (c->c_key != key) lo = 0;
+    if (chunk_next(c, lo, &lo_found)) {
+      *id_out = ROARING_ID(c->c_key, lo_found);
+      if (*id_out == ULLONG_MAX)
+        pos->gip_size = ROARING_POS_END;
+      else {
+        pos->gip_ull = *id_out + 1;
+        pos->gip_size = i + (lo_found == ROARING_CHUNK_SIZE - 1);
+      }
+      return true;
+    }
+  }
+  pos->gip_size = i;
+  return false;
+}
+
+static void graph_idset_roaring_prev_reset(graph_idset *gi,
+                                           graph_idset_position *pos) {
+  pos->gip_ull = 0;
+  pos->gip_size = ROARING_POS_END;
+}
+
+static bool graph_idset_roaring_prev(graph_idset *gi,
+                                     unsigned long long *id_out,
+                                     graph_idset_position *pos) {
+  graph_idset_roaring const *idr = (graph_idset_roaring const *)gi;
+  unsigned int lo_found;
+  size_t i;
+
+  if (pos->gip_size == ROARING_POS_END)
+    i = idr->idr_chunk_n;
+  else {
+    unsigned long long key = ROARING_KEY(pos->gip_ull);
+
+    i = idr_chunk_hint(idr, key, pos->gip_size);
+    if (i < idr->idr_chunk_n && idr->idr_chunk[i].c_key == key &&
+        chunk_prev(idr->idr_chunk + i, ROARING_LOW(pos->gip_ull), &lo_found))
+      goto found;
+  }
+
+  /*  Chunks are never empty; the last id in the
+   *  previous chunk, if any, is the one.
+   */
+  if (i == 0) {
+    pos->gip_ull = 0;
+    pos->gip_size = 0;
+    return false;
+  }
+  i--;
+  chunk_prev(idr->idr_chunk + i, ROARING_CHUNK_SIZE, &lo_found);
+
+found:
+  *id_out = ROARING_ID(idr->idr_chunk[i].c_key, lo_found);
+  pos->gip_ull = *id_out;
+  pos->gip_size = i;
+
+  return true;
+}
+
+static bool graph_idset_roaring_check(graph_idset *gi, unsigned long long id) {
+  graph_idset_roaring const *idr = (graph_idset_roaring const *)gi;
+  size_t i = idr_chunk_lower_bound(idr, ROARING_KEY(id));
+
+  return i < idr->idr_chunk_n &&
+         idr->idr_chunk[i].c_key == ROARING_KEY(id) &&
+         chunk_contains(idr->idr_chunk + i, ROARING_LOW(id));
+}
+
+static bool graph_idset_roaring_locate(graph_idset *gi, unsigned long long id,
+                                       graph_idset_position *pos) {
+  graph_idset_roaring const *idr = (graph_idset_roaring const *)gi;
+
+  pos->gip_ull = id;
+  pos->gip_size = idr_chunk_lower_bound(idr, ROARING_KEY(id));
+
+  return pos->gip_size < idr->idr_chunk_n &&
+         idr->idr_chunk[pos->gip_size].c_key == ROARING_KEY(id) &&
+         chunk_contains(idr->idr_chunk + pos->gip_size, ROARING_LOW(id));
+}
+
+/*  How many members are < id?
+ */
+static unsigned long long idr_rank(graph_idset_roaring const *idr,
+                                   unsigned long long id) {
+  unsigned long long n = 0;
+  size_t i;
+
+  for (i = 0; i < idr->idr_chunk_n; i++) {
+    chunk const *c = idr->idr_chunk + i;
+
+    if (c->c_key >= ROARING_KEY(id)) {
+      if (c->c_key == ROARING_KEY(id)) n += chunk_rank(c, ROARING_LOW(id));
+      break;
+    }
+    n += c->c_n;
+  }
+  return n;
+}
+
+/*  return position(id) - pos, that is, how far forward
+ *  you'd have to go from pos to stand on top of id, if
+ *  it existed.
+ */
+static long long graph_idset_roaring_offset(graph_idset *gi,
+                                            graph_idset_position *pos,
+                                            unsigned long long id) {
+  graph_idset_roaring const *idr = (graph_idset_roaring const *)gi;
+  unsigned long long here;
+
+  here = pos->gip_size == ROARING_POS_END ? idr->idr_n
+                                          : idr_rank(idr, pos->gip_ull);
+  return (long long)idr_rank(idr, id) - (long long)here;
+}
+
+static int graph_idset_roaring_insert(graph_idset *gi, unsigned long long id) {
+  graph_idset_roaring *idr = (graph_idset_roaring *)gi;
+  graph_handle *g = idr->idr_graph;
+  unsigned long long key = ROARING_KEY(id);
+  bool added;
+  chunk *c;
+  size_t i;
+  int err;
+
+  i = idr_chunk_lower_bound(idr, key);
+  if (i >= idr->idr_chunk_n || idr->idr_chunk[i].c_key != key) {
+    if ((err = idr_chunk_reserve(idr)) != 0) {
+      cl_log(g->graph_cl, CL_LEVEL_FAIL,
+             "graph_idset_roaring_insert: "
+             "can't grow chunk table: %s",
+             strerror(err));
+      return err;
+    }
+    if (i < idr->idr_chunk_n)
+      memmove(idr->idr_chunk + i + 1, idr->idr_chunk + i,
+              (idr->idr_chunk_n - i) * sizeof(*idr->idr_chunk));
+    idr->idr_chunk_n++;
+
+    c = idr->idr_chunk + i;
+    memset(c, 0, sizeof(*c));
+    c->c_key = key;
+    c->c_kind = CHUNK_ARRAY;
+  }
+  c = idr->idr_chunk + i;
+
+  err = chunk_insert(g, c, ROARING_LOW(id), &added);
+  if (err != 0) {
+    cl_log(g->graph_cl, CL_LEVEL_FAIL,
+           "graph_idset_roaring_insert: "
+           "can't insert %llu: %s",
+           id, strerror(err));
+
+    /*  Don't leave an empty chunk behind.
+     */
+    if (c->c_n == 0) {
+      chunk_free(g, c);
+      memmove(idr->idr_chunk + i, idr->idr_chunk + i + 1,
+              (idr->idr_chunk_n - (i + 1)) * sizeof(*idr->idr_chunk));
+      idr->idr_chunk_n--;
+    }
+    return err;
+  }
+  if (added) idr->idr_n++;
+
+  return 0;
+}
+
+static void graph_idset_roaring_free(graph_idset *gi) {
+  graph_idset_roaring *idr = (graph_idset_roaring *)gi;
+
+  if (idr != NULL) {
+    size_t i;
+
+    if (idr->idr_chunk != NULL) {
+      for (i = 0; i < idr->idr_chunk_n; i++)
+        chunk_free(idr->idr_graph, idr->idr_chunk + i);
+      cm_free(idr->idr_graph->graph_cm, idr->idr_chunk);
+    }
+    cm_free(idr->idr_graph->graph_cm, idr);
+  }
+}
+
+static const graph_idset_type graph_idset_roaring_type[1] = {
+    {graph_idset_roaring_insert, graph_idset_roaring_check,
+     graph_idset_roaring_locate, graph_idset_roaring_next,
+     graph_idset_roaring_next_reset, graph_idset_roaring_prev,
+     graph_idset_roaring_prev_reset, graph_idset_roaring_offset,
+     graph_idset_roaring_free}};
+
+graph_idset *graph_idset_roaring_create(graph_handle *g) {
+  graph_idset_roaring *idr;
+
+  idr = cm_malloc(g->graph_cm, sizeof(*idr));
+  if (idr == NULL) return NULL;
+
+  idr->idr_linkcount = 1;
+  idr->idr_n = 0;
+  idr->idr_chunk_m = 0;
+  idr->idr_chunk_n = 0;
+  idr->idr_chunk = NULL;
+  idr->idr_type = graph_idset_roaring_type;
+  idr->idr_graph = g;
+
+  return (graph_idset *)idr;
+}
+
+/**
+ * @brief How many bytes does a roaring idset use?
+ *
+ *  Not counting allocator overhead.  For other
+ *  idset types, returns 0.
+ */
+size_t graph_idset_roaring_memory(graph_idset const *gi) {
+  graph_idset_roaring const *idr = (graph_idset_roaring const *)gi;
+  size_t i, total;
+
+  if (gi->gi_type != graph_idset_roaring_type) return 0;
+
+  total = sizeof(*idr) + idr->idr_chunk_m * sizeof(*idr->idr_chunk);
+  for (i = 0; i < idr->idr_chunk_n; i++) {
+    chunk const *c = idr->idr_chunk + i;
+
+    if (c->c_kind == CHUNK_BITMAP)
+      total += ROARING_BITMAP_SIZE;
+    else if (c->c_kind == CHUNK_ARRAY)
+      total += c->c_m * sizeof(*chunk_array(c));
+    else
+      total += c->c_m * sizeof(*c->c_run);
+  }
+  return total;
+}
+
+/*  Fallback for idsets that aren't both roaring: walk the
+ *  smaller set, and check its members against the larger.
+ */
+static unsigned long long idset_intersect_count_generic(graph_idset *small,
+                                                        graph_idset *large) {
+  graph_idset_position pos;
+  unsigned long long id, n = 0;
+
+  graph_idset_next_reset(small, &pos);
+  while (graph_idset_next(small, &id, &pos)) n += graph_idset_check(large, id);
+  return n;
+}
+
+/**
+ * @brief How many members do two idsets have in common?
+ *
+ *  If both sets are roaring idsets, this works a chunk at a
+ *  time; otherwise, it checks each member of the smaller set
+ *  against the larger one.
+ *
+ * @param a	one set
+ * @param b	the other set
+ * @return the number of ids in both a and b.
+ */
+unsigned long long graph_idset_intersect_count(graph_idset *a,
+                                               graph_idset *b) {
+  unsigned long long n = 0;
+
+  if (a->gi_type == graph_idset_roaring_type &&
+      b->gi_type == graph_idset_roaring_type) {
+    graph_idset_roaring const *ra = (graph_idset_roaring const *)a;
+    graph_idset_roaring const *rb = (graph_idset_roaring const *)b;
+    size_t i = 0, j = 0;
+
+    while (i < ra->idr_chunk_n && j < rb->idr_chunk_n) {
+      chunk const *ca = ra->idr_chunk + i, *cb = rb->idr_chunk + j;
+
+      if (ca->c_key < cb->c_key)
+        i++;
+      else if (ca->c_key > cb->c_key)
+        j++;
+      else {
+        n += chunk_intersect_count(ca, cb);
+        i++;
+        j++;
+      }
+    }
+  } else if (a->gi_n <= b->gi_n)
+    n = idset_intersect_count_generic(a, b);
+  else
+    n = idset_intersect_count_generic(b, a);
+
+  return n;
+}
@@ -0,0 +1,261 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "libgraph/graph.h"
+#include "libcm/cm.h"
+#include "libcl/cl.h"
+
+#define except_throw(e) goto e
+#define except_catch(e) \
+  while (0) e:
+
+#define TEST(expr)                          \
+  do {                                      \
+    if (!(expr)) {                          \
+      fprintf(stderr,                       \
+              "test \"%s\", line %d: test " \
+              "failed: %s\n",               \
+              __FILE__, __LINE__, #expr);   \
+      except_throw(err);                    \
+    }                                       \
+  } while (0)
+
+/*  The tests use ids out of four 64k chunks, starting at chunk 3.
+ */
+#define CHUNK (1ull << 16)
+#define BASE (3 * CHUNK)
+#define UNIVERSE (4 * CHUNK)
+
+static unsigned char shadow_a[UNIVERSE], shadow_b[UNIVERSE];
+
+static int set_insert(graph_idset *set, unsigned char *shadow,
+                      unsigned long long id) {
+  shadow[id - BASE] = 1;
+  return graph_idset_insert(set, id);
+}
+
+/*  Check <set> against <shadow> -- membership, iteration in
+ *  both directions, locate and offset.
+ */
+static int set_check(graph_idset *set, unsigned char const *shadow,
+                     char const *file, int line) {
+  graph_idset_position pos;
+  unsigned long long i, id, n = 0;
+
+  for (i = 0; i < UNIVERSE; i++) {
+    TEST(graph_idset_check(set, BASE + i) == shadow[i]);
+    n += shadow[i];
+  }
+  TEST(!graph_idset_check(set, BASE - 1));
+  TEST(!graph_idset_check(set, BASE + UNIVERSE));
+  TEST(set->gi_n == n);
+
+  graph_idset_next_reset(set, &pos);
+  for (i = 0; i < UNIVERSE; i++)
+    if (shadow[i]) {
+      TEST(graph_idset_next(set, &id, &pos));
+      TEST(id == BASE + i);
+    }
+  TEST(!graph_idset_next(set, &id, &pos));
+
+  graph_idset_prev_reset(set, &pos);
+  for (i = UNIVERSE; i-- > 0;)
+    if (shadow[i]) {
+      TEST(graph_idset_prev(set, &id, &pos));
+      TEST(id == BASE + i);
+    }
+  TEST(!graph_idset_prev(set, &id, &pos));
+
+  /*  Locate each chunk boundary, and its neighbors; the
+   *  next id from there is the first member at or after it,
+   *  and the offset to the end is the number of members
+   *  at or after it.
+   */
+  for (i = 1; i < UNIVERSE; i += CHUNK - 1) {
+    unsigned long long j, after = 0;
+
+    TEST(graph_idset_locate(set, BASE + i, &pos) == shadow[i]);
+    for (j = i; j < UNIVERSE; j++) after += shadow[j];
+    TEST(graph_idset_offset(set, &pos, BASE + UNIVERSE) == (long long)after);
+
+    for (j = i; j < UNIVERSE && !shadow[j]; j++)
+      ;
+    if (j < UNIVERSE) {
+      TEST(graph_idset_next(set, &id, &pos));
+      TEST(id == BASE + j);
+    } else
+      TEST(!graph_idset_next(set, &id, &pos));
+  }
+
+  except_catch(err) {
+    fprintf(stderr, "\t[from \"%s\", line %d]\n", file, line);
+    return 1;
+  }
+  return 0;
+}
+
+static unsigned long long shadow_intersect_count(void) {
+  unsigned long long i, n = 0;
+
+  for (i = 0; i < UNIVERSE; i++) n += shadow_a[i] & shadow_b[i];
+  return n;
+}
+
+/*  Fill one set with a mix of containers, check it as it
+ *  grows, and intersect it with a second set, roaring or tile.
+ */
+static int idset_roaring(graph_handle *graph, char const *file, int line) {
+  graph_idset *a = NULL, *b = NULL, *t = NULL;
+  unsigned long long i;
+  size_t mem;
+
+  memset(shadow_a, 0, sizeof shadow_a);
+  memset(shadow_b, 0, sizeof shadow_b);
+
+  a = graph_idset_roaring_create(graph);
+  TEST(a != NULL);
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+
+  /*  A handful of ids on either side of each chunk boundary:
+   *  small arrays in four chunks.
+   */
+  for (i = 1; i < 4; i++) {
+    TEST(!set_insert(a, shadow_a, BASE + i * CHUNK - 1));
+    TEST(!set_insert(a, shadow_a, BASE + i * CHUNK));
+  }
+  TEST(!set_insert(a, shadow_a, BASE));
+  TEST(!set_insert(a, shadow_a, BASE + UNIVERSE - 1));
+  TEST(!set_insert(a, shadow_a, BASE + UNIVERSE - 1));
+  TEST(a->gi_n == 8);
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+
+  /*  Chunk 0: every third id turns the array into a bitmap
+   *  once it has more than 4096 members.
+   */
+  for (i = 0; i < CHUNK; i += 3) TEST(!set_insert(a, shadow_a, BASE + i));
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+  mem = graph_idset_roaring_memory(a);
+  TEST(mem >= CHUNK / 8 && mem < CHUNK / 8 + 4096);
+
+  /*  Chunk 1: a few long runs, inserted out of order; the
+   *  array becomes a run container and stays small.
+   */
+  for (i = 20000; i < 40000; i++)
+    TEST(!set_insert(a, shadow_a, BASE + CHUNK + i));
+  for (i = 0; i < 10000; i++) TEST(!set_insert(a, shadow_a, BASE + CHUNK + i));
+  for (i = 50000; i < CHUNK; i++)
+    TEST(!set_insert(a, shadow_a, BASE + CHUNK + i));
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+  TEST(graph_idset_roaring_memory(a) < mem + 1024);
+
+  /*  Chunk 1 again: breaking up the runs with single ids in
+   *  the gaps, until a bitmap is smaller than the runs.
+   */
+  for (i = 10001; i < 20000; i += 2)
+    TEST(!set_insert(a, shadow_a, BASE + CHUNK + i));
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+  TEST(graph_idset_roaring_memory(a) >= 2 * (CHUNK / 8));
+
+  /*  ...and filling the gaps merges the runs back into one.
+   *  (The run container keeps the capacity it had when it
+   *  replaced the bitmap, but that's still less than a bitmap.)
+   */
+  for (i = 0; i < CHUNK; i++)
+    TEST(!set_insert(a, shadow_a, BASE + CHUNK + i));
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+  TEST(graph_idset_roaring_memory(a) < mem + CHUNK / 8);
+
+  /*  Chunk 2: a sparse array, growing out of the chunk header.
+   */
+  for (i = 7; i < CHUNK; i += 997)
+    TEST(!set_insert(a, shadow_a, BASE + 2 * CHUNK + i));
+  TEST(!set_check(a, shadow_a, __FILE__, __LINE__));
+
+  /*  The second set overlaps every chunk, in a different
+   *  container from the first.
+   */
+  b = graph_idset_roaring_create(graph);
+  TEST(b != NULL);
+  for (i = 0; i < CHUNK; i += 2) TEST(!set_insert(b, shadow_b, BASE + i));
+  for (i = 30000; i < 30100; i++)
+    TEST(!set_insert(b, shadow_b, BASE + CHUNK + i));
+  for (i = 0; i < CHUNK; i += 7)
+    TEST(!set_insert(b, shadow_b, BASE + 2 * CHUNK + i));
+  for (i = 3 * CHUNK - 5; i < UNIVERSE; i++)
+    TEST(!set_insert(b, shadow_b, BASE + i));
+  TEST(!set_check(b, shadow_b, __FILE__, __LINE__));
+
+  TEST(graph_idset_intersect_count(a, b) == shadow_intersect_count());
+  TEST(graph_idset_intersect_count(b, a) == shadow_intersect_count());
+  TEST(graph_idset_intersect_count(a, a) == a->gi_n);
+
+  /*  The same against a tile set goes the generic way.
+   */
+  t = graph_idset_tile_create(graph);
+  TEST(t != NULL);
+  for (i = 0; i < UNIVERSE; i++)
+    if (shadow_b[i]) TEST(!graph_idset_insert(t, BASE + i));
+  TEST(graph_idset_roaring_memory(t) == 0);
+  TEST(graph_idset_intersect_count(a, t) == shadow_intersect_count());
+  TEST(graph_idset_intersect_count(t, a) == shadow_intersect_count());
+
+  /*  Disjoint sets, in chunks both do and don't share.
+   */
+  graph_idset_free(b);
+  memset(shadow_b, 0, sizeof shadow_b);
+  b = graph_idset_roaring_create(graph);
+  TEST(b != NULL);
+  for (i = 1; i < CHUNK; i += 3) TEST(!set_insert(b, shadow_b, BASE + i));
+  TEST(!set_insert(b, shadow_b, BASE + 2 * CHUNK + 8));
+  TEST(!graph_idset_insert(b, BASE + UNIVERSE + CHUNK));
+  TEST(shadow_intersect_count() == 0);
+  TEST(graph_idset_intersect_count(a, b) == 0);
+
+  graph_idset_free(t);
+  graph_idset_free(b);
+  graph_idset_free(a);
+
+  except_catch(err) {
+    if (t != NULL) graph_idset_free(t);
+    if (b != NULL) graph_idset_free(b);
+    if (a != NULL) graph_idset_free(a);
+    fprintf(stderr, "\t[from \"%s\", line %d]\n", file, line);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int ac, char **av) {
+  cm_handle *cm;
+  cl_handle *cl;
+  graph_handle *graph;
+  int result = 0;
+
+  cm = cm_trace(cm_c());
+  cl = cl_create();
+  graph = graph_create(cm, cl);
+  if (graph == NULL) {
+    fprintf(stderr, "%s: can't create graph handle\n", av[0]);
+    return 1;
+  }
+
+  result |= idset_roaring(graph, __FILE__, __LINE__);
+
+  graph_destroy(graph);
+  cm_trace_destroy(cm);
+  cl_destroy(cl);
+
+  return result;
+}
@@ -617,6 +617,13 @@ typedef struct graph_idset_position {
 
 graph_idset *graph_idset_tile_create(graph_handle *g);
 
+/* graph-idset-roaring.c */
+
+graph_idset *graph_idset_roaring_create(graph_handle *g);
+size_t graph_idset_roaring_memory(graph_idset const *_idset);
+unsigned long long graph_idset_intersect_count(graph_idset *_a,
+                                               graph_idset *_b);
+
 /* Add, sorting automatically, duplicates silently discarded. */
 typedef int graph_idset_insert(graph_idset *idset, unsigned long long id);
 #define graph_idset_insert(idset, a) ((idset)->gi_type->git_insert)(idset, (a))
@@ -0,0 +1,538 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libpdb/pdbp.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libaddb/addb.h"
+
+/*  Bulk loading.
+ *
+ *  Normally, each new primitive is added to every index as it
+ *  is written (pdb_index_new_primitive()).  For the four linkage
+ *  gmaps, that means a random write into a different array for
+ *  each primitive -- fine for a running server, but painfully
+ *  slow when loading hundreds of millions of primitives.
+ *
+ *  Between pdb_bulk_begin() and pdb_bulk_finish(), primitives
+ *  are only appended to the istore.  The indices stay at the
+ *  horizon they had when the bulk load began; the istore
+ *  horizon doesn't advance.  (The generation table is the
+ *  exception -- pdb_primitive_alloc() reads it to number new
+ *  versions, so it is kept current; so is the column file,
+ *  which is appended to in id order either way.)
+ *
+ *  pdb_bulk_finish() then reads the new primitives once, in
+ *  order.  It adds them to the hmap-based indices as it goes,
+ *  and collects (source, id) pairs for the linkage gmaps into
+ *  runs which are sorted, in parallel on the addb worker
+ *  threads, and spilled to disk.  Merging the runs of each gmap
+ *  yields its additions in source order, which turns the gmap
+ *  updates into one sequential sweep through its partitions.
+ *
+ *  The indices end up holding the same ID sets, in the same
+ *  on-disk format, as if each primitive had been indexed when
+ *  it was written.
+ *
+ *  If the server crashes during a bulk load, the indices are
+ *  still consistent with the istore horizon; a server started
+ *  with a bulk load picks up where the crashed one left off.
+ */
+
+/*  Records per sorted run and index.  (With four indices and
+ *  24 bytes per record, that's 192M of buffers.)
+ */
+#define PDB_BULK_RUN_MAX (1024ul * 1024 * 2)
+
+/*  Read buffer size for each run while merging.
+ */
+#define PDB_BULK_READ_BUFFER (1024 * 64)
+
+typedef struct pdb_bulk_record {
+  pdb_id br_source;
+  pdb_id br_id;
+
+  /*  For left and right, the link's typeguid ID (or PDB_ID_NONE),
+   *  for the VIP table.
+   */
+  pdb_id br_type;
+
+} pdb_bulk_record;
+
+typedef struct pdb_bulk_index {
+  pdb_bulk_record *bi_buf;
+  size_t bi_n;
+
+  /*  Number of runs written to disk so far.
+   */
+  size_t bi_run_n;
+
+  /*  Set by the sort task.
+   */
+  int bi_err;
+
+} pdb_bulk_index;
+
+typedef struct pdb_bulk_state {
+  pdb_handle *pbs_pdb;
+  pdb_bulk_index pbs_index[PDB_LINKAGE_N];
+
+} pdb_bulk_state;
+
+typedef struct pdb_bulk_run {
+  FILE *run_fp;
+  pdb_bulk_record run_rec;
+
+} pdb_bulk_run;
+
+static int bulk_record_compare(void const *a_ptr, void const *b_ptr) {
+  pdb_bulk_record const *a = a_ptr;
+  pdb_bulk_record const *b = b_ptr;
+
+  if (a->br_source != b->br_source) return a->br_source < b->br_source ? -1 : 1;
+  if (a->br_id != b->br_id) return a->br_id < b->br_id ? -1 : 1;
+  return 0;
+}
+
+static bool bulk_record_less(pdb_bulk_record const *a,
+                             pdb_bulk_record const *b) {
+  return a->br_source < b->br_source ||
+         (a->br_source == b->br_source && a->br_id < b->br_id);
+}
+
+static void bulk_run_path(pdb_handle *pdb, int linkage, size_t run, char *buf,
+                          size_t size) {
+  snprintf(buf, size, "%s/bulk-%s.%zu",
+           pdb->pdb_path ? pdb->pdb_path : PDB_PATH_DEFAULT,
+           pdb_linkage_to_string(linkage), run);
+}
+
+/*  Worker task: sort the buffered records of index <i> and write
+ *  them out as a run.  This runs outside of the main thread, and
+ *  mustn't log or allocate through cm.
+ */
+static void bulk_sort_task(void *data, size_t i) {
+  pdb_bulk_state *pbs = data;
+  pdb_bulk_index *bi = pbs->pbs_index + i;
+  char path[1024];
+  FILE *fp;
+
+  if (bi->bi_n == 0 || bi->bi_err != 0) return;
+
+  qsort(bi->bi_buf, bi->bi_n, sizeof(*bi->bi_buf), bulk_record_compare);
+
+  bulk_run_path(pbs->pbs_pdb, (int)i, bi->bi_run_n, path, sizeof path);
+  if ((fp = fopen(path, "w")) == NULL) {
+    bi->bi_err = errno ? errno : EIO;
+    return;
+  }
+  if (fwrite(bi->bi_buf, sizeof(*bi->bi_buf), bi->bi_n, fp) != bi->bi_n) {
+    bi->bi_err = errno ? errno : EIO;
+    (void)fclose(fp);
+    return;
+  }
+  if (fclose(fp) != 0) {
+    bi->bi_err = errno ? errno : EIO;
+    return;
+  }
+  bi->bi_run_n++;
+  bi->bi_n = 0;
+}
+
+/*  Sort and spill all buffered records, one index per thread.
+ */
+static int bulk_flush(pdb_bulk_state *pbs) {
+  pdb_handle *pdb = pbs->pbs_pdb;
+  int linkage;
+
+  addb_worker_run(pdb->pdb_addb, PDB_LINKAGE_N, bulk_sort_task, pbs);
+
+  for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++) {
+    pdb_bulk_index *bi = pbs->pbs_index + linkage;
+    if (bi->bi_err != 0) {
+      char path[1024];
+
+      bulk_run_path(pdb, linkage, bi->bi_run_n, path, sizeof path);
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "bulk_sort_task", bi->bi_err,
+                   "can't write sorted run \"%s\"", path);
+      return bi->bi_err;
+    }
+  }
+  return 0;
+}
+
+/*  Read the primitives in [low...high) once.  Update the
+ *  hmap-based indices and subscribers in ID order; buffer
+ *  linkage pairs for sorting.
+ */
+static int bulk_scan(pdb_bulk_state *pbs, pdb_id low, pdb_id high) {
+  pdb_handle *pdb = pbs->pbs_pdb;
+  pdb_id id;
+  int err;
+
+  for (id = low; id < high; id++) {
+    pdb_primitive pr;
+    pdb_id type_id = PDB_ID_NONE;
+    bool full = false;
+    int linkage;
+
+    err = pdb_id_read(pdb, id, &pr);
+    if (err == PDB_ERR_NO) continue;
+    if (err != 0) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "pdb_id_read", err, "id=%llx",
+                   (unsigned long long)id);
+      return err;
+    }
+
+    if (pdb_primitive_has_typeguid(&pr)) {
+      graph_guid typeguid;
+
+      pdb_primitive_typeguid_get(&pr, typeguid);
+      type_id = GRAPH_GUID_SERIAL(typeguid);
+    }
+
+    for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++) {
+      pdb_bulk_index *bi = pbs->pbs_index + linkage;
+      pdb_bulk_record *br;
+      graph_guid guid;
+      pdb_id source;
+
+      if (!pdb_primitive_has_linkage(&pr, linkage)) continue;
+
+      pdb_primitive_linkage_get(&pr, linkage, guid);
+      err = pdb_id_from_guid(pdb, &source, &guid);
+      if (err != 0) {
+        char buf[GRAPH_GUID_SIZE];
+        cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_id_from_guid", err,
+                     "cannot resolve %llx.%s=%s to a local id",
+                     (unsigned long long)id, pdb_linkage_to_string(linkage),
+                     graph_guid_to_string(&guid, buf, sizeof buf));
+        pdb_primitive_finish(pdb, &pr);
+        return err;
+      }
+
+      br = bi->bi_buf + bi->bi_n++;
+      br->br_source = source;
+      br->br_id = id;
+      br->br_type = type_id;
+
+      if (bi->bi_n >= PDB_BULK_RUN_MAX) full = true;
+    }
+
+    err = pdb_hash_synchronize(pdb, id, &pr);
+    if (err == 0) err = pdb_value_bin_synchronize(pdb, id, &pr);
+    if (err == 0) err = pdb_primitive_alloc_subscription_call(pdb, id, &pr);
+    pdb_primitive_finish(pdb, &pr);
+
+    if (err != 0) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "bulk_scan", err, "id=%llx",
+                   (unsigned long long)id);
+      return err;
+    }
+    if (full && (err = bulk_flush(pbs)) != 0) return err;
+  }
+  return bulk_flush(pbs);
+}
+
+/*  Restore the heap property below heap[i].
+ */
+static void bulk_heap_down(pdb_bulk_run *run, size_t *heap, size_t n,
+                           size_t i) {
+  for (;;) {
+    size_t least = i, child = 2 * i + 1;
+    size_t tmp;
+
+    if (child < n &&
+        bulk_record_less(&run[heap[child]].run_rec, &run[heap[least]].run_rec))
+      least = child;
+    if (child + 1 < n && bulk_record_less(&run[heap[child + 1]].run_rec,
+                                          &run[heap[least]].run_rec))
+      least = child + 1;
+    if (least == i) return;
+
+    tmp = heap[i];
+    heap[i] = heap[least];
+    heap[least] = tmp;
+    i = least;
+  }
+}
+
+/*  Merge the runs of one linkage into its gmap, in (source, id)
+ *  order.  For left and right, also keep the VIP table current,
+ *  exactly as pdb_vip_synchronize() would have.
+ */
+static int bulk_merge(pdb_bulk_state *pbs, int linkage) {
+  pdb_handle *pdb = pbs->pbs_pdb;
+  pdb_bulk_index *bi = pbs->pbs_index + linkage;
+  addb_gmap *gm = pdb_linkage_to_gmap(pdb, linkage);
+  bool const vip = linkage == PDB_LINKAGE_LEFT || linkage == PDB_LINKAGE_RIGHT;
+  pdb_id source = PDB_ID_NONE;
+  unsigned long long n = 0;
+  pdb_bulk_run *run;
+  size_t *heap, heap_n = 0, i;
+  char path[1024];
+  int err = 0;
+
+  if (bi->bi_run_n == 0) return 0;
+
+  run = cm_zalloc(pdb->pdb_cm, bi->bi_run_n * sizeof(*run));
+  heap = cm_malloc(pdb->pdb_cm, bi->bi_run_n * sizeof(*heap));
+  if (run == NULL || heap == NULL) {
+    err = ENOMEM;
+    goto done;
+  }
+
+  for (i = 0; i < bi->bi_run_n; i++) {
+    bulk_run_path(pdb, linkage, i, path, sizeof path);
+    if ((run[i].run_fp = fopen(path, "r")) == NULL) {
+      err = errno ? errno : EIO;
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "fopen", err, "path=%s", path);
+      goto done;
+    }
+    (void)setvbuf(run[i].run_fp, NULL, _IOFBF, PDB_BULK_READ_BUFFER);
+    if (fread(&run[i].run_rec, sizeof run[i].run_rec, 1, run[i].run_fp) == 1)
+      heap[heap_n++] = i;
+  }
+  for (i = heap_n / 2; i-- > 0;) bulk_heap_down(run, heap, heap_n, i);
+
+  while (heap_n > 0) {
+    pdb_bulk_run *r = run + heap[0];
+    pdb_bulk_record const br = r->run_rec;
+
+    if (vip && br.br_source != source) {
+      err = pdb_linkage_count_est(pdb, linkage, br.br_source,
+                                  PDB_ITERATOR_LOW_ANY, PDB_ITERATOR_HIGH_ANY,
+                                  PDB_COUNT_UNBOUNDED, &n);
+      if (err != 0) goto done;
+    }
+    source = br.br_source;
+
+    pdb->pdb_runtime_statistics.rts_index_elements_written++;
+    err = addb_gmap_add(gm, br.br_source, br.br_id, 0);
+    if (err != 0) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "addb_gmap_add", err,
+                   "%s %llx -> primitive %llx", pdb_linkage_to_string(linkage),
+                   (unsigned long long)br.br_source,
+                   (unsigned long long)br.br_id);
+      goto done;
+    }
+
+    /*  Below the VIP threshold, pdb_vip_add() would do nothing;
+     *  save it the trouble of counting.
+     */
+    if (vip && ++n >= PDB_VIP_MIN - 1) {
+      err = pdb_vip_add(pdb, br.br_source, linkage, br.br_type, br.br_id);
+      if (err != 0) goto done;
+    }
+
+    if (fread(&r->run_rec, sizeof r->run_rec, 1, r->run_fp) != 1) {
+      if (ferror(r->run_fp)) {
+        err = errno ? errno : EIO;
+        cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "fread", err,
+                     "error reading sorted %s run",
+                     pdb_linkage_to_string(linkage));
+        goto done;
+      }
+      heap[0] = heap[--heap_n];
+    }
+    bulk_heap_down(run, heap, heap_n, 0);
+  }
+
+done:
+  if (run != NULL)
+    for (i = 0; i < bi->bi_run_n; i++)
+      if (run[i].run_fp != NULL) (void)fclose(run[i].run_fp);
+  cm_free(pdb->pdb_cm, heap);
+  cm_free(pdb->pdb_cm, run);
+  return err;
+}
+
+static void bulk_state_finish(pdb_bulk_state *pbs) {
+  pdb_handle *pdb = pbs->pbs_pdb;
+  char path[1024];
+  int linkage;
+  size_t i;
+
+  for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++) {
+    pdb_bulk_index *bi = pbs->pbs_index + linkage;
+
+    for (i = 0; i < bi->bi_run_n; i++) {
+      bulk_run_path(pdb, linkage, i, path, sizeof path);
+      (void)unlink(path);
+    }
+    if (bi->bi_buf != NULL) free(bi->bi_buf);
+  }
+}
+
+/**
+ * @brief Start a bulk load.
+ *
+ *  Call this after pdb_initialize(), and before
+ *  pdb_initialize_checkpoint().  Until pdb_bulk_finish(),
+ *  new primitives aren't added to the indices.
+ *
+ * @param pdb	opaque database handle
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_bulk_begin(pdb_handle *pdb) {
+  int err;
+
+  if (pdb->pdb_bulk) return 0;
+
+  /*  A transactional database's indices are consistent
+   *  with its horizon.  Without transactions, they may
+   *  have gone past it; bring them up to date the usual
+   *  way before we start.
+   */
+  if (!pdb_transactional(pdb) && (err = pdb_checkpoint_synchronize(pdb)) != 0)
+    return err;
+
+  pdb->pdb_bulk = true;
+  cl_log(pdb->pdb_cl, CL_LEVEL_INFO,
+         "pdb: bulk load; indices stay at %llx until it's finished",
+         (unsigned long long)addb_istore_horizon(pdb->pdb_primitive));
+
+  /*  If an earlier bulk load crashed, catch up its
+   *  generation table.
+   */
+  return pdb_checkpoint_synchronize(pdb);
+}
+
+/**
+ * @brief Is a bulk load in progress?
+ *
+ * @param pdb	opaque database handle
+ * @return true between pdb_bulk_begin() and pdb_bulk_finish().
+ */
+bool pdb_bulk(pdb_handle *pdb) { return pdb != NULL && pdb->pdb_bulk; }
+
+/**
+ * @brief Keep the generation table current during a bulk load.
+ *
+ *  Called by pdb_checkpoint_synchronize() while a bulk load
+ *  is in progress: the indices are at the istore horizon, and
+ *  everything above it, other than the generation table and
+ *  the column file, is left to pdb_bulk_finish().
+ *
+ * @param pdb	opaque database handle
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_bulk_synchronize(pdb_handle *pdb) {
+  addb_istore_id const horizon = addb_istore_horizon(pdb->pdb_primitive);
+  addb_istore_id const next_id = addb_istore_next_id(pdb->pdb_primitive);
+  addb_istore_id id;
+  int err;
+
+  for (id = horizon; id < next_id; id++) {
+    pdb_primitive pr;
+
+    err = pdb_id_read(pdb, id, &pr);
+    if (err == PDB_ERR_NO) continue;
+    if (err != 0) return err;
+
+    err = pdb_generation_synchronize(pdb, id, &pr);
+    if (err == 0) err = pdb_versioned_synchronize(pdb, id, &pr);
+    if (err == 0) err = pdb_column_synchronize(pdb, id, &pr);
+    pdb_primitive_finish(pdb, &pr);
+
+    if (err != 0) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_bulk_synchronize", err,
+                   "id=%llx", (unsigned long long)id);
+      return err;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Finish a bulk load: index everything it loaded.
+ *
+ *  This can take a while; it doesn't return until the indices
+ *  have been brought up to date and checkpointed.
+ *
+ * @param pdb	opaque database handle
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_bulk_finish(pdb_handle *pdb) {
+  pdb_bulk_state pbs;
+  pdb_id low, high;
+  int linkage;
+  int err = 0;
+
+  if (!pdb->pdb_bulk) return 0;
+  if (pdb->pdb_primitive == NULL) {
+    pdb->pdb_bulk = false;
+    return 0;
+  }
+
+  low = addb_istore_horizon(pdb->pdb_primitive);
+  high = addb_istore_next_id(pdb->pdb_primitive);
+
+  cl_log(pdb->pdb_cl, CL_LEVEL_INFO,
+         "pdb: indexing %llu bulk-loaded primitives (%llx...%llx)",
+         (unsigned long long)(high - low), (unsigned long long)low,
+         (unsigned long long)high);
+
+  if (pdb->pdb_iterator_n_unsuspended > 0 &&
+      (err = pdb_iterator_suspend_all(pdb)) != 0)
+    return err;
+
+  memset(&pbs, 0, sizeof pbs);
+  pbs.pbs_pdb = pdb;
+
+  if (low < high) {
+    for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++) {
+      pbs.pbs_index[linkage].bi_buf =
+          malloc(PDB_BULK_RUN_MAX * sizeof(pdb_bulk_record));
+      if (pbs.pbs_index[linkage].bi_buf == NULL) {
+        err = ENOMEM;
+        goto err;
+      }
+    }
+
+    if ((err = bulk_scan(&pbs, low, high)) != 0) goto err;
+
+    for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++)
+      if ((err = bulk_merge(&pbs, linkage)) != 0) goto err;
+  }
+  bulk_state_finish(&pbs);
+
+  pdb->pdb_bulk = false;
+  err = pdb_checkpoint_optional(pdb, 0);
+  if (err != 0)
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "pdb_checkpoint_optional", err,
+                 "can't checkpoint bulk-loaded indices");
+  else
+    cl_log(pdb->pdb_cl, CL_LEVEL_INFO, "pdb: bulk load finished at %llx",
+           (unsigned long long)high);
+  return err;
+
+err:
+  bulk_state_finish(&pbs);
+  cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "pdb_bulk_finish", err,
+               "failed to index bulk-loaded primitives %llx...%llx",
+               (unsigned long long)low, (unsigned long long)high);
+
+  /*  Undo the partial index updates, if we can; the bulk
+   *  load is then still in progress, and can be finished later.
+   */
+  if (pdb_transactional(pdb) && pdb_checkpoint_rollback(pdb, high) != 0)
+    cl_log(pdb->pdb_cl, CL_LEVEL_ERROR,
+           "pdb_bulk_finish: can't roll indices back to %llx",
+           (unsigned long long)low);
+  return err;
+}
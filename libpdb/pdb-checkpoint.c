@@ -118,6 +118,11 @@ int pdb_checkpoint_optional(pdb_handle* pdb, pdb_msclock_t deadline) {
    */
   if (pdb->pdb_primitive == NULL) return 0;
 
+  /*  During a bulk load, the indices stay where they are
+   *  until pdb_bulk_finish().
+   */
+  if (pdb->pdb_bulk) return 0;
+
   deficit = pdb_checkpoint_deficit(pdb);
   if (0 == deficit && PDB_CKS_START == stage) return 0;
 
@@ -361,6 +366,8 @@ int pdb_checkpoint_synchronize(pdb_handle* pdb) {
 
   if (!pdb) return EINVAL;
 
+  if (pdb->pdb_bulk) return pdb_bulk_synchronize(pdb);
+
   cl_enter(pdb->pdb_cl, CL_LEVEL_SPEW | ADDB_FACILITY_RECOVERY, "%s",
            pdb->pdb_path);
 
@@ -512,7 +519,10 @@ int pdb_checkpoint_rollback(pdb_handle* pdb, unsigned long long horizon) {
  * the indices?
  */
 unsigned long long pdb_checkpoint_deficit(pdb_handle* pdb) {
-  if (pdb->pdb_primitive == NULL) return 0;
+  /*  During a bulk load, that's on purpose; there's nothing
+   *  a checkpoint could do about it.
+   */
+  if (pdb->pdb_primitive == NULL || pdb->pdb_bulk) return 0;
   return addb_istore_next_id(pdb->pdb_primitive) -
          addb_istore_horizon(pdb->pdb_primitive);
 }
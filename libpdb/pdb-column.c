@@ -0,0 +1,223 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libpdb/pdbp.h"
+
+#include <errno.h>
+
+#include "libaddb/addb-column.h"
+
+/*  The column file.
+ *
+ *  Checks against a primitive mostly want one of its linkages,
+ *  as a local id.  Getting that out of the istore record means
+ *  reading the record, decompressing the GUID, and mapping it
+ *  back to an id.  The column file keeps those fields, already
+ *  decoded, in one 32-byte record per id:
+ *
+ *	 0	typeguid, right, left, scope: 5 bytes each,
+ *		all ones if unset
+ *	20	timestamp (6 bytes)
+ *	26	primitive bits
+ *	27	PDB_COLUMN_VALID, if the record has been written
+ *	28	low 32 bits of the value's hmap hash
+ *
+ *  Records are written by pdb_index_new_primitive().  Ids that
+ *  don't have one -- primitives written before the database
+ *  had a column file -- are answered from the istore record.
+ */
+
+#define PDB_COLUMN_LINKAGE_OFFSET(linkage) (5 * (linkage))
+#define PDB_COLUMN_TIMESTAMP_OFFSET 20
+#define PDB_COLUMN_BITS_OFFSET 26
+#define PDB_COLUMN_FLAGS_OFFSET 27
+#define PDB_COLUMN_VALUE_HASH_OFFSET 28
+
+#define PDB_COLUMN_VALID 0x01
+
+#define PDB_COLUMN_ID_NONE ((1ull << 40) - 1)
+
+static int pdb_column_encode(pdb_handle* pdb, pdb_id id,
+                             pdb_primitive const* pr, unsigned char* buf) {
+  unsigned long long h = 0;
+  size_t sz;
+  int linkage, err;
+
+  for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++) {
+    pdb_id source = PDB_COLUMN_ID_NONE;
+
+    if (pdb_primitive_has_linkage(pr, linkage)) {
+      graph_guid g;
+
+      pdb_primitive_linkage_get(pr, linkage, g);
+      err = pdb_id_from_guid(pdb, &source, &g);
+      if (err) {
+        char buf1[GRAPH_GUID_SIZE];
+
+        cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_id_from_guid", err,
+                     "cannot resolve %llx.%s=%s to a local id",
+                     (unsigned long long)id, pdb_linkage_to_string(linkage),
+                     graph_guid_to_string(&g, buf1, sizeof buf1));
+        return err;
+      }
+    }
+    ADDB_PUT_U5(buf + PDB_COLUMN_LINKAGE_OFFSET(linkage), source);
+  }
+
+  sz = pdb_primitive_value_get_size(pr);
+  if (sz > 0) {
+    char const* s = pdb_primitive_value_get_memory(pr);
+
+    err = pdb_hash_value(pdb, s, s + (sz - 1), &h);
+    if (err) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_hash_value", err,
+                   "id=%llx", (unsigned long long)id);
+      return err;
+    }
+  }
+
+  ADDB_PUT_U6(buf + PDB_COLUMN_TIMESTAMP_OFFSET,
+              pdb_primitive_timestamp_get(pr));
+  buf[PDB_COLUMN_BITS_OFFSET] = pdb_primitive_bits_get(pr);
+  buf[PDB_COLUMN_FLAGS_OFFSET] = PDB_COLUMN_VALID;
+  ADDB_PUT_U4(buf + PDB_COLUMN_VALUE_HASH_OFFSET, h & 0xFFFFFFFFul);
+
+  return 0;
+}
+
+static pdb_id pdb_column_linkage_decode(unsigned char const* buf,
+                                        int linkage) {
+  unsigned long long source;
+
+  source = ADDB_GET_U5(buf + PDB_COLUMN_LINKAGE_OFFSET(linkage));
+  return source == PDB_COLUMN_ID_NONE ? PDB_ID_NONE : source;
+}
+
+/*  Read the column record for <id> into <buf>.  Returns
+ *  PDB_ERR_NO if there is no valid record.
+ */
+static int pdb_column_get(pdb_handle* pdb, pdb_id id, unsigned char* buf) {
+  int err;
+
+  /*  Records past the end of the istore may be left over
+   *  from primitives that were rolled back.
+   */
+  if (pdb->pdb_column == NULL || pdb->pdb_primitive == NULL ||
+      id >= addb_istore_next_id(pdb->pdb_primitive))
+    return PDB_ERR_NO;
+
+  err = addb_column_read(pdb->pdb_column, id, buf);
+  if (err == 0 && !(buf[PDB_COLUMN_FLAGS_OFFSET] & PDB_COLUMN_VALID))
+    err = PDB_ERR_NO;
+  else if (err != 0 && err != ADDB_ERR_NO)
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_column_read", err,
+                 "id=%llx", (unsigned long long)id);
+  return err;
+}
+
+/**
+ * @brief Read the fixed-width fields of a primitive.
+ *
+ * @param pdb		opaque pdb module handle
+ * @param id		local ID of the primitive
+ * @param pcr		out: its fields
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_column_read(pdb_handle* pdb, pdb_id id, pdb_column_record* pcr) {
+  unsigned char buf[PDB_COLUMN_SIZE];
+  int linkage, err;
+
+  err = pdb_column_get(pdb, id, buf);
+  if (err == PDB_ERR_NO) {
+    pdb_primitive pr;
+
+    if ((err = pdb_id_read(pdb, id, &pr)) != 0) return err;
+    err = pdb_column_encode(pdb, id, &pr, buf);
+    pdb_primitive_finish(pdb, &pr);
+  }
+  if (err != 0) return err;
+
+  for (linkage = 0; linkage < PDB_LINKAGE_N; linkage++)
+    pcr->pcr_linkage[linkage] = pdb_column_linkage_decode(buf, linkage);
+  pcr->pcr_timestamp = ADDB_GET_U6(buf + PDB_COLUMN_TIMESTAMP_OFFSET);
+  pcr->pcr_bits = buf[PDB_COLUMN_BITS_OFFSET];
+  pcr->pcr_value_hash = ADDB_GET_U4(buf + PDB_COLUMN_VALUE_HASH_OFFSET);
+
+  return 0;
+}
+
+/**
+ * @brief Get one linkage of a primitive, as a local id.
+ *
+ * @param pdb		opaque pdb module handle
+ * @param id		local ID of the primitive
+ * @param linkage	PDB_LINKAGE_... selector
+ * @param id_out	out: the linkage's id, or PDB_ID_NONE if
+ *			the primitive doesn't have that linkage.
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_column_linkage(pdb_handle* pdb, pdb_id id, int linkage,
+                       pdb_id* id_out) {
+  unsigned char buf[PDB_COLUMN_SIZE];
+  pdb_primitive pr;
+  graph_guid g;
+  int err;
+
+  cl_assert(pdb->pdb_cl, PDB_IS_LINKAGE(linkage));
+
+  err = pdb_column_get(pdb, id, buf);
+  if (err == 0) {
+    *id_out = pdb_column_linkage_decode(buf, linkage);
+    return 0;
+  }
+  if (err != PDB_ERR_NO) return err;
+
+  /*  No record; decode just the one linkage.
+   */
+  if ((err = pdb_id_read(pdb, id, &pr)) != 0) return err;
+
+  if (!pdb_primitive_has_linkage(&pr, linkage))
+    *id_out = PDB_ID_NONE;
+  else {
+    pdb_primitive_linkage_get(&pr, linkage, g);
+    err = pdb_id_from_guid(pdb, id_out, &g);
+  }
+  pdb_primitive_finish(pdb, &pr);
+
+  return err;
+}
+
+/**
+ * @brief Write the column record for a new primitive.
+ *
+ * @param pdb   opaque pdb module handle
+ * @param id    local ID of the passed-in record
+ * @param pr    passed-in record
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_column_synchronize(pdb_handle* pdb, pdb_id id,
+                           pdb_primitive const* pr) {
+  unsigned char buf[PDB_COLUMN_SIZE];
+  int err;
+
+  err = pdb_column_encode(pdb, id, pr, buf);
+  if (err) return err;
+
+  err = addb_column_write(pdb->pdb_column, id, buf);
+  if (err)
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "addb_column_write", err,
+                 "id=%llx", (unsigned long long)id);
+  return err;
+}
@@ -118,8 +118,7 @@ int pdb_count_gmap_est(pdb_handle* pdb, addb_gmap* gm, pdb_id source,
     return 0;
   } else if (err == ADDB_ERR_BITMAP) {
     /*
-     * We know this thing is a bitmap. Use random sampling
-     * to estimate the number of bits set.
+     * We know this thing is a bitmap. Count the bits set.
      */
     if (high == PDB_ITERATOR_HIGH_ANY)
       high = addb_istore_next_id(pdb->pdb_primitive);
@@ -197,3 +196,82 @@ int pdb_count_hmap(pdb_handle* pdb, addb_hmap* hm, addb_hmap_id hash_of_key,
   }
   return err;
 }
+
+/*  Ids of an idarray run through the live bitmap at a time.
+ */
+#define PDB_COUNT_LIVE_CHUNK 256
+
+/**
+ * @brief How many live primitives are in a gmap entry?
+ *
+ *  Bitmaps are ANDed with the live bitmap and counted; arrays
+ *  are tested against it a chunk of ids at a time.
+ *
+ * @param pdb 		opaque database pointer, created with pdb_create()
+ * @param gm 		opaque gmap poitner
+ * @param source 	source of the GMAP iteration
+ * @param low	 	lower value bound or PDB_ITERATOR_LOW_ANY
+ * @param high	 	higher value bound or PDB_ITERATOR_HIGH_ANY
+ * @param upper_bound 	higher number of results bound, or PDB_COUNT_UNBOUNDED
+ * @param nout	 	out: number of live entries in this GMAP.
+ *
+ * @return 0 on success, a nonzero error code on error
+ */
+int pdb_count_gmap_live(pdb_handle* pdb, addb_gmap* gm, pdb_id source,
+                        pdb_id low, pdb_id high,
+                        unsigned long long upper_bound,
+                        unsigned long long* n_out) {
+  addb_id buf[PDB_COUNT_LIVE_CHUNK], live[PDB_COUNT_LIVE_CHUNK], id;
+  unsigned long long off, end, n;
+  addb_idarray ida;
+  int err;
+
+  *n_out = 0;
+  if (high == PDB_ITERATOR_HIGH_ANY)
+    high = addb_istore_next_id(pdb->pdb_primitive);
+
+  err = addb_gmap_idarray(gm, source, &ida);
+  if (err == ADDB_ERR_NO) return 0;
+  if (err == ADDB_ERR_BITMAP) {
+    addb_bgmap* bgm;
+
+    err = addb_bgmap_lookup(gm, source, &bgm);
+    if (err != 0) return err;
+
+    err = addb_bgmap_count_masked(gm, bgm, pdb->pdb_live, low, high, n_out);
+    if (err == 0 && *n_out > upper_bound) *n_out = upper_bound;
+    return err;
+  }
+  if (err != 0) return err;
+
+  pdb->pdb_runtime_statistics.rts_index_extents_read++;
+  n = addb_idarray_n(&ida);
+
+  err = addb_idarray_search(&ida, 0, n, low, &off, &id);
+  while (err == 0 && off < n && *n_out < upper_bound) {
+    size_t i, k, n_live;
+
+    end = off + PDB_COUNT_LIVE_CHUNK > n ? n : off + PDB_COUNT_LIVE_CHUNK;
+    err = addb_idarray_read(&ida, off, end, buf, &end);
+    if (err != 0) break;
+
+    /*  The ids are sorted; stop at <high>.
+     */
+    k = end - off;
+    for (i = 0; i < k && buf[i] < high; i++)
+      ;
+    pdb->pdb_runtime_statistics.rts_index_elements_read += i;
+
+    err = addb_bmap_fixed_intersect(pdb->pdb_addb, pdb->pdb_live, buf, i, live,
+                                    &n_live, i);
+    if (err != 0) break;
+
+    *n_out += n_live;
+    if (i < k) break;
+    off = end;
+  }
+  addb_idarray_finish(&ida);
+
+  if (*n_out > upper_bound) *n_out = upper_bound;
+  return err;
+}
@@ -63,6 +63,8 @@ pdb_handle* pdb_create(cm_handle* cm, cl_handle* cl, int version) {
   pdb->pdb_indices[PDB_INDEX_HMAP].ii_type = &pdb_index_hmap;
   pdb->pdb_indices[PDB_INDEX_PREFIX].ii_type = &pdb_index_bmap;
   pdb->pdb_indices[PDB_INDEX_DEAD].ii_type = &pdb_index_bmap;
+  pdb->pdb_indices[PDB_INDEX_COLUMN].ii_type = &pdb_index_column;
+  pdb->pdb_indices[PDB_INDEX_LIVE].ii_type = &pdb_index_bmap;
 
   /*   Make sure that we initialized all types.
    */
@@ -69,6 +69,31 @@ static unsigned long long pdb_case_insensitive_hash(char const* key,
   return h & ((1ull << 34) - 1);
 }
 
+/**
+ * @brief The hash a value is filed under in the hmap.
+ *
+ * @param pdb		opaque pdb module handle
+ * @param s		beginning of the value
+ * @param e		end of the value
+ * @param hash_out	out: the hash of the normalized value
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_hash_value(pdb_handle* pdb, char const* s, char const* e,
+                   unsigned long long* hash_out) {
+  char const *norm_s, *norm_e;
+  char* norm_buf;
+  int err;
+
+  err = pdb_hmap_value_normalize(pdb, s, e, &norm_s, &norm_e, &norm_buf);
+  if (err != 0) return err;
+
+  *hash_out = pdb_case_insensitive_hash(norm_s, norm_e - norm_s);
+  if (norm_buf != NULL) cm_free(pdb->pdb_cm, norm_buf);
+
+  return 0;
+}
+
 int pdb_hash_add(pdb_handle* pdb, addb_hmap_type t, char const* key,
                  size_t key_len, pdb_id id) {
   cl_assert(pdb->pdb_cl, key);
@@ -0,0 +1,91 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libpdb/pdbp.h"
+
+#include "libaddb/addb-column.h"
+
+/* Column index type
+ */
+
+static int pdb_coli_close(pdb_handle* pdb, pdb_index_instance* ii) {
+  return addb_column_close(ii->ii_impl.col);
+}
+
+static int pdb_coli_truncate(pdb_handle* pdb, pdb_index_instance* ii) {
+  return addb_column_truncate(ii->ii_impl.col);
+}
+
+static int pdb_coli_status(pdb_handle* pdb, pdb_index_instance* ii,
+                           cm_prefix const* prefix,
+                           pdb_status_callback* callback, void* callback_data) {
+  return addb_column_status(ii->ii_impl.col, prefix, callback, callback_data);
+}
+
+static int pdb_coli_status_tiles(pdb_handle* pdb, pdb_index_instance* ii,
+                                 cm_prefix const* prefix,
+                                 pdb_status_callback* callback,
+                                 void* callback_data) {
+  return addb_column_status_tiles(ii->ii_impl.col, prefix, callback,
+                                  callback_data);
+}
+
+static unsigned long long pdb_coli_horizon(pdb_handle* pdb,
+                                           pdb_index_instance* ii) {
+  cl_assert(pdb->pdb_cl, ii->ii_impl.col);
+
+  return addb_column_horizon(ii->ii_impl.col);
+}
+
+static void pdb_coli_advance_horizon(pdb_handle* pdb, pdb_index_instance* ii,
+                                     unsigned long long horizon) {
+  cl_assert(pdb->pdb_cl, ii->ii_impl.col);
+  cl_assert(pdb->pdb_cl, horizon >= addb_column_horizon(ii->ii_impl.col));
+
+  addb_column_horizon_set(ii->ii_impl.col, horizon);
+}
+
+/*  Nothing to undo; records above the horizon are rewritten
+ *  as their primitives are indexed again.
+ */
+static int pdb_coli_rollback(pdb_handle* pdb, pdb_index_instance* ii) {
+  return 0;
+}
+
+static int pdb_coli_start_writes(pdb_index_instance* ii, bool hard_sync,
+                                 bool block) {
+  return addb_column_checkpoint_start_writes(ii->ii_impl.col, hard_sync, block);
+}
+
+static int pdb_coli_finish_writes(pdb_index_instance* ii, bool hard_sync,
+                                  bool block) {
+  return addb_column_checkpoint_finish_writes(ii->ii_impl.col, hard_sync,
+                                              block);
+}
+
+static int pdb_coli_refresh(pdb_handle* pdb, pdb_index_instance* ii,
+                            unsigned long long pdb_n) {
+  return addb_column_refresh(ii->ii_impl.col, pdb_n);
+}
+
+pdb_index_type pdb_index_column = {
+    "column",
+    pdb_coli_close,
+    pdb_coli_truncate,
+    pdb_coli_status,
+    pdb_coli_status_tiles,
+    pdb_coli_horizon,
+    pdb_coli_advance_horizon,
+    pdb_coli_rollback,
+    pdb_coli_refresh,
+    {NULL, NULL, NULL, pdb_coli_start_writes, pdb_coli_finish_writes, NULL,
+     NULL, NULL}};
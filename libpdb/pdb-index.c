@@ -96,6 +96,22 @@ int pdb_index_new_primitive(pdb_handle* pdb, pdb_id id,
   }
   cl_assert(pdb->pdb_cl, pdb->pdb_iterator_n_unsuspended == 0);
 
+  /*  During a bulk load, everything else is indexed by
+   *  pdb_bulk_finish().  The generation table can't wait;
+   *  pdb_primitive_alloc() uses it to number new versions.
+   *  The column file is written in id order anyway, and
+   *  keeping it current means checks never see a stale record.
+   */
+  if (pdb->pdb_bulk) {
+    err = pdb_generation_synchronize(pdb, id, pr);
+    if (err == 0) err = pdb_versioned_synchronize(pdb, id, pr);
+    if (err == 0) err = pdb_column_synchronize(pdb, id, pr);
+    if (err)
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_generation_synchronize",
+                   err, "id=%llx", (unsigned long long)id);
+    return err;
+  }
+
   err = pdb_linkage_synchronize(pdb, id, pr);
   if (err) {
     cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_linkage_synchronize", err,
@@ -103,6 +119,13 @@ int pdb_index_new_primitive(pdb_handle* pdb, pdb_id id,
     return err;
   }
 
+  err = pdb_column_synchronize(pdb, id, pr);
+  if (err) {
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_column_synchronize", err,
+                 "id=%llx", (unsigned long long)id);
+    return err;
+  }
+
   err = pdb_vip_synchronize(pdb, id, pr);
   if (err) {
     cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_vip_synchronize", err,
@@ -133,7 +156,8 @@ int pdb_index_new_primitive(pdb_handle* pdb, pdb_id id,
 
   /*
    * Mark primitives that this one has versioned as
-   * obsolete in the versioned bitmap
+   * obsolete in the versioned bitmap, and keep the
+   * live bitmap current.
    */
   err = pdb_versioned_synchronize(pdb, id, pr);
 
@@ -23,6 +23,7 @@ limitations under the License.
 #include <unistd.h>
 
 #include "libaddb/addb-bmap.h"
+#include "libaddb/addb-column.h"
 #include "libcl/cl.h"
 #include "libcm/cm.h"
 
@@ -234,6 +235,14 @@ int pdb_initialize_names(pdb_handle* pdb) {
   pdb->pdb_versioned_path = cm_strmalcpy(pdb->pdb_cm, dir_buf);
   if (!pdb->pdb_versioned_path) goto oom;
 
+  strcpy(dir_base, "bmap/live");
+  pdb->pdb_live_path = cm_strmalcpy(pdb->pdb_cm, dir_buf);
+  if (!pdb->pdb_live_path) goto oom;
+
+  strcpy(dir_base, "column");
+  pdb->pdb_column_path = cm_strmalcpy(pdb->pdb_cm, dir_buf);
+  if (!pdb->pdb_column_path) goto oom;
+
   cm_free(pdb->pdb_cm, dir_buf);
 
   return 0;
@@ -305,7 +314,7 @@ close_hmap:
 }
 
 /*
- * make the bmap directory for the versioned and prefix maps
+ * make the bmap directory for the versioned, live, and prefix maps
  */
 static int pdb_initialize_bmap_dir(pdb_handle* pdb) {
   int err;
@@ -390,6 +399,49 @@ int pdb_initialize_open_databases(pdb_handle* pdb) {
              "bmap/versioned initialization failed: %s", strerror(err));
     return err;
   }
+
+  /*  A database from before the live bitmap gets one built
+   *  from the istore and the versioned bitmap.
+   */
+  if (addb_istore_next_id(pdb->pdb_primitive) > 0 &&
+      access(pdb->pdb_live_path, F_OK) != 0 && errno == ENOENT) {
+    err = pdb_live_rebuild(pdb, horizon);
+    if (err) {
+      cl_leave(pdb->pdb_cl, CL_LEVEL_FAIL, "live bitmap rebuild failed: %s",
+               pdb_xstrerror(err));
+      return err;
+    }
+  }
+
+  err = addb_bmap_open(pdb->pdb_addb, pdb->pdb_live_path, 0, horizon, false,
+                       &pdb->pdb_live);
+  if (err) {
+    cl_leave(pdb->pdb_cl, CL_LEVEL_FAIL, "bmap/live initialization failed: %s",
+             strerror(err));
+    return err;
+  }
+
+  /*  The column file only caches what the istore has.  If its
+   *  header is damaged, start it over; ids without a record are
+   *  read from the istore.
+   */
+  err = addb_column_open(pdb->pdb_addb, pdb->pdb_column_path, PDB_COLUMN_SIZE,
+                         horizon, &pdb->pdb_column);
+  if (err == EINVAL) {
+    cl_log(pdb->pdb_cl, CL_LEVEL_ERROR,
+           "pdb_initialize: %s is damaged; starting a new column file",
+           pdb->pdb_column_path);
+    if (unlink(pdb->pdb_column_path) != 0)
+      err = errno;
+    else
+      err = addb_column_open(pdb->pdb_addb, pdb->pdb_column_path,
+                             PDB_COLUMN_SIZE, horizon, &pdb->pdb_column);
+  }
+  if (err) {
+    cl_leave(pdb->pdb_cl, CL_LEVEL_FAIL, "column initialization failed: %s",
+             strerror(err));
+    return err;
+  }
   cl_leave(pdb->pdb_cl, CL_LEVEL_SPEW, "ok horizon=%llu", horizon);
   return 0;
 }
@@ -520,6 +572,12 @@ int pdb_configure_done(pdb_handle* pdb) {
     pdb->pdb_addb = addb_create(pdb->pdb_cm, pdb->pdb_cl, tile_memory,
                                 pdb->pdb_cf.pcf_transactional);
     if (!pdb->pdb_addb) return ENOMEM;
+
+    addb_set_workers(pdb->pdb_addb, pdb->pdb_cf.pcf_workers);
+    addb_set_parallel_min(pdb->pdb_addb, pdb->pdb_cf.pcf_parallel_min);
+    addb_set_prefetch(pdb->pdb_addb, pdb->pdb_cf.pcf_prefetch);
+    addb_set_redo_log(pdb->pdb_addb, pdb->pdb_cf.pcf_redo_log);
+    addb_set_writeback(pdb->pdb_addb, pdb->pdb_cf.pcf_writeback);
   }
   pdb_check_max_files(pdb);
   return 0;
@@ -529,7 +587,9 @@ int pdb_initialize_checkpoint(pdb_handle* pdb) {
   addb_istore_id const next_id = addb_istore_next_id(pdb->pdb_primitive);
   addb_istore_id const horizon = addb_istore_horizon(pdb->pdb_primitive);
 
-  if (next_id == horizon) return 0;
+  /*  A bulk load catches up in pdb_bulk_finish().
+   */
+  if (next_id == horizon || pdb->pdb_bulk) return 0;
 
   cl_log(
       pdb->pdb_cl, CL_LEVEL_INFO | ADDB_FACILITY_RECOVERY,
@@ -27,6 +27,36 @@ limitations under the License.
  *  count down from it_high - 1 through it_low.
  */
 
+/*  Rough size of a primitive on disk, to turn the read-ahead
+ *  distance into a number of primitives.
+ */
+#define PDB_PRIMITIVE_PREFETCH_SIZE 64
+
+/*  Keep read-ahead pcf_prefetch bytes' worth of primitives in
+ *  front of the cursor; top it up once the cursor has used half
+ *  of it.
+ */
+static void pdb_iterator_all_prefetch(pdb_handle *pdb, pdb_iterator *it) {
+  unsigned long long const dist =
+      pdb->pdb_cf.pcf_prefetch / PDB_PRIMITIVE_PREFETCH_SIZE;
+  addb_istore_id const i = it->it_all_i;
+  addb_istore_id s, e;
+
+  if (dist == 0 || i + dist / 2 < it->it_all_prefetch) return;
+
+  s = i > it->it_all_prefetch ? i : it->it_all_prefetch;
+  e = i + dist < it->it_high ? i + dist : it->it_high;
+  if (s >= e) return;
+
+  if (it->it_forward)
+    addb_istore_prefetch(pdb->pdb_primitive, s, e, i >= it->it_all_prefetch);
+  else
+    addb_istore_prefetch(pdb->pdb_primitive, (it->it_high + it->it_low) - e,
+                         (it->it_high + it->it_low) - s,
+                         i >= it->it_all_prefetch);
+  it->it_all_prefetch = e;
+}
+
 /**
  * @brief access the next primitive in an iteration
  *
@@ -54,6 +84,7 @@ static int pdb_iterator_all_next_loc(pdb_handle *pdb, pdb_iterator *it,
                 (unsigned long long)PDB_COST_FUNCTION_CALL);
     return PDB_ERR_NO;
   }
+  pdb_iterator_all_prefetch(pdb, it);
 
   *id_out = it->it_forward ? it->it_all_i
                            : ((it->it_high + it->it_low) - 1) - it->it_all_i;
@@ -398,6 +429,7 @@ int pdb_iterator_all_create(pdb_handle *pdb, pdb_id low, pdb_id high,
 
   it->it_type = &pdb_iterator_all;
   it->it_all_i = low;
+  it->it_all_prefetch = low;
 
   pdb_iterator_n_set(pdb, it, high - low);
   pdb_iterator_next_cost_set(pdb, it, PDB_COST_FUNCTION_CALL);
@@ -0,0 +1,210 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "libpdb/pdbp.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*  Batched next and check.
+ *
+ *  Iterators that can produce or check many ids at once
+ *  (gmaps, bitmaps, fixed arrays) implement itt_next_batch
+ *  and itt_check_batch themselves.  Everybody else goes
+ *  through the generic adapters in this file, which call
+ *  next or check once per id.
+ *
+ *  Iterators can replace themselves with a different type
+ *  in the middle of a call (pdb_iterator_substitute()); the
+ *  adapters re-dispatch through the type after every call.
+ */
+
+/**
+ * @brief Are these ids sorted in strictly ascending order?
+ *
+ *  Native check_batch implementations that intersect
+ *  use this to decide whether they can.
+ *
+ * @param id	array of ids
+ * @param n	number of ids in the array
+ *
+ * @return true if each id is larger than its predecessor.
+ */
+bool pdb_iterator_batch_is_ascending(pdb_id const *id, size_t n) {
+  size_t i;
+
+  for (i = 1; i < n; i++)
+    if (id[i - 1] >= id[i]) return false;
+  return true;
+}
+
+/**
+ * @brief Fill an id array by calling a next function repeatedly.
+ *
+ *  Native next_batch implementations that don't do anything
+ *  smarter than looping over their own next use this to save
+ *  the dispatch.  If the iterator changes type under us, the
+ *  batch ends early; the caller's next call will dispatch
+ *  to the new type.
+ *
+ * @param pdb		module handle
+ * @param it		iterator
+ * @param next		the iterator's next function
+ * @param id_out	out: the ids
+ * @param m		number of slots in id_out
+ * @param n_out		out: number of ids returned
+ * @param budget_inout	budget to charge
+ *
+ * @return 0, PDB_ERR_NO, PDB_ERR_MORE, or another error,
+ *	as for pdb_iterator_next_batch().
+ */
+int pdb_iterator_next_batch_loop(pdb_handle *pdb, pdb_iterator *it,
+                                 pdb_iterator_next_loc *next, pdb_id *id_out,
+                                 size_t m, size_t *n_out,
+                                 pdb_budget *budget_inout) {
+  pdb_iterator_type const *type = it->it_type;
+  int err;
+
+  cl_assert(pdb->pdb_cl, m > 0);
+  *n_out = 0;
+
+  for (;;) {
+    err = (*next)(pdb, it, id_out + *n_out, budget_inout, __FILE__, __LINE__);
+    if (err != 0) {
+      if (err != PDB_ERR_NO && err != PDB_ERR_MORE) {
+        char buf[200];
+        cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "next", err, "it=%s",
+                     pdb_iterator_to_string(pdb, it, buf, sizeof buf));
+      }
+      return err;
+    }
+    if (++*n_out >= m || *budget_inout <= 0 || it->it_type != type) break;
+  }
+  return 0;
+}
+
+/**
+ * @brief Generic next_batch, for iterators without their own.
+ *
+ * @param pdb		module handle
+ * @param it		iterator
+ * @param id_out	out: the ids
+ * @param m		number of slots in id_out
+ * @param n_out		out: number of ids returned
+ * @param budget_inout	budget to charge
+ *
+ * @return 0, PDB_ERR_NO, PDB_ERR_MORE, or another error,
+ *	as for pdb_iterator_next_batch().
+ */
+int pdb_iterator_next_batch_default(pdb_handle *pdb, pdb_iterator *it,
+                                    pdb_id *id_out, size_t m, size_t *n_out,
+                                    pdb_budget *budget_inout) {
+  int err;
+
+  cl_assert(pdb->pdb_cl, m > 0);
+  *n_out = 0;
+
+  for (;;) {
+    err = pdb_iterator_next(pdb, it, id_out + *n_out, budget_inout);
+    if (err != 0) return err;
+
+    if (++*n_out >= m || *budget_inout <= 0) break;
+  }
+  return 0;
+}
+
+/**
+ * @brief Filter an id array by calling a check function repeatedly.
+ *
+ *  The counterpart to pdb_iterator_next_batch_loop().  If the
+ *  iterator changes type under us, the rest of the batch is
+ *  handed to pdb_iterator_check_batch_default().
+ *
+ * @return 0, PDB_ERR_MORE, or another error,
+ *	as for pdb_iterator_check_batch().
+ */
+int pdb_iterator_check_batch_loop(pdb_handle *pdb, pdb_iterator *it,
+                                  pdb_iterator_check *check,
+                                  pdb_id const *id_in, size_t n_in,
+                                  size_t *n_in_done, pdb_id *id_out,
+                                  size_t *n_out, pdb_budget *budget_inout) {
+  pdb_iterator_type const *type = it->it_type;
+  size_t i;
+  int err;
+
+  *n_out = 0;
+  for (i = 0; i < n_in; i++) {
+    if (it->it_type != type) {
+      size_t rest_done, rest_out;
+
+      err = pdb_iterator_check_batch_default(pdb, it, id_in + i, n_in - i,
+                                             &rest_done, id_out + *n_out,
+                                             &rest_out, budget_inout);
+      *n_in_done = i + rest_done;
+      *n_out += rest_out;
+
+      return err;
+    }
+    if (i > 0 && *budget_inout < 0) break;
+
+    it->it_has_position = false;
+    err = (*check)(pdb, it, id_in[i], budget_inout);
+    if (err == 0)
+      id_out[(*n_out)++] = id_in[i];
+    else if (err != PDB_ERR_NO) {
+      *n_in_done = i;
+      return err;
+    }
+  }
+  *n_in_done = i;
+  return i < n_in ? PDB_ERR_MORE : 0;
+}
+
+/**
+ * @brief Generic check_batch, for iterators without their own.
+ *
+ * @param pdb		module handle
+ * @param it		iterator
+ * @param id_in		ids to check
+ * @param n_in		number of ids in id_in
+ * @param n_in_done	out: number of input ids decided
+ * @param id_out	out: the ids that passed
+ * @param n_out		out: number of ids in id_out
+ * @param budget_inout	budget to charge
+ *
+ * @return 0, PDB_ERR_MORE, or another error,
+ *	as for pdb_iterator_check_batch().
+ */
+int pdb_iterator_check_batch_default(pdb_handle *pdb, pdb_iterator *it,
+                                     pdb_id const *id_in, size_t n_in,
+                                     size_t *n_in_done, pdb_id *id_out,
+                                     size_t *n_out, pdb_budget *budget_inout) {
+  size_t i;
+  int err;
+
+  *n_out = 0;
+  for (i = 0; i < n_in; i++) {
+    if (i > 0 && *budget_inout < 0) break;
+
+    err = pdb_iterator_check(pdb, it, id_in[i], budget_inout);
+    if (err == 0)
+      id_out[(*n_out)++] = id_in[i];
+    else if (err != PDB_ERR_NO) {
+      *n_in_done = i;
+      return err;
+    }
+  }
+  *n_in_done = i;
+  return i < n_in ? PDB_ERR_MORE : 0;
+}
@@ -15,6 +15,61 @@ limitations under the License.
 #include <errno.h>
 #include <string.h>
 
+/*  Count the bits of a bgmap iterator's range at creation time
+ *  if the range spans at most this many ids.  (Counting 64M ids
+ *  reads 8 MB of bitmap.)
+ */
+#define PDB_BGMAP_COUNT_MAX (64ull * 1024 * 1024)
+
+/*  Ids run through the live bitmap at a time by check-batch.
+ */
+#define PDB_BGMAP_LIVE_CHUNK 256
+
+/*
+ *  The bitmap that a live bgmap iterator's ids are ANDed with,
+ *  or NULL.  A write can retire primitives we've promised not
+ *  to skip, so once the database has changed, we stop filtering.
+ */
+static addb_bmap *pdb_iterator_bgmap_mask(pdb_handle *pdb, pdb_iterator *it) {
+  if (!it->it_bgmap_live) return NULL;
+
+  if (it->it_bgmap_live_n != pdb_primitive_n(pdb)) {
+    cl_log(pdb->pdb_cl, CL_LEVEL_DEBUG,
+           "bgmap[%p]: database changed (%llu -> %llu); no longer "
+           "filtering live primitives",
+           (void *)it, it->it_bgmap_live_n, pdb_primitive_n(pdb));
+    it->it_bgmap_live = false;
+    return NULL;
+  }
+  return pdb->pdb_live;
+}
+
+/*
+ *  Keep only those of id[0..n-1] that are set in <mask>.
+ */
+static int pdb_iterator_bgmap_mask_filter(pdb_handle *pdb, addb_bmap *mask,
+                                          pdb_id *id, size_t n,
+                                          size_t *n_out) {
+  pdb_id buf[PDB_BGMAP_LIVE_CHUNK];
+  size_t i, k, n_k;
+  int err;
+
+  *n_out = 0;
+  for (i = 0; i < n; i += k) {
+    k = n - i > PDB_BGMAP_LIVE_CHUNK ? PDB_BGMAP_LIVE_CHUNK : n - i;
+    memcpy(buf, id + i, k * sizeof(*buf));
+
+    err = addb_bmap_fixed_intersect(pdb->pdb_addb, mask, buf, k, id + *n_out,
+                                    &n_k, k);
+    if (err != 0) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_bmap_fixed_intersect",
+                   err, "%zu ids", k);
+      return err;
+    }
+    *n_out += n_k;
+  }
+  return 0;
+}
 
 /*
  *  Be done with a bgmap iterator.  The pointer <it> itself will be
@@ -38,9 +93,10 @@ static void pdb_iterator_bgmap_finish(pdb_handle *pdb, pdb_iterator *it) {
 static const char *pdb_iterator_bgmap_to_string(pdb_handle *pdb,
                                                 pdb_iterator *it, char *buf,
                                                 size_t size) {
-  snprintf(buf, size, "%sbgmap(%llx):%llx..%llx", it->it_forward ? "" : "~",
+  snprintf(buf, size, "%sbgmap(%llx)%s:%llx..%llx", it->it_forward ? "" : "~",
            (unsigned long long)it->it_bgmap_source,
-           (unsigned long long)it->it_low, (unsigned long long)it->it_high);
+           it->it_bgmap_live ? "+live" : "", (unsigned long long)it->it_low,
+           (unsigned long long)it->it_high);
 
   it->it_displayname = cm_strmalcpy(pdb->pdb_cm, buf);
   return buf;
@@ -79,6 +135,13 @@ static int pdb_iterator_bgmap_freeze(pdb_handle *pdb, pdb_iterator *it,
     err = pdb_iterator_freeze_account(pdb, buf, it);
     if (err) return err;
 
+    /*  Thawed, the iterator no longer filters; but it mustn't be
+     *  mistaken for one that never did.
+     */
+    if (it->it_bgmap_live) {
+      err = cm_buffer_add_string(buf, "[live:]");
+      if (err) return err;
+    }
     sep = "/";
   }
   if (flags & PDB_ITERATOR_FREEZE_POSITION) {
@@ -217,6 +280,7 @@ static int pdb_iterator_bgmap_next_loc(pdb_handle *pdb, pdb_iterator *it,
                                        pdb_budget *budget_inout,
                                        const char *file, int line) {
   pdb_budget budget_in = *budget_inout;
+  addb_bmap *const mask = pdb_iterator_bgmap_mask(pdb, it);
   int err;
   addb_gmap_id s;
   bool o;
@@ -275,8 +339,8 @@ static int pdb_iterator_bgmap_next_loc(pdb_handle *pdb, pdb_iterator *it,
 
   *budget_inout -= pdb_iterator_next_cost(pdb, it);
   for (; *budget_inout >= 0; *budget_inout -= 20) {
-    err = addb_bgmap_next(it->it_bgmap_gmap, it->it_bgmap, &s, it->it_low,
-                          it->it_high, it->it_forward);
+    err = addb_bgmap_next_masked(it->it_bgmap_gmap, it->it_bgmap, mask, &s,
+                                 it->it_low, it->it_high, it->it_forward);
 
     cl_log(pdb->pdb_cl, CL_LEVEL_VERBOSE,
            "bgmap_next[%p][%s:%i]: %llx->%llx [%s] ($%lld)", it, file, line,
@@ -360,6 +424,7 @@ err:
 static int pdb_iterator_bgmap_check(pdb_handle *pdb, pdb_iterator *it,
                                     pdb_id id, pdb_budget *budget_inout) {
   pdb_budget budget_in = *budget_inout;
+  addb_bmap *mask;
   bool o;
   int err = 0;
 
@@ -382,6 +447,14 @@ static int pdb_iterator_bgmap_check(pdb_handle *pdb, pdb_iterator *it,
                  (long long)pdb_iterator_check_cost(pdb, it));
     goto err;
   }
+  if (o && (mask = pdb_iterator_bgmap_mask(pdb, it)) != NULL) {
+    err = addb_bmap_check(mask, id, &o);
+    if (err) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_bmap_check", err,
+                   "live bitmap: %llx", (unsigned long long)id);
+      goto err;
+    }
+  }
 
   pdb_rxs_log(pdb, "CHECK %p bgmap %llx %s ($%lld)", (void *)it,
               (unsigned long long)id, o ? "yes" : "no",
@@ -394,6 +467,145 @@ err:
   return err;
 }
 
+/*
+ * Return up to m ids from a bgmap.
+ *
+ * Going forward from a known position, this just keeps calling
+ * addb_bgmap_next; everything else goes through the single-id
+ * next function.
+ */
+static int pdb_iterator_bgmap_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                                         pdb_id *id_out, size_t m,
+                                         size_t *n_out,
+                                         pdb_budget *budget_inout) {
+  pdb_budget budget_in = *budget_inout;
+  addb_bmap *mask;
+  addb_gmap_id s;
+  int err = 0;
+
+  if (!it->it_forward || it->it_bgmap_need_recover)
+    return pdb_iterator_next_batch_loop(pdb, it, pdb_iterator_bgmap_next_loc,
+                                        id_out, m, n_out, budget_inout);
+
+  cl_assert(pdb->pdb_cl, it->it_high < PDB_ITERATOR_HIGH_ANY);
+  cl_assert(pdb->pdb_cl, it->it_has_position);
+
+  *n_out = 0;
+  s = it->it_bgmap_offset;
+  mask = pdb_iterator_bgmap_mask(pdb, it);
+
+  while (*n_out < m) {
+    if (*n_out > 0 && *budget_inout <= 0) break;
+
+    *budget_inout -= pdb_iterator_next_cost(pdb, it);
+    for (;;) {
+      err = addb_bgmap_next_masked(it->it_bgmap_gmap, it->it_bgmap, mask, &s,
+                                   it->it_low, it->it_high, true);
+      it->it_bgmap_offset = s;
+      if (err != ADDB_ERR_MORE) break;
+
+      if (*budget_inout < 0) {
+        /*  Out of budget in the middle of a gap.  If we
+         *  have ids, hand them back; the next call resumes
+         *  at it_bgmap_offset.
+         */
+        pdb_rxs_log(pdb, "NEXT-BATCH %p bgmap suspend (%zu) ($%lld)",
+                    (void *)it, *n_out, (long long)(budget_in - *budget_inout));
+        err = *n_out > 0 ? 0 : PDB_ERR_MORE;
+        goto err;
+      }
+      *budget_inout -= 20;
+    }
+    if (err != 0) {
+      if (err != ADDB_ERR_NO)
+        cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_bgmap_next", err,
+                     "unexpected error");
+      goto err;
+    }
+
+    id_out[(*n_out)++] = s++;
+    it->it_bgmap_offset = s;
+    if (s > it->it_high) {
+      err = PDB_ERR_NO;
+      goto err;
+    }
+  }
+
+err:
+  pdb_rxs_log(pdb, "NEXT-BATCH %p bgmap %zu%s ($%lld)", (void *)it, *n_out,
+              err == PDB_ERR_NO ? " done" : "",
+              (long long)(budget_in - *budget_inout));
+  pdb_iterator_account_charge(pdb, it, next, *n_out > 0 ? *n_out : 1,
+                              budget_in - *budget_inout);
+  return err;
+}
+
+/*
+ * Check an array of ids against a bgmap.
+ */
+static int pdb_iterator_bgmap_check_batch(pdb_handle *pdb, pdb_iterator *it,
+                                          pdb_id const *id_in, size_t n_in,
+                                          size_t *n_in_done, pdb_id *id_out,
+                                          size_t *n_out,
+                                          pdb_budget *budget_inout) {
+  pdb_budget budget_in = *budget_inout;
+  pdb_budget const cost = pdb_iterator_check_cost(pdb, it);
+  addb_bmap *mask;
+  size_t i, j, n;
+  int err = 0;
+
+  /*  Take as many ids as the budget allows (at least one),
+   *  and test them against the bitmap in one go.
+   */
+  i = n_in;
+  if (cost > 0 && n_in > 0) {
+    if (*budget_inout < 0)
+      i = 1;
+    else if ((unsigned long long)*budget_inout / cost + 1 < n_in)
+      i = *budget_inout / cost + 1;
+  }
+  *budget_inout -= cost * (pdb_budget)i;
+  if (i < n_in) err = PDB_ERR_MORE;
+
+  *n_out = 0;
+  if (i > 0) {
+    int e;
+
+    e = addb_bgmap_fixed_intersect(pdb->pdb_addb, it->it_bgmap, id_in, i,
+                                   id_out, &n, i);
+    if (e != 0) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_bgmap_fixed_intersect", e,
+                   "%s[%llx]: %zu ids", addb_bgmap_name(it->it_bgmap),
+                   (unsigned long long)it->it_bgmap_source, i);
+      *n_in_done = 0;
+      return e;
+    }
+
+    /*  Drop what's outside our range.
+     */
+    for (j = 0; j < n; j++)
+      if (id_out[j] < it->it_high && id_out[j] >= it->it_low)
+        id_out[(*n_out)++] = id_out[j];
+
+    /*  ... or not live, if we're filtering.
+     */
+    if ((mask = pdb_iterator_bgmap_mask(pdb, it)) != NULL && *n_out > 0) {
+      e = pdb_iterator_bgmap_mask_filter(pdb, mask, id_out, *n_out, n_out);
+      if (e != 0) {
+        *n_in_done = 0;
+        return e;
+      }
+    }
+  }
+  *n_in_done = i;
+
+  pdb_rxs_log(pdb, "CHECK-BATCH %p bgmap %zu/%zu -> %zu ($%lld)", (void *)it,
+              *n_in_done, n_in, *n_out, (long long)(budget_in - *budget_inout));
+  pdb_iterator_account_charge(pdb, it, check, i > 0 ? i : 1,
+                              budget_in - *budget_inout);
+  return err;
+}
+
 /*
  * Find the first bit set on or after id_in
  */
@@ -705,7 +917,10 @@ static const pdb_iterator_type pdb_iterator_bgmap = {
     pdb_iterator_bgmap_restrict,
 
     pdb_iterator_bgmap_suspend,
-    pdb_iterator_bgmap_unsuspend};
+    pdb_iterator_bgmap_unsuspend,
+
+    pdb_iterator_bgmap_next_batch,
+    pdb_iterator_bgmap_check_batch};
 
 /*
  * This is the bgmap analogy to pdb_iterator_gmap_is_instance
@@ -916,6 +1131,17 @@ int pdb_iterator_bgmap_create(pdb_handle *pdb, addb_gmap *gm, pdb_id source,
   cl_assert(cl, total_n > 0);
   if (guess_n > total_n) guess_n = total_n;
 
+  /*  If the range doesn't obviously cover everything, and isn't
+   *  too large to be worth it, count the bits in it.
+   */
+  if (guess_n < total_n && adjhigh - adjlow <= PDB_BGMAP_COUNT_MAX) {
+    unsigned long long n;
+
+    err = addb_bgmap_count_range(gm, bgm, adjlow, adjhigh, &n);
+    if (err != 0) return err;
+    if (n > 0 && n < guess_n) guess_n = n;
+  }
+
   cl_assert(cl, guess_n > 0);
 
   *it_out = it = cm_malloc(pdb->pdb_cm, sizeof *it);
@@ -931,6 +1157,7 @@ int pdb_iterator_bgmap_create(pdb_handle *pdb, addb_gmap *gm, pdb_id source,
   it->it_forward = forward;
   it->it_bgmap_need_recover = false;
   it->it_bgmap_linkage = linkage;
+  it->it_bgmap_live = false;
 
   if (forward)
     it->it_bgmap_offset = adjlow;
@@ -982,6 +1209,7 @@ int pdb_iterator_bgmap_idarray_intersect(pdb_handle *pdb, pdb_iterator *bgmap,
   pdb_id id;
   unsigned long long ida_offset = 0;
   unsigned long long ida_max;
+  addb_bmap *const mask = pdb_iterator_bgmap_mask(pdb, bgmap);
 
   int err;
   char s2[200];
@@ -1029,6 +1257,7 @@ int pdb_iterator_bgmap_idarray_intersect(pdb_handle *pdb, pdb_iterator *bgmap,
     }
 
     err = addb_bgmap_check(bgmap->it_bgmap_gmap, bgmap->it_bgmap, id, &bit);
+    if (err == 0 && bit && mask != NULL) err = addb_bmap_check(mask, id, &bit);
     if (err == 0) {
       if (bit) {
         if (*id_n >= id_m) {
@@ -1072,8 +1301,62 @@ int pdb_iterator_bgmap_fixed_intersect(pdb_handle *pdb, pdb_iterator *it,
                                        pdb_id const *id_in, size_t n_in,
                                        pdb_id *id_out, size_t *n_out,
                                        size_t id_m) {
+  addb_bmap *mask;
+  int err, e2;
+
   if (it->it_type != &pdb_iterator_bgmap) return PDB_ERR_NOT_SUPPORTED;
 
-  return addb_bgmap_fixed_intersect(pdb->pdb_addb, it->it_bgmap, id_in, n_in,
-                                    id_out, n_out, id_m);
+  err = addb_bgmap_fixed_intersect(pdb->pdb_addb, it->it_bgmap, id_in, n_in,
+                                   id_out, n_out, id_m);
+  if ((err == 0 || err == PDB_ERR_MORE) &&
+      (mask = pdb_iterator_bgmap_mask(pdb, it)) != NULL) {
+    e2 = pdb_iterator_bgmap_mask_filter(pdb, mask, id_out, *n_out, n_out);
+    if (e2 != 0) return e2;
+  }
+  return err;
+}
+
+/**
+ * @brief Restrict a bgmap iterator to live primitives.
+ *
+ *  The caller promises to discard primitives that are deleted or
+ *  have a newer version anyway; the iterator can then skip them
+ *  a bitmap word at a time, by ANDing its bitmap with the live
+ *  bitmap.  If the range is small enough to count, its size estimate
+ *  becomes the number of live primitives in it.
+ *
+ *  The restriction lasts only as long as nothing is written to
+ *  the database, and doesn't survive a freeze and thaw.
+ *
+ * @param pdb		module handle
+ * @param it		an iterator
+ *
+ * @return true if the iterator is a bgmap and now filters,
+ *	false otherwise.
+ */
+bool pdb_iterator_bgmap_live_set(pdb_handle *pdb, pdb_iterator *it) {
+  if (it == NULL || it->it_type != &pdb_iterator_bgmap ||
+      it->it_original != it || pdb->pdb_live == NULL)
+    return false;
+
+  it->it_bgmap_live = true;
+  it->it_bgmap_live_n = pdb_primitive_n(pdb);
+
+  if (pdb_iterator_n_valid(pdb, it) &&
+      it->it_high - it->it_low <= PDB_BGMAP_COUNT_MAX) {
+    unsigned long long n;
+    int err;
+
+    err = pdb_linkage_count_live(pdb, it->it_bgmap_linkage,
+                                 it->it_bgmap_source, it->it_low, it->it_high,
+                                 pdb_iterator_n(pdb, it), &n);
+    if (err == 0 && n > 0 && n < pdb_iterator_n(pdb, it))
+      pdb_iterator_n_set(pdb, it, n);
+  }
+
+  if (it->it_displayname != NULL) {
+    cm_free(pdb->pdb_cm, it->it_displayname);
+    it->it_displayname = NULL;
+  }
+  return true;
 }
@@ -54,6 +54,37 @@ limitations under the License.
 
 #define gmap_ida(it) (it->it_original->it_gmap_ida)
 
+/*  Size of an element of an on-disk gmap array, in bytes.
+ */
+#define PDB_GMAP_ENTRY_SIZE 5
+
+/*  Keep read-ahead pcf_prefetch bytes in front of the cursor;
+ *  top it up once the cursor has used half of it.
+ */
+static void pdb_iterator_gmap_prefetch(pdb_handle *pdb, pdb_iterator *it) {
+  unsigned long long const dist =
+      pdb->pdb_cf.pcf_prefetch / PDB_GMAP_ENTRY_SIZE;
+  unsigned long long const off = it->it_gmap_offset;
+  unsigned long long s, e;
+
+  if (dist == 0 || off + dist / 2 < it->it_gmap_prefetch) return;
+
+  s = off > it->it_gmap_prefetch ? off : it->it_gmap_prefetch;
+  e = off + dist < pdb_iterator_n(pdb, it) ? off + dist
+                                            : pdb_iterator_n(pdb, it);
+  if (s >= e) return;
+
+  if (pdb_iterator_forward(pdb, it))
+    addb_idarray_prefetch(&gmap_ida(it), OFFSET_PDB_TO_IDARRAY(pdb, it, s),
+                          OFFSET_PDB_TO_IDARRAY(pdb, it, e - 1) + 1,
+                          off >= it->it_gmap_prefetch);
+  else
+    addb_idarray_prefetch(&gmap_ida(it), OFFSET_PDB_TO_IDARRAY(pdb, it, e - 1),
+                          OFFSET_PDB_TO_IDARRAY(pdb, it, s) + 1,
+                          off >= it->it_gmap_prefetch);
+  it->it_gmap_prefetch = e;
+}
+
 /*  Translate a name (like "left") to a GMAP pointer.
  */
 addb_gmap *pdb_gmap_by_name(pdb_handle *pdb, char const *s, char const *e) {
@@ -123,6 +154,7 @@ static int pdb_iterator_gmap_next_loc(pdb_handle *pdb, pdb_iterator *it,
                 (long long)(PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT));
     return PDB_ERR_NO;
   }
+  pdb_iterator_gmap_prefetch(pdb, it);
 
   off = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_gmap_offset);
   err = addb_idarray_read1(&gmap_ida(it), off, &id);
@@ -503,26 +535,13 @@ static int pdb_iterator_gmap_check(pdb_handle *pdb, pdb_iterator *it, pdb_id id,
                               pdb_iterator_check_cost(pdb, it));
 
   if (pdb_iterator_check_cost(pdb, it) > PDB_COST_PRIMITIVE) {
-    pdb_primitive pr;
-
-    err = pdb_id_read(pdb, id, &pr);
+    err = pdb_column_linkage(pdb, id, it->it_gmap_linkage, &found_id);
     if (err != 0) {
-      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_id_read", err, "id=%llx",
+      cl_log_errno(cl, CL_LEVEL_FAIL, "pdb_column_linkage", err, "id=%llx",
                    (unsigned long long)id);
       return err;
     }
-
-    if (!pdb_primitive_has_linkage(&pr, it->it_gmap_linkage))
-      err = PDB_ERR_NO;
-    else {
-      graph_guid guid;
-
-      pdb_primitive_linkage_get(&pr, it->it_gmap_linkage, guid);
-      err = pdb_id_from_guid(pdb, &found_id, &guid);
-      if (err == 0) err = found_id == it->it_gmap_source ? 0 : PDB_ERR_NO;
-    }
-    pdb_primitive_finish(pdb, &pr);
-    cl_assert(pdb->pdb_cl, err != PDB_ERR_MORE);
+    err = found_id == it->it_gmap_source ? 0 : PDB_ERR_NO;
     goto have_result;
   } else {
     cl_assert(pdb->pdb_cl, id < (1ull << 34));
@@ -553,6 +572,156 @@ have_result:
   return err;
 }
 
+/**
+ * @brief Return up to m ids from a GMAP iterator.
+ *
+ *  Copies a run of the idarray straight into the caller's
+ *  buffer.  The budget and account are charged as if
+ *  pdb_iterator_next() had been called once per id.
+ *
+ * @param pdb		opaque module handle, created with pdb_create()
+ * @param it		iteration to step through
+ * @param id_out	out: ids
+ * @param m		number of slots in id_out
+ * @param n_out		out: number of ids returned
+ * @param budget_inout	decrement this budget
+ *
+ * @return 0, PDB_ERR_NO, or a nonzero error code,
+ *	as for pdb_iterator_next_batch().
+ */
+static int pdb_iterator_gmap_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                                        pdb_id *id_out, size_t m,
+                                        size_t *n_out,
+                                        pdb_budget *budget_inout) {
+  unsigned long long n, s, e, end;
+  pdb_budget cost;
+  int err;
+
+  PDB_IS_ITERATOR(pdb->pdb_cl, it);
+  cl_assert(pdb->pdb_cl, it->it_gmap != NULL);
+  cl_assert(pdb->pdb_cl, m > 0);
+
+  *n_out = 0;
+  if (it->it_gmap_offset >= pdb_iterator_n(pdb, it)) {
+    *budget_inout -= PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT;
+    pdb_iterator_account_charge(pdb, it, next, 1,
+                                PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT);
+    pdb_rxs_log(pdb, "NEXT-BATCH %p gmap done", (void *)it);
+    return PDB_ERR_NO;
+  }
+
+  /*  Don't go much further than the budget would have
+   *  taken single calls to next.
+   */
+  n = pdb_iterator_n(pdb, it) - it->it_gmap_offset;
+  if (n > m) n = m;
+  if (*budget_inout > 0 &&
+      n > 1 + *budget_inout / (PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT))
+    n = 1 + *budget_inout / (PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT);
+  pdb_iterator_gmap_prefetch(pdb, it);
+
+  if (pdb_iterator_forward(pdb, it)) {
+    s = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_gmap_offset);
+    e = s + n;
+  } else {
+    s = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_gmap_offset + n - 1);
+    e = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_gmap_offset) + 1;
+  }
+
+  err = addb_idarray_read(&gmap_ida(it), s, e, id_out, &end);
+  if (err != 0) {
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_idarray_read", err,
+                 "%s(%llx) [%llu..%llu]",
+                 pdb_linkage_to_string(it->it_gmap_linkage),
+                 (unsigned long long)it->it_gmap_source, s, e - 1);
+    return err;
+  }
+  cl_assert(pdb->pdb_cl, end == e);
+
+  if (!pdb_iterator_forward(pdb, it)) {
+    pdb_id *lo = id_out, *hi = id_out + n - 1;
+
+    for (; lo < hi; lo++, hi--) {
+      pdb_id tmp = *lo;
+      *lo = *hi;
+      *hi = tmp;
+    }
+  }
+
+  cost = n * (PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT);
+  *budget_inout -= cost;
+  pdb_iterator_account_charge(pdb, it, next, n, cost);
+
+  it->it_gmap_offset += n;
+  *n_out = n;
+
+  pdb_rxs_log(pdb, "NEXT-BATCH %p gmap %llx..%llx (%zu) ($%lld)", (void *)it,
+              (unsigned long long)id_out[0], (unsigned long long)id_out[n - 1],
+              *n_out, (long long)cost);
+
+  return it->it_gmap_offset >= pdb_iterator_n(pdb, it) ? PDB_ERR_NO : 0;
+}
+
+/**
+ * @brief Check an array of ids against a GMAP iterator.
+ *
+ *  If the ids are sorted and the iterator checks against
+ *  its idarray (rather than by reading primitives), this is
+ *  a single idarray intersection.
+ *
+ * @return 0, PDB_ERR_MORE, or a nonzero error code,
+ *	as for pdb_iterator_check_batch().
+ */
+static int pdb_iterator_gmap_check_batch(pdb_handle *pdb, pdb_iterator *it,
+                                         pdb_id const *id_in, size_t n_in,
+                                         size_t *n_in_done, pdb_id *id_out,
+                                         size_t *n_out,
+                                         pdb_budget *budget_inout) {
+  pdb_id const *s = id_in, *e = id_in + n_in;
+  double a_n, b_n;
+  pdb_budget cost;
+  int err;
+
+  if (n_in < 2 ||
+      pdb_iterator_check_cost(pdb, it) > PDB_COST_PRIMITIVE ||
+      !pdb_iterator_batch_is_ascending(id_in, n_in))
+    return pdb_iterator_check_batch_loop(pdb, it, pdb_iterator_gmap_check,
+                                         id_in, n_in, n_in_done, id_out, n_out,
+                                         budget_inout);
+
+  /*  Clip the input to the iterator's boundaries.
+   */
+  while (s < e && *s < it->it_low) s++;
+  while (e > s && e[-1] >= it->it_high) e--;
+
+  a_n = it->it_gmap_end - it->it_gmap_start;
+  b_n = e - s;
+  cost = PDB_COST_FUNCTION_CALL +
+         (b_n <= 0 || a_n <= 0 ? 0 : (a_n > b_n) ? b_n * log(a_n)
+                                                 : a_n * log(b_n));
+  *budget_inout -= cost;
+  pdb_iterator_account_charge(pdb, it, check, n_in, cost);
+
+  *n_out = 0;
+  *n_in_done = n_in;
+  if (s >= e || a_n <= 0) return 0;
+
+  err = addb_idarray_fixed_intersect(pdb->pdb_addb, &gmap_ida(it),
+                                     it->it_gmap_start, it->it_gmap_end,
+                                     (addb_id *)s, e - s, id_out, n_out, n_in);
+  if (err != 0) {
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_idarray_fixed_intersect",
+                 err, "%s(%llx) vs. %zu ids",
+                 pdb_linkage_to_string(it->it_gmap_linkage),
+                 (unsigned long long)it->it_gmap_source, (size_t)(e - s));
+    *n_in_done = 0;
+    return err;
+  }
+  pdb_rxs_log(pdb, "CHECK-BATCH %p gmap %zu -> %zu ($%lld)", (void *)it, n_in,
+              *n_out, (long long)cost);
+  return 0;
+}
+
 /**
  * @brief Return the idarray for a GMAP iterator.
  *
@@ -850,7 +1019,10 @@ static const pdb_iterator_type pdb_iterator_gmap = {
     pdb_iterator_gmap_restrict,
 
     pdb_iterator_gmap_suspend,
-    pdb_iterator_gmap_unsuspend};
+    pdb_iterator_gmap_unsuspend,
+
+    pdb_iterator_gmap_next_batch,
+    pdb_iterator_gmap_check_batch};
 
 /**
  * @brief initialize a GMAP iterator.
@@ -1086,6 +1258,7 @@ int pdb_iterator_gmap_create(pdb_handle *pdb, addb_gmap *gmap, int linkage,
   it->it_gmap_start = start;
   it->it_gmap_linkage = linkage;
   it->it_gmap_cached_check_id = PDB_ID_NONE;
+  it->it_gmap_prefetch = 0;
 
   cl_assert(pdb->pdb_cl, start < end);
 
@@ -450,6 +450,130 @@ static int pdb_iterator_hmap_check(pdb_handle *pdb, pdb_iterator *it, pdb_id id,
   return err;
 }
 
+/**
+ * @brief Return up to m ids from an HMAP iterator.
+ *
+ *  Like pdb_iterator_gmap_next_batch(), copies a run of
+ *  the idarray into the caller's buffer.
+ */
+static int pdb_iterator_hmap_next_batch(pdb_handle *pdb, pdb_iterator *it,
+                                        pdb_id *id_out, size_t m,
+                                        size_t *n_out,
+                                        pdb_budget *budget_inout) {
+  unsigned long long n, s, e, end;
+  pdb_budget cost;
+  int err;
+
+  PDB_IS_ITERATOR(pdb->pdb_cl, it);
+  cl_assert(pdb->pdb_cl, it->it_hmap != NULL);
+  cl_assert(pdb->pdb_cl, m > 0);
+
+  *n_out = 0;
+  if (it->it_hmap_offset >= pdb_iterator_n(pdb, it)) {
+    *budget_inout -= PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT;
+    pdb_iterator_account_charge(pdb, it, next, 1,
+                                PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT);
+    pdb_rxs_log(pdb, "NEXT-BATCH %p hmap done", (void *)it);
+    return PDB_ERR_NO;
+  }
+
+  n = pdb_iterator_n(pdb, it) - it->it_hmap_offset;
+  if (n > m) n = m;
+  if (*budget_inout > 0 &&
+      n > 1 + *budget_inout / (PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT))
+    n = 1 + *budget_inout / (PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT);
+
+  if (pdb_iterator_forward(pdb, it)) {
+    s = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_hmap_offset);
+    e = s + n;
+  } else {
+    s = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_hmap_offset + n - 1);
+    e = OFFSET_PDB_TO_IDARRAY(pdb, it, it->it_hmap_offset) + 1;
+  }
+
+  cl_assert(pdb->pdb_cl, !it->it_suspended);
+  err = addb_idarray_read(&hmap_ida(it), s, e, id_out, &end);
+  if (err != 0) {
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_idarray_read", err,
+                 "[%llu..%llu]", s, e - 1);
+    return err;
+  }
+  cl_assert(pdb->pdb_cl, end == e);
+
+  if (!pdb_iterator_forward(pdb, it)) {
+    pdb_id *lo = id_out, *hi = id_out + n - 1;
+
+    for (; lo < hi; lo++, hi--) {
+      pdb_id tmp = *lo;
+      *lo = *hi;
+      *hi = tmp;
+    }
+  }
+
+  cost = n * (PDB_COST_FUNCTION_CALL + PDB_COST_GMAP_ELEMENT);
+  *budget_inout -= cost;
+  pdb_iterator_account_charge(pdb, it, next, n, cost);
+
+  it->it_hmap_offset += n;
+  *n_out = n;
+
+  pdb_rxs_log(pdb, "NEXT-BATCH %p hmap %llx..%llx (%zu) ($%lld)", (void *)it,
+              (unsigned long long)id_out[0], (unsigned long long)id_out[n - 1],
+              *n_out, (long long)cost);
+
+  return it->it_hmap_offset >= pdb_iterator_n(pdb, it) ? PDB_ERR_NO : 0;
+}
+
+/**
+ * @brief Check an array of ids against an HMAP iterator.
+ *
+ *  Sorted input is intersected with the idarray in one go.
+ */
+static int pdb_iterator_hmap_check_batch(pdb_handle *pdb, pdb_iterator *it,
+                                         pdb_id const *id_in, size_t n_in,
+                                         size_t *n_in_done, pdb_id *id_out,
+                                         size_t *n_out,
+                                         pdb_budget *budget_inout) {
+  pdb_id const *s = id_in, *e = id_in + n_in;
+  double a_n, b_n;
+  pdb_budget cost;
+  int err;
+
+  if (n_in < 2 || !pdb_iterator_batch_is_ascending(id_in, n_in))
+    return pdb_iterator_check_batch_loop(pdb, it, pdb_iterator_hmap_check,
+                                         id_in, n_in, n_in_done, id_out, n_out,
+                                         budget_inout);
+
+  while (s < e && *s < it->it_low) s++;
+  while (e > s && e[-1] >= it->it_high) e--;
+
+  a_n = it->it_hmap_end - it->it_hmap_start;
+  b_n = e - s;
+  cost = PDB_COST_FUNCTION_CALL +
+         (b_n <= 0 || a_n <= 0 ? 0 : (a_n > b_n) ? b_n * log(a_n)
+                                                 : a_n * log(b_n));
+  *budget_inout -= cost;
+  pdb_iterator_account_charge(pdb, it, check, n_in, cost);
+
+  *n_out = 0;
+  *n_in_done = n_in;
+  if (s >= e || a_n <= 0) return 0;
+
+  cl_assert(pdb->pdb_cl, !it->it_original->it_suspended);
+  err = addb_idarray_fixed_intersect(pdb->pdb_addb, &hmap_ida(it),
+                                     it->it_hmap_start, it->it_hmap_end,
+                                     (addb_id *)s, e - s, id_out, n_out, n_in);
+  if (err != 0) {
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "addb_idarray_fixed_intersect",
+                 err, "vs. %zu ids", (size_t)(e - s));
+    *n_in_done = 0;
+    return err;
+  }
+  pdb_rxs_log(pdb, "CHECK-BATCH %p hmap %zu -> %zu ($%lld)", (void *)it, n_in,
+              *n_out, (long long)cost);
+  return 0;
+}
+
 /**
  * @brief Return the idarray for an HMAP iterator.
  *
@@ -680,7 +804,10 @@ const pdb_iterator_type pdb_iterator_hmap = {
     /* restrict */ NULL,
 
     pdb_iterator_hmap_suspend,
-    pdb_iterator_hmap_unsuspend};
+    pdb_iterator_hmap_unsuspend,
+
+    pdb_iterator_hmap_next_batch,
+    pdb_iterator_hmap_check_batch};
 
 /*
  * @brief Create an iterator over the values in an hmap entry.
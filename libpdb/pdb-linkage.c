@@ -111,6 +111,41 @@ int pdb_linkage_count_est(pdb_handle* pdb, int linkage, pdb_id source,
   return err;
 }
 
+/**
+ * @brief How many live primitives link to this node?
+ *
+ *  Like pdb_linkage_count(), but only counts primitives that are
+ *  the newest of their lineage and not deleted.
+ *
+ * @param pdb 		opaque database pointer, creatd with pdb_create()
+ * @param linkage	which of the four linkage databases are we
+ *			talking about?
+ * @param source 	the local ID used to index it
+ * @param low	 	start counting at this value
+ * @param high	 	stop counting at this value
+ * @param upper_bound	if more than this many, stop counting.
+ * @param n_out		the number of live links, or upper_bound
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_linkage_count_live(pdb_handle* pdb, int linkage, pdb_id source,
+                           pdb_id low, pdb_id high,
+                           unsigned long long upper_bound,
+                           unsigned long long* n_out) {
+  addb_gmap* const gm = pdb_linkage_to_gmap(pdb, linkage);
+  int err;
+
+  cl_assert(pdb->pdb_cl, gm);
+
+  err = pdb_count_gmap_live(pdb, gm, source, low, high, upper_bound, n_out);
+  if (err)
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_FAIL, "pdb_count_gmap_live", err,
+                 "Can't count live %s:%llx (%llx-%llx)",
+                 pdb_linkage_to_string(linkage), (unsigned long long)source,
+                 (unsigned long long)low, (unsigned long long)high);
+  return err;
+}
+
 /**
  * @brief How many links emerge from this node
  *
@@ -97,6 +97,10 @@ int pdb_refresh(pdb_handle* pdb) {
                    (unsigned long long)new_pdb_n);
       goto err;
     }
+
+    /*  Reopening replaced the istore we started with.
+     */
+    is = pdb->pdb_primitive;
   }
 
   err = addb_istore_refresh(is, new_pdb_n);
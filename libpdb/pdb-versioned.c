@@ -14,9 +14,18 @@ limitations under the License.
 #include "libpdb/pdbp.h"
 
 #include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #include "libaddb/addb-bmap.h"
 
+/*  Besides the "versioned" bitmap of primitives that have a newer
+ *  version, we keep a "live" bitmap of primitives that are the newest
+ *  of their lineage and not deleted -- the ones a read matches by
+ *  default.  Iterators can AND against it a word at a time instead
+ *  of testing candidates one by one.
+ */
+
 int pdb_is_versioned(pdb_handle* pdb, pdb_id id, bool* result) {
   int err;
 
@@ -32,6 +41,19 @@ int pdb_versioned_synchronize(pdb_handle* pdb, pdb_id id,
   addb_idarray ida;
   int err;
 
+  /*  A new primitive is the newest of its lineage; it is live
+   *  unless it is the deletion of a previous version.
+   */
+  if (pdb_primitive_is_live(pr)) {
+    err = addb_bmap_set(pdb->pdb_live, id);
+    if (err) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "addb_bmap_set", err,
+                   "pdb_versioned_synchronize: can't mark %llx as live",
+                   (unsigned long long)id);
+      return err;
+    }
+  }
+
   if (pdb_primitive_has_generation(pr)) {
     lineage = pdb_primitive_lineage_get(pr);
 
@@ -103,7 +125,110 @@ int pdb_versioned_synchronize(pdb_handle* pdb, pdb_id id,
       return err;
     }
 
+    err = addb_bmap_clear(pdb->pdb_live, last);
+    if (err) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "addb_bmap_clear", err,
+                   "pdb_versioned_synchronize: can't mark %llx"
+                   " as no longer live",
+                   (unsigned long long)last);
+      return err;
+    }
     return 0;
   }
   return 0;
 }
+
+/**
+ * @brief Build the live bitmap of an existing database.
+ *
+ *  Databases written before there was a live bitmap get one
+ *  when they're first opened.  It is built under a temporary
+ *  name, flushed, and renamed into place, so that a crash
+ *  halfway through leaves no partial bitmap behind.
+ *
+ * @param pdb		opaque pdb module handle
+ * @param horizon	horizon of the indices
+ *
+ * @return 0 on success, a nonzero error code on error.
+ */
+int pdb_live_rebuild(pdb_handle* pdb, unsigned long long horizon) {
+  addb_istore_id const next_id = addb_istore_next_id(pdb->pdb_primitive);
+  unsigned long long n = 0;
+  addb_bmap* bm;
+  char* tmp;
+  pdb_id id;
+  int err, e2;
+
+  tmp = cm_sprintf(pdb->pdb_cm, "%s.tmp", pdb->pdb_live_path);
+  if (tmp == NULL) return ENOMEM;
+  (void)unlink(tmp);
+
+  cl_log(pdb->pdb_cl, CL_LEVEL_INFO,
+         "pdb_live_rebuild: building %s for %llu primitives",
+         pdb->pdb_live_path, (unsigned long long)next_id);
+
+  /*  Bits are set in ascending order, and nothing needs to be
+   *  rolled back; the temporary bitmap needs no backup.
+   */
+  err = addb_bmap_open(pdb->pdb_addb, tmp, 0, horizon, true, &bm);
+  if (err) {
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "addb_bmap_open", err, "%s",
+                 tmp);
+    cm_free(pdb->pdb_cm, tmp);
+    return err;
+  }
+
+  for (id = 0; id < next_id; id++) {
+    pdb_primitive pr;
+    bool live, versioned;
+
+    err = pdb_id_read(pdb, id, &pr);
+    if (err == PDB_ERR_NO) {
+      err = 0;
+      continue;
+    }
+    if (err) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "pdb_id_read", err, "id=%llx",
+                   (unsigned long long)id);
+      break;
+    }
+    live = pdb_primitive_is_live(&pr);
+    pdb_primitive_finish(pdb, &pr);
+    if (!live) continue;
+
+    err = addb_bmap_check(pdb->pdb_versioned, id, &versioned);
+    if (err == 0 && !versioned) {
+      err = addb_bmap_set(bm, id);
+      n++;
+    }
+    if (err) {
+      cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "addb_bmap_set", err,
+                   "id=%llx", (unsigned long long)id);
+      break;
+    }
+  }
+
+  if (err == 0)
+    err = addb_bmap_checkpoint(bm, true, true,
+                               addb_tiled_checkpoint_start_writes);
+  if (err == 0)
+    err = addb_bmap_checkpoint(bm, true, true,
+                               addb_tiled_checkpoint_finish_writes);
+
+  e2 = addb_bmap_close(bm);
+  if (err == 0) err = e2;
+
+  if (err == 0 && rename(tmp, pdb->pdb_live_path) != 0) {
+    err = errno;
+    cl_log_errno(pdb->pdb_cl, CL_LEVEL_ERROR, "rename", err, "%s -> %s", tmp,
+                 pdb->pdb_live_path);
+  }
+  if (err != 0) (void)unlink(tmp);
+  cm_free(pdb->pdb_cm, tmp);
+
+  if (err == 0)
+    cl_log(pdb->pdb_cl, CL_LEVEL_INFO,
+           "pdb_live_rebuild: %llu of %llu primitives are live", n,
+           (unsigned long long)next_id);
+  return err;
+}
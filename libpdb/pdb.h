@@ -102,7 +102,9 @@ typedef struct pdb_iterator_base pdb_iterator_base;
 #define PDB_INDEX_HMAP 4
 #define PDB_INDEX_PREFIX 5
 #define PDB_INDEX_DEAD 6
-#define PDB_INDEX_N 7
+#define PDB_INDEX_COLUMN 7
+#define PDB_INDEX_LIVE 8
+#define PDB_INDEX_N 9
 
 #define PDB_VERIFY_TYPEGUID 1
 #define PDB_VERIFY_LEFT 2
@@ -187,6 +189,33 @@ typedef struct pdb_configuration {
    */
   long long pcf_total_memory;
 
+  /* How many threads may help with large index intersections,
+   * besides the one running the request?  0 means none.
+   */
+  unsigned long long pcf_workers;
+
+  /* How many ids must an intersection have, on both sides
+   * together, before the workers help with it?  0 for the default.
+   */
+  unsigned long long pcf_parallel_min;
+
+  /* How many bytes ahead of their cursor should iterators
+   * ask the kernel to read?  0 turns read-ahead off.
+   */
+  unsigned long long pcf_prefetch;
+
+  /* If nonzero, index checkpoints write redo logs instead of
+   * backup files, and an index file's redo log is retired once
+   * it grows past this many bytes.  See addb_set_redo_log().
+   */
+  unsigned long long pcf_redo_log;
+
+  /* If nonzero, a background thread writes pages that were
+   * modified in place back to disk ahead of the next fsync, at up
+   * to this many bytes per second.  See addb_set_writeback().
+   */
+  unsigned long long pcf_writeback;
+
   addb_gmap_configuration pcf_gcf;
   addb_hmap_configuration pcf_hcf;
   addb_istore_configuration pcf_icf;
@@ -200,6 +229,24 @@ typedef struct pdb_primitive {
 
 } pdb_primitive;
 
+/*  The fixed-width fields of a primitive, as kept in the column
+ *  file.  Linkages are local ids, PDB_ID_NONE if unset.
+ */
+typedef struct pdb_column_record {
+  pdb_id pcr_linkage[PDB_LINKAGE_N];
+  graph_timestamp_t pcr_timestamp;
+
+  /*  PDB_PRIMITIVE_BIT_...
+   */
+  unsigned char pcr_bits;
+
+  /*  The low 32 bits of the hash the value is filed under in
+   *  the hmap; 0 if the primitive has no value.
+   */
+  unsigned long pcr_value_hash;
+
+} pdb_column_record;
+
 struct pdb_iterator;
 typedef struct pdb_iterator_chain {
   struct pdb_iterator *pic_head;
@@ -705,6 +752,68 @@ typedef int pdb_iterator_beyond(pdb_handle *_pdb, pdb_iterator *_it,
                                 char const *_s, char const *_e,
                                 bool *_beyond_out);
 
+/**
+ * @brief Return up to _m ids from the current position onwards.
+ *
+ *  Equivalent to repeated calls to pdb_iterator_next(), but
+ *  without the per-id call overhead.  The ids returned in
+ *  _id_out[0.._n_out-1] are valid whatever the return value;
+ *  the return value says why the batch ended.
+ *
+ *  If an iterator doesn't define this method, the generic
+ *  pdb_iterator_next_batch_default() loops over its next().
+ *
+ * @param _pdb		module handle
+ * @param _it		iterator
+ * @param _id_out	out: the ids
+ * @param _m		number of slots in _id_out, at least 1
+ * @param _n_out	out: number of ids returned
+ * @param _budget_inout	budget to charge
+ *
+ * @return 0 if more ids may follow; *_n_out is at least 1
+ * @return PDB_ERR_NO if the iterator has run out; the
+ *	ids in _id_out, if any, are its last.
+ * @return PDB_ERR_MORE if the budget ran out; call again to continue.
+ * @return other nonzero error codes on unexpected error.
+ */
+typedef int pdb_iterator_next_batch(pdb_handle *_pdb, pdb_iterator *_it,
+                                    pdb_id *_id_out, size_t _m,
+                                    size_t *_n_out, pdb_budget *_budget_inout);
+
+/**
+ * @brief Check an array of ids against an iterator.
+ *
+ *  Equivalent to calling pdb_iterator_check() on each of
+ *  _id_in[0.._n_in-1] in turn, and copying the ones that
+ *  pass to _id_out.  _id_out must not overlap _id_in.
+ *
+ *  If the budget runs out in the middle, the call returns
+ *  PDB_ERR_MORE; *_n_in_done says how many of the input ids
+ *  have been decided.  The caller resumes by calling again
+ *  with the remaining ids.
+ *
+ *  If an iterator doesn't define this method, the generic
+ *  pdb_iterator_check_batch_default() loops over its check().
+ *
+ * @param _pdb		module handle
+ * @param _it		iterator
+ * @param _id_in	ids to check
+ * @param _n_in		number of ids in _id_in
+ * @param _n_in_done	out: number of input ids decided
+ * @param _id_out	out: the ids that passed, in input order
+ * @param _n_out	out: number of ids in _id_out
+ * @param _budget_inout	budget to charge
+ *
+ * @return 0 after all ids have been checked
+ * @return PDB_ERR_MORE if the budget ran out first
+ * @return other nonzero error codes on unexpected error.
+ */
+typedef int pdb_iterator_check_batch(pdb_handle *_pdb, pdb_iterator *_it,
+                                     pdb_id const *_id_in, size_t _n_in,
+                                     size_t *_n_in_done, pdb_id *_id_out,
+                                     size_t *_n_out,
+                                     pdb_budget *_budget_inout);
+
 typedef struct pdb_iterator_type {
   char const *itt_name;
 
@@ -728,6 +837,9 @@ typedef struct pdb_iterator_type {
   pdb_iterator_suspend *itt_suspend;
   pdb_iterator_unsuspend *itt_unsuspend;
 
+  pdb_iterator_next_batch *itt_next_batch;
+  pdb_iterator_check_batch *itt_check_batch;
+
 } pdb_iterator_type;
 
 #define pdb_iterator_finish(a, b) \
@@ -759,6 +871,19 @@ typedef struct pdb_iterator_type {
   (((b)->it_has_position = true),                  \
    ((b)->it_type->itt_find_loc)((a), (b), (c), (d), (e), (f), (g)))
 
+#define pdb_iterator_next_batch(a, b, c, d, e, f)                        \
+  ((b)->it_type->itt_next_batch == NULL                                  \
+       ? pdb_iterator_next_batch_default((a), (b), (c), (d), (e), (f))   \
+       : ((b)->it_type->itt_next_batch)((a), (b), (c), (d), (e), (f)))
+
+#define pdb_iterator_check_batch(a, b, c, d, e, f, g, h)                   \
+  ((b)->it_has_position = false,                                           \
+   ((b)->it_type->itt_check_batch == NULL                                  \
+        ? pdb_iterator_check_batch_default((a), (b), (c), (d), (e), (f),   \
+                                           (g), (h))                       \
+        : ((b)->it_type->itt_check_batch)((a), (b), (c), (d), (e), (f),  \
+                                          (g), (h))))
+
 #define pdb_iterator_statistics(a, b, c)                                    \
   ((b)->it_original->it_statistics_done                                     \
        ? 0                                                                  \
@@ -1161,6 +1286,11 @@ struct pdb_iterator {
       pdb_id body_gmap_cached_check_id;
       unsigned int body_gmap_cached_check_result : 1;
 
+      /* Read-ahead has been requested up to here (counted
+       * like body_gmap_offset).
+       */
+      unsigned long long body_gmap_prefetch;
+
 #define it_gmap it_body.body_gmap.body_gmap_gmap
 #define it_gmap_source it_body.body_gmap.body_gmap_source
 #define it_gmap_source_guid it_body.body_gmap.body_gmap_source_guid
@@ -1173,6 +1303,7 @@ struct pdb_iterator {
 #define it_gmap_cached_check_id it_body.body_gmap.body_gmap_cached_check_id
 #define it_gmap_cached_check_result \
   it_body.body_gmap.body_gmap_cached_check_result
+#define it_gmap_prefetch it_body.body_gmap.body_gmap_prefetch
 
     } body_gmap;
 
@@ -1183,8 +1314,14 @@ struct pdb_iterator {
       addb_istore_id body_all_i;
       addb_istore_id body_all_m;
 
+      /* Read-ahead has been requested up to here (counted
+       * like body_all_i).
+       */
+      addb_istore_id body_all_prefetch;
+
 #define it_all_i it_body.body_all.body_all_i
 #define it_all_m it_body.body_all.body_all_m
+#define it_all_prefetch it_body.body_all.body_all_prefetch
 
     } body_all;
 
@@ -1199,6 +1336,12 @@ struct pdb_iterator {
       addb_gmap_id body_bgmap_recover_count;
       addb_gmap_id body_bgmap_recover_pos;
       bool body_bgmap_need_recover;
+
+      /*  Only return live primitives, as long as the database
+       *  still has body_bgmap_live_n primitives.
+       */
+      bool body_bgmap_live;
+      unsigned long long body_bgmap_live_n;
     } body_bgmap;
 
 #define it_bgmap it_body.body_bgmap.body_bgmap_bgmap
@@ -1211,6 +1354,8 @@ struct pdb_iterator {
 #define it_bgmap_recover_count it_body.body_bgmap.body_bgmap_recover_count
 #define it_bgmap_recover_pos it_body.body_bgmap.body_bgmap_recover_pos
 #define it_bgmap_need_recover it_body.body_bgmap.body_bgmap_need_recover
+#define it_bgmap_live it_body.body_bgmap.body_bgmap_live
+#define it_bgmap_live_n it_body.body_bgmap.body_bgmap_live_n
     void *body_theory;
 #define it_theory it_body.body_theory
 
@@ -1263,6 +1408,12 @@ typedef struct pdb_iterator_property {
  */
 typedef int pdb_primitive_callback(void *_callback_data, pdb_handle *_handle,
                                    pdb_id _id, pdb_primitive const *_primitive);
+/* pdb-bulk.c */
+
+int pdb_bulk_begin(pdb_handle *_pdb);
+bool pdb_bulk(pdb_handle *_pdb);
+int pdb_bulk_finish(pdb_handle *_pdb);
+
 /* pdb-checkpoint.c */
 
 pdb_id pdb_checkpoint_id_on_disk(pdb_handle *p);
@@ -1340,8 +1491,18 @@ int pdb_generation_nth(pdb_handle *_pdb, graph_dateline const *_asof,
 int pdb_generation_synchronize(pdb_handle *_pdb, pdb_id _id,
                                pdb_primitive const *_pr);
 
+/* pdb-column.c */
+
+int pdb_column_read(pdb_handle *_pdb, pdb_id _id, pdb_column_record *_pcr);
+
+int pdb_column_linkage(pdb_handle *_pdb, pdb_id _id, int _linkage,
+                       pdb_id *_id_out);
+
 /* pdb-hash.c */
 
+int pdb_hash_value(pdb_handle *_pdb, char const *_s, char const *_e,
+                   unsigned long long *_hash_out);
+
 int pdb_hash_iterator(pdb_handle *pdb, addb_hmap_type t, char const *key,
                       size_t key_len, pdb_id low, pdb_id high, bool forward,
                       pdb_iterator **it_out);
@@ -1533,6 +1694,31 @@ int pdb_iterator_all_thaw(pdb_handle *_pdb, pdb_iterator_text const *_pit,
 
 bool pdb_iterator_all_is_instance(pdb_handle *_pdb, pdb_iterator const *_it);
 
+/* pdb-iterator-batch.c */
+
+int pdb_iterator_next_batch_default(pdb_handle *_pdb, pdb_iterator *_it,
+                                    pdb_id *_id_out, size_t _m,
+                                    size_t *_n_out, pdb_budget *_budget_inout);
+
+int pdb_iterator_check_batch_default(pdb_handle *_pdb, pdb_iterator *_it,
+                                     pdb_id const *_id_in, size_t _n_in,
+                                     size_t *_n_in_done, pdb_id *_id_out,
+                                     size_t *_n_out,
+                                     pdb_budget *_budget_inout);
+
+int pdb_iterator_next_batch_loop(pdb_handle *_pdb, pdb_iterator *_it,
+                                 pdb_iterator_next_loc *_next, pdb_id *_id_out,
+                                 size_t _m, size_t *_n_out,
+                                 pdb_budget *_budget_inout);
+
+int pdb_iterator_check_batch_loop(pdb_handle *_pdb, pdb_iterator *_it,
+                                  pdb_iterator_check *_check,
+                                  pdb_id const *_id_in, size_t _n_in,
+                                  size_t *_n_in_done, pdb_id *_id_out,
+                                  size_t *_n_out, pdb_budget *_budget_inout);
+
+bool pdb_iterator_batch_is_ascending(pdb_id const *_id, size_t _n);
+
 /* pdb-iterator-bgmap.c */
 
 int pdb_iterator_bgmap_thaw(pdb_handle *pdb, pdb_iterator_text const *pit,
@@ -1556,6 +1742,8 @@ int pdb_iterator_bgmap_position_recover_work(pdb_handle *pdb, pdb_iterator *it,
 
 const char *pdb_iterator_bgmap_name(pdb_handle *pdb, pdb_iterator *it);
 
+bool pdb_iterator_bgmap_live_set(pdb_handle *pdb, pdb_iterator *it);
+
 const char *pdb_gmap_to_name(pdb_handle *pdb, addb_gmap *gmap);
 
 #define pdb_iterator_bgmap_next(a, b, c, d) \
@@ -1685,6 +1873,11 @@ int pdb_linkage_count_est(pdb_handle *_pdb, int _linkage, pdb_id _source,
                           unsigned long long _upper_bound,
                           unsigned long long *_n_out);
 
+int pdb_linkage_count_live(pdb_handle *_pdb, int _linkage, pdb_id _source,
+                           pdb_id _low, pdb_id _high,
+                           unsigned long long _upper_bound,
+                           unsigned long long *_n_out);
+
 int pdb_linkage_guid_count_est(pdb_handle *_pdb, int _linkage,
                                graph_guid const *_source_guid, pdb_id _low,
                                pdb_id _high, unsigned long long _upper_bound,
@@ -131,6 +131,7 @@ typedef struct pdb_index_type {
 extern pdb_index_type pdb_index_gmap;
 extern pdb_index_type pdb_index_hmap;
 extern pdb_index_type pdb_index_bmap;
+extern pdb_index_type pdb_index_column;
 
 /*  An index instance is the fixed-size slot in the pdb world
  *  which holds an an index.  A pointer to the  index implementation
@@ -152,6 +153,7 @@ struct pdb_index_instance {
     addb_hmap* hm;
     addb_gmap* gm;
     addb_bmap* bm;
+    addb_column* col;
     void* any;
   } ii_impl;
 };
@@ -223,6 +225,13 @@ struct pdb_handle {
 #define pdb_prefix_path pdb_indices[PDB_INDEX_PREFIX].ii_path
 #define pdb_versioned pdb_indices[PDB_INDEX_DEAD].ii_impl.bm
 #define pdb_versioned_path pdb_indices[PDB_INDEX_DEAD].ii_path
+#define pdb_column pdb_indices[PDB_INDEX_COLUMN].ii_impl.col
+#define pdb_column_path pdb_indices[PDB_INDEX_COLUMN].ii_path
+#define pdb_live pdb_indices[PDB_INDEX_LIVE].ii_impl.bm
+#define pdb_live_path pdb_indices[PDB_INDEX_LIVE].ii_path
+
+/* Size of a record in the column file, see pdb-column.c */
+#define PDB_COLUMN_SIZE 32
 
   /* New index horizon for the ongoing checkpoint
    */
@@ -250,6 +259,12 @@ struct pdb_handle {
   time_t pdb_disk_warning;
 
   bool pdb_deficit_exceeded;
+
+  /*  Between pdb_bulk_begin() and pdb_bulk_finish(), new
+   *  primitives are indexed later, in bulk.
+   */
+  bool pdb_bulk;
+
   time_t pdb_started_checkpoint;
   bool pdb_active_checkpoint_sync;
 
@@ -281,6 +296,10 @@ struct pdb_handle {
 
 unsigned long pdb_local_ip(void);
 
+/* pdb-bulk.c */
+
+int pdb_bulk_synchronize(pdb_handle* _pdb);
+
 /* pdb-configure.c */
 
 void pdb_configure_databases(pdb_handle* pdb, bool _is_default);
@@ -297,6 +316,11 @@ int pdb_count_gmap(pdb_handle* _pdb, addb_gmap* _gm, pdb_id _source,
                    pdb_id _low, pdb_id _high, unsigned long long _upper_bound,
                    unsigned long long* _n_out);
 
+int pdb_count_gmap_live(pdb_handle* _pdb, addb_gmap* _gm, pdb_id _source,
+                        pdb_id _low, pdb_id _high,
+                        unsigned long long _upper_bound,
+                        unsigned long long* _n_out);
+
 int pdb_count_hmap(pdb_handle* _pdb, addb_hmap* _hm, addb_hmap_id _hash_of_key,
                    char const* const _key, size_t _key_len,
                    addb_hmap_type _type, pdb_id _low, pdb_id _high,
@@ -309,6 +333,11 @@ int pdb_from_node_add(pdb_handle* _pdb, pdb_id _node_id, pdb_id _link_id);
 int pdb_from_node_synchronize(pdb_handle* _pdb, pdb_id _id,
                               pdb_primitive const* _pr);
 
+/* pdb-column.c */
+
+int pdb_column_synchronize(pdb_handle* _pdb, pdb_id _id,
+                           pdb_primitive const* _pr);
+
 /* pdb-hash.c */
 
 char const* pdb_hash_type_to_string(int);
@@ -416,6 +445,8 @@ addb_gmap* pdb_gmap_by_name(pdb_handle* pdb, char const* s, char const* e);
 int pdb_versioned_synchronize(pdb_handle* pdb, pdb_id id,
                               const pdb_primitive* pr);
 
+int pdb_live_rebuild(pdb_handle* pdb, unsigned long long horizon);
+
 int pdb_value_bin_synchronize(pdb_handle* pdb, pdb_id id,
                               pdb_primitive const* pr);
 
@@ -248,18 +248,19 @@ static int srv_buffered_connection_write_call_pre_hook(
 }
 
 /*  Get <bc> ready to write (to <ed>.)
+ *
+ *  The pre-hook is called without blocking; it may ask
+ *  to be called again later by returning SRV_ERR_MORE.
  *
  * @param bc		The buffered connection
  * @param ed		The output descriptor
- * @param block		true if the call should block
  * @param any_out	out: Did we actually do anything?
  *
  * @return 0		if the descriptor is as ready
  *			as it'll ever be (including
  *			if it's empty)
  *
- * @return SRV_ERR_MORE	if block wasn't set, and the pre-hook
- *			flush is still in progress.
+ * @return SRV_ERR_MORE	if the pre-hook flush is still in progress.
  *
  * @return other nonzero error codes on system error.
  *
@@ -278,7 +279,9 @@ int srv_buffered_connection_write_ready(srv_buffered_connection *bc,
 
   if (buf->b_pre_callback == NULL) return 0;
 
-  err = srv_buffered_connection_write_call_pre_hook(bc, ed, buf, true, any_out);
+  err = srv_buffered_connection_write_call_pre_hook(bc, ed, buf,
+                                                    /* block? */ false,
+                                                    any_out);
 
   if (err == SRV_ERR_MORE) return err;
 
@@ -797,6 +797,14 @@ int srv_config_read(srv_handle *srv, char const *filename, cm_handle *cm_env,
         cf->cf_cpu = 0;
       }
       if (err) goto err;
+    } else if (srv_config_is_name("eventloop", tok_s, tok_e)) {
+      if (!(cf->cf_event_loop =
+                srv_config_read_string(cf, cl, "event loop", &s, e))) {
+        cl_cover(cl);
+        err = errno ? errno : ENOMEM;
+        goto err;
+      }
+      cl_cover(cl);
     } else if (srv_config_is_name("group", tok_s, tok_e)) {
       char *name = srv_config_read_string(cf, cl, "group name", &s, e);
       err = srv_unixid_name_to_gid(name, &cf->cf_group_id);
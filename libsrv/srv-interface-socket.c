@@ -137,7 +137,8 @@ bool srv_socket_run(void *conn_data, srv_handle *srv, srv_session *ses,
     if ((ses->ses_bc.bc_error & SRV_BCERR_WRITE) ||
         ((ses->ses_bc.bc_error & SRV_BCERR_READ) &&
          ses->ses_request_head == NULL &&
-         !ses->ses_bc.bc_input_waiting_to_be_parsed)) {
+         !ses->ses_bc.bc_input_waiting_to_be_parsed &&
+         !ses->ses_bc.bc_output_waiting_to_be_written)) {
       /* close the interface */
 
       if (conn->conn_sock != -1) {
@@ -145,7 +145,8 @@ static bool tty_run(void *cb_data, srv_handle *srv, srv_session *ses,
     if ((ses->ses_bc.bc_error & SRV_BCERR_WRITE) ||
         ((ses->ses_bc.bc_error & SRV_BCERR_READ) &&
          ses->ses_request_head == NULL &&
-         !ses->ses_bc.bc_input_waiting_to_be_parsed)) {
+         !ses->ses_bc.bc_input_waiting_to_be_parsed &&
+         !ses->ses_bc.bc_output_waiting_to_be_written)) {
       /*  Close both interfaces.
        *  After all non-deamon interfaces are closed,
        *  es_loop() returns.
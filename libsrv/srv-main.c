@@ -374,6 +374,12 @@ static int srv_initialize(srv_handle *srv) {
     return EX_OSERR;
   }
 
+  if (es_set_backend(srv->srv_es, srv->srv_config->cf_event_loop) != 0) {
+    fprintf(stderr, "%s: unknown or unsupported event loop \"%s\"\n",
+            srv->srv_progname, srv->srv_config->cf_event_loop);
+    if (pid_file) (void)unlink(pid_file);
+    return EX_USAGE;
+  }
   es_set_pre_dispatch(srv->srv_es, srv_es_pre_dispatch, srv);
   es_set_post_dispatch(srv->srv_es, srv_es_post_dispatch, srv);
 
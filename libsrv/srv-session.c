@@ -1590,3 +1590,20 @@ bool srv_any_sessions_ready_for(srv_handle *srv, int flags) {
   }
   return false;
 }
+
+/*  Does any session other than <except> have a request that
+ *  srv_session_run() would run next?
+ */
+bool srv_any_other_sessions_ready_to_run(srv_handle *srv,
+                                         srv_session const *except) {
+  srv_session *ses;
+  srv_request *req;
+
+  for (ses = srv->srv_session_head; ses != NULL; ses = ses->ses_next) {
+    if (ses == except) continue;
+
+    req = srv_session_waiting_request(ses, 1 << SRV_RUN);
+    if (req != NULL && (req->req_ready & (1 << SRV_RUN))) return true;
+  }
+  return false;
+}
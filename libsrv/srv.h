@@ -1643,6 +1643,8 @@ void srv_session_schedule(srv_session *);
 void srv_session_suspend(srv_session *);
 void srv_session_resume(srv_session *);
 bool srv_any_sessions_ready_for(srv_handle *srv, int flag);
+bool srv_any_other_sessions_ready_to_run(srv_handle *srv,
+                                         srv_session const *except);
 
 void *srv_session_allocate_pre_hook(srv_session *ses,
                                     srv_pre_callback *callback,
@@ -134,6 +134,11 @@ struct srv_config {
    */
   char *cf_pid_file;
 
+  /* Wait for events with this es backend ("poll", "epoll",
+   * "io_uring"); NULL for the best one available.
+   */
+  char *cf_event_loop;
+
   /* Open these interfaces.
    */
   srv_interface_config *cf_interface_head, **cf_interface_tail;
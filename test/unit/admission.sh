@@ -0,0 +1,56 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+rm -rf $D $D.cheap* $D.dear
+
+rungraphd -f $B.conf -p${D}.pid -itcp::8119 -bt
+for i in $(seq 1 20000); do echo "write (value=\"$i\")"; done |
+	$GLD -s tcp::8119 -ap > /dev/null
+
+#  Eight connections send cheap lookups as fast as they can, while
+#  a ninth sends reads that scan everything.  With a 1 ms SLO, the
+#  server falls behind, and defers and then turns away reads that
+#  cost more than average - mostly the scans.  How many depends on
+#  timing, so we only check that some were, that every read got an
+#  answer, and that the server's counts match what the clients saw.
+#
+for c in 1 2 3 4 5 6 7 8
+do
+	for i in $(seq 1 3000); do echo "read (value=\"$i\" result=count)"; done |
+		$GLD -s tcp::8119 -ap > $D.cheap$c &
+done
+for i in $(seq 1 30)
+do
+	echo 'read (value~="*1*" pagesize=20000 result=((value)))'
+done | $GLD -s tcp::8119 -ap | cut -c1-40 > $D.dear &
+wait
+
+echo "lookups answered: `cat $D.cheap* | grep -c '^ok 1$\|^error BUSY'`"
+echo "scans answered: `grep -c '^ok \|^error BUSY' $D.dear`"
+grep -q '^error BUSY' $D.dear && echo "some scans got BUSY"
+busy=`cat $D.cheap* $D.dear | grep -c '^error BUSY'`
+
+echo 'status (admission)' | $GLD -s tcp::8119 -ap > $D.status
+grep -o '("slo" [0-9]*)' $D.status
+grep -q '("deferred" [1-9]' $D.status && echo "some reads were deferred"
+grep -q "(\"shed\" $busy)" $D.status && echo "shed the ones that got BUSY"
+
+rungraphd -f $B.conf -p${D}.pid -z
+rm -rf $D $D.cheap* $D.dear $D.status
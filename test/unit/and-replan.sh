@@ -0,0 +1,99 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+source ./pages
+GLD=../../gld/gld
+
+rm -rf $D $D.expected $D.read $D.log $D.page $D.pages $D.server-log
+
+#  An "and" of the hub's links and an "or" of four values, laid
+#  out so that the plan made from the first few ids is badly wrong:
+#
+#  - ids 1..1280: every 64th points to the hub and has one of
+#    the values; the others only have a value.  The hub's links
+#    win the contest, five for five.
+#  - the next 20,000 point to the hub, but only every 400th has
+#    one of the values; that's where the hub's links fall apart.
+#  - the next 20,000 only have a value, and a last one only
+#    points to the hub, which keeps the checker from using "find".
+#
+HUB=00000012400034568000000000000000
+VALUES='"a" "c" "d" "e"'
+function primitives ()
+{
+	v=(a c d e)
+	echo 'write (name="hub")'
+	for i in `seq 1 1280`
+	do
+		if [ $((i % 64)) = 0 ]
+		then echo "write (left=$HUB value=\"${v[i % 4]}\")"
+		else echo "write (value=\"${v[i % 4]}\")"
+		fi
+	done
+	for i in `seq 1 20000`
+	do
+		if [ $((i % 400)) = 0 ]
+		then echo "write (left=$HUB value=\"${v[i / 400 % 4]}\")"
+		else echo "write (left=$HUB value=\"b\")"
+		fi
+	done
+	for i in `seq 1 20000`
+	do
+		echo "write (value=\"${v[i % 4]}\")"
+	done
+	echo "write (left=$HUB value=\"b\")"
+}
+primitives | rungraphd -d${D} -bty | grep -vc '^ok ('
+
+function guids ()
+{
+	grep -o '[0-9a-f]\{32\}' | grep -v $HUB
+}
+
+#  The ids that should come back, in order.
+#
+{
+	for i in `seq 64 64 1280`; do echo $i; done
+	for i in `seq 400 400 20000`; do echo $((1280 + i)); done
+} | while read i
+do
+	printf "000000124000345680000000%08x\n" $i
+done > $D.expected
+wc -l < $D.expected
+
+#  Read it in one go.  The "and" switches producers once the hub's
+#  links stop paying off, and picks up after the last id it saw.
+#
+echo "read (left=$HUB value=($VALUES) pagesize=100 result=((guid)))" \
+	| rungraphd -d${D} -bty -v debug 2> $D.log | guids > $D.read
+cmp -s $D.read $D.expected && echo "read: same"
+grep -c "and_run_replan_producer: .*switching to #1" $D.log
+
+#  Page through it with cursors, ten at a time.  The cursors are
+#  taken while the hub's links are still producing; the pages that
+#  resume from them in the middle of the hub's "b" links switch
+#  producers along the way.
+#
+rungraphd -d${D} -p${D}.pid -itcp::8127 -bt -v debug -l $D.server-log 2> /dev/null
+pages 8127 10 "left=$HUB value=($VALUES)" 20 | guids > $D.pages
+rungraphd -d${D} -p${D}.pid -z
+cmp -s $D.pages $D.expected && echo "pages: same"
+grep -q "and_run_replan_producer: .*switching to #1" $D.server-log* \
+	&& echo "pages: re-planned"
+
+rm -rf $D $D.expected $D.read $D.log $D.page $D.pages $D.server-log*
@@ -0,0 +1,101 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+source ./pages
+GLD=../../gld/gld
+
+rm -rf $D $D.expected $D.page
+
+#  6,000 primitives after a hub.  Primitive #i has the value
+#  "v$((i % 20))"; two out of three point left to the hub.
+#
+HUB=00000012400034568000000000000000
+N=6000
+function primitives ()
+{
+	echo 'write (value="hub")'
+	for i in `seq 1 $N`
+	do
+		if [ $((i % 3)) = 0 ]; then
+			echo "write (value=\"v$((i % 20))\")"
+		else
+			echo "write (value=\"v$((i % 20))\" left=$HUB)"
+		fi
+	done
+}
+primitives | rungraphd -d${D} -bty | grep -vc '^ok ('
+
+#  Seventeen branches, enough for the loser tree; and a few.
+#
+FEW='"v1" "v2" "v3" "v5" "v7"'
+VALUES='"v0" "v1" "v2" "v3" "v4" "v5" "v6" "v7" "v8" "v9" "v10" "v11" "v12" "v13" "v14" "v15" "v16"'
+
+function guids ()
+{
+	grep -o '[0-9a-f]\{32\}' | grep -v $HUB
+}
+
+#  The ids each read should return, worked out one id at a time.
+#
+function expected ()
+{
+	for i in `seq 1 $N`
+	do
+		if [ $2 = and ] && [ $((i % 3)) = 0 ]; then continue; fi
+		case $1 in
+		or)	[ $((i % 20)) -lt 17 ] || continue;;
+		few)	case $((i % 20)) in 1|2|3|5|7) ;; *) continue;; esac;;
+		ors)	[ $((i % 20)) -lt 18 ] || continue;;
+		checked) case $((i % 20)) in 1|2) ;; *) continue;; esac;;
+		esac
+		printf "000000124000345680000000%08x\n" $i
+	done
+}
+
+#  Each read in one go, and in pages of 7 -- an odd size, so that
+#  pages end in the middle of the batches the subiterators read.
+#
+function compare ()
+{
+	expected $2 $3 > $D.expected
+	echo "read ($1 pagesize=$N result=((guid)))" | $GLD -s tcp::8128 -ap \
+		| guids | cmp -s - $D.expected && echo "$2 $3: same"
+	pages 8128 7 "$1" | guids | cmp -s - $D.expected \
+		&& echo "$2 $3 pages: same"
+}
+
+rungraphd -d${D} -p${D}.pid -itcp::8128 -bt
+compare "value=($VALUES)" or -
+compare "left=$HUB value=($FEW)" few and
+compare "left=$HUB value=($VALUES)" or and
+
+#  Seventeen overlapping "and"s under one "or", each too large to
+#  become a fixed set: the loser tree reads batches from the "and"s.
+#  Then the same "or" as a check, which checks its ids in batches
+#  against each "and".
+#
+ORS=
+for k in `seq 0 16`
+do
+	ORS="$ORS${ORS:+ || }{left=$HUB value=(\"v$k\" \"v$((k + 1))\")}"
+done
+compare "$ORS" ors and
+compare "value=(\"v1\" \"v2\") {$ORS}" checked and
+rungraphd -d${D} -p${D}.pid -z
+
+rm -rf $D $D.expected $D.page
@@ -0,0 +1,94 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+rm -rf $D $D-i $D-b $D.[12bqwi]
+
+#  A bulk load must leave a database that answers queries exactly
+#  like one that indexed each primitive as it arrived.  Write a
+#  dataset with links, new versions, and deletions; dump it; then
+#  restore the dump once normally and once with -B, and ask all
+#  three databases the same questions.
+#
+P=00000012400034568
+guid() { printf "$P%015x" $1; }
+{
+	echo 'write (name="hub" value="center")'
+	for i in `seq 0 39`
+	do
+		echo "write (name=\"t$i\")"
+	done
+	for i in `seq 1 3000`
+	do
+		echo "write (name=\"n$i\" value=\"v$((i % 17)) w$((i % 5))\"" \
+			"(<-left typeguid=`guid 0` right=`guid $((i % 40 + 1))`))"
+	done
+	for i in `seq 1 200`
+	do
+		echo "write (guid~=`guid $((39 + 4 * i))` value=\"changed $i\")"
+	done
+	for i in `seq 1 50`
+	do
+		echo "write (guid~=`guid $((41 + 4 * i))` live=false)"
+	done
+} | rungraphd -d${D} -bty | grep -v '^ok ([0-9a-f]* *(*[0-9a-f]*)*)$'
+
+echo 'dump (start=0 end=4000)' | rungraphd -d${D} -bty |
+	sed 's/^ok (/restore (/' > $D.1
+echo 'dump (start=4000)' | rungraphd -d${D} -bty |
+	sed 's/^ok (/restore (/' > $D.2
+
+cat > $D.q <<-'EOF'
+	read (value~="*" result=count)
+	read (name="n1000" result=((guid name value)))
+	read (guid=0000001240003456800000000000002b newest>=1 result=((value)))
+	read (value="v3 w1" result=count)
+	read (value~="w2" result=count)
+	read (value~="changed" sort=value pagesize=5 result=((value)))
+	read (name="t7" (<-right result=count))
+	read (name="t7" result=((name contents)) (<-right pagesize=3 result=((left))))
+	read (name="n401" result=((name contents)) (<-left result=((typeguid right))))
+	read (typeguid=00000012400034568000000000000000 result=count)
+	read (right->(name="t3") left->(value~="w3") result=count)
+	read (live=false result=count)
+	read (newest>=1 result=count)
+	read (value~="v1*" sort=name pagesize=4 result=((name value)))
+	EOF
+rungraphd -d${D} -bty < $D.q > $D.w
+cat $D.w
+
+cat $D.1 $D.2 | rungraphd -d${D}-i -bty
+rungraphd -d${D}-i -bty < $D.q > $D.i
+cmp -s $D.w $D.i && echo "incremental restore: same" || diff $D.w $D.i
+
+#  Crash the bulk load halfway through; restarted with -B, it
+#  picks up where it left off, and indexes everything when it
+#  shuts down.
+#
+rungraphd -d${D}-b -p${D}.pid -itcp::8120 -B -bt
+$GLD -s tcp::8120 -ap < $D.1
+pid=`cat ${D}.pid`
+kill -9 -$pid
+while kill -0 -$pid 2>/dev/null; do sleep 0.1; done
+rm -f ${D}.pid
+rungraphd -d${D}-b -B -bty < $D.2
+rungraphd -d${D}-b -bty < $D.q > $D.b
+cmp -s $D.w $D.b && echo "bulk load: same" || diff $D.w $D.b
+
+rm -rf $D $D-i $D-b $D.[12bqwi]
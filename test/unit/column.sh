@@ -0,0 +1,81 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+rm -rf $D $D.expected $D.log
+
+#  A hub, and 200 nodes with two links each; one of them points
+#  right to the hub.
+#
+HUB=`echo 'write (value="hub")' | rungraphd -d${D} -bty | grep -o '[0-9a-f]\{32\}'`
+function primitives ()
+{
+	for i in `seq 1 200`
+	do
+		echo "write (type=\"node\" value=\"n$((i % 5))\"
+			(<-left type=\"link\" value=\"l$((i % 7))\" right=$HUB)
+			(<-left type=\"link\" value=\"l$(((i + 3) % 7))\"))"
+	done
+}
+primitives | rungraphd -d${D} -bty | grep -vc '^ok ('
+
+#  Reads whose checks get linkages from the column file: "linksto"
+#  with and without a hint, and gmap checks in an "and".
+#
+function reads ()
+{
+	rungraphd -d${D} -bty <<-EOF
+	read (type="node" value="n1" (<-left type="link" value="l3") result=((guid)))
+	read (type="link" right=$HUB value="l2" result=((guid)))
+	read (value="n4" (<-left right=$HUB) result=count)
+	read (type="node" (<-left value="l1" right=$HUB) result=count)
+	EOF
+}
+reads > $D.expected
+
+#  The column file only caches decoded istore records.  Damaged,
+#  emptied, or gone, the server starts over with a new one and
+#  answers from the istore; the results don't change.
+#
+printf 'XXXX' | dd of=$D/column conv=notrunc status=none
+reads 2> $D.log | cmp -s - $D.expected && echo "damaged header: same"
+grep -c "column is damaged; starting a new column file" $D.log
+
+: > $D/column
+reads | cmp -s - $D.expected && echo "emptied: same"
+
+rm -f $D/column
+reads | cmp -s - $D.expected && echo "removed: same"
+
+#  Primitives written after that get column records again.
+#  (Counting the nonzero bytes; the file is written in whole tiles.)
+#
+function written ()
+{
+	tr -d '\000' < $D/column | wc -c
+}
+size=`written`
+rungraphd -d${D} -bty <<-EOF | grep -vc '^ok ('
+	write (type="node" value="new" (<-left type="link" value="l1" right=$HUB))
+	EOF
+[ `written` -gt $size ] && echo "column record written"
+rungraphd -d${D} -bty <<-EOF
+	read (type="node" value="new" (<-left type="link" value="l1" right=$HUB) result=count)
+	EOF
+
+rm -rf $D $D.expected $D.log
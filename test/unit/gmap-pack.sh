@@ -0,0 +1,42 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+#  3000 links to one node put its "from" array into a largefile,
+#  and the checkpoints after the writes pack it into a .glp.
+
+rm -rf $D
+{
+	echo 'write (name="hub")'
+	for i in `seq 3000`; do
+		echo "write (value=\"$i\" left=00000012400034568000000000000000)"
+	done
+} | rungraphd -f gmap-pack.conf -bty > /dev/null
+ls $D/from/large
+rungraphd -f gmap-pack.conf -bty <<-'EOF'
+	read (guid=00000012400034568000000000000000 result=((contents)) (<-left result=count))
+	read (guid=00000012400034568000000000000000 result=((contents)) (<-left pagesize=5 result=((value))))
+	read (value="2999" left=00000012400034568000000000000000 result=value)
+	read (value="3001" left=00000012400034568000000000000000 result=value)
+	write (value="3001" left=00000012400034568000000000000000)
+EOF
+rungraphd -f gmap-pack.conf -bty <<-'EOF'
+	read (guid=00000012400034568000000000000000 result=((contents)) (<-left result=count))
+	read (value="3001" left=00000012400034568000000000000000 result=value)
+EOF
+rm -rf $D
@@ -0,0 +1,50 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+rm -rf $D
+
+#  With a group commit window of half a second, eight writes sent
+#  at once share a checkpoint.
+#
+rungraphd -f $B.conf -p${D}.pid -itcp::8118 -bt
+for i in 1 2 3 4 5 6 7 8
+do
+	echo "write (value=\"$i\")" | $GLD -s tcp::8118 -ap > $D.$i &
+done
+wait
+cat $D.[1-8] | grep -c '^ok ('
+echo 'status (commit)' | $GLD -s tcp::8118 -ap > $D.status
+grep -o '("window" [0-9]*)' $D.status
+grep -q '("batches" [1-7])' $D.status && echo "fewer checkpoints than writes"
+grep -o '("requests" [0-9]*)' $D.status
+
+#  Every write that was acknowledged is on disk: kill the server
+#  without letting it shut down, and the restarted one still has
+#  them all.  (Primitives that weren't checkpointed would have been
+#  rolled back.)
+#
+pid=`cat ${D}.pid`
+kill -9 -$pid
+while kill -0 -$pid 2>/dev/null; do sleep 0.1; done
+rm -f ${D}.pid
+rungraphd -f $B.conf -bty <<-'EOF'
+	read (value~="*" result=count)
+	EOF
+rm -rf $D $D.[1-8] $D.status
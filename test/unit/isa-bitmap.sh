@@ -0,0 +1,48 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+#  Twenty results one per 64 ids, then a thousand dense ones.
+#  The isa over them weeds out duplicates with a bitmap; a short
+#  one goes into the cursor, a longer one into the resource cache.
+
+rm -rf $D
+{
+	for g in `seq 20`; do
+		for f in `seq 62`; do echo 'write (value="f")'; done
+		echo "write (value=\"s$g\" (<-left name=\"e\"))"
+	done
+	for g in `seq 1000`; do
+		echo "write (value=\"d$g\" (<-left name=\"e\"))"
+	done
+} | rungraphd -d${D} -bty > /dev/null
+rungraphd -d${D} -bty <<-'EOF'
+	read id="1: inline" (pagesize=3 result=(cursor (value)) (<-left name="e"))
+	read id="2: thaw inline" (pagesize=3 result=(cursor (value)) (<-left name="e")
+		cursor="cursor:8802:[o:3][n:3280]isa:0-3279:l<-(hmap:63-3280:pool:name:101:e)/190:~-/0:(3/)-:54:16:1019:-:[bd:0:4000000000000000,4000000000000000,4000000000000000]")
+	read id="3: bad low" (pagesize=3 result=(cursor (value)) (<-left name="e")
+		cursor="cursor:c476:[o:3][n:3280]isa:0-3279:l<-(hmap:63-3280:pool:name:101:e)/190:~-/0:(3/)-:54:16:1019:-:[bd:1000:1]")
+	read id="4: stamp" (pagesize=18 result=(cursor (value)) (<-left name="e"))
+	read id="5: thaw stamp" (pagesize=3 result=(cursor (value)) (<-left name="e")
+		cursor="cursor:4f6b:[o:18][n:3280]isa:0-3279:l<-(hmap:63-3280:pool:name:101:e)/1150:~-/0:(18/)-:54:16:1019:-:[bd:@0123456789ab2]")
+EOF
+rungraphd -d${D} -bty <<-'EOF'
+	read id="6: lost stamp" (pagesize=3 result=(cursor (value)) (<-left name="e")
+		cursor="cursor:4f6b:[o:18][n:3280]isa:0-3279:l<-(hmap:63-3280:pool:name:101:e)/1150:~-/0:(18/)-:54:16:1019:-:[bd:@0123456789ab2]")
+EOF
+rm -rf $D
@@ -8476,6 +8476,9 @@ rungraphd -d${D} -bty <<-'EOF'
 	read id="2b: <-a* cursor-2" (pagesize=1 result=(cursor (guid value)) (<-right value~="a*")
 		cursor="cursor:1a77:[o:1][n:16500]isa:0-16499:r<-(prefix:4-16500:a)/3:~-[sp:1]/0:(-/)-:34:26:4092:-:[sd:(prefix:4-16500:a/20/)@0123456789ab1]"
 		)
+	read id="2c: <-a* cursor-2" (pagesize=1 result=(cursor (guid value)) (<-right value~="a*")
+		cursor="cursor:ed3a:[o:1][n:16500]isa:0-16499:r<-(prefix:4-16500:a)/3:~-/0:(4/[st:4092:4:1116])-:34:16:4091:-:[bd:0:8]"
+		)
 	read id="3a: <-a* cursor-3" (pagesize=1 result=(cursor (guid value)) (<-right value~="a*")
 		cursor="cursor:9ba0:[o:2][n:16500]isa:0-16499:r<-(prefix:4-16500:a)/7:~-/0:(-/)-:34:26:4092:-:[sd:(prefix:4-16500:a/20/)@0123456789ab1]")
 	read id="3b: <-a* cursor-3" (pagesize=1 result=(cursor (guid value)) (<-right value~="a*")
@@ -0,0 +1,107 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+rm -rf $D $D-fresh $D-other $D.pid $D.[0-9]
+
+P=00000012400034568
+guid() { printf "$P%015x" $1; }
+member() {
+	echo "write (name=\"n$1\"" \
+		"(<-left typeguid=`guid 0` right=`guid $(($1 % 10 + 1))`))"
+}
+
+#  Build the type analysis and a group for "member" links;
+#  the server saves them to "islink" when it shuts down.
+#
+{
+	echo 'write (name="member")'
+	for i in `seq 0 9`
+	do
+		echo "write (name=\"t$i\")"
+	done
+	for i in `seq 1 500`
+	do
+		member $i
+	done
+} | rungraphd -d${D} -bty | grep -v '^ok ([0-9a-f]* *(*[0-9a-f]*)*)$'
+
+cat > $D.1 <<-EOF
+	islink (typeguid=`guid 0`)
+	islink (typeguid=`guid 0` right=`guid 4`)
+	EOF
+cat > $D.2 <<-EOF
+	status (islink)
+	read (typeguid=`guid 0` right=`guid 4` result=count)
+	read (name="t3" (<-right typeguid=`guid 0` result=count))
+	EOF
+cat $D.1 $D.2 | rungraphd -d${D} -bty
+test -s $D/islink && echo "saved"
+
+#  Compare what a server finds in the cache at startup with
+#  what a server that has to build it from scratch ends up with.
+#
+same_as_rebuild() {
+	rungraphd -d${D} -bty < $D.2 > $D.3
+	rm -rf $D-fresh
+	cp -r $D $D-fresh
+	rm -f $D-fresh/islink
+	cat $D.1 $D.2 | rungraphd -d${D}-fresh -bty | tail -3 > $D.4
+	cmp -s $D.3 $D.4 && echo "$1: same as a rebuild" || diff $D.3 $D.4
+}
+same_as_rebuild "restart"
+
+#  Primitives written after the cache was last saved are added
+#  when it's loaded.  (Kill the server, so that it doesn't save
+#  the cache again.)
+#
+rungraphd -d${D} -p${D}.pid -itcp::8121 -bt
+for i in 501 502 503 513 523
+do
+	member $i
+done | $GLD -s tcp::8121 -ap | grep -v '^ok ([0-9a-f]* *(*[0-9a-f]*)*)$'
+pid=`cat ${D}.pid`
+kill -9 -$pid
+while kill -0 -$pid 2>/dev/null; do sleep 0.1; done
+rm -f ${D}.pid
+same_as_rebuild "after a crash"
+cat $D.3
+
+#  A damaged file, or one that belongs to a different database,
+#  is ignored; the server starts with an empty cache, and builds
+#  the same one again when asked.
+#
+rebuilds() {
+	echo 'status (islink)' | rungraphd -d$2 -bty
+	cat $D.1 $D.2 | rungraphd -d$2 -bty | tail -3 > $D.3
+	cmp -s $D.3 $D.4 && echo "$1: rebuilt" || diff $D.3 $D.4
+}
+cp $D/islink $D.5
+head -c 100 $D.5 > $D/islink
+rebuilds "truncated" $D
+
+echo "not an islink cache" > $D/islink
+rebuilds "garbage" $D
+
+echo 'write (name="other")' | rungraphd -d${D}-other -bty > /dev/null
+cat $D.1 $D.2 | rungraphd -d${D}-other -bty | tail -3 > $D.4
+cp $D.5 $D-other/islink
+rebuilds "other database" $D-other
+
+rm -rf $D $D-fresh $D-other $D.pid $D.[0-9]
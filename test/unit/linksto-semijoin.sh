@@ -0,0 +1,44 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+#  12000 targets, and a link to every other one.  With that
+#  many targets, "left->(name=target)" is cheapest as a semi-join:
+#  a bitmap of the targets, and one pass over the links.
+
+rm -rf $D
+{
+	for i in `seq 12000`; do echo 'write (name="target")'; done
+	for i in `seq 0 2 11999`; do
+		printf 'write (name="link" value="%d" left=00000012400034568%015x)\n' $i $i
+	done
+} | rungraphd -d${D} -bty > /dev/null
+rungraphd -d${D} -bty <<-'EOF'
+	read id="1" (left->(name="target") result=count)
+	read id="2" (left->(name="target") pagesize=3 result=(cursor (value)))
+	read id="3" (name="link" left->(name="target") pagesize=3 result=(cursor (value)))
+	read id="4" (left->(name="target") pagesize=3 result=(cursor (value))
+		cursor="cursor:4681:[o:3][n:18000]linksto:#1-18000:l->(hmap:0-12000:pool:name:4658952359:target)/2:12002:4/0:(0/):-:63:12+22:6666:")
+	read id="5" (name="link" left->(name="target") pagesize=3 result=(cursor (value))
+		cursor="cursor:b787:[o:3][n:18000]and:#12000-18000:2:[psz:3][ov:0](hmap:12000-18000:pool:name:3999278:link)(linksto:#12000-18000:l->(hmap:0-12000:pool:name:4658952359:target)[md:2])[pro:0]/12002/@0123456789ab1")
+EOF
+rungraphd -d${D} -bty <<-'EOF'
+	read id="6" (name="link" left->(name="target") pagesize=3 result=(cursor (value))
+		cursor="cursor:b787:[o:3][n:18000]and:#12000-18000:2:[psz:3][ov:0](hmap:12000-18000:pool:name:3999278:link)(linksto:#12000-18000:l->(hmap:0-12000:pool:name:4658952359:target)[md:2])[pro:0]/12002/@0123456789ab1")
+EOF
+rm -rf $D
@@ -0,0 +1,72 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+rm -rf $D $D.read
+
+#  Enough links of type "t" for the type index to become a bitmap,
+#  with a few plain "t" nodes before and after them.
+#
+function primitives ()
+{
+	for i in 1 2 3; do echo "write (type=\"t\" value=\"a$i\")"; done
+	for i in `seq 1 140`
+	do
+		printf 'write (value="p%d"' $i
+		for j in `seq 1 1000`; do printf ' (<-left type="t")'; done
+		echo ')'
+	done
+	for i in 4 5 6; do echo "write (type=\"t\" value=\"a$i\")"; done
+}
+primitives | rungraphd -d${D} -bty | grep -vc '^ok ('
+
+#  Version two of the nodes and delete a third.  A scan of the type
+#  skips the superseded versions, and its estimate counts only the
+#  live ones; asking for old versions too still finds them all.
+#
+rungraphd -d${D} -bty <<-'EOF'
+	read (type="t" result=estimate-count)
+	write (guid=00000012400034568000000000000009 type="t" value="a1 again")
+	write (guid=0000001240003456800000000000000a type="t" value="a2 again")
+	write (guid=0000001240003456800000000000000b type="t" value="a3" live=false)
+	read (type="t" result=estimate-count)
+	read (type="t" result=count)
+	read (type="t" value="a1" result=count)
+	read (type="t" value="a1 again" result=count)
+	read (type="t" newest>=0 result=count)
+	EOF
+
+#  Writes that land while a scan is running retire versions the
+#  scan must still see; it stops skipping, and counts what was
+#  live when it started.
+#
+rungraphd -d${D} -p${D}.pid -itcp::8125 -bt
+echo 'read (type="t" result=count)' | $GLD -s tcp::8125 -ap > $D.read &
+reader=$!
+guid=0000001240003456800000000002237a
+while kill -0 $reader 2>/dev/null
+do
+	guid=`echo "write (guid=$guid type=\"t\" value=\"a6 again\")" \
+		| $GLD -s tcp::8125 -ap | sed 's/^ok (\(.*\))$/\1/'`
+done
+wait
+cat $D.read
+echo 'read (type="t" result=count)' | $GLD -s tcp::8125 -ap
+rungraphd -d${D} -p${D}.pid -z
+rm -rf $D $D.read
@@ -0,0 +1,82 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+source ./pages
+GLD=../../gld/gld
+
+rm -rf $D $D.expected $D.next $D.find $D.page
+
+#  20,000 primitives pointing left to a hub.  The first 300 have
+#  the value "early"; the others cycle through "v0" ... "v19".
+#
+HUB=00000012400034568000000000000000
+function primitives ()
+{
+	echo 'write (value="hub")'
+	for i in `seq 1 20000`
+	do
+		if [ $i -le 300 ]; then v=early; else v=v$((i % 20)); fi
+		echo "write (value=\"$v\" left=$HUB)"
+	done
+}
+primitives | rungraphd -d${D} -bty | grep -vc '^ok ('
+
+#  Seventeen sorted branches, enough for the loser tree: one runs
+#  out after the first 300 ids, and "v3" is there twice, so all of
+#  its ids show up in two branches.
+#
+VALUES='"early" "v0" "v1" "v2" "v3" "v4" "v5" "v6" "v7" "v8" "v9" "v10" "v11" "v12" "v13" "v14" "v3"'
+
+function guids ()
+{
+	grep -o '[0-9a-f]\{32\}' | grep -v $HUB
+}
+
+#  What the "or" should return: each branch on its own, merged.
+#
+for v in $VALUES
+do
+	echo "read (value=$v pagesize=20000 result=((guid)))"
+done | rungraphd -d${D} -bty | guids | sort -u > $D.expected
+wc -l < $D.expected
+
+#  "next" through the whole "or", in one go.
+#
+echo "read (value=($VALUES) pagesize=20000 result=((guid)))" \
+	| rungraphd -d${D} -bty | guids > $D.next
+sort -c $D.next 2>/dev/null || sort -rc $D.next && echo "next: in order"
+sort $D.next | cmp -s - $D.expected && echo "next: same"
+
+#  Intersected with the hub's links, the "or" is resumed with a
+#  find whenever the "and" picks a producer.
+#
+echo "read (left=$HUB value=($VALUES) pagesize=20000 result=((guid)))" \
+	| rungraphd -d${D} -bty | guids > $D.find
+sort $D.find | cmp -s - $D.expected && echo "find: same"
+
+#  Page through both with cursors; each page thaws the "or" in
+#  the middle of its merge.
+#
+rungraphd -d${D} -p${D}.pid -itcp::8126 -bt
+pages 8126 1000 "value=($VALUES)" 30 | guids | cmp -s - $D.next \
+	&& echo "next pages: same"
+pages 8126 1000 "left=$HUB value=($VALUES)" 30 | guids | cmp -s - $D.find \
+	&& echo "find pages: same"
+rungraphd -d${D} -p${D}.pid -z
+
+rm -rf $D $D.expected $D.next $D.find $D.page
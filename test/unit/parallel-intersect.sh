@@ -0,0 +1,44 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+#  Intersect "left=a" (every third link) with "right=b" (every
+#  tenth), once serially and once on worker threads with the
+#  parallel threshold lowered far enough to split these arrays.
+
+rm -rf $D
+{
+	echo 'write (name="a")'
+	echo 'write (name="b")'
+	for i in `seq 6000`; do
+		l=; r=
+		[ $((i % 3)) = 0 ] && l=" left=00000012400034568000000000000000"
+		[ $((i % 10)) = 0 ] && r=" right=00000012400034568000000000000001"
+		echo "write (value=\"$i\"$l$r)"
+	done
+} | rungraphd -d${D} -bty > /dev/null
+
+Q='read (left=00000012400034568000000000000000 right=00000012400034568000000000000001 result=((value)))'
+
+echo "$Q" | rungraphd -d${D} -bty > $D.serial
+echo "$Q" | rungraphd -f $B.conf -bty \
+	-vverbose 2>$D.log > $D.parallel
+cat $D.serial
+grep -c "addb_idarray_intersect: [0-9]* partitions" $D.log
+cmp $D.serial $D.parallel && echo same
+rm -rf $D $D.serial $D.parallel $D.log
@@ -0,0 +1,60 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+rm -rf $D
+
+#  The plan cache lives in the server process, so this all goes
+#  to one server.  (The grep drops the replies to the writes.)
+#
+{
+	#  1000 each of n0 and n1, 400 each of v0 ... v4; large enough
+	#  that the "and" of a name and a value runs a producer contest.
+	#
+	for i in $(seq 1 2000)
+	do
+		echo "write (name=\"n$((i % 2))\" value=\"v$((i % 5))\")"
+	done
+
+	#  The first query makes a plan; the second, with the same
+	#  name, reuses it.  A different name is a different signature.
+	#
+	cat <<-'EOF'
+	status (plan)
+	read (name="n0" value="v1" result=count)
+	read (name="n0" value="v2" result=count)
+	read (name="n1" value="v1" result=count)
+	status (plan)
+	EOF
+
+	#  Grow v1 until the plan made with its old count is stale.
+	#  The next query drops it and runs the contest; the one after
+	#  that uses the new plan.
+	#
+	for i in $(seq 1 5000)
+	do
+		echo "write (name=\"n2\" value=\"v1\")"
+	done
+	cat <<-'EOF'
+	read (name="n0" value="v1" result=count)
+	status (plan)
+	read (name="n0" value="v1" result=count)
+	status (plan)
+	EOF
+} | rungraphd -d${D} -bty | grep -v '^ok ([0-9a-f]*)$'
+rm -rf $D
@@ -0,0 +1,52 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+rm -rf $D
+
+#  A hub with 3000 links pointing right to it -- a gmap array
+#  long enough to be read ahead of, short enough to stay in the
+#  gmap partition file.
+#
+HUB=`echo 'write (value="hub")' | rungraphd -d${D} -bty | grep -o '[0-9a-f]\{32\}'`
+function links ()
+{
+	for i in `seq 1 3000`
+	do
+		echo "write (type=\"link\" value=\"l$((i % 7))\" right=$HUB)"
+	done
+}
+links | rungraphd -d${D} -bty | grep -vc '^ok ('
+
+#  Scan the hub's array, and print the prefetch counters of all
+#  tiled files, summed.  Hits and misses depend on what's in the
+#  page cache; their sum, the number of requests, doesn't.
+#
+function scan ()
+{
+	rungraphd -d${D} -bty $* <<-EOF | tail -1 | tr '(' '\n' \
+		| sed -n 's/^"[a-z.0-9]*\.tile\.prefetch-\([a-z]*\)" "\([0-9]*\)".*/\1 \2/p' \
+		| awk '{ n[$1 == "stall" ? "stall" : "requests"] += $2 }
+			END { print "requests", n["requests"], "stall", n["stall"] }'
+	read (right=$HUB result=count)
+	status (database)
+	EOF
+}
+scan
+scan -f $B-off.conf
+rm -rf $D
@@ -0,0 +1,86 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+LOG=$D/type/g-00.addb.cln
+
+rm -rf $D $D.log $D.torn
+
+#  Write five primitives of type "t", then wait until the checkpoint
+#  that picks them up has appended its segment to the redo log of the
+#  type index.
+#
+function write_round ()
+{
+	size=`stat -c %s $LOG 2>/dev/null || echo 0`
+	for i in 1 2 3 4 5
+	do
+		echo "write (name=\"n$1.$i\" type=\"t\" value=\"v$i\")" \
+			| $GLD -s tcp::8124 -ap > /dev/null
+	done
+	for i in `seq 1 300`
+	do
+		[ `stat -c %s $LOG 2>/dev/null || echo 0` -gt $size ] && return
+		sleep 0.1
+	done
+	echo "round $1: redo log didn't grow"
+}
+
+#  Kill the server without letting it shut down; its index files
+#  still have a redo log.
+#
+function crash ()
+{
+	pid=`cat ${D}.pid`
+	[ -f $LOG ] && echo "redo log present"
+	kill -9 -$pid
+	while kill -0 -$pid 2>/dev/null; do sleep 0.1; done
+	rm -f ${D}.pid
+}
+
+#  Several checkpoints' worth of writes land in the redo logs;
+#  after the crash, replaying them gets all of them back.
+#
+rungraphd -f $B.conf -p${D}.pid -itcp::8124 -bt
+write_round 1
+write_round 2
+write_round 3
+crash
+rungraphd -f $B.conf -bty <<-'EOF'
+	read (type="t" result=count)
+	read (name="n2.4" result=((value)))
+	EOF
+[ -f $LOG ] || echo "redo log retired"
+
+#  A checkpoint that died while appending to the log leaves a
+#  segment cut short at its end (here, the start of an earlier
+#  segment); it is ignored, and the server still comes up with
+#  everything.
+#
+rungraphd -f $B.conf -p${D}.pid -itcp::8124 -bt
+write_round 4
+write_round 5
+crash
+head -c 100 $LOG > $D.torn
+cat $D.torn >> $LOG
+rungraphd -f $B.conf -bty -v debug 2> $D.log <<-'EOF'
+	read (type="t" result=count)
+	read (name="n5.5" result=((value)))
+	EOF
+grep -c "type/g-00.addb.cln: ignoring incomplete redo log segment" $D.log
+rm -rf $D $D.log $D.torn
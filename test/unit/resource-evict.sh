@@ -0,0 +1,69 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+#  Targets k1...k52.  "big" points to k13...k52 twenty times each;
+#  s1...s12 point once each to forty targets starting at k1...k12.
+#  The resources cached for the two kinds of read are the same size,
+#  but "big" costs twenty times as much to rebuild.
+#
+function primitives ()
+{
+	for i in $(seq 1 52)
+	do
+		printf 'write (value="k%d"' $i
+		if [ $i -ge 13 ]
+		then
+			for j in $(seq 1 20); do printf ' (<-right name="big")'; done
+		fi
+		for j in $(seq 1 12)
+		do
+			if [ $i -ge $j -a $i -lt $((j + 40)) ]
+			then
+				printf ' (<-right name="s%d")' $j
+			fi
+		done
+		echo ')'
+	done
+}
+
+#  With room for eight resources, storing the ninth flushes the
+#  cache down to half.  Greedy-dual-size-frequency evicts the cheap
+#  s1...s5 first, and keeps "big" even though it's the least
+#  recently used.  Continuing the "big" cursor finds its resource;
+#  continuing the s1 cursor has to rebuild.
+#
+rm -rf $D
+{
+	primitives
+	echo 'read (pagesize=2 result=(cursor (value)) (<-right name="big"))'
+	for j in $(seq 1 12)
+	do
+		echo "read (pagesize=2 result=(cursor (value)) (<-right name=\"s$j\"))"
+		[ $j -eq 8 -o $j -eq 9 ] && echo 'status (resource)'
+	done
+	cat <<-'EOF'
+	read (pagesize=2 result=(cursor (value)) (<-right name="big")
+		cursor="cursor:4bc7:[o:2][n:1332]fixed:(fixed-isa:90-1312:r<-(hmap:91-1332:pool:name:110290:big)[hint:0])/2/[cache:@0123456789ab1]")
+	status (resource)
+	read (pagesize=2 result=(cursor (value)) (<-right name="s1")
+		cursor="cursor:9002:[o:2][n:1332]fixed:(fixed-isa:0-982:r<-(hmap:1-1003:pool:name:3844:s1)[hint:0])/2/[cache:@0123456789ab2]")
+	status (resource)
+	EOF
+} | rungraphd -f $B.conf -bty | grep -v '^ok (0'
+rm -rf $D
@@ -0,0 +1,76 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+#  Print the shared segment's counters from "status (resource)".
+#  They live in the segment itself, so it doesn't matter which
+#  process answers.
+#
+function share_status ()
+{
+	echo 'status (resource)' | $GLD -s tcp::8122 -ap |
+		grep -o '("shared[a-z-]*" [0-9]*)' | tr -d '()"' |
+		awk '{ print $1, ($2 > 0 ? "yes" : "no") }'
+}
+
+#  SMP processes serve a replica; the writes go to its master.
+#  The replica isn't -b: predictable cursor stamps would be the
+#  same in both processes, and graphd doesn't share them then.
+#
+rm -rf $D $D-m $D.first $D.pages
+rungraphd -d${D}-m -p${D}-m.pid -itcp::8123 -bt
+rungraphd -f $B.conf -p${D}.pid -itcp::8122 -t 2>/dev/null
+sleep 1
+
+for i in $(seq 1 52)
+do
+	printf 'write (value="k%d"' $i
+	if [ $i -ge 13 ]
+	then
+		for j in $(seq 1 20); do printf ' (<-right name="big")'; done
+	fi
+	echo ')'
+done | $GLD -s tcp::8123 -ap | grep -c '^ok'
+sleep 1
+
+#  The first page publishes the cursor's resource into the segment.
+#
+echo 'read (pagesize=2 result=(cursor (value)) (<-right name="big"))' |
+	$GLD -s tcp::8122 -ap > $D.first
+sed 's/"cursor:[^"]*"/CURSOR/' $D.first
+CURSOR=`grep -o '"cursor:[^"]*"' $D.first`
+share_status
+
+#  Keep continuing the cursor on fresh connections until one lands
+#  on the process that didn't make it, and imports it from the segment
+#  instead of recomputing it.  Every continuation returns the same page.
+#
+for i in $(seq 1 50)
+do
+	echo "read (pagesize=2 result=(cursor (value)) (<-right name=\"big\")
+		cursor=$CURSOR)" | $GLD -s tcp::8122 -ap |
+		sed 's/"cursor:[^"]*"/CURSOR/' >> $D.pages
+	share_status | grep -q 'shared-hit yes' && break
+done
+sort -u $D.pages
+share_status
+
+rungraphd -f $B.conf -p${D}.pid -z
+rungraphd -d${D}-m -p${D}-m.pid -z
+rm -rf $D $D-m $D.first $D.pages
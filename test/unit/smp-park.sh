@@ -0,0 +1,73 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+#  Keep asking the follower at tcp::8113 for "$1" until it has it.
+#
+function wait_for ()
+{
+	for i in $(seq 1 100)
+	do
+		if echo "read (value=\"$1\" result=count)" |
+			$GLD -s tcp::8113 -ap | grep -q "^ok 1$"
+		then
+			echo "replica has $1"
+			return
+		fi
+		sleep 0.1
+	done
+	echo "replica doesn't have $1"
+}
+
+rm -rf $D $D-m $D.log
+rungraphd -d${D}-m -p${D}-m.pid -itcp::8112 -bt
+
+#  A read that starts before a write doesn't see it, even if the
+#  write runs while the read is suspended; its dateline is the one
+#  from before the write.  (The loglevel just makes the read slow
+#  enough for the write to overtake it.)
+#
+for i in $(seq 1 20000); do echo "write (value=\"$i\")"; done |
+	$GLD -s tcp::8112 -ap > /dev/null
+( echo 'read dateline="" loglevel=(verbose) (value~="*1*" result=count)' |
+	$GLD -s tcp::8112 -ap > $D.read; echo "read: `cat $D.read`" ) &
+sleep 0.3
+echo 'write (value="1 more")' | $GLD -s tcp::8112 -ap > /dev/null
+echo "write: done"
+wait
+echo 'read (value~="*1*" result=count)' | $GLD -s tcp::8112 -ap
+rm -f $D.read
+
+#  An SMP replica of that; its followers park when they have
+#  nothing to read, writes go ahead without them, and a read that
+#  arrives unparks a follower on the latest write.
+#
+rungraphd -f $B.conf -p${D}.pid -itcp::8113 -l$D.log -vverbose -bt 2>/dev/null
+wait_for "1 more"
+sleep 0.3
+echo 'write (value="a")' | $GLD -s tcp::8112 -ap > /dev/null
+wait_for a
+echo 'write (value="b")' | $GLD -s tcp::8112 -ap > /dev/null
+wait_for b
+grep -q "graphd_smp_in_postwrite: parking" $D.log && echo "followers parked"
+grep -q "graphd_smp_wake: unparking" $D.log && echo "a follower unparked"
+
+rungraphd -f $B.conf -p${D}.pid -z
+rungraphd -d${D}-m -p${D}-m.pid -z
+rm -rf $D $D-m $D.log
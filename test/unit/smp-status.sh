@@ -0,0 +1,77 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+GLD=../../gld/gld
+
+#  Print the replica's "status (smp)" without process IDs, times, or
+#  how often the leader published (the followers' post-write answers
+#  can race with our writes); one follower per line, sorted, since
+#  which follower gets which of our connections is up to the kernel.
+#
+function smp_status ()
+{
+	echo 'status (smp)' | $GLD -s tcp::8117 -ap > $D.status
+	grep -o '("horizon" [0-9]*)' $D.status
+	grep -o '("follower" [0-9 ]*)' $D.status | tr -d '()' |
+		awk '{ print "follower: horizon", $4, "lag", $5,
+			($6 > 0 ? "late" : "on time"),
+			"refreshes", $7, "skipped", $8 }' | sort
+	rm -f $D.status
+}
+
+#  Read from the replica until every follower has caught up.
+#
+function catch_up ()
+{
+	for i in $(seq 1 50)
+	do
+		echo 'read (value="b" result=count)' |
+			$GLD -s tcp::8117 -ap > /dev/null
+		echo 'status (smp)' | $GLD -s tcp::8117 -ap |
+			grep -q '("follower" [0-9]* [0-9]* [0-9]* [1-9]' || return
+		sleep 0.1
+	done
+}
+
+rm -rf $D $D-m
+rungraphd -d${D}-m -p${D}-m.pid -itcp::8116 -bt
+rungraphd -f $B.conf -p${D}.pid -itcp::8117 -bt 2>/dev/null
+sleep 1
+smp_status
+
+#  Parked followers fall behind the horizon the leader publishes.
+#
+echo 'write (value="a")' | $GLD -s tcp::8116 -ap
+sleep 1
+smp_status
+for i in 1 2 3; do echo 'write (value="b")' | $GLD -s tcp::8116 -ap; done
+sleep 1
+smp_status
+
+#  A read unparks the follower it lands on; it refreshes and
+#  no longer trails.
+#
+echo 'read (value="b" result=count)' | $GLD -s tcp::8117 -ap
+smp_status
+
+catch_up
+smp_status
+
+rungraphd -f $B.conf -p${D}.pid -z
+rungraphd -d${D}-m -p${D}-m.pid -z
+rm -rf $D $D-m
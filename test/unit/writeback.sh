@@ -0,0 +1,33 @@
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#!/bin/bash
+
+B=`basename $0 .sh`
+cd `dirname $0`
+source ./rungraphd
+
+#  ben's write load, with background writeback turned on; the
+#  results must not change, and the tile status of every
+#  partition picks up the writeback and dirty-age keys.
+#
+rm -rf $D $D.writes
+(cat ben.in; echo 'status (database)') | rungraphd -f $B.conf -bty > $D.writes
+head -465 $D.writes | cmp -s - <(head -465 ben.out.exp) && echo "same as ben"
+tail -1 $D.writes | tr '(' '\n' \
+	| grep -o '"[a-z]*\.[a-z.]*partition\.[0-9]*\.tile\.\(writeback-[a-z]*\|dirty-age\.[a-z0-9]*\)"' \
+	| sed 's/.*\.tile\.\(.*\)"/tile.\1/' | sort | uniq -c
+rungraphd -f $B.conf -bty <<-'EOF'
+	read (value="monopoly")
+EOF
+rm -rf $D $D.writes